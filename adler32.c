@@ -6,6 +6,7 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "zcpu.h"
 
 #define BASE 65521U     /* largest prime smaller than 65536 */
 #define NMAX 5552
@@ -57,11 +58,325 @@
 #  define MOD63(a) a %= BASE
 #endif
 
+#ifdef X86_SIMD
+#include <immintrin.h>
+
+/* ========================================================================= */
+/*
+   Compute the Adler-32 of buf[0..len-1] with SSE2, and copy it to dest if dest
+   is not Z_NULL, all in one pass.  32 bytes are processed at a time.  Sixteen
+   bytes are summed with one psadbw.  The contributions to sum2 from the bytes
+   are the bytes widened to 16 bits and multiplied by their weights, 32 down to
+   1, with pmaddwd.  The contribution from the running sum in each 32-byte
+   block is 32 times the sum of the bytes before it, which is accumulated in
+   ps.  The blocks are limited so that the 32-bit lanes cannot overflow before
+   the modulo, per NMAX.
+ */
+local uLong adler32_sse2(uLong adler, Bytef *dest, const Bytef *buf,
+                         z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    unsigned int sums[4];
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w1 = _mm_set_epi16(25, 26, 27, 28, 29, 30, 31, 32);
+    const __m128i w2 = _mm_set_epi16(17, 18, 19, 20, 21, 22, 23, 24);
+    const __m128i w3 = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+    const __m128i w4 = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+    __m128i a, b, s1, s2, ps;
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    while (len >= 32) {
+        n = len < NMAX ? (unsigned)(len >> 5) : NMAX >> 5;
+        len -= (z_size_t)n << 5;
+        ps = _mm_cvtsi32_si128((int)(adler * n));
+        s1 = zero;
+        s2 = _mm_cvtsi32_si128((int)sum2);
+        do {
+            a = _mm_loadu_si128((const __m128i *)buf);
+            b = _mm_loadu_si128((const __m128i *)(buf + 16));
+            buf += 32;
+            if (dest != Z_NULL) {
+                _mm_storeu_si128((__m128i *)dest, a);
+                _mm_storeu_si128((__m128i *)(dest + 16), b);
+                dest += 32;
+            }
+            ps = _mm_add_epi32(ps, s1);
+            s1 = _mm_add_epi32(s1, _mm_add_epi32(_mm_sad_epu8(a, zero),
+                                                 _mm_sad_epu8(b, zero)));
+            s2 = _mm_add_epi32(s2, _mm_add_epi32(
+                _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(a, zero), w1),
+                              _mm_madd_epi16(_mm_unpackhi_epi8(a, zero), w2)),
+                _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(b, zero), w3),
+                              _mm_madd_epi16(_mm_unpackhi_epi8(b, zero),
+                                             w4))));
+        } while (--n);
+        s2 = _mm_add_epi32(s2, _mm_slli_epi32(ps, 5));
+
+        /* add up the lanes and reduce */
+        _mm_storeu_si128((__m128i *)sums, s1);
+        adler += (unsigned long)sums[0] + sums[2];
+        _mm_storeu_si128((__m128i *)sums, s2);
+        sum2 = (unsigned long)sums[0] + sums[1] + sums[2] + sums[3];
+        MOD(adler);
+        MOD(sum2);
+    }
+    adler |= sum2 << 16;
+    if (len) {
+        if (dest != Z_NULL)
+            zmemcpy(dest, buf, (unsigned)len);
+        adler = adler32_z(adler, buf, len);
+    }
+    return adler;
+}
+
+/*
+   The same with SSSE3, where pmaddubsw multiplies the bytes by their weights
+   and adds adjacent pairs, without first widening the bytes to 16 bits.
+   pmaddwd with ones then adds those pairs into 32-bit lanes.
+ */
+__attribute__((target("ssse3")))
+local uLong adler32_ssse3(uLong adler, Bytef *dest, const Bytef *buf,
+                          z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    unsigned int sums[4];
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i w1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                     24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i w2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                     8, 7, 6, 5, 4, 3, 2, 1);
+    __m128i a, b, s1, s2, ps;
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    while (len >= 32) {
+        n = len < NMAX ? (unsigned)(len >> 5) : NMAX >> 5;
+        len -= (z_size_t)n << 5;
+        ps = _mm_cvtsi32_si128((int)(adler * n));
+        s1 = zero;
+        s2 = _mm_cvtsi32_si128((int)sum2);
+        do {
+            a = _mm_loadu_si128((const __m128i *)buf);
+            b = _mm_loadu_si128((const __m128i *)(buf + 16));
+            buf += 32;
+            if (dest != Z_NULL) {
+                _mm_storeu_si128((__m128i *)dest, a);
+                _mm_storeu_si128((__m128i *)(dest + 16), b);
+                dest += 32;
+            }
+            ps = _mm_add_epi32(ps, s1);
+            s1 = _mm_add_epi32(s1, _mm_add_epi32(_mm_sad_epu8(a, zero),
+                                                 _mm_sad_epu8(b, zero)));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_add_epi16(
+                _mm_maddubs_epi16(a, w1), _mm_maddubs_epi16(b, w2)), ones));
+        } while (--n);
+        s2 = _mm_add_epi32(s2, _mm_slli_epi32(ps, 5));
+
+        /* add up the lanes and reduce */
+        _mm_storeu_si128((__m128i *)sums, s1);
+        adler += (unsigned long)sums[0] + sums[2];
+        _mm_storeu_si128((__m128i *)sums, s2);
+        sum2 = (unsigned long)sums[0] + sums[1] + sums[2] + sums[3];
+        MOD(adler);
+        MOD(sum2);
+    }
+    adler |= sum2 << 16;
+    if (len) {
+        if (dest != Z_NULL)
+            zmemcpy(dest, buf, (unsigned)len);
+        adler = adler32_z(adler, buf, len);
+    }
+    return adler;
+}
+
+/*
+   The same with AVX2, 64 bytes at a time in two 32-byte vectors, with weights
+   64 down to 1.  The pairs from the two vectors are widened to 32 bits before
+   adding, since with the larger weights their sum could overflow 16 bits.
+ */
+__attribute__((target("avx2")))
+local uLong adler32_avx2(uLong adler, Bytef *dest, const Bytef *buf,
+                         z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    unsigned int sums[8];
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i w1 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57,
+                                        56, 55, 54, 53, 52, 51, 50, 49,
+                                        48, 47, 46, 45, 44, 43, 42, 41,
+                                        40, 39, 38, 37, 36, 35, 34, 33);
+    const __m256i w2 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                        24, 23, 22, 21, 20, 19, 18, 17,
+                                        16, 15, 14, 13, 12, 11, 10, 9,
+                                        8, 7, 6, 5, 4, 3, 2, 1);
+    __m256i a, b, s1, s2, ps;
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    while (len >= 64) {
+        n = len < NMAX ? (unsigned)(len >> 6) : NMAX >> 6;
+        len -= (z_size_t)n << 6;
+        ps = _mm256_setr_epi32((int)(adler * n), 0, 0, 0, 0, 0, 0, 0);
+        s1 = zero;
+        s2 = _mm256_setr_epi32((int)sum2, 0, 0, 0, 0, 0, 0, 0);
+        do {
+            a = _mm256_loadu_si256((const __m256i *)buf);
+            b = _mm256_loadu_si256((const __m256i *)(buf + 32));
+            buf += 64;
+            if (dest != Z_NULL) {
+                _mm256_storeu_si256((__m256i *)dest, a);
+                _mm256_storeu_si256((__m256i *)(dest + 32), b);
+                dest += 64;
+            }
+            ps = _mm256_add_epi32(ps, s1);
+            s1 = _mm256_add_epi32(s1, _mm256_add_epi32(
+                _mm256_sad_epu8(a, zero), _mm256_sad_epu8(b, zero)));
+            s2 = _mm256_add_epi32(s2, _mm256_add_epi32(
+                _mm256_madd_epi16(_mm256_maddubs_epi16(a, w1), ones),
+                _mm256_madd_epi16(_mm256_maddubs_epi16(b, w2), ones)));
+        } while (--n);
+        s2 = _mm256_add_epi32(s2, _mm256_slli_epi32(ps, 6));
+
+        /* add up the lanes and reduce */
+        _mm256_storeu_si256((__m256i *)sums, s1);
+        adler += (unsigned long)sums[0] + sums[2] + sums[4] + sums[6];
+        _mm256_storeu_si256((__m256i *)sums, s2);
+        sum2 = (unsigned long)sums[0] + sums[1] + sums[2] + sums[3] +
+               sums[4] + sums[5] + sums[6] + sums[7];
+        MOD(adler);
+        MOD(sum2);
+    }
+    adler |= sum2 << 16;
+    if (len) {
+        if (dest != Z_NULL)
+            zmemcpy(dest, buf, (unsigned)len);
+        adler = adler32_z(adler, buf, len);
+    }
+    return adler;
+}
+
+/* Use the fastest version supported by this processor, chosen on first use. */
+typedef uLong (*adler_func)(uLong, Bytef *, const Bytef *, z_size_t);
+local z_once_t adler_chosen = Z_ONCE_INIT;
+local adler_func adler32_vec;
+local const char *adler32_name;
+
+local void adler32_choose(void) {
+    unsigned features = zcpu_features();
+
+    if (features & ZCPU_AVX2) {
+        adler32_vec = adler32_avx2;
+        adler32_name = "avx2";
+    }
+    else if (features & ZCPU_SSSE3) {
+        adler32_vec = adler32_ssse3;
+        adler32_name = "ssse3";
+    }
+    else {
+        adler32_vec = adler32_sse2;
+        adler32_name = "sse2";
+    }
+}
+
+local uLong adler32_simd(uLong adler, Bytef *dest, const Bytef *buf,
+                         z_size_t len) {
+    z_once(&adler_chosen, adler32_choose);
+    return adler32_vec(adler, dest, buf, len);
+}
+
+#elif defined(ARM_SIMD)
+#include <arm_neon.h>
+
+/* ========================================================================= */
+/*
+   Compute the Adler-32 of buf[0..len-1] with NEON, and copy it to dest if dest
+   is not Z_NULL, all in one pass.  32 bytes are processed at a time.  The
+   bytes are summed with pairwise widening adds.  The bytes at each of the 32
+   positions are summed in 16-bit columns, which are multiplied by their
+   weights, 32 down to 1, once per block.  The contribution from the running
+   sum in each 32-byte block is 32 times the sum of the bytes before it, which
+   is accumulated in ps.  The blocks are limited per NMAX, which also keeps the
+   columns from overflowing.
+ */
+local uLong adler32_neon(uLong adler, Bytef *dest, const Bytef *buf,
+                         z_size_t len) {
+    static const uint16_t w[32] = {
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+    };
+    unsigned long sum2;
+    unsigned n;
+    uint8x16_t a, b;
+    uint16x8_t c1, c2, c3, c4;
+    uint32x4_t s1, s2, ps;
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    while (len >= 32) {
+        n = len < NMAX ? (unsigned)(len >> 5) : NMAX >> 5;
+        len -= (z_size_t)n << 5;
+        sum2 += (adler * n) << 5;
+        ps = vdupq_n_u32(0);
+        s1 = ps;
+        c1 = c2 = c3 = c4 = vdupq_n_u16(0);
+        do {
+            a = vld1q_u8(buf);
+            b = vld1q_u8(buf + 16);
+            buf += 32;
+            if (dest != Z_NULL) {
+                vst1q_u8(dest, a);
+                vst1q_u8(dest + 16, b);
+                dest += 32;
+            }
+            ps = vaddq_u32(ps, s1);
+            s1 = vpadalq_u16(s1, vpadalq_u8(vpaddlq_u8(a), b));
+            c1 = vaddw_u8(c1, vget_low_u8(a));
+            c2 = vaddw_u8(c2, vget_high_u8(a));
+            c3 = vaddw_u8(c3, vget_low_u8(b));
+            c4 = vaddw_u8(c4, vget_high_u8(b));
+        } while (--n);
+        s2 = vshlq_n_u32(ps, 5);
+        s2 = vmlal_u16(s2, vget_low_u16(c1), vld1_u16(w));
+        s2 = vmlal_u16(s2, vget_high_u16(c1), vld1_u16(w + 4));
+        s2 = vmlal_u16(s2, vget_low_u16(c2), vld1_u16(w + 8));
+        s2 = vmlal_u16(s2, vget_high_u16(c2), vld1_u16(w + 12));
+        s2 = vmlal_u16(s2, vget_low_u16(c3), vld1_u16(w + 16));
+        s2 = vmlal_u16(s2, vget_high_u16(c3), vld1_u16(w + 20));
+        s2 = vmlal_u16(s2, vget_low_u16(c4), vld1_u16(w + 24));
+        s2 = vmlal_u16(s2, vget_high_u16(c4), vld1_u16(w + 28));
+
+        /* add up the lanes and reduce */
+        adler += vaddvq_u32(s1);
+        sum2 += vaddvq_u32(s2);
+        MOD(adler);
+        MOD(sum2);
+    }
+    adler |= sum2 << 16;
+    if (len) {
+        if (dest != Z_NULL)
+            zmemcpy(dest, buf, (unsigned)len);
+        adler = adler32_z(adler, buf, len);
+    }
+    return adler;
+}
+
+/* NEON is always present on AArch64. */
+#define adler32_simd adler32_neon
+#endif
+
 /* ========================================================================= */
 uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
     unsigned long sum2;
     unsigned n;
 
+#if defined(X86_SIMD) || defined(ARM_SIMD)
+    if (len >= 64 && buf != Z_NULL)
+        return adler32_simd(adler, Z_NULL, buf, len);
+#endif
+
     /* split Adler-32 into component sums */
     sum2 = (adler >> 16) & 0xffff;
     adler &= 0xffff;
@@ -129,6 +444,38 @@ uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len) {
     return adler32_z(adler, buf, len);
 }
 
+/* ========================================================================= */
+uLong ZLIB_INTERNAL adler32_copy(uLong adler, Bytef *dest,
+                                 const Bytef *source, z_size_t len) {
+    unsigned n;
+
+#if defined(X86_SIMD) || defined(ARM_SIMD)
+    if (len >= 64)
+        return adler32_simd(adler, dest, source, len);
+#endif
+    while (len) {
+        n = len < CHECK_BLOCK ? (unsigned)len : CHECK_BLOCK;
+        zmemcpy(dest, source, n);
+        adler = adler32_z(adler, dest, n);
+        dest += n;
+        source += n;
+        len -= n;
+    }
+    return adler;
+}
+
+/* ========================================================================= */
+const char ZLIB_INTERNAL *adler32_kernel(void) {
+#if defined(X86_SIMD)
+    z_once(&adler_chosen, adler32_choose);
+    return adler32_name;
+#elif defined(ARM_SIMD)
+    return "neon";
+#else
+    return "c";
+#endif
+}
+
 /* ========================================================================= */
 local uLong adler32_combine_(uLong adler1, uLong adler2, z_off64_t len2) {
     unsigned long sum1;
@@ -159,6 +506,21 @@ uLong ZEXPORT adler32_combine(uLong adler1, uLong adler2, z_off_t len2) {
     return adler32_combine_(adler1, adler2, len2);
 }
 
+/* ========================================================================= */
+uLong ZEXPORT adler32_combine_many(const uLong *adlers, const z_size_t *lens,
+                                   unsigned n) {
+    uLong adler;
+    unsigned i;
+
+    /* each combination takes constant time, so there is nothing to cache */
+    if (n == 0)
+        return 1L;
+    adler = adlers[0];
+    for (i = 1; i < n; i++)
+        adler = adler32_combine_(adler, adlers[i], (z_off64_t)lens[i]);
+    return adler;
+}
+
 uLong ZEXPORT adler32_combine64(uLong adler1, uLong adler2, z_off64_t len2) {
     return adler32_combine_(adler1, adler2, len2);
 }
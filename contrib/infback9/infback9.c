@@ -7,8 +7,7 @@
 #include "infback9.h"
 #include "inftree9.h"
 #include "inflate9.h"
-
-#define WSIZE 65536UL
+#include "inffast9.h"
 
 /*
    strm provides memory allocation functions in zalloc and zfree, or
@@ -108,6 +107,34 @@ void makefixed9(void) {
 
 /* Macros for inflateBack(): */
 
+/* Load returned state from inflate_fast9() */
+#define LOAD() \
+    do { \
+        put = strm->next_out; \
+        left = state->left; \
+        next = strm->next_in; \
+        have = strm->avail_in; \
+        hold = state->hold; \
+        bits = state->bits; \
+        mode = state->mode; \
+    } while (0)
+
+/* Set state from registers for inflate_fast9() */
+#define RESTORE() \
+    do { \
+        strm->next_out = put; \
+        state->left = left; \
+        strm->next_in = next; \
+        strm->avail_in = have; \
+        state->hold = hold; \
+        state->bits = bits; \
+        state->wrap = wrap; \
+        state->lencode = lencode; \
+        state->distcode = distcode; \
+        state->lenbits = lenbits; \
+        state->distbits = distbits; \
+    } while (0)
+
 /* Clear the input bit accumulator */
 #define INITBITS() \
     do { \
@@ -453,8 +480,22 @@ int ZEXPORT inflateBack9(z_stream FAR *strm, in_func in, void FAR *in_desc,
             }
             Tracev((stderr, "inflate:       codes ok\n"));
             mode = LEN;
+                /* fallthrough */
 
         case LEN:
+            /* use inflate_fast9() if we have enough input and output */
+            if (have >= INFLATE9_FAST_MIN_HAVE &&
+                left >= INFLATE9_FAST_MIN_LEFT) {
+                RESTORE();
+                inflate_fast9(strm);
+                LOAD();
+                if (mode == MATCH) {
+                    length = state->length;
+                    offset = state->offset;
+                }
+                break;
+            }
+
             /* get a literal, length, or end-of-block code */
             for (;;) {
                 here = lencode[BITS(lenbits)];
@@ -546,7 +587,10 @@ int ZEXPORT inflateBack9(z_stream FAR *strm, in_func in, void FAR *in_desc,
                 break;
             }
             Tracevv((stderr, "inflate:         distance %lu\n", offset));
+            mode = MATCH;
+                /* fallthrough */
 
+        case MATCH:
             /* copy match from window to output */
             do {
                 ROOM();
@@ -566,6 +610,7 @@ int ZEXPORT inflateBack9(z_stream FAR *strm, in_func in, void FAR *in_desc,
                     *put++ = *from++;
                 } while (--copy);
             } while (length != 0);
+            mode = LEN;
             break;
 
         case DONE:
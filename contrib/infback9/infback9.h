@@ -6,7 +6,8 @@
 /*
  * This header file and associated patches provide a decoder for PKWare's
  * undocumented deflate64 compression method (method 9).  Use with infback9.c,
- * inftree9.h, inftree9.c, and inffix9.h.  These patches are not supported.
+ * inftree9.h, inftree9.c, inffast9.h, inffast9.c, and inffix9.h.  These
+ * patches are not supported.
  * This should be compiled with zlib, since it uses zutil.h and zutil.o.
  * This code has not yet been tested on 16-bit architectures.  See the
  * comments in zlib.h for inflateBack() usage.  These functions are used
@@ -0,0 +1,240 @@
+/* inffast9.c -- fast decoding of deflate64 data for inflateBack9()
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "zutil.h"
+#include "inftree9.h"
+#include "inflate9.h"
+#include "inffast9.h"
+
+/* Pull a byte of input into hold, with no check -- inflate_fast9() has made
+   sure that there is enough input for the whole length/distance pair */
+#define PUP() \
+    do { \
+        hold += (unsigned long)(*in++) << bits; \
+        bits += 8; \
+    } while (0)
+
+/*
+   Decode literal, length, and distance codes and write out the resulting
+   literal and match bytes until either not enough input or output is
+   available, an end-of-block is encountered, or a data error is encountered.
+   When there is enough input, this is where inflateBack9() spends most of its
+   time, since the loop does not check for input and output on each step.
+
+   Entry assumptions:
+
+        state->mode == LEN
+        strm->avail_in >= INFLATE9_FAST_MIN_HAVE
+        state->left >= INFLATE9_FAST_MIN_LEFT
+        strm->next_out == state->window + WSIZE - state->left
+        state->bits < 8
+
+   On return, state->mode is one of:
+
+        LEN -- ran out of enough output space or enough available input
+        TYPE -- reached end of block code, inflateBack9() checks for last
+        MATCH -- a match did not fit in the window, and the remaining
+                 state->length bytes are to be copied from state->offset back
+        BAD -- error in block data
+
+   Notes:
+
+    - Deflate64 differs from deflate in that length code 285 has 16 extra bits
+      for lengths 3..65538, and that distance codes 30 and 31 are used, with
+      14 extra bits to reach back 64K.  So a length/distance pair can use 15
+      bits for the length code, 16 for the length extra, 15 for the distance
+      code, and 14 for the distance extra.  Two bytes are pulled when there
+      are less than 15 bits, and one or two bytes for the extra bits, so no
+      more than eight bytes are needed for one symbol, and hold never has
+      more than 31 bits.
+
+    - The window is also the output buffer, and there is at least 258 bytes
+      of space at out on each loop.  That leaves room for a literal or a match
+      of the deflate lengths.  A longer match is copied until the window is
+      full, and inflateBack9() writes it out and copies the rest.
+ */
+void inflate_fast9(z_stream FAR *strm) {
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *window;  /* window and output buffer */
+    unsigned long hold;         /* local state->hold */
+    unsigned bits;              /* local state->bits */
+    code const FAR *lcode;      /* local state->lencode */
+    code const FAR *dcode;      /* local state->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code const FAR *here;       /* retrieved table entry */
+    unsigned op;                /* code bits, operation, or extra bits */
+    unsigned long len;          /* match length, unused bytes */
+    unsigned long dist;         /* match distance */
+    unsigned long copy;         /* window bytes before out, bytes to copy */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE9_FAST_MIN_HAVE - 1));
+    out = strm->next_out;
+    end = out + (state->left - (INFLATE9_FAST_MIN_LEFT - 1));
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    state->mode = LEN;
+    do {
+        if (bits < 15) {
+            PUP();
+            PUP();
+        }
+        here = lcode + (hold & lmask);
+      dolen:
+        op = (unsigned)(here->bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here->op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here->val >= 0x20 && here->val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here->val));
+            *out++ = (unsigned char)(here->val);
+        }
+        else if (op & 128) {                    /* length base */
+            len = (unsigned long)(here->val);
+            op &= 31;                           /* number of extra bits */
+            if (op) {
+                if (bits < op) {
+                    PUP();
+                    if (bits < op)
+                        PUP();
+                }
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %lu\n", len));
+            if (bits < 15) {
+                PUP();
+                PUP();
+            }
+            here = dcode + (hold & dmask);
+          dodist:
+            op = (unsigned)(here->bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here->op);
+            if (op & 128) {                     /* distance base */
+                dist = (unsigned long)(here->val);
+                op &= 15;                       /* number of extra bits */
+                if (bits < op) {
+                    PUP();
+                    if (bits < op)
+                        PUP();
+                }
+                dist += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %lu\n", dist));
+                copy = (unsigned long)(out - window);
+                if (dist > copy && !state->wrap) {
+                    strm->msg = (z_const char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+
+                /* copy only what fits, leaving the rest to inflateBack9() */
+                if (len > (unsigned long)(window + WSIZE - out)) {
+                    state->length = len - (unsigned long)(window + WSIZE - out);
+                    state->offset = dist;
+                    state->mode = MATCH;
+                    len = (unsigned long)(window + WSIZE - out);
+                }
+
+                /* copy from the end of the window, if wrapped */
+                if (dist > copy) {
+                    copy = dist - copy;                 /* bytes at end */
+                    from = window + (WSIZE - copy);
+                    if (copy > len)
+                        copy = len;
+                    len -= copy;
+                    do {
+                        *out++ = *from++;
+                    } while (--copy);
+                    from = window;
+                }
+                else
+                    from = out - dist;
+
+                /* copy the rest, which may overlap the output */
+                if (dist >= len) {
+                    zmemcpy(out, from, (unsigned)len);
+                    out += len;
+                }
+                else {
+                    while (len > 2) {
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        len -= 3;
+                    }
+                    if (len) {
+                        *out++ = *from++;
+                        if (len > 1)
+                            *out++ = *from++;
+                    }
+                }
+                if (state->mode == MATCH)
+                    break;
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode + here->val + (hold & ((1U << op) - 1));
+                goto dodist;
+            }
+            else {
+                strm->msg = (z_const char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode + here->val + (hold & ((1U << op) - 1));
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (z_const char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    len = bits >> 3;
+    in -= len;
+    bits -= (unsigned)len << 3;
+    hold &= (1UL << bits) - 1;
+
+    /* update state */
+    strm->next_in = in;
+    strm->avail_in = (unsigned)(in < last ?
+        (INFLATE9_FAST_MIN_HAVE - 1) + (last - in) :
+        (INFLATE9_FAST_MIN_HAVE - 1) - (in - last));
+    strm->next_out = out;
+    state->left = (unsigned long)(window + WSIZE - out);
+    state->hold = hold;
+    state->bits = bits;
+}
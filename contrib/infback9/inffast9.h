@@ -0,0 +1,18 @@
+/* inffast9.h -- header to use inffast9.c
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* inflate_fast9() can decode a length/distance pair with up to 60 bits of
+   codes and extra bits, so it needs eight input bytes on each loop.  The
+   258 bytes of output are for a match of the common lengths, where the
+   loop stops early for the longer matches of deflate64 that do not fit. */
+#define INFLATE9_FAST_MIN_HAVE 8
+#define INFLATE9_FAST_MIN_LEFT 258
+
+extern void inflate_fast9(z_stream FAR *strm);
@@ -8,12 +8,16 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* size of the window, which is also the output buffer */
+#define WSIZE 65536UL
+
 /* Possible inflate modes between inflate() calls */
 typedef enum {
         TYPE,       /* i: waiting for type bits, including last-flag bit */
         STORED,     /* i: waiting for stored size (length and complement) */
         TABLE,      /* i: waiting for dynamic block table lengths */
             LEN,        /* i: waiting for length/lit code */
+            MATCH,      /* o: waiting for output space to copy string */
     DONE,       /* finished check, done -- remain here until reset */
     BAD         /* got a data error -- remain here until reset */
 } inflate_mode;
@@ -28,13 +32,26 @@ typedef enum {
             STORED -> TYPE
             TABLE -> LENLENS -> CODELENS -> LEN
     Read deflate codes:
-                LEN -> LEN or TYPE
+                LEN -> LEN or TYPE or MATCH
+                MATCH -> LEN
  */
 
 /* state maintained between inflate() calls.  Approximately 7K bytes. */
 struct inflate_state {
         /* sliding window */
     unsigned char FAR *window;  /* allocated sliding window, if needed */
+        /* registers exchanged with inflate_fast9() */
+    inflate_mode mode;          /* current inflate mode */
+    int wrap;                   /* true if the window has wrapped */
+    unsigned long left;         /* available output */
+    unsigned long hold;         /* input bit accumulator */
+    unsigned bits;              /* number of bits in hold */
+    unsigned long length;       /* length of string left to copy */
+    unsigned long offset;       /* distance back to copy string from */
+    code const FAR *lencode;    /* starting table for length/literal codes */
+    code const FAR *distcode;   /* starting table for distance codes */
+    unsigned lenbits;           /* index bits for lencode */
+    unsigned distbits;          /* index bits for distcode */
         /* dynamic table building */
     unsigned ncode;             /* number of code length code lengths */
     unsigned nlen;              /* number of length code lengths */
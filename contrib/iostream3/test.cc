@@ -7,6 +7,7 @@
 
 #include "zfstream.h"
 #include <iostream>      // for cout
+#include <string>        // for bulk test data
 
 int main() {
 
@@ -45,6 +46,25 @@ int main() {
   }
   inf.close();
 
+  // Large reads and writes go straight to gzread and gzwrite
+  std::string big;
+  for (int i = 0; big.size() < 1000000; i++)
+    big += "Line " + std::to_string(i) + " of a large gzipped file\n";
+  outf.rdbuf()->setbufsize(32768);
+  outf.open("test3.txt.gz");
+  outf << "Header\n";
+  outf.write(big.data(), big.size());
+  outf.close();
+  std::string back(big.size(), '\0');
+  inf.rdbuf()->setbufsize(32768);
+  inf.open("test3.txt.gz");
+  inf.getline(buf, 80, '\n');
+  inf.read(&back[0], back.size());
+  std::cout << "\nBulk write and read of " << big.size() << " bytes "
+            << (std::string(buf) == "Header" && inf.gcount() == std::streamsize(big.size())
+                && back == big ? "succeeded" : "FAILED") << std::endl;
+  inf.close();
+
   return 0;
 
 }
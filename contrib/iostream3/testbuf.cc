@@ -0,0 +1,59 @@
+/*
+ * Test program for zstreambuf
+ */
+
+#include "zstreambuf.h"
+#include <iostream>      // for cout
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+int main() {
+
+  // Count what zlib and the buffers take from the memory resource
+  std::pmr::monotonic_buffer_resource arena(1 << 20);
+
+  std::string text;
+  for (int i = 0; text.size() < 200000; i++)
+    text += "Line " + std::to_string(i) + " of a gzip-encoded body\n";
+
+  // Compress into a span with an ostream, using the arena
+  std::vector<std::byte> gz(deflateBound(nullptr, text.size()) + 18);
+  zstreambuf out = zstreambuf::compress(gz, 6, 15 + 16, &arena);
+  std::ostream os(&out);
+  os << "Header " << 1 << std::endl;
+  os.write(text.data(), text.size());
+  os.flush();
+  bool done = out.finish();
+  std::cout << "Compressed " << text.size() + 9 << " bytes to "
+            << out.output().size() << (done ? " bytes\n" : " bytes, FAILED\n");
+
+  // Move the buffer, then decompress with an istream in a small read and
+  // a bulk read
+  zstreambuf moved = zstreambuf::decompress(out.output(), 15 + 32, &arena);
+  zstreambuf in(std::move(moved));
+  std::istream is(&in);
+  std::string line;
+  std::getline(is, line);
+  std::string back(text.size(), '\0');
+  is.read(&back[0], back.size());
+  bool ok = line == "Header 1" && back == text && is.gcount() == std::streamsize(text.size())
+            && is.get() == EOF && in.status() == Z_STREAM_END && in.remaining() == 0
+            && moved.status() != Z_OK;
+  std::cout << "Decompressed with moved buffer " << (ok ? "succeeded\n" : "FAILED\n");
+
+  // A truncated body is an error, and too small an output span is full
+  zstreambuf cut = zstreambuf::decompress(out.output().first(100));
+  std::istream cs(&cut);
+  while (cs.read(&back[0], back.size())) ;
+  std::vector<std::byte> small(50);
+  zstreambuf full = zstreambuf::compress(small);
+  std::ostream fs(&full);
+  fs.write(text.data(), text.size());
+  ok = cut.status() == Z_BUF_ERROR && !full.finish() && full.status() == Z_BUF_ERROR;
+  std::cout << "Truncated input and full output detected " << (ok ? "succeeded\n" : "FAILED\n");
+
+  return 0;
+
+}
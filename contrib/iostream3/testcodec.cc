@@ -0,0 +1,54 @@
+/*
+ * Test program for zlib::deflater and zlib::inflater
+ */
+
+#include "zcodec.h"
+#include <cstring>       // for memcmp
+#include <iostream>      // for cout
+#include <string>
+
+int main() {
+
+  // One arena per request, holding both streams and the compressed message
+  std::pmr::monotonic_buffer_resource arena(1 << 20);
+  zlib::deflater def(Z_DEFAULT_COMPRESSION, 15 + 16, 8, Z_DEFAULT_STRATEGY, &arena);
+  zlib::inflater inf(15 + 32, &arena);
+
+  // Several messages reuse the same state
+  bool ok = true;
+  std::size_t total = 0;
+  for (int m = 0; m < 5; m++) {
+    std::string msg;
+    for (int i = 0; msg.size() < 20000u * (m + 1); i++)
+      msg += "Message " + std::to_string(m) + " line " + std::to_string(i) + "\n";
+    zlib::span<const std::byte> in(reinterpret_cast<const std::byte*>(msg.data()), msg.size());
+    std::pmr::vector<std::byte> gz = def.compress(in);
+    std::pmr::vector<std::byte> back(msg.size(), &arena);
+    std::size_t got = inf.decompress_into(gz, back);
+    ok = ok && got == msg.size() && std::memcmp(back.data(), msg.data(), got) == 0;
+    total += gz.size();
+  }
+  std::cout << "Five messages through one deflater and inflater ("
+            << total << " bytes compressed) " << (ok ? "succeeded\n" : "FAILED\n");
+
+  // Errors come as zlib::error with the zlib code
+  std::string msg(1000, 'a');
+  zlib::span<const std::byte> in(reinterpret_cast<const std::byte*>(msg.data()), msg.size());
+  std::pmr::vector<std::byte> gz = def.compress(in);
+  std::byte small[10], big[2000];
+  int codes[3] = {0, 0, 0};
+  try { def.compress_into(in, small); } catch (const zlib::error& e) { codes[0] = e.code(); }
+  try { inf.decompress_into(zlib::span<const std::byte>(gz.data(), gz.size() - 5), big); }
+  catch (const zlib::error& e) { codes[1] = e.code(); }
+  gz[12] = std::byte(0xff);
+  try { inf.decompress_into(gz, big); } catch (const zlib::error& e) { codes[2] = e.code(); }
+  ok = codes[0] == Z_BUF_ERROR && codes[1] == Z_BUF_ERROR && codes[2] == Z_DATA_ERROR;
+
+  // Moved-from owners are empty, and the moved-to one works
+  zlib::deflater moved(std::move(def));
+  ok = ok && moved.compress(in).size() > 0;
+  std::cout << "Errors and moves " << (ok ? "succeeded\n" : "FAILED\n");
+
+  return 0;
+
+}
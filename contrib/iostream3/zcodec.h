@@ -0,0 +1,413 @@
+/*
+ * Header-only C++17 owners of deflate and inflate streams
+ *
+ * zlib::deflater and zlib::inflater own a z_stream, allocate everything
+ * from a std::pmr memory resource, such as a monotonic arena for the
+ * request, and reuse their state with deflateReset() and inflateReset()
+ * rather than initializing zlib again for each message.
+ *
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ZCODEC_H
+#define ZCODEC_H
+
+#include <climits>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if __cplusplus > 201703L && __has_include(<span>)
+#  include <span>
+#endif
+#include "zlib.h"
+
+namespace zlib
+{
+
+/*****************************************************************************/
+
+#if __cplusplus > 201703L && __has_include(<span>)
+  template<typename T>
+    using span = std::span<T>;
+#else
+  /**
+   *  @brief  Minimal stand-in for std::span before C++20.
+  */
+  template<typename T>
+    class span
+    {
+    public:
+      constexpr span() noexcept : ptr(nullptr), len(0) { }
+      constexpr span(T* p, std::size_t n) noexcept : ptr(p), len(n) { }
+      template<std::size_t N>
+        constexpr span(T (&a)[N]) noexcept : ptr(a), len(N) { }
+      // Any contiguous container with data() and size()
+      template<typename C,
+               typename = decltype(static_cast<T*>(std::declval<C&>().data()))>
+        constexpr span(C& c) noexcept : ptr(c.data()), len(c.size()) { }
+      constexpr T* data() const noexcept { return ptr; }
+      constexpr std::size_t size() const noexcept { return len; }
+    private:
+      T* ptr;
+      std::size_t len;
+    };
+#endif
+
+/**
+ *  @brief  zlib error, with the zlib return code.
+*/
+class error : public std::runtime_error
+{
+public:
+  error(int code, const char* msg)
+  : std::runtime_error(msg ? msg : zError(code)), ret(code) { }
+
+  int
+  code() const noexcept { return ret; }
+
+private:
+  int ret;
+};
+
+namespace detail
+{
+  // zfree is not told the size of a block, which deallocate needs, so each
+  // block from zalloc starts with its size, padded to keep the alignment
+  constexpr std::size_t align = alignof(std::max_align_t);
+  static_assert(align >= sizeof(std::size_t), "no room for block size");
+
+  inline voidpf
+  pmr_alloc(voidpf opaque, uInt items, uInt size)
+  {
+    auto mr = static_cast<std::pmr::memory_resource*>(opaque);
+    std::size_t n = align + std::size_t(items) * size;
+    try
+    {
+      auto p = static_cast<char*>(mr->allocate(n, align));
+      *reinterpret_cast<std::size_t*>(p) = n;
+      return p + align;
+    }
+    catch (...)
+    {
+      return Z_NULL;
+    }
+  }
+
+  inline void
+  pmr_free(voidpf opaque, voidpf address)
+  {
+    auto mr = static_cast<std::pmr::memory_resource*>(opaque);
+    char* p = static_cast<char*>(address) - align;
+    mr->deallocate(p, *reinterpret_cast<std::size_t*>(p), align);
+  }
+
+  // Largest piece of a span that zlib can take at once
+  inline uInt
+  piece(std::size_t n) noexcept
+  { return n > UINT_MAX ? UINT_MAX : uInt(n); }
+
+  /**
+   *  @brief  Owner of a z_stream allocated from a memory resource.
+   *
+   *  zlib's state points back to the z_stream, so it lives on the free
+   *  store where moving the owner doesn't change its address.
+  */
+  class stream
+  {
+  public:
+    stream(stream&& other) noexcept
+    : mr(other.mr), strm(std::exchange(other.strm, nullptr)) { }
+
+    stream(const stream&) = delete;
+    stream&
+    operator=(const stream&) = delete;
+
+    /**
+     *  @brief  Underlying z_stream, for streaming use of deflate or inflate.
+    */
+    z_stream&
+    get() noexcept { return *strm; }
+
+    /**
+     *  @brief  Memory resource that everything is allocated from.
+    */
+    std::pmr::memory_resource*
+    resource() const noexcept { return mr; }
+
+  protected:
+    explicit
+    stream(std::pmr::memory_resource* r)
+    : mr(r), strm(nullptr)
+    {
+      void* p = mr->allocate(sizeof(z_stream), alignof(z_stream));
+      strm = new (p) z_stream();
+      strm->zalloc = pmr_alloc;
+      strm->zfree = pmr_free;
+      strm->opaque = mr;
+    }
+
+    ~stream() { release(); }
+
+    // Free the z_stream after its state has been ended
+    void
+    release() noexcept
+    {
+      if (strm)
+        mr->deallocate(std::exchange(strm, nullptr), sizeof(z_stream),
+                       alignof(z_stream));
+    }
+
+    // Throw for a failed initialization, after freeing the z_stream
+    void
+    check_init(int ret)
+    {
+      if (ret == Z_OK)
+        return;
+      release();
+      if (ret == Z_MEM_ERROR)
+        throw std::bad_alloc();
+      throw error(ret, nullptr);
+    }
+
+    // Point zlib at the next pieces of in and out
+    void
+    feed(const Bytef* in_end, Bytef* out_end) noexcept
+    {
+      strm->avail_in = piece(std::size_t(in_end - strm->next_in));
+      strm->avail_out = piece(std::size_t(out_end - strm->next_out));
+    }
+
+    std::pmr::memory_resource* mr;
+    z_stream* strm;
+  };
+}
+
+/*****************************************************************************/
+
+/**
+ *  @brief  Deflate stream owner.
+ *
+ *  Construct once, then compress any number of messages with compress_into()
+ *  or compress(), each of which starts with deflateReset(). get() gives the
+ *  z_stream for streaming with deflate(), and reset() starts over.
+*/
+class deflater : public detail::stream
+{
+public:
+  /**
+   *  @brief  Initialize deflate.
+   *  @param  level  Compression level (see zlib.h for allowed values).
+   *  @param  window_bits  As for deflateInit2 (add 16 for gzip).
+   *  @param  mem_level  As for deflateInit2.
+   *  @param  strategy  Compression strategy (see zlib.h for allowed values).
+   *  @param  mr  Memory resource for zlib's state.
+   *
+   *  Throws std::bad_alloc if out of memory, or zlib::error for invalid
+   *  parameters.
+  */
+  explicit
+  deflater(int level = Z_DEFAULT_COMPRESSION,
+           int window_bits = 15,
+           int mem_level = 8,
+           int strategy = Z_DEFAULT_STRATEGY,
+           std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+  : detail::stream(mr)
+  {
+    check_init(deflateInit2(strm, level, Z_DEFLATED, window_bits, mem_level,
+                            strategy));
+  }
+
+  deflater(deflater&&) noexcept = default;
+
+  deflater&
+  operator=(deflater&& other) noexcept
+  {
+    if (this != &other)
+    {
+      end();
+      mr = other.mr;
+      strm = std::exchange(other.strm, nullptr);
+    }
+    return *this;
+  }
+
+  ~deflater() { end(); }
+
+  /**
+   *  @brief  Start a new stream with the same parameters.
+   *  @return  deflateReset() return code.
+  */
+  int
+  reset() noexcept { return deflateReset(strm); }
+
+  /**
+   *  @brief  Upper bound on compressed size.
+   *  @param  n  Uncompressed size.
+   *  @return  deflateBound() for the current parameters.
+  */
+  std::size_t
+  bound(std::size_t n) const noexcept
+  { return std::size_t(deflateBound(strm, uLong(n))); }
+
+  /**
+   *  @brief  Compress a complete message.
+   *  @param  in  Data to compress.
+   *  @param  out  Space for compressed data.
+   *  @return  Number of bytes written to @a out.
+   *
+   *  Throws zlib::error with Z_BUF_ERROR if @a out is too small, which
+   *  can't happen if it has bound(in.size()) bytes.
+  */
+  std::size_t
+  compress_into(span<const std::byte> in,
+                span<std::byte> out)
+  {
+    reset();
+    auto in_end = reinterpret_cast<const Bytef*>(in.data()) + in.size();
+    auto out_end = reinterpret_cast<Bytef*>(out.data()) + out.size();
+    strm->next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(in.data()));
+    strm->next_out = reinterpret_cast<Bytef*>(out.data());
+    for (;;)
+    {
+      feed(in_end, out_end);
+      int ret = deflate(strm, strm->next_in + strm->avail_in == in_end ?
+                              Z_FINISH : Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+        break;
+      if (ret == Z_STREAM_ERROR)
+        throw error(ret, strm->msg);
+      if (strm->next_out == out_end)
+        throw error(Z_BUF_ERROR, "compressed data does not fit");
+    }
+    return std::size_t(strm->next_out - reinterpret_cast<Bytef*>(out.data()));
+  }
+
+  /**
+   *  @brief  Compress a complete message into a new vector.
+   *  @param  in  Data to compress.
+   *  @return  Compressed data, allocated from the memory resource.
+   *
+   *  The vector is sized with bound(), then trimmed.
+  */
+  std::pmr::vector<std::byte>
+  compress(span<const std::byte> in)
+  {
+    std::pmr::vector<std::byte> out(bound(in.size()), mr);
+    out.resize(compress_into(in, out));
+    return out;
+  }
+
+private:
+  void
+  end() noexcept
+  {
+    if (strm)
+      deflateEnd(strm);
+    release();
+  }
+};
+
+/*****************************************************************************/
+
+/**
+ *  @brief  Inflate stream owner.
+ *
+ *  Construct once, then decompress any number of messages with
+ *  decompress_into(), each of which starts with inflateReset(). get() gives
+ *  the z_stream for streaming with inflate(), and reset() starts over.
+*/
+class inflater : public detail::stream
+{
+public:
+  /**
+   *  @brief  Initialize inflate.
+   *  @param  window_bits  As for inflateInit2 (default detects zlib or gzip).
+   *  @param  mr  Memory resource for zlib's state.
+   *
+   *  Throws std::bad_alloc if out of memory, or zlib::error for invalid
+   *  parameters.
+  */
+  explicit
+  inflater(int window_bits = 15 + 32,
+           std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+  : detail::stream(mr)
+  {
+    check_init(inflateInit2(strm, window_bits));
+  }
+
+  inflater(inflater&&) noexcept = default;
+
+  inflater&
+  operator=(inflater&& other) noexcept
+  {
+    if (this != &other)
+    {
+      end();
+      mr = other.mr;
+      strm = std::exchange(other.strm, nullptr);
+    }
+    return *this;
+  }
+
+  ~inflater() { end(); }
+
+  /**
+   *  @brief  Start a new stream with the same parameters.
+   *  @return  inflateReset() return code.
+  */
+  int
+  reset() noexcept { return inflateReset(strm); }
+
+  /**
+   *  @brief  Decompress a complete message.
+   *  @param  in  Compressed data, which may be followed by other data.
+   *  @param  out  Space for decompressed data.
+   *  @return  Number of bytes written to @a out.
+   *
+   *  Throws zlib::error with Z_DATA_ERROR or Z_NEED_DICT if the data is
+   *  invalid or needs a dictionary, or with Z_BUF_ERROR if @a in ends
+   *  early or @a out is too small. get().avail_in is left with the
+   *  number of bytes after the stream, for sizes up to UINT_MAX.
+  */
+  std::size_t
+  decompress_into(span<const std::byte> in,
+                  span<std::byte> out)
+  {
+    reset();
+    auto in_end = reinterpret_cast<const Bytef*>(in.data()) + in.size();
+    auto out_end = reinterpret_cast<Bytef*>(out.data()) + out.size();
+    strm->next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(in.data()));
+    strm->next_out = reinterpret_cast<Bytef*>(out.data());
+    for (;;)
+    {
+      feed(in_end, out_end);
+      int ret = inflate(strm, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+        break;
+      if (ret == Z_BUF_ERROR)
+        throw error(ret, strm->next_out == out_end ?
+                         "decompressed data does not fit" :
+                         "compressed data ends early");
+      if (ret != Z_OK)
+        throw error(ret, strm->msg);
+    }
+    return std::size_t(strm->next_out - reinterpret_cast<Bytef*>(out.data()));
+  }
+
+private:
+  void
+  end() noexcept
+  {
+    if (strm)
+      inflateEnd(strm);
+    release();
+  }
+};
+
+}
+
+#endif // ZCODEC_H
@@ -10,11 +10,15 @@
 #include "zfstream.h"
 #include <cstring>          // for strcpy, strcat, strlen (mode strings)
 #include <cstdio>           // for BUFSIZ
+#include <algorithm>        // for min
 
 // Internal buffer sizes (default and "unbuffered" versions)
-#define BIGBUFSIZE BUFSIZ
+#define BIGBUFSIZE 65536
 #define SMALLBUFSIZE 1
 
+// Largest single gzread/gzwrite, which return an int
+#define MAXIOSIZE (1 << 30)
+
 /*****************************************************************************/
 
 // Default constructor
@@ -66,6 +70,9 @@ gzfilebuf::open(const char *name,
   // Attempt to open file
   if ((file = gzopen(name, char_mode)) == NULL)
     return NULL;
+  // Let zlib buffer as much as the stream buffer if that is larger
+  if (buffer_size > BUFSIZ)
+    gzbuffer(file, unsigned(buffer_size));
 
   // On success, allocate internal buffer and set flags
   this->enable_buffer();
@@ -94,6 +101,9 @@ gzfilebuf::attach(int fd,
   // Attempt to attach to file
   if ((file = gzdopen(fd, char_mode)) == NULL)
     return NULL;
+  // Let zlib buffer as much as the stream buffer if that is larger
+  if (buffer_size > BUFSIZ)
+    gzbuffer(file, unsigned(buffer_size));
 
   // On success, allocate internal buffer and set flags
   this->enable_buffer();
@@ -124,6 +134,22 @@ gzfilebuf::close()
   return retval;
 }
 
+// Set size of internal buffer
+gzfilebuf*
+gzfilebuf::setbufsize(std::streamsize n)
+{
+  // Buffer size must be settled before file is opened
+  if (this->is_open() || n <= 0 || n > MAXIOSIZE)
+    return NULL;
+  // Replace existing buffer (if any) with internal buffer of new size,
+  // which is allocated when the file is opened
+  this->disable_buffer();
+  buffer = NULL;
+  buffer_size = n;
+  own_buffer = true;
+  return this;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 // Convert int open mode to mode string
@@ -209,6 +235,44 @@ gzfilebuf::underflow()
   return traits_type::to_int_type(*(this->gptr()));
 }
 
+// Read sequence of characters, with large reads bypassing the get area
+std::streamsize
+gzfilebuf::xsgetn(char_type* s,
+                  std::streamsize n)
+{
+  // Take what is already in the get area first
+  std::streamsize total = 0;
+  if (this->gptr() && (this->gptr() < this->egptr()))
+  {
+    total = std::min(n, std::streamsize(this->egptr() - this->gptr()));
+    traits_type::copy(s, this->gptr(), total);
+    this->gbump(int(total));
+  }
+  // Leave a small remainder to underflow, which reads ahead into the buffer
+  if (n - total < buffer_size)
+    return total + std::streambuf::xsgetn(s + total, n - total);
+
+  // If the file hasn't been opened for reading, nothing more can be read
+  if (!this->is_open() || !(io_mode & std::ios_base::in))
+    return total;
+  // Read the rest from gzipped file straight into s
+  while (total < n)
+  {
+    int bytes_to_read = int(std::min(n - total, std::streamsize(MAXIOSIZE)));
+    int bytes_read = gzread(file, s + total, bytes_to_read);
+    // Indicates error or EOF
+    if (bytes_read <= 0)
+      break;
+    total += bytes_read;
+    // A short read means EOF
+    if (bytes_read < bytes_to_read)
+      break;
+  }
+  // Get area is now empty
+  this->setg(buffer, buffer, buffer);
+  return total;
+}
+
 // Write put area to gzipped file
 gzfilebuf::int_type
 gzfilebuf::overflow(int_type c)
@@ -261,6 +325,37 @@ gzfilebuf::overflow(int_type c)
     return c;
 }
 
+// Write sequence of characters, with large writes bypassing the put area
+std::streamsize
+gzfilebuf::xsputn(const char_type* s,
+                  std::streamsize n)
+{
+  // Add a small sequence to the put area, which overflow writes when full
+  if (n < buffer_size)
+    return std::streambuf::xsputn(s, n);
+
+  // If the file hasn't been opened for writing, produce error
+  if (!this->is_open() || !(io_mode & std::ios_base::out))
+    return 0;
+  // Write what is in the put area first to keep the order
+  if (traits_type::eq_int_type(this->overflow(), traits_type::eof()))
+    return 0;
+  // Write the sequence from s straight to gzipped file
+  std::streamsize total = 0;
+  while (total < n)
+  {
+    int bytes_to_write = int(std::min(n - total, std::streamsize(MAXIOSIZE)));
+    // If gzipped file won't accept all bytes written to it, stop
+    int bytes_written = gzwrite(file, s + total, unsigned(bytes_to_write));
+    if (bytes_written <= 0)
+      break;
+    total += bytes_written;
+    if (bytes_written < bytes_to_write)
+      break;
+  }
+  return total;
+}
+
 // Assign new buffer
 std::streambuf*
 gzfilebuf::setbuf(char_type* p,
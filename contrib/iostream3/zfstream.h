@@ -83,6 +83,19 @@ public:
   gzfilebuf*
   close();
 
+  /**
+   *  @brief  Set size of internal stream buffer.
+   *  @param  n  Buffer size in bytes.
+   *  @return  @c this on success, NULL if file is open or size is invalid.
+   *
+   *  This replaces any external buffer installed by setbuf. Buffers
+   *  larger than BUFSIZ also set the size of zlib's own buffers with
+   *  gzbuffer() when the file is opened, so this must be called before
+   *  open or attach.
+  */
+  gzfilebuf*
+  setbufsize(std::streamsize n);
+
 protected:
   /**
    *  @brief  Convert ios open mode int to mode string used by zlib.
@@ -112,6 +125,20 @@ protected:
   virtual int_type
   underflow();
 
+  /**
+   *  @brief  Read a sequence of characters from stream buffer.
+   *  @param  s  Destination array.
+   *  @param  n  Number of characters to read.
+   *  @return  Number of characters read.
+   *
+   *  Characters in the get area are copied first. A remainder of at
+   *  least the buffer size is read by gzread straight into @a s,
+   *  bypassing the get area, otherwise it is read through underflow.
+  */
+  virtual std::streamsize
+  xsgetn(char_type* s,
+         std::streamsize n);
+
   /**
    *  @brief  Write put area to gzipped file.
    *  @param  c  Extra character to add to buffer contents.
@@ -124,6 +151,20 @@ protected:
   virtual int_type
   overflow(int_type c = traits_type::eof());
 
+  /**
+   *  @brief  Write a sequence of characters to stream buffer.
+   *  @param  s  Source array.
+   *  @param  n  Number of characters to write.
+   *  @return  Number of characters written.
+   *
+   *  A sequence of at least the buffer size is written by gzwrite
+   *  straight from @a s after flushing the put area, otherwise it is
+   *  added to the put area as usual.
+  */
+  virtual std::streamsize
+  xsputn(const char_type* s,
+         std::streamsize n);
+
   /**
    *  @brief  Installs external stream buffer.
    *  @param  p  Pointer to char buffer.
@@ -209,8 +250,8 @@ private:
   /**
    *  @brief  Stream buffer size.
    *
-   *  Defaults to system default buffer size (typically 8192 bytes).
-   *  Modified by setbuf.
+   *  Defaults to 64K, which is also used for zlib's own buffers.
+   *  Modified by setbuf and setbufsize.
   */
   std::streamsize buffer_size;
 
@@ -0,0 +1,369 @@
+/*
+ * A C++ stream buffer that compresses to or decompresses from memory
+ *
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "zstreambuf.h"
+#include <algorithm>        // for min
+#include <climits>          // for UINT_MAX
+#include <new>              // for placement new
+
+namespace
+{
+  // zfree is not told the size of a block, which deallocate needs, so each
+  // block from zalloc starts with its size, padded to keep the alignment
+  constexpr std::size_t align = alignof(std::max_align_t);
+  constexpr std::size_t header = align;
+  static_assert(header >= sizeof(std::size_t), "no room for block size");
+
+  // Allocate for zlib from memory resource in opaque
+  voidpf
+  pmr_alloc(voidpf opaque,
+            uInt items,
+            uInt size)
+  {
+    auto mr = static_cast<std::pmr::memory_resource*>(opaque);
+    std::size_t n = header + std::size_t(items) * size;
+    try
+    {
+      auto p = static_cast<char*>(mr->allocate(n, align));
+      *reinterpret_cast<std::size_t*>(p) = n;
+      return p + header;
+    }
+    catch (...)
+    {
+      return Z_NULL;
+    }
+  }
+
+  // Return block from pmr_alloc to memory resource in opaque
+  void
+  pmr_free(voidpf opaque,
+           voidpf address)
+  {
+    auto mr = static_cast<std::pmr::memory_resource*>(opaque);
+    char* p = static_cast<char*>(address) - header;
+    mr->deallocate(p, *reinterpret_cast<std::size_t*>(p), align);
+  }
+
+  // Largest piece of a span that zlib can take at once
+  uInt
+  piece(std::size_t n)
+  { return n > UINT_MAX ? UINT_MAX : uInt(n); }
+}
+
+/*****************************************************************************/
+
+// Default constructor
+zstreambuf::zstreambuf() noexcept
+: mr(std::pmr::get_default_resource()), strm(nullptr), deflating(false),
+  state(Z_STREAM_ERROR), buffer(nullptr), buffer_size(0),
+  in_next(nullptr), in_left(0),
+  out_begin(nullptr), out_next(nullptr), out_left(0)
+{ }
+
+// Make decompressing buffer
+zstreambuf
+zstreambuf::decompress(std::span<const std::byte> in,
+                       int window_bits,
+                       std::pmr::memory_resource* mr,
+                       std::size_t buffer_size)
+{
+  zstreambuf sb;
+  sb.mr = mr;
+  sb.in_next = in.data();
+  sb.in_left = in.size();
+  sb.open(false, 0, window_bits, buffer_size);
+  return sb;
+}
+
+// Make compressing buffer
+zstreambuf
+zstreambuf::compress(std::span<std::byte> out,
+                     int level,
+                     int window_bits,
+                     std::pmr::memory_resource* mr,
+                     std::size_t buffer_size)
+{
+  zstreambuf sb;
+  sb.mr = mr;
+  sb.out_begin = sb.out_next = out.data();
+  sb.out_left = out.size();
+  sb.open(true, level, window_bits, buffer_size);
+  return sb;
+}
+
+// Move constructor takes the stream, buffer and buffer pointers
+zstreambuf::zstreambuf(zstreambuf&& other) noexcept
+: std::streambuf(other), mr(other.mr), strm(other.strm),
+  deflating(other.deflating), state(other.state),
+  buffer(other.buffer), buffer_size(other.buffer_size),
+  in_next(other.in_next), in_left(other.in_left),
+  out_begin(other.out_begin), out_next(other.out_next),
+  out_left(other.out_left)
+{
+  other.strm = nullptr;
+  other.buffer = nullptr;
+  other.state = Z_STREAM_ERROR;
+  other.setg(nullptr, nullptr, nullptr);
+  other.setp(nullptr, nullptr);
+}
+
+// Move assignment
+zstreambuf&
+zstreambuf::operator=(zstreambuf&& other) noexcept
+{
+  if (this != &other)
+  {
+    this->close();
+    std::streambuf::operator=(other);
+    mr = other.mr;
+    strm = other.strm;
+    deflating = other.deflating;
+    state = other.state;
+    buffer = other.buffer;
+    buffer_size = other.buffer_size;
+    in_next = other.in_next;
+    in_left = other.in_left;
+    out_begin = other.out_begin;
+    out_next = other.out_next;
+    out_left = other.out_left;
+    other.strm = nullptr;
+    other.buffer = nullptr;
+    other.state = Z_STREAM_ERROR;
+    other.setg(nullptr, nullptr, nullptr);
+    other.setp(nullptr, nullptr);
+  }
+  return *this;
+}
+
+// Destructor
+zstreambuf::~zstreambuf()
+{
+  this->close();
+}
+
+// Finish compressed stream
+bool
+zstreambuf::finish()
+{
+  if (!strm || !deflating)
+    return false;
+  if (state == Z_OK)
+  {
+    this->push(this->pbase(), this->pptr() - this->pbase(), Z_FINISH);
+    this->setp(buffer, buffer + buffer_size);
+  }
+  return state == Z_STREAM_END;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Fill get area by decompressing
+zstreambuf::int_type
+zstreambuf::underflow()
+{
+  // Return what is left in the get area, if anything
+  if (this->gptr() && (this->gptr() < this->egptr()))
+    return traits_type::to_int_type(*(this->gptr()));
+
+  // Produce EOF if not decompressing, or at end
+  if (!strm || deflating)
+    return traits_type::eof();
+  std::size_t got = this->pull(buffer, buffer_size);
+  this->setg(buffer, buffer, buffer + got);
+  if (got == 0)
+    return traits_type::eof();
+  return traits_type::to_int_type(*(this->gptr()));
+}
+
+// Read sequence of characters, with large reads bypassing the get area
+std::streamsize
+zstreambuf::xsgetn(char_type* s,
+                   std::streamsize n)
+{
+  // Take what is already in the get area first
+  std::streamsize total = 0;
+  if (this->gptr() && (this->gptr() < this->egptr()))
+  {
+    total = std::min(n, std::streamsize(this->egptr() - this->gptr()));
+    traits_type::copy(s, this->gptr(), total);
+    this->gbump(int(total));
+  }
+  // Leave a small remainder to underflow, which decompresses ahead
+  if (!strm || deflating || std::size_t(n - total) < buffer_size)
+    return total + std::streambuf::xsgetn(s + total, n - total);
+  return total + std::streamsize(this->pull(s + total, n - total));
+}
+
+// Compress put area into output span
+zstreambuf::int_type
+zstreambuf::overflow(int_type c)
+{
+  if (!strm || !deflating || state != Z_OK)
+    return traits_type::eof();
+  if (!this->push(this->pbase(), this->pptr() - this->pbase(), Z_NO_FLUSH))
+    return traits_type::eof();
+  this->setp(buffer, buffer + buffer_size);
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  *(this->pptr()) = traits_type::to_char_type(c);
+  this->pbump(1);
+  return c;
+}
+
+// Write sequence of characters, with large writes bypassing the put area
+std::streamsize
+zstreambuf::xsputn(const char_type* s,
+                   std::streamsize n)
+{
+  // Add a small sequence to the put area, which overflow compresses when full
+  if (!strm || !deflating || std::size_t(n) < buffer_size)
+    return std::streambuf::xsputn(s, n);
+
+  // Compress the put area first to keep the order, then s
+  if (traits_type::eq_int_type(this->overflow(), traits_type::eof()))
+    return 0;
+  uLong before = strm->total_in;
+  this->push(s, n, Z_NO_FLUSH);
+  return std::streamsize(strm->total_in - before);
+}
+
+// Compress put area
+int
+zstreambuf::sync()
+{
+  if (!strm || !deflating)
+    return 0;
+  return traits_type::eq_int_type(this->overflow(), traits_type::eof()) ? -1 : 0;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Allocate stream and buffer and initialize zlib
+int
+zstreambuf::open(bool deflate,
+                 int level,
+                 int window_bits,
+                 std::size_t size)
+{
+  deflating = deflate;
+  buffer_size = size ? size : 1;
+  buffer = static_cast<char_type*>(mr->allocate(buffer_size, 1));
+  strm = new (mr->allocate(sizeof(z_stream), alignof(z_stream))) z_stream();
+  strm->zalloc = pmr_alloc;
+  strm->zfree = pmr_free;
+  strm->opaque = mr;
+  if (deflating)
+  {
+    state = deflateInit2(strm, level, Z_DEFLATED, window_bits, 8,
+                         Z_DEFAULT_STRATEGY);
+    this->setp(buffer, buffer + buffer_size);
+  }
+  else
+  {
+    state = inflateInit2(strm, window_bits);
+    this->setg(buffer, buffer, buffer);
+  }
+  // Without an initialized stream, only the memory needs to be released
+  if (state != Z_OK)
+  {
+    mr->deallocate(strm, sizeof(z_stream), alignof(z_stream));
+    strm = nullptr;
+  }
+  return state;
+}
+
+// End zlib stream and free stream and buffer
+void
+zstreambuf::close() noexcept
+{
+  if (strm)
+  {
+    if (deflating)
+      deflateEnd(strm);
+    else
+      inflateEnd(strm);
+    mr->deallocate(strm, sizeof(z_stream), alignof(z_stream));
+    strm = nullptr;
+  }
+  if (buffer)
+  {
+    mr->deallocate(buffer, buffer_size, 1);
+    buffer = nullptr;
+  }
+  this->setg(nullptr, nullptr, nullptr);
+  this->setp(nullptr, nullptr);
+}
+
+// Decompress into s[0..n-1]
+std::size_t
+zstreambuf::pull(char_type* s,
+                 std::size_t n)
+{
+  std::size_t total = 0;
+  while (total < n && state == Z_OK)
+  {
+    // Give zlib the next piece of the input span when it needs it
+    if (strm->avail_in == 0)
+    {
+      strm->next_in =
+        reinterpret_cast<Bytef*>(const_cast<std::byte*>(in_next));
+      strm->avail_in = piece(in_left);
+      in_next += strm->avail_in;
+      in_left -= strm->avail_in;
+    }
+    uInt want = piece(n - total);
+    strm->next_out = reinterpret_cast<Bytef*>(s + total);
+    strm->avail_out = want;
+    int ret = inflate(strm, Z_NO_FLUSH);
+    total += want - strm->avail_out;
+    // Stop at the end, or on error, which is Z_BUF_ERROR if the input ended
+    if (ret != Z_OK)
+      state = ret;
+  }
+  return total;
+}
+
+// Compress s[0..n-1] into the output span with flush
+bool
+zstreambuf::push(const char_type* s,
+                 std::size_t n,
+                 int flush)
+{
+  strm->next_in = reinterpret_cast<Bytef*>(const_cast<char_type*>(s));
+  for (;;)
+  {
+    // Give zlib the next pieces of the input and output
+    uInt have = piece(n);
+    strm->avail_in = have;
+    strm->next_out = reinterpret_cast<Bytef*>(out_next);
+    strm->avail_out = piece(out_left);
+    uInt room = strm->avail_out;
+    int ret = deflate(strm, n > have ? Z_NO_FLUSH : flush);
+    n -= have - strm->avail_in;
+    out_next += room - strm->avail_out;
+    out_left -= room - strm->avail_out;
+    if (ret == Z_STREAM_END)
+    {
+      state = ret;
+      return true;
+    }
+    if (ret == Z_STREAM_ERROR)
+    {
+      state = ret;
+      return false;
+    }
+    // Done if all of s was taken, and there was room for what deflate had
+    if (n == 0 && flush == Z_NO_FLUSH && (strm->avail_out || !out_left))
+      return true;
+    // Fail if out of room for the output
+    if (strm->avail_out == 0 && out_left == 0)
+    {
+      state = Z_BUF_ERROR;
+      return false;
+    }
+  }
+}
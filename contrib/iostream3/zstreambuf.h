@@ -0,0 +1,254 @@
+/*
+ * A C++ stream buffer that compresses to or decompresses from memory
+ *
+ * This needs C++20 for std::span, and uses the std::pmr memory resource
+ * of the caller for everything, including zlib's own allocations.
+ *
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ZSTREAMBUF_H
+#define ZSTREAMBUF_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <streambuf>
+#include "zlib.h"
+
+/*****************************************************************************/
+
+/**
+ *  @brief  In-memory compressing/decompressing stream buffer class.
+ *
+ *  A decompressing buffer reads compressed data from a span and delivers the
+ *  uncompressed data to whatever reads from it, such as an istream. A
+ *  compressing buffer takes what is written to it, such as by an ostream,
+ *  and compresses it into a span provided by the caller. Either way the
+ *  z_stream is driven directly, with no gzFile and no temporary files, and
+ *  large reads and writes bypass the internal buffer. The object owns its
+ *  z_stream and can be moved but not copied.
+*/
+class zstreambuf : public std::streambuf
+{
+public:
+  /**
+   *  Default internal buffer size.
+  */
+  static constexpr std::size_t default_buffer_size = 16384;
+
+  //  Default constructor, with no stream.
+  zstreambuf() noexcept;
+
+  /**
+   *  @brief  Make buffer that decompresses a span.
+   *  @param  in  Compressed data, which must outlive the buffer.
+   *  @param  window_bits  As for inflateInit2 (default detects zlib or gzip).
+   *  @param  mr  Memory resource for the buffer and zlib's state.
+   *  @param  buffer_size  Size of internal get buffer.
+   *  @return  Stream buffer, with status() Z_OK on success.
+  */
+  static zstreambuf
+  decompress(std::span<const std::byte> in,
+             int window_bits = 15 + 32,
+             std::pmr::memory_resource* mr = std::pmr::get_default_resource(),
+             std::size_t buffer_size = default_buffer_size);
+
+  /**
+   *  @brief  Make buffer that compresses into a span.
+   *  @param  out  Space for compressed data, which must outlive the buffer.
+   *  @param  level  Compression level (see zlib.h for allowed values).
+   *  @param  window_bits  As for deflateInit2 (default writes gzip).
+   *  @param  mr  Memory resource for the buffer and zlib's state.
+   *  @param  buffer_size  Size of internal put buffer.
+   *  @return  Stream buffer, with status() Z_OK on success.
+   *
+   *  Writes fail once @a out is full. deflateBound gives a size that
+   *  always suffices when the amount of data is known in advance.
+  */
+  static zstreambuf
+  compress(std::span<std::byte> out,
+           int level = Z_DEFAULT_COMPRESSION,
+           int window_bits = 15 + 16,
+           std::pmr::memory_resource* mr = std::pmr::get_default_resource(),
+           std::size_t buffer_size = default_buffer_size);
+
+  //  Move constructor, leaving @a other with no stream.
+  zstreambuf(zstreambuf&& other) noexcept;
+
+  //  Move assignment, leaving @a other with no stream.
+  zstreambuf&
+  operator=(zstreambuf&& other) noexcept;
+
+  zstreambuf(const zstreambuf&) = delete;
+  zstreambuf&
+  operator=(const zstreambuf&) = delete;
+
+  //  Destructor. Does not finish a compressed stream.
+  virtual
+  ~zstreambuf();
+
+  /**
+   *  @brief  Finish compressed stream.
+   *  @return  True if the complete stream fit in the output span.
+  */
+  bool
+  finish();
+
+  /**
+   *  @brief  Compressed data written so far.
+   *  @return  Leading part of the output span, empty when decompressing.
+  */
+  std::span<std::byte>
+  output() const noexcept
+  { return std::span<std::byte>(out_begin, out_next); }
+
+  /**
+   *  @brief  Compressed data not yet used.
+   *  @return  Number of bytes left in the input span after the end of the
+   *           compressed stream, or not yet read by inflate.
+  */
+  std::size_t
+  remaining() const noexcept
+  { return strm ? in_left + strm->avail_in : 0; }
+
+  /**
+   *  @brief  Stream state.
+   *  @return  Z_OK while in progress, Z_STREAM_END when the stream is
+   *           complete, Z_NEED_DICT, Z_BUF_ERROR if the input ended early
+   *           or the output span is full, or another zlib error code.
+  */
+  int
+  status() const noexcept { return state; }
+
+protected:
+  /**
+   *  @brief  Fill get area by decompressing.
+   *  @return  First character in get area on success, EOF at end or error.
+  */
+  virtual int_type
+  underflow();
+
+  /**
+   *  @brief  Read a sequence of characters from stream buffer.
+   *  @param  s  Destination array.
+   *  @param  n  Number of characters to read.
+   *  @return  Number of characters read.
+   *
+   *  A remainder of at least the buffer size after the get area is
+   *  decompressed straight into @a s.
+  */
+  virtual std::streamsize
+  xsgetn(char_type* s,
+         std::streamsize n);
+
+  /**
+   *  @brief  Compress put area into output span.
+   *  @param  c  Extra character to add to buffer contents.
+   *  @return  Non-EOF on success, EOF on error.
+  */
+  virtual int_type
+  overflow(int_type c = traits_type::eof());
+
+  /**
+   *  @brief  Write a sequence of characters to stream buffer.
+   *  @param  s  Source array.
+   *  @param  n  Number of characters to write.
+   *  @return  Number of characters written.
+   *
+   *  A sequence of at least the buffer size is compressed straight from
+   *  @a s after the put area.
+  */
+  virtual std::streamsize
+  xsputn(const char_type* s,
+         std::streamsize n);
+
+  /**
+   *  @brief  Compress put area.
+   *  @return  0 on success, -1 on error.
+   *
+   *  This does not flush deflate, so that std::endl stays cheap. The
+   *  output is only complete after finish().
+  */
+  virtual int
+  sync();
+
+private:
+  /**
+   *  @brief  Allocate stream and buffer and initialize zlib.
+   *  @return  zlib return code.
+  */
+  int
+  open(bool deflating,
+       int level,
+       int window_bits,
+       std::size_t size);
+
+  /**
+   *  @brief  End zlib stream and free stream and buffer.
+  */
+  void
+  close() noexcept;
+
+  /**
+   *  @brief  Decompress into s[0..n-1].
+   *  @return  Number of characters decompressed.
+  */
+  std::size_t
+  pull(char_type* s,
+       std::size_t n);
+
+  /**
+   *  @brief  Compress s[0..n-1] with flush.
+   *  @return  True if all of it was taken and the output fit.
+  */
+  bool
+  push(const char_type* s,
+       std::size_t n,
+       int flush);
+
+  /**
+   *  Memory resource for everything allocated.
+  */
+  std::pmr::memory_resource* mr;
+
+  /**
+   *  @brief  Underlying zlib stream.
+   *
+   *  zlib's state points back to the z_stream, so it lives on the free
+   *  store where moving this object doesn't change its address.
+  */
+  z_stream* strm;
+
+  /**
+   *  True if compressing.
+  */
+  bool deflating;
+
+  /**
+   *  Last zlib status, see status().
+  */
+  int state;
+
+  /**
+   *  Stream buffer and its size.
+  */
+  char_type* buffer;
+  std::size_t buffer_size;
+
+  /**
+   *  Input span not yet given to zlib.
+  */
+  const std::byte* in_next;
+  std::size_t in_left;
+
+  /**
+   *  Output span, and the part of it not yet given to zlib.
+  */
+  std::byte* out_begin;
+  std::byte* out_next;
+  std::size_t out_left;
+};
+
+#endif // ZSTREAMBUF_H
@@ -28,6 +28,19 @@
 
 #include "ioapi.h"
 
+/* map archives opened for reading with fill_mmap_filefunc64() on systems with
+   mmap() */
+#if !defined(NO_MMAP) && !defined(_WIN32) && \
+    (defined(__unix__) || defined(__unix) || defined(__APPLE__))
+#  define IOAPI_MMAP
+#  include <string.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 voidpf call_zopen64 (const zlib_filefunc64_32_def* pfilefunc, const void*filename, int mode) {
     if (pfilefunc->zfile_func64.zopen64_file != NULL)
         return (*(pfilefunc->zfile_func64.zopen64_file)) (pfilefunc->zfile_func64.opaque,filename,mode);
@@ -50,6 +63,31 @@ long call_zseek64 (const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZP
     }
 }
 
+#ifdef IOAPI_MMAP
+/* a read-only archive mapped in memory, the stream for the mmap functions */
+typedef struct {
+    const unsigned char* base;  /* mapped file, or NULL if empty */
+    ZPOS64_T size;              /* length of the file */
+    ZPOS64_T pos;               /* current position, may be past size */
+} mmap_file;
+
+static voidpf ZCALLBACK mmap_open64_file_func(voidpf opaque, const void* filename, int mode);
+#endif
+
+const void* call_zmap64(const zlib_filefunc64_32_def* pfilefunc, voidpf filestream, ZPOS64_T* size) {
+#ifdef IOAPI_MMAP
+    if (pfilefunc->zfile_func64.zopen64_file == mmap_open64_file_func) {
+        *size = ((mmap_file*)filestream)->size;
+        return ((mmap_file*)filestream)->base;
+    }
+#else
+    (void)filestream;
+#endif
+    (void)pfilefunc;
+    *size = 0;
+    return NULL;
+}
+
 ZPOS64_T call_ztell64 (const zlib_filefunc64_32_def* pfilefunc, voidpf filestream) {
     if (pfilefunc->zfile_func64.zseek64_file != NULL)
         return (*(pfilefunc->zfile_func64.ztell64_file)) (pfilefunc->zfile_func64.opaque,filestream);
@@ -229,3 +267,119 @@ void fill_fopen64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def) {
     pzlib_filefunc_def->zerror_file = ferror_file_func;
     pzlib_filefunc_def->opaque = NULL;
 }
+
+#ifdef IOAPI_MMAP
+static voidpf ZCALLBACK mmap_open64_file_func(voidpf opaque, const void* filename, int mode) {
+    mmap_file* file;
+    struct stat st;
+    void* base = NULL;
+    int fd;
+    (void)opaque;
+    if (filename == NULL ||
+        (mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ)
+        return NULL;
+    fd = open((const char*)filename, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        (off_t)(size_t)st.st_size != st.st_size) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size != 0) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+    }
+    close(fd);
+    file = (mmap_file*)malloc(sizeof(mmap_file));
+    if (file == NULL) {
+        if (base != NULL)
+            munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    file->base = (const unsigned char*)base;
+    file->size = (ZPOS64_T)st.st_size;
+    file->pos = 0;
+    return file;
+}
+
+static uLong ZCALLBACK mmap_read_file_func(voidpf opaque, voidpf stream, void* buf, uLong size) {
+    mmap_file* file = (mmap_file*)stream;
+    (void)opaque;
+    if (file->pos >= file->size)
+        return 0;
+    if (size > file->size - file->pos)
+        size = (uLong)(file->size - file->pos);
+    memcpy(buf, file->base + file->pos, (size_t)size);
+    file->pos += size;
+    return size;
+}
+
+static uLong ZCALLBACK mmap_write_file_func(voidpf opaque, voidpf stream, const void* buf, uLong size) {
+    (void)opaque;
+    (void)stream;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+static ZPOS64_T ZCALLBACK mmap_tell64_file_func(voidpf opaque, voidpf stream) {
+    (void)opaque;
+    return ((mmap_file*)stream)->pos;
+}
+
+static long ZCALLBACK mmap_seek64_file_func(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin) {
+    mmap_file* file = (mmap_file*)stream;
+    ZPOS64_T from;
+    (void)opaque;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        from = file->pos;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        from = file->size;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        from = 0;
+        break;
+    default: return -1;
+    }
+    /* offset is unsigned, so a negative one from CUR or END wraps around */
+    file->pos = from + offset;
+    return 0;
+}
+
+static int ZCALLBACK mmap_close_file_func(voidpf opaque, voidpf stream) {
+    mmap_file* file = (mmap_file*)stream;
+    (void)opaque;
+    if (file->base != NULL)
+        munmap((void*)file->base, (size_t)file->size);
+    free(file);
+    return 0;
+}
+
+static int ZCALLBACK mmap_error_file_func(voidpf opaque, voidpf stream) {
+    (void)opaque;
+    (void)stream;
+    return 0;
+}
+#endif
+
+void fill_mmap_filefunc64(zlib_filefunc64_def* pzlib_filefunc_def) {
+#ifdef IOAPI_MMAP
+    pzlib_filefunc_def->zopen64_file = mmap_open64_file_func;
+    pzlib_filefunc_def->zread_file = mmap_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mmap_write_file_func;
+    pzlib_filefunc_def->ztell64_file = mmap_tell64_file_func;
+    pzlib_filefunc_def->zseek64_file = mmap_seek64_file_func;
+    pzlib_filefunc_def->zclose_file = mmap_close_file_func;
+    pzlib_filefunc_def->zerror_file = mmap_error_file_func;
+    pzlib_filefunc_def->opaque = NULL;
+#else
+    fill_fopen64_filefunc(pzlib_filefunc_def);
+#endif
+}
\ No newline at end of file
@@ -149,6 +149,13 @@ typedef struct zlib_filefunc64_def_s
 void fill_fopen64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def);
 void fill_fopen_filefunc(zlib_filefunc_def* pzlib_filefunc_def);
 
+/* Like fill_fopen64_filefunc(), but archives can only be opened for reading,
+   and are mapped in memory with mmap(), so that reads are copies from the map
+   and unzGetCurrentFileData() can return a stored entry in place, without
+   reading it.  Where mmap() is not available, or if NO_MMAP is defined, this
+   is the same as fill_fopen64_filefunc(). */
+void fill_mmap_filefunc64(zlib_filefunc64_def* pzlib_filefunc_def);
+
 /* now internal definition, only for zip.c and unzip.h */
 typedef struct zlib_filefunc64_32_def_s
 {
@@ -169,6 +176,7 @@ typedef struct zlib_filefunc64_32_def_s
 voidpf call_zopen64(const zlib_filefunc64_32_def* pfilefunc,const void*filename,int mode);
 long call_zseek64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, int origin);
 ZPOS64_T call_ztell64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream);
+const void* call_zmap64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T* size);
 
 void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def* p_filefunc64_32,const zlib_filefunc_def* p_filefunc32);
 
@@ -69,6 +69,47 @@
 #define USEWIN32IOAPI
 #include "iowin32.h"
 #endif
+
+/* threads for -j, from Windows, or POSIX if HAVE_PTHREAD */
+#ifndef NO_THREADS
+#  if defined(_WIN32)
+#    include <windows.h>
+#    include <process.h>
+#    define MINIUNZ_THREADS
+     typedef CRITICAL_SECTION extract_mutex;
+     typedef HANDLE extract_thread;
+#    define extract_mutex_init(m) InitializeCriticalSection(m)
+#    define extract_mutex_free(m) DeleteCriticalSection(m)
+#    define extract_lock(m) EnterCriticalSection(m)
+#    define extract_unlock(m) LeaveCriticalSection(m)
+#    define EXTRACT_WORKER unsigned __stdcall
+#    define extract_start(t, run, arg) \
+        ((*(t) = (HANDLE)_beginthreadex(NULL, 0, run, arg, 0, NULL)) == 0)
+#    define extract_join(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#  elif defined(HAVE_PTHREAD)
+#    include <pthread.h>
+#    define MINIUNZ_THREADS
+     typedef pthread_mutex_t extract_mutex;
+     typedef pthread_t extract_thread;
+#    define extract_mutex_init(m) pthread_mutex_init(m, NULL)
+#    define extract_mutex_free(m) pthread_mutex_destroy(m)
+#    define extract_lock(m) pthread_mutex_lock(m)
+#    define extract_unlock(m) pthread_mutex_unlock(m)
+#    define EXTRACT_WORKER void *
+#    define extract_start(t, run, arg) pthread_create(t, NULL, run, arg)
+#    define extract_join(t) pthread_join(t, NULL)
+#  endif
+#endif
+
+#ifdef MINIUNZ_THREADS
+/* held while asking about overwriting, when extracting with threads */
+static extract_mutex *ask_lock = NULL;
+#  define ASK_LOCK() do { if (ask_lock) extract_lock(ask_lock); } while (0)
+#  define ASK_UNLOCK() do { if (ask_lock) extract_unlock(ask_lock); } while (0)
+#else
+#  define ASK_LOCK()
+#  define ASK_UNLOCK()
+#endif
 /*
   mini unzip, demo of unzip package
 
@@ -191,14 +232,15 @@ static void do_banner(void) {
 }
 
 static void do_help(void) {
-    printf("Usage : miniunz [-e] [-x] [-v] [-l] [-o] [-p password] file.zip [file_to_extr.] [-d extractdir]\n\n" \
+    printf("Usage : miniunz [-e] [-x] [-v] [-l] [-o] [-p password] [-j threads] file.zip [file_to_extr.] [-d extractdir]\n\n" \
            "  -e  Extract without pathname (junk paths)\n" \
            "  -x  Extract with pathname\n" \
            "  -v  list files\n" \
            "  -l  list files\n" \
            "  -d  directory to extract into\n" \
            "  -o  overwrite files without prompting\n" \
-           "  -p  extract encrypted file using password\n\n");
+           "  -p  extract encrypted file using password\n" \
+           "  -j  extract files using that many threads\n\n");
 }
 
 static void Display64BitsSize(ZPOS64_T n, int size_char) {
@@ -376,6 +418,7 @@ static int do_extract_currentfile(unzFile uf, const int* popt_extract_without_pa
             printf("error %d with zipfile in unzOpenCurrentFilePassword\n",err);
         }
 
+        ASK_LOCK();
         if (((*popt_overwrite)==0) && (err==UNZ_OK))
         {
             char rep=0;
@@ -408,6 +451,7 @@ static int do_extract_currentfile(unzFile uf, const int* popt_extract_without_pa
             if (rep == 'A')
                 *popt_overwrite=1;
         }
+        ASK_UNLOCK();
 
         if ((skip==0) && (err==UNZ_OK))
         {
@@ -505,6 +549,113 @@ static int do_extract(unzFile uf, int opt_extract_without_path, int opt_overwrit
     return 0;
 }
 
+#ifdef MINIUNZ_THREADS
+/* Files to extract, shared by the threads that extract them. */
+typedef struct {
+    ZPOS64_T next;              /* next file to extract */
+    ZPOS64_T count;             /* number of files */
+    int stop;                   /* true after an error */
+    int opt_extract_without_path;
+    int opt_overwrite;          /* shared, set by an answer of All */
+    const char* password;
+    extract_mutex lock;         /* protects next and stop */
+    extract_mutex ask;          /* for ask_lock */
+} extract_work;
+
+typedef struct {
+    extract_work* work;
+    unzFile uf;                 /* this thread's reader */
+} extract_job;
+
+/* Extract files with a reader of the zipfile until there are no more. */
+static EXTRACT_WORKER extract_worker(void* arg) {
+    extract_job* job = (extract_job*)arg;
+    extract_work* work = job->work;
+
+    for (;;) {
+        ZPOS64_T n;
+        int err;
+
+        extract_lock(&work->lock);
+        n = work->next++;
+        if (work->stop)
+            n = work->count;
+        extract_unlock(&work->lock);
+        if (n >= work->count)
+            break;
+
+        err = unzGoToFileNumber(job->uf, n);
+        if (err!=UNZ_OK)
+            printf("error %d with zipfile in unzGoToFileNumber\n",err);
+        else
+            err = do_extract_currentfile(job->uf,
+                                         &work->opt_extract_without_path,
+                                         &work->opt_overwrite,
+                                         work->password);
+        if (err!=UNZ_OK) {
+            extract_lock(&work->lock);
+            work->stop = 1;
+            extract_unlock(&work->lock);
+        }
+    }
+    return 0;
+}
+
+/* Extract all of the files in uf, opened from zipfilename, using threads
+   threads. Return -1 if they could not be started, to extract the files
+   without threads instead. */
+static int do_extract_threads(unzFile uf, const char* zipfilename, int threads, int opt_extract_without_path, int opt_overwrite, const char* password) {
+    unz_global_info64 gi;
+    extract_work work;
+    extract_job* job;
+    extract_thread* thread;
+    int started = 0, opened = 0;
+
+    if (unzGetGlobalInfo64(uf,&gi)!=UNZ_OK || unzIndex(uf)!=UNZ_OK)
+        return -1;
+    job = (extract_job*)malloc(threads * sizeof(extract_job));
+    thread = (extract_thread*)malloc(threads * sizeof(extract_thread));
+    if (job==NULL || thread==NULL) {
+        free(thread);
+        free(job);
+        return -1;
+    }
+
+    /* open a reader for each thread, sharing the index of uf */
+    while (opened < threads) {
+        job[opened].work = &work;
+        job[opened].uf = unzOpenReader(uf, zipfilename);
+        if (job[opened].uf == NULL)
+            break;
+        opened++;
+    }
+
+    work.next = 0;
+    work.count = gi.number_entry;
+    work.stop = 0;
+    work.opt_extract_without_path = opt_extract_without_path;
+    work.opt_overwrite = opt_overwrite;
+    work.password = password;
+    extract_mutex_init(&work.lock);
+    extract_mutex_init(&work.ask);
+    ask_lock = &work.ask;
+    while (started < opened &&
+           extract_start(thread + started, extract_worker, job + started) == 0)
+        started++;
+    while (started)
+        extract_join(thread[--started]);
+    ask_lock = NULL;
+    extract_mutex_free(&work.ask);
+    extract_mutex_free(&work.lock);
+
+    while (opened)
+        unzClose(job[--opened].uf);
+    free(thread);
+    free(job);
+    return work.next == 0 ? -1 : 0;
+}
+#endif
+
 static int do_extract_onefile(unzFile uf, const char* filename, int opt_extract_without_path, int opt_overwrite, const char* password) {
     if (unzLocateFile(uf,filename,CASESENSITIVITY)!=UNZ_OK)
     {
@@ -533,6 +684,7 @@ int main(int argc, char *argv[]) {
     int opt_do_extract_withoutpath=0;
     int opt_overwrite=0;
     int opt_extractdir=0;
+    int opt_threads=1;
     const char *dirname=NULL;
     unzFile uf=NULL;
 
@@ -574,6 +726,12 @@ int main(int argc, char *argv[]) {
                         password=argv[i+1];
                         i++;
                     }
+
+                    if (((c=='j') || (c=='J')) && (i+1<argc))
+                    {
+                        opt_threads=atoi(argv[i+1]);
+                        i++;
+                    }
                 }
             }
             else
@@ -635,6 +793,14 @@ int main(int argc, char *argv[]) {
           exit(-1);
         }
 
+#ifdef MINIUNZ_THREADS
+        if (filename_to_extract == NULL && opt_threads > 1 &&
+            do_extract_threads(uf, filename_try, opt_threads, opt_do_extract_withoutpath, opt_overwrite, password) == 0)
+            ret_value = 0;
+        else
+#else
+        (void)opt_threads;
+#endif
         if (filename_to_extract == NULL)
             ret_value = do_extract(uf, opt_do_extract_withoutpath, opt_overwrite, password);
         else
@@ -62,6 +62,8 @@
 #endif
 
 #include "zip.h"
+#include "unzip.h"
+#include "mztools.h"
 #include "ints.h"
 
 #ifdef _WIN32
@@ -72,6 +74,7 @@
 
 
 #define WRITEBUFFERSIZE (16384)
+#define MERGEBUFFERSIZE (1048576)   /* zip write buffer for -m */
 #define MAXFILENAME (256)
 
 #ifdef _WIN32
@@ -168,13 +171,65 @@ static void do_banner(void) {
 }
 
 static void do_help(void) {
-    printf("Usage : minizip [-o] [-a] [-0 to -9] [-p password] [-j] file.zip [files_to_add]\n\n" \
+    printf("Usage : minizip [-o] [-a] [-0 to -9] [-p password] [-j] [-m] file.zip [files_to_add]\n\n" \
            "  -o  Overwrite existing file.zip\n" \
            "  -a  Append to existing file.zip\n" \
            "  -0  Store only\n" \
            "  -1  Compress faster\n" \
            "  -9  Compress better\n\n" \
-           "  -j  exclude path. store only the file name.\n\n");
+           "  -j  exclude path. store only the file name.\n" \
+           "  -m  merge: files_to_add are zip files, whose entries are copied\n" \
+           "      without recompressing them.\n\n");
+}
+
+/* copy the entries of the zip file filename to zf, skipping names that are
+   already in zf */
+static int merge_zip(zipFile zf, const char* filename) {
+    zlib_filefunc64_def ffunc;
+    unzFile uf;
+    int err;
+    ZPOS64_T copied = 0;
+
+#ifdef USEWIN32IOAPI
+    fill_win32_filefunc64A(&ffunc);
+#else
+    fill_mmap_filefunc64(&ffunc);
+#endif
+    uf = unzOpen2_64(filename, &ffunc);
+    if (uf == NULL)
+    {
+        printf("error opening %s\n", filename);
+        return ZIP_ERRNO;
+    }
+
+    err = unzGoToFirstFile(uf);
+    while (err == UNZ_OK)
+    {
+        char name[MAXFILENAME];
+        err = unzGetCurrentFileInfo64(uf, NULL, name, sizeof(name),
+                                      NULL, 0, NULL, 0);
+        if (err != UNZ_OK)
+            break;
+        if (zipAlreadyThere(zf, name) > 0)
+            printf("  skipping duplicate %s\n", name);
+        else
+        {
+            err = zipCopyEntryFrom(zf, uf);
+            if (err != ZIP_OK)
+            {
+                printf("error %d in copying %s from %s\n", err, name,
+                       filename);
+                break;
+            }
+            copied++;
+        }
+        err = unzGoToNextFile(uf);
+    }
+    if (err == UNZ_END_OF_LIST_OF_FILE)
+        err = ZIP_OK;
+    unzClose(uf);
+    printf("merged %"PUI64" files from %s\n", copied, filename);
+    return err;
 }
 
 /* calculate the CRC32 of a file,
@@ -243,6 +298,7 @@ int main(int argc, char *argv[]) {
     int opt_overwrite=0;
     int opt_compress_level=Z_DEFAULT_COMPRESSION;
     int opt_exclude_path=0;
+    int opt_merge=0;
     int zipfilenamearg = 0;
     char filename_try[MAXFILENAME+16];
     int zipok;
@@ -277,6 +333,8 @@ int main(int argc, char *argv[]) {
                         opt_compress_level = c-'0';
                     if ((c=='j') || (c=='J'))
                         opt_exclude_path = 1;
+                    if ((c=='m') || (c=='M'))
+                        opt_merge = 1;
 
                     if (((c=='p') || (c=='P')) && (i+1<argc))
                     {
@@ -376,7 +434,11 @@ int main(int argc, char *argv[]) {
             err= ZIP_ERRNO;
         }
         else
+        {
             printf("creating %s\n",filename_try);
+            if (opt_merge)
+                zipSetBufferSize(zf, MERGEBUFFERSIZE);
+        }
 
         for (i=zipfilenamearg+1;(i<argc) && (err==ZIP_OK);i++)
         {
@@ -384,6 +446,7 @@ int main(int argc, char *argv[]) {
                   ((argv[i][1]=='o') || (argv[i][1]=='O') ||
                    (argv[i][1]=='a') || (argv[i][1]=='A') ||
                    (argv[i][1]=='p') || (argv[i][1]=='P') ||
+                   (argv[i][1]=='m') || (argv[i][1]=='M') ||
                    ((argv[i][1]>='0') && (argv[i][1]<='9'))) &&
                   (strlen(argv[i]) == 2)))
             {
@@ -395,6 +458,12 @@ int main(int argc, char *argv[]) {
                 unsigned long crcFile=0;
                 int zip64 = 0;
 
+                if (opt_merge)
+                {
+                    err = merge_zip(zf, argv[i]);
+                    continue;
+                }
+
                 zi.tmz_date.tm_sec = zi.tmz_date.tm_min = zi.tmz_date.tm_hour =
                 zi.tmz_date.tm_mday = zi.tmz_date.tm_mon = zi.tmz_date.tm_year = 0;
                 zi.dosDate = 0;
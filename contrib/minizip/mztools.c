@@ -13,10 +13,12 @@
 #include <string.h>
 #include "zlib.h"
 #include "unzip.h"
+#include "zip.h"
+#include "mztools.h"
 
 #define READ_8(adr)  ((unsigned char)*(adr))
 #define READ_16(adr) ( READ_8(adr) | (READ_8(adr+1) << 8) )
-#define READ_32(adr) ( READ_16(adr) | (READ_16((adr)+2) << 16) )
+#define READ_32(adr) ( (uLong)READ_16(adr) | ((uLong)READ_16((adr)+2) << 16) )
 
 #define WRITE_8(buff, n) do { \
   *((unsigned char*)(buff)) = (unsigned char) ((n) & 0xff); \
@@ -30,259 +32,503 @@
   WRITE_16((unsigned char*)(buff) + 2, (n) >> 16); \
 } while(0)
 
-extern int ZEXPORT unzRepair(const char* file, const char* fileOut, const char* fileOutTmp, uLong* nRecovered, uLong* bytesRecovered) {
+/* size of the reads and writes of unzRepair64() */
+#define REPAIR_BUFSIZE (1024*1024)
+
+#define READ_64(adr) \
+  ((ZPOS64_T)READ_32(adr) | ((ZPOS64_T)READ_32((adr)+4) << 32))
+#define WRITE_64(buff, n) do { \
+  WRITE_32((unsigned char*)(buff), (uLong)((n) & 0xffffffff)); \
+  WRITE_32((unsigned char*)(buff) + 4, (uLong)((ZPOS64_T)(n) >> 32)); \
+} while(0)
+
+/* a file read or written by unzRepair64(), through a buffer */
+typedef struct {
+  zlib_filefunc64_def ff;
+  voidpf stream;
+  unsigned char* buf;           /* REPAIR_BUFSIZE bytes */
+  uLong next;                   /* next byte in buf to use, when reading */
+  uLong have;                   /* bytes in buf */
+  ZPOS64_T pos;                 /* offset in the file of buf + next */
+  int err;                      /* true if a write failed */
+} repair_file;
+
+/* Have at least need bytes at f->buf + f->next, where need is at most
+   REPAIR_BUFSIZE, reading as much as fits.  Return the number of bytes there,
+   which is less than need only at the end of the file, or on a read error. */
+static uLong repair_fill(repair_file* f, uLong need) {
+  if (f->have - f->next < need) {
+    memmove(f->buf, f->buf + f->next, f->have - f->next);
+    f->have -= f->next;
+    f->next = 0;
+    while (f->have < need) {
+      uLong got = f->ff.zread_file(f->ff.opaque, f->stream, f->buf + f->have,
+                                   REPAIR_BUFSIZE - f->have);
+      if (got == 0)
+        break;
+      f->have += got;
+    }
+  }
+  return f->have - f->next;
+}
+
+/* Write any buffered output.  Return 0 on success, or -1 if this or any
+   earlier write failed. */
+static int repair_flush(repair_file* f) {
+  if (f->have && !f->err &&
+      f->ff.zwrite_file(f->ff.opaque, f->stream, f->buf, f->have) != f->have)
+    f->err = 1;
+  f->have = 0;
+  return f->err ? -1 : 0;
+}
+
+/* Write len bytes, through the buffer unless they would fill it.  An error
+   is returned by the next repair_flush(). */
+static void repair_write(repair_file* f, const void* data, uLong len) {
+  f->pos += len;
+  if (len > REPAIR_BUFSIZE - f->have) {
+    repair_flush(f);
+    if (len >= REPAIR_BUFSIZE) {
+      if (!f->err &&
+          f->ff.zwrite_file(f->ff.opaque, f->stream, data, len) != len)
+        f->err = 1;
+      return;
+    }
+  }
+  memcpy(f->buf + f->have, data, len);
+  f->have += len;
+}
+
+/* Copy the next len bytes of in to out, or if out is NULL, skip them, with a
+   seek if they are more than a buffer.  Return 0 on success, or -1 on a read
+   or seek error. */
+static int repair_pass(repair_file* in, repair_file* out, ZPOS64_T len) {
+  uLong n;
+
+  if (out == NULL && len > in->have - in->next + REPAIR_BUFSIZE) {
+    in->pos += len;
+    in->next = in->have = 0;
+    return in->ff.zseek64_file(in->ff.opaque, in->stream, in->pos,
+                               ZLIB_FILEFUNC_SEEK_SET) != 0 ? -1 : 0;
+  }
+  while (len) {
+    n = repair_fill(in, 1);
+    if (n == 0)
+      return -1;
+    if (n > len)
+      n = (uLong)len;
+    if (out != NULL)
+      repair_write(out, in->buf + in->next, n);
+    in->next += n;
+    in->pos += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Copy or skip, as repair_pass() does, the file data of unknown length that
+   is followed by a data descriptor.  The descriptor is found by its signature
+   and CRC, followed by a compressed size (of eight bytes if zip64) equal to
+   the length of the data before the signature.  Return 0 with that length in
+   *len, or -1 if there is no such descriptor before the end of the file. */
+static int repair_find(repair_file* in, repair_file* out, int zip64,
+                       ZPOS64_T* len) {
+  uLong need = zip64 ? 24 : 16;
+  uLong have, i;
+  const unsigned char* p;
+
+  *len = 0;
+  for (;;) {
+    have = repair_fill(in, need);
+    if (have < need)
+      return -1;
+    p = in->buf + in->next;
+    for (i = 0; i <= have - need; i++)
+      if (p[i] == 0x50 && READ_32(p + i) == 0x08074b50 &&
+          (zip64 ? READ_64(p + i + 8) : READ_32(p + i + 8)) == *len + i) {
+        *len += i;
+        return repair_pass(in, out, i);
+      }
+    *len += i;
+    repair_pass(in, out, i);
+  }
+}
+
+extern int ZEXPORT unzRepair64(const char* file, const char* fileOut, ZPOS64_T* nRecovered, ZPOS64_T* bytesRecovered) {
   int err = Z_OK;
-  FILE* fpZip = fopen(file, "rb");
-  FILE* fpOut = fopen(fileOut, "wb");
-  FILE* fpOutCD = fopen(fileOutTmp, "wb");
-  if (fpZip != NULL &&  fpOut != NULL) {
-    int entries = 0;
-    uLong totalBytes = 0;
-    char header[30];
-    char filename[1024];
-    char extra[1024];
-    int offset = 0;
-    int offsetCD = 0;
-    while ( fread(header, 1, 30, fpZip) == 30 ) {
-      int currentOffset = offset;
-
-      /* File entry */
-      if (READ_32(header) == 0x04034b50) {
-        unsigned int version = READ_16(header + 4);
-        unsigned int gpflag = READ_16(header + 6);
-        unsigned int method = READ_16(header + 8);
-        unsigned int filetime = READ_16(header + 10);
-        unsigned int filedate = READ_16(header + 12);
-        unsigned int crc = READ_32(header + 14); /* crc */
-        unsigned int cpsize = READ_32(header + 18); /* compressed size */
-        unsigned int uncpsize = READ_32(header + 22); /* uncompressed sz */
-        unsigned int fnsize = READ_16(header + 26); /* file name length */
-        unsigned int extsize = READ_16(header + 28); /* extra field length */
-        filename[0] = extra[0] = '\0';
-
-        /* Header */
-        if (fwrite(header, 1, 30, fpOut) == 30) {
-          offset += 30;
-        } else {
-          err = Z_ERRNO;
-          break;
-        }
+  repair_file in, out;
+  repair_file* copy = fileOut != NULL ? &out : NULL;
+  ZPOS64_T entries = 0;
+  ZPOS64_T totalBytes = 0;
+  ZPOS64_T end = 0;             /* length of file */
+  unsigned char* cd = NULL;     /* the central directory being built */
+  uLong sizeCD = 0;
+  uLong allocCD = 0;
+  unsigned char* central;       /* one entry of it */
 
-        /* Filename */
-        if (fnsize > 0) {
-          if (fnsize < sizeof(filename)) {
-            if (fread(filename, 1, fnsize, fpZip) == fnsize) {
-                if (fwrite(filename, 1, fnsize, fpOut) == fnsize) {
-                offset += fnsize;
-              } else {
-                err = Z_ERRNO;
-                break;
-              }
-            } else {
-              err = Z_ERRNO;
-              break;
-            }
-          } else {
-            err = Z_ERRNO;
-            break;
-          }
-        } else {
-          err = Z_STREAM_ERROR;
-          break;
-        }
+  fill_fopen64_filefunc(&in.ff);
+  out.ff = in.ff;
+  in.stream = out.stream = NULL;
+  in.next = in.have = out.next = out.have = 0;
+  in.pos = out.pos = 0;
+  in.err = out.err = 0;
+  in.buf = (unsigned char*)malloc(REPAIR_BUFSIZE);
+  out.buf = (unsigned char*)malloc(REPAIR_BUFSIZE);
+  central = (unsigned char*)malloc(46 + 2 * 65535 + 28);
+  if (in.buf == NULL || out.buf == NULL || central == NULL)
+    err = Z_MEM_ERROR;
+  else {
+    in.stream = in.ff.zopen64_file(in.ff.opaque, file,
+                                   ZLIB_FILEFUNC_MODE_READ |
+                                   ZLIB_FILEFUNC_MODE_EXISTING);
+    if (in.stream != NULL && copy != NULL)
+      out.stream = out.ff.zopen64_file(out.ff.opaque, fileOut,
+                                       ZLIB_FILEFUNC_MODE_WRITE |
+                                       ZLIB_FILEFUNC_MODE_CREATE);
+    if (in.stream == NULL || (copy != NULL && out.stream == NULL))
+      err = Z_STREAM_ERROR;
+    else if (in.ff.zseek64_file(in.ff.opaque, in.stream, 0,
+                                ZLIB_FILEFUNC_SEEK_END) != 0 ||
+             (end = in.ff.ztell64_file(in.ff.opaque, in.stream)) ==
+               (ZPOS64_T)-1 ||
+             in.ff.zseek64_file(in.ff.opaque, in.stream, 0,
+                                ZLIB_FILEFUNC_SEEK_SET) != 0)
+      err = Z_ERRNO;
+  }
 
-        /* Extra field */
-        if (extsize > 0) {
-          if (extsize < sizeof(extra)) {
-            if (fread(extra, 1, extsize, fpZip) == extsize) {
-              if (fwrite(extra, 1, extsize, fpOut) == extsize) {
-                offset += extsize;
-                } else {
-                err = Z_ERRNO;
-                break;
-              }
-            } else {
-              err = Z_ERRNO;
-              break;
-            }
-          } else {
-            err = Z_ERRNO;
-            break;
-          }
-        }
+  /* File entries, up to the first that is not one, or that is cut off */
+  while (err == Z_OK && repair_fill(&in, 30) >= 30 &&
+         READ_32(in.buf + in.next) == 0x04034b50) {
+    const unsigned char* header = in.buf + in.next;
+    uLong gpflag = READ_16(header + 6);
+    ZPOS64_T cpsize = READ_32(header + 18);   /* compressed size */
+    ZPOS64_T uncpsize = READ_32(header + 22); /* uncompressed sz */
+    uLong fnsize = READ_16(header + 26);      /* file name length */
+    uLong extsize = READ_16(header + 28);     /* extra field length */
+    ZPOS64_T offset = copy != NULL ? out.pos : in.pos;
+    int unknown;
+    int zip64 = 0;
+    const unsigned char* field;
+    const unsigned char* last;
+    unsigned char* put;
+    uLong size;
 
-        /* Data */
-        {
-          int dataSize = cpsize;
-          if (dataSize == 0) {
-            dataSize = uncpsize;
-          }
-          if (dataSize > 0) {
-            char* data = malloc(dataSize);
-            if (data != NULL) {
-              if ((int)fread(data, 1, dataSize, fpZip) == dataSize) {
-                if ((int)fwrite(data, 1, dataSize, fpOut) == dataSize) {
-                  offset += dataSize;
-                  totalBytes += dataSize;
-                } else {
-                  err = Z_ERRNO;
-                }
-              } else {
-                err = Z_ERRNO;
-              }
-              free(data);
-              if (err != Z_OK) {
-                break;
-              }
-            } else {
-              err = Z_MEM_ERROR;
-              break;
-            }
-          }
-        }
+    if (fnsize == 0 ||
+        repair_fill(&in, 30 + fnsize + extsize) < 30 + fnsize + extsize)
+      break;
+    header = in.buf + in.next;
 
-        /* Central directory entry */
-        {
-          char central[46];
-          char* comment = "";
-          int comsize = (int) strlen(comment);
-          WRITE_32(central, 0x02014b50);
-          WRITE_16(central + 4, version);
-          WRITE_16(central + 6, version);
-          WRITE_16(central + 8, gpflag);
-          WRITE_16(central + 10, method);
-          WRITE_16(central + 12, filetime);
-          WRITE_16(central + 14, filedate);
-          WRITE_32(central + 16, crc);
-          WRITE_32(central + 20, cpsize);
-          WRITE_32(central + 24, uncpsize);
-          WRITE_16(central + 28, fnsize);
-          WRITE_16(central + 30, extsize);
-          WRITE_16(central + 32, comsize);
-          WRITE_16(central + 34, 0);    /* disk # */
-          WRITE_16(central + 36, 0);    /* int attrb */
-          WRITE_32(central + 38, 0);    /* ext attrb */
-          WRITE_32(central + 42, currentOffset);
-          /* Header */
-          if (fwrite(central, 1, 46, fpOutCD) == 46) {
-            offsetCD += 46;
-
-            /* Filename */
-            if (fnsize > 0) {
-              if (fwrite(filename, 1, fnsize, fpOutCD) == fnsize) {
-                offsetCD += fnsize;
-              } else {
-                err = Z_ERRNO;
-                break;
-              }
-            } else {
-              err = Z_STREAM_ERROR;
-              break;
-            }
-
-            /* Extra field */
-            if (extsize > 0) {
-              if (fwrite(extra, 1, extsize, fpOutCD) == extsize) {
-                offsetCD += extsize;
-              } else {
-                err = Z_ERRNO;
-                break;
-              }
-            }
-
-            /* Comment field */
-            if (comsize > 0) {
-              if ((int)fwrite(comment, 1, comsize, fpOutCD) == comsize) {
-                offsetCD += comsize;
-              } else {
-                err = Z_ERRNO;
-                break;
-              }
-            }
-
-
-          } else {
-            err = Z_ERRNO;
-            break;
-          }
+    /* Central directory entry, with the extra field less any Zip64 field,
+       from which the sizes that don't fit in the header are taken */
+    WRITE_32(central, 0x02014b50);
+    memcpy(central + 4, header + 4, 2);         /* version made by */
+    memcpy(central + 6, header + 4, 14);        /* version .. crc */
+    WRITE_16(central + 28, fnsize);
+    WRITE_16(central + 32, 0);          /* comment */
+    WRITE_16(central + 34, 0);          /* disk # */
+    WRITE_16(central + 36, 0);          /* int attrb */
+    WRITE_32(central + 38, 0);          /* ext attrb */
+    memcpy(central + 46, header + 30, fnsize);
+    field = header + 30 + fnsize;
+    last = field + extsize;
+    put = central + 46 + fnsize;
+    while (last - field >= 4) {
+      uLong id = READ_16(field);
+      uLong len = READ_16(field + 2);
+      if (len > (uLong)(last - field) - 4)
+        break;
+      if (id == 0x0001) {
+        const unsigned char* p = field + 4;
+        zip64 = 1;
+        if (uncpsize == 0xffffffff && len >= 8) {
+          uncpsize = READ_64(p);
+          p += 8;
+          len -= 8;
         }
+        if (cpsize == 0xffffffff && len >= 8)
+          cpsize = READ_64(p);
+      } else {
+        memcpy(put, field, 4 + len);
+        put += 4 + len;
+      }
+      field += 4 + READ_16(field + 2);
+    }
+    memcpy(put, field, (size_t)(last - field));
+    put += last - field;
+    unknown = (gpflag & 8) && cpsize == 0;
+    if (!unknown && cpsize > end - (in.pos + 30 + fnsize + extsize))
+      break;
 
-        /* Success */
-        entries++;
+    /* Header, which is in the buffer, and data */
+    repair_pass(&in, copy, 30 + fnsize + extsize);
+    if (unknown) {
+      if (repair_find(&in, copy, zip64, &cpsize) != 0)
+        break;
+    } else if (repair_pass(&in, copy, cpsize) != 0) {
+      err = Z_ERRNO;
+      break;
+    }
 
-      } else {
+    /* Data descriptor, with or without a signature, which has the CRC and
+       the sizes */
+    if (gpflag & 8) {
+      uLong desc = zip64 ? 20 : 12;
+      uLong sig;
+      const unsigned char* p;
+      if (repair_fill(&in, 4 + desc) < 4 + desc)
+        break;
+      p = in.buf + in.next;
+      sig = READ_32(p) == 0x08074b50 ? 4 : 0;
+      if ((zip64 ? READ_64(p + sig + 4) : READ_32(p + sig + 4)) != cpsize)
+        break;
+      memcpy(central + 16, p + sig, 4);
+      if (unknown)
+        uncpsize = zip64 ? READ_64(p + sig + 12) : READ_32(p + sig + 8);
+      if (repair_pass(&in, copy, sig + desc) != 0) {
+        err = Z_ERRNO;
         break;
       }
     }
 
-    /* Final central directory  */
-    {
-      int entriesZip = entries;
-      char end[22];
-      char* comment = ""; // "ZIP File recovered by zlib/minizip/mztools";
-      int comsize = (int) strlen(comment);
-      if (entriesZip > 0xffff) {
-        entriesZip = 0xffff;
+    /* The sizes and offset, with a Zip64 extra field for what doesn't fit */
+    WRITE_32(central + 20, cpsize >= 0xffffffff ? 0xffffffff : cpsize);
+    WRITE_32(central + 24, uncpsize >= 0xffffffff ? 0xffffffff : uncpsize);
+    WRITE_32(central + 42, offset >= 0xffffffff ? 0xffffffff : offset);
+    if (uncpsize >= 0xffffffff || cpsize >= 0xffffffff ||
+        offset >= 0xffffffff) {
+      unsigned char* zip64field = put;
+      put += 4;
+      if (uncpsize >= 0xffffffff) {
+        WRITE_64(put, uncpsize);
+        put += 8;
       }
-      WRITE_32(end, 0x06054b50);
-      WRITE_16(end + 4, 0);         /* disk # */
-      WRITE_16(end + 6, 0);         /* disk # */
-      WRITE_16(end + 8, entriesZip);        /* hack */
-      WRITE_16(end + 10, entriesZip);       /* hack */
-      WRITE_32(end + 12, offsetCD);         /* size of CD */
-      WRITE_32(end + 16, offset);           /* offset to CD */
-      WRITE_16(end + 20, comsize);          /* comment */
-
-      /* Header */
-      if (fwrite(end, 1, 22, fpOutCD) == 22) {
-
-        /* Comment field */
-        if (comsize > 0) {
-          if ((int)fwrite(comment, 1, comsize, fpOutCD) != comsize) {
-            err = Z_ERRNO;
-          }
-        }
-
-      } else {
-        err = Z_ERRNO;
+      if (cpsize >= 0xffffffff) {
+        WRITE_64(put, cpsize);
+        put += 8;
+      }
+      if (offset >= 0xffffffff) {
+        WRITE_64(put, offset);
+        put += 8;
       }
+      WRITE_16(zip64field, 0x0001);
+      WRITE_16(zip64field + 2, put - zip64field - 4);
     }
+    size = (uLong)(put - central);
+    if (size - 46 - fnsize > 0xffff)
+      break;
+    WRITE_16(central + 30, size - 46 - fnsize);
 
-    /* Final merge (file + central directory) */
-    fclose(fpOutCD);
-    if (err == Z_OK) {
-      fpOutCD = fopen(fileOutTmp, "rb");
-      if (fpOutCD != NULL) {
-        int nRead;
-        char buffer[8192];
-        while ( (nRead = (int)fread(buffer, 1, sizeof(buffer), fpOutCD)) > 0) {
-          if ((int)fwrite(buffer, 1, nRead, fpOut) != nRead) {
-            err = Z_ERRNO;
-            break;
-          }
-        }
-        fclose(fpOutCD);
+    if (size > allocCD - sizeCD) {
+      uLong grow = allocCD ? allocCD : 65536;
+      unsigned char* more = allocCD + grow < allocCD ? NULL :
+        (unsigned char*)realloc(cd, allocCD + grow);
+      if (more == NULL) {
+        err = Z_MEM_ERROR;
+        break;
       }
+      cd = more;
+      allocCD += grow;
     }
+    memcpy(cd + sizeCD, central, size);
+    sizeCD += size;
 
-    /* Close */
-    fclose(fpZip);
-    fclose(fpOut);
+    /* Success */
+    entries++;
+    totalBytes += cpsize;
+  }
 
-    /* Wipe temporary file */
-    (void)remove(fileOutTmp);
+  /* Final central directory, after the copy, or appended to file */
+  if (err == Z_OK && copy == NULL) {
+    out.stream = out.ff.zopen64_file(out.ff.opaque, file,
+                                     ZLIB_FILEFUNC_MODE_WRITE |
+                                     ZLIB_FILEFUNC_MODE_EXISTING);
+    if (out.stream == NULL ||
+        out.ff.zseek64_file(out.ff.opaque, out.stream, 0,
+                            ZLIB_FILEFUNC_SEEK_END) != 0)
+      err = Z_ERRNO;
+    out.pos = end;
+  }
+  if (err == Z_OK) {
+    ZPOS64_T offsetCD = out.pos;
+    unsigned char tail[56 + 20 + 22];
+    unsigned char* p = tail;
+    if (sizeCD)
+      repair_write(&out, cd, sizeCD);
+    if (entries >= 0xffff || sizeCD >= 0xffffffff ||
+        offsetCD >= 0xffffffff) {
+      WRITE_32(p, 0x06064b50);          /* Zip64 end of central directory */
+      WRITE_64(p + 4, 44);              /* size of the rest of it */
+      WRITE_16(p + 12, 45);             /* version made by */
+      WRITE_16(p + 14, 45);             /* version needed */
+      WRITE_32(p + 16, 0);              /* disk # */
+      WRITE_32(p + 20, 0);              /* disk # */
+      WRITE_64(p + 24, entries);
+      WRITE_64(p + 32, entries);
+      WRITE_64(p + 40, sizeCD);
+      WRITE_64(p + 48, offsetCD);
+      WRITE_32(p + 56, 0x07064b50);     /* its locator */
+      WRITE_32(p + 60, 0);              /* disk # */
+      WRITE_64(p + 64, offsetCD + sizeCD);
+      WRITE_32(p + 72, 1);              /* number of disks */
+      p += 76;
+    }
+    WRITE_32(p, 0x06054b50);
+    WRITE_16(p + 4, 0);         /* disk # */
+    WRITE_16(p + 6, 0);         /* disk # */
+    WRITE_16(p + 8, entries >= 0xffff ? 0xffff : entries);
+    WRITE_16(p + 10, entries >= 0xffff ? 0xffff : entries);
+    WRITE_32(p + 12, sizeCD >= 0xffffffff ? 0xffffffff : sizeCD);
+    WRITE_32(p + 16, offsetCD >= 0xffffffff ? 0xffffffff : offsetCD);
+    WRITE_16(p + 20, 0);        /* comment */
+    repair_write(&out, tail, (uLong)(p + 22 - tail));
+    if (repair_flush(&out) != 0)
+      err = Z_ERRNO;
+  }
 
-    /* Number of recovered entries */
-    if (err == Z_OK) {
-      if (nRecovered != NULL) {
-        *nRecovered = entries;
-      }
-      if (bytesRecovered != NULL) {
-        *bytesRecovered = totalBytes;
+  /* Close */
+  if (out.stream != NULL &&
+      out.ff.zclose_file(out.ff.opaque, out.stream) != 0 && err == Z_OK)
+    err = Z_ERRNO;
+  if (in.stream != NULL)
+    in.ff.zclose_file(in.ff.opaque, in.stream);
+  free(cd);
+  free(central);
+  free(out.buf);
+  free(in.buf);
+
+  /* Number of recovered entries */
+  if (err == Z_OK) {
+    if (nRecovered != NULL) {
+      *nRecovered = entries;
+    }
+    if (bytesRecovered != NULL) {
+      *bytesRecovered = totalBytes;
+    }
+  }
+  return err;
+}
+
+extern int ZEXPORT unzRepair(const char* file, const char* fileOut, const char* fileOutTmp, uLong* nRecovered, uLong* bytesRecovered) {
+  ZPOS64_T entries, bytes;
+  int err = unzRepair64(file, fileOut, &entries, &bytes);
+  (void)fileOutTmp;
+  if (err == Z_OK) {
+    if (nRecovered != NULL) {
+      *nRecovered = (uLong)entries;
+    }
+    if (bytesRecovered != NULL) {
+      *bytesRecovered = (uLong)bytes;
+    }
+  }
+  return err;
+}
+
+/* size of the pieces read by zipCopyEntryFrom() when the data is not mapped */
+#define COPY_BUFSIZE (1024*1024)
+
+extern int ZEXPORT zipCopyEntryFrom(zipFile dst, unzFile src) {
+  unz_file_info64 info;
+  zip_fileinfo zi;
+  char* filename = NULL;
+  char* extra = NULL;
+  char* local = NULL;
+  char* comment = NULL;
+  int size_extra, size_local = 0;
+  int method, level, err;
+  const void* data;
+  ZPOS64_T len;
+
+  if (dst == NULL || src == NULL)
+    return ZIP_PARAMERROR;
+  err = unzGetCurrentFileInfo64(src, &info, NULL, 0, NULL, 0, NULL, 0);
+  if (err != UNZ_OK)
+    return err;
+  if ((info.flag & 9) == 9)
+    return ZIP_PARAMERROR;
+
+  filename = (char*)malloc(info.size_filename + 1);
+  extra = (char*)malloc(info.size_file_extra + 1);
+  comment = (char*)malloc(info.size_file_comment + 1);
+  if (filename == NULL || extra == NULL || comment == NULL)
+    err = ZIP_INTERNALERROR;
+  if (err == ZIP_OK)
+    err = unzGetCurrentFileInfo64(src, NULL, filename, info.size_filename + 1,
+                                  extra, info.size_file_extra,
+                                  comment, info.size_file_comment + 1);
+  if (err == ZIP_OK)
+    err = unzOpenCurrentFile2(src, &method, &level, 1);
+  if (err == ZIP_OK) {
+    size_local = unzGetLocalExtrafield(src, NULL, 0);
+    local = (char*)malloc((size_t)size_local + 1);
+    if (local == NULL)
+      err = ZIP_INTERNALERROR;
+    else if (size_local > 0 &&
+             unzGetLocalExtrafield(src, local, (unsigned)size_local) != size_local)
+      err = ZIP_ERRNO;
+  }
+
+  if (err == ZIP_OK) {
+    /* zip.c writes its own Zip64 extra fields as needed */
+    size_extra = (int)info.size_file_extra;
+    if (size_extra >= 4)
+      zipRemoveExtraInfoBlock(extra, &size_extra, 0x0001);
+    if (size_local >= 4)
+      zipRemoveExtraInfoBlock(local, &size_local, 0x0001);
+
+    zi.tmz_date.tm_sec = (int)info.tmu_date.tm_sec;
+    zi.tmz_date.tm_min = (int)info.tmu_date.tm_min;
+    zi.tmz_date.tm_hour = (int)info.tmu_date.tm_hour;
+    zi.tmz_date.tm_mday = (int)info.tmu_date.tm_mday;
+    zi.tmz_date.tm_mon = (int)info.tmu_date.tm_mon;
+    zi.tmz_date.tm_year = (int)info.tmu_date.tm_year;
+    zi.dosDate = info.dosDate;
+    zi.internal_fa = info.internal_fa;
+    zi.external_fa = info.external_fa;
+
+    /* level reproduces flag bits 1 and 2, and the data is not followed by
+       a data descriptor, since the sizes are known */
+    err = zipOpenNewFileInZip4_64(dst, filename, &zi,
+                                  local, (uInt)size_local,
+                                  extra, (uInt)size_extra,
+                                  info.size_file_comment ? comment : NULL,
+                                  method, level, 1,
+                                  -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                  NULL, 0, info.version, info.flag & ~8UL,
+                                  info.compressed_size >= 0xffffffff ||
+                                  info.uncompressed_size >= 0xffffffff);
+  }
+
+  if (err == ZIP_OK) {
+    if (unzGetCurrentFileData(src, &data, &len) == UNZ_OK) {
+      const unsigned char* next = (const unsigned char*)data;
+      while (err == ZIP_OK && len > 0) {
+        unsigned n = len > 0x40000000 ? 0x40000000 : (unsigned)len;
+        err = zipWriteInFileInZip(dst, next, n);
+        next += n;
+        len -= n;
       }
+    } else {
+      void* buf = malloc(COPY_BUFSIZE);
+      int got = 0;
+      if (buf == NULL)
+        err = ZIP_INTERNALERROR;
+      while (err == ZIP_OK &&
+             (got = unzReadCurrentFile(src, buf, COPY_BUFSIZE)) > 0)
+        err = zipWriteInFileInZip(dst, buf, (unsigned)got);
+      if (got < 0)
+        err = got;
+      free(buf);
     }
-  } else {
-    err = Z_STREAM_ERROR;
+    if (err == ZIP_OK)
+      err = zipCloseFileInZipRaw64(dst, info.uncompressed_size, info.crc);
+    else
+      zipCloseFileInZipRaw64(dst, 0, 0);
   }
+  unzCloseCurrentFile(src);
+
+  free(local);
+  free(comment);
+  free(extra);
+  free(filename);
   return err;
 }
@@ -16,11 +16,12 @@ extern "C" {
 #endif
 
 #include "unzip.h"
+#include "zip.h"
 
 /* Repair a ZIP file (missing central directory)
    file: file to recover
-   fileOut: output file after recovery
-   fileOutTmp: temporary file name used for recovery
+   fileOut: output file after recovery, or NULL to repair file in place
+   fileOutTmp: no longer used
 */
 extern int ZEXPORT unzRepair(const char* file,
                              const char* fileOut,
@@ -28,6 +29,34 @@ extern int ZEXPORT unzRepair(const char* file,
                              uLong* nRecovered,
                              uLong* bytesRecovered);
 
+/* Like unzRepair(), with 64-bit counts.  The entries from the start of file
+   up to the first that is not a local header, or whose data is cut off, are
+   scanned in one pass with large reads, and a new central directory for them
+   is built in memory, with Zip64 records where needed.  With fileOut, the
+   entries are copied to fileOut followed by the central directory.  With
+   fileOut NULL, the central directory is instead appended to file, which is
+   not otherwise written, and the file data is sought over instead of read.
+   Returns Z_OK, Z_STREAM_ERROR if a file could not be opened, Z_ERRNO on a
+   read or write error, or Z_MEM_ERROR if out of memory. */
+extern int ZEXPORT unzRepair64(const char* file,
+                               const char* fileOut,
+                               ZPOS64_T* nRecovered,
+                               ZPOS64_T* bytesRecovered);
+
+/* Copy the current file of src to a new file in dst, without decompressing
+   and recompressing it.  The compressed data, CRC, sizes, method, dates,
+   attributes, extra fields, and comment are copied as they are, except for
+   the Zip64 extra fields, which zip.c makes anew.  src is left on the same
+   file, which is closed if it was open.  Files encrypted with a data
+   descriptor (general purpose flag bits 0 and 3) cannot be copied, since
+   their password check needs the descriptor, and return ZIP_PARAMERROR.
+   Otherwise this returns ZIP_OK, or the error from reading or writing.
+
+   The data is read in large pieces, or used in place if src was opened with
+   fill_mmap_filefunc64(), and written with one call where possible, so a
+   merge of many zip files with this is limited by I/O. */
+extern int ZEXPORT zipCopyEntryFrom(zipFile dst, unzFile src);
+
 
 #ifdef __cplusplus
 }
@@ -71,6 +71,10 @@
 #include "zlib.h"
 #include "unzip.h"
 
+#ifdef HAVE_INFBACK9
+#  include "infback9.h"
+#endif
+
 #ifdef STDC
 #  include <stddef.h>
 #endif
@@ -80,6 +84,50 @@
 #   include <errno.h>
 #endif
 
+/* threads for unzSetReadAhead(), from Windows, or POSIX if HAVE_PTHREAD */
+#ifndef NO_THREADS
+#  if defined(_WIN32)
+#    ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#    include <process.h>
+#    define UNZ_THREADS
+     typedef CRITICAL_SECTION unz_mutex;
+     typedef CONDITION_VARIABLE unz_cond;
+     typedef HANDLE unz_thread;
+#    define unz_mutex_init(m) InitializeCriticalSection(m)
+#    define unz_mutex_free(m) DeleteCriticalSection(m)
+#    define unz_lock(m) EnterCriticalSection(m)
+#    define unz_unlock(m) LeaveCriticalSection(m)
+#    define unz_cond_init(c) InitializeConditionVariable(c)
+#    define unz_cond_free(c)
+#    define unz_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#    define unz_wake(c) WakeAllConditionVariable(c)
+#    define UNZ_WORKER unsigned __stdcall
+#    define unz_start(t, run, arg) \
+        ((*(t) = (HANDLE)_beginthreadex(NULL, 0, run, arg, 0, NULL)) == 0)
+#    define unz_join(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#  elif defined(HAVE_PTHREAD)
+#    include <pthread.h>
+#    define UNZ_THREADS
+     typedef pthread_mutex_t unz_mutex;
+     typedef pthread_cond_t unz_cond;
+     typedef pthread_t unz_thread;
+#    define unz_mutex_init(m) pthread_mutex_init(m, NULL)
+#    define unz_mutex_free(m) pthread_mutex_destroy(m)
+#    define unz_lock(m) pthread_mutex_lock(m)
+#    define unz_unlock(m) pthread_mutex_unlock(m)
+#    define unz_cond_init(c) pthread_cond_init(c, NULL)
+#    define unz_cond_free(c) pthread_cond_destroy(c)
+#    define unz_wait(c, m) pthread_cond_wait(c, m)
+#    define unz_wake(c) pthread_cond_broadcast(c)
+#    define UNZ_WORKER void *
+#    define unz_start(t, run, arg) pthread_create(t, NULL, run, arg)
+#    define unz_join(t) pthread_join(t, NULL)
+#  endif
+#endif
+
 
 #ifndef local
 #  define local static
@@ -106,6 +154,8 @@
 # define ALLOC(size) (malloc(size))
 #endif
 
+#define UNZ_CKPT (32792)   /* largest inflateCheckpoint() */
+
 #define SIZECENTRALDIRITEM (0x2e)
 #define SIZEZIPLOCALHEADER (0x1e)
 
@@ -120,17 +170,36 @@ typedef struct unz_file_info64_internal_s
 } unz_file_info64_internal;
 
 
+/* an access point saved by unzReadCurrentFile() for unzSeek64() */
+typedef struct unz_point_s
+{
+    ZPOS64_T in;                /* offset of the point in compressed data */
+    ZPOS64_T out;               /* offset in the uncompressed data */
+    unsigned char* ckpt;        /* inflateCheckpoint() state, compressed */
+    uLong len;                  /* length of the state */
+    uLong clen;                 /* length of ckpt */
+} unz_point;
+
 /* file_in_zip_read_info_s contain internal information about a file in zipfile,
     when reading and decompress it */
 typedef struct
 {
     char  *read_buffer;         /* internal buffer for compressed data */
+    uInt  read_size;            /* size of read_buffer */
+    struct unz_ahead_s* ahead;  /* read-ahead thread and buffers, or NULL */
+    unsigned ahead_count;       /* number of read-ahead buffers, 0 for none */
     z_stream stream;            /* zLib stream structure for inflate */
 
 #ifdef HAVE_BZIP2
     bz_stream bstream;          /* bzLib stream structure for bziped */
 #endif
 
+#ifdef HAVE_INFBACK9
+    unsigned char *deflate64_buffer; /* whole entry inflated by inflateBack9 */
+    uInt deflate64_have;        /* number of bytes in deflate64_buffer */
+    uInt deflate64_size;        /* allocated size of deflate64_buffer */
+#endif
+
     ZPOS64_T pos_in_zipfile;       /* position in byte on the zipfile, for fseek*/
     uLong stream_initialised;   /* flag set if stream structure is initialised*/
 
@@ -148,6 +217,16 @@ typedef struct
     uLong compression_method;   /* compression method (0==store) */
     ZPOS64_T byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
     int   raw;
+
+    ZPOS64_T pos_data;          /* position of the data in the zipfile */
+    ZPOS64_T size_compressed;   /* rest_read_compressed at pos_data */
+    ZPOS64_T size_uncompressed; /* rest_read_uncompressed at pos_data */
+    int   seeked;               /* true if the crc32 can't be checked */
+    ZPOS64_T span;              /* distance of access points, 0 for none */
+    unz_point* points;          /* access points for unzSeek64() */
+    uInt  points_have;          /* number of points */
+    uInt  points_size;          /* allocated number of points */
+    unsigned char* ckpt_buffer; /* UNZ_CKPT bytes for a checkpoint, or NULL */
 } file_in_zip64_read_info_s;
 
 
@@ -177,6 +256,17 @@ typedef struct
 
     int isZip64;
 
+    unsigned char* index_dir;   /* central directory read by unzIndex() */
+    ZPOS64_T* index_pos;        /* offset of each file in index_dir */
+    ZPOS64_T index_count;       /* number of files in index_pos */
+    uLong* index_hash;          /* file numbers plus one, hashed by name */
+    uLong index_mask;           /* number of index_hash slots minus one */
+    int index_owner;            /* true to free the index on unzClose() */
+
+    uInt read_size;             /* from unzSetBufferSize() */
+    unsigned ahead_count;       /* from unzSetReadAhead() */
+    ZPOS64_T span;              /* from unzSetSeekSpan() */
+
 #    ifndef NOUNCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
     const z_crc_t* pcrc_32_tab;
@@ -189,6 +279,169 @@ typedef struct
 #endif
 
 
+#ifdef UNZ_THREADS
+/* read-ahead buffers of the file being read, filled by a thread that reads
+   its compressed data in sequence while the caller decompresses */
+struct unz_ahead_s
+{
+        /* shared, protected by lock */
+    unz_mutex lock;             /* mutex for the following */
+    unz_cond cond;              /* signaled when a buffer is filled or freed */
+    unsigned head;              /* number of buffers filled */
+    unsigned tail;              /* number of buffers released */
+    ZPOS64_T rest;              /* bytes left for the thread to read */
+    int err;                    /* true if a seek or read failed */
+    int stop;                   /* true to tell the thread to return */
+        /* used only by the reader */
+    int done;                   /* true if the tail buffer is to be released */
+        /* set before the thread is started */
+    zlib_filefunc64_32_def z_filefunc;
+    voidpf filestream;          /* io structure of the zipfile */
+    ZPOS64_T pos;               /* where in the zipfile to start reading */
+    unsigned count;             /* number of buffers */
+    uInt size;                  /* size of each buffer */
+    uInt* len;                  /* bytes in each filled buffer */
+    unsigned char* buf;         /* count buffers of size bytes */
+    unz_thread thread;          /* the read-ahead thread */
+};
+
+/* Read-ahead thread. */
+local UNZ_WORKER unz64local_AheadRun(void* arg) {
+    struct unz_ahead_s* ring = (struct unz_ahead_s*)arg;
+    unsigned char* buf;
+    uInt len;
+    int ok;
+
+    ok = ZSEEK64(ring->z_filefunc, ring->filestream, ring->pos,
+                 ZLIB_FILEFUNC_SEEK_SET) == 0;
+    unz_lock(&ring->lock);
+    ring->err = !ok;
+    for (;;)
+    {
+        while (!ring->stop && !ring->err && ring->rest != 0 &&
+               ring->head - ring->tail == ring->count)
+            unz_wait(&ring->cond, &ring->lock);
+        if (ring->stop || ring->err || ring->rest == 0)
+            break;
+        buf = ring->buf + (size_t)(ring->head % ring->count) * ring->size;
+        len = ring->size;
+        if (ring->rest < len)
+            len = (uInt)ring->rest;
+        unz_unlock(&ring->lock);
+        ok = ZREAD64(ring->z_filefunc, ring->filestream, buf, len) == len;
+        unz_lock(&ring->lock);
+        if (!ok)
+            ring->err = 1;
+        else
+        {
+            ring->len[ring->head++ % ring->count] = len;
+            ring->rest -= len;
+        }
+        unz_wake(&ring->cond);
+    }
+    unz_wake(&ring->cond);
+    unz_unlock(&ring->lock);
+    return 0;
+}
+
+/* Start the read-ahead thread at the current position of the file being
+   read, if requested, not already running, and there is more than one read
+   left.  If it can't be started, or the zipfile is mapped in memory, give up
+   on reading ahead for this file and read in unz64local_Fill(). */
+local void unz64local_StartAhead(file_in_zip64_read_info_s* pfile_in_zip_read_info) {
+    struct unz_ahead_s* ring;
+    ZPOS64_T size;
+
+    if ((pfile_in_zip_read_info->ahead_count == 0) ||
+        (pfile_in_zip_read_info->ahead != NULL) ||
+        (pfile_in_zip_read_info->rest_read_compressed <=
+            pfile_in_zip_read_info->read_size))
+        return;
+    if (call_zmap64(&pfile_in_zip_read_info->z_filefunc,
+                    pfile_in_zip_read_info->filestream, &size) != NULL)
+    {
+        pfile_in_zip_read_info->ahead_count = 0;
+        return;
+    }
+    ring = (struct unz_ahead_s*)ALLOC(sizeof(struct unz_ahead_s));
+    if (ring == NULL)
+    {
+        pfile_in_zip_read_info->ahead_count = 0;
+        return;
+    }
+    ring->count = pfile_in_zip_read_info->ahead_count;
+    ring->size = pfile_in_zip_read_info->read_size;
+    ring->len = (uInt*)ALLOC(ring->count * sizeof(uInt));
+    ring->buf = (size_t)ring->count * ring->size / ring->size != ring->count ?
+                NULL : (unsigned char*)ALLOC((size_t)ring->count * ring->size);
+    if (ring->len == NULL || ring->buf == NULL ||
+        ring->count * sizeof(uInt) / sizeof(uInt) != ring->count)
+    {
+        free(ring->buf);
+        free(ring->len);
+        free(ring);
+        pfile_in_zip_read_info->ahead_count = 0;
+        return;
+    }
+    ring->head = ring->tail = 0;
+    ring->rest = pfile_in_zip_read_info->rest_read_compressed;
+    ring->err = ring->stop = ring->done = 0;
+    ring->z_filefunc = pfile_in_zip_read_info->z_filefunc;
+    ring->filestream = pfile_in_zip_read_info->filestream;
+    ring->pos = pfile_in_zip_read_info->pos_in_zipfile +
+                pfile_in_zip_read_info->byte_before_the_zipfile;
+    unz_mutex_init(&ring->lock);
+    unz_cond_init(&ring->cond);
+    if (unz_start(&ring->thread, unz64local_AheadRun, ring) != 0)
+    {
+        unz_cond_free(&ring->cond);
+        unz_mutex_free(&ring->lock);
+        free(ring->buf);
+        free(ring->len);
+        free(ring);
+        pfile_in_zip_read_info->ahead_count = 0;
+        return;
+    }
+    pfile_in_zip_read_info->ahead = ring;
+}
+
+/* Stop the read-ahead thread of the file being read, if it is running, so
+   that the zipfile can be used for something else.  The compressed data taken
+   from the buffers and not yet decompressed is kept in read_buffer, and the
+   rest is dropped, to be read again from pos_in_zipfile.  The thread is
+   started again by the next unz64local_Fill(). */
+local void unz64local_StopAhead(unz64_s* s) {
+    file_in_zip64_read_info_s* pfile_in_zip_read_info=s->pfile_in_zip_read;
+    struct unz_ahead_s* ring;
+
+    if (pfile_in_zip_read_info==NULL || pfile_in_zip_read_info->ahead==NULL)
+        return;
+    ring = pfile_in_zip_read_info->ahead;
+    unz_lock(&ring->lock);
+    ring->stop = 1;
+    unz_wake(&ring->cond);
+    unz_unlock(&ring->lock);
+    unz_join(ring->thread);
+    unz_cond_free(&ring->cond);
+    unz_mutex_free(&ring->lock);
+    if (ring->done && pfile_in_zip_read_info->stream.avail_in != 0)
+    {
+        memcpy(pfile_in_zip_read_info->read_buffer,
+               pfile_in_zip_read_info->stream.next_in,
+               pfile_in_zip_read_info->stream.avail_in);
+        pfile_in_zip_read_info->stream.next_in =
+            (Bytef*)pfile_in_zip_read_info->read_buffer;
+    }
+    free(ring->buf);
+    free(ring->len);
+    free(ring);
+    pfile_in_zip_read_info->ahead = NULL;
+}
+#else
+#  define unz64local_StopAhead(s)
+#endif
+
+
 /* ===========================================================================
    Reads a long in LSB order from the given gz_stream. Sets
 */
@@ -653,6 +906,15 @@ local unzFile unzOpenInternal(const void *path,
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
     us.encrypted = 0;
+    us.index_dir = NULL;
+    us.index_pos = NULL;
+    us.index_count = 0;
+    us.index_hash = NULL;
+    us.index_mask = 0;
+    us.index_owner = 0;
+    us.read_size = UNZ_BUFSIZE;
+    us.ahead_count = 0;
+    us.span = 0;
 
 
     s=(unz64_s*)ALLOC(sizeof(unz64_s));
@@ -714,6 +976,12 @@ extern int ZEXPORT unzClose(unzFile file) {
         unzCloseCurrentFile(file);
 
     ZCLOSE64(s->z_filefunc, s->filestream);
+    if (s->index_owner)
+    {
+        free(s->index_dir);
+        free(s->index_pos);
+        free(s->index_hash);
+    }
     free(s);
     return UNZ_OK;
 }
@@ -781,6 +1049,7 @@ local int unz64local_GetCurrentFileInfoInternal(unzFile file,
     if (file==NULL)
         return UNZ_PARAMERROR;
     s=(unz64_s*)file;
+    unz64local_StopAhead(s);
     if (ZSEEK64(s->z_filefunc, s->filestream,
               s->pos_in_central_dir+s->byte_before_the_zipfile,
               ZLIB_FILEFUNC_SEEK_SET)!=0)
@@ -1098,6 +1367,221 @@ extern int ZEXPORT unzGoToNextFile(unzFile file) {
 }
 
 
+/*
+  Hash the name of len bytes, up to any zero byte, which is where the name
+  read by unzGetCurrentFileInfo64() ends. Letters are folded to upper case as
+  in strcmpcasenosensitive_internal(), so that names that are the same without
+  regard to case have the same hash.
+*/
+local uLong unz64local_HashName(const char* name, uLong len) {
+    uLong hash = 2166136261UL;
+
+    while (len-- && *name) {
+        int c = (unsigned char)*name++;
+        if ((c >= 'a') && (c <= 'z'))
+            c -= 0x20;
+        hash = ((hash ^ (uLong)c) * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/* Return the central directory header of file number n from the index. */
+#define INDEX_ENTRY(s, n) ((s)->index_dir + (s)->index_pos[n])
+
+/* Return a little-endian value of two or four bytes at p. */
+#define INDEX_SHORT(p) ((uLong)(p)[0] | ((uLong)(p)[1] << 8))
+#define INDEX_LONG(p) (INDEX_SHORT(p) | (INDEX_SHORT((p) + 2) << 16))
+
+extern int ZEXPORT unzIndex(unzFile file) {
+    unz64_s* s;
+    unsigned char* dir;
+    ZPOS64_T* pos;
+    uLong* hash;
+    ZPOS64_T size, at, count, n;
+    uLong mask;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    if (s->index_hash != NULL)
+        return UNZ_OK;
+    unz64local_StopAhead(s);
+
+    /* read the central directory */
+    size = s->size_central_dir;
+    if ((size_t)size != size || (uLong)size != size)
+        return UNZ_INTERNALERROR;
+    dir = (unsigned char*)ALLOC((size_t)size + 1);
+    if (dir == NULL)
+        return UNZ_INTERNALERROR;
+    if (ZSEEK64(s->z_filefunc, s->filestream,
+                s->offset_central_dir+s->byte_before_the_zipfile,
+                ZLIB_FILEFUNC_SEEK_SET)!=0 ||
+        ZREAD64(s->z_filefunc, s->filestream, dir, (uLong)size) != size)
+    {
+        free(dir);
+        return UNZ_ERRNO;
+    }
+
+    /* count the files, checking that each header is complete -- read all of
+       them if there may be more than 65535 (see unzGoToNextFile()) */
+    count = 0;
+    at = 0;
+    while (at + SIZECENTRALDIRITEM <= size &&
+           (s->gi.number_entry == 0xffff || count < s->gi.number_entry))
+    {
+        if (INDEX_LONG(dir + at) != 0x02014b50)
+            break;
+        at += SIZECENTRALDIRITEM + INDEX_SHORT(dir + at + 28) +
+              INDEX_SHORT(dir + at + 30) + INDEX_SHORT(dir + at + 32);
+        count++;
+    }
+    if (at > size ||
+        (s->gi.number_entry != 0xffff && count != s->gi.number_entry) ||
+        count > 0x3fffffffUL)
+    {
+        free(dir);
+        return count > 0x3fffffffUL ? UNZ_INTERNALERROR : UNZ_BADZIPFILE;
+    }
+
+    /* make a hash table at least twice the number of files */
+    mask = 1;
+    while (mask < 2 * count)
+        mask <<= 1;
+    pos = (ZPOS64_T*)ALLOC(((size_t)count + 1) * sizeof(ZPOS64_T));
+    hash = (uLong*)ALLOC((size_t)mask * sizeof(uLong));
+    if (pos == NULL || hash == NULL)
+    {
+        free(hash);
+        free(pos);
+        free(dir);
+        return UNZ_INTERNALERROR;
+    }
+    mask--;
+    memset(hash, 0, (mask + 1) * sizeof(uLong));
+
+    /* insert the files in order, so that the first of any files with the same
+       name is found first, as unzLocateFile() finds without the index */
+    at = 0;
+    for (n = 0; n < count; n++)
+    {
+        uLong len = INDEX_SHORT(dir + at + 28), slot;
+
+        pos[n] = at;
+        slot = unz64local_HashName((char*)dir + at + SIZECENTRALDIRITEM,
+                                   len) & mask;
+        while (hash[slot])
+            slot = (slot + 1) & mask;
+        hash[slot] = (uLong)n + 1;
+        at += SIZECENTRALDIRITEM + len + INDEX_SHORT(dir + at + 30) +
+              INDEX_SHORT(dir + at + 32);
+    }
+    s->index_dir = dir;
+    s->index_pos = pos;
+    s->index_count = count;
+    s->index_hash = hash;
+    s->index_mask = mask;
+    s->index_owner = 1;
+    return UNZ_OK;
+}
+
+extern unzFile ZEXPORT unzOpenReader(unzFile file, const void *path) {
+    unz64_s* s;
+    unz64_s* r;
+
+    if (file==NULL)
+        return NULL;
+    s=(unz64_s*)file;
+    r=(unz64_s*)ALLOC(sizeof(unz64_s));
+    if (r==NULL)
+        return NULL;
+    *r=*s;
+    r->filestream = ZOPEN64(r->z_filefunc, path,
+                            ZLIB_FILEFUNC_MODE_READ |
+                            ZLIB_FILEFUNC_MODE_EXISTING);
+    if (r->filestream==NULL)
+    {
+        free(r);
+        return NULL;
+    }
+    r->pfile_in_zip_read = NULL;
+    r->encrypted = 0;
+    r->index_owner = 0;
+    unzGoToFirstFile((unzFile)r);
+    return (unzFile)r;
+}
+
+extern int ZEXPORT unzGoToFileNumber(unzFile file, ZPOS64_T number) {
+    unz64_s* s;
+    int err;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    if (s->index_hash == NULL)
+    {
+        /* step to the file, and go back to the current file if there is no
+           such file */
+        unz_file_info64 cur_file_infoSaved = s->cur_file_info;
+        unz_file_info64_internal cur_file_info_internalSaved =
+            s->cur_file_info_internal;
+        ZPOS64_T num_fileSaved = s->num_file;
+        ZPOS64_T pos_in_central_dirSaved = s->pos_in_central_dir;
+        ZPOS64_T current_file_okSaved = s->current_file_ok;
+
+        err = unzGoToFirstFile(file);
+        while (err == UNZ_OK && s->num_file < number)
+            err = unzGoToNextFile(file);
+        if (err == UNZ_END_OF_LIST_OF_FILE)
+        {
+            s->num_file = num_fileSaved;
+            s->pos_in_central_dir = pos_in_central_dirSaved;
+            s->cur_file_info = cur_file_infoSaved;
+            s->cur_file_info_internal = cur_file_info_internalSaved;
+            s->current_file_ok = current_file_okSaved;
+        }
+        return err;
+    }
+    if (number >= s->index_count)
+        return UNZ_END_OF_LIST_OF_FILE;
+    s->pos_in_central_dir = s->offset_central_dir + s->index_pos[number];
+    s->num_file = number;
+    err = unz64local_GetCurrentFileInfoInternal(file,&s->cur_file_info,
+                                               &s->cur_file_info_internal,
+                                               NULL,0,NULL,0,NULL,0);
+    s->current_file_ok = (err == UNZ_OK);
+    return err;
+}
+
+/*
+  unzLocateFile() using the index. The name of each candidate is compared just
+  as unzLocateFile() compares it without the index.
+*/
+local int unz64local_LocateIndexed(unz64_s* s, const char *szFileName,
+                                   int iCaseSensitivity) {
+    uLong slot = unz64local_HashName(szFileName, UNZ_MAXFILENAMEINZIP) &
+                 s->index_mask;
+
+    while (s->index_hash[slot])
+    {
+        ZPOS64_T n = s->index_hash[slot] - 1;
+        const unsigned char* entry = INDEX_ENTRY(s, n);
+        char szCurrentFileName[UNZ_MAXFILENAMEINZIP+1];
+        uLong len = INDEX_SHORT(entry + 28);
+
+        if (len > sizeof(szCurrentFileName)-1)
+            len = sizeof(szCurrentFileName)-1;
+        memcpy(szCurrentFileName, entry + SIZECENTRALDIRITEM, len);
+        szCurrentFileName[len] = '\0';
+        if (unzStringFileNameCompare(szCurrentFileName,
+                                     szFileName,iCaseSensitivity)==0)
+            return unzGoToFileNumber((unzFile)s, n);
+        slot = (slot + 1) & s->index_mask;
+    }
+    return UNZ_END_OF_LIST_OF_FILE;
+}
+
 /*
   Try locate the file szFileName in the zipfile.
   For the iCaseSensitivity signification, see unzStringFileNameCompare
@@ -1129,6 +1613,9 @@ extern int ZEXPORT unzLocateFile(unzFile file, const char *szFileName, int iCase
     if (!s->current_file_ok)
         return UNZ_END_OF_LIST_OF_FILE;
 
+    if (s->index_hash != NULL)
+        return unz64local_LocateIndexed(s, szFileName, iCaseSensitivity);
+
     /* Save the current state */
     num_fileSaved = s->num_file;
     pos_in_central_dirSaved = s->pos_in_central_dir;
@@ -1293,6 +1780,9 @@ local int unz64local_CheckCurrentFileCoherencyHeader(unz64_s* s, uInt* piSizeVar
 /* #ifdef HAVE_BZIP2 */
                          (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
 /* #endif */
+#ifdef HAVE_INFBACK9
+                         (s->cur_file_info.compression_method!=Z_DEFLATE64ED) &&
+#endif
                          (s->cur_file_info.compression_method!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
@@ -1332,6 +1822,42 @@ local int unz64local_CheckCurrentFileCoherencyHeader(unz64_s* s, uInt* piSizeVar
     return err;
 }
 
+/*
+  Set the size of the buffer for compressed data, for files opened after this.
+*/
+extern int ZEXPORT unzSetBufferSize(unzFile file, unsigned size) {
+    unz64_s* s;
+    if (file==NULL || size==0)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->read_size = (uInt)size;
+    return UNZ_OK;
+}
+
+/*
+  Set the number of read-ahead buffers, for files opened after this.
+*/
+extern int ZEXPORT unzSetReadAhead(unzFile file, unsigned buffers) {
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->ahead_count = buffers;
+    return UNZ_OK;
+}
+
+/*
+  Set the distance between access points, for files opened after this.
+*/
+extern int ZEXPORT unzSetSeekSpan(unzFile file, ZPOS64_T span) {
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->span = span;
+    return UNZ_OK;
+}
+
 /*
   Open for reading data the current file in the zipfile.
   If there is no error and the file is opened, the return value is UNZ_OK.
@@ -1367,7 +1893,16 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
     if (pfile_in_zip_read_info==NULL)
         return UNZ_INTERNALERROR;
 
-    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
+    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(s->read_size);
+    pfile_in_zip_read_info->read_size = s->read_size;
+    pfile_in_zip_read_info->ahead = NULL;
+    pfile_in_zip_read_info->ahead_count = s->ahead_count;
+    pfile_in_zip_read_info->seeked = 0;
+    pfile_in_zip_read_info->span = 0;
+    pfile_in_zip_read_info->points = NULL;
+    pfile_in_zip_read_info->points_have = 0;
+    pfile_in_zip_read_info->points_size = 0;
+    pfile_in_zip_read_info->ckpt_buffer = NULL;
     pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
     pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
     pfile_in_zip_read_info->pos_local_extrafield=0;
@@ -1380,6 +1915,9 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
     }
 
     pfile_in_zip_read_info->stream_initialised=0;
+#ifdef HAVE_INFBACK9
+    pfile_in_zip_read_info->deflate64_buffer=NULL;
+#endif
 
     if (method!=NULL)
         *method = (int)s->cur_file_info.compression_method;
@@ -1399,6 +1937,9 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
 /* #ifdef HAVE_BZIP2 */
         (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
 /* #endif */
+#ifdef HAVE_INFBACK9
+        (s->cur_file_info.compression_method!=Z_DEFLATE64ED) &&
+#endif
         (s->cur_file_info.compression_method!=Z_DEFLATED))
 
         err=UNZ_BADZIPFILE;
@@ -1502,6 +2043,14 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
     }
 #    endif
 
+    pfile_in_zip_read_info->pos_data = pfile_in_zip_read_info->pos_in_zipfile;
+    pfile_in_zip_read_info->size_compressed =
+        pfile_in_zip_read_info->rest_read_compressed;
+    pfile_in_zip_read_info->size_uncompressed =
+        pfile_in_zip_read_info->rest_read_uncompressed;
+    if ((pfile_in_zip_read_info->stream_initialised==Z_DEFLATED) &&
+        (!s->encrypted))
+        pfile_in_zip_read_info->span = s->span;
 
     return UNZ_OK;
 }
@@ -1535,6 +2084,226 @@ extern ZPOS64_T ZEXPORT unzGetCurrentFileZStreamPos64(unzFile file) {
 
 /** Addition for GDAL : END */
 
+/*
+  Load the next piece of the compressed data of the file being read at
+  stream.next_in and stream.avail_in, which must have been used up, from the
+  read-ahead buffers if reading ahead, or else by reading it into read_buffer.
+  Return UNZ_OK, UNZ_EOF if there is no more, or UNZ_ERRNO.
+*/
+local int unz64local_Fill(unz64_s* s) {
+    file_in_zip64_read_info_s* pfile_in_zip_read_info=s->pfile_in_zip_read;
+    Bytef* buf = (Bytef*)pfile_in_zip_read_info->read_buffer;
+    uInt uReadThis = pfile_in_zip_read_info->read_size;
+    if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
+        uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
+    if (uReadThis == 0)
+        return UNZ_EOF;
+
+#ifdef UNZ_THREADS
+    unz64local_StartAhead(pfile_in_zip_read_info);
+    if (pfile_in_zip_read_info->ahead != NULL)
+    {
+        struct unz_ahead_s* ring = pfile_in_zip_read_info->ahead;
+        unz_lock(&ring->lock);
+        if (ring->done)
+        {
+            ring->tail++;
+            ring->done = 0;
+            unz_wake(&ring->cond);
+        }
+        while (ring->head == ring->tail && !ring->err)
+            unz_wait(&ring->cond, &ring->lock);
+        if (ring->head == ring->tail)
+        {
+            unz_unlock(&ring->lock);
+            return UNZ_ERRNO;
+        }
+        unz_unlock(&ring->lock);
+        buf = ring->buf + (size_t)(ring->tail % ring->count) * ring->size;
+        uReadThis = ring->len[ring->tail % ring->count];
+        ring->done = 1;
+    }
+    else
+#endif
+    {
+        if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
+                  pfile_in_zip_read_info->filestream,
+                  pfile_in_zip_read_info->pos_in_zipfile +
+                     pfile_in_zip_read_info->byte_before_the_zipfile,
+                     ZLIB_FILEFUNC_SEEK_SET)!=0)
+            return UNZ_ERRNO;
+        if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
+                  pfile_in_zip_read_info->filestream,
+                  buf, uReadThis)!=uReadThis)
+            return UNZ_ERRNO;
+    }
+
+#    ifndef NOUNCRYPT
+    if(s->encrypted)
+    {
+        uInt i;
+        for(i=0;i<uReadThis;i++)
+          buf[i] = (Bytef)zdecode(s->keys,s->pcrc_32_tab,buf[i]);
+    }
+#    endif
+
+    pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
+    pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
+    pfile_in_zip_read_info->stream.next_in = buf;
+    pfile_in_zip_read_info->stream.avail_in = uReadThis;
+    return UNZ_OK;
+}
+
+#ifdef HAVE_INFBACK9
+/*
+  inflateBack9() only has a call-back interface, which runs until the end of
+  the entry, so a deflate64 entry is inflated whole into a buffer the size of
+  its uncompressed data on the first read.  inflateBack9() decodes most of it
+  with inflate_fast9(), at about the speed of inflate().  unzReadCurrentFile()
+  then reads from that buffer the way it reads a stored entry.
+*/
+local unsigned unz64local_in9(void FAR *desc, z_const unsigned char FAR * FAR *buf) {
+    unz64_s* s=(unz64_s*)desc;
+    file_in_zip64_read_info_s* pfile_in_zip_read_info=s->pfile_in_zip_read;
+    uInt uReadThis;
+    if (unz64local_Fill(s)!=UNZ_OK)
+        return 0;
+    uReadThis = pfile_in_zip_read_info->stream.avail_in;
+    *buf = (z_const unsigned char FAR *)pfile_in_zip_read_info->stream.next_in;
+    pfile_in_zip_read_info->stream.avail_in = 0;
+    return uReadThis;
+}
+
+local int unz64local_out9(void FAR *desc, unsigned char FAR *buf, unsigned len) {
+    file_in_zip64_read_info_s* pfile_in_zip_read_info=(file_in_zip64_read_info_s*)desc;
+    if (len > pfile_in_zip_read_info->deflate64_size -
+              pfile_in_zip_read_info->deflate64_have)
+        return 1;
+    memcpy(pfile_in_zip_read_info->deflate64_buffer +
+           pfile_in_zip_read_info->deflate64_have, buf, len);
+    pfile_in_zip_read_info->deflate64_have += len;
+    return 0;
+}
+
+local int unz64local_inflate9(unz64_s* s) {
+    file_in_zip64_read_info_s* pfile_in_zip_read_info=s->pfile_in_zip_read;
+    unsigned char* window;
+    z_stream stream;
+    int err;
+
+    if (pfile_in_zip_read_info->rest_read_uncompressed > (uInt)-1 - 1)
+        return UNZ_INTERNALERROR;
+    pfile_in_zip_read_info->deflate64_size =
+        (uInt)pfile_in_zip_read_info->rest_read_uncompressed;
+    pfile_in_zip_read_info->deflate64_have = 0;
+    /* one more byte, so that an empty entry is not a NULL buffer */
+    pfile_in_zip_read_info->deflate64_buffer =
+        (unsigned char*)ALLOC(pfile_in_zip_read_info->deflate64_size + 1);
+    window = (unsigned char*)ALLOC(65536L);
+    if (pfile_in_zip_read_info->deflate64_buffer==NULL || window==NULL)
+    {
+        free(window);
+        return UNZ_INTERNALERROR;
+    }
+
+    stream.zalloc = (alloc_func)0;
+    stream.zfree = (free_func)0;
+    stream.opaque = (voidpf)0;
+    err=inflateBack9Init(&stream, window);
+    if (err==Z_OK)
+    {
+        stream.next_in = Z_NULL;
+        stream.avail_in = 0;
+        err=inflateBack9(&stream, unz64local_in9, s,
+                         unz64local_out9, pfile_in_zip_read_info);
+        inflateBack9End(&stream);
+        if (err==Z_STREAM_END)
+            err=UNZ_OK;
+        else if ((err==Z_BUF_ERROR) && (stream.next_in==Z_NULL) &&
+                 (pfile_in_zip_read_info->rest_read_compressed!=0))
+            err=UNZ_ERRNO;              /* in() could not read the zipfile */
+        else if (err==Z_BUF_ERROR)
+            err=Z_DATA_ERROR;           /* truncated, or longer than said */
+    }
+    free(window);
+    unz64local_StopAhead(s);
+    if (err!=UNZ_OK)
+        return err;
+
+    /* the copy in unzReadCurrentFile() now takes from the inflated data */
+    pfile_in_zip_read_info->rest_read_compressed = 0;
+    pfile_in_zip_read_info->stream.next_in =
+        (Bytef*)pfile_in_zip_read_info->deflate64_buffer;
+    pfile_in_zip_read_info->stream.avail_in =
+        pfile_in_zip_read_info->deflate64_have;
+    return UNZ_OK;
+}
+#endif
+
+/*
+  Save an access point for unzSeek64() if inflate() is at the start of a
+  deflate block, at least span bytes after the last access point.  If there
+  is not the memory for it, give up on saving access points for this file.
+*/
+local void unz64local_AddPoint(file_in_zip64_read_info_s* pfile_in_zip_read_info) {
+    unz_point* point;
+    uLong len, clen;
+    uInt have = pfile_in_zip_read_info->points_have;
+
+    if (((pfile_in_zip_read_info->stream.data_type & 0xc0) != 0x80) ||
+        (pfile_in_zip_read_info->total_out_64 <
+            (have ? pfile_in_zip_read_info->points[have - 1].out : 0) +
+            pfile_in_zip_read_info->span))
+        return;
+    if (pfile_in_zip_read_info->ckpt_buffer==NULL)
+    {
+        pfile_in_zip_read_info->ckpt_buffer =
+            (unsigned char*)ALLOC(UNZ_CKPT);
+        if (pfile_in_zip_read_info->ckpt_buffer==NULL)
+        {
+            pfile_in_zip_read_info->span = 0;
+            return;
+        }
+    }
+    len = UNZ_CKPT;
+    if (inflateCheckpoint(&pfile_in_zip_read_info->stream,
+                          pfile_in_zip_read_info->ckpt_buffer, &len) != Z_OK)
+        return;
+    if (have == pfile_in_zip_read_info->points_size)
+    {
+        uInt size = have ? have << 1 : 64;
+        point = (size < have) ||
+                (size * sizeof(unz_point) / sizeof(unz_point) != size) ? NULL :
+            (unz_point*)realloc(pfile_in_zip_read_info->points,
+                                size * sizeof(unz_point));
+        if (point==NULL)
+        {
+            pfile_in_zip_read_info->span = 0;
+            return;
+        }
+        pfile_in_zip_read_info->points = point;
+        pfile_in_zip_read_info->points_size = size;
+    }
+    point = pfile_in_zip_read_info->points + have;
+    clen = compressBound(len);
+    point->ckpt = (unsigned char*)ALLOC(clen);
+    if (point->ckpt==NULL ||
+        compress2(point->ckpt, &clen, pfile_in_zip_read_info->ckpt_buffer,
+                  len, 1) != Z_OK)
+    {
+        free(point->ckpt);
+        pfile_in_zip_read_info->span = 0;
+        return;
+    }
+    point->in = pfile_in_zip_read_info->pos_in_zipfile -
+                pfile_in_zip_read_info->pos_data -
+                pfile_in_zip_read_info->stream.avail_in;
+    point->out = pfile_in_zip_read_info->total_out_64;
+    point->len = len;
+    point->clen = clen;
+    pfile_in_zip_read_info->points_have++;
+}
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -1564,6 +2333,17 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
     if (len==0)
         return 0;
 
+#ifdef HAVE_INFBACK9
+    if ((pfile_in_zip_read_info->compression_method==Z_DEFLATE64ED) &&
+        (!pfile_in_zip_read_info->raw) &&
+        (pfile_in_zip_read_info->deflate64_buffer==NULL))
+    {
+        err=unz64local_inflate9(s);
+        if (err!=UNZ_OK)
+            return err;
+    }
+#endif
+
     pfile_in_zip_read_info->stream.next_out = (Bytef*)buf;
 
     pfile_in_zip_read_info->stream.avail_out = (uInt)len;
@@ -1583,13 +2363,18 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
     while (pfile_in_zip_read_info->stream.avail_out>0)
     {
         if ((pfile_in_zip_read_info->stream.avail_in==0) &&
-            (pfile_in_zip_read_info->rest_read_compressed>0))
+            (pfile_in_zip_read_info->rest_read_compressed>0) &&
+            (pfile_in_zip_read_info->stream.avail_out>=
+                pfile_in_zip_read_info->read_size) &&
+            ((pfile_in_zip_read_info->compression_method==0) ||
+             (pfile_in_zip_read_info->raw)) &&
+            (!s->encrypted) && (pfile_in_zip_read_info->ahead_count==0))
         {
-            uInt uReadThis = UNZ_BUFSIZE;
+            /* copying stored or raw data, so read it directly into buf in
+               one large read, instead of read_size at a time */
+            uInt uReadThis = pfile_in_zip_read_info->stream.avail_out;
             if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
                 uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
-            if (uReadThis == 0)
-                return UNZ_EOF;
             if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
                       pfile_in_zip_read_info->filestream,
                       pfile_in_zip_read_info->pos_in_zipfile +
@@ -1598,33 +2383,36 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
                 return UNZ_ERRNO;
             if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
                       pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->read_buffer,
+                      pfile_in_zip_read_info->stream.next_out,
                       uReadThis)!=uReadThis)
                 return UNZ_ERRNO;
-
-
-#            ifndef NOUNCRYPT
-            if(s->encrypted)
-            {
-                uInt i;
-                for(i=0;i<uReadThis;i++)
-                  pfile_in_zip_read_info->read_buffer[i] =
-                      (char)zdecode(s->keys,s->pcrc_32_tab,
-                              pfile_in_zip_read_info->read_buffer[i]);
-            }
-#            endif
-
-
             pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
-
             pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
+            pfile_in_zip_read_info->total_out_64 += uReadThis;
+            pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,
+                                pfile_in_zip_read_info->stream.next_out,
+                                uReadThis);
+            pfile_in_zip_read_info->rest_read_uncompressed-=uReadThis;
+            pfile_in_zip_read_info->stream.avail_out -= uReadThis;
+            pfile_in_zip_read_info->stream.next_out += uReadThis;
+            pfile_in_zip_read_info->stream.total_out += uReadThis;
+            iRead += uReadThis;
+            continue;
+        }
 
-            pfile_in_zip_read_info->stream.next_in =
-                (Bytef*)pfile_in_zip_read_info->read_buffer;
-            pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+        if ((pfile_in_zip_read_info->stream.avail_in==0) &&
+            (pfile_in_zip_read_info->rest_read_compressed>0))
+        {
+            err=unz64local_Fill(s);
+            if (err!=UNZ_OK)
+                return err;
         }
 
-        if ((pfile_in_zip_read_info->compression_method==0) || (pfile_in_zip_read_info->raw))
+        if ((pfile_in_zip_read_info->compression_method==0) ||
+#ifdef HAVE_INFBACK9
+            (pfile_in_zip_read_info->compression_method==Z_DEFLATE64ED) ||
+#endif
+            (pfile_in_zip_read_info->raw))
         {
             uInt uDoCopy,i ;
 
@@ -1703,7 +2491,7 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
             ZPOS64_T uTotalOutBefore,uTotalOutAfter;
             const Bytef *bufBefore;
             ZPOS64_T uOutThis;
-            int flush=Z_SYNC_FLUSH;
+            int flush=pfile_in_zip_read_info->span ? Z_BLOCK : Z_SYNC_FLUSH;
 
             uTotalOutBefore = pfile_in_zip_read_info->stream.total_out;
             bufBefore = pfile_in_zip_read_info->stream.next_out;
@@ -1736,6 +2524,8 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
 
             iRead += (uInt)(uTotalOutAfter - uTotalOutBefore);
 
+            if ((err==Z_OK) && (pfile_in_zip_read_info->span))
+                unz64local_AddPoint(pfile_in_zip_read_info);
             if (err==Z_STREAM_END)
                 return (iRead==0) ? UNZ_EOF : (int)iRead;
             if (err!=Z_OK)
@@ -1752,6 +2542,46 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, unsigned len) {
 /*
   Give the current position in uncompressed data
 */
+/*
+  Return the rest of the current file where it is mapped in memory, which is
+  what unzReadCurrentFile() would copy out for a stored or raw file.
+*/
+extern int ZEXPORT unzGetCurrentFileData(unzFile file, const void** data, ZPOS64_T* len) {
+    unz64_s* s;
+    file_in_zip64_read_info_s* pfile_in_zip_read_info;
+    const unsigned char* base;
+    ZPOS64_T size, pos, rest;
+    if (file==NULL || data==NULL || len==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+    if (pfile_in_zip_read_info==NULL)
+        return UNZ_PARAMERROR;
+    if ((pfile_in_zip_read_info->compression_method!=0 &&
+         !pfile_in_zip_read_info->raw) || s->encrypted)
+        return UNZ_PARAMERROR;
+    base = (const unsigned char*)call_zmap64(&pfile_in_zip_read_info->z_filefunc,
+                                             pfile_in_zip_read_info->filestream,
+                                             &size);
+    if (base==NULL)
+        return UNZ_PARAMERROR;
+
+    /* what is left in read_buffer comes just before pos_in_zipfile */
+    pos = pfile_in_zip_read_info->pos_in_zipfile +
+          pfile_in_zip_read_info->byte_before_the_zipfile -
+          pfile_in_zip_read_info->stream.avail_in;
+    rest = pfile_in_zip_read_info->rest_read_compressed +
+           pfile_in_zip_read_info->stream.avail_in;
+    if (!pfile_in_zip_read_info->raw &&
+        rest > pfile_in_zip_read_info->rest_read_uncompressed)
+        rest = pfile_in_zip_read_info->rest_read_uncompressed;
+    if (pos > size || rest > size - pos)
+        return UNZ_BADZIPFILE;
+    *data = base + pos;
+    *len = rest;
+    return UNZ_OK;
+}
+
 extern z_off_t ZEXPORT unztell(unzFile file) {
     unz64_s* s;
     file_in_zip64_read_info_s* pfile_in_zip_read_info;
@@ -1782,6 +2612,161 @@ extern ZPOS64_T ZEXPORT unztell64(unzFile file) {
 }
 
 
+/*
+  Go to offset pos in the uncompressed data of the current file, from an
+  access point if there is one before pos, or else by decompressing up to pos.
+*/
+extern int ZEXPORT unzSeek64(unzFile file, ZPOS64_T pos) {
+    unz64_s* s;
+    file_in_zip64_read_info_s* pfile_in_zip_read_info;
+    char* skip;
+    int err;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return UNZ_PARAMERROR;
+    if (pos > (pfile_in_zip_read_info->raw ?
+                 pfile_in_zip_read_info->size_compressed :
+                 pfile_in_zip_read_info->size_uncompressed))
+        return UNZ_PARAMERROR;
+    if (pos == pfile_in_zip_read_info->total_out_64)
+        return UNZ_OK;
+
+#ifdef HAVE_INFBACK9
+    if ((pfile_in_zip_read_info->compression_method==Z_DEFLATE64ED) &&
+        (!pfile_in_zip_read_info->raw))
+    {
+        /* deflate64 data is at pos in deflate64_buffer */
+        if (pfile_in_zip_read_info->deflate64_buffer==NULL)
+        {
+            err=unz64local_inflate9(s);
+            if (err!=UNZ_OK)
+                return err;
+        }
+        if (pos > pfile_in_zip_read_info->deflate64_have)
+            return UNZ_BADZIPFILE;
+        pfile_in_zip_read_info->stream.next_in =
+            (Bytef*)pfile_in_zip_read_info->deflate64_buffer + pos;
+        pfile_in_zip_read_info->stream.avail_in =
+            pfile_in_zip_read_info->deflate64_have - (uInt)pos;
+        pfile_in_zip_read_info->rest_read_uncompressed =
+            pfile_in_zip_read_info->size_uncompressed - pos;
+        pfile_in_zip_read_info->total_out_64 = pos;
+        pfile_in_zip_read_info->crc32 = 0;
+        pfile_in_zip_read_info->seeked = pos != 0;
+        return UNZ_OK;
+    }
+#endif
+
+    if (((pfile_in_zip_read_info->compression_method==0) ||
+         (pfile_in_zip_read_info->raw)) && (!s->encrypted))
+    {
+        /* stored or raw data is at pos in the zipfile */
+        unz64local_StopAhead(s);
+        pfile_in_zip_read_info->pos_in_zipfile =
+            pfile_in_zip_read_info->pos_data + pos;
+        pfile_in_zip_read_info->rest_read_compressed =
+            pfile_in_zip_read_info->size_compressed - pos;
+        pfile_in_zip_read_info->rest_read_uncompressed =
+            pfile_in_zip_read_info->size_uncompressed - pos;
+        pfile_in_zip_read_info->stream.avail_in = 0;
+        pfile_in_zip_read_info->total_out_64 = pos;
+        pfile_in_zip_read_info->crc32 = 0;
+        pfile_in_zip_read_info->seeked = pos != 0;
+        return UNZ_OK;
+    }
+
+    if (pfile_in_zip_read_info->stream_initialised==Z_DEFLATED)
+    {
+        /* find the last access point at or before pos */
+        unz_point* point = NULL;
+        uInt lo = 0, hi = pfile_in_zip_read_info->points_have, mid;
+        while (lo < hi)
+        {
+            mid = lo + ((hi - lo) >> 1);
+            if (pfile_in_zip_read_info->points[mid].out <= pos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo)
+            point = pfile_in_zip_read_info->points + lo - 1;
+
+        if ((point!=NULL) &&
+            ((pos < pfile_in_zip_read_info->total_out_64) ||
+             (point->out > pfile_in_zip_read_info->total_out_64)))
+        {
+            /* resume decompression from the access point */
+            uLong len = point->len;
+            if ((uncompress(pfile_in_zip_read_info->ckpt_buffer, &len,
+                            point->ckpt, point->clen) != Z_OK) ||
+                (len != point->len))
+                return UNZ_INTERNALERROR;
+            unz64local_StopAhead(s);
+            if (inflateRestore(&pfile_in_zip_read_info->stream,
+                               pfile_in_zip_read_info->ckpt_buffer, len) != Z_OK)
+                return UNZ_INTERNALERROR;
+            pfile_in_zip_read_info->pos_in_zipfile =
+                pfile_in_zip_read_info->pos_data + point->in;
+            pfile_in_zip_read_info->rest_read_compressed =
+                pfile_in_zip_read_info->size_compressed - point->in;
+            pfile_in_zip_read_info->rest_read_uncompressed =
+                pfile_in_zip_read_info->size_uncompressed - point->out;
+            pfile_in_zip_read_info->stream.avail_in = 0;
+            pfile_in_zip_read_info->total_out_64 = point->out;
+            pfile_in_zip_read_info->seeked = 1;
+        }
+        else if (pos < pfile_in_zip_read_info->total_out_64)
+        {
+            /* start over from the beginning, which the keys can't do */
+            if (s->encrypted)
+                return UNZ_PARAMERROR;
+            unz64local_StopAhead(s);
+            if (inflateReset(&pfile_in_zip_read_info->stream) != Z_OK)
+                return UNZ_INTERNALERROR;
+            pfile_in_zip_read_info->pos_in_zipfile =
+                pfile_in_zip_read_info->pos_data;
+            pfile_in_zip_read_info->rest_read_compressed =
+                pfile_in_zip_read_info->size_compressed;
+            pfile_in_zip_read_info->rest_read_uncompressed =
+                pfile_in_zip_read_info->size_uncompressed;
+            pfile_in_zip_read_info->stream.avail_in = 0;
+            pfile_in_zip_read_info->total_out_64 = 0;
+            pfile_in_zip_read_info->crc32 = 0;
+            pfile_in_zip_read_info->seeked = 0;
+        }
+    }
+    else if (pos < pfile_in_zip_read_info->total_out_64)
+        return UNZ_PARAMERROR;
+
+    /* decompress and discard the data up to pos */
+    if (pos == pfile_in_zip_read_info->total_out_64)
+        return UNZ_OK;
+    skip = (char*)ALLOC(UNZ_BUFSIZE);
+    if (skip==NULL)
+        return UNZ_INTERNALERROR;
+    err = UNZ_OK;
+    while (pfile_in_zip_read_info->total_out_64 < pos)
+    {
+        uInt uSkipThis = UNZ_BUFSIZE;
+        if (pos - pfile_in_zip_read_info->total_out_64 < uSkipThis)
+            uSkipThis = (uInt)(pos - pfile_in_zip_read_info->total_out_64);
+        err = unzReadCurrentFile(file, skip, uSkipThis);
+        if (err <= 0)
+        {
+            if (err == 0)
+                err = UNZ_BADZIPFILE;
+            break;
+        }
+        err = UNZ_OK;
+    }
+    free(skip);
+    return err;
+}
+
 /*
   return 1 if the end of file was reached, 0 elsewhere
 */
@@ -1843,6 +2828,7 @@ extern int ZEXPORT unzGetLocalExtrafield(unzFile file, voidp buf, unsigned len)
 
     if (read_now==0)
         return 0;
+    unz64local_StopAhead(s);
 
     if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
               pfile_in_zip_read_info->filestream,
@@ -1877,14 +2863,21 @@ extern int ZEXPORT unzCloseCurrentFile(unzFile file) {
         return UNZ_PARAMERROR;
 
 
+    unz64local_StopAhead(s);
+
     if ((pfile_in_zip_read_info->rest_read_uncompressed == 0) &&
-        (!pfile_in_zip_read_info->raw))
+        (!pfile_in_zip_read_info->raw) && (!pfile_in_zip_read_info->seeked))
     {
         if (pfile_in_zip_read_info->crc32 != pfile_in_zip_read_info->crc32_wait)
             err=UNZ_CRCERROR;
     }
 
 
+    while (pfile_in_zip_read_info->points_have)
+        free(pfile_in_zip_read_info->points[
+                 --pfile_in_zip_read_info->points_have].ckpt);
+    free(pfile_in_zip_read_info->points);
+    free(pfile_in_zip_read_info->ckpt_buffer);
     free(pfile_in_zip_read_info->read_buffer);
     pfile_in_zip_read_info->read_buffer = NULL;
     if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
@@ -1893,6 +2886,9 @@ extern int ZEXPORT unzCloseCurrentFile(unzFile file) {
     else if (pfile_in_zip_read_info->stream_initialised == Z_BZIP2ED)
         BZ2_bzDecompressEnd(&pfile_in_zip_read_info->bstream);
 #endif
+#ifdef HAVE_INFBACK9
+    free(pfile_in_zip_read_info->deflate64_buffer);
+#endif
 
 
     pfile_in_zip_read_info->stream_initialised = 0;
@@ -1915,6 +2911,7 @@ extern int ZEXPORT unzGetGlobalComment(unzFile file, char * szComment, uLong uSi
     if (file==NULL)
         return (int)UNZ_PARAMERROR;
     s=(unz64_s*)file;
+    unz64local_StopAhead(s);
 
     uReadThis = uSizeBuf;
     if (uReadThis>s->gi.size_comment)
@@ -61,6 +61,10 @@ extern "C" {
 
 #define Z_BZIP2ED 12
 
+/* Deflate64 entries can be read when unzip.c is compiled with HAVE_INFBACK9
+   and linked with contrib/infback9 -- see unzReadCurrentFile() */
+#define Z_DEFLATE64ED 9
+
 #if defined(STRICTUNZIP) || defined(STRICTZIPUNZIP)
 /* like the STRICT of WIN32, we define a pointer that cannot be converted
     from (void*) without cast */
@@ -251,6 +255,79 @@ extern int ZEXPORT unzLocateFile(unzFile file,
   UNZ_END_OF_LIST_OF_FILE if the file is not found
 */
 
+extern int ZEXPORT unzIndex(unzFile file);
+/*
+  Read the whole central directory into memory with one read, and index the
+    files by name and by number, for unzLocateFile() and unzGoToFileNumber().
+    Call it once after opening a zipfile with many files that will be looked
+    up.  The index uses about the size of the central directory plus 16 bytes
+    per file in memory, and is freed by unzClose().
+  return UNZ_OK if the index was built or already exists,
+    UNZ_BADZIPFILE if the central directory is not consistent,
+    UNZ_ERRNO if it could not be read, or UNZ_INTERNALERROR if out of memory.
+    unzip works as before without the index if it could not be built.
+*/
+
+extern unzFile ZEXPORT unzOpenReader(unzFile file, const void *path);
+/*
+  Open another handle to the zipfile open as file, for reading files from the
+    zipfile in another thread at the same time.  path must name the same
+    zipfile as when file was opened, and is opened again with the same file
+    functions, giving the new handle its own file position and current file.
+    The central directory information, and the index from unzIndex() if it
+    was made, are shared instead of read again.  Each handle may be used by
+    only one thread at a time, and unzOpenReader() must be called in the
+    thread using file.  The handle is closed with unzClose(), and all of them
+    must be closed before file, which is where the index is kept.
+  return NULL if path could not be opened, or the new handle, with the first
+    file as the current file.
+*/
+
+extern int ZEXPORT unzGoToFileNumber(unzFile file, ZPOS64_T number);
+/*
+  Set the current file of the zipfile to the file with the given number,
+    counting from zero in the order of the central directory.  This is
+    immediate if unzIndex() was called, otherwise the preceding files are
+    stepped over as with unzGoToNextFile().
+  return UNZ_OK if there is no problem
+  return UNZ_END_OF_LIST_OF_FILE if there are not that many files, in which
+    case the current file is unchanged.
+*/
+
+extern int ZEXPORT unzSetBufferSize(unzFile file, unsigned size);
+/*
+  Set the size of the buffer for the compressed data of the files opened
+    after this, and of each read from the zipfile for them.  The default is
+    16K.  A larger buffer makes fewer reads, which helps when the zipfile is
+    on a slow or remote file system.
+  return UNZ_OK, or UNZ_PARAMERROR if size is zero
+*/
+
+extern int ZEXPORT unzSetReadAhead(unzFile file, unsigned buffers);
+/*
+  Read the compressed data of the files opened after this ahead in another
+    thread, into as many as buffers buffers of the size set by
+    unzSetBufferSize(), while unzReadCurrentFile() decompresses.  Zero, the
+    default, reads in the calling thread.  The reading is stopped and restarted
+    around the other functions here that read the zipfile.  This does nothing
+    if minizip was compiled without threads (HAVE_PTHREAD on POSIX systems),
+    or if the zipfile was opened with the functions from
+    fill_mmap_filefunc64().  The zipfile functions are then called from the
+    read-ahead thread while it is running.
+  return UNZ_OK
+*/
+
+extern int ZEXPORT unzSetSeekSpan(unzFile file, ZPOS64_T span);
+/*
+  Save access points for unzSeek64() about every span bytes of uncompressed
+    data while reading the deflated files opened after this, so that seeking
+    to where that file has already been read decompresses at most about span
+    bytes.  Each access point takes up to 32K of memory, usually much less,
+    and is freed by unzCloseCurrentFile().  Zero, the default, saves none.  No
+    access points are saved for encrypted files.
+  return UNZ_OK
+*/
+
 
 /* ****************************************** */
 /* Ryan supplied functions */
@@ -394,6 +471,24 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file,
     (UNZ_ERRNO for IO error, or zLib error for uncompress error)
 */
 
+extern int ZEXPORT unzGetCurrentFileData(unzFile file,
+                                         const void** data,
+                                         ZPOS64_T* len);
+/*
+  Return in *data a pointer to the rest of the current file, and in *len its
+    length, without copying it, if the zipfile was opened with the functions
+    from fill_mmap_filefunc64() and the current file is stored (method 0),
+    or was opened with raw set in unzOpenCurrentFile2().  The data are the
+    bytes that unzReadCurrentFile() would return next, but this does not
+    advance the reading, nor check the CRC.  The pointer is good until the
+    zipfile is closed.
+
+  return UNZ_OK if the data are in memory
+  return UNZ_PARAMERROR if no file is open, or if the file is compressed and
+    not opened raw, is encrypted, or the zipfile is not mapped
+  return UNZ_BADZIPFILE if the file extends past the end of the zipfile
+*/
+
 extern z_off_t ZEXPORT unztell(unzFile file);
 
 extern ZPOS64_T ZEXPORT unztell64(unzFile file);
@@ -401,6 +496,26 @@ extern ZPOS64_T ZEXPORT unztell64(unzFile file);
   Give the current position in uncompressed data
 */
 
+extern int ZEXPORT unzSeek64(unzFile file, ZPOS64_T pos);
+/*
+  Set the position in the uncompressed data of the current file to pos, for
+    the next unzReadCurrentFile(), or in the compressed data if the file was
+    opened raw.  A stored or raw file that is not encrypted, or a deflate64
+    file, goes directly there.  A deflated file resumes from the last access
+    point at or before pos saved as set with unzSetSeekSpan(), if that is
+    ahead of the current position or pos is behind it, or else starts over
+    when pos is behind, and then decompresses up to pos.  Other files are
+    decompressed up to pos.
+    Since then not all of the file is read, the CRC is not checked by
+    unzCloseCurrentFile(), unless pos is zero, or the deflated file started
+    over.
+  return UNZ_OK if the current position is now pos
+  return UNZ_PARAMERROR if no file is open, if pos is past the end of the file,
+    or if pos is behind the current position of an encrypted file without an
+    access point, or of a bzip2 file
+  return an error from unzReadCurrentFile() if it fails on the way to pos
+*/
+
 extern int ZEXPORT unzeof(unzFile file);
 /*
   return 1 if the end of file was reached, 0 elsewhere
@@ -41,6 +41,50 @@
 #   include <errno.h>
 #endif
 
+/* threads for zipWriteFilesInZip(), from Windows, or POSIX if HAVE_PTHREAD */
+#ifndef NO_THREADS
+#  if defined(_WIN32)
+#    ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#    include <process.h>
+#    define ZIP_THREADS
+     typedef CRITICAL_SECTION zip_mutex;
+     typedef CONDITION_VARIABLE zip_cond;
+     typedef HANDLE zip_thread;
+#    define zip_mutex_init(m) InitializeCriticalSection(m)
+#    define zip_mutex_free(m) DeleteCriticalSection(m)
+#    define zip_lock(m) EnterCriticalSection(m)
+#    define zip_unlock(m) LeaveCriticalSection(m)
+#    define zip_cond_init(c) InitializeConditionVariable(c)
+#    define zip_cond_free(c)
+#    define zip_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#    define zip_wake(c) WakeAllConditionVariable(c)
+#    define ZIP_WORKER unsigned __stdcall
+#    define zip_start(t, run, arg) \
+        ((*(t) = (HANDLE)_beginthreadex(NULL, 0, run, arg, 0, NULL)) == 0)
+#    define zip_join(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#  elif defined(HAVE_PTHREAD)
+#    include <pthread.h>
+#    define ZIP_THREADS
+     typedef pthread_mutex_t zip_mutex;
+     typedef pthread_cond_t zip_cond;
+     typedef pthread_t zip_thread;
+#    define zip_mutex_init(m) pthread_mutex_init(m, NULL)
+#    define zip_mutex_free(m) pthread_mutex_destroy(m)
+#    define zip_lock(m) pthread_mutex_lock(m)
+#    define zip_unlock(m) pthread_mutex_unlock(m)
+#    define zip_cond_init(c) pthread_cond_init(c, NULL)
+#    define zip_cond_free(c) pthread_cond_destroy(c)
+#    define zip_wait(c, m) pthread_cond_wait(c, m)
+#    define zip_wake(c) pthread_cond_broadcast(c)
+#    define ZIP_WORKER void *
+#    define zip_start(t, run, arg) pthread_create(t, NULL, run, arg)
+#    define zip_join(t) pthread_join(t, NULL)
+#  endif
+#endif
+
 
 #ifndef local
 #  define local static
@@ -158,7 +202,8 @@ typedef struct
 
     int  method;                /* compression method of file currently wr.*/
     int  raw;                   /* 1 for directly writing raw data */
-    Byte buffered_data[Z_BUFSIZE];/* buffer contain compressed data to be writ*/
+    Byte* buffered_data;        /* buffer contain compressed data to be writ*/
+    uInt size_buffered_data;    /* size of buffered_data, Z_BUFSIZE default */
     uLong dosDate;
     uLong crc32;
     int  encrypt;
@@ -511,32 +556,10 @@ extern int ZEXPORT zipAlreadyThere(zipFile file, char const *name) {
 
 #ifndef NO_ADDFILEINEXISTINGZIP
 /* ===========================================================================
-   Inputs a long in LSB order to the given file
+   Inputs a long in LSB order to the given buffer
    nbByte == 1, 2 ,4 or 8 (byte, short or long, ZPOS64_T)
 */
 
-local int zip64local_putValue(const zlib_filefunc64_32_def* pzlib_filefunc_def, voidpf filestream, ZPOS64_T x, int nbByte) {
-    unsigned char buf[8];
-    int n;
-    for (n = 0; n < nbByte; n++)
-    {
-        buf[n] = (unsigned char)(x & 0xff);
-        x >>= 8;
-    }
-    if (x != 0)
-      {     /* data overflow - hack for ZIP64 (X Roche) */
-      for (n = 0; n < nbByte; n++)
-        {
-          buf[n] = 0xff;
-        }
-      }
-
-    if (ZWRITE64(*pzlib_filefunc_def,filestream,buf,(uLong)nbByte)!=(uLong)nbByte)
-        return ZIP_ERRNO;
-    else
-        return ZIP_OK;
-}
-
 local void zip64local_putValue_inmemory (void* dest, ZPOS64_T x, int nbByte) {
     unsigned char* buf=(unsigned char*)dest;
     int n;
@@ -554,6 +577,50 @@ local void zip64local_putValue_inmemory (void* dest, ZPOS64_T x, int nbByte) {
     }
 }
 
+/* ===========================================================================
+   Write the headers and records through buffered_data, to make few large
+   writes instead of one for each field.  This is only used while no data of
+   a file is in buffered_data.
+*/
+local int zip64local_flushBuffered(zip64_internal* zi) {
+    uInt len = zi->ci.pos_in_buffered_data;
+    zi->ci.pos_in_buffered_data = 0;
+    if (len > 0 && ZWRITE64(zi->z_filefunc,zi->filestream,zi->ci.buffered_data,len) != len)
+        return ZIP_ERRNO;
+    return ZIP_OK;
+}
+
+local int zip64local_putBuffered(zip64_internal* zi, const void* buf, uLong len) {
+    const Byte* next = (const Byte*)buf;
+    while (len > 0)
+    {
+        uInt copy_this = zi->ci.size_buffered_data - zi->ci.pos_in_buffered_data;
+        if (copy_this == 0)
+        {
+            if (zip64local_flushBuffered(zi) != ZIP_OK)
+                return ZIP_ERRNO;
+            if (len >= zi->ci.size_buffered_data)
+                /* no point in copying it */
+                return ZWRITE64(zi->z_filefunc,zi->filestream,next,len) != len ?
+                       ZIP_ERRNO : ZIP_OK;
+            continue;
+        }
+        if (copy_this > len)
+            copy_this = (uInt)len;
+        memcpy(zi->ci.buffered_data + zi->ci.pos_in_buffered_data, next, copy_this);
+        zi->ci.pos_in_buffered_data += copy_this;
+        next += copy_this;
+        len -= copy_this;
+    }
+    return ZIP_OK;
+}
+
+local int zip64local_putValueBuffered(zip64_internal* zi, ZPOS64_T x, int nbByte) {
+    unsigned char buf[8];
+    zip64local_putValue_inmemory(buf, x, nbByte);
+    return zip64local_putBuffered(zi, buf, (uLong)nbByte);
+}
+
 /****************************************************************************/
 
 
@@ -1081,6 +1148,8 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* glo
     ziinit.begin_pos = ZTELL64(ziinit.z_filefunc,ziinit.filestream);
     ziinit.in_opened_file_inzip = 0;
     ziinit.ci.stream_initialised = 0;
+    ziinit.ci.pos_in_buffered_data = 0;
+    ziinit.ci.size_buffered_data = Z_BUFSIZE;
     ziinit.number_entry = 0;
     ziinit.add_position_when_writing_offset = 0;
     init_linkedlist(&(ziinit.central_dir));
@@ -1089,8 +1158,11 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* glo
 
 
     zi = (zip64_internal*)ALLOC(sizeof(zip64_internal));
-    if (zi==NULL)
+    ziinit.ci.buffered_data = (Byte*)ALLOC(Z_BUFSIZE);
+    if (zi==NULL || ziinit.ci.buffered_data==NULL)
     {
+        free(ziinit.ci.buffered_data);
+        free(zi);
         ZCLOSE64(ziinit.z_filefunc,ziinit.filestream);
         return NULL;
     }
@@ -1115,6 +1187,7 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* glo
 #    ifndef NO_ADDFILEINEXISTINGZIP
         free(ziinit.globalcomment);
 #    endif /* !NO_ADDFILEINEXISTINGZIP*/
+        free(ziinit.ci.buffered_data);
         free(zi);
         return NULL;
     }
@@ -1159,51 +1232,72 @@ extern zipFile ZEXPORT zipOpen64(const void* pathname, int append) {
     return zipOpen3(pathname,append,NULL,NULL);
 }
 
+extern int ZEXPORT zipSetBufferSize(zipFile file, unsigned size) {
+    zip64_internal* zi;
+    Byte* buffered_data;
+
+    if (file == NULL || size == 0)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+
+    if (zi->in_opened_file_inzip)
+        return ZIP_PARAMERROR;
+    if (size == zi->ci.size_buffered_data)
+        return ZIP_OK;
+    buffered_data = (Byte*)ALLOC(size);
+    if (buffered_data == NULL)
+        return ZIP_INTERNALERROR;
+    free(zi->ci.buffered_data);
+    zi->ci.buffered_data = buffered_data;
+    zi->ci.size_buffered_data = (uInt)size;
+    return ZIP_OK;
+}
+
 local int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_extrafield_local, const void* extrafield_local) {
   /* write the local header */
   int err;
   uInt size_filename = (uInt)strlen(filename);
   uInt size_extrafield = size_extrafield_local;
 
-  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)LOCALHEADERMAGIC, 4);
+  err = zip64local_putValueBuffered(zi,(uLong)LOCALHEADERMAGIC, 4);
 
   if (err==ZIP_OK)
   {
     if(zi->ci.zip64)
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);/* version needed to extract */
+      err = zip64local_putValueBuffered(zi,(uLong)45,2);/* version needed to extract */
     else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)20,2);/* version needed to extract */
+      err = zip64local_putValueBuffered(zi,(uLong)20,2);/* version needed to extract */
   }
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.flag,2);
+    err = zip64local_putValueBuffered(zi,(uLong)zi->ci.flag,2);
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.method,2);
+    err = zip64local_putValueBuffered(zi,(uLong)zi->ci.method,2);
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.dosDate,4);
+    err = zip64local_putValueBuffered(zi,(uLong)zi->ci.dosDate,4);
 
   // CRC / Compressed size / Uncompressed size will be filled in later and rewritten later
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* crc 32, unknown */
+    err = zip64local_putValueBuffered(zi,(uLong)0,4); /* crc 32, unknown */
   if (err==ZIP_OK)
   {
     if(zi->ci.zip64)
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0xFFFFFFFF,4); /* compressed size, unknown */
+      err = zip64local_putValueBuffered(zi,(uLong)0xFFFFFFFF,4); /* compressed size, unknown */
     else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* compressed size, unknown */
+      err = zip64local_putValueBuffered(zi,(uLong)0,4); /* compressed size, unknown */
   }
   if (err==ZIP_OK)
   {
     if(zi->ci.zip64)
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0xFFFFFFFF,4); /* uncompressed size, unknown */
+      err = zip64local_putValueBuffered(zi,(uLong)0xFFFFFFFF,4); /* uncompressed size, unknown */
     else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* uncompressed size, unknown */
+      err = zip64local_putValueBuffered(zi,(uLong)0,4); /* uncompressed size, unknown */
   }
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_filename,2);
+    err = zip64local_putValueBuffered(zi,(uLong)size_filename,2);
 
   if(zi->ci.zip64)
   {
@@ -1211,18 +1305,16 @@ local int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt s
   }
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_extrafield,2);
+    err = zip64local_putValueBuffered(zi,(uLong)size_extrafield,2);
 
   if ((err==ZIP_OK) && (size_filename > 0))
   {
-    if (ZWRITE64(zi->z_filefunc,zi->filestream,filename,size_filename)!=size_filename)
-      err = ZIP_ERRNO;
+    err = zip64local_putBuffered(zi, filename, size_filename);
   }
 
   if ((err==ZIP_OK) && (size_extrafield_local > 0))
   {
-    if (ZWRITE64(zi->z_filefunc, zi->filestream, extrafield_local, size_extrafield_local) != size_extrafield_local)
-      err = ZIP_ERRNO;
+    err = zip64local_putBuffered(zi, extrafield_local, size_extrafield_local);
   }
 
 
@@ -1235,15 +1327,20 @@ local int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt s
       ZPOS64_T UncompressedSize = 0;
 
       // Remember position of Zip64 extended info for the local file header. (needed when we update size after done with file)
-      zi->ci.pos_zip64extrainfo = ZTELL64(zi->z_filefunc,zi->filestream);
+      zi->ci.pos_zip64extrainfo = ZTELL64(zi->z_filefunc,zi->filestream) +
+                                  zi->ci.pos_in_buffered_data;
 
-      err = zip64local_putValue(&zi->z_filefunc, zi->filestream, (ZPOS64_T)HeaderID,2);
-      err = zip64local_putValue(&zi->z_filefunc, zi->filestream, (ZPOS64_T)DataSize,2);
+      err = zip64local_putValueBuffered(zi, (ZPOS64_T)HeaderID,2);
+      err = zip64local_putValueBuffered(zi, (ZPOS64_T)DataSize,2);
 
-      err = zip64local_putValue(&zi->z_filefunc, zi->filestream, (ZPOS64_T)UncompressedSize,8);
-      err = zip64local_putValue(&zi->z_filefunc, zi->filestream, (ZPOS64_T)CompressedSize,8);
+      err = zip64local_putValueBuffered(zi, (ZPOS64_T)UncompressedSize,8);
+      err = zip64local_putValueBuffered(zi, (ZPOS64_T)CompressedSize,8);
   }
 
+  if (err==ZIP_OK)
+    err = zip64local_flushBuffered(zi);
+  else
+    zi->ci.pos_in_buffered_data = 0;
   return err;
 }
 
@@ -1400,7 +1497,7 @@ extern int ZEXPORT zipOpenNewFileInZip4_64(zipFile file, const char* filename, c
 
 #ifdef HAVE_BZIP2
     zi->ci.bstream.avail_in = (uInt)0;
-    zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+    zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
     zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
     zi->ci.bstream.total_in_hi32 = 0;
     zi->ci.bstream.total_in_lo32 = 0;
@@ -1409,7 +1506,7 @@ extern int ZEXPORT zipOpenNewFileInZip4_64(zipFile file, const char* filename, c
 #endif
 
     zi->ci.stream.avail_in = (uInt)0;
-    zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+    zi->ci.stream.avail_out = zi->ci.size_buffered_data;
     zi->ci.stream.next_out = zi->ci.buffered_data;
     zi->ci.stream.total_in = 0;
     zi->ci.stream.total_out = 0;
@@ -1614,7 +1711,9 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void* buf, unsigned i
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
 
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
+    /* the crc of raw data is given to zipCloseFileInZipRaw64() */
+    if (!zi->ci.raw)
+        zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
 
 #ifdef HAVE_BZIP2
     if(zi->ci.method == Z_BZIP2ED && (!zi->ci.raw))
@@ -1629,7 +1728,7 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void* buf, unsigned i
         {
           if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
             err = ZIP_ERRNO;
-          zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+          zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
           zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
         }
 
@@ -1652,6 +1751,21 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void* buf, unsigned i
     }
     else
 #endif
+    if ((zi->ci.method != Z_DEFLATED || zi->ci.raw) && zi->ci.encrypt == 0 &&
+        len >= zi->ci.size_buffered_data)
+    {
+      /* stored or raw data that would fill the buffer is written as is */
+      if (zi->ci.pos_in_buffered_data > 0 &&
+          zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
+        return ZIP_ERRNO;
+      zi->ci.stream.avail_out = zi->ci.size_buffered_data;
+      zi->ci.stream.next_out = zi->ci.buffered_data;
+      if (ZWRITE64(zi->z_filefunc,zi->filestream,buf,len) != len)
+        return ZIP_ERRNO;
+      zi->ci.totalCompressedData += len;
+      zi->ci.totalUncompressedData += len;
+    }
+    else
     {
       zi->ci.stream.next_in = buf;
       zi->ci.stream.avail_in = len;
@@ -1662,7 +1776,7 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void* buf, unsigned i
           {
               if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
                   err = ZIP_ERRNO;
-              zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+              zi->ci.stream.avail_out = zi->ci.size_buffered_data;
               zi->ci.stream.next_out = zi->ci.buffered_data;
           }
 
@@ -1732,7 +1846,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, ZPOS64_T uncompressed_si
                                 {
                                         if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
                                                 err = ZIP_ERRNO;
-                                        zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+                                        zi->ci.stream.avail_out = zi->ci.size_buffered_data;
                                         zi->ci.stream.next_out = zi->ci.buffered_data;
                                 }
                                 uTotalOutBefore = zi->ci.stream.total_out;
@@ -1751,7 +1865,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, ZPOS64_T uncompressed_si
         {
           if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
             err = ZIP_ERRNO;
-          zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+          zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
           zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
         }
         uTotalOutBefore = zi->ci.bstream.total_out_lo32;
@@ -1900,37 +2014,39 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, ZPOS64_T uncompressed_si
         // Update the LocalFileHeader with the new values.
 
         ZPOS64_T cur_pos_inzip = ZTELL64(zi->z_filefunc,zi->filestream);
+        unsigned char sizes[16];
 
         if (ZSEEK64(zi->z_filefunc,zi->filestream, zi->ci.pos_local_header + 14,ZLIB_FILEFUNC_SEEK_SET)!=0)
             err = ZIP_ERRNO;
 
-        if (err==ZIP_OK)
-            err = zip64local_putValue(&zi->z_filefunc,zi->filestream,crc32,4); /* crc 32, unknown */
-
         if(uncompressed_size >= 0xffffffff || compressed_size >= 0xffffffff )
         {
+          zip64local_putValue_inmemory(sizes, crc32, 4); /* crc 32, unknown */
+          if (err==ZIP_OK && ZWRITE64(zi->z_filefunc,zi->filestream,sizes,4) != 4)
+            err = ZIP_ERRNO;
+
           if(zi->ci.pos_zip64extrainfo > 0)
           {
             // Update the size in the ZIP64 extended field.
             if (ZSEEK64(zi->z_filefunc,zi->filestream, zi->ci.pos_zip64extrainfo + 4,ZLIB_FILEFUNC_SEEK_SET)!=0)
               err = ZIP_ERRNO;
 
-            if (err==ZIP_OK) /* compressed size, unknown */
-              err = zip64local_putValue(&zi->z_filefunc, zi->filestream, uncompressed_size, 8);
-
-            if (err==ZIP_OK) /* uncompressed size, unknown */
-              err = zip64local_putValue(&zi->z_filefunc, zi->filestream, compressed_size, 8);
+            zip64local_putValue_inmemory(sizes, uncompressed_size, 8);
+            zip64local_putValue_inmemory(sizes + 8, compressed_size, 8);
+            if (err==ZIP_OK && ZWRITE64(zi->z_filefunc,zi->filestream,sizes,16) != 16)
+              err = ZIP_ERRNO;
           }
           else
               err = ZIP_BADZIPFILE; // Caller passed zip64 = 0, so no room for zip64 info -> fatal
         }
         else
         {
-          if (err==ZIP_OK) /* compressed size, unknown */
-              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,compressed_size,4);
-
-          if (err==ZIP_OK) /* uncompressed size, unknown */
-              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,4);
+          /* crc, compressed size, and uncompressed size in one write */
+          zip64local_putValue_inmemory(sizes, crc32, 4);
+          zip64local_putValue_inmemory(sizes + 4, compressed_size, 4);
+          zip64local_putValue_inmemory(sizes + 8, uncompressed_size, 4);
+          if (err==ZIP_OK && ZWRITE64(zi->z_filefunc,zi->filestream,sizes,12) != 12)
+            err = ZIP_ERRNO;
         }
 
         if (ZSEEK64(zi->z_filefunc,zi->filestream, cur_pos_inzip,ZLIB_FILEFUNC_SEEK_SET)!=0)
@@ -1947,23 +2063,273 @@ extern int ZEXPORT zipCloseFileInZip(zipFile file) {
     return zipCloseFileInZipRaw (file,0,0);
 }
 
+/* A file from zipWriteFilesInZip(), once compressed. */
+typedef struct
+{
+    unsigned char* data;    /* compressed data, NULL if stored */
+    uLong size;             /* number of bytes at data */
+    uLong crc;              /* CRC-32 of the uncompressed data */
+    int type;               /* data_type from deflate, for the text flag */
+    int err;                /* ZIP_OK, or the error compressing the file */
+    int done;               /* true when data, size, crc, and err are set */
+} zip_packed;
+
+/* Compress entry into packed, using strm, set up by the first call with
+   *init zero, and reused with deflateReset() after that. */
+local void zip_pack(const zip_entry* entry, zip_packed* packed,
+                    z_stream* strm, int* init) {
+    const unsigned char* next = (const unsigned char*)entry->buf;
+    uLong left = entry->len, bound;
+    int err = Z_OK;
+
+    packed->data = NULL;
+    packed->size = entry->len;
+    packed->crc = crc32_z(0, next, entry->len);
+    packed->type = Z_BINARY;
+    packed->err = ZIP_OK;
+    if (entry->method == 0)
+        return;
+    if (entry->method != Z_DEFLATED) {
+        packed->err = ZIP_PARAMERROR;
+        return;
+    }
+
+    if (*init == 0) {
+        strm->zalloc = Z_NULL;
+        strm->zfree = Z_NULL;
+        strm->opaque = Z_NULL;
+        err = deflateInit2(strm, entry->level, Z_DEFLATED, -MAX_WBITS,
+                           DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        *init = err == Z_OK;
+    }
+    else {
+        deflateReset(strm);
+        err = deflateParams(strm, entry->level, Z_DEFAULT_STRATEGY);
+    }
+    bound = deflateBound(strm, entry->len);
+    packed->data = err == Z_OK ? (unsigned char*)ALLOC(bound) : NULL;
+    if (packed->data == NULL) {
+        packed->err = ZIP_INTERNALERROR;
+        return;
+    }
+
+    /* feed the input and output in pieces that fit in a uInt */
+    strm->next_in = next;
+    strm->avail_in = 0;
+    strm->next_out = packed->data;
+    strm->avail_out = 0;
+    do {
+        uLong room = bound - (uLong)(strm->next_out - packed->data);
+
+        if (strm->avail_in == 0) {
+            strm->avail_in = left > (uInt)-1 ? (uInt)-1 : (uInt)left;
+            left -= strm->avail_in;
+        }
+        if (strm->avail_out == 0)
+            strm->avail_out = room > (uInt)-1 ? (uInt)-1 : (uInt)room;
+        err = deflate(strm, left ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK);
+    if (err != Z_STREAM_END) {
+        free(packed->data);
+        packed->data = NULL;
+        packed->err = ZIP_INTERNALERROR;
+        return;
+    }
+    packed->size = (uLong)(strm->next_out - packed->data);
+    packed->type = strm->data_type;
+}
+
+/* Write entry, compressed into packed, to the zipfile as a raw file. */
+local int zip_put(zipFile file, const zip_entry* entry,
+                  const zip_packed* packed) {
+    const unsigned char* data;
+    uLong left = packed->size;
+    int err = packed->err;
+
+    if (err == ZIP_OK)
+        err = zipOpenNewFileInZip4_64(file, entry->filename, entry->zipfi,
+                                      entry->extrafield_local,
+                                      entry->size_extrafield_local,
+                                      entry->extrafield_global,
+                                      entry->size_extrafield_global,
+                                      entry->comment, entry->method,
+                                      entry->level, 1, -MAX_WBITS,
+                                      DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                      NULL, 0, VERSIONMADEBY, 0,
+                                      entry->len >= 0xffffffff);
+    data = packed->data != NULL ? packed->data :
+                                  (const unsigned char*)entry->buf;
+    while (err == ZIP_OK && left) {
+        /* in one piece if it fits, which is then written directly */
+        unsigned len = left > 0x40000000 ? 0x40000000 : (unsigned)left;
+        err = zipWriteInFileInZip(file, data, len);
+        data += len;
+        left -= len;
+    }
+    if (err == ZIP_OK) {
+        ((zip64_internal*)file)->ci.stream.data_type = packed->type;
+        err = zipCloseFileInZipRaw64(file, entry->len, packed->crc);
+    }
+    return err;
+}
+
+#ifdef ZIP_THREADS
+
+/* The files of a zipWriteFilesInZip() call, shared with the threads that
+   compress them. */
+typedef struct
+{
+    const zip_entry* entries;
+    zip_packed* packed;
+    unsigned count;         /* number of entries */
+    unsigned next;          /* next entry for a thread to compress */
+    unsigned limit;         /* entries at limit and after must wait */
+    int stop;               /* true to have the threads return */
+    zip_mutex lock;         /* protects next, limit, stop, and packed[].done */
+    zip_cond change;        /* signaled when any of those change */
+} zip_work;
+
+/* Compress entries until there are no more, or until told to stop. */
+local ZIP_WORKER zip_worker(void* arg) {
+    zip_work* work = (zip_work*)arg;
+    z_stream strm;
+    int init = 0;
+
+    zip_lock(&work->lock);
+    for (;;) {
+        unsigned i;
+
+        while (!work->stop && work->next < work->count &&
+               work->next >= work->limit)
+            zip_wait(&work->change, &work->lock);
+        if (work->stop || work->next >= work->count)
+            break;
+        i = work->next++;
+        zip_unlock(&work->lock);
+        zip_pack(work->entries + i, work->packed + i, &strm, &init);
+        zip_lock(&work->lock);
+        work->packed[i].done = 1;
+        zip_wake(&work->change);
+    }
+    zip_unlock(&work->lock);
+    if (init)
+        deflateEnd(&strm);
+    return 0;
+}
+
+#endif /* ZIP_THREADS */
+
+extern int ZEXPORT zipWriteFilesInZip(zipFile file, const zip_entry* entries,
+                                      unsigned count, int threads) {
+    zip_packed* packed;
+    z_stream strm;
+    int init = 0, err = ZIP_OK;
+    unsigned i;
+#ifdef ZIP_THREADS
+    int started = 0;
+    zip_work work;
+    zip_thread* thread = NULL;
+#endif
+
+    if (file == NULL || (entries == NULL && count != 0) || threads < 1)
+        return ZIP_PARAMERROR;
+    if (count == 0)
+        return ZIP_OK;
+    packed = (zip_packed*)ALLOC(count * sizeof(zip_packed));
+    if (packed == NULL)
+        return ZIP_INTERNALERROR;
+    for (i = 0; i < count; i++) {
+        packed[i].data = NULL;
+        packed[i].done = 0;
+    }
+
+#ifdef ZIP_THREADS
+    /* start the threads, or as many as can be started */
+    if ((unsigned)threads > count)
+        threads = (int)count;
+    if (threads > 1)
+        thread = (zip_thread*)ALLOC(threads * sizeof(zip_thread));
+    if (thread != NULL) {
+        work.entries = entries;
+        work.packed = packed;
+        work.count = count;
+        work.next = 0;
+        work.limit = 4 * (unsigned)threads;
+        work.stop = 0;
+        zip_mutex_init(&work.lock);
+        zip_cond_init(&work.change);
+        while (started < threads &&
+               zip_start(thread + started, zip_worker, &work) == 0)
+            started++;
+    }
+#endif
+
+    /* write the files in order, compressing them here if there are no
+       threads */
+    for (i = 0; i < count && err == ZIP_OK; i++) {
+#ifdef ZIP_THREADS
+        if (started) {
+            zip_lock(&work.lock);
+            while (!packed[i].done)
+                zip_wait(&work.change, &work.lock);
+            zip_unlock(&work.lock);
+        }
+        else
+#endif
+            zip_pack(entries + i, packed + i, &strm, &init);
+        err = zip_put(file, entries + i, packed + i);
+        free(packed[i].data);
+        packed[i].data = NULL;
+#ifdef ZIP_THREADS
+        if (started) {
+            zip_lock(&work.lock);
+            work.limit++;
+            zip_wake(&work.change);
+            zip_unlock(&work.lock);
+        }
+#endif
+    }
+
+#ifdef ZIP_THREADS
+    if (thread != NULL) {
+        /* stop the threads, and free what they compressed that was not
+           written */
+        zip_lock(&work.lock);
+        work.stop = 1;
+        zip_wake(&work.change);
+        zip_unlock(&work.lock);
+        while (started)
+            zip_join(thread[--started]);
+        zip_cond_free(&work.change);
+        zip_mutex_free(&work.lock);
+        free(thread);
+        for (; i < count; i++)
+            free(packed[i].data);
+    }
+#endif
+    if (init)
+        deflateEnd(&strm);
+    free(packed);
+    return err;
+}
+
 local int Write_Zip64EndOfCentralDirectoryLocator(zip64_internal* zi, ZPOS64_T zip64eocd_pos_inzip) {
   int err = ZIP_OK;
   ZPOS64_T pos = zip64eocd_pos_inzip - zi->add_position_when_writing_offset;
 
-  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDLOCHEADERMAGIC,4);
+  err = zip64local_putValueBuffered(zi,(uLong)ZIP64ENDLOCHEADERMAGIC,4);
 
   /*num disks*/
     if (err==ZIP_OK) /* number of the disk with the start of the central directory */
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+      err = zip64local_putValueBuffered(zi,(uLong)0,4);
 
   /*relative offset*/
     if (err==ZIP_OK) /* Relative offset to the Zip64EndOfCentralDirectory */
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream, pos,8);
+      err = zip64local_putValueBuffered(zi, pos,8);
 
   /*total disks*/ /* Do not support spawning of disk so always say 1 here*/
     if (err==ZIP_OK) /* number of the disk with the start of the central directory */
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)1,4);
+      err = zip64local_putValueBuffered(zi,(uLong)1,4);
 
     return err;
 }
@@ -1973,36 +2339,36 @@ local int Write_Zip64EndOfCentralDirectoryRecord(zip64_internal* zi, uLong size_
 
   uLong Zip64DataSize = 44;
 
-  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDHEADERMAGIC,4);
+  err = zip64local_putValueBuffered(zi,(uLong)ZIP64ENDHEADERMAGIC,4);
 
   if (err==ZIP_OK) /* size of this 'zip64 end of central directory' */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(ZPOS64_T)Zip64DataSize,8); // why ZPOS64_T of this ?
+    err = zip64local_putValueBuffered(zi,(ZPOS64_T)Zip64DataSize,8); // why ZPOS64_T of this ?
 
   if (err==ZIP_OK) /* version made by */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);
+    err = zip64local_putValueBuffered(zi,(uLong)45,2);
 
   if (err==ZIP_OK) /* version needed */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);
+    err = zip64local_putValueBuffered(zi,(uLong)45,2);
 
   if (err==ZIP_OK) /* number of this disk */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+    err = zip64local_putValueBuffered(zi,(uLong)0,4);
 
   if (err==ZIP_OK) /* number of the disk with the start of the central directory */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+    err = zip64local_putValueBuffered(zi,(uLong)0,4);
 
   if (err==ZIP_OK) /* total number of entries in the central dir on this disk */
-    err = zip64local_putValue(&zi->z_filefunc, zi->filestream, zi->number_entry, 8);
+    err = zip64local_putValueBuffered(zi, zi->number_entry, 8);
 
   if (err==ZIP_OK) /* total number of entries in the central dir */
-    err = zip64local_putValue(&zi->z_filefunc, zi->filestream, zi->number_entry, 8);
+    err = zip64local_putValueBuffered(zi, zi->number_entry, 8);
 
   if (err==ZIP_OK) /* size of the central directory */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(ZPOS64_T)size_centraldir,8);
+    err = zip64local_putValueBuffered(zi,(ZPOS64_T)size_centraldir,8);
 
   if (err==ZIP_OK) /* offset of start of central directory with respect to the starting disk number */
   {
     ZPOS64_T pos = centraldir_pos_inzip - zi->add_position_when_writing_offset;
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream, (ZPOS64_T)pos,8);
+    err = zip64local_putValueBuffered(zi, (ZPOS64_T)pos,8);
   }
   return err;
 }
@@ -2011,44 +2377,44 @@ local int Write_EndOfCentralDirectoryRecord(zip64_internal* zi, uLong size_centr
   int err = ZIP_OK;
 
   /*signature*/
-  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)ENDHEADERMAGIC,4);
+  err = zip64local_putValueBuffered(zi,(uLong)ENDHEADERMAGIC,4);
 
   if (err==ZIP_OK) /* number of this disk */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,2);
+    err = zip64local_putValueBuffered(zi,(uLong)0,2);
 
   if (err==ZIP_OK) /* number of the disk with the start of the central directory */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,2);
+    err = zip64local_putValueBuffered(zi,(uLong)0,2);
 
   if (err==ZIP_OK) /* total number of entries in the central dir on this disk */
   {
     {
       if(zi->number_entry >= 0xFFFF)
-        err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0xffff,2); // use value in ZIP64 record
+        err = zip64local_putValueBuffered(zi,(uLong)0xffff,2); // use value in ZIP64 record
       else
-        err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,2);
+        err = zip64local_putValueBuffered(zi,(uLong)zi->number_entry,2);
     }
   }
 
   if (err==ZIP_OK) /* total number of entries in the central dir */
   {
     if(zi->number_entry >= 0xFFFF)
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)0xffff,2); // use value in ZIP64 record
+      err = zip64local_putValueBuffered(zi,(uLong)0xffff,2); // use value in ZIP64 record
     else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,2);
+      err = zip64local_putValueBuffered(zi,(uLong)zi->number_entry,2);
   }
 
   if (err==ZIP_OK) /* size of the central directory */
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_centraldir,4);
+    err = zip64local_putValueBuffered(zi,(uLong)size_centraldir,4);
 
   if (err==ZIP_OK) /* offset of start of central directory with respect to the starting disk number */
   {
     ZPOS64_T pos = centraldir_pos_inzip - zi->add_position_when_writing_offset;
     if(pos >= 0xffffffff)
     {
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream, (uLong)0xffffffff,4);
+      err = zip64local_putValueBuffered(zi, (uLong)0xffffffff,4);
     }
     else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream, (uLong)(centraldir_pos_inzip - zi->add_position_when_writing_offset),4);
+      err = zip64local_putValueBuffered(zi, (uLong)(centraldir_pos_inzip - zi->add_position_when_writing_offset),4);
   }
 
    return err;
@@ -2061,12 +2427,11 @@ local int Write_GlobalComment(zip64_internal* zi, const char* global_comment) {
   if(global_comment != NULL)
     size_global_comment = (uInt)strlen(global_comment);
 
-  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_global_comment,2);
+  err = zip64local_putValueBuffered(zi,(uLong)size_global_comment,2);
 
   if (err == ZIP_OK && size_global_comment > 0)
   {
-    if (ZWRITE64(zi->z_filefunc,zi->filestream, global_comment, size_global_comment) != size_global_comment)
-      err = ZIP_ERRNO;
+    err = zip64local_putBuffered(zi, global_comment, size_global_comment);
   }
   return err;
 }
@@ -2098,13 +2463,11 @@ extern int ZEXPORT zipClose(zipFile file, const char* global_comment) {
     if (err==ZIP_OK)
     {
         linkedlist_datablock_internal* ldi = zi->central_dir.first_block;
+        zi->ci.pos_in_buffered_data = 0;
         while (ldi!=NULL)
         {
             if ((err==ZIP_OK) && (ldi->filled_in_this_block>0))
-            {
-                if (ZWRITE64(zi->z_filefunc,zi->filestream, ldi->data, ldi->filled_in_this_block) != ldi->filled_in_this_block)
-                    err = ZIP_ERRNO;
-            }
+                err = zip64local_putBuffered(zi, ldi->data, ldi->filled_in_this_block);
 
             size_centraldir += ldi->filled_in_this_block;
             ldi = ldi->next_datablock;
@@ -2117,7 +2480,7 @@ extern int ZEXPORT zipClose(zipFile file, const char* global_comment) {
     pos = centraldir_pos_inzip - zi->add_position_when_writing_offset;
     if(pos >= 0xffffffff || zi->number_entry >= 0xFFFF)
     {
-      ZPOS64_T Zip64EOCDpos = ZTELL64(zi->z_filefunc,zi->filestream);
+      ZPOS64_T Zip64EOCDpos = centraldir_pos_inzip + size_centraldir;
       Write_Zip64EndOfCentralDirectoryRecord(zi, size_centraldir, centraldir_pos_inzip);
 
       Write_Zip64EndOfCentralDirectoryLocator(zi, Zip64EOCDpos);
@@ -2129,6 +2492,9 @@ extern int ZEXPORT zipClose(zipFile file, const char* global_comment) {
     if(err == ZIP_OK)
       err = Write_GlobalComment(zi, global_comment);
 
+    if(err == ZIP_OK)
+      err = zip64local_flushBuffered(zi);
+
     if (ZCLOSE64(zi->z_filefunc,zi->filestream) != 0)
         if (err == ZIP_OK)
             err = ZIP_ERRNO;
@@ -2136,6 +2502,7 @@ extern int ZEXPORT zipClose(zipFile file, const char* global_comment) {
 #ifndef NO_ADDFILEINEXISTINGZIP
     free(zi->globalcomment);
 #endif
+    free(zi->ci.buffered_data);
     free(zi);
 
     return err;
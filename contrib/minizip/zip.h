@@ -149,6 +149,19 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname,
                                 zipcharpc* globalcomment,
                                 zlib_filefunc64_32_def* pzlib_filefunc64_32_def);
 
+extern int ZEXPORT zipSetBufferSize(zipFile file, unsigned size);
+/*
+  Set the size of the buffer that compressed data and headers are collected in
+    before being written to the zipfile, Z_BUFSIZE (64K) by default.  A larger
+    buffer makes fewer and larger writes, which can be much faster on network
+    storage.  Stored and raw data given to zipWriteInFileInZip() in pieces of
+    at least this size are written directly, without the buffer.
+
+  This can only be called when no file in the zipfile is open for writing.
+  Return ZIP_OK, ZIP_PARAMERROR if a file is open or size is zero, or
+    ZIP_INTERNALERROR if the buffer could not be allocated.
+*/
+
 extern int ZEXPORT zipOpenNewFileInZip(zipFile file,
                                        const char* filename,
                                        const zip_fileinfo* zipfi,
@@ -311,6 +324,8 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file,
                                        unsigned len);
 /*
   Write data in the zipfile
+  Stored or raw data with len at least the buffer size (see zipSetBufferSize)
+    is written directly to the zipfile, unless it is being encrypted.
  */
 
 extern int ZEXPORT zipCloseFileInZip(zipFile file);
@@ -338,6 +353,39 @@ extern int ZEXPORT zipAlreadyThere(zipFile file,
   uncompressed_size and crc32 are value for the uncompressed size
  */
 
+typedef struct
+{
+    const char*         filename;       /* name in the zip, or NULL for '-' */
+    const zip_fileinfo* zipfi;          /* date and attributes, or NULL */
+    const void*         buf;            /* complete contents of the file */
+    uLong               len;            /* number of bytes at buf */
+    const void*         extrafield_local;
+    uInt                size_extrafield_local;
+    const void*         extrafield_global;
+    uInt                size_extrafield_global;
+    const char*         comment;        /* file comment, or NULL */
+    int                 method;         /* 0 to store, or Z_DEFLATED */
+    int                 level;          /* compression level for Z_DEFLATED */
+} zip_entry;
+
+extern int ZEXPORT zipWriteFilesInZip(zipFile file,
+                                      const zip_entry* entries,
+                                      unsigned count,
+                                      int threads);
+/*
+  Add count files to the zipfile, each given complete in memory, as if each
+    were added with zipOpenNewFileInZip64(), zipWriteInFileInZip() and
+    zipCloseFileInZip().  The files are compressed at the same time using up
+    to threads threads, each into its own memory buffer, and are written in
+    the order of entries[] from the calling thread.  Up to four compressed
+    files per thread are held in memory waiting to be written.  Without thread
+    support (define HAVE_PTHREAD when compiling zip.c on non-Windows systems),
+    or if threads is one, the files are compressed in the calling thread.
+  Returns ZIP_OK if all of the files were added.  Otherwise the error for the
+    first file that could not be added is returned, and the files before it
+    were added.
+ */
+
 extern int ZEXPORT zipClose(zipFile file,
                             const char* global_comment);
 /*
@@ -17,7 +17,8 @@
   one thread to use crc32().
 
   MAKECRCH can be #defined to write out crc32.h. A main() routine is also
-  produced, so that this one source file can be compiled to an executable.
+  produced, so that this source file can be compiled to an executable, linked
+  with zcpu.c.
  */
 
 #ifdef MAKECRCH
@@ -28,6 +29,8 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for Z_U4, Z_U8, z_crc_t, and FAR definitions */
+#include "zthread.h"    /* for crc32_z_parallel() */
+#include "zcpu.h"       /* for zcpu_features() and z_once() */
 
  /*
   A CRC of a message is computed on N braids of words in the message, where
@@ -47,7 +50,9 @@
   Octeon II processors. The Intel, AMD, and ARM processors were all fastest
   with N=5, W=8. The Sparc, PowerPC, and MIPS64 were all fastest at N=5, W=4.
   They were all tested with either gcc or clang, all using the -O3 optimization
-  level. Your mileage may vary.
+  level. Your mileage may vary. The CMake option ZLIB_CRC32_TUNE times all of
+  the choices on the build host with test/crc32_tune.c, and then compiles with
+  the fastest N and W as Z_TESTN and Z_TESTW. crc32.h has the tables for all.
  */
 
 /* Define N */
@@ -103,6 +108,28 @@
 #  define ARMCRC32
 #endif
 
+/* On 64-bit ARM Linux, check for the CRC32 and PMULL instructions at run time
+   if the compiler can target them for a single function. Use PMULL if that
+   check is possible, or if the compilation specifies it. */
+#if defined(ARM_SIMD) && defined(__linux__) && W == 8 && \
+    (defined(__clang__) ? __clang_major__ >= 17 : __GNUC__ >= 9)
+#  define ARMHWCAP
+#endif
+#if defined(ARM_SIMD) && (defined(ARMHWCAP) || defined(__ARM_FEATURE_AES) || \
+                          defined(__ARM_FEATURE_CRYPTO))
+#  define ARMPMULL
+#endif
+
+/* On x86, use the carry-less multiply instruction if the compiler can target
+   it for a single function, and if the processor has it when run. */
+#if defined(X86_SIMD) && (defined(__clang__) || __GNUC__ > 4 || \
+                          (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  define X86PCLMUL
+#  if defined(__clang__) ? __clang_major__ >= 6 : __GNUC__ >= 8
+#    define X86VPCLMUL
+#  endif
+#endif
+
 #if defined(W) && (!defined(ARMCRC32) || defined(DYNAMIC_CRC_TABLE))
 /*
   Swap the bytes in a z_word_t to convert between little and big endian. Any
@@ -204,83 +231,8 @@ local z_crc_t FAR crc_table[256];
    local void write_table64(FILE *, const z_word_t FAR *, int);
 #endif /* MAKECRCH */
 
-/*
-  Define a once() function depending on the availability of atomics. If this is
-  compiled with DYNAMIC_CRC_TABLE defined, and if CRCs will be computed in
-  multiple threads, and if atomics are not available, then get_crc_table() must
-  be called to initialize the tables and must return before any threads are
-  allowed to compute or combine CRCs.
- */
-
-/* Definition of once functionality. */
-typedef struct once_s once_t;
-
-/* Check for the availability of atomics. */
-#if defined(__STDC__) && __STDC_VERSION__ >= 201112L && \
-    !defined(__STDC_NO_ATOMICS__)
-
-#include <stdatomic.h>
-
-/* Structure for once(), which must be initialized with ONCE_INIT. */
-struct once_s {
-    atomic_flag begun;
-    atomic_int done;
-};
-#define ONCE_INIT {ATOMIC_FLAG_INIT, 0}
-
-/*
-  Run the provided init() function exactly once, even if multiple threads
-  invoke once() at the same time. The state must be a once_t initialized with
-  ONCE_INIT.
- */
-local void once(once_t *state, void (*init)(void)) {
-    if (!atomic_load(&state->done)) {
-        if (atomic_flag_test_and_set(&state->begun))
-            while (!atomic_load(&state->done))
-                ;
-        else {
-            init();
-            atomic_store(&state->done, 1);
-        }
-    }
-}
-
-#else   /* no atomics */
-
-/* Structure for once(), which must be initialized with ONCE_INIT. */
-struct once_s {
-    volatile int begun;
-    volatile int done;
-};
-#define ONCE_INIT {0, 0}
-
-/* Test and set. Alas, not atomic, but tries to minimize the period of
-   vulnerability. */
-local int test_and_set(int volatile *flag) {
-    int was;
-
-    was = *flag;
-    *flag = 1;
-    return was;
-}
-
-/* Run the provided init() function once. This is not thread-safe. */
-local void once(once_t *state, void (*init)(void)) {
-    if (!state->done) {
-        if (test_and_set(&state->begun))
-            while (!state->done)
-                ;
-        else {
-            init();
-            state->done = 1;
-        }
-    }
-}
-
-#endif
-
-/* State for once(). */
-local once_t made = ONCE_INIT;
+/* State for z_once(). */
+local z_once_t made = Z_ONCE_INIT;
 
 /*
   Generate tables for a byte-wise 32-bit CRC calculation on the polynomial:
@@ -548,21 +500,232 @@ local void braid(z_crc_t ltl[][256], z_word_t big[][256], int n, int w) {
  */
 const z_crc_t FAR * ZEXPORT get_crc_table(void) {
 #ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
+    z_once(&made, make_crc_table);
 #endif /* DYNAMIC_CRC_TABLE */
     return (const z_crc_t FAR *)crc_table;
 }
 
+/* =========================================================================
+ * Use the x86 PCLMULQDQ carry-less multiply instruction if available, which is
+ * checked at run time. Four 16-byte lanes are folded together 64 bytes at a
+ * time, and then folded down to a single 16-byte value, whose CRC is computed
+ * using the table. This is about ten times faster than the braided
+ * calculation. If dest is not Z_NULL, then the data is also copied to dest as
+ * it is loaded, so that a copy and a CRC need only one pass over memory. The
+ * fold constants are x^n modulo the CRC polynomial for n = 544, 480, 160, and
+ * 96, bit reflected and shifted up one bit.
+ *
+ * With AVX-512 and VPCLMULQDQ, four 64-byte registers of four lanes each are
+ * folded 256 bytes at a time, using the constants for n = 2080 and 2016. That
+ * is about three times as fast again on long buffers.
+ */
+#ifdef X86PCLMUL
+#include <immintrin.h>
+
+#define have_pclmul() (zcpu_features() & ZCPU_PCLMUL)
+#ifdef X86VPCLMUL
+#  define have_vpclmul() (zcpu_features() & ZCPU_VPCLMUL)
+#endif
+
+/* Load the next 16 bytes from buf, copying them to dest if not Z_NULL. */
+#define FOLDLOAD(v) \
+    do { \
+        v = _mm_loadu_si128((const __m128i *)buf); \
+        buf += 16; \
+        if (dest != Z_NULL) { \
+            _mm_storeu_si128((__m128i *)dest, v); \
+            dest += 16; \
+        } \
+    } while (0)
+
+/* Fold x forward by the distance given by the constants in k, onto d. */
+#define FOLD(x, k, d) \
+    x = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), \
+                                    _mm_clmulepi64_si128(x, k, 0x11)), d)
+
+/* Return the CRC of buf[0..len-1], where len >= 64, and copy it to dest. */
+__attribute__((target("pclmul")))
+local unsigned long crc32_pclmul(unsigned long crc, unsigned char FAR *dest,
+                                 const unsigned char FAR *buf, z_size_t len) {
+    __m128i k, x0, x1, x2, x3, d0, d1, d2, d3;
+    unsigned char last[16];
+
+    /* Start with the first 64 bytes, with the pre-conditioned CRC exclusive-
+       or'ed into the first four bytes. */
+    FOLDLOAD(x0);
+    FOLDLOAD(x1);
+    FOLDLOAD(x2);
+    FOLDLOAD(x3);
+    x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128((int)(~crc & 0xffffffff)));
+    len -= 64;
+
+    /* Fold each lane forward by 512 bits onto the next 64 bytes. */
+    k = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+    while (len >= 64) {
+        FOLDLOAD(d0);
+        FOLDLOAD(d1);
+        FOLDLOAD(d2);
+        FOLDLOAD(d3);
+        FOLD(x0, k, d0);
+        FOLD(x1, k, d1);
+        FOLD(x2, k, d2);
+        FOLD(x3, k, d3);
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one, and then onto any remaining 16-byte
+       blocks, by 128 bits at a time. */
+    k = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+    FOLD(x0, k, x1);
+    FOLD(x0, k, x2);
+    FOLD(x0, k, x3);
+    while (len >= 16) {
+        FOLDLOAD(d0);
+        FOLD(x0, k, d0);
+        len -= 16;
+    }
+
+    /* The CRC of the message is now the CRC of the 16 folded bytes with a
+       zero initial value, followed by the remaining bytes. */
+    _mm_storeu_si128((__m128i *)last, x0);
+    crc = crc32_z(0xffffffff, last, 16);
+    if (dest != Z_NULL)
+        zmemcpy(dest, buf, (unsigned)len);
+    return crc32_z(crc, buf, len);
+}
+
+#ifdef X86VPCLMUL
+/* Load the next 64 bytes from buf, copying them to dest if not Z_NULL. */
+#define FOLDLOAD512(v) \
+    do { \
+        v = _mm512_loadu_si512((const void *)buf); \
+        buf += 64; \
+        if (dest != Z_NULL) { \
+            _mm512_storeu_si512((void *)dest, v); \
+            dest += 64; \
+        } \
+    } while (0)
+
+/* Fold the four lanes of x forward by the distance given by k, onto d. */
+#define FOLD512(x, k, d) \
+    x = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0x00), \
+                                  _mm512_clmulepi64_epi128(x, k, 0x11), d, \
+                                  0x96)
+
+/* Return the CRC of buf[0..len-1], where len >= 256, and copy it to dest. The
+   sixteen lanes are folded down to four, which crc32_pclmul() finishes. */
+__attribute__((target("avx512f,vpclmulqdq,pclmul")))
+local unsigned long crc32_vpclmul(unsigned long crc, unsigned char FAR *dest,
+                                  const unsigned char FAR *buf, z_size_t len) {
+    __m512i k, x0, x1, x2, x3, d0, d1, d2, d3;
+    unsigned char lanes[64];
+
+    /* Start with the first 256 bytes, with the pre-conditioned CRC exclusive-
+       or'ed into the first four bytes. */
+    FOLDLOAD512(x0);
+    FOLDLOAD512(x1);
+    FOLDLOAD512(x2);
+    FOLDLOAD512(x3);
+    x0 = _mm512_xor_si512(x0, _mm512_inserti32x4(_mm512_setzero_si512(),
+                          _mm_cvtsi32_si128((int)(~crc & 0xffffffff)), 0));
+    len -= 256;
+
+    /* Fold each lane forward by 2048 bits onto the next 256 bytes. */
+    k = _mm512_broadcast_i32x4(_mm_set_epi64x(0x1322d1430, 0x11542778a));
+    while (len >= 256) {
+        FOLDLOAD512(d0);
+        FOLDLOAD512(d1);
+        FOLDLOAD512(d2);
+        FOLDLOAD512(d3);
+        FOLD512(x0, k, d0);
+        FOLD512(x1, k, d1);
+        FOLD512(x2, k, d2);
+        FOLD512(x3, k, d3);
+        len -= 256;
+    }
+
+    /* Fold the four registers into one, and then onto any remaining 64-byte
+       blocks, by 512 bits at a time. */
+    k = _mm512_broadcast_i32x4(_mm_set_epi64x(0x1c6e41596, 0x154442bd4));
+    FOLD512(x0, k, x1);
+    FOLD512(x0, k, x2);
+    FOLD512(x0, k, x3);
+    while (len >= 64) {
+        FOLDLOAD512(d0);
+        FOLD512(x0, k, d0);
+        len -= 64;
+    }
+
+    /* The message now has the same CRC as the 64 folded bytes with a zero
+       initial value, followed by the remaining bytes. */
+    _mm512_storeu_si512((void *)lanes, x0);
+    crc = crc32_pclmul(0xffffffff, Z_NULL, lanes, 64);
+    if (dest != Z_NULL)
+        zmemcpy(dest, buf, (unsigned)len);
+    return crc32_z(crc, buf, len);
+}
+#endif
+#endif
+
 /* =========================================================================
  * Use ARM machine instructions if available. This will compute the CRC about
- * ten times faster than the braided calculation. This code does not check for
- * the presence of the CRC instruction at run time. __ARM_FEATURE_CRC32 will
- * only be defined if the compilation specifies an ARM processor architecture
- * that has the instructions. For example, compiling with -march=armv8.1-a or
- * -march=armv8-a+crc, or -march=native if the compile machine has the crc32
- * instructions.
+ * ten times faster than the braided calculation. __ARM_FEATURE_CRC32 will only
+ * be defined if the compilation specifies an ARM processor architecture that
+ * has the instructions, in which case they are always used. For example,
+ * compiling with -march=armv8.1-a or -march=armv8-a+crc, or -march=native if
+ * the compile machine has the crc32 instructions. Otherwise on Linux, the
+ * presence of the instructions is checked at run time using the HWCAP bits.
+ *
+ * The PMULL carry-less multiply instruction is used in the same way as
+ * PCLMULQDQ above, folding four 16-byte lanes 64 bytes at a time with the same
+ * constants. If the CRC32 instructions are also available, then PMULL is used
+ * only on longer buffers, where the folding makes up for its cost to finish.
  */
+#if defined(ARMCRC32) || defined(ARMHWCAP)
+#include <arm_acle.h>
+#endif
+#ifdef ARMPMULL
+#include <arm_neon.h>
+#endif
+
+#ifdef ARMHWCAP
+#  define have_pmull() (zcpu_features() & ZCPU_PMULL)
+#else
+#  define have_pmull() 1
+#endif
 #ifdef ARMCRC32
+#  define have_armcrc() 1
+#elif defined(ARMHWCAP)
+#  define have_armcrc() (zcpu_features() & ZCPU_ARMCRC32)
+#else
+#  define have_armcrc() 0
+#endif
+
+/* Function attributes to compile the instructions when checked at run time. */
+#if defined(ARMHWCAP) && !defined(ARMCRC32)
+#  ifdef __clang__
+#    define ARMCRC_TARGET __attribute__((target("crc")))
+#  else
+#    define ARMCRC_TARGET __attribute__((target("+crc")))
+#  endif
+#else
+#  define ARMCRC_TARGET
+#endif
+#if defined(ARMHWCAP) && !defined(__ARM_FEATURE_AES) && \
+    !defined(__ARM_FEATURE_CRYPTO)
+#  ifdef __clang__
+#    define ARMPMULL_TARGET __attribute__((target("aes")))
+#  else
+#    define ARMPMULL_TARGET __attribute__((target("+aes")))
+#  endif
+#else
+#  define ARMPMULL_TARGET
+#endif
+
+/* Fewest bytes for which PMULL is used when CRC32 is also available. */
+#define Z_PMULL_MIN 1024
+
+#if defined(ARMCRC32) || defined(ARMHWCAP)
 
 /*
    Constants empirically determined to maximize speed. These values are from
@@ -572,8 +735,10 @@ const z_crc_t FAR * ZEXPORT get_crc_table(void) {
 #define Z_BATCH_ZEROS 0xa10d3d0c    /* computed from Z_BATCH = 3990 */
 #define Z_BATCH_MIN 800             /* fewest words in a final batch */
 
-unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
-                              z_size_t len) {
+/* Return the CRC of buf[0..len-1] using the CRC32 instructions. */
+ARMCRC_TARGET
+local unsigned long crc32_armv8(unsigned long crc,
+                                const unsigned char FAR *buf, z_size_t len) {
     z_crc_t val;
     z_word_t crc1, crc2;
     const z_word_t *word;
@@ -581,21 +746,13 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     z_size_t last, last2, i;
     z_size_t num;
 
-    /* Return initial CRC, if requested. */
-    if (buf == Z_NULL) return 0;
-
-#ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
-#endif /* DYNAMIC_CRC_TABLE */
-
     /* Pre-condition the CRC */
     crc = (~crc) & 0xffffffff;
 
     /* Compute the CRC up to a word boundary. */
     while (len && ((z_size_t)buf & 7) != 0) {
         len--;
-        val = *buf++;
-        __asm__ volatile("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(val));
+        crc = __crc32b((z_crc_t)crc, *buf++);
     }
 
     /* Prepare to compute the CRC on full 64-bit words word[0..num-1]. */
@@ -613,9 +770,9 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
             val0 = word[i];
             val1 = word[i + Z_BATCH];
             val2 = word[i + 2 * Z_BATCH];
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc1) : "r"(val1));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc2) : "r"(val2));
+            crc = __crc32d((z_crc_t)crc, val0);
+            crc1 = __crc32d((z_crc_t)crc1, val1);
+            crc2 = __crc32d((z_crc_t)crc2, val2);
         }
         word += 3 * Z_BATCH;
         num -= 3 * Z_BATCH;
@@ -634,9 +791,9 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
             val0 = word[i];
             val1 = word[i + last];
             val2 = word[i + last2];
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc1) : "r"(val1));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc2) : "r"(val2));
+            crc = __crc32d((z_crc_t)crc, val0);
+            crc1 = __crc32d((z_crc_t)crc1, val1);
+            crc2 = __crc32d((z_crc_t)crc2, val2);
         }
         word += 3 * last;
         num -= 3 * last;
@@ -648,7 +805,7 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     /* Compute the CRC on any remaining words. */
     for (i = 0; i < num; i++) {
         val0 = word[i];
-        __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
+        crc = __crc32d((z_crc_t)crc, val0);
     }
     word += num;
 
@@ -656,14 +813,109 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     buf = (const unsigned char FAR *)word;
     while (len) {
         len--;
-        val = *buf++;
-        __asm__ volatile("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(val));
+        crc = __crc32b((z_crc_t)crc, *buf++);
     }
 
     /* Return the CRC, post-conditioned. */
     return crc ^ 0xffffffff;
 }
 
+#endif
+
+#ifdef ARMPMULL
+
+/* Load the next 16 bytes from buf, copying them to dest if not Z_NULL. */
+#define PMULLLOAD(v) \
+    do { \
+        v = vreinterpretq_u64_u8(vld1q_u8(buf)); \
+        buf += 16; \
+        if (dest != Z_NULL) { \
+            vst1q_u8(dest, vreinterpretq_u8_u64(v)); \
+            dest += 16; \
+        } \
+    } while (0)
+
+/* Fold x forward by the distance given by the constants in k, onto d. */
+#define PMULLFOLD(x, k, d) \
+    x = veorq_u64(veorq_u64(vreinterpretq_u64_p128(vmull_p64( \
+            (poly64_t)vgetq_lane_u64(x, 0), (poly64_t)vgetq_lane_u64(k, 0))), \
+        vreinterpretq_u64_p128(vmull_high_p64(vreinterpretq_p64_u64(x), \
+                                              vreinterpretq_p64_u64(k)))), d)
+
+/* Return the CRC of buf[0..len-1], where len >= 64, and copy it to dest. */
+ARMPMULL_TARGET
+local unsigned long crc32_pmull(unsigned long crc, unsigned char FAR *dest,
+                                const unsigned char FAR *buf, z_size_t len) {
+    uint64x2_t k, x0, x1, x2, x3, d0, d1, d2, d3;
+    unsigned char last[16];
+
+    /* Start with the first 64 bytes, with the pre-conditioned CRC exclusive-
+       or'ed into the first four bytes. */
+    PMULLLOAD(x0);
+    PMULLLOAD(x1);
+    PMULLLOAD(x2);
+    PMULLLOAD(x3);
+    x0 = veorq_u64(x0, vsetq_lane_u64((uint64_t)(~crc & 0xffffffff),
+                                      vdupq_n_u64(0), 0));
+    len -= 64;
+
+    /* Fold each lane forward by 512 bits onto the next 64 bytes. */
+    k = vcombine_u64(vcreate_u64(0x154442bd4), vcreate_u64(0x1c6e41596));
+    while (len >= 64) {
+        PMULLLOAD(d0);
+        PMULLLOAD(d1);
+        PMULLLOAD(d2);
+        PMULLLOAD(d3);
+        PMULLFOLD(x0, k, d0);
+        PMULLFOLD(x1, k, d1);
+        PMULLFOLD(x2, k, d2);
+        PMULLFOLD(x3, k, d3);
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one, and then onto any remaining 16-byte
+       blocks, by 128 bits at a time. */
+    k = vcombine_u64(vcreate_u64(0x1751997d0), vcreate_u64(0x0ccaa009e));
+    PMULLFOLD(x0, k, x1);
+    PMULLFOLD(x0, k, x2);
+    PMULLFOLD(x0, k, x3);
+    while (len >= 16) {
+        PMULLLOAD(d0);
+        PMULLFOLD(x0, k, d0);
+        len -= 16;
+    }
+
+    /* The CRC of the message is now the CRC of the 16 folded bytes with a
+       zero initial value, followed by the remaining bytes. */
+    vst1q_u8(last, vreinterpretq_u8_u64(x0));
+    crc = crc32_z(0xffffffff, last, 16);
+    if (dest != Z_NULL)
+        zmemcpy(dest, buf, (unsigned)len);
+    return crc32_z(crc, buf, len);
+}
+
+#endif
+
+#ifdef ARMCRC32
+
+unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
+                              z_size_t len) {
+    /* Return initial CRC, if requested. */
+    if (buf == Z_NULL) return 0;
+
+#ifdef DYNAMIC_CRC_TABLE
+    z_once(&made, make_crc_table);
+#endif /* DYNAMIC_CRC_TABLE */
+
+#ifdef ARMPMULL
+    /* Use carry-less multiplication on long buffers if available. */
+    if (len >= Z_PMULL_MIN && have_pmull())
+        return crc32_pmull(crc, Z_NULL, buf, len);
+#endif
+
+    return crc32_armv8(crc, buf, len);
+}
+
 #else
 
 #ifdef W
@@ -696,10 +948,31 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     /* Return initial CRC, if requested. */
     if (buf == Z_NULL) return 0;
 
+#ifdef X86PCLMUL
+    /* Use carry-less multiplication if available. */
+#  ifdef X86VPCLMUL
+    if (len >= 512 && have_vpclmul())
+        return crc32_vpclmul(crc, Z_NULL, buf, len);
+#  endif
+    if (len >= 64 && have_pclmul())
+        return crc32_pclmul(crc, Z_NULL, buf, len);
+#endif
+
 #ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
+    z_once(&made, make_crc_table);
 #endif /* DYNAMIC_CRC_TABLE */
 
+#ifdef ARMPMULL
+    /* Use carry-less multiplication if available, leaving shorter buffers to
+       the CRC32 instructions if those are available. */
+    if (len >= 64 && have_pmull() && (len >= Z_PMULL_MIN || !have_armcrc()))
+        return crc32_pmull(crc, Z_NULL, buf, len);
+#endif
+#ifdef ARMHWCAP
+    if (have_armcrc())
+        return crc32_armv8(crc, buf, len);
+#endif
+
     /* Pre-condition the CRC */
     crc = (~crc) & 0xffffffff;
 
@@ -1017,10 +1290,64 @@ unsigned long ZEXPORT crc32(unsigned long crc, const unsigned char FAR *buf,
     return crc32_z(crc, buf, len);
 }
 
+/* ========================================================================= */
+const char ZLIB_INTERNAL *crc32_kernel(void) {
+#ifdef X86PCLMUL
+#  ifdef X86VPCLMUL
+    if (have_vpclmul())
+        return "vpclmul";
+#  endif
+    if (have_pclmul())
+        return "pclmul";
+#endif
+#ifdef ARMPMULL
+    if (have_pmull())
+        return "pmull";
+#endif
+#if defined(ARMCRC32) || defined(ARMHWCAP)
+    if (have_armcrc())
+        return "armv8";
+#endif
+#ifdef W
+    return "braid";
+#else
+    return "byte";
+#endif
+}
+
+/* ========================================================================= */
+uLong ZLIB_INTERNAL crc32_copy(uLong crc, Bytef *dest, const Bytef *source,
+                               z_size_t len) {
+    unsigned n;
+
+#ifdef X86PCLMUL
+#  ifdef X86VPCLMUL
+    if (len >= 512 && have_vpclmul())
+        return crc32_vpclmul(crc, dest, source, len);
+#  endif
+    if (len >= 64 && have_pclmul())
+        return crc32_pclmul(crc, dest, source, len);
+#endif
+#ifdef ARMPMULL
+    if (len >= 64 && have_pmull() && (len >= Z_PMULL_MIN || !have_armcrc()))
+        return crc32_pmull(crc, dest, source, len);
+#endif
+
+    while (len) {
+        n = len < CHECK_BLOCK ? (unsigned)len : CHECK_BLOCK;
+        zmemcpy(dest, source, n);
+        crc = crc32_z(crc, dest, n);
+        dest += n;
+        source += n;
+        len -= n;
+    }
+    return crc;
+}
+
 /* ========================================================================= */
 uLong ZEXPORT crc32_combine64(uLong crc1, uLong crc2, z_off64_t len2) {
 #ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
+    z_once(&made, make_crc_table);
 #endif /* DYNAMIC_CRC_TABLE */
     return multmodp(x2nmodp(len2, 3), crc1) ^ (crc2 & 0xffffffff);
 }
@@ -1033,7 +1360,7 @@ uLong ZEXPORT crc32_combine(uLong crc1, uLong crc2, z_off_t len2) {
 /* ========================================================================= */
 uLong ZEXPORT crc32_combine_gen64(z_off64_t len2) {
 #ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
+    z_once(&made, make_crc_table);
 #endif /* DYNAMIC_CRC_TABLE */
     return x2nmodp(len2, 3);
 }
@@ -1047,3 +1374,150 @@ uLong ZEXPORT crc32_combine_gen(z_off_t len2) {
 uLong ZEXPORT crc32_combine_op(uLong crc1, uLong crc2, uLong op) {
     return multmodp(op, crc1) ^ (crc2 & 0xffffffff);
 }
+
+/* =========================================================================
+ * Return a(x) multiplied by b(x) modulo p(x), as for multmodp(), using a
+ * carry-less multiply instruction. The 64-bit product, shifted up one bit to
+ * be bit reflected, is reduced by applying four byte steps of the CRC table to
+ * its higher-degree half, which is then exclusive-or'ed with the other half.
+ */
+#if defined(X86PCLMUL) || defined(ARMPMULL)
+local z_crc_t clmul_reduce(z_crc_t lo, z_crc_t hi) {
+    int k;
+
+    hi = (hi << 1) | (lo >> 31);
+    lo = (lo << 1) & 0xffffffff;
+    for (k = 0; k < 4; k++)
+        lo = (lo >> 8) ^ crc_table[lo & 0xff];
+    return hi ^ lo;
+}
+#endif
+
+#ifdef X86PCLMUL
+__attribute__((target("pclmul")))
+local z_crc_t multmodp_clmul(z_crc_t a, z_crc_t b) {
+    __m128i p;
+
+    p = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)a),
+                             _mm_cvtsi32_si128((int)b), 0);
+    return clmul_reduce((z_crc_t)(unsigned)_mm_cvtsi128_si32(p),
+        (z_crc_t)(unsigned)_mm_cvtsi128_si32(_mm_srli_si128(p, 4)));
+}
+#  define have_clmul() have_pclmul()
+#elif defined(ARMPMULL)
+ARMPMULL_TARGET
+local z_crc_t multmodp_clmul(z_crc_t a, z_crc_t b) {
+    uint64_t p;
+
+    p = vgetq_lane_u64(vreinterpretq_u64_p128(vmull_p64((poly64_t)a,
+                                                        (poly64_t)b)), 0);
+    return clmul_reduce((z_crc_t)(p & 0xffffffff), (z_crc_t)(p >> 32));
+}
+#  define have_clmul() have_pmull()
+#else
+#  define have_clmul() 0
+#  define multmodp_clmul multmodp
+#endif
+
+/* ========================================================================= */
+#define CRC_OPS 31              /* number of cached operators, prime */
+
+uLong ZEXPORT crc32_combine_many(const uLong *crcs, const z_size_t *lens,
+                                 unsigned n) {
+    z_size_t len[CRC_OPS];
+    z_crc_t op[CRC_OPS], crc;
+    unsigned i, h;
+    int clmul;
+
+    if (n == 0)
+        return 0;
+#ifdef DYNAMIC_CRC_TABLE
+    z_once(&made, make_crc_table);
+#endif /* DYNAMIC_CRC_TABLE */
+
+    /* Keep the operators for the most recent lengths, hashed by length. Each
+       starts as the operator for a length of zero, which is x^0. */
+    for (h = 0; h < CRC_OPS; h++) {
+        len[h] = 0;
+        op[h] = (z_crc_t)1 << 31;
+    }
+    clmul = have_clmul();
+    crc = (z_crc_t)(crcs[0] & 0xffffffff);
+    for (i = 1; i < n; i++) {
+        h = (unsigned)(lens[i] % CRC_OPS);
+        if (len[h] != lens[i]) {
+            len[h] = lens[i];
+            op[h] = x2nmodp((z_off64_t)lens[i], 3);
+        }
+        crc = (clmul ? multmodp_clmul(op[h], crc) : multmodp(op[h], crc)) ^
+              (z_crc_t)(crcs[i] & 0xffffffff);
+    }
+    return crc;
+}
+
+/* ========================================================================= */
+#define CRC_PAR_MIN 4194304     /* fewest bytes for each thread */
+
+#ifdef HAVE_THREADS
+/* A piece of the buffer for a thread of crc32_z_parallel(). */
+typedef struct {
+    zthread thread;                 /* the thread computing the CRC */
+    const unsigned char FAR *buf;   /* the piece */
+    z_size_t len;                   /* length of the piece */
+    uLong crc;                      /* CRC-32 of the piece, once done */
+} crc_piece;
+
+local void crc_piece_run(void *arg) {
+    crc_piece *piece = (crc_piece *)arg;
+
+    piece->crc = crc32_z(0, piece->buf, piece->len);
+}
+#endif
+
+uLong ZEXPORT crc32_z_parallel(uLong crc, const Bytef *buf, z_size_t len,
+                               int threads) {
+#ifdef HAVE_THREADS
+    crc_piece *pool;
+    z_size_t size, first;
+    uLong op;
+    int i, started;
+
+    /* Divide the buffer into threads pieces of at least CRC_PAR_MIN bytes.
+       The calling thread does the first piece, which takes the remainder. The
+       others are the same length, so that they can be combined using the same
+       operator. If any of the threads cannot be started, then their pieces
+       are done by the calling thread. */
+    if (buf != Z_NULL && threads > 1 && len / CRC_PAR_MIN > 1) {
+        if ((z_size_t)threads > len / CRC_PAR_MIN)
+            threads = (int)(len / CRC_PAR_MIN);
+        pool = (crc_piece *)zcalloc(Z_NULL, (unsigned)threads - 1,
+                                    sizeof(crc_piece));
+        if (pool != Z_NULL) {
+            size = len / (unsigned)threads;
+            first = len - size * (unsigned)(threads - 1);
+            for (i = 0; i < threads - 1; i++) {
+                pool[i].buf = buf + first + size * (unsigned)i;
+                pool[i].len = size;
+            }
+            for (started = 0; started < threads - 1; started++)
+                if (zthread_start(&pool[started].thread, crc_piece_run,
+                                  pool + started))
+                    break;
+            crc = crc32_z(crc, buf, first);
+            op = crc32_combine_gen64((z_off64_t)size);
+            for (i = 0; i < threads - 1; i++) {
+                if (i < started)
+                    zthread_join(pool[i].thread);
+                else
+                    crc_piece_run(pool + i);
+                crc = crc32_combine_op(crc, pool[i].crc, op);
+            }
+            zcfree(Z_NULL, pool);
+            return crc;
+        }
+    }
+#else
+    (void)threads;
+#endif
+    return crc32_z(crc, buf, len);
+}
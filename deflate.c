@@ -50,6 +50,25 @@
 /* @(#) $Id$ */
 
 #include "deflate.h"
+#include "zcpu.h"
+#include "zthread.h"
+
+#if defined(X86_SIMD)
+#  include <immintrin.h>
+#elif defined(ARM_SIMD)
+#  include <arm_neon.h>
+#endif
+
+#ifdef CHAIN_MEM
+#  if defined(__GNUC__)
+#    define PREFETCH(p) __builtin_prefetch(p)
+#  elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#    include <xmmintrin.h>
+#    define PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#  else
+#    define PREFETCH(p)
+#  endif
+#endif
 
 const char deflate_copyright[] =
    " deflate 1.3.1.1 Copyright 1995-2024 Jean-loup Gailly and Mark Adler ";
@@ -72,11 +91,15 @@ typedef block_state (*compress_func)(deflate_state *s, int flush);
 
 local block_state deflate_stored(deflate_state *s, int flush);
 local block_state deflate_fast(deflate_state *s, int flush);
+local block_state deflate_quick(deflate_state *s, int flush);
 #ifndef FASTEST
+local block_state deflate_medium(deflate_state *s, int flush);
 local block_state deflate_slow(deflate_state *s, int flush);
+local block_state deflate_optimal(deflate_state *s, int flush);
 #endif
 local block_state deflate_rle(deflate_state *s, int flush);
 local block_state deflate_huff(deflate_state *s, int flush);
+local block_state deflate_pass(deflate_state *s, int flush);
 
 /* ===========================================================================
  * Local data
@@ -91,7 +114,7 @@ local block_state deflate_huff(deflate_state *s, int flush);
 /* Matches of length 3 are discarded if their distance exceeds TOO_FAR */
 
 /* Values for max_lazy_match, good_match and max_chain_length, depending on
- * the desired pack level (0..9). The values given below have been tuned to
+ * the desired pack level (0..12). The values given below have been tuned to
  * exclude worst case performance for pathological files. Better values may be
  * found for specific files.
  */
@@ -109,26 +132,44 @@ local const config configuration_table[2] = {
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
 /* 1 */ {4,    4,  8,    4, deflate_fast}}; /* max speed, no lazy matches */
 #else
-local const config configuration_table[10] = {
+local const config configuration_table[MAX_LEVEL + 1] = {
 /*      good lazy nice chain */
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
 /* 1 */ {4,    4,  8,    4, deflate_fast}, /* max speed, no lazy matches */
 /* 2 */ {4,    5, 16,    8, deflate_fast},
 /* 3 */ {4,    6, 32,   32, deflate_fast},
 
-/* 4 */ {4,    4, 16,   16, deflate_slow},  /* lazy matches */
-/* 5 */ {8,   16, 32,   32, deflate_slow},
-/* 6 */ {8,   16, 128, 128, deflate_slow},
+/* 4 */ {8,   32, 32,    8, deflate_medium}, /* bounded lazy matches */
+/* 5 */ {8,  128, 128,  32, deflate_medium},
+/* 6 */ {8,   16, 128, 128, deflate_slow},  /* lazy matches */
 /* 7 */ {8,   32, 128, 256, deflate_slow},
 /* 8 */ {32, 128, 258, 1024, deflate_slow},
-/* 9 */ {32, 258, 258, 4096, deflate_slow}}; /* max compression */
+/* 9 */ {32, 258, 258, 4096, deflate_slow},
+
+/* 10 */ {0,   2, 258, 1024, deflate_optimal}, /* optimal parsing */
+/* 11 */ {0,   5, 258, 4096, deflate_optimal},
+/* 12 */ {0,  15, 258, 8192, deflate_optimal}}; /* max compression */
 #endif
 
 /* Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
  * For deflate_fast() (levels <= 3) good is ignored and lazy has a different
- * meaning.
+ * meaning. For deflate_medium() (levels 4 and 5) the strings in matches longer
+ * than nice are not inserted. For deflate_optimal() (levels 10 to 12) good is
+ * ignored and lazy is the number of iterations.
  */
 
+/* Regions of input for deflateAdaptive(), in adapt_mode */
+#define ADAPT_MATCH 0   /* compress with the function for the level */
+#define ADAPT_HUFF 1    /* code literals only with deflate_huff() */
+#define ADAPT_STORE 2   /* copy to stored blocks with deflate_pass() */
+
+#define ADAPT_MIN 1024          /* fewest bytes in a block to judge it by */
+#define ADAPT_SAMPLE 4096       /* most bytes at the end of a block to count */
+#define ADAPT_RANDOM 200        /* spread of bytes that are not compressible */
+#define ADAPT_SKEWED 32         /* spread of bytes worth coding as literals */
+#define ADAPT_PROBE 262144UL    /* first length of a region */
+#define ADAPT_PROBE_MAX 8388608UL   /* longest a region grows to */
+
 /* rank Z_BLOCK between Z_NO_FLUSH and Z_PARTIAL_FLUSH */
 #define RANK(f) (((f) * 2) - ((f) > 4 ? 9 : 0))
 
@@ -140,6 +181,106 @@ local const config configuration_table[10] = {
  */
 #define UPDATE_HASH(s,h,c) (h = (((h) << s->hash_shift) ^ (c)) & s->hash_mask)
 
+/* ===========================================================================
+ * Alternative hash for Z_HASH_CRC32C: the CRC-32C of the four bytes at str,
+ * with no pre or post conditioning. Unlike UPDATE_HASH(), this does not carry
+ * a running value, so each hash is independent of the previous one. The
+ * SSE4.2 or ARMv8 crc32c instruction is used when the processor has it, else
+ * the table below, so the compressed output does not depend on the machine.
+ */
+local const z_crc_t crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f,
+    0x35f1141c, 0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc,
+    0x6be22838, 0x9989ab3b, 0x4d43cfd0, 0xbf284cd3, 0xac78bf27,
+    0x5e133c24, 0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b,
+    0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384, 0x9a879fa0,
+    0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+    0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29,
+    0x33ed7d2a, 0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+    0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5, 0x6dfe410e,
+    0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa, 0x30e349b1, 0xc288cab2,
+    0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad, 0x1642ae59,
+    0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+    0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc,
+    0xb3109ebf, 0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0,
+    0x67dafa54, 0x95b17957, 0xcba24573, 0x39c9c670, 0x2a993584,
+    0xd8f2b687, 0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+    0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927, 0x96bf4dcc,
+    0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+    0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4,
+    0x0f36e6f7, 0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096,
+    0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789, 0xeb1fcbad,
+    0x197448ae, 0x0a24bb5a, 0xf84f3859, 0x2c855cb2, 0xdeeedfb1,
+    0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e, 0x90a324fa,
+    0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd,
+    0xceb018de, 0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b,
+    0x63cd4b8f, 0x91a6c88c, 0x456cac67, 0xb7072f64, 0xa457dc90,
+    0x563c5f93, 0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043,
+    0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c, 0x92a8fc17,
+    0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+    0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f,
+    0x0b21572c, 0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+    0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652, 0x65d122b9,
+    0x97baa1ba, 0x84ea524e, 0x7681d14d, 0x2892ed69, 0xdaf96e6a,
+    0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975, 0x0e330a81,
+    0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+    0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06,
+    0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a,
+    0x1e6dcdee, 0xec064eed, 0xc38d26c4, 0x31e6a5c7, 0x22b65633,
+    0xd0ddd530, 0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+    0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff, 0x8ecee914,
+    0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+    0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643,
+    0x07198540, 0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90,
+    0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a,
+    0x115b2b19, 0x020bd8ed, 0xf0605bee, 0x24aa3f05, 0xd6c1bc06,
+    0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6, 0x88d28022,
+    0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a,
+    0xc69f7b69, 0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9,
+    0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052,
+    0xad7d5351
+};
+
+#if defined(X86_SIMD) || (defined(ARM_SIMD) && \
+    defined(__ARM_FEATURE_CRC32) && !defined(__ARM_BIG_ENDIAN))
+#  define CRC32C_INSN 2     /* value of s->hash to use the instruction */
+#endif
+
+local uInt hash_crc32c(deflate_state *s, uInt str) {
+    const Bytef *p = s->window + str;
+    z_crc_t crc = 0;
+
+#ifdef CRC32C_INSN
+    if (s->hash == CRC32C_INSN) {
+        unsigned val;
+        zmemcpy((Bytef *)&val, p, 4);   /* little-endian, so bytes in order */
+#  ifdef X86_SIMD
+        __asm__("crc32l %1, %0" : "+r"(crc) : "r"(val));
+#  else
+        __asm__("crc32cw %w0, %w0, %w1" : "+r"(crc) : "r"(val));
+#  endif
+        return (uInt)crc & s->hash_mask;
+    }
+#endif
+    crc = (crc >> 8) ^ crc32c_table[(crc ^ p[0]) & 0xff];
+    crc = (crc >> 8) ^ crc32c_table[(crc ^ p[1]) & 0xff];
+    crc = (crc >> 8) ^ crc32c_table[(crc ^ p[2]) & 0xff];
+    crc = (crc >> 8) ^ crc32c_table[(crc ^ p[3]) & 0xff];
+    return (uInt)crc & s->hash_mask;
+}
+
+/* ===========================================================================
+ * Set ins_h to the hash of the string at str, using the hash function selected
+ * for the stream. For the default rolling hash, this requires that ins_h hold
+ * the hash of the string that precedes str.
+ */
+#define UPDATE_HASH_AT(s, str) \
+    (s->hash == Z_HASH_ROLLING ? \
+     UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]) : \
+     (s->ins_h = hash_crc32c(s, str)))
+
 
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
@@ -153,16 +294,30 @@ local const config configuration_table[10] = {
  */
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (UPDATE_HASH_AT(s, str), \
     match_head = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #else
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
-    match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
+   (UPDATE_HASH_AT(s, str), \
+    match_head = s->head[s->ins_h], \
+    SET_PREV(s, str, match_head), \
     s->head[s->ins_h] = (Pos)(str))
 #endif
 
+/* ===========================================================================
+ * Link the string str to the older string head on its hash chain. With
+ * CHAIN_MEM, the first CHAIN_BYTES of str are saved with the link.
+ */
+#ifdef CHAIN_MEM
+#define SET_PREV(s, str, head) \
+   (s->prev[(str) & s->w_mask].link = (Pos)(head), \
+    zmemcpy(s->prev[(str) & s->w_mask].bytes, s->window + (str), CHAIN_BYTES))
+#else
+#define SET_PREV(s, str, head) \
+   (s->prev[(str) & s->w_mask] = (Pos)(head))
+#endif
+
 /* ===========================================================================
  * Initialize the hash table (avoiding 64K overflow for 16 bit systems).
  * prev[] will be initialized on the fly.
@@ -181,33 +336,246 @@ local const config configuration_table[10] = {
  */
 #if defined(__has_feature)
 #  if __has_feature(memory_sanitizer)
-     __attribute__((no_sanitize("memory")))
+#    define NO_MSAN __attribute__((no_sanitize("memory")))
 #  endif
 #endif
-local void slide_hash(deflate_state *s) {
-    unsigned n, m;
+#ifndef NO_MSAN
+#  define NO_MSAN
+#endif
+/* Each slide_table_*() subtracts wsize from the n entries of table, setting
+   those less than wsize to NIL. The vector versions do this with an unsigned
+   saturating subtraction, which gives the same result since NIL is zero. The
+   table sizes are powers of two no less than 256, so n is a multiple of every
+   vector length. prev[] entries that are not on any hash chain are garbage,
+   but their values will never be used -- NO_MSAN keeps the memory sanitizer
+   from complaining about reading them. */
+#if defined(X86_SIMD)
+
+NO_MSAN
+local void slide_table_sse2(Posf *table, unsigned n, unsigned wsize) {
+    const __m128i w = _mm_set1_epi16((short)wsize);
+
+    Assert((n & 7) == 0, "table size not a multiple of 8");
+    do {
+        _mm_storeu_si128((__m128i *)table, _mm_subs_epu16(
+            _mm_loadu_si128((const __m128i *)table), w));
+        table += 8;
+    } while (n -= 8);
+}
+
+__attribute__((target("avx2"))) NO_MSAN
+local void slide_table_avx2(Posf *table, unsigned n, unsigned wsize) {
+    const __m256i w = _mm256_set1_epi16((short)wsize);
+
+    Assert((n & 15) == 0, "table size not a multiple of 16");
+    do {
+        _mm256_storeu_si256((__m256i *)table, _mm256_subs_epu16(
+            _mm256_loadu_si256((const __m256i *)table), w));
+        table += 16;
+    } while (n -= 16);
+}
+
+__attribute__((target("avx512f,avx512bw"))) NO_MSAN
+local void slide_table_avx512(Posf *table, unsigned n, unsigned wsize) {
+    const __m512i w = _mm512_set1_epi16((short)wsize);
+
+    Assert((n & 31) == 0, "table size not a multiple of 32");
+    do {
+        _mm512_storeu_si512((void *)table, _mm512_subs_epu16(
+            _mm512_loadu_si512((const void *)table), w));
+        table += 32;
+    } while (n -= 32);
+}
+
+/* Return the fastest slide supported by this processor, and its name. */
+local slide_func select_slide(const char **name) {
+    unsigned features = zcpu_features();
+
+    if (features & ZCPU_AVX512) {
+        *name = "avx512";
+        return slide_table_avx512;
+    }
+    if (features & ZCPU_AVX2) {
+        *name = "avx2";
+        return slide_table_avx2;
+    }
+    *name = "sse2";
+    return slide_table_sse2;
+}
+
+#elif defined(ARM_SIMD)
+
+NO_MSAN
+local void slide_table_neon(Posf *table, unsigned n, unsigned wsize) {
+    const uint16x8_t w = vdupq_n_u16((uint16_t)wsize);
+
+    Assert((n & 15) == 0, "table size not a multiple of 16");
+    do {
+        vst1q_u16(table, vqsubq_u16(vld1q_u16(table), w));
+        vst1q_u16(table + 8, vqsubq_u16(vld1q_u16(table + 8), w));
+        table += 16;
+    } while (n -= 16);
+}
+
+/* NEON is always present on AArch64. */
+local slide_func select_slide(const char **name) {
+    *name = "neon";
+    return slide_table_neon;
+}
+
+#else
+
+NO_MSAN
+local void slide_table_c(Posf *table, unsigned n, unsigned wsize) {
+    unsigned m;
     Posf *p;
-    uInt wsize = s->w_size;
 
-    n = s->hash_size;
-    p = &s->head[n];
+    p = &table[n];
     do {
         m = *--p;
         *p = (Pos)(m >= wsize ? m - wsize : NIL);
     } while (--n);
-    n = wsize;
-#ifndef FASTEST
-    p = &s->prev[n];
+}
+
+local slide_func select_slide(const char **name) {
+    *name = "c";
+    return slide_table_c;
+}
+
+#endif
+
+#if defined(CHAIN_MEM) && !defined(FASTEST)
+/* Slide the links in the n entries of prev[], leaving the saved strings. */
+NO_MSAN
+local void slide_chain(Chainf *prev, unsigned n, unsigned wsize) {
+    unsigned m;
+
     do {
-        m = *--p;
-        *p = (Pos)(m >= wsize ? m - wsize : NIL);
-        /* If n is not on any hash chain, prev[n] is garbage but
-         * its value will never be used.
-         */
+        m = prev->link;
+        prev->link = (Pos)(m >= wsize ? m - wsize : NIL);
+        prev++;
     } while (--n);
+}
+#endif
+
+local void slide_hash(deflate_state *s) {
+    STAT(s, slides, 1);
+    (*s->slide)(s->head, s->hash_size, s->w_size);
+#ifndef FASTEST
+#ifdef CHAIN_MEM
+    slide_chain(s->prev, s->w_size, s->w_size);
+#else
+    (*s->slide)(s->prev, s->w_size, s->w_size);
+#endif
 #endif
 }
 
+/* ===========================================================================
+ * Vectorized string comparisons for longest_match(). These compare 16 or 32
+ * bytes at a time and locate the first mismatch from the comparison mask.
+ * Like the byte-by-byte loop in longest_match(), they start at offset
+ * MIN_MATCH and read no further than offset MAX_MATCH of both strings, so the
+ * same window bytes are examined and the matches found are identical.
+ */
+#if defined(X86_SIMD)
+#  define SIMD_COMPARE
+
+local unsigned compare258_sse2(const Bytef *scan, const Bytef *match) {
+    unsigned len = MIN_MATCH;
+    unsigned mask;
+
+    do {
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                   _mm_loadu_si128((const __m128i *)(scan + len)),
+                   _mm_loadu_si128((const __m128i *)(match + len))));
+        if (mask != 0xffff)
+            return len + (unsigned)__builtin_ctz(~mask);
+        len += 16;
+    } while (len < MAX_MATCH);
+    return MAX_MATCH;
+}
+
+__attribute__((target("avx2")))
+local unsigned compare258_avx2(const Bytef *scan, const Bytef *match) {
+    unsigned len = MIN_MATCH;
+    unsigned mask;
+
+    do {
+        mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                   _mm256_loadu_si256((const __m256i *)(scan + len)),
+                   _mm256_loadu_si256((const __m256i *)(match + len))));
+        if (mask != 0xffffffff)
+            return len + (unsigned)__builtin_ctz(~mask);
+        len += 32;
+    } while (len < MAX_MATCH);
+    return MAX_MATCH;
+}
+
+/* Return the fastest comparison supported by this processor, and its name. */
+local compare_func select_compare(const char **name) {
+    if (zcpu_features() & ZCPU_AVX2) {
+        *name = "avx2";
+        return compare258_avx2;
+    }
+    *name = "sse2";
+    return compare258_sse2;
+}
+
+#elif defined(ARM_SIMD)
+#  define SIMD_COMPARE
+
+local unsigned compare258_neon(const Bytef *scan, const Bytef *match) {
+    unsigned len = MIN_MATCH;
+    uint64_t mask;
+
+    do {
+        /* narrow the 0x00/0xff bytes of the comparison to four bits each */
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+                   vreinterpretq_u16_u8(vceqq_u8(vld1q_u8(scan + len),
+                                                 vld1q_u8(match + len))),
+                   4)), 0);
+        if (mask != (uint64_t)-1)
+            return len + ((unsigned)__builtin_ctzll(~mask) >> 2);
+        len += 16;
+    } while (len < MAX_MATCH);
+    return MAX_MATCH;
+}
+
+/* NEON is always present on AArch64. */
+local compare_func select_compare(const char **name) {
+    *name = "neon";
+    return compare258_neon;
+}
+
+#endif
+
+/* The slide and comparison kernels for this processor, chosen once on first
+   use, with their names for zlibKernels(). */
+local z_once_t chosen = Z_ONCE_INIT;
+local slide_func slide_kernel;
+local const char *slide_name;
+#ifdef SIMD_COMPARE
+local compare_func compare_kernel;
+#endif
+local const char *compare_name = "c";
+
+local void choose_kernels(void) {
+    slide_kernel = select_slide(&slide_name);
+#ifdef SIMD_COMPARE
+    compare_kernel = select_compare(&compare_name);
+#endif
+}
+
+const char ZLIB_INTERNAL *longest_match_kernel(void) {
+    z_once(&chosen, choose_kernels);
+    return compare_name;
+}
+
+const char ZLIB_INTERNAL *slide_hash_kernel(void) {
+    z_once(&chosen, choose_kernels);
+    return slide_name;
+}
+
 /* ===========================================================================
  * Read a new buffer from the current input stream, update the adler32
  * and total number of bytes read.  All deflate() input goes through
@@ -223,21 +591,60 @@ local unsigned read_buf(z_streamp strm, Bytef *buf, unsigned size) {
 
     strm->avail_in  -= len;
 
-    zmemcpy(buf, strm->next_in, len);
     if (strm->state->wrap == 1) {
-        strm->adler = adler32(strm->adler, buf, len);
+        strm->adler = adler32_copy(strm->adler, buf, strm->next_in, len);
     }
 #ifdef GZIP
     else if (strm->state->wrap == 2) {
-        strm->adler = crc32(strm->adler, buf, len);
+        strm->adler = crc32_copy(strm->adler, buf, strm->next_in, len);
     }
 #endif
+    else
+        zmemcpy(buf, strm->next_in, len);
     strm->next_in  += len;
     strm->total_in += len;
 
     return len;
 }
 
+/* ===========================================================================
+ * Take the next input for a window that points directly into it, updating the
+ * check value and total number of bytes read, as read_buf() does, but without
+ * a copy.
+ */
+local unsigned read_direct(z_streamp strm, unsigned size) {
+    unsigned len = strm->avail_in;
+
+    if (len > size) len = size;
+    if (len == 0) return 0;
+
+    strm->avail_in  -= len;
+
+    if (strm->state->wrap == 1) {
+        strm->adler = adler32(strm->adler, strm->next_in, len);
+    }
+#ifdef GZIP
+    else if (strm->state->wrap == 2) {
+        strm->adler = crc32(strm->adler, strm->next_in, len);
+    }
+#endif
+    strm->next_in  += len;
+    strm->total_in += len;
+
+    return len;
+}
+
+/* ===========================================================================
+ * Copy the window that points into the input to the allocated window, and use
+ * that from here on. The window is full, so the result is exactly what it
+ * would have been had the input been read into the allocated window.
+ */
+local void direct_end(deflate_state *s) {
+    zmemcpy(s->direct, s->window, (unsigned)s->window_size);
+    s->window = s->direct;
+    s->direct = Z_NULL;
+}
+
 /* ===========================================================================
  * Fill the window when the lookahead becomes insufficient.
  * Updates strstart and lookahead.
@@ -253,7 +660,9 @@ local void fill_window(deflate_state *s) {
     unsigned more;    /* Amount of free space at the end of the window. */
     uInt wsize = s->w_size;
 
-    Assert(s->lookahead < MIN_LOOKAHEAD, "already enough lookahead");
+    Assert(s->strstart + s->lookahead < s->window_size ||
+           s->strstart >= wsize + MAX_DIST(s), "no room in window");
+    STAT(s, fills, 1);
 
     do {
         more = (unsigned)(s->window_size -(ulg)s->lookahead -(ulg)s->strstart);
@@ -276,7 +685,15 @@ local void fill_window(deflate_state *s) {
          */
         if (s->strstart >= wsize + MAX_DIST(s)) {
 
-            zmemcpy(s->window, s->window + wsize, (unsigned)wsize - more);
+            /* A window that points into the input is always full, and can
+             * slide by moving forward only if there is input to fill it.
+             */
+            if (s->direct != Z_NULL && s->strm->avail_in < wsize)
+                direct_end(s);
+            if (s->direct != Z_NULL)
+                s->window += wsize;
+            else
+                zmemcpy(s->window, s->window + wsize, (unsigned)wsize - more);
             s->match_start -= wsize;
             s->strstart    -= wsize; /* we now have strstart >= MAX_DIST */
             s->block_start -= (long) wsize;
@@ -297,10 +714,32 @@ local void fill_window(deflate_state *s) {
          *   strstart + s->lookahead <= input_size => more >= MIN_LOOKAHEAD.
          * Otherwise, window_size == 2*WSIZE so more >= 2.
          * If there was sliding, more >= WSIZE. So in all cases, more >= 2.
+         * deflate_optimal() can call with more lookahead, but only if there
+         * is room in the window or it can slide, so more >= 1.
          */
-        Assert(more >= 2, "more < 2");
+        Assert(more >= 2 || s->lookahead >= MIN_LOOKAHEAD, "more < 2");
 
-        n = read_buf(s->strm, s->window + s->strstart + s->lookahead, more);
+        if (s->direct != Z_NULL) {
+            Assert(s->window + s->strstart + s->lookahead == s->strm->next_in,
+                   "window not at input");
+            n = read_direct(s->strm, more);
+        }
+        else
+            n = read_buf(s->strm, s->window + s->strstart + s->lookahead,
+                         more);
+#if defined(CHAIN_MEM) && !defined(FASTEST)
+        {
+            /* Update the bytes saved for the last strings before the new
+             * input, which may have been inserted before it was there.
+             */
+            uInt end = s->strstart + s->lookahead;
+            uInt str = end > CHAIN_BYTES - 1 ? end - (CHAIN_BYTES - 1) : 0;
+
+            for (; str < end; str++)
+                zmemcpy(s->prev[str & s->w_mask].bytes, s->window + str,
+                        CHAIN_BYTES);
+        }
+#endif
         s->lookahead += n;
 
         /* Initialize the hash value now that we have some input: */
@@ -312,9 +751,9 @@ local void fill_window(deflate_state *s) {
             Call UPDATE_HASH() MIN_MATCH-3 more times
 #endif
             while (s->insert) {
-                UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+                UPDATE_HASH_AT(s, str);
 #ifndef FASTEST
-                s->prev[str & s->w_mask] = s->head[s->ins_h];
+                SET_PREV(s, str, s->head[s->ins_h]);
 #endif
                 s->head[s->ins_h] = (Pos)str;
                 str++;
@@ -367,6 +806,27 @@ local void fill_window(deflate_state *s) {
            "not enough room for search");
 }
 
+/* ===========================================================================
+ * Point the symbol buffers into pending_buf, for separate distance and
+ * literal/length buffers if s->lit_mem is true, or else for the three-byte
+ * symbols of sym_buf.
+ */
+local void sym_init(deflate_state *s) {
+    if (s->lit_mem) {
+        s->d_buf = (ushf *)(s->pending_buf + (s->lit_bufsize << 1));
+        s->l_buf = s->pending_buf + (s->lit_bufsize << 2);
+        s->sym_end = s->lit_bufsize - 1;
+    }
+    else {
+        s->sym_buf = s->pending_buf + s->lit_bufsize;
+        s->sym_end = (s->lit_bufsize - 1) * 3;
+    }
+    /* We avoid equality with lit_bufsize*3 because of wraparound at 64K
+     * on 16 bit machines and because stored blocks are restricted to
+     * 64K-1 bytes.
+     */
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateInit_(z_streamp strm, int level, const char *version,
                          int stream_size) {
@@ -375,12 +835,88 @@ int ZEXPORT deflateInit_(z_streamp strm, int level, const char *version,
     /* To do: ignore strm->next_in if we use it as window */
 }
 
+/* ===========================================================================
+ * Check the deflateInit2() parameters, and normalize *level and *windowBits.
+ * Return the wrapper type, or -1 if the parameters are invalid.
+ */
+local int deflate_params(int *level, int method, int *windowBits,
+                         int memLevel, int strategy) {
+    int wrap = 1;
+
+#ifdef FASTEST
+    if (*level != 0) *level = 1;
+#else
+    if (*level == Z_DEFAULT_COMPRESSION) *level = 6;
+#endif
+
+    if (*windowBits < 0) { /* suppress zlib wrapper */
+        wrap = 0;
+        if (*windowBits < -15)
+            return -1;
+        *windowBits = -*windowBits;
+    }
+#ifdef GZIP
+    else if (*windowBits > 15) {
+        wrap = 2;       /* write gzip wrapper instead */
+        *windowBits -= 16;
+    }
+#endif
+    if (memLevel < 1 || memLevel > MAX_MEM_LEVEL || method != Z_DEFLATED ||
+        *windowBits < 8 || *windowBits > 15 || *level < 0 ||
+        *level > MAX_LEVEL || strategy < 0 || strategy > Z_QUICK ||
+        (*windowBits == 8 && wrap != 1)) {
+        return -1;
+    }
+    if (*windowBits == 8)
+        *windowBits = 9;        /* until 256-byte window bug fixed */
+    return wrap;
+}
+
+#ifndef FASTEST
+/* Average and maximum number of matches kept for each position by
+ * deflate_optimal(), and the smallest segment size allowed.
+ */
+#define OPT_POOL 4
+#define OPT_MATCHES 32
+#define OPT_MIN 1024
+
+/* ===========================================================================
+ * Return the number of bytes of working memory for deflate_optimal() with
+ * segments of up to size bytes.
+ */
+local ulg opt_bytes(uInt size) {
+    return sizeof(opt_state) + ((ulg)size + 1) * sizeof(ulg) +
+           ((ulg)size * (4 + 2 * OPT_POOL) + 2) * sizeof(ush);
+}
+
+/* ===========================================================================
+ * Allocate the working memory for deflate_optimal(), or return Z_NULL if
+ * there is not enough memory.
+ */
+local opt_state *opt_alloc(z_streamp strm, uInt size) {
+    opt_state *opt;
+
+    opt = (opt_state *) ZALLOC(strm, 1, (uInt)opt_bytes(size));
+    if (opt == Z_NULL) return Z_NULL;
+    opt->size = size;
+    opt->pool = size * OPT_POOL;
+    opt->cost = (ulg FAR *)(opt + 1);
+    opt->step = (ushf *)(opt->cost + size + 1);
+    opt->dist = opt->step + size + 1;
+    opt->count = opt->dist + size + 1;
+    opt->path = opt->count + size;
+    opt->mlen = opt->path + size;
+    opt->mdist = opt->mlen + opt->pool;
+    return opt;
+}
+#endif
+
 /* ========================================================================= */
 int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
                           int windowBits, int memLevel, int strategy,
                           const char *version, int stream_size) {
     deflate_state *s;
-    int wrap = 1;
+    int wrap;
     static const char my_version[] = ZLIB_VERSION;
 
     if (version == Z_NULL || version[0] != my_version[0] ||
@@ -405,30 +941,10 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
         strm->zfree = zcfree;
 #endif
 
-#ifdef FASTEST
-    if (level != 0) level = 1;
-#else
-    if (level == Z_DEFAULT_COMPRESSION) level = 6;
-#endif
-
-    if (windowBits < 0) { /* suppress zlib wrapper */
-        wrap = 0;
-        if (windowBits < -15)
-            return Z_STREAM_ERROR;
-        windowBits = -windowBits;
-    }
-#ifdef GZIP
-    else if (windowBits > 15) {
-        wrap = 2;       /* write gzip wrapper instead */
-        windowBits -= 16;
-    }
-#endif
-    if (memLevel < 1 || memLevel > MAX_MEM_LEVEL || method != Z_DEFLATED ||
-        windowBits < 8 || windowBits > 15 || level < 0 || level > 9 ||
-        strategy < 0 || strategy > Z_FIXED || (windowBits == 8 && wrap != 1)) {
+    wrap = deflate_params(&level, method, &windowBits, memLevel, strategy);
+    if (wrap < 0)
         return Z_STREAM_ERROR;
-    }
-    if (windowBits == 8) windowBits = 9;  /* until 256-byte window bug fixed */
+
     s = (deflate_state *) ZALLOC(strm, 1, sizeof(deflate_state));
     if (s == Z_NULL) return Z_MEM_ERROR;
     strm->state = (struct internal_state FAR *)s;
@@ -445,14 +961,27 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
     s->hash_size = 1 << s->hash_bits;
     s->hash_mask = s->hash_size - 1;
     s->hash_shift =  ((s->hash_bits + MIN_MATCH-1) / MIN_MATCH);
+    s->hash = Z_HASH_ROLLING;
 
-    s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
-    s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
+    s->window = (Bytef *) ZALLOC(strm, s->w_size + WIN_PAD, 2*sizeof(Byte));
+    s->direct = Z_NULL;
+    s->prev   = (Chainf *) ZALLOC(strm, s->w_size, sizeof(Chain));
     s->head   = (Posf *)  ZALLOC(strm, s->hash_size, sizeof(Pos));
+    s->opt    = Z_NULL;
+    s->split  = Z_NULL;
+    s->reuse  = Z_NULL;
 
     s->high_water = 0;      /* nothing written to s->window yet */
+    s->next_level = -1;     /* no deflateParams() switch pending */
+    s->adapt = 0;           /* no deflateAdaptive() regions */
+    s->lat_bytes = 0;       /* no deflateLatency() bounds */
+    s->lat_usec = 0;
+    s->out = Z_NULL;        /* no deflateOutput() function */
+    s->strstart = 0;        /* so that lm_init() clears all of head[] */
+    s->lookahead = 0;
 
     s->lit_bufsize = 1 << (memLevel + 6); /* 16K elements by default */
+    s->opt_size = s->lit_bufsize - 1;
 
     /* We overlay pending_buf and sym_buf. This works since the average size
      * for length/distance pairs over any compressed block is assured to be 31
@@ -495,34 +1024,114 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
 
     s->pending_buf = (uchf *) ZALLOC(strm, s->lit_bufsize, LIT_BUFS);
     s->pending_buf_size = (ulg)s->lit_bufsize * 4;
+    s->lit_bufs = LIT_BUFS;
+
+#ifndef FASTEST
+    if (level > 9 && s->pending_buf != Z_NULL)
+        s->opt = opt_alloc(strm, s->opt_size);
+#endif
 
     if (s->window == Z_NULL || s->prev == Z_NULL || s->head == Z_NULL ||
-        s->pending_buf == Z_NULL) {
+        s->pending_buf == Z_NULL || (level > 9 && s->opt == Z_NULL)) {
         s->status = FINISH_STATE;
         strm->msg = ERR_MSG(Z_MEM_ERROR);
         deflateEnd (strm);
         return Z_MEM_ERROR;
     }
-#ifdef LIT_MEM
-    s->d_buf = (ushf *)(s->pending_buf + (s->lit_bufsize << 1));
-    s->l_buf = s->pending_buf + (s->lit_bufsize << 2);
-    s->sym_end = s->lit_bufsize - 1;
-#else
-    s->sym_buf = s->pending_buf + s->lit_bufsize;
-    s->sym_end = (s->lit_bufsize - 1) * 3;
+#ifdef CHAIN_MEM
+    zmemzero(s->window + 2 * (ulg)s->w_size, 2 * WIN_PAD);
 #endif
-    /* We avoid equality with lit_bufsize*3 because of wraparound at 64K
-     * on 16 bit machines and because stored blocks are restricted to
-     * 64K-1 bytes.
-     */
+    s->lit_mem = LIT_BUFS == 5;
+    sym_init(s);
 
     s->level = level;
     s->strategy = strategy;
     s->method = (Byte)method;
+    z_once(&chosen, choose_kernels);
+#ifdef SIMD_COMPARE
+    s->compare = compare_kernel;
+#else
+    s->compare = Z_NULL;
+#endif
+    s->slide = slide_kernel;
 
     return deflateReset(strm);
 }
 
+/* ========================================================================= */
+uLong ZEXPORT deflateStateSize(int level, int windowBits, int memLevel,
+                               int strategy) {
+    ulg w_size, opt = 0;
+
+    if (deflate_params(&level, Z_DEFLATED, &windowBits, memLevel,
+                       strategy) < 0)
+        return 0;
+    w_size = (ulg)1 << windowBits;
+#ifndef FASTEST
+    if (level > 9)
+        opt = ZARENA_ROUND(opt_bytes((1U << (memLevel + 6)) - 1));
+#endif
+
+    /* the allocations in deflateInit2_() */
+    return ZARENA_SIZE(ZARENA_ROUND(sizeof(deflate_state)) +
+                       ZARENA_ROUND((w_size + WIN_PAD) * 2*sizeof(Byte)) +
+                       ZARENA_ROUND(w_size * sizeof(Chain)) +
+                       ZARENA_ROUND(((ulg)1 << (memLevel + 7)) * sizeof(Pos)) +
+                       ZARENA_ROUND(((ulg)1 << (memLevel + 6)) * LIT_BUFS) +
+                       opt);
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateSizeParams(uLong sourceLen, int *windowBits,
+                              int *memLevel) {
+    int level = Z_DEFAULT_COMPRESSION, bits, max, mem, wrap;
+
+    if (windowBits == Z_NULL || memLevel == Z_NULL)
+        return Z_STREAM_ERROR;
+    bits = *windowBits;
+    wrap = deflate_params(&level, Z_DEFLATED, &bits, *memLevel,
+                          Z_DEFAULT_STRATEGY);
+    if (wrap < 0)
+        return Z_STREAM_ERROR;
+
+    /* reach back from the end of the input to its start, within MAX_DIST */
+    max = bits;
+    while (bits > 9 && ((uLong)1 << (bits - 1)) - MIN_LOOKAHEAD + 1 >=
+                       sourceLen)
+        bits--;
+
+    /* hold all of the symbols of the input in one block */
+    mem = *memLevel;
+    while (mem > 1 && ((uLong)1 << (mem + 5)) > sourceLen)
+        mem--;
+
+    if (bits < max)
+        *windowBits = wrap == 0 ? -bits : wrap == 2 ? bits + 16 : bits;
+    *memLevel = mem;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateInitMem_(z_streamp strm, int level, int windowBits,
+                            int memLevel, int strategy, voidpf mem,
+                            uLong size, const char *version,
+                            int stream_size) {
+    uLong need;
+
+    if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
+        stream_size != (int)sizeof(z_stream)) {
+        return Z_VERSION_ERROR;
+    }
+    need = deflateStateSize(level, windowBits, memLevel, strategy);
+    if (strm == Z_NULL || mem == Z_NULL || need == 0) return Z_STREAM_ERROR;
+    if (size < need) return Z_MEM_ERROR;
+    strm->zalloc = zarena_alloc;
+    strm->zfree = zarena_free;
+    strm->opaque = zarena_init(mem, size);
+    return deflateInit2_(strm, level, Z_DEFLATED, windowBits, memLevel,
+                         strategy, version, stream_size);
+}
+
 /* =========================================================================
  * Check for a valid deflate stream state. Return 0 if ok, 1 if not.
  */
@@ -589,9 +1198,9 @@ int ZEXPORT deflateSetDictionary(z_streamp strm, const Bytef *dictionary,
         str = s->strstart;
         n = s->lookahead - (MIN_MATCH-1);
         do {
-            UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+            UPDATE_HASH_AT(s, str);
 #ifndef FASTEST
-            s->prev[str & s->w_mask] = s->head[s->ins_h];
+            SET_PREV(s, str, s->head[s->ins_h]);
 #endif
             s->head[s->ins_h] = (Pos)str;
             str++;
@@ -612,23 +1221,166 @@ int ZEXPORT deflateSetDictionary(z_streamp strm, const Bytef *dictionary,
     return Z_OK;
 }
 
-/* ========================================================================= */
-int ZEXPORT deflateGetDictionary(z_streamp strm, Bytef *dictionary,
-                                 uInt *dictLength) {
-    deflate_state *s;
-    uInt len;
-
-    if (deflateStateCheck(strm))
-        return Z_STREAM_ERROR;
-    s = strm->state;
-    len = s->strstart + s->lookahead;
-    if (len > s->w_size)
-        len = s->w_size;
-    if (dictionary != Z_NULL && len)
-        zmemcpy(dictionary, s->window + s->strstart + s->lookahead - len, len);
-    if (dictLength != Z_NULL)
-        *dictLength = len;
-    return Z_OK;
+/* ========================================================================= */
+int ZEXPORT deflateGetDictionary(z_streamp strm, Bytef *dictionary,
+                                 uInt *dictLength) {
+    deflate_state *s;
+    uInt len;
+
+    if (deflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    len = s->strstart + s->lookahead;
+    if (len > s->w_size)
+        len = s->w_size;
+    if (dictionary != Z_NULL && len)
+        zmemcpy(dictionary, s->window + s->strstart + s->lookahead - len, len);
+    if (dictLength != Z_NULL)
+        *dictLength = len;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+z_deflate_dictp ZEXPORT deflatePrepareDictionary(z_streamp strm,
+                                                 const Bytef *dictionary,
+                                                 uInt  dictLength) {
+    deflate_state *s;
+    z_deflate_dictp dict;
+    uInt have;
+    uLong total;
+    int wrap;
+
+    if (deflateStateCheck(strm) || dictionary == Z_NULL)
+        return Z_NULL;
+    s = strm->state;
+    if (s->status != INIT_STATE || s->strstart || s->lookahead || s->insert)
+        return Z_NULL;
+    have = dictLength < s->w_size ? dictLength : s->w_size;
+    dict = (z_deflate_dictp) ZALLOC(strm, 1,
+                    (uInt)(sizeof(struct z_deflate_dict_s) +
+                           s->w_size * sizeof(Chain) +
+                           s->hash_size * sizeof(Pos) + have));
+    if (dict == Z_NULL)
+        return Z_NULL;
+    dict->prev = (Chainf *)(dict + 1);
+    dict->head = (Posf *)(dict->prev + s->w_size);
+    dict->window = (Bytef *)(dict->head + s->hash_size);
+
+    /* let deflateSetDictionary() do the work, without a check value */
+    wrap = s->wrap;
+    total = strm->total_in;
+    s->wrap = 0;
+    deflateSetDictionary(strm, dictionary, dictLength);
+    s->wrap = wrap;
+    Assert(s->strstart == have, "dictionary not all in window");
+
+    dict->zfree = strm->zfree;
+    dict->opaque = strm->opaque;
+    dict->w_size = s->w_size;
+    dict->hash_size = s->hash_size;
+    dict->hash = s->hash;
+    dict->adler = adler32(adler32(0L, Z_NULL, 0), dictionary, dictLength);
+    dict->strstart = s->strstart;
+    dict->insert = s->insert;
+    dict->ins_h = s->ins_h;
+    zmemcpy((Bytef *)dict->prev, (Bytef *)s->prev,
+            s->w_size * sizeof(Chain));
+    zmemcpy((Bytef *)dict->head, (Bytef *)s->head,
+            s->hash_size * sizeof(Pos));
+    zmemcpy(dict->window, s->window, have);
+
+    /* return strm to its fresh state */
+    CLEAR_HASH(s);
+    s->strstart = 0;
+    s->block_start = 0L;
+    s->insert = 0;
+    s->ins_h = 0;
+    strm->total_in = total;
+    return dict;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateUseDictionary(z_streamp strm, z_deflate_dictp dict) {
+    deflate_state *s;
+    ulg init;
+
+    if (deflateStateCheck(strm) || dict == Z_NULL)
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->status != INIT_STATE || s->strstart || s->lookahead || s->insert ||
+        s->w_size != dict->w_size || s->hash_size != dict->hash_size ||
+        s->hash != dict->hash)
+        return Z_STREAM_ERROR;
+
+    /* copy what deflateSetDictionary() would have made, and zero the WIN_INIT
+       bytes after it as fill_window() would have */
+    zmemcpy(s->window, dict->window, dict->strstart);
+    zmemcpy((Bytef *)s->prev, (Bytef *)dict->prev,
+            s->w_size * sizeof(Chain));
+    zmemcpy((Bytef *)s->head, (Bytef *)dict->head,
+            s->hash_size * sizeof(Pos));
+    init = (ulg)dict->strstart + WIN_INIT;
+    if (init > s->window_size)
+        init = s->window_size;
+    if (s->high_water < init) {
+        zmemzero(s->window + dict->strstart,
+                 (unsigned)(init - dict->strstart));
+        s->high_water = init;
+    }
+
+    if (s->wrap == 1)
+        strm->adler = dict->adler;
+    strm->total_in += dict->strstart;
+    s->strstart = dict->strstart;
+    s->block_start = (long)s->strstart;
+    s->insert = dict->insert;
+    s->ins_h = dict->ins_h;
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    s->match_available = 0;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+void ZEXPORT deflateFreeDictionary(z_deflate_dictp dict) {
+    if (dict != Z_NULL)
+        dict->zfree(dict->opaque, (voidpf)dict);
+}
+
+/* ===========================================================================
+ * Set the compression level and strategy, with the parameters for the level.
+ */
+local void params_set(deflate_state *s, int level, int strategy) {
+    if (s->level != level) {
+        if (s->level == 0 && s->matches != 0) {
+            if (s->matches == 1)
+                slide_hash(s);
+            else
+                CLEAR_HASH(s);
+            s->matches = 0;
+        }
+        s->level = level;
+        s->max_lazy_match   = configuration_table[level].max_lazy;
+        s->good_match       = configuration_table[level].good_length;
+        s->nice_match       = configuration_table[level].nice_length;
+        s->max_chain_length = configuration_table[level].max_chain;
+    }
+    s->strategy = strategy;
+    s->next_level = -1;
+}
+
+/* ===========================================================================
+ * Make the switch requested by deflateParams() if it is pending and the
+ * current block has ended, with nothing left over from the old compression
+ * function. Return true if the switch was made.
+ */
+local int params_switch(deflate_state *s) {
+    if (s->next_level < 0 || s->sym_next ||
+        s->block_start != (long)s->strstart || s->match_available)
+        return 0;
+    params_set(s, s->next_level, s->next_strategy);
+    s->adapt_mode = s->adapt_next;
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    return 1;
 }
 
 /* ========================================================================= */
@@ -661,6 +1413,15 @@ int ZEXPORT deflateResetKeep(z_streamp strm) {
 #endif
         adler32(0L, Z_NULL, 0);
     s->last_flush = -2;
+    s->lat_emit = 0;
+    s->lat_since = 0;
+    if (s->next_level >= 0)
+        params_set(s, s->next_level, s->next_strategy);
+    s->adapt_mode = s->adapt_next = ADAPT_MATCH;
+    s->adapt_probe = ADAPT_PROBE;
+#ifdef DEFLATE_STATS
+    zmemzero((Bytef *)&s->stats, sizeof(s->stats));
+#endif
 
     _tr_init(s);
 
@@ -671,9 +1432,30 @@ int ZEXPORT deflateResetKeep(z_streamp strm) {
  * Initialize the "longest match" routines for a new zlib stream
  */
 local void lm_init(deflate_state *s) {
+    uInt end = s->strstart + s->lookahead;
+
     s->window_size = (ulg)2L*s->w_size;
 
-    CLEAR_HASH(s);
+    /* After a short stream, clear just the entries in head[] that it made,
+     * found by hashing its strings again, instead of all of head[]. This is
+     * done only for the rolling hash, which depends only on the MIN_MATCH
+     * bytes of each string, all of which are still in the window. It is not
+     * done after level 0, where deflate_stored() can move the window without
+     * moving the entries until deflateParams() does (see matches).
+     */
+    if (end != 0 && end <= (s->hash_size >> 4) + MIN_MATCH &&
+        s->level != 0 && s->hash == Z_HASH_ROLLING) {
+        uInt str;
+
+        s->ins_h = s->window[0];
+        UPDATE_HASH(s, s->ins_h, s->window[1]);
+        for (str = 0; str + MIN_MATCH <= end; str++) {
+            UPDATE_HASH(s, s->ins_h, s->window[str + (MIN_MATCH-1)]);
+            s->head[s->ins_h] = NIL;
+        }
+    }
+    else
+        CLEAR_HASH(s);
 
     /* Set the default configuration parameters:
      */
@@ -686,6 +1468,7 @@ local void lm_init(deflate_state *s) {
     s->block_start = 0L;
     s->lookahead = 0;
     s->insert = 0;
+    s->block_open = 0;
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
@@ -701,6 +1484,162 @@ int ZEXPORT deflateReset(z_streamp strm) {
     return ret;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateBatch(z_streamp strm, z_batchp batch, unsigned n) {
+    int ret;
+
+    if (deflateStateCheck(strm) || (batch == Z_NULL && n))
+        return Z_STREAM_ERROR;
+    for (; n; n--, batch++) {
+        deflateReset(strm);
+        strm->next_in = batch->next_in;
+        strm->avail_in = batch->avail_in;
+        strm->next_out = batch->next_out;
+        strm->avail_out = batch->avail_out;
+        ret = deflate(strm, Z_FINISH);
+        batch->next_in = strm->next_in;
+        batch->avail_in = strm->avail_in;
+        batch->next_out = strm->next_out;
+        batch->avail_out = strm->avail_out;
+        batch->status = ret == Z_STREAM_END ? Z_OK :
+                        ret == Z_OK ? Z_BUF_ERROR : ret;
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateHash(z_streamp strm, int hash) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if ((hash != Z_HASH_ROLLING && hash != Z_HASH_CRC32C) ||
+        s->strstart || s->lookahead || s->insert)
+        return Z_STREAM_ERROR;
+#ifdef CRC32C_INSN
+    if (hash == Z_HASH_CRC32C) {
+#  ifdef X86_SIMD
+        if (zcpu_features() & ZCPU_SSE42)
+#  endif
+            hash = CRC32C_INSN;
+    }
+#endif
+    s->hash = hash;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateAdaptive(z_streamp strm, int adaptive) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    s->adapt = adaptive != 0;
+    if (!s->adapt && (s->adapt_mode != ADAPT_MATCH ||
+                      s->adapt_next != ADAPT_MATCH)) {
+        /* Go back to finding matches at the end of the current region's
+           block, or now if it has just ended. */
+        s->adapt_next = ADAPT_MATCH;
+        if (s->next_level < 0) {
+            s->next_level = s->level;
+            s->next_strategy = s->strategy;
+        }
+        params_switch(s);
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateSplit(z_streamp strm, int split) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (!split) {
+        TRY_FREE(strm, s->split);
+        s->split = Z_NULL;
+    }
+    else if (s->split == Z_NULL) {
+        s->split = (split_state *) ZALLOC(strm, 1, sizeof(split_state));
+        if (s->split == Z_NULL) return Z_MEM_ERROR;
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateReuse(z_streamp strm, int reuse) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (!reuse) {
+        TRY_FREE(strm, s->reuse);
+        s->reuse = Z_NULL;
+    }
+    else if (s->reuse == Z_NULL) {
+        s->reuse = (reuse_state *) ZALLOC(strm, 1, sizeof(reuse_state));
+        if (s->reuse == Z_NULL) return Z_MEM_ERROR;
+        zmemzero((Bytef *)s->reuse, sizeof(reuse_state));
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateLatency(z_streamp strm, uLong bytes, uLong usec,
+                           int flush) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm) ||
+        (flush != Z_BLOCK && flush != Z_PARTIAL_FLUSH &&
+         flush != Z_SYNC_FLUSH && flush != Z_FULL_FLUSH))
+        return Z_STREAM_ERROR;
+    s = strm->state;
+#ifdef HAVE_CLOCK
+    if (usec && s->lat_usec == 0)
+        s->lat_first = zclock();    /* start timing input already taken */
+#else
+    if (usec)
+        return Z_STREAM_ERROR;
+#endif
+    s->lat_bytes = bytes;
+    s->lat_usec = usec;
+    s->lat_flush = flush;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateOutput(z_streamp strm, out_func out, void FAR *out_desc) {
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    strm->state->out = out;
+    strm->state->out_desc = out_desc;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateLitMem(z_streamp strm, int lit_mem) {
+    deflate_state *s;
+    uchf *buf;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->sym_next || s->pending)
+        return Z_STREAM_ERROR;
+    lit_mem = lit_mem != 0;
+    if (lit_mem && s->lit_bufs < 5) {
+        /* d_buf and l_buf need one more lit_bufsize than sym_buf */
+        buf = (uchf *) ZALLOC(strm, s->lit_bufsize, 5);
+        if (buf == Z_NULL)
+            return Z_MEM_ERROR;
+        ZFREE(strm, s->pending_buf);
+        s->pending_buf = buf;
+        s->pending_out = buf;
+        s->lit_bufs = 5;
+    }
+    s->lit_mem = lit_mem;
+    sym_init(s);
+    return Z_OK;
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateSetHeader(z_streamp strm, gz_headerp head) {
     if (deflateStateCheck(strm) || strm->state->wrap != 2)
@@ -712,10 +1651,11 @@ int ZEXPORT deflateSetHeader(z_streamp strm, gz_headerp head) {
 /* ========================================================================= */
 int ZEXPORT deflatePending(z_streamp strm, unsigned *pending, int *bits) {
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    /* count the whole bytes in the bit buffer as pending */
     if (pending != Z_NULL)
-        *pending = strm->state->pending;
+        *pending = strm->state->pending + (strm->state->bi_valid >> 3);
     if (bits != Z_NULL)
-        *bits = strm->state->bi_valid;
+        *bits = strm->state->bi_valid & 7;
     return Z_OK;
 }
 
@@ -727,6 +1667,18 @@ int ZEXPORT deflateUsed(z_streamp strm, int *bits) {
     return Z_OK;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateGetStats(z_streamp strm, z_deflate_stats *stats) {
+    if (deflateStateCheck(strm) || stats == Z_NULL) return Z_STREAM_ERROR;
+#ifdef DEFLATE_STATS
+    *stats = strm->state->stats;
+    return Z_OK;
+#else
+    zmemzero((Bytef *)stats, sizeof(z_deflate_stats));
+    return Z_VERSION_ERROR;
+#endif
+}
+
 /* ========================================================================= */
 int ZEXPORT deflatePrime(z_streamp strm, int bits, int value) {
     deflate_state *s;
@@ -734,20 +1686,15 @@ int ZEXPORT deflatePrime(z_streamp strm, int bits, int value) {
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
     s = strm->state;
-#ifdef LIT_MEM
-    if (bits < 0 || bits > 16 ||
-        (uchf *)s->d_buf < s->pending_out + ((Buf_size + 7) >> 3))
-        return Z_BUF_ERROR;
-#else
     if (bits < 0 || bits > 16 ||
-        s->sym_buf < s->pending_out + ((Buf_size + 7) >> 3))
+        (s->lit_mem ? (uchf *)s->d_buf : s->sym_buf) <
+            s->pending_out + ((Buf_size + 7) >> 3))
         return Z_BUF_ERROR;
-#endif
     do {
         put = Buf_size - s->bi_valid;
         if (put > bits)
             put = bits;
-        s->bi_buf |= (ush)((value & ((1 << put) - 1)) << s->bi_valid);
+        s->bi_buf |= (bi_t)(value & ((1 << put) - 1)) << s->bi_valid;
         s->bi_valid += put;
         _tr_flush_bits(s);
         value >>= put;
@@ -769,35 +1716,41 @@ int ZEXPORT deflateParams(z_streamp strm, int level, int strategy) {
 #else
     if (level == Z_DEFAULT_COMPRESSION) level = 6;
 #endif
-    if (level < 0 || level > 9 || strategy < 0 || strategy > Z_FIXED) {
+    if (level < 0 || level > MAX_LEVEL || strategy < 0 ||
+        strategy > Z_QUICK) {
         return Z_STREAM_ERROR;
     }
+#ifndef FASTEST
+    if (level > 9 && s->opt == Z_NULL) {
+        s->opt = opt_alloc(strm, s->opt_size);
+        if (s->opt == Z_NULL) return Z_MEM_ERROR;
+    }
+#endif
     func = configuration_table[s->level].func;
 
     if ((strategy != s->strategy || func != configuration_table[level].func) &&
         s->last_flush != -2) {
+        int err;
+
+        if (s->level != 0 && level != 0 &&
+            s->strategy != Z_QUICK && strategy != Z_QUICK) {
+            /* Switch at the end of the current block, or now if it has just
+               ended. deflate_stored() and deflate_quick() make their own
+               blocks, so switching to or from those flushes instead. */
+            s->next_level = level;
+            s->next_strategy = strategy;
+            params_switch(s);
+            return Z_OK;
+        }
+
         /* Flush the last buffer: */
-        int err = deflate(strm, Z_BLOCK);
+        err = deflate(strm, Z_BLOCK);
         if (err == Z_STREAM_ERROR)
             return err;
         if (strm->avail_in || (s->strstart - s->block_start) + s->lookahead)
             return Z_BUF_ERROR;
     }
-    if (s->level != level) {
-        if (s->level == 0 && s->matches != 0) {
-            if (s->matches == 1)
-                slide_hash(s);
-            else
-                CLEAR_HASH(s);
-            s->matches = 0;
-        }
-        s->level = level;
-        s->max_lazy_match   = configuration_table[level].max_lazy;
-        s->good_match       = configuration_table[level].good_length;
-        s->nice_match       = configuration_table[level].nice_length;
-        s->max_chain_length = configuration_table[level].max_chain;
-    }
-    s->strategy = strategy;
+    params_set(s, level, strategy);
     return Z_OK;
 }
 
@@ -815,6 +1768,42 @@ int ZEXPORT deflateTune(z_streamp strm, int good_length, int max_lazy,
     return Z_OK;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateOptimize(z_streamp strm, int iterations, uLong memory) {
+    deflate_state *s;
+    uInt size;
+
+    if (deflateStateCheck(strm) || iterations < 1) return Z_STREAM_ERROR;
+    s = strm->state;
+#ifndef FASTEST
+    size = s->lit_bufsize - 1;
+    if (memory) {
+        ulg fixed = opt_bytes(0), each = opt_bytes(1) - fixed;
+
+        if (memory < fixed + each * size)
+            size = memory < fixed + each * OPT_MIN ? OPT_MIN :
+                   (uInt)((memory - fixed) / each);
+        if (size > s->lit_bufsize - 1)
+            size = s->lit_bufsize - 1;
+    }
+    if (size != s->opt_size) {
+        s->opt_size = size;
+        TRY_FREE(strm, s->opt);
+        s->opt = Z_NULL;
+    }
+    if ((s->level > 9 || s->next_level > 9) && s->opt == Z_NULL) {
+        /* needed now, or after a pending switch from deflateParams() */
+        s->opt = opt_alloc(strm, s->opt_size);
+        if (s->opt == Z_NULL) return Z_MEM_ERROR;
+    }
+#else
+    (void)memory;
+    (void)size;
+#endif
+    s->max_iterations = (uInt)iterations;
+    return Z_OK;
+}
+
 /* =========================================================================
  * For the default windowBits of 15 and memLevel of 8, this function returns a
  * close to exact, as well as small, upper bound on the compressed size. This
@@ -893,6 +1882,10 @@ uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
         wraplen = 18;
     }
 
+    /* Z_QUICK never uses stored blocks, so return the fixed block bound */
+    if (s->strategy == Z_QUICK && s->level)
+        return fixedlen + wraplen;
+
     /* if not default parameters, return one of the conservative bounds */
     if (s->w_bits != 15 || s->hash_bits != 8 + 7)
         return (s->w_bits <= s->hash_bits && s->level ? fixedlen : storelen) +
@@ -904,6 +1897,33 @@ uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
            (sourceLen >> 25) + 13 - 6 + wraplen;
 }
 
+/* ========================================================================= */
+uLong ZEXPORT deflateMemUsage(z_streamp strm) {
+    deflate_state *s;
+    ulg used;
+
+    if (deflateStateCheck(strm))
+        return 0;
+    s = strm->state;
+
+    /* the allocations in deflateInit2_(), deflateLitMem(), opt_alloc(),
+       deflateSplit(), and deflateReuse() */
+    used = sizeof(deflate_state) +
+           ((ulg)s->w_size + WIN_PAD) * 2*sizeof(Byte) +
+           (ulg)s->w_size * sizeof(Chain) +
+           (ulg)s->hash_size * sizeof(Pos) +
+           (ulg)s->lit_bufsize * s->lit_bufs;
+#ifndef FASTEST
+    if (s->opt != Z_NULL)
+        used += opt_bytes(s->opt->size);
+#endif
+    if (s->split != Z_NULL)
+        used += sizeof(split_state);
+    if (s->reuse != Z_NULL)
+        used += sizeof(reuse_state);
+    return used;
+}
+
 /* =========================================================================
  * Put a short in the pending buffer. The 16-bit value is put in MSB order.
  * IN assertion: the stream state is correct and there is enough room in
@@ -950,8 +1970,11 @@ local void flush_pending(z_streamp strm) {
                                 s->pending - (beg)); \
     } while (0)
 
-/* ========================================================================= */
-int ZEXPORT deflate(z_streamp strm, int flush) {
+/* ===========================================================================
+ * Compress as much as possible from next_in to next_out, with the given flush.
+ * This is deflate() without deflateLatency() and deflateOutput().
+ */
+local int deflate_step(z_streamp strm, int flush) {
     int old_flush; /* value of flush param for previous deflate call */
     deflate_state *s;
 
@@ -1048,7 +2071,7 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
             put_byte(s, 0);
             put_byte(s, 0);
             put_byte(s, 0);
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, OS_CODE);
@@ -1072,7 +2095,7 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
             put_byte(s, (Byte)((s->gzhead->time >> 8) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 16) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 24) & 0xff));
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, s->gzhead->os & 0xff);
@@ -1187,10 +2210,33 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
         (flush != Z_NO_FLUSH && s->status != FINISH_STATE)) {
         block_state bstate;
 
-        bstate = s->level == 0 ? deflate_stored(s, flush) :
-                 s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
-                 s->strategy == Z_RLE ? deflate_rle(s, flush) :
-                 (*(configuration_table[s->level].func))(s, flush);
+#ifndef CHAIN_MEM
+        /* If starting with at least a full window of input, then use the
+         * input directly as the window until there is not enough left to fill
+         * it, avoiding copies of the input. The window is copied back to the
+         * allocated memory before returning.
+         */
+        if (s->level != 0 && s->strstart == 0 && s->lookahead == 0 &&
+            strm->avail_in >= s->window_size) {
+            s->direct = s->window;
+            s->window = (Bytef *)strm->next_in;
+        }
+#endif
+        /* Continue with a new compression function after a block boundary,
+           if one was requested by deflateParams(). */
+        params_switch(s);
+        do {
+            bstate = s->level == 0 ? deflate_stored(s, flush) :
+                     s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
+                     s->strategy == Z_RLE ? deflate_rle(s, flush) :
+                     s->strategy == Z_QUICK ? deflate_quick(s, flush) :
+                     s->adapt_mode == ADAPT_STORE ? deflate_pass(s, flush) :
+                     s->adapt_mode == ADAPT_HUFF ? deflate_huff(s, flush) :
+                     (*(configuration_table[s->level].func))(s, flush);
+        } while (bstate == need_more && strm->avail_out != 0 &&
+                 params_switch(s));
+        if (s->direct != Z_NULL)
+            direct_end(s);
 
         if (bstate == finish_started || bstate == finish_done) {
             s->status = FINISH_STATE;
@@ -1262,6 +2308,102 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
     return s->pending != 0 ? Z_OK : Z_STREAM_END;
 }
 
+/* ===========================================================================
+ * Return true if the input taken since the last emit has waited as long as
+ * deflateLatency() allows.
+ */
+local int lat_due(deflate_state *s) {
+#ifdef HAVE_CLOCK
+    return s->lat_usec && s->lat_since &&
+           zclock() - s->lat_first >= s->lat_usec;
+#else
+    (void)s;
+    return 0;
+#endif
+}
+
+/* ===========================================================================
+ * deflate() with the bounds set by deflateLatency() and the function set by
+ * deflateOutput(). The input is given to deflate_step() in pieces that end
+ * where a block is to be emitted, and each piece is compressed with the emit
+ * flush, except that the application's flush is used instead when the piece
+ * ends the input. The output of each piece is pushed to out(), if there is
+ * one. An emit cut short by avail_out is completed first on the next call.
+ */
+local int deflate_bounded(z_streamp strm, int flush) {
+    deflate_state *s = strm->state;
+    Bytef *buf = strm->next_out;        /* output space given to out() */
+    uInt room = strm->avail_out;        /* size of that space */
+    uInt left = strm->avail_in;         /* input not yet taken */
+    uLong took = strm->total_in, made = strm->total_out;
+    uInt take;
+    ulg need;
+    int ret, step, emit, full;
+
+    for (;;) {
+        /* take the input up to the next emit, if there is one in it */
+        emit = s->lat_emit;
+        take = emit ? 0 : left;
+        if (s->lat_bytes && !emit) {
+            need = s->lat_since < s->lat_bytes ?
+                   s->lat_bytes - s->lat_since : 0;
+            if (need <= left) {
+                take = (uInt)need;
+                emit = 1;
+            }
+        }
+        if (!emit && lat_due(s))
+            emit = 1;
+#ifdef HAVE_CLOCK
+        if (s->lat_usec && s->lat_since == 0 && take)
+            s->lat_first = zclock();
+#endif
+        step = emit && (take < left || flush == Z_NO_FLUSH) ?
+               s->lat_flush : flush;
+        strm->avail_in = take;
+        ret = deflate_step(strm, step);
+        take -= strm->avail_in;
+        left -= take;
+        s->lat_since += take;
+        if (ret == Z_STREAM_ERROR)
+            break;
+
+        /* any flush completed is an emit */
+        full = strm->avail_out == 0;
+        s->lat_emit = emit && full;
+        if (step != Z_NO_FLUSH && !full)
+            s->lat_since = 0;
+
+        /* push the output, or else return for the application to take it */
+        if (s->out != Z_NULL && strm->avail_out != room) {
+            if (s->out(s->out_desc, buf, room - strm->avail_out)) {
+                strm->avail_in = left;
+                ERR_RETURN(strm, Z_BUF_ERROR);
+            }
+            strm->next_out = buf;
+            strm->avail_out = room;
+        }
+        else if (full)
+            break;
+        if (ret != Z_OK || (left == 0 && !full && !lat_due(s)))
+            break;
+    }
+    strm->avail_in = left;
+    if (ret == Z_BUF_ERROR &&
+        (strm->total_in != took || strm->total_out != made))
+        ret = Z_OK;         /* the last step had nothing to do, but some did */
+    return ret;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflate(z_streamp strm, int flush) {
+    if (!deflateStateCheck(strm) && flush >= 0 && flush <= Z_BLOCK &&
+        (strm->state->lat_bytes || strm->state->lat_usec ||
+         strm->state->out != Z_NULL))
+        return deflate_bounded(strm, flush);
+    return deflate_step(strm, flush);
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateEnd(z_streamp strm) {
     int status;
@@ -1271,6 +2413,9 @@ int ZEXPORT deflateEnd(z_streamp strm) {
     status = strm->state->status;
 
     /* Deallocate in reverse order of allocations: */
+    TRY_FREE(strm, strm->state->reuse);
+    TRY_FREE(strm, strm->state->split);
+    TRY_FREE(strm, strm->state->opt);
     TRY_FREE(strm, strm->state->pending_buf);
     TRY_FREE(strm, strm->state->head);
     TRY_FREE(strm, strm->state->prev);
@@ -1300,6 +2445,8 @@ int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
     if (deflateStateCheck(source) || dest == Z_NULL) {
         return Z_STREAM_ERROR;
     }
+    if (source->zfree == zarena_free)
+        return Z_MEM_ERROR;     /* no room in a deflateInitMem() block */
 
     ss = source->state;
 
@@ -1311,29 +2458,43 @@ int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
     zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
     ds->strm = dest;
 
-    ds->window = (Bytef *) ZALLOC(dest, ds->w_size, 2*sizeof(Byte));
-    ds->prev   = (Posf *)  ZALLOC(dest, ds->w_size, sizeof(Pos));
+    ds->window = (Bytef *) ZALLOC(dest, ds->w_size + WIN_PAD, 2*sizeof(Byte));
+    ds->prev   = (Chainf *) ZALLOC(dest, ds->w_size, sizeof(Chain));
     ds->head   = (Posf *)  ZALLOC(dest, ds->hash_size, sizeof(Pos));
-    ds->pending_buf = (uchf *) ZALLOC(dest, ds->lit_bufsize, LIT_BUFS);
+    ds->pending_buf = (uchf *) ZALLOC(dest, ds->lit_bufsize,
+                                      (uInt)ds->lit_bufs);
+    ds->opt = Z_NULL;
+#ifndef FASTEST
+    if (ss->opt != Z_NULL && ds->pending_buf != Z_NULL)
+        ds->opt = opt_alloc(dest, ss->opt->size);
+#endif
+    ds->split = Z_NULL;
+    if (ss->split != Z_NULL && ds->pending_buf != Z_NULL)
+        ds->split = (split_state *) ZALLOC(dest, 1, sizeof(split_state));
+    ds->reuse = Z_NULL;
+    if (ss->reuse != Z_NULL && ds->pending_buf != Z_NULL)
+        ds->reuse = (reuse_state *) ZALLOC(dest, 1, sizeof(reuse_state));
 
     if (ds->window == Z_NULL || ds->prev == Z_NULL || ds->head == Z_NULL ||
-        ds->pending_buf == Z_NULL) {
+        ds->pending_buf == Z_NULL ||
+        (ss->opt != Z_NULL && ds->opt == Z_NULL) ||
+        (ss->split != Z_NULL && ds->split == Z_NULL) ||
+        (ss->reuse != Z_NULL && ds->reuse == Z_NULL)) {
         deflateEnd (dest);
         return Z_MEM_ERROR;
     }
     /* following zmemcpy do not work for 16-bit MSDOS */
-    zmemcpy(ds->window, ss->window, ds->w_size * 2 * sizeof(Byte));
-    zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Pos));
+    zmemcpy(ds->window, ss->window,
+            (ds->w_size + WIN_PAD) * 2 * sizeof(Byte));
+    zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Chain));
     zmemcpy((voidpf)ds->head, (voidpf)ss->head, ds->hash_size * sizeof(Pos));
-    zmemcpy(ds->pending_buf, ss->pending_buf, ds->lit_bufsize * LIT_BUFS);
+    zmemcpy(ds->pending_buf, ss->pending_buf,
+            ds->lit_bufsize * (uInt)ds->lit_bufs);
+    if (ds->reuse != Z_NULL)
+        zmemcpy((voidpf)ds->reuse, (voidpf)ss->reuse, sizeof(reuse_state));
 
     ds->pending_out = ds->pending_buf + (ss->pending_out - ss->pending_buf);
-#ifdef LIT_MEM
-    ds->d_buf = (ushf *)(ds->pending_buf + (ds->lit_bufsize << 1));
-    ds->l_buf = ds->pending_buf + (ds->lit_bufsize << 2);
-#else
-    ds->sym_buf = ds->pending_buf + ds->lit_bufsize;
-#endif
+    sym_init(ds);
 
     ds->l_desc.dyn_tree = ds->dyn_ltree;
     ds->d_desc.dyn_tree = ds->dyn_dtree;
@@ -1352,6 +2513,11 @@ int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
  * IN assertions: cur_match is the head of the hash chain for the current
  *   string (strstart) and its distance is <= MAX_DIST, and prev_length >= 1
  * OUT assertion: the match length is not greater than s->lookahead.
+ *
+ * The configuration_table parameters and w_mask are read from s once per
+ * call, and are in registers for the loop. Copies of this function with them
+ * as constants for each level and windowBits 15 were no faster: the time is
+ * in following the chain and comparing the strings.
  */
 local uInt longest_match(deflate_state *s, IPos cur_match) {
     unsigned chain_length = s->max_chain_length;/* max hash chain length */
@@ -1365,8 +2531,27 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
     /* Stop when cur_match becomes <= limit. To simplify the code,
      * we prevent matches with the string of window index 0.
      */
-    Posf *prev = s->prev;
+    Chainf *prev = s->prev;
     uInt wmask = s->w_mask;
+    int check2 = s->hash != Z_HASH_ROLLING;
+    /* Only the rolling hash assures that scan[2] == match[2] when the first
+     * two bytes of strings on the same hash chain match (see below). With
+     * any other hash, scan[2] must be compared.
+     */
+#ifdef CHAIN_MEM
+    int check = best_len < CHAIN_BYTES ? best_len + 1 : CHAIN_BYTES;
+    /* The number of saved bytes that must match for a longer match. */
+#  ifdef Z_U8
+    /* Compare the saved bytes eight at a time, including the link, masked to
+     * the first check bytes. A Chain is eight bytes.
+     */
+    Z_U8 lead, mask, word;
+    uch ones[8];
+#  else
+    uchf *str;
+#  endif
+    int k;
+#endif
 
 #ifdef UNALIGNED_OK
     /* Compare two bytes at a time. Note: this is not always beneficial.
@@ -1397,11 +2582,35 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
 
     Assert((ulg)s->strstart <= s->window_size - MIN_LOOKAHEAD,
            "need lookahead");
+#if defined(CHAIN_MEM) && defined(Z_U8)
+    zmemcpy((Bytef *)&lead, scan, 8);
+    for (k = 0; k < 8; k++)
+        ones[k] = k < check ? 0xff : 0;
+    zmemcpy((Bytef *)&mask, ones, 8);
+#endif
 
+    STAT(s, searches, 1);
     do {
         Assert(cur_match < s->strstart, "no future");
+        STAT(s, chain_steps, 1);
         match = s->window + cur_match;
 
+#ifdef CHAIN_MEM
+        /* Prefetch the next link on the chain, and reject this candidate
+         * with the bytes saved with its link, if they differ from scan.
+         */
+        PREFETCH(prev + (prev[cur_match & wmask].link & wmask));
+#  ifdef Z_U8
+        zmemcpy((Bytef *)&word, (Bytef *)(prev + (cur_match & wmask)), 8);
+        if ((word ^ lead) & mask) continue;
+#  else
+        str = prev[cur_match & wmask].bytes;
+        for (k = 0; k < check && str[k] == scan[k]; k++)
+            ;
+        if (k < check) continue;
+#  endif
+#endif
+
         /* Skip to next match if the match length cannot increase
          * or if the match length is less than 2.  Note that the checks below
          * for insufficient lookahead only occur occasionally for performance
@@ -1415,7 +2624,8 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
          * UNALIGNED_OK if your compiler uses a different size.
          */
         if (*(ushf*)(match + best_len - 1) != scan_end ||
-            *(ushf*)match != scan_start) continue;
+            *(ushf*)match != scan_start ||
+            (check2 && match[2] != scan[2])) continue;
 
         /* It is not necessary to compare scan[2] and match[2] since they are
          * always equal when the other bytes match, given that the hash keys
@@ -1427,29 +2637,37 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
          * to check more often for insufficient lookahead.
          */
         Assert(scan[2] == match[2], "scan[2]?");
-        scan++, match++;
-        do {
-        } while (*(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
-                 *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
-                 *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
-                 *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
-                 scan < strend);
-        /* The funny "do {}" generates better code on most compilers */
-
-        /* Here, scan <= window + strstart + 257 */
-        Assert(scan <= s->window + (unsigned)(s->window_size - 1),
-               "wild scan");
-        if (*scan == *match) scan++;
+#ifdef SIMD_COMPARE
+        if (s->compare != Z_NULL)
+            len = (int)(*s->compare)(scan, match);
+        else
+#endif
+        {
+            scan++, match++;
+            do {
+            } while (*(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
+                     *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
+                     *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
+                     *(ushf*)(scan += 2) == *(ushf*)(match += 2) &&
+                     scan < strend);
+            /* The funny "do {}" generates better code on most compilers */
+
+            /* Here, scan <= window + strstart + 257 */
+            Assert(scan <= s->window + (unsigned)(s->window_size - 1),
+                   "wild scan");
+            if (*scan == *match) scan++;
 
-        len = (MAX_MATCH - 1) - (int)(strend - scan);
-        scan = strend - (MAX_MATCH-1);
+            len = (MAX_MATCH - 1) - (int)(strend - scan);
+            scan = strend - (MAX_MATCH-1);
+        }
 
 #else /* UNALIGNED_OK */
 
         if (match[best_len]     != scan_end  ||
             match[best_len - 1] != scan_end1 ||
             *match              != *scan     ||
-            *++match            != scan[1])      continue;
+            *++match            != scan[1]   ||
+            (check2 && match[1] != scan[2])) continue;
 
         /* The check at best_len - 1 can be removed because it will be made
          * again later. (This heuristic is not always a win.)
@@ -1457,24 +2675,33 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
          * are always equal when the other bytes match, given that
          * the hash keys are equal and that HASH_BITS >= 8.
          */
-        scan += 2, match++;
-        Assert(*scan == *match, "match[2]?");
+#ifdef SIMD_COMPARE
+        if (s->compare != Z_NULL) {
+            Assert(scan[2] == match[1], "match[2]?");
+            len = (int)(*s->compare)(scan, match - 1);
+        }
+        else
+#endif
+        {
+            scan += 2, match++;
+            Assert(*scan == *match, "match[2]?");
 
-        /* We check for insufficient lookahead only every 8th comparison;
-         * the 256th check will be made at strstart + 258.
-         */
-        do {
-        } while (*++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 scan < strend);
+            /* We check for insufficient lookahead only every 8th comparison;
+             * the 256th check will be made at strstart + 258.
+             */
+            do {
+            } while (*++scan == *++match && *++scan == *++match &&
+                     *++scan == *++match && *++scan == *++match &&
+                     *++scan == *++match && *++scan == *++match &&
+                     *++scan == *++match && *++scan == *++match &&
+                     scan < strend);
 
-        Assert(scan <= s->window + (unsigned)(s->window_size - 1),
-               "wild scan");
+            Assert(scan <= s->window + (unsigned)(s->window_size - 1),
+                   "wild scan");
 
-        len = MAX_MATCH - (int)(strend - scan);
-        scan = strend - MAX_MATCH;
+            len = MAX_MATCH - (int)(strend - scan);
+            scan = strend - MAX_MATCH;
+        }
 
 #endif /* UNALIGNED_OK */
 
@@ -1487,21 +2714,32 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
 #else
             scan_end1  = scan[best_len - 1];
             scan_end   = scan[best_len];
+#endif
+#ifdef CHAIN_MEM
+            if (check < CHAIN_BYTES) {
+                check = best_len < CHAIN_BYTES ? best_len + 1 : CHAIN_BYTES;
+#  ifdef Z_U8
+                for (k = 0; k < check; k++)
+                    ones[k] = 0xff;
+                zmemcpy((Bytef *)&mask, ones, 8);
+#  endif
+            }
 #endif
         }
-    } while ((cur_match = prev[cur_match & wmask]) > limit
+    } while ((cur_match = CHAIN_LINK(prev[cur_match & wmask])) > limit
              && --chain_length != 0);
 
     if ((uInt)best_len <= s->lookahead) return (uInt)best_len;
     return s->lookahead;
 }
 
-#else /* FASTEST */
+#endif /* FASTEST */
 
 /* ---------------------------------------------------------------------------
- * Optimized version for FASTEST only
+ * Check only the head of the hash chain. This is longest_match() for FASTEST,
+ * and is also used by deflate_quick().
  */
-local uInt longest_match(deflate_state *s, IPos cur_match) {
+local uInt longest_match_fast(deflate_state *s, IPos cur_match) {
     register Bytef *scan = s->window + s->strstart; /* current string */
     register Bytef *match;                       /* matched string */
     register int len;                           /* length of current match */
@@ -1516,12 +2754,16 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
            "need lookahead");
 
     Assert(cur_match < s->strstart, "no future");
+    STAT(s, searches, 1);
+    STAT(s, chain_steps, 1);
 
     match = s->window + cur_match;
 
     /* Return failure if the match length is less than 2:
      */
-    if (match[0] != scan[0] || match[1] != scan[1]) return MIN_MATCH-1;
+    if (match[0] != scan[0] || match[1] != scan[1] ||
+        (s->hash != Z_HASH_ROLLING && match[2] != scan[2]))
+        return MIN_MATCH-1;
 
     /* The check at best_len - 1 can be removed because it will be made
      * again later. (This heuristic is not always a win.)
@@ -1529,22 +2771,30 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
      * are always equal when the other bytes match, given that
      * the hash keys are equal and that HASH_BITS >= 8.
      */
-    scan += 2, match += 2;
-    Assert(*scan == *match, "match[2]?");
-
-    /* We check for insufficient lookahead only every 8th comparison;
-     * the 256th check will be made at strstart + 258.
-     */
-    do {
-    } while (*++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             scan < strend);
+#ifdef SIMD_COMPARE
+    if (s->compare != Z_NULL)
+        len = (int)(*s->compare)(scan, match);
+    else
+#endif
+    {
+        scan += 2, match += 2;
+        Assert(*scan == *match, "match[2]?");
 
-    Assert(scan <= s->window + (unsigned)(s->window_size - 1), "wild scan");
+        /* We check for insufficient lookahead only every 8th comparison;
+         * the 256th check will be made at strstart + 258.
+         */
+        do {
+        } while (*++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 scan < strend);
+
+        Assert(scan <= s->window + (unsigned)(s->window_size - 1),
+               "wild scan");
 
-    len = MAX_MATCH - (int)(strend - scan);
+        len = MAX_MATCH - (int)(strend - scan);
+    }
 
     if (len < MIN_MATCH) return MIN_MATCH - 1;
 
@@ -1552,7 +2802,9 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
     return (uInt)len <= s->lookahead ? (uInt)len : s->lookahead;
 }
 
-#endif /* FASTEST */
+#ifdef FASTEST
+#  define longest_match longest_match_fast
+#endif
 
 #ifdef ZLIB_DEBUG
 
@@ -1595,6 +2847,7 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
  * IN assertion: strstart is set to the end of the current match.
  */
 #define FLUSH_BLOCK_ONLY(s, last) { \
+   if (s->adapt && !(last)) adapt_block(s); \
    _tr_flush_block(s, (s->block_start >= 0L ? \
                    (charf *)&s->window[(unsigned)s->block_start] : \
                    (charf *)Z_NULL), \
@@ -1605,10 +2858,24 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
    Tracev((stderr,"[FLUSH]")); \
 }
 
-/* Same but force premature exit if necessary. */
+/* Same but force premature exit if necessary, or to let deflate() switch to
+   the compression function requested by deflateParams(). */
 #define FLUSH_BLOCK(s, last) { \
    FLUSH_BLOCK_ONLY(s, last); \
-   if (s->strm->avail_out == 0) return (last) ? finish_started : need_more; \
+   if (s->strm->avail_out == 0 || (!(last) && s->next_level >= 0)) \
+       return (last) ? finish_started : need_more; \
+}
+
+/* Emit the input from block_start to strstart as a stored block for
+   deflate_pass(), returning like FLUSH_BLOCK(). */
+#define STORE_BLOCK(s, last) { \
+   _tr_stored_block(s, (charf *)s->window + s->block_start, \
+                    (ulg)((long)s->strstart - s->block_start), (last)); \
+   s->block_start = s->strstart; \
+   if (last) s->bi_used = 8; \
+   flush_pending(s->strm); \
+   if (s->strm->avail_out == 0 || (!(last) && s->next_level >= 0)) \
+       return (last) ? finish_started : need_more; \
 }
 
 /* Maximum stored block length in deflate format (not including header). */
@@ -1617,6 +2884,80 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
 /* Minimum of a and b. */
 #define MIN(a, b) ((a) > (b) ? (b) : (a))
 
+/* ===========================================================================
+ * Return the number of equally likely byte values that would have the same
+ * chance as the len bytes at buf of two picked at random being equal. This is
+ * two to the power of their order-two entropy in bits per byte, which is near
+ * 256 for random or already compressed data, and much less for text.
+ */
+local unsigned adapt_spread(const Bytef *buf, unsigned len) {
+    unsigned count[256], n;
+    ulg same = 0;
+
+    zmemzero(count, sizeof(count));
+    for (n = 0; n < len; n++)
+        count[buf[n]]++;
+    for (n = 0; n < 256; n++)
+        same += (ulg)count[n] * (count[n] - 1);
+    n = same ? (unsigned)(((ulg)len * (len - 1)) / same) : 256;
+    return n > 256 ? 256 : n;
+}
+
+/* ===========================================================================
+ * For deflateAdaptive(), judge the block about to be emitted, and request a
+ * switch at its end to the region that the input following it should be in.
+ * If the matches of a block save less than a sixteenth of its bytes, and the
+ * bytes at its end are spread over most of the byte values, then the input is
+ * taken to be compressed or encrypted data, which deflate_pass() copies to
+ * stored blocks. If the spread is less, deflate_huff() codes the bytes as
+ * literals, without spending time on matches that aren't there. A region
+ * ends when the spread changes, or after adapt_left bytes in order to look
+ * for matches again, with each region that goes on that long running for
+ * twice as long the next time.
+ */
+local void adapt_block(deflate_state *s) {
+    ulg len = (ulg)((long)s->strstart - s->block_start);
+    unsigned n, spread;
+    int mode = s->adapt_mode;
+
+    if (s->level == 0 || mode == ADAPT_STORE ||
+        (s->strategy != Z_DEFAULT_STRATEGY && s->strategy != Z_FILTERED))
+        return;
+    if (mode == ADAPT_HUFF && s->adapt_left <= len)
+        mode = ADAPT_MATCH;
+    else {
+        if (mode == ADAPT_HUFF)
+            s->adapt_left -= len;
+        n = (unsigned)MIN(len, ADAPT_SAMPLE);
+        if (n > s->strstart)
+            n = s->strstart;
+        if (n < ADAPT_MIN)
+            return;
+        spread = adapt_spread(s->window + s->strstart - n, n);
+        if (mode == ADAPT_HUFF) {
+            if (spread >= ADAPT_RANDOM)
+                mode = ADAPT_STORE;
+            else if (spread < ADAPT_SKEWED) {
+                mode = ADAPT_MATCH;
+                s->adapt_probe = ADAPT_PROBE;
+            }
+        }
+        else if (s->sym_next / SYM_SIZE(s) <= len - (len >> 4))
+            s->adapt_probe = ADAPT_PROBE;
+        else if (spread >= ADAPT_SKEWED) {
+            mode = spread >= ADAPT_RANDOM ? ADAPT_STORE : ADAPT_HUFF;
+            s->adapt_left = s->adapt_probe;
+            if (s->adapt_probe < ADAPT_PROBE_MAX)
+                s->adapt_probe <<= 1;
+        }
+    }
+    s->adapt_next = mode;
+    if (mode != s->adapt_mode && s->next_level < 0) {
+        s->next_level = s->level;
+        s->next_strategy = s->strategy;
+    }
+}
+
 /* ===========================================================================
  * Copy without compression as much as possible from the input stream, return
  * the current block state.
@@ -1914,6 +3255,97 @@ local block_state deflate_fast(deflate_state *s, int flush) {
     return block_done;
 }
 
+/* Room to leave in pending_buf for one match, the end of the block, the
+   header of the next block, and emptying the bit buffer. */
+#define QUICK_MARGIN 24
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, sending the literals
+ * and matches directly as fixed-code blocks, and return the current block
+ * state. This is used for the Z_QUICK strategy. Only the most recent string
+ * with the same hash is checked for a match, no strings are inserted in the
+ * dictionary within matches, and fixed codes avoid collecting symbols and
+ * constructing trees. This trades compression for speed. s->block_open is
+ * 0 when no block has been started, 1 for a block in progress, or 2 for the
+ * last block in progress.
+ */
+local block_state deflate_quick(deflate_state *s, int flush) {
+    IPos hash_head;       /* head of the hash chain */
+    uInt len;             /* length of the current match */
+    int last = flush == Z_FINISH;
+
+    if (last && s->block_open != 2) {
+        /* end any block in progress and start the last block */
+        if (s->block_open)
+            _tr_quick_end(s, 0);
+        _tr_quick_start(s, 1);
+        s->block_open = 2;
+    }
+    for (;;) {
+        if (s->pending + QUICK_MARGIN > s->pending_buf_size) {
+            flush_pending(s->strm);
+            if (s->strm->avail_out == 0) {
+                s->block_start = s->strstart;
+                return need_more;
+            }
+        }
+
+        /* Make sure that we always have enough lookahead, except at the end
+         * of the input file, as for deflate_fast().
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                s->block_start = s->strstart;
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* end the current block */
+        }
+        if (s->block_open == 0) {
+            _tr_quick_start(s, 0);
+            s->block_open = 1;
+        }
+
+        /* Insert the string window[strstart .. strstart + 2] in the
+         * dictionary, and look for a match at the head of its hash chain.
+         */
+        if (s->lookahead >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart, hash_head);
+            if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s) &&
+                (len = longest_match_fast(s, hash_head)) >= MIN_MATCH) {
+                check_match(s, s->strstart, s->match_start, len);
+                _tr_quick_dist(s, s->strstart - s->match_start,
+                               len - MIN_MATCH);
+                s->lookahead -= len;
+                s->strstart += len;
+                s->ins_h = s->window[s->strstart];
+                UPDATE_HASH(s, s->ins_h, s->window[s->strstart + 1]);
+#if MIN_MATCH != 3
+                Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+                continue;
+            }
+        }
+
+        /* No match, output a literal byte */
+        Tracevv((stderr,"%c", s->window[s->strstart]));
+        _tr_quick_lit(s, s->window[s->strstart]);
+        s->lookahead--;
+        s->strstart++;
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    s->block_start = s->strstart;
+    last = s->block_open == 2;
+    if (s->block_open) {
+        _tr_quick_end(s, last);
+        s->block_open = 0;
+        flush_pending(s->strm);
+        if (s->strm->avail_out == 0)
+            return last ? finish_started : need_more;
+    }
+    return last ? finish_done : block_done;
+}
+
 #ifndef FASTEST
 /* ===========================================================================
  * Same as above, but achieves better compression. We use a lazy
@@ -2009,10 +3441,22 @@ local block_state deflate_slow(deflate_state *s, int flush) {
              * single literal. If there was a match but the current match
              * is longer, truncate the previous match to a single literal.
              */
+            STAT(s, lazy_wins, s->prev_length >= MIN_MATCH);
             Tracevv((stderr,"%c", s->window[s->strstart - 1]));
             _tr_tally_lit(s, s->window[s->strstart - 1], bflush);
             if (bflush) {
                 FLUSH_BLOCK_ONLY(s, 0);
+                if (s->next_level >= 0 && s->strm->avail_out != 0) {
+                    /* Emit this position as a literal in a block of its own,
+                       so that deflate() can switch at the end of it. This
+                       waits for the pending output to be written, since the
+                       symbols share its buffer. */
+                    _tr_tally_lit(s, s->window[s->strstart], bflush);
+                    s->match_available = 0;
+                    s->strstart++;
+                    s->lookahead--;
+                    FLUSH_BLOCK(s, 0);
+                }
             }
             s->strstart++;
             s->lookahead--;
@@ -2041,6 +3485,390 @@ local block_state deflate_slow(deflate_state *s, int flush) {
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
+
+/* ===========================================================================
+ * Same as deflate_fast(), but with a bounded lazy evaluation. When a match is
+ * shorter than max_lazy_match, only the next position is checked for a longer
+ * match. If there is one, a literal is emitted and the longer match is taken
+ * without looking further ahead. Otherwise the first match is taken. Unlike
+ * deflate_slow(), a position is never reconsidered after the next one has
+ * been checked, so no state is carried from one step to the next. The strings
+ * in a match are inserted in the dictionary, unless the match is longer than
+ * nice_match, since the search would have stopped there anyway.
+ */
+local block_state deflate_medium(deflate_state *s, int flush) {
+    IPos hash_head;       /* head of the hash chain */
+    int bflush;           /* set if current block must be flushed */
+    int inserted;         /* 1 if the string at strstart + 1 is inserted */
+
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file. We need MAX_MATCH bytes
+         * for the next match, plus MIN_MATCH bytes to insert the
+         * string following the next match.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        /* Insert the string window[strstart .. strstart + 2] in the
+         * dictionary, and set hash_head to the head of the hash chain:
+         */
+        hash_head = NIL;
+        if (s->lookahead >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart, hash_head);
+        }
+
+        /* Find the longest match, discarding short and distant ones as for
+         * deflate_slow().
+         */
+        s->prev_length = s->match_length = MIN_MATCH-1;
+        if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+            s->match_length = longest_match (s, hash_head);
+            /* longest_match() sets match_start */
+
+            if (s->match_length <= 5 && (s->strategy == Z_FILTERED
+#if TOO_FAR <= 32767
+                || (s->match_length == MIN_MATCH &&
+                    s->strstart - s->match_start > TOO_FAR)
+#endif
+                )) {
+                s->match_length = MIN_MATCH-1;
+            }
+        }
+
+        /* If the match is short, check the next position for a longer one.
+         * This needs room in sym_buf for both a literal and a match, input
+         * after the match, and room in the window for longest_match().
+         */
+        inserted = 0;
+        if (s->match_length >= MIN_MATCH &&
+            s->match_length < s->max_lazy_match &&
+            s->lookahead > s->match_length &&
+            s->sym_next + 2 * SYM_SIZE(s) <= s->sym_end &&
+            s->strstart < s->window_size - MIN_LOOKAHEAD) {
+            uInt length = s->match_length;
+            IPos start = s->match_start;
+
+            s->strstart++;
+            s->lookahead--;
+            INSERT_STRING(s, s->strstart, hash_head);
+            if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+                /* only look for matches longer than the first one */
+                s->prev_length = length;
+                s->match_length = longest_match (s, hash_head);
+                s->prev_length = MIN_MATCH-1;
+            }
+            if (s->match_length > length) {
+                /* emit the first byte as a literal and take the new match */
+                STAT(s, lazy_wins, 1);
+                Tracevv((stderr,"%c", s->window[s->strstart - 1]));
+                _tr_tally_lit(s, s->window[s->strstart - 1], bflush);
+                Assert(!bflush, "no room for lazy match");
+            } else {
+                /* take the first match */
+                s->strstart--;
+                s->lookahead++;
+                s->match_length = length;
+                s->match_start = start;
+                inserted = 1;
+            }
+        }
+
+        if (s->match_length >= MIN_MATCH) {
+            /* Do not insert strings in hash table beyond this. */
+            uInt max_insert = s->strstart + s->lookahead - MIN_MATCH;
+
+            check_match(s, s->strstart, s->match_start, s->match_length);
+
+            _tr_tally_dist(s, s->strstart - s->match_start,
+                           s->match_length - MIN_MATCH, bflush);
+
+            /* Insert in hash table all strings up to the end of the match,
+             * if it is not too long. strstart, and strstart + 1 if inserted is
+             * set, are already inserted. If there is not enough lookahead, the
+             * last two strings are not inserted in the hash table.
+             */
+            s->lookahead -= s->match_length;
+            if (s->match_length > (uInt)s->nice_match) {
+                s->strstart += s->match_length;
+                s->match_length = 0;
+                s->ins_h = s->window[s->strstart];
+                UPDATE_HASH(s, s->ins_h, s->window[s->strstart + 1]);
+#if MIN_MATCH != 3
+                Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+            } else {
+                s->match_length -= 1 + inserted;
+                s->strstart += 1 + inserted;
+            }
+            while (s->match_length != 0) {
+                if (s->strstart <= max_insert) {
+                    INSERT_STRING(s, s->strstart, hash_head);
+                }
+                s->strstart++;
+                s->match_length--;
+            }
+        } else {
+            /* No match, output a literal byte */
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_tally_lit(s, s->window[s->strstart], bflush);
+            s->lookahead--;
+            s->strstart++;
+        }
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
+/* ===========================================================================
+ * Save up to max matches for the string at pos in len[] and dist[], searching
+ * the hash chain that starts at cur_match. Each match saved is longer than the
+ * one before it, and so is farther away, which makes the matches saved the
+ * nearest ones for every length up to the longest. If there are more than max,
+ * the last one saved is replaced. No match is longer than maxlen. Return the
+ * number of matches saved.
+ */
+local unsigned find_matches(deflate_state *s, IPos cur_match, IPos pos,
+                            unsigned maxlen, ushf *len, ushf *dist,
+                            unsigned max) {
+    unsigned chain_length = s->max_chain_length;
+    Bytef *scan = s->window + pos;
+    Bytef *match;
+    unsigned n = 0, best = MIN_MATCH - 1, nice = (unsigned)s->nice_match, k;
+    IPos limit = pos > (IPos)MAX_DIST(s) ? pos - (IPos)MAX_DIST(s) : NIL;
+#ifdef SIMD_COMPARE
+    /* the vectorized comparisons read MAX_MATCH bytes past the string */
+    int simd = s->compare != Z_NULL && pos + MAX_MATCH < s->window_size;
+#endif
+
+    if (nice > maxlen) nice = maxlen;
+    STAT(s, searches, 1);
+    do {
+        Assert(cur_match < pos, "no future");
+        STAT(s, chain_steps, 1);
+        match = s->window + cur_match;
+        if (match[best] != scan[best] || match[0] != scan[0] ||
+            match[1] != scan[1] || match[2] != scan[2])
+            continue;
+#ifdef SIMD_COMPARE
+        if (simd) {
+            k = (*s->compare)(scan, match);
+            if (k > maxlen) k = maxlen;
+        }
+        else
+#endif
+        {
+            k = MIN_MATCH;
+            while (k < maxlen && scan[k] == match[k])
+                k++;
+        }
+        if (k > best) {
+            if (n == max) n--;
+            len[n] = (ush)k;
+            dist[n] = (ush)(pos - cur_match);
+            n++;
+            best = k;
+            if (k >= nice) break;
+        }
+    } while ((cur_match = CHAIN_LINK(s->prev[cur_match & s->w_mask])) >
+             limit && --chain_length != 0);
+    return n;
+}
+
+/* ===========================================================================
+ * Choose the literals and matches for the len bytes at strstart that have the
+ * smallest total cost, tally them, and return true if the symbol buffer is
+ * then full. The strings are inserted in the dictionary and their matches
+ * found once. Then each pass finds the cheapest path through the segment by
+ * dynamic programming, with the costs of the Huffman codes that would be made
+ * for the current block plus the symbols chosen by the previous pass. The
+ * first pass uses the current block alone, or the fixed codes if the block is
+ * empty. The passes stop after max_iterations, or when a pass chooses the
+ * same path as the one before it.
+ */
+local int optimal_segment(deflate_state *s, uInt len) {
+    opt_state *opt = s->opt;
+    IPos hash_head;             /* head of the hash chain */
+    Bytef *str = s->window + s->strstart;
+    ushf *mlen, *mdist;         /* matches at the current position */
+    uInt i, j, k, n, l;
+    uInt used, steps = 0, iter = 0;
+    uInt need = s->hash == Z_HASH_ROLLING ? MIN_MATCH : 4;
+    ulg c, d, t, sum, last = 0;
+    int bflush = 0;             /* set if current block must be flushed */
+
+    /* Insert the strings and find their matches, keeping at least one entry
+     * of the pool for each position after this one. The CRC-32C hash reads
+     * four bytes, so with it the last three bytes of a flush are not
+     * inserted, since the parse can reach the end of the window.
+     */
+    used = 0;
+    for (i = 0; i < len; i++) {
+        opt->count[i] = 0;
+        if (s->lookahead - i >= need) {
+            INSERT_STRING(s, s->strstart + i, hash_head);
+            if (hash_head != NIL && len - i >= MIN_MATCH &&
+                s->strstart + i - hash_head <= MAX_DIST(s)) {
+                n = opt->pool - used - (len - 1 - i);
+                n = find_matches(s, hash_head, s->strstart + i,
+                                 MIN(len - i, MAX_MATCH), opt->mlen + used,
+                                 opt->mdist + used, MIN(n, OPT_MATCHES));
+                opt->count[i] = (ush)n;
+                used += n;
+            }
+        }
+    }
+
+    zmemzero((Bytef *)opt->ltree, sizeof(opt->ltree));
+    zmemzero((Bytef *)opt->dtree, sizeof(opt->dtree));
+    for (;;) {
+        _tr_opt_costs(s, opt, iter == 0 && s->sym_next == 0);
+
+        /* Find the cheapest way to reach each position. Only the longest
+         * match is tried where it reaches nice_match.
+         */
+        opt->cost[0] = 0;
+        for (j = 1; j <= len; j++)
+            opt->cost[j] = ~(ulg)0;
+        mlen = opt->mlen;
+        mdist = opt->mdist;
+        for (i = 0; i < len; i++) {
+            c = opt->cost[i];
+            t = c + opt->lit_cost[str[i]];
+            if (t < opt->cost[i + 1]) {
+                opt->cost[i + 1] = t;
+                opt->step[i + 1] = 1;
+            }
+            n = opt->count[i];
+            if (n == 0)
+                continue;
+            k = 0;
+            l = MIN_MATCH;
+            if (mlen[n - 1] >= (uInt)s->nice_match) {
+                k = n - 1;
+                l = mlen[k];
+            }
+            for (; k < n; k++) {
+                d = c + opt->dist_cost[d_code(mdist[k] - 1)];
+                for (; l <= mlen[k]; l++) {
+                    t = d + opt->len_cost[l];
+                    if (t < opt->cost[i + l]) {
+                        opt->cost[i + l] = t;
+                        opt->step[i + l] = (ush)l;
+                        opt->dist[i + l] = mdist[k];
+                    }
+                }
+            }
+            mlen += n;
+            mdist += n;
+        }
+
+        /* Trace the path back from the end, and stop if it is the same as the
+         * one from the previous pass.
+         */
+        steps = 0;
+        for (j = len; j; j -= opt->step[j])
+            opt->path[steps++] = (ush)j;
+        sum = adler32(1L, (const Bytef *)opt->path,
+                      steps * (uInt)sizeof(ush));
+        if (++iter >= s->max_iterations || (iter > 1 && sum == last))
+            break;
+        last = sum;
+
+        /* Count the symbols on the path for the costs of the next pass. */
+        zmemzero((Bytef *)opt->ltree, sizeof(opt->ltree));
+        zmemzero((Bytef *)opt->dtree, sizeof(opt->dtree));
+        for (k = 0; k < steps; k++) {
+            j = opt->path[k];
+            l = opt->step[j];
+            if (l == 1)
+                opt->ltree[str[j - 1]].Freq++;
+            else {
+                opt->ltree[_length_code[l - MIN_MATCH] + LITERALS + 1].Freq++;
+                opt->dtree[d_code(opt->dist[j] - 1)].Freq++;
+            }
+        }
+    }
+
+    /* Tally the path, first step first. */
+    while (steps) {
+        j = opt->path[--steps];
+        l = opt->step[j];
+        i = s->strstart + j - l;
+        if (l == 1) {
+            Tracevv((stderr,"%c", s->window[i]));
+            _tr_tally_lit(s, s->window[i], bflush);
+        }
+        else {
+            check_match(s, i, i - opt->dist[j], (int)l);
+            _tr_tally_dist(s, opt->dist[j], l - MIN_MATCH, bflush);
+        }
+    }
+    s->strstart += len;
+    s->lookahead -= len;
+    return bflush;
+}
+
+/* ===========================================================================
+ * Optimal parsing, for levels 10 to 12. The input is taken in segments of up
+ * to opt->size bytes, each of which is parsed by optimal_segment(). The parse
+ * waits for a full segment, plus MIN_LOOKAHEAD bytes for the matches at its
+ * end, unless the window is full or the input is being flushed. A new block
+ * is started when there is not enough room left in the symbol buffer for a
+ * quarter of a segment, since each byte of a segment can take a symbol.
+ */
+local block_state deflate_optimal(deflate_state *s, int flush) {
+    uInt len, room;
+
+    Assert(s->opt != Z_NULL, "no optimal parsing memory");
+    for (;;) {
+        if (s->lookahead < s->opt->size + MIN_LOOKAHEAD) {
+            if (s->strstart + s->lookahead < s->window_size ||
+                s->strstart >= s->w_size + MAX_DIST(s))
+                fill_window(s);
+            if (s->lookahead < s->opt->size + MIN_LOOKAHEAD &&
+                s->strstart + s->lookahead < s->window_size &&
+                flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        /* Leave the lookahead for the last matches, unless flushing. */
+        len = s->lookahead;
+        if (flush == Z_NO_FLUSH || s->strm->avail_in != 0)
+            len -= MIN_LOOKAHEAD;
+        len = MIN(len, s->opt->size);
+
+        room = (s->sym_end - s->sym_next) / SYM_SIZE(s);
+        if (room < len && room < s->opt->size >> 2) {
+            FLUSH_BLOCK(s, 0);
+            room = (s->sym_end - s->sym_next) / SYM_SIZE(s);
+        }
+        if (optimal_segment(s, MIN(len, room)))
+            FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
 #endif /* FASTEST */
 
 /* ===========================================================================
@@ -2150,3 +3978,71 @@ local block_state deflate_huff(deflate_state *s, int flush) {
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
+
+/* ===========================================================================
+ * For a region of deflateAdaptive() that looks incompressible, copy the input
+ * to stored blocks without looking for matches or counting literals. Like
+ * deflate_huff(), do not maintain a hash table. The spread of the bytes (see
+ * adapt_spread()) is checked for each ADAPT_SAMPLE bytes before they are
+ * added to a block, in order to end the region where compressible data
+ * starts. Blocks are made no longer than MAX_DIST(s), so that the window
+ * never slides past the start of one.
+ */
+local block_state deflate_pass(deflate_state *s, int flush) {
+    ulg max, len;
+
+    /* leave room in pending for the block header and any bits before it */
+    max = MIN(s->pending_buf_size - ((Buf_size + 41) >> 3), MAX_DIST(s));
+    for (;;) {
+        /* Get a sample's worth of lookahead, unless at the end of the input */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH)
+                return need_more;
+            if (s->lookahead == 0)
+                break;      /* flush the current block */
+        }
+
+        /* Take as much of the lookahead as fits in the block, up to a sample,
+           or end the region if the sample is compressible, if it has run its
+           length, or if deflateParams() or deflateAdaptive() asked */
+        len = max - (ulg)((long)s->strstart - s->block_start);
+        if (len > s->lookahead)
+            len = s->lookahead;
+        if (len > ADAPT_SAMPLE)
+            len = ADAPT_SAMPLE;
+        if (s->next_level < 0 && (s->adapt_left <= len ||
+                (len >= MIN_LOOKAHEAD &&
+                 adapt_spread(s->window + s->strstart, (unsigned)len) <
+                     ADAPT_RANDOM - (ADAPT_RANDOM >> 2)))) {
+            if (s->adapt_left > len)
+                s->adapt_probe = ADAPT_PROBE;
+            s->adapt_next = ADAPT_MATCH;
+            s->next_level = s->level;
+            s->next_strategy = s->strategy;
+        }
+        if (s->next_level >= 0) {
+            if ((long)s->strstart != s->block_start)
+                STORE_BLOCK(s, 0);
+            return need_more;
+        }
+        s->adapt_left -= len;
+        s->strstart += (uInt)len;
+        s->lookahead -= (uInt)len;
+        if ((ulg)((long)s->strstart - s->block_start) == max)
+            STORE_BLOCK(s, 0);
+    }
+    s->insert = 0;
+    if (flush == Z_FINISH) {
+        if ((long)s->strstart != s->block_start) {
+            STORE_BLOCK(s, 1);
+        }
+        else {
+            FLUSH_BLOCK(s, 1);      /* empty last block with the fixed codes */
+        }
+        return finish_done;
+    }
+    if ((long)s->strstart != s->block_start)
+        STORE_BLOCK(s, 0);
+    return block_done;
+}
@@ -23,10 +23,20 @@
 #  define GZIP
 #endif
 
-/* define LIT_MEM to slightly increase the speed of deflate (order 1% to 2%) at
-   the cost of a larger memory footprint */
+/* define LIT_MEM to have deflate streams use separate distance and
+   literal/length buffers by default, which slightly increases the speed of
+   deflate (order 1% to 2%) at the cost of a larger memory footprint -- either
+   can be selected for each stream with deflateLitMem() */
 /* #define LIT_MEM */
 
+/* define CHAIN_MEM to save the first bytes of each string with its link in
+   prev[], so that longest_match() can reject many candidates without reading
+   the window, and to prefetch the next link of a hash chain.  This uses four
+   times the memory for prev[], and is slower (order 20% to 30%) when the
+   window and prev[] fit in the level 2 cache.  It can help when a cache miss
+   on the window costs more than the larger prev[] */
+/* #define CHAIN_MEM */
+
 /* ===========================================================================
  * Internal compression state.
  */
@@ -52,8 +62,14 @@
 #define MAX_BITS 15
 /* All codes must not exceed MAX_BITS bits */
 
-#define Buf_size 16
-/* size of bit buffer in bi_buf */
+#ifdef Z_U8
+   typedef Z_U8 bi_t;
+#  define Buf_size 64
+#else
+   typedef ulg bi_t;
+#  define Buf_size 32
+#endif
+/* type of the bit buffer bi_buf, and the number of bits of it that are used */
 
 #define INIT_STATE    42    /* zlib header -> BUSY_STATE */
 #ifdef GZIP
@@ -101,6 +117,92 @@ typedef unsigned IPos;
  * save space in the various tables. IPos is used only for parameter passing.
  */
 
+#ifdef CHAIN_MEM
+#  define CHAIN_BYTES 6
+typedef struct chain_s {
+    uch bytes[CHAIN_BYTES];     /* first bytes of the string at this index */
+    Pos link;                   /* older string with the same hash index */
+} Chain;
+#  define CHAIN_LINK(c) ((c).link)
+#  define WIN_PAD ((CHAIN_BYTES - MIN_MATCH + 1) >> 1)
+#else
+typedef Pos Chain;
+#  define CHAIN_LINK(c) (c)
+#  define WIN_PAD 0
+#endif
+typedef Chain FAR Chainf;
+/* An entry of prev[], and the link in it. WIN_PAD is the number of extra
+ * pairs of bytes allocated after the window, so that the first CHAIN_BYTES of
+ * the last strings inserted can be read.
+ */
+
+typedef unsigned (*compare_func)(const Bytef *scan, const Bytef *match);
+/* String comparison used by longest_match(). Given two strings whose first
+ * MIN_MATCH bytes are taken to be equal, return their match length, at most
+ * MAX_MATCH.
+ */
+
+typedef void (*slide_func)(Posf *table, unsigned n, unsigned wsize);
+/* Subtract wsize from the n entries of table, setting entries less than wsize
+ * to NIL. Used by slide_hash() on head[] and prev[].
+ */
+
+typedef struct opt_state_s {
+    ct_data ltree[HEAP_SIZE];   /* symbol frequencies in, code lengths out */
+    ct_data dtree[2*D_CODES+1]; /* same for the distance codes */
+    ush lit_cost[LITERALS];     /* bits to code each literal */
+    ush len_cost[MAX_MATCH+1];  /* bits to code each match length */
+    ush dist_cost[D_CODES];     /* bits to code each distance code */
+    uInt size;                  /* maximum number of bytes in a segment */
+    uInt pool;                  /* number of entries in mlen[] and mdist[] */
+    ulg FAR *cost;              /* cost of the best path to each position */
+    ushf *step;                 /* length of the last step of that path */
+    ushf *dist;                 /* distance of that step, if it is a match */
+    ushf *count;                /* number of matches found at each position */
+    ushf *path;                 /* positions on the best path, last first */
+    ushf *mlen;                 /* lengths of the matches found */
+    ushf *mdist;                /* distances of the matches found */
+} FAR opt_state;
+/* Working memory for deflate_optimal(), which chooses the matches and
+ * literals for segments of up to size bytes. The matches at each position
+ * are listed in order of increasing length and distance.
+ */
+
+#define SPLIT_SEGS 8
+/* number of equal segments of symbols that a block is cut into when looking
+ * for a better place to end it
+ */
+
+typedef struct split_state_s {
+    ct_data ltree[HEAP_SIZE];     /* trees built to cost a run of segments */
+    ct_data dtree[2*D_CODES+1];
+    ush freq[SPLIT_SEGS+1][L_CODES+D_CODES]; /* counts before each boundary */
+    ulg len[SPLIT_SEGS+1];        /* input bytes before each boundary */
+    unsigned sym[SPLIT_SEGS+1];   /* symbol buffer index of each boundary */
+    ulg cost[SPLIT_SEGS+1];       /* bits of the best blocks up to a boundary */
+    int from[SPLIT_SEGS+1];       /* where the last of those blocks starts */
+} FAR split_state;
+/* Working memory for deflateSplit(), used by _tr_flush_block() to code the
+ * symbols of a block as several blocks when that is smaller.
+ */
+
+typedef struct reuse_state_s {
+    ct_data ltree[HEAP_SIZE];     /* saved literal/length codes */
+    ct_data dtree[2*D_CODES+1];   /* saved distance codes */
+    ct_data bl_tree[BL_CODES];    /* codes for their code lengths */
+    int lcodes, dcodes, blcodes;  /* codes in the header, 0 if none */
+    ulg header;                   /* bits in the header after the block type */
+    ulg rate;                     /* data bits per symbol, times 256 */
+    ush freq[L_CODES+D_CODES];    /* recent counts the codes are built from */
+    ulg total;                    /* literal/length symbols in the counts */
+    ulg guess;                    /* bits of the block with saved codes, or 0 */
+    int trust;                    /* log2 of the next run of blocks to skip */
+    int skip;                     /* blocks left to code without checking */
+} FAR reuse_state;
+/* Codes built by _tr_flush_block() from the symbol counts of recent blocks
+ * when deflateReuse() is on, and used for later blocks that they fit.
+ */
+
 typedef struct internal_state {
     z_streamp strm;      /* pointer back to this zlib stream */
     int   status;        /* as the name implies */
@@ -113,6 +215,14 @@ typedef struct internal_state {
     ulg   gzindex;       /* where in extra, name, or comment */
     Byte  method;        /* can only be DEFLATED */
     int   last_flush;    /* value of flush param for previous deflate call */
+    ulg   lat_bytes;     /* emit a block after this much input, or 0 */
+    ulg   lat_usec;      /* or after input has waited this long, or 0 */
+    int   lat_flush;     /* flush to emit the block with */
+    int   lat_emit;      /* true if an emit was cut short by avail_out */
+    ulg   lat_since;     /* input taken since the last emit */
+    ulg   lat_first;     /* zclock() when the first of that input was taken */
+    out_func out;        /* function to push output to, or Z_NULL */
+    void FAR *out_desc;  /* first argument of out() */
 
                 /* used by deflate.c: */
 
@@ -127,7 +237,14 @@ typedef struct internal_state {
      * wSize-MAX_MATCH bytes, but this ensures that IO is always
      * performed with a length multiple of the block size. Also, it limits
      * the window size to 64K, which is quite useful on MSDOS.
-     * To do: use the user input buffer as sliding window.
+     * When a stream starts with at least a window's worth of input, window
+     * instead points directly into the user input buffer, moving forward
+     * through it in place of the copies (see fill_window()).
+     */
+
+    Bytef *direct;
+    /* The allocated window while window points into the input, else Z_NULL.
+     * It is only non-null during a deflate() call.
      */
 
     ulg window_size;
@@ -135,7 +252,7 @@ typedef struct internal_state {
      * is directly used as sliding window.
      */
 
-    Posf *prev;
+    Chainf *prev;
     /* Link to older string with same hash index. To limit the size of this
      * array to 64K, this link is maintained only for the last 32K strings.
      * An index in this array is thus a window index modulo 32K.
@@ -155,6 +272,11 @@ typedef struct internal_state {
      *   hash_shift * MIN_MATCH >= hash_bits
      */
 
+    int   hash;
+    /* Hash function used for ins_h, Z_HASH_ROLLING or Z_HASH_CRC32C (the
+     * latter possibly recorded as the instruction variant in deflate.c).
+     */
+
     long block_start;
     /* Window position at the beginning of the current output block. Gets
      * negative when the window is moved backwards.
@@ -188,15 +310,56 @@ typedef struct internal_state {
      * greater than this length. This saves time but degrades compression.
      * max_insert_length is used only for compression levels <= 3.
      */
+#   define max_iterations  max_lazy_match
+    /* Number of passes of deflate_optimal() over each segment, each using the
+     * code lengths that resulted from the previous pass. max_iterations is
+     * used only for compression levels >= 10.
+     */
 
-    int level;    /* compression level (1..9) */
+    int level;    /* compression level (1..12) */
     int strategy; /* favor or force Huffman coding*/
 
+    int next_level;     /* level to switch to at the end of the block, or -1 */
+    int next_strategy;  /* strategy to switch to with next_level */
+    /* deflateParams() defers a change of the compression function to the end
+     * of the current block, so that the block is not cut short.
+     */
+
+    int adapt;          /* true to pass over incompressible regions */
+    int adapt_mode;     /* ADAPT_MATCH, ADAPT_HUFF, or ADAPT_STORE */
+    int adapt_next;     /* mode to switch to with next_level */
+    ulg adapt_left;     /* bytes left in the region before matching again */
+    ulg adapt_probe;    /* length of the next region */
+    /* With deflateAdaptive(), a region of input that looks like it is already
+     * compressed is coded as literals by deflate_huff() or copied to stored
+     * blocks by deflate_pass(), switching with next_level at block ends.
+     */
+
     uInt good_match;
     /* Use a faster search when the previous match is longer than this */
 
     int nice_match; /* Stop searching when current match exceeds this */
 
+    compare_func compare;
+    /* Vectorized string comparison selected for this processor, or Z_NULL to
+     * use the byte-by-byte loop in longest_match().
+     */
+
+    slide_func slide;
+    /* Hash table slide selected for this processor */
+
+    opt_state *opt;
+    /* Working memory for deflate_optimal(), or Z_NULL if not allocated */
+
+    uInt opt_size;
+    /* Maximum segment length for deflate_optimal() */
+
+    split_state *split;
+    /* Working memory for splitting blocks, or Z_NULL if not splitting */
+
+    reuse_state *reuse;
+    /* Codes saved for reuse by later blocks, or Z_NULL if not reusing */
+
                 /* used by trees.c: */
     /* Didn't use ct_data typedef below to suppress compiler warning */
     struct ct_data_s dyn_ltree[HEAP_SIZE];   /* literal and length tree */
@@ -222,13 +385,15 @@ typedef struct internal_state {
      */
 
 #ifdef LIT_MEM
-#   define LIT_BUFS 5
+#   define LIT_BUFS 5     /* initial lit_bufs, for d_buf and l_buf */
+#else
+#   define LIT_BUFS 4     /* initial lit_bufs, for sym_buf */
+#endif
+    int lit_mem;          /* true to use d_buf and l_buf, false for sym_buf */
+    int lit_bufs;         /* size of pending_buf in units of lit_bufsize */
     ushf *d_buf;          /* buffer for distances */
     uchf *l_buf;          /* buffer for literals/lengths */
-#else
-#   define LIT_BUFS 4
     uchf *sym_buf;        /* buffer for distances and literals/lengths */
-#endif
 
     uInt  lit_bufsize;
     /* Size of match buffer for literals/lengths.  There are 4 reasons for
@@ -257,15 +422,16 @@ typedef struct internal_state {
     ulg static_len;     /* bit length of current block with static trees */
     uInt matches;       /* number of string matches in current block */
     uInt insert;        /* bytes at end of window left to insert */
+    int block_open;     /* deflate_quick() block: 0 none, 1 open, 2 last */
 
 #ifdef ZLIB_DEBUG
     ulg compressed_len; /* total bit length of compressed file mod 2^32 */
     ulg bits_sent;      /* bit length of compressed data sent mod 2^32 */
 #endif
 
-    ush bi_buf;
+    bi_t bi_buf;
     /* Output buffer. bits are inserted starting at the bottom (least
-     * significant bits).
+     * significant bits), and written to pending_buf Buf_size bits at a time.
      */
     int bi_valid;
     /* Number of valid bits in bi_buf.  All bits above the last valid bit
@@ -282,8 +448,32 @@ typedef struct internal_state {
      * updated to the new high water mark.
      */
 
+#ifdef DEFLATE_STATS
+    z_deflate_stats stats;
+    /* Counts of the work done, returned by deflateGetStats() */
+#endif
+
 } FAR deflate_state;
 
+/* A dictionary prepared by deflatePrepareDictionary(): the window and hash
+ * tables that deflateSetDictionary() makes from it, to be copied into each
+ * stream that uses it.
+ */
+struct z_deflate_dict_s {
+    free_func zfree;    /* to free this, from the preparing stream */
+    voidpf opaque;
+    uInt w_size;        /* w_size, hash_size, and hash of the streams that */
+    uInt hash_size;     /*  can use this dictionary */
+    int hash;
+    uLong adler;        /* Adler-32 of the whole dictionary */
+    uInt strstart;      /* bytes of the dictionary in the window */
+    uInt insert;        /* and the state after inserting them */
+    uInt ins_h;
+    Chainf *prev;       /* w_size entries */
+    Posf *head;         /* hash_size entries */
+    Bytef *window;      /* strstart bytes */
+};
+
 /* Output a byte on the stream.
  * IN assertion: there is enough room in pending_buf.
  */
@@ -300,10 +490,20 @@ typedef struct internal_state {
  * distances are limited to MAX_DIST instead of WSIZE.
  */
 
+#define SYM_SIZE(s) ((s)->lit_mem ? 1 : 3)
+/* Number of entries in the symbol buffer used by one symbol. */
+
 #define WIN_INIT MAX_MATCH
 /* Number of bytes after end of data in window to initialize in order to avoid
    memory checker errors from longest match routines */
 
+/* Add n to the count in s->stats, if DEFLATE_STATS is defined. */
+#ifdef DEFLATE_STATS
+#  define STAT(s, count, n) ((s)->stats.count += (n))
+#else
+#  define STAT(s, count, n) ((void)0)
+#endif
+
         /* in trees.c */
 void ZLIB_INTERNAL _tr_init(deflate_state *s);
 int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc);
@@ -313,6 +513,12 @@ void ZLIB_INTERNAL _tr_flush_bits(deflate_state *s);
 void ZLIB_INTERNAL _tr_align(deflate_state *s);
 void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
                                     ulg stored_len, int last);
+void ZLIB_INTERNAL _tr_quick_start(deflate_state *s, int last);
+void ZLIB_INTERNAL _tr_quick_lit(deflate_state *s, unsigned c);
+void ZLIB_INTERNAL _tr_quick_dist(deflate_state *s, unsigned dist,
+                                  unsigned lc);
+void ZLIB_INTERNAL _tr_quick_end(deflate_state *s, int last);
+void ZLIB_INTERNAL _tr_opt_costs(deflate_state *s, opt_state *opt, int fixed);
 
 #define d_code(dist) \
    ((dist) < 256 ? _dist_code[dist] : _dist_code[256+((dist)>>7)])
@@ -321,9 +527,6 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
  * used.
  */
 
-#ifndef ZLIB_DEBUG
-/* Inline versions of _tr_tally for speed: */
-
 #if defined(GEN_TREES_H) || !defined(STDC)
   extern uch ZLIB_INTERNAL _length_code[];
   extern uch ZLIB_INTERNAL _dist_code[];
@@ -332,45 +535,42 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
   extern const uch ZLIB_INTERNAL _dist_code[];
 #endif
 
-#ifdef LIT_MEM
-# define _tr_tally_lit(s, c, flush) \
-  { uch cc = (c); \
-    s->d_buf[s->sym_next] = 0; \
-    s->l_buf[s->sym_next++] = cc; \
-    s->dyn_ltree[cc].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
-   }
-# define _tr_tally_dist(s, distance, length, flush) \
-  { uch len = (uch)(length); \
-    ush dist = (ush)(distance); \
-    s->d_buf[s->sym_next] = dist; \
-    s->l_buf[s->sym_next++] = len; \
-    dist--; \
-    s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
-    s->dyn_dtree[d_code(dist)].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
-  }
-#else
+#ifndef ZLIB_DEBUG
+/* Inline versions of _tr_tally for speed: */
+
 # define _tr_tally_lit(s, c, flush) \
   { uch cc = (c); \
-    s->sym_buf[s->sym_next++] = 0; \
-    s->sym_buf[s->sym_next++] = 0; \
-    s->sym_buf[s->sym_next++] = cc; \
+    if (s->lit_mem) { \
+        s->d_buf[s->sym_next] = 0; \
+        s->l_buf[s->sym_next++] = cc; \
+    } \
+    else { \
+        s->sym_buf[s->sym_next++] = 0; \
+        s->sym_buf[s->sym_next++] = 0; \
+        s->sym_buf[s->sym_next++] = cc; \
+    } \
     s->dyn_ltree[cc].Freq++; \
+    STAT(s, literals, 1); \
     flush = (s->sym_next == s->sym_end); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
   { uch len = (uch)(length); \
     ush dist = (ush)(distance); \
-    s->sym_buf[s->sym_next++] = (uch)dist; \
-    s->sym_buf[s->sym_next++] = (uch)(dist >> 8); \
-    s->sym_buf[s->sym_next++] = len; \
+    if (s->lit_mem) { \
+        s->d_buf[s->sym_next] = dist; \
+        s->l_buf[s->sym_next++] = len; \
+    } \
+    else { \
+        s->sym_buf[s->sym_next++] = (uch)dist; \
+        s->sym_buf[s->sym_next++] = (uch)(dist >> 8); \
+        s->sym_buf[s->sym_next++] = len; \
+    } \
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
+    STAT(s, matches, 1); \
     flush = (s->sym_next == s->sym_end); \
   }
-#endif
 #else
 # define _tr_tally_lit(s, c, flush) flush = _tr_tally(s, 0, c)
 # define _tr_tally_dist(s, distance, length, flush) \
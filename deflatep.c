@@ -0,0 +1,697 @@
+/* deflatep.c -- compress data using multiple threads
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      The input is divided into chunks, each of which is compressed by itself
+ *      as raw deflate data. A chunk is primed with the preceding window's worth
+ *      of uncompressed data using deflateSetDictionary(), so that little
+ *      compression is lost at the chunk boundaries. Every chunk except the last
+ *      is ended with a sync flush, which leaves the compressed data on a byte
+ *      boundary without a last block. The compressed chunks can then simply be
+ *      concatenated, in order, to make a single deflate stream. The check
+ *      values of the chunks are likewise computed separately, and combined in
+ *      order with adler32_combine() or crc32_combine(). The result is one
+ *      ordinary zlib, gzip, or raw deflate stream, which can be decompressed
+ *      by inflate() or any other inflator.
+ *
+ *      The chunks are compressed by a pool of worker threads, each with its
+ *      own deflate stream. The application's thread copies input into the
+ *      chunk being filled, hands full chunks to the workers, and copies the
+ *      compressed chunks to the output in order as they are completed. At most
+ *      two chunks per thread are in progress at any time, which bounds the
+ *      memory used. If there are no threads, or there is only one, then each
+ *      chunk is compressed by the application's thread when it is submitted.
+ */
+
+/* @(#) $Id$ */
+
+#include "zthread.h"
+
+#define PAR_STATE 4217  /* status of a parallel stream, rejected by deflate */
+#define PAR_CHUNK 131072UL              /* default chunk size */
+#define PAR_MAX_CHUNK 0x40000000UL      /* largest permitted chunk size */
+
+/* A chunk of input and its compressed data. */
+typedef struct par_job_s par_job;
+struct par_job_s {
+    par_job *next;      /* next job in stream order, or next free job */
+    Bytef *in;          /* dictionary followed by the input */
+    uInt dict;          /* length of the dictionary at the start of in */
+    uInt len;           /* length of the input after the dictionary */
+    int flush;          /* Z_SYNC_FLUSH, or Z_FINISH for the last chunk */
+    int done;           /* true when the compressed data is ready */
+    int ret;            /* Z_OK, or an error from compressing the chunk */
+    uLong check;        /* check value of the input */
+    Bytef *out;         /* compressed data */
+    uInt have;          /* length of the compressed data */
+    uInt sent;          /* number of compressed bytes written so far */
+};
+
+/* A deflate stream for compressing jobs, and the thread that uses it. */
+typedef struct par_state_s par_state;
+typedef struct {
+    par_state *s;       /* the parallel state this belongs to */
+    z_stream strm;      /* raw deflate stream for this thread */
+#ifdef HAVE_THREADS
+    zthread thread;     /* the worker thread, if there are workers */
+#endif
+} par_thread;
+
+/* The parallel deflate state, at strm->state. The first two members mirror
+   those of deflate_state, so that the deflate functions reject this state. */
+struct par_state_s {
+    z_streamp strm;     /* pointer back to this zlib stream */
+    int status;         /* PAR_STATE */
+    int wrap;           /* 0 for raw, 1 for zlib, 2 for gzip */
+    int err;            /* Z_OK, or the first error, which is returned again */
+    int finish;         /* true once the last chunk has been submitted */
+    uInt wsize;         /* window size, the most dictionary a chunk uses */
+    uInt chunk;         /* size of the input chunks */
+    uInt bound;         /* size of the compressed data buffers */
+    uLong check;        /* check value of the input written so far */
+    Byte extra[10];     /* zlib or gzip header or trailer */
+    uInt extra_len;     /* length of the header or trailer */
+    uInt extra_sent;    /* number of header or trailer bytes written */
+    Bytef *dict;        /* the last wsize bytes of input (or fewer) */
+    uInt dlen;          /* number of bytes in dict */
+    par_job *fill;      /* job being filled with input, or Z_NULL */
+    par_job *first;     /* oldest job submitted and not yet written */
+    par_job *last;      /* newest job submitted */
+    par_job *todo;      /* oldest job not yet taken by a worker */
+    par_job *spare;     /* list of jobs available for reuse */
+    int jobs;           /* number of jobs from first to last */
+    int max;            /* maximum number of jobs in progress */
+    int threads;        /* number of deflate streams in pool */
+    par_thread *pool;   /* deflate streams, one for each thread */
+#ifdef HAVE_THREADS
+    int running;        /* number of worker threads started */
+    int quit;           /* true to make the workers exit */
+    zmutex lock;        /* protects todo, done, and quit */
+    zcond work;         /* signaled when todo is set or quit is set */
+    zcond ready;        /* signaled when a job is done */
+#endif
+};
+
+/* ========================================================================= */
+local int parStateCheck(z_streamp strm) {
+    par_state *s;
+
+    if (strm == Z_NULL ||
+        strm->zalloc == (alloc_func)0 || strm->zfree == (free_func)0)
+        return 1;
+    s = (par_state *)strm->state;
+    if (s == Z_NULL || s->strm != strm || s->status != PAR_STATE)
+        return 1;
+    return 0;
+}
+
+/* ===========================================================================
+ * Compress the job's input using strm, which is a raw deflate stream with the
+ * parameters of the parallel stream.
+ */
+local void par_compress(par_state *s, z_streamp strm, par_job *job) {
+    int ret;
+
+    ret = deflateReset(strm);
+    if (ret == Z_OK && job->dict)
+        ret = deflateSetDictionary(strm, job->in, job->dict);
+    strm->next_in = job->in + job->dict;
+    strm->avail_in = job->len;
+    strm->next_out = job->out;
+    strm->avail_out = s->bound;
+    if (ret == Z_OK)
+        ret = deflate(strm, job->flush);
+    job->have = s->bound - strm->avail_out;
+    if (ret == (job->flush == Z_FINISH ? Z_STREAM_END : Z_OK) &&
+        strm->avail_in == 0 && strm->avail_out != 0)
+        job->ret = Z_OK;
+    else
+        job->ret = ret < 0 ? ret : Z_STREAM_ERROR;
+    if (s->wrap == 1)
+        job->check = adler32(1L, job->in + job->dict, job->len);
+#ifndef NO_GZIP
+    else if (s->wrap == 2)
+        job->check = crc32(0L, job->in + job->dict, job->len);
+#endif
+}
+
+#ifdef HAVE_THREADS
+/* ===========================================================================
+ * Worker thread: compress jobs in order as they are submitted, until told to
+ * quit.
+ */
+local void par_worker(void *arg) {
+    par_thread *me = (par_thread *)arg;
+    par_state *s = me->s;
+    par_job *job;
+
+    zmutex_lock(&s->lock);
+    for (;;) {
+        while (s->todo == Z_NULL && !s->quit)
+            zcond_wait(&s->work, &s->lock);
+        if (s->quit)
+            break;
+        job = s->todo;
+        s->todo = job->next;
+        zmutex_unlock(&s->lock);
+        par_compress(s, &me->strm, job);
+        zmutex_lock(&s->lock);
+        job->done = 1;
+        zcond_broadcast(&s->ready);
+    }
+    zmutex_unlock(&s->lock);
+}
+#endif
+
+/* ===========================================================================
+ * Wait for the oldest submitted job to be done. Without workers, jobs are done
+ * when they are submitted.
+ */
+local void par_wait(par_state *s) {
+#ifdef HAVE_THREADS
+    if (s->running && s->first != Z_NULL) {
+        zmutex_lock(&s->lock);
+        while (!s->first->done)
+            zcond_wait(&s->ready, &s->lock);
+        zmutex_unlock(&s->lock);
+    }
+#else
+    (void)s;
+#endif
+}
+
+/* Return true if job is done. */
+local int par_done(par_state *s, par_job *job) {
+#ifdef HAVE_THREADS
+    int done;
+
+    if (s->running) {
+        zmutex_lock(&s->lock);
+        done = job->done;
+        zmutex_unlock(&s->lock);
+        return done;
+    }
+#else
+    (void)s;
+#endif
+    return job->done;
+}
+
+/* ===========================================================================
+ * Start a new job to fill with input, primed with the current dictionary.
+ * Return Z_OK, or Z_MEM_ERROR if a new job could not be allocated.
+ */
+local int par_fill(par_state *s) {
+    par_job *job;
+
+    job = s->spare;
+    if (job != Z_NULL)
+        s->spare = job->next;
+    else {
+        job = (par_job *)ZALLOC(s->strm, 1, (uInt)sizeof(par_job) +
+                                s->wsize + s->chunk + s->bound);
+        if (job == Z_NULL)
+            return Z_MEM_ERROR;
+        job->in = (Bytef *)(job + 1);
+        job->out = job->in + s->wsize + s->chunk;
+    }
+    zmemcpy(job->in, s->dict, s->dlen);
+    job->dict = s->dlen;
+    job->len = 0;
+    s->fill = job;
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Submit the job being filled for compression, ending it with flush, which is
+ * Z_SYNC_FLUSH, Z_FULL_FLUSH, or Z_FINISH. Update the dictionary for the next
+ * chunk, or discard it for Z_FULL_FLUSH.
+ */
+local void par_submit(par_state *s, int flush) {
+    par_job *job = s->fill;
+    uInt n;
+
+    s->fill = Z_NULL;
+    if (flush == Z_FULL_FLUSH) {
+        s->dlen = 0;
+        flush = Z_SYNC_FLUSH;
+    }
+    else {
+        n = job->dict + job->len;
+        s->dlen = n < s->wsize ? n : s->wsize;
+        zmemcpy(s->dict, job->in + n - s->dlen, s->dlen);
+    }
+    if (flush == Z_FINISH)
+        s->finish = 1;
+    job->flush = flush;
+    job->done = 0;
+    job->sent = 0;
+    job->next = Z_NULL;
+    s->jobs++;
+#ifdef HAVE_THREADS
+    if (s->running) {
+        /* the workers follow the next links, so append under the lock */
+        zmutex_lock(&s->lock);
+        if (s->first == Z_NULL)
+            s->first = job;
+        else
+            s->last->next = job;
+        s->last = job;
+        if (s->todo == Z_NULL)
+            s->todo = job;
+        zcond_broadcast(&s->work);
+        zmutex_unlock(&s->lock);
+        return;
+    }
+#endif
+    if (s->first == Z_NULL)
+        s->first = job;
+    else
+        s->last->next = job;
+    s->last = job;
+    par_compress(s, &s->pool[0].strm, job);
+    job->done = 1;
+}
+
+/* ===========================================================================
+ * Write as much of the header, the completed jobs, and the trailer as will
+ * fit in the output, in order. An error from a job is saved in s->err.
+ */
+local void par_write(par_state *s) {
+    z_streamp strm = s->strm;
+    par_job *job;
+    uInt n;
+
+    while (strm->avail_out != 0) {
+        /* write the header or trailer */
+        if (s->extra_sent < s->extra_len) {
+            n = s->extra_len - s->extra_sent;
+            if (n > strm->avail_out)
+                n = strm->avail_out;
+            zmemcpy(strm->next_out, s->extra + s->extra_sent, n);
+            s->extra_sent += n;
+            strm->next_out += n;
+            strm->avail_out -= n;
+            strm->total_out += n;
+            continue;
+        }
+
+        /* write the oldest job's compressed data, if it's ready */
+        job = s->first;
+        if (job == Z_NULL || !par_done(s, job))
+            return;
+        if (job->ret != Z_OK) {
+            s->err = job->ret;
+            return;
+        }
+        n = job->have - job->sent;
+        if (n > strm->avail_out)
+            n = strm->avail_out;
+        zmemcpy(strm->next_out, job->out + job->sent, n);
+        job->sent += n;
+        strm->next_out += n;
+        strm->avail_out -= n;
+        strm->total_out += n;
+        if (job->sent < job->have)
+            return;
+
+        /* done with the job -- update the check value and recycle it */
+        if (s->wrap == 1)
+            s->check = adler32_combine(s->check, job->check, job->len);
+#ifndef NO_GZIP
+        else if (s->wrap == 2)
+            s->check = crc32_combine(s->check, job->check, job->len);
+#endif
+        strm->adler = s->check;
+        s->first = job->next;
+        s->jobs--;
+        job->next = s->spare;
+        s->spare = job;
+
+        /* after the last job, write the trailer */
+        if (job->flush == Z_FINISH) {
+            if (s->wrap == 1) {
+                s->extra[0] = (Byte)(s->check >> 24);
+                s->extra[1] = (Byte)(s->check >> 16);
+                s->extra[2] = (Byte)(s->check >> 8);
+                s->extra[3] = (Byte)s->check;
+                s->extra_len = 4;
+            }
+            else if (s->wrap == 2) {
+                s->extra[0] = (Byte)s->check;
+                s->extra[1] = (Byte)(s->check >> 8);
+                s->extra[2] = (Byte)(s->check >> 16);
+                s->extra[3] = (Byte)(s->check >> 24);
+                s->extra[4] = (Byte)strm->total_in;
+                s->extra[5] = (Byte)(strm->total_in >> 8);
+                s->extra[6] = (Byte)(strm->total_in >> 16);
+                s->extra[7] = (Byte)(strm->total_in >> 24);
+                s->extra_len = 8;
+            }
+            else
+                s->extra_len = 0;
+            s->extra_sent = 0;
+        }
+    }
+}
+
+/* ===========================================================================
+ * Stop the workers, and free everything allocated for the parallel state.
+ */
+local void par_free(par_state *s) {
+    z_streamp strm = s->strm;
+    par_job *job, *list[3];
+    int i;
+
+#ifdef HAVE_THREADS
+    if (s->running) {
+        zmutex_lock(&s->lock);
+        s->quit = 1;
+        zcond_broadcast(&s->work);
+        zmutex_unlock(&s->lock);
+        for (i = 0; i < s->running; i++)
+            zthread_join(s->pool[i].thread);
+        zcond_free(&s->ready);
+        zcond_free(&s->work);
+        zmutex_free(&s->lock);
+    }
+#endif
+    list[0] = s->first;
+    list[1] = s->spare;
+    list[2] = s->fill;
+    if (list[2] != Z_NULL)
+        list[2]->next = Z_NULL;
+    for (i = 0; i < 3; i++)
+        while ((job = list[i]) != Z_NULL) {
+            list[i] = job->next;
+            ZFREE(strm, job);
+        }
+    if (s->pool != Z_NULL) {
+        for (i = 0; i < s->threads; i++)
+            if (s->pool[i].s != Z_NULL)
+                deflateEnd(&s->pool[i].strm);
+        ZFREE(strm, s->pool);
+    }
+    TRY_FREE(strm, s->dict);
+    ZFREE(strm, s);
+    strm->state = Z_NULL;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateParallelInit2_(z_streamp strm, int level, int windowBits,
+                                  int memLevel, int strategy, int threads,
+                                  uLong chunk, const char *version,
+                                  int stream_size) {
+    par_state *s;
+    int wrap = 1, ret, i;
+    static const char my_version[] = ZLIB_VERSION;
+
+    if (version == Z_NULL || version[0] != my_version[0] ||
+        stream_size != sizeof(z_stream)) {
+        return Z_VERSION_ERROR;
+    }
+    if (strm == Z_NULL) return Z_STREAM_ERROR;
+
+    strm->msg = Z_NULL;
+    if (strm->zalloc == (alloc_func)0) {
+#ifdef Z_SOLO
+        return Z_STREAM_ERROR;
+#else
+        strm->zalloc = zcalloc;
+        strm->opaque = (voidpf)0;
+#endif
+    }
+    if (strm->zfree == (free_func)0)
+#ifdef Z_SOLO
+        return Z_STREAM_ERROR;
+#else
+        strm->zfree = zcfree;
+#endif
+
+#ifdef FASTEST
+    if (level != 0) level = 1;
+#else
+    if (level == Z_DEFAULT_COMPRESSION) level = 6;
+#endif
+    if (windowBits < 0) {
+        wrap = 0;
+        if (windowBits < -15)
+            return Z_STREAM_ERROR;
+        windowBits = -windowBits;
+    }
+#ifndef NO_GZIP
+    else if (windowBits > 15) {
+        wrap = 2;
+        windowBits -= 16;
+    }
+#endif
+    if (chunk == 0)
+        chunk = PAR_CHUNK;
+    if (memLevel < 1 || memLevel > MAX_MEM_LEVEL || windowBits < 8 ||
+        windowBits > 15 || level < 0 || level > MAX_LEVEL || strategy < 0 ||
+        strategy > Z_QUICK || (windowBits == 8 && wrap != 1) ||
+        threads < 1 || chunk > PAR_MAX_CHUNK)
+        return Z_STREAM_ERROR;
+    if (windowBits == 8) windowBits = 9;    /* as for deflateInit2() */
+#ifndef HAVE_THREADS
+    threads = 1;
+#endif
+
+    s = (par_state *)ZALLOC(strm, 1, sizeof(par_state));
+    if (s == Z_NULL) return Z_MEM_ERROR;
+    zmemzero((Bytef *)s, sizeof(par_state));
+    strm->state = (struct internal_state FAR *)s;
+    s->strm = strm;
+    s->status = PAR_STATE;
+    s->wrap = wrap;
+    s->err = Z_OK;
+    s->wsize = 1U << windowBits;
+    s->chunk = (uInt)chunk;
+    s->threads = threads;
+
+    /* allocate a raw deflate stream for each thread */
+    s->dict = (Bytef *)ZALLOC(strm, s->wsize, 1);
+    s->pool = (par_thread *)ZALLOC(strm, threads, sizeof(par_thread));
+    if (s->dict == Z_NULL || s->pool == Z_NULL) {
+        par_free(s);
+        return Z_MEM_ERROR;
+    }
+    zmemzero((Bytef *)s->pool, threads * (uInt)sizeof(par_thread));
+    for (i = 0; i < threads; i++) {
+        s->pool[i].strm.zalloc = strm->zalloc;
+        s->pool[i].strm.zfree = strm->zfree;
+        s->pool[i].strm.opaque = strm->opaque;
+        ret = deflateInit2(&s->pool[i].strm, level, Z_DEFLATED, -windowBits,
+                           memLevel, strategy);
+        if (ret != Z_OK) {
+            par_free(s);
+            return ret;
+        }
+        s->pool[i].s = s;
+    }
+    /* room for a chunk's compressed data, plus its sync flush marker */
+    s->bound = (uInt)deflateBound(&s->pool[0].strm, chunk) + 6;
+
+    /* start the workers -- if not all of them can be started, use the ones
+       that were, or if none, compress in the application's thread */
+    s->max = 1;
+#ifdef HAVE_THREADS
+    if (threads > 1 && zmutex_init(&s->lock) == 0) {
+        if (zcond_init(&s->work) == 0) {
+            if (zcond_init(&s->ready) == 0) {
+                while (s->running < threads &&
+                       zthread_start(&s->pool[s->running].thread, par_worker,
+                                     &s->pool[s->running]) == 0)
+                    s->running++;
+                if (s->running)
+                    s->max = s->running << 1;
+                else
+                    zcond_free(&s->ready);
+            }
+            if (s->running == 0)
+                zcond_free(&s->work);
+        }
+        if (s->running == 0)
+            zmutex_free(&s->lock);
+    }
+#endif
+
+    /* prepare the header */
+    if (wrap == 1) {
+        uInt header = (Z_DEFLATED + ((windowBits - 8) << 4)) << 8;
+        int flags = strategy >= Z_HUFFMAN_ONLY || level < 2 ? 0 :
+                    level < 6 ? 1 : level == 6 ? 2 : 3;
+
+        header |= flags << 6;
+        header += 31 - (header % 31);
+        s->extra[0] = (Byte)(header >> 8);
+        s->extra[1] = (Byte)header;
+        s->extra_len = 2;
+        s->check = adler32(0L, Z_NULL, 0);
+    }
+#ifndef NO_GZIP
+    else if (wrap == 2) {
+        s->extra[0] = 31;
+        s->extra[1] = 139;
+        s->extra[2] = 8;
+        s->extra[8] = level >= 9 ? 2 :
+                      strategy >= Z_HUFFMAN_ONLY || level < 2 ? 4 : 0;
+        s->extra[9] = OS_CODE;
+        s->extra_len = 10;
+        s->check = crc32(0L, Z_NULL, 0);
+    }
+#endif
+    strm->adler = s->check;
+    strm->total_in = strm->total_out = 0;
+    strm->data_type = Z_UNKNOWN;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateParallel(z_streamp strm, int flush) {
+    par_state *s;
+    uInt n;
+
+    if (parStateCheck(strm) || flush > Z_BLOCK || flush < 0)
+        return Z_STREAM_ERROR;
+    s = (par_state *)strm->state;
+    if (strm->next_out == Z_NULL ||
+        (strm->avail_in != 0 && strm->next_in == Z_NULL) ||
+        (s->finish && flush != Z_FINISH))
+        ERR_RETURN(strm, Z_STREAM_ERROR);
+    if (s->err != Z_OK)
+        ERR_RETURN(strm, s->err);
+    if (strm->avail_out == 0)
+        ERR_RETURN(strm, Z_BUF_ERROR);
+    if (flush == Z_PARTIAL_FLUSH || flush == Z_BLOCK)
+        flush = Z_SYNC_FLUSH;
+
+    for (;;) {
+        /* write whatever is ready */
+        par_write(s);
+        if (s->err != Z_OK)
+            ERR_RETURN(strm, s->err);
+        if (strm->avail_out == 0)
+            return Z_OK;
+
+        /* once the last chunk is submitted, wait for it all to be written */
+        if (s->finish) {
+            if (s->first == Z_NULL && s->extra_sent == s->extra_len)
+                return Z_STREAM_END;
+            par_wait(s);
+            continue;
+        }
+
+        /* submit a full chunk, if there is room for another job */
+        if (s->fill != Z_NULL && s->fill->len == s->chunk) {
+            if (s->jobs == s->max)
+                par_wait(s);
+            else
+                par_submit(s, Z_SYNC_FLUSH);
+            continue;
+        }
+
+        /* copy input to the chunk being filled */
+        if (strm->avail_in != 0) {
+            if (s->fill == Z_NULL && par_fill(s) != Z_OK) {
+                s->err = Z_MEM_ERROR;
+                ERR_RETURN(strm, Z_MEM_ERROR);
+            }
+            n = s->chunk - s->fill->len;
+            if (n > strm->avail_in)
+                n = strm->avail_in;
+            zmemcpy(s->fill->in + s->fill->dict + s->fill->len,
+                    strm->next_in, n);
+            s->fill->len += n;
+            strm->next_in += n;
+            strm->avail_in -= n;
+            strm->total_in += n;
+            continue;
+        }
+        if (flush == Z_NO_FLUSH)
+            return Z_OK;
+
+        /* submit the partial chunk for a flush, or the last chunk */
+        if (flush == Z_FINISH || (s->fill != Z_NULL && s->fill->len)) {
+            if (s->jobs == s->max)
+                par_wait(s);
+            else if (s->fill == Z_NULL && par_fill(s) != Z_OK) {
+                s->err = Z_MEM_ERROR;
+                ERR_RETURN(strm, Z_MEM_ERROR);
+            }
+            else
+                par_submit(s, flush);
+            continue;
+        }
+
+        /* all of the input has been submitted -- every submitted chunk ends
+           with a sync flush, so the flush is complete once all of them have
+           been written */
+        if (flush == Z_FULL_FLUSH) {
+            s->dlen = 0;
+            if (s->fill != Z_NULL)
+                s->fill->dict = 0;
+        }
+        if (s->first == Z_NULL)
+            return Z_OK;
+        par_wait(s);
+    }
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateParallelParams(z_streamp strm, int level, int strategy) {
+    par_state *s;
+    par_job *job;
+    uInt bound;
+    int ret, i;
+
+    if (parStateCheck(strm)) return Z_STREAM_ERROR;
+    s = (par_state *)strm->state;
+    if (s->finish)
+        return Z_STREAM_ERROR;
+    if (s->first != Z_NULL || (s->fill != Z_NULL && s->fill->len))
+        return Z_BUF_ERROR;
+
+    /* all submitted jobs have been written, so the workers are idle -- reset
+       each stream so that deflateParams() doesn't try to compress, and set
+       the new parameters, which deflateReset() will keep */
+    for (i = 0; i < s->threads; i++) {
+        deflateReset(&s->pool[i].strm);
+        ret = deflateParams(&s->pool[i].strm, level, strategy);
+        if (ret != Z_OK)
+            return ret;
+    }
+
+    /* the bound depends on the parameters -- if it grew, drop the jobs that
+       were allocated for the old bound */
+    bound = (uInt)deflateBound(&s->pool[0].strm, s->chunk) + 6;
+    if (bound > s->bound) {
+        if (s->fill != Z_NULL) {
+            s->fill->next = s->spare;
+            s->spare = s->fill;
+            s->fill = Z_NULL;
+        }
+        while ((job = s->spare) != Z_NULL) {
+            s->spare = job->next;
+            ZFREE(strm, job);
+        }
+        s->bound = bound;
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateParallelEnd(z_streamp strm) {
+    par_state *s;
+    int done;
+
+    if (parStateCheck(strm)) return Z_STREAM_ERROR;
+    s = (par_state *)strm->state;
+    done = s->finish && s->first == Z_NULL && s->extra_sent == s->extra_len;
+    par_free(s);
+    return done ? Z_OK : Z_DATA_ERROR;
+}
@@ -1,7 +1,7 @@
 /* enough.c -- determine the maximum size of inflate's Huffman code tables over
  * all possible valid and complete prefix codes, subject to a length limit.
- * Copyright (C) 2007, 2008, 2012, 2018, 2024 Mark Adler
- * Version 1.6  29 July 2024  Mark Adler
+ * Copyright (C) 2007, 2008, 2012, 2018, 2024, 2026 Mark Adler
+ * Version 1.7  15 October 2026  Mark Adler
  */
 
 /* Version history:
@@ -20,6 +20,8 @@
    1.5   5 Aug 2018  Clean up code style, formatting, and comments
                      Show all the codes for the maximum, and only the maximum
    1.6  29 Jul 2024  Avoid use of uintmax_t
+   1.7  15 Oct 2026  Add optional threads argument to examine sub-codes on
+                     several threads, each with its own visited states
  */
 
 /*
@@ -89,6 +91,25 @@
    need to be examined to cover all of the possible table memory usage cases
    for the default arguments of 286 symbols limited to 15-bit codes.
 
+   The examination of the sub-codes can be done on several threads. Each
+   number of symbols n is a task, covering the reachable (root + 1) bit nodes
+   for all of the values of left with that n. The threads take the next n
+   from a shared counter whenever they finish one, so that a thread that gets
+   a long task does not hold up the others. Each thread has its own code
+   vector, visited states, largest table size, and sub-codes shown, and the
+   largest sizes and sub-codes are merged when all of the tasks are done.
+   Sharing the visited states would save work, since the nodes for nearby n
+   reach many of the same states, but been_here() is called so often that
+   even an uncontended lock in it costs more than the entire search on one
+   thread. Giving each thread whole values of n keeps the nodes that share the
+   most states together, so that four threads do two to three times the work
+   of one, and more threads add less than that. A search on eight cores then
+   finishes two to three times sooner. Which sub-codes are shown depends on
+   the order in which states were visited, since a pruned state is shown only
+   for the first path that reached it. So with more than one thread, the
+   lines are sorted, and there can be different lines than for a single
+   thread. The maximum is the same.
+
    Note that unsigned long long is used for counting. It is quite easy to
    exceed the capacity of an eight-byte integer with a large number of symbols
    and a large maximum code length, so multiple-precision arithmetic would need
@@ -108,6 +129,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <pthread.h>
 
 #define local static
 
@@ -220,17 +242,25 @@ local void string_printf(string_t *s, char *fmt, ...) {
     va_end(ap);
 }
 
+// State of one examination of sub-codes, one for each thread.
+typedef struct {
+    int large;          // largest code table so far
+    string_t out;       // display of subcodes for maximum tables size
+    int *code;          // number of symbols assigned to each bit length
+    struct tab *done;   // states already evaluated array
+} search_t;
+
 // Globals to avoid propagating constants or constant pointers recursively.
 struct {
     int max;            // maximum allowed bit length for the codes
     int root;           // size of base code table in bits
-    int large;          // largest code table so far
     size_t size;        // number of elements in num and done
     big_t tot;          // total number of codes with maximum tables size
-    string_t out;       // display of subcodes for maximum tables size
-    int *code;          // number of symbols assigned to each bit length
     big_t *num;         // saved results array for code counting
-    struct tab *done;   // states already evaluated array
+    int syms;           // total number of symbols
+    int threads;        // number of threads for enough()
+    int next;           // next number of symbols for enough() to examine
+    pthread_mutex_t lock;   // protects next
 } g;
 
 // Index function for num[] and done[].
@@ -240,18 +270,36 @@ local inline size_t map(int syms, int left, int len) {
            len - 1;
 }
 
-// Free allocated space in globals.
-local void cleanup(void) {
-    if (g.done != NULL) {
+// Allocate and clear the code vector and the done array for s.
+local void search_init(search_t *s) {
+    s->code = calloc(g.max + 1, sizeof(int));
+    assert(s->code != NULL && "out of memory");
+    if (g.size == 0)
+        s->done = NULL;
+    else {
+        s->done = calloc(g.size, sizeof(struct tab));
+        assert(s->done != NULL && "out of memory");
+    }
+    string_init(&s->out);
+    s->large = 1 << g.root;         // base table
+}
+
+// Free the allocated space in s.
+local void search_free(search_t *s) {
+    if (s->done != NULL) {
         for (size_t n = 0; n < g.size; n++)
-            if (g.done[n].len)
-                free(g.done[n].vec);
-        g.size = 0;
-        free(g.done);   g.done = NULL;
+            if (s->done[n].len)
+                free(s->done[n].vec);
+        free(s->done);  s->done = NULL;
     }
+    free(s->code);  s->code = NULL;
+    string_free(&s->out);
+}
+
+// Free allocated space in globals.
+local void cleanup(void) {
     free(g.num);    g.num = NULL;
-    free(g.code);   g.code = NULL;
-    string_free(&g.out);
+    g.size = 0;
 }
 
 // Return the number of possible prefix codes using bit patterns of lengths len
@@ -305,7 +353,8 @@ local big_t count(int syms, int left, int len) {
 // bit vector to indicate visiting this state. Each (syms,len,left) state has a
 // variable size bit vector indexed by (mem,rem). The bit vector is lengthened
 // as needed to allow setting the (mem,rem) bit.
-local int been_here(int syms, int left, int len, int mem, int rem) {
+local int been_here(search_t *s, int syms, int left, int len, int mem,
+                    int rem) {
     // point to vector for (syms,left,len), bit in vector for (mem,rem)
     size_t index = map(syms, left, len);
     mem -= 1 << g.root;             // mem always includes the root table
@@ -316,8 +365,9 @@ local int been_here(int syms, int left, int len, int mem, int rem) {
     int bit = 1 << (mem & 7);
 
     // see if we've been here
-    size_t length = g.done[index].len;
-    if (offset < length && (g.done[index].vec[offset] & bit) != 0)
+    struct tab *done = s->done + index;
+    size_t length = done->len;
+    if (offset < length && (done->vec[offset] & bit) != 0)
         return 1;       // done this!
 
     // we haven't been here before -- set the bit to show we have now
@@ -330,9 +380,9 @@ local int been_here(int syms, int left, int len, int mem, int rem) {
             do {
                 length <<= 1;
             } while (length <= offset);
-            vector = realloc(g.done[index].vec, length);
+            vector = realloc(done->vec, length);
             assert(vector != NULL && "out of memory");
-            memset(vector + g.done[index].len, 0, length - g.done[index].len);
+            memset(vector + done->len, 0, length - done->len);
         }
 
         // otherwise we need to make a new vector and zero it out
@@ -345,24 +395,25 @@ local int been_here(int syms, int left, int len, int mem, int rem) {
         }
 
         // install the new vector
-        g.done[index].len = length;
-        g.done[index].vec = vector;
+        done->len = length;
+        done->vec = vector;
     }
 
     // set the bit
-    g.done[index].vec[offset] |= bit;
+    done->vec[offset] |= bit;
     return 0;
 }
 
 // Examine all possible codes from the given node (syms, len, left). Compute
 // the amount of memory required to build inflate's decoding tables, where the
 // number of code structures used so far is mem, and the number remaining in
-// the current sub-table is rem.
-local void examine(int syms, int left, int len, int mem, int rem) {
+// the current sub-table is rem. The results go in s.
+local void examine(search_t *s, int syms, int left, int len, int mem,
+                   int rem) {
     // see if we have a complete code
     if (syms == left) {
         // set the last code entry
-        g.code[len] = left;
+        s->code[len] = left;
 
         // complete computation of memory used by this code
         while (rem < left) {
@@ -373,40 +424,40 @@ local void examine(int syms, int left, int len, int mem, int rem) {
         assert(rem == left);
 
         // if this is at the maximum, show the sub-code
-        if (mem >= g.large) {
+        if (mem >= s->large) {
             // if this is a new maximum, update the maximum and clear out the
             // printed sub-codes from the previous maximum
-            if (mem > g.large) {
-                g.large = mem;
-                string_clear(&g.out);
+            if (mem > s->large) {
+                s->large = mem;
+                string_clear(&s->out);
             }
 
             // compute the starting state for this sub-code
             syms = 0;
             left = 1 << g.max;
             for (int bits = g.max; bits > g.root; bits--) {
-                syms += g.code[bits];
-                left -= g.code[bits];
+                syms += s->code[bits];
+                left -= s->code[bits];
                 assert((left & 1) == 0);
                 left >>= 1;
             }
 
-            // print the starting state and the resulting sub-code to g.out
-            string_printf(&g.out, "<%u, %u, %u>:",
+            // print the starting state and the resulting sub-code to s->out
+            string_printf(&s->out, "<%u, %u, %u>:",
                           syms, g.root + 1, ((1 << g.root) - left) << 1);
             for (int bits = g.root + 1; bits <= g.max; bits++)
-                if (g.code[bits])
-                    string_printf(&g.out, " %d[%d]", g.code[bits], bits);
-            string_printf(&g.out, "\n");
+                if (s->code[bits])
+                    string_printf(&s->out, " %d[%d]", s->code[bits], bits);
+            string_printf(&s->out, "\n");
         }
 
         // remove entries as we drop back down in the recursion
-        g.code[len] = 0;
+        s->code[len] = 0;
         return;
     }
 
     // prune the tree if we can
-    if (been_here(syms, left, len, mem, rem))
+    if (been_here(s, syms, left, len, mem, rem))
         return;
 
     // we need to use at least this many bit patterns so that the code won't be
@@ -432,8 +483,8 @@ local void examine(int syms, int left, int len, int mem, int rem) {
 
     // examine codes from here, updating table space as we go
     for (use = least; use <= most; use++) {
-        g.code[len] = use;
-        examine(syms - use, (left - use) << 1, len + 1,
+        s->code[len] = use;
+        examine(s, syms - use, (left - use) << 1, len + 1,
                 mem + (rem ? 1 << (len - g.root) : 0), rem << 1);
         if (rem == 0) {
             rem = 1 << (len - g.root);
@@ -443,41 +494,131 @@ local void examine(int syms, int left, int len, int mem, int rem) {
     }
 
     // remove entries as we drop back down in the recursion
-    g.code[len] = 0;
+    s->code[len] = 0;
+}
+
+// Examine the sub-codes from the reachable (root + 1) bit node (n, left), and
+// the root bit codes with completions at root + 1 bits, with the results in s.
+local void examine_node(search_t *s, int n, int left) {
+    // look at all reachable (root + 1) bit nodes, and the resulting codes
+    // (complete at root + 2 or more)
+    size_t index = map(n, left, g.root + 1);
+    if (g.root + 1 < g.max && g.num[index])     // reachable node
+        examine(s, n, left, g.root + 1, 1 << g.root, 0);
+
+    // also look at root bit codes with completions at root + 1 bits (not
+    // saved in num, since complete), just in case
+    if (g.num[index - 1] && n <= left << 1)
+        examine(s, (n - left) << 1, (n - left) << 1, g.root + 1,
+                1 << g.root, 0);
+}
+
+// Examine the nodes for all values of left with n symbols.
+local void examine_syms(search_t *s, int n) {
+    for (int left = 2; left < n; left += 2)
+        examine_node(s, n, left);
+}
+
+// Thread to examine the nodes for the next number of symbols, until there
+// are no more.
+local void *worker(void *arg) {
+    search_t *s = arg;
+    for (;;) {
+        pthread_mutex_lock(&g.lock);
+        int n = g.next++;
+        pthread_mutex_unlock(&g.lock);
+        if (n > g.syms)
+            break;
+        examine_syms(s, n);
+    }
+    return NULL;
+}
+
+// Compare two lines for qsort().
+local int compare(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// Sort the lines in out, removing any duplicates.
+local void sort_lines(string_t *out) {
+    size_t count = 0;
+    for (size_t i = 0; i < out->len; i++)
+        if (out->str[i] == '\n')
+            count++;
+    if (count == 0)
+        return;
+    char **line = malloc(count * sizeof(char *));
+    assert(line != NULL && "out of memory");
+    char *copy = malloc(out->len + 1);
+    assert(copy != NULL && "out of memory");
+    memcpy(copy, out->str, out->len + 1);
+    char *next = copy;
+    for (size_t i = 0; i < count; i++) {
+        line[i] = next;
+        next = strchr(next, '\n');
+        *next++ = 0;
+    }
+    qsort(line, count, sizeof(char *), compare);
+    string_clear(out);
+    for (size_t i = 0; i < count; i++)
+        if (i == 0 || strcmp(line[i], line[i - 1]))
+            string_printf(out, "%s\n", line[i]);
+    free(copy);
+    free(line);
 }
 
 // Look at all sub-codes starting with root + 1 bits. Look at only the valid
 // intermediate code states (syms, left, len). For each completed code,
 // calculate the amount of memory required by inflate to build the decoding
 // tables. Find the maximum amount of memory required and show the codes that
-// require that maximum.
+// require that maximum. With more than one thread, each thread has its own
+// search state, and the results are merged at the end.
 local void enough(int syms) {
-    // clear code
-    for (int n = 0; n <= g.max; n++)
-        g.code[n] = 0;
+    search_t *s = calloc(g.threads, sizeof(search_t));
+    assert(s != NULL && "out of memory");
+    for (int t = 0; t < g.threads; t++)
+        search_init(s + t);
 
     // look at all (root + 1) bit and longer codes
-    string_clear(&g.out);           // empty saved results
-    g.large = 1 << g.root;          // base table
-    if (g.root < g.max)             // otherwise, there's only a base table
-        for (int n = 3; n <= syms; n++)
-            for (int left = 2; left < n; left += 2) {
-                // look at all reachable (root + 1) bit nodes, and the
-                // resulting codes (complete at root + 2 or more)
-                size_t index = map(n, left, g.root + 1);
-                if (g.root + 1 < g.max && g.num[index]) // reachable node
-                    examine(n, left, g.root + 1, 1 << g.root, 0);
-
-                // also look at root bit codes with completions at root + 1
-                // bits (not saved in num, since complete), just in case
-                if (g.num[index - 1] && n <= left << 1)
-                    examine((n - left) << 1, (n - left) << 1, g.root + 1,
-                            1 << g.root, 0);
+    if (g.root < g.max) {           // otherwise, there's only a base table
+        if (g.threads == 1)
+            for (int n = 3; n <= syms; n++)
+                examine_syms(s, n);
+        else {
+            pthread_t *id = malloc(g.threads * sizeof(pthread_t));
+            assert(id != NULL && "out of memory");
+            g.syms = syms;
+            g.next = 3;
+            pthread_mutex_init(&g.lock, NULL);
+            for (int t = 0; t < g.threads; t++) {
+                int ret = pthread_create(id + t, NULL, worker, s + t);
+                assert(ret == 0 && "could not start thread");
+                (void)ret;
             }
+            for (int t = 0; t < g.threads; t++)
+                pthread_join(id[t], NULL);
+            pthread_mutex_destroy(&g.lock);
+            free(id);
+
+            // merge the results into the first search state
+            for (int t = 1; t < g.threads; t++)
+                if (s[t].large > s->large) {
+                    s->large = s[t].large;
+                    string_clear(&s->out);
+                }
+            for (int t = 1; t < g.threads; t++)
+                if (s[t].large == s->large)
+                    string_printf(&s->out, "%s", s[t].out.str);
+            sort_lines(&s->out);
+        }
+    }
 
     // done
-    printf("maximum of %d table entries for root = %d\n", g.large, g.root);
-    fputs(g.out.str, stdout);
+    printf("maximum of %d table entries for root = %d\n", s->large, g.root);
+    fputs(s->out.str, stdout);
+    for (int t = 0; t < g.threads; t++)
+        search_free(s + t);
+    free(s);
 }
 
 // Examine and show the total number of possible prefix codes for a given
@@ -490,6 +631,10 @@ local void enough(int syms) {
 // all possible codes. Each new maximum number of table entries and the
 // associated sub-code (starting at root + 1 == 10 bits) is shown.
 //
+// An optional fourth argument is the number of threads to examine the
+// sub-codes with, which defaults to one. For example, "enough 286 11 15 8"
+// examines the literal/length code for an 11-bit root table on eight threads.
+//
 // To count and examine prefix codes that are not length-limited, provide a
 // maximum length equal to the number of symbols minus one.
 //
@@ -497,26 +642,27 @@ local void enough(int syms) {
 // code, use "enough 30 6".
 int main(int argc, char **argv) {
     // set up globals for cleanup()
-    g.code = NULL;
     g.num = NULL;
-    g.done = NULL;
-    string_init(&g.out);
 
     // get arguments -- default to the deflate literal/length code
     int syms = 286;
     g.root = 9;
     g.max = 15;
+    g.threads = 1;
     if (argc > 1) {
         syms = atoi(argv[1]);
         if (argc > 2) {
             g.root = atoi(argv[2]);
-            if (argc > 3)
+            if (argc > 3) {
                 g.max = atoi(argv[3]);
+                if (argc > 4)
+                    g.threads = atoi(argv[4]);
+            }
         }
     }
-    if (argc > 4 || syms < 2 || g.root < 1 || g.max < 1) {
-        fputs("invalid arguments, need: [sym >= 2 [root >= 1 [max >= 1]]]\n",
-              stderr);
+    if (argc > 5 || syms < 2 || g.root < 1 || g.max < 1 || g.threads < 1) {
+        fputs("invalid arguments, need: "
+              "[sym >= 2 [root >= 1 [max >= 1 [threads >= 1]]]]\n", stderr);
         return 1;
     }
 
@@ -542,10 +688,6 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    // allocate code vector
-    g.code = calloc(g.max + 1, sizeof(int));
-    assert(g.code != NULL && "out of memory");
-
     // determine size of saved results array, checking for overflows,
     // allocate and clear the array (set all to zero with calloc())
     if (syms == 2)              // iff max == 1
@@ -575,14 +717,6 @@ int main(int argc, char **argv) {
     else
         puts(" (no length limit)");
 
-    // allocate and clear done array for been_here()
-    if (syms == 2)
-        g.done = NULL;
-    else {
-        g.done = calloc(g.size, sizeof(struct tab));
-        assert(g.done != NULL && "out of memory");
-    }
-
     // find and show maximum inflate table usage
     if (g.root > g.max)             // reduce root to max length
         g.root = g.max;
@@ -1,6 +1,6 @@
 /* fitblk.c: example of fitting compressed output to a specified size
    Not copyrighted -- provided to the public domain
-   Version 1.1  25 November 2004  Mark Adler */
+   Version 1.2  15 October 2026  Mark Adler */
 
 /* Version history:
    1.0  24 Nov 2004  First version
@@ -9,50 +9,44 @@
                      Simplify code moving compression to subroutines
                      Use assert() for internal errors
                      Add detailed description of approach
+   1.2  15 Oct 2026  Compress once, finishing copies of the stream to find
+                     the fit, instead of decompressing and recompressing
+                     Report the bits used in the last deflate byte
  */
 
 /* Approach to just fitting a requested compressed size:
 
-   fitblk performs three compression passes on a portion of the input
-   data in order to determine how much of that input will compress to
-   nearly the requested output block size.  The first pass generates
-   enough deflate blocks to produce output to fill the requested
-   output size plus a specified excess amount (see the EXCESS define
-   below).  The last deflate block may go quite a bit past that, but
-   is discarded.  The second pass decompresses and recompresses just
-   the compressed data that fit in the requested plus excess sized
-   buffer.  The deflate process is terminated after that amount of
-   input, which is less than the amount consumed on the first pass.
-   The last deflate block of the result will be of a comparable size
-   to the final product, so that the header for that deflate block and
-   the compression ratio for that block will be about the same as in
-   the final product.  The third compression pass decompresses the
-   result of the second step, but only the compressed data up to the
-   requested size minus an amount to allow the compressed stream to
-   complete (see the MARGIN define below).  That will result in a
-   final compressed stream whose length is less than or equal to the
-   requested size.  Assuming sufficient input and a requested size
-   greater than a few hundred bytes, the shortfall will typically be
-   less than ten bytes.
-
-   If the input is short enough that the first compression completes
-   before filling the requested output size, then that compressed
-   stream is return with no recompression.
-
-   EXCESS is chosen to be just greater than the shortfall seen in a
-   two pass approach similar to the above.  That shortfall is due to
-   the last deflate block compressing more efficiently with a smaller
-   header on the second pass.  EXCESS is set to be large enough so
-   that there is enough uncompressed data for the second pass to fill
-   out the requested size, and small enough so that the final deflate
-   block of the second pass will be close in size to the final deflate
-   block of the third and final pass.  MARGIN is chosen to be just
-   large enough to assure that the final compression has enough room
-   to complete in all cases.
+   fitblk compresses the input once, in steps of STEP bytes.  Since deflate
+   holds on to the symbols of the block it is building, the output it has
+   written does not say how long the stream would be if it ended there.  So
+   every so often fitblk makes a copy of the stream with deflateCopy(), and
+   finishes the copy with Z_FINISH to see how long the complete stream for
+   the input so far would be.  The original stream goes on compressing as if
+   nothing had happened.  If the trial stream fits, then it is saved as the
+   best so far, along with another copy of the stream at that point.  The
+   next trial is made halfway to where the ratio of the last trial predicts
+   that the output will be full, so the trials close in on the answer
+   without being made at every step.
+
+   Once a trial does not fit, or the output written so far has filled the
+   requested size, the answer lies between the last trial that fit and the
+   first that did not.  deflatePending() gives the full length of a trial
+   that did not fit, so the first probe into the gap is placed where the
+   input would fill the block if the ratio were constant across it.  After
+   that the gap is narrowed by a binary search, each probe compressing just
+   the input after the saved copy and finishing it.  A probe that fits
+   becomes the new saved copy.  The result is the longest prefix of the
+   input, to the byte, whose compressed stream fits, and only the input past
+   the last fitting trial is ever compressed more than once.  deflateUsed()
+   reports how many bits of the last byte of deflate data were used.
+
+   If all of the input compresses to the requested size or less, then that
+   compressed stream is returned, the first time the input is compressed.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "zlib.h"
 
@@ -65,73 +59,97 @@ local void quit(char *why)
     exit(1);
 }
 
-#define RAWLEN 4096    /* intermediate uncompressed buffer size */
+#define STEP 1024       /* input consumed between checks */
+#define RAWLEN 65536    /* initial size of the input buffer */
 
-/* compress from file to def until provided buffer is full or end of
-   input reached; return last deflate() return value, or Z_ERRNO if
-   there was read error on the file */
-local int partcompress(FILE *in, z_streamp def)
+/* input read so far, which is kept so that it can be compressed again from
+   a saved copy of the stream */
+local unsigned char *raw = NULL;
+local size_t rawlen = 0, rawsize = 0;
+
+/* make sure that raw has at least want bytes, if there is that much input;
+   return the number of bytes available, up to want */
+local size_t load(size_t want)
 {
-    int ret, flush;
-    unsigned char raw[RAWLEN];
-
-    flush = Z_NO_FLUSH;
-    do {
-        def->avail_in = fread(raw, 1, RAWLEN, in);
-        if (ferror(in))
-            return Z_ERRNO;
-        def->next_in = raw;
-        if (feof(in))
-            flush = Z_FINISH;
-        ret = deflate(def, flush);
-        assert(ret != Z_STREAM_ERROR);
-    } while (def->avail_out != 0 && flush == Z_NO_FLUSH);
-    return ret;
+    while (rawlen < want && !feof(stdin)) {
+        if (rawlen == rawsize) {
+            rawsize = rawsize ? rawsize << 1 : RAWLEN;
+            raw = realloc(raw, rawsize);
+            if (raw == NULL)
+                quit("out of memory");
+        }
+        rawlen += fread(raw + rawlen, 1, rawsize - rawlen, stdin);
+        if (ferror(stdin))
+            quit("error reading input");
+    }
+    return rawlen < want ? rawlen : want;
 }
 
-/* recompress from inf's input to def's output; the input for inf and
-   the output for def are set in those structures before calling;
-   return last deflate() return value, or Z_MEM_ERROR if inflate()
-   was not able to allocate enough memory when it needed to */
-local int recompress(z_streamp inf, z_streamp def)
+/* compress raw[from..to-1] with def, which must have room for the output */
+local void feed(z_streamp def, size_t from, size_t to)
 {
-    int ret, flush;
-    unsigned char raw[RAWLEN];
-
-    flush = Z_NO_FLUSH;
-    do {
-        /* decompress */
-        inf->avail_out = RAWLEN;
-        inf->next_out = raw;
-        ret = inflate(inf, Z_NO_FLUSH);
-        assert(ret != Z_STREAM_ERROR && ret != Z_DATA_ERROR &&
-               ret != Z_NEED_DICT);
-        if (ret == Z_MEM_ERROR)
-            return ret;
-
-        /* compress what was decompressed until done or no room */
-        def->avail_in = RAWLEN - inf->avail_out;
-        def->next_in = raw;
-        if (inf->avail_out != 0)
-            flush = Z_FINISH;
-        ret = deflate(def, flush);
-        assert(ret != Z_STREAM_ERROR);
-    } while (ret != Z_STREAM_END && def->avail_out != 0);
-    return ret;
+    int ret;
+
+    def->next_in = raw + from;
+    def->avail_in = (unsigned)(to - from);
+    ret = deflate(def, Z_NO_FLUSH);
+    assert(ret != Z_STREAM_ERROR);
+    (void)ret;
 }
 
-#define EXCESS 256      /* empirically determined stream overage */
-#define MARGIN 8        /* amount to back off for completion */
+/* finish a copy of def into out[0..room-1], leaving def as it was; return
+   the length of the complete stream from the start of out, which is more
+   than room if it does not fit, and if it fits set *used to the number of
+   bits used in the last deflate byte */
+local unsigned trial(z_streamp def, unsigned char *out, unsigned room,
+                     int *used)
+{
+    int ret;
+    unsigned pend;
+    z_stream tmp;
+
+    if (deflateCopy(&tmp, def) != Z_OK)
+        quit("out of memory");
+    tmp.avail_in = 0;
+    tmp.next_out = out;
+    tmp.avail_out = room;
+    ret = deflate(&tmp, Z_FINISH);
+    assert(ret != Z_STREAM_ERROR);
+    if (ret == Z_STREAM_END) {
+        pend = room - tmp.avail_out;
+        ret = deflateUsed(&tmp, used);
+        assert(ret == Z_OK);
+    }
+    else {
+        /* out of room -- count what is left, plus the trailer if it hasn't
+           been made yet */
+        ret = deflatePending(&tmp, &pend, Z_NULL);
+        assert(ret == Z_OK);
+        pend += room + 4;
+    }
+    (void)deflateEnd(&tmp);
+    return pend;
+}
 
 /* compress from stdin to fixed-size block on stdout */
 int main(int argc, char **argv)
 {
     int ret;                /* return code */
+    int used;               /* bits used in the last deflate byte */
     unsigned size;          /* requested fixed output block size */
-    unsigned have;          /* bytes written by deflate() call */
-    unsigned char *blk;     /* intermediate and final stream */
-    unsigned char *tmp;     /* close to desired size stream */
-    z_stream def, inf;      /* zlib deflate and inflate states */
+    unsigned have;          /* length of best complete stream */
+    unsigned len;           /* length of the latest trial stream */
+    unsigned out;           /* output written before the trial */
+    unsigned char *blk;     /* output of the stream being compressed */
+    unsigned char *fit;     /* best complete stream so far */
+    unsigned char *tmp;     /* output of a trial */
+    size_t pos;             /* input compressed by def */
+    size_t good;            /* input in the best complete stream */
+    size_t next;            /* input at which to make the next trial */
+    size_t bad;             /* input known not to fit */
+    unsigned over;          /* length of the stream for bad, if known */
+    z_stream strm[2];       /* deflate states for def and snap */
+    z_streamp def, snap;    /* deflate state, and copy of it at good */
 
     /* get requested output size */
     if (argc != 2)
@@ -144,90 +162,148 @@ int main(int argc, char **argv)
     size = (unsigned)ret;
 
     /* allocate memory for buffers and compression engine */
-    blk = malloc(size + EXCESS);
-    def.zalloc = Z_NULL;
-    def.zfree = Z_NULL;
-    def.opaque = Z_NULL;
-    ret = deflateInit(&def, Z_DEFAULT_COMPRESSION);
-    if (ret != Z_OK || blk == NULL)
+    blk = malloc(size);
+    fit = malloc(size);
+    tmp = malloc(size);
+    def = strm;
+    snap = strm + 1;
+    def->zalloc = Z_NULL;
+    def->zfree = Z_NULL;
+    def->opaque = Z_NULL;
+    ret = deflateInit(def, Z_DEFAULT_COMPRESSION);
+    if (ret != Z_OK || blk == NULL || fit == NULL || tmp == NULL)
         quit("out of memory");
+    def->next_out = blk;
+    def->avail_out = size;
 
-    /* compress from stdin until output full, or no more input */
-    def.avail_out = size + EXCESS;
-    def.next_out = blk;
-    ret = partcompress(stdin, &def);
-    if (ret == Z_ERRNO)
-        quit("error reading input");
-
-    /* if it all fit, then size was undersubscribed -- done! */
-    if (ret == Z_STREAM_END && def.avail_out >= EXCESS) {
-        /* write block to stdout */
-        have = size + EXCESS - def.avail_out;
-        if (fwrite(blk, 1, have, stdout) != have || ferror(stdout))
-            quit("error writing output");
-
-        /* clean up and print results to stderr */
-        ret = deflateEnd(&def);
-        assert(ret != Z_STREAM_ERROR);
-        free(blk);
-        fprintf(stderr,
-                "%u bytes unused out of %u requested (all input)\n",
-                size - have, size);
-        return 0;
-    }
-
-    /* it didn't all fit -- set up for recompression */
-    inf.zalloc = Z_NULL;
-    inf.zfree = Z_NULL;
-    inf.opaque = Z_NULL;
-    inf.avail_in = 0;
-    inf.next_in = Z_NULL;
-    ret = inflateInit(&inf);
-    tmp = malloc(size + EXCESS);
-    if (ret != Z_OK || tmp == NULL)
+    /* the empty stream always fits -- save it and a copy of the state */
+    have = trial(def, fit, size, &used);
+    assert(have <= size);
+    ret = deflateCopy(snap, def);
+    if (ret != Z_OK)
         quit("out of memory");
-    ret = deflateReset(&def);
-    assert(ret != Z_STREAM_ERROR);
+    good = 0;
 
-    /* do first recompression close to the right amount */
-    inf.avail_in = size + EXCESS;
-    inf.next_in = blk;
-    def.avail_out = size + EXCESS;
-    def.next_out = tmp;
-    ret = recompress(&inf, &def);
-    if (ret == Z_MEM_ERROR)
-        quit("out of memory");
+    /* compress in steps, making trials at increasing intervals, until a trial
+       does not fit, the output so far is full, or the input runs out */
+    pos = 0;
+    over = 0;
+    next = size >> 1;
+    for (;;) {
+        size_t end = load(pos + STEP);
+        if (end == pos) {
+            /* all of the input has been compressed -- finish def itself */
+            ret = deflate(def, Z_FINISH);
+            assert(ret != Z_STREAM_ERROR);
+            if (ret == Z_STREAM_END) {
+                have = size - def->avail_out;
+                if (fwrite(blk, 1, have, stdout) != have || ferror(stdout))
+                    quit("error writing output");
+                (void)deflateUsed(def, &used);
+                ret = deflateEnd(def);
+                assert(ret != Z_STREAM_ERROR);
+                (void)deflateEnd(snap);
+                free(tmp);
+                free(fit);
+                free(blk);
+                free(raw);
+                fprintf(stderr,
+                        "%u bytes unused out of %u requested (all input, "
+                        "%d bits of last deflate byte used)\n",
+                        size - have, size, used);
+                return 0;
+            }
+            bad = pos;
+            break;
+        }
+        feed(def, pos, end);
+        pos = end;
+        if (def->avail_out == 0) {
+            /* the output so far fills the block, so the trailer won't fit */
+            bad = pos;
+            break;
+        }
+        if (pos < next)
+            continue;
 
-    /* set up for next recompression */
-    ret = inflateReset(&inf);
-    assert(ret != Z_STREAM_ERROR);
-    ret = deflateReset(&def);
-    assert(ret != Z_STREAM_ERROR);
+        /* see if the stream would fit if it ended here */
+        out = size - def->avail_out;
+        len = trial(def, tmp, def->avail_out, &used) + out;
+        if (len > size) {
+            bad = pos;
+            over = len;
+            break;
+        }
+        memcpy(fit, blk, out);
+        memcpy(fit + out, tmp, len - out);
+        have = len;
+        (void)deflateEnd(snap);
+        ret = deflateCopy(snap, def);
+        if (ret != Z_OK)
+            quit("out of memory");
+        good = pos;
 
-    /* do second and final recompression (third compression) */
-    inf.avail_in = size - MARGIN;   /* assure stream will complete */
-    inf.next_in = tmp;
-    def.avail_out = size;
-    def.next_out = blk;
-    ret = recompress(&inf, &def);
-    if (ret == Z_MEM_ERROR)
-        quit("out of memory");
-    assert(ret == Z_STREAM_END);    /* otherwise MARGIN too small */
+        /* aim halfway to where this ratio would fill the block */
+        next = (size_t)((double)pos * size / len);
+        next = pos + (next > pos + 2 * STEP ? (next - pos) >> 1 : STEP);
+    }
+    (void)deflateEnd(def);
+
+    /* binary search between good and bad, compressing from snap -- a probe
+       that fits becomes the new snap */
+    while (bad - good > 1) {
+        size_t mid;
+        int bits = 0;
+
+        if (over) {
+            /* interpolate from the lengths at good and bad */
+            mid = good + (size_t)((double)(bad - good) * (size - have) /
+                                  (over - have));
+            if (mid <= good)
+                mid = good + 1;
+            else if (mid >= bad)
+                mid = bad - 1;
+            over = 0;
+        }
+        else
+            mid = good + ((bad - good) >> 1);
+
+        ret = deflateCopy(def, snap);
+        if (ret != Z_OK)
+            quit("out of memory");
+        feed(def, good, mid);
+        out = size - def->avail_out;
+        len = def->avail_out == 0 ? size + 1 :
+              trial(def, tmp, def->avail_out, &bits) + out;
+        if (len > size) {
+            (void)deflateEnd(def);
+            bad = mid;
+        }
+        else {
+            memcpy(fit, blk, out);
+            memcpy(fit + out, tmp, len - out);
+            have = len;
+            used = bits;
+            (void)deflateEnd(snap);
+            snap = def;
+            def = snap == strm ? strm + 1 : strm;
+            good = mid;
+        }
+    }
+    (void)deflateEnd(snap);
 
     /* done -- write block to stdout */
-    have = size - def.avail_out;
-    if (fwrite(blk, 1, have, stdout) != have || ferror(stdout))
+    if (fwrite(fit, 1, have, stdout) != have || ferror(stdout))
         quit("error writing output");
 
     /* clean up and print results to stderr */
     free(tmp);
-    ret = inflateEnd(&inf);
-    assert(ret != Z_STREAM_ERROR);
-    ret = deflateEnd(&def);
-    assert(ret != Z_STREAM_ERROR);
+    free(fit);
     free(blk);
+    free(raw);
     fprintf(stderr,
-            "%u bytes unused out of %u requested (%lu input)\n",
-            size - have, size, def.total_in);
+            "%u bytes unused out of %u requested (%lu input, "
+            "%d bits of last deflate byte used)\n",
+            size - have, size, (unsigned long)good, used);
     return 0;
 }
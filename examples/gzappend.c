@@ -41,6 +41,9 @@
  *                        (Why you ask?  Because it was fun to write!)
  * 1.2  11 Oct 2012     - Fix for proper z_const usage
  *                      - Check for input buffer malloc failure
+ * 1.3  15 Oct 2026     - Keep a checkpoint in a sidecar file so the next
+ *                        append need not decompress all of the gzip file
+ *                      - Get the dictionary with inflateGetDictionary()
  */
 
 /*
@@ -63,6 +66,22 @@
    The gzip trailer containing the CRC-32 and length of the uncompressed data
    is verified.  This trailer will be later overwritten.
 
+   Decompressing the whole file each time gets slow once the file is large, so
+   after appending, gzappend saves a checkpoint from inflateCheckpoint() at the
+   start of the last deflate block, along with the CRC-32 of the data before it
+   and the location of the last block bit.  The checkpoint is saved in a
+   sidecar file, named with ".ckpt" added to the name of the gzip file, so the
+   gzip file itself ends with its real trailer as usual.  The sidecar also has
+   the length and the trailer of the gzip file it was made for, and a CRC-32
+   of its own.  If it is there, intact, and for this gzip file, then gzappend
+   resumes decompression from it with inflateRestore(), and so only
+   decompresses the last block.  Otherwise, as for a gzip file from another
+   source, the whole file is decompressed.  Either way, a new checkpoint is
+   saved after appending.  To find the new last block, only the data from the
+   previous checkpoint on is decompressed, which also verifies what was
+   appended.  An append then costs time in proportion to the data appended,
+   not to the size of the gzip file.
+
    Then the last block bit is cleared by seeking back in the file and rewriting
    the byte that contains it.  Seeking forward, the last byte of the compressed
    data is saved along with the number of unused bits to initialize deflate.
@@ -88,6 +107,8 @@
 #define LGCHUNK 14
 #define CHUNK (1U << LGCHUNK)
 #define DSIZE 32768U
+#define CKMAX (DSIZE + 24)      /* largest inflateCheckpoint() */
+#define SFIX 33                 /* sidecar bytes besides the checkpoint */
 
 /* print an error message and terminate with extreme prejudice */
 local void bye(char *msg1, char *msg2)
@@ -96,76 +117,6 @@ local void bye(char *msg1, char *msg2)
     exit(1);
 }
 
-/* return the greatest common divisor of a and b using Euclid's algorithm,
-   modified to be fast when one argument much greater than the other, and
-   coded to avoid unnecessary swapping */
-local unsigned gcd(unsigned a, unsigned b)
-{
-    unsigned c;
-
-    while (a && b)
-        if (a > b) {
-            c = b;
-            while (a - c >= c)
-                c <<= 1;
-            a -= c;
-        }
-        else {
-            c = a;
-            while (b - c >= c)
-                c <<= 1;
-            b -= c;
-        }
-    return a + b;
-}
-
-/* rotate list[0..len-1] left by rot positions, in place */
-local void rotate(unsigned char *list, unsigned len, unsigned rot)
-{
-    unsigned char tmp;
-    unsigned cycles;
-    unsigned char *start, *last, *to, *from;
-
-    /* normalize rot and handle degenerate cases */
-    if (len < 2) return;
-    if (rot >= len) rot %= len;
-    if (rot == 0) return;
-
-    /* pointer to last entry in list */
-    last = list + (len - 1);
-
-    /* do simple left shift by one */
-    if (rot == 1) {
-        tmp = *list;
-        memmove(list, list + 1, len - 1);
-        *last = tmp;
-        return;
-    }
-
-    /* do simple right shift by one */
-    if (rot == len - 1) {
-        tmp = *last;
-        memmove(list + 1, list, len - 1);
-        *list = tmp;
-        return;
-    }
-
-    /* otherwise do rotate as a set of cycles in place */
-    cycles = gcd(len, rot);             /* number of cycles */
-    do {
-        start = from = list + cycles;   /* start index is arbitrary */
-        tmp = *from;                    /* save entry to be overwritten */
-        for (;;) {
-            to = from;                  /* next step in cycle */
-            from += rot;                /* go right rot positions */
-            if (from > last) from -= len;   /* (pointer better not wrap) */
-            if (from == start) break;   /* all but one shifted */
-            *to = *from;                /* shift left */
-        }
-        *to = tmp;                      /* complete the circle */
-    } while (--cycles);
-}
-
 /* structure for gzip file read operations */
 typedef struct {
     int fd;                     /* file descriptor */
@@ -231,6 +182,47 @@ unsigned long read4(file *in)
     return val;
 }
 
+/* get and put little-endian integers in memory */
+local unsigned long get4(const unsigned char *p)
+{
+    return p[0] + ((unsigned)p[1] << 8) + ((unsigned long)p[2] << 16) +
+           ((unsigned long)p[3] << 24);
+}
+
+local void put4(unsigned char *p, unsigned long val)
+{
+    p[0] = (unsigned char)val;
+    p[1] = (unsigned char)(val >> 8);
+    p[2] = (unsigned char)(val >> 16);
+    p[3] = (unsigned char)(val >> 24);
+}
+
+/* write all of buf[0..len-1] to fd */
+local void writen(int fd, const unsigned char *buf, unsigned long len,
+                  char *name)
+{
+    int ret;
+
+    while (len) {
+        ret = write(fd, buf, len > CHUNK ? CHUNK : (unsigned)len);
+        if (ret == -1) bye("writing ", name);
+        buf += ret;
+        len -= (unsigned)ret;
+    }
+}
+
+/* return the name of the checkpoint sidecar for gzip file "name", allocated */
+local char *ckname(char *name)
+{
+    char *ck;
+
+    ck = malloc(strlen(name) + 6);
+    if (ck == NULL) bye("out of memory", "");
+    strcpy(ck, name);
+    strcat(ck, ".ckpt");
+    return ck;
+}
+
 /* skip over gzip header */
 local void gzheader(file *in)
 {
@@ -252,17 +244,154 @@ local void gzheader(file *in)
     if (flags & 2) skip(in, 2);
 }
 
+/* where the last deflate block starts, and a checkpoint to resume there */
+typedef struct {
+    off_t start;                /* offset of the deflate data in the file */
+    off_t lastoff;              /* offset just past the last block bit */
+    int lastbit;                /* bits in the byte before lastoff after it */
+    int left;                   /* unused bits in the last byte of the data */
+    unsigned long crc;          /* CRC-32 of the data decompressed so far */
+    unsigned long ckcrc;        /* CRC-32 of the data before the checkpoint */
+    uLong len;                  /* length of the checkpoint, 0 if none */
+    unsigned char *ckpt;        /* inflateCheckpoint() at lastoff */
+} scan;
+
+/* decompress the deflate data from gz using strm, from wherever strm and gz
+   are until the end of the deflate stream, using out[0..DSIZE-1] for output
+   -- update the CRC-32 of the data and the location of the last block bit,
+   and take a checkpoint at the start of each block so that the one at the
+   start of the last block is left in s -- return Z_OK, or Z_DATA_ERROR if the
+   deflate data is invalid */
+local int gzblocks(file *gz, z_stream *strm, unsigned char *out, scan *s)
+{
+    int ret;
+
+    strm->avail_in = gz->left;
+    strm->next_in = gz->next;
+    do {
+        /* if needed, get more input */
+        if (strm->avail_in == 0) {
+            readmore(gz);
+            strm->avail_in = gz->left;
+            strm->next_in = gz->next;
+        }
+
+        /* inflate and check for errors */
+        strm->avail_out = DSIZE;
+        strm->next_out = out;
+        ret = inflate(strm, Z_BLOCK);
+        if (ret == Z_STREAM_ERROR) bye("internal stream error!", "");
+        if (ret == Z_MEM_ERROR) bye("out of memory", "");
+        if (ret == Z_DATA_ERROR) return ret;
+        s->crc = crc32(s->crc, out, DSIZE - strm->avail_out);
+
+        /* process end of block */
+        if (strm->data_type & 128) {
+            if (strm->data_type & 64)
+                s->left = strm->data_type & 0x1f;
+            else {
+                s->lastbit = strm->data_type & 0x1f;
+                s->lastoff = lseek(gz->fd, 0L, SEEK_CUR) - strm->avail_in;
+                s->len = CKMAX;
+                if (inflateCheckpoint(strm, s->ckpt, &s->len) != Z_OK)
+                    s->len = 0;
+                s->ckcrc = s->crc;
+            }
+        }
+    } while (ret != Z_STREAM_END);
+    gz->left = strm->avail_in;
+    gz->next = strm->next_in;
+    return Z_OK;
+}
+
+/* restore strm from the checkpoint in s and position fd to resume there --
+   the checkpoint holds the bits of the byte before lastoff as they were when
+   it was taken, which may include a last block bit since cleared, so reload
+   those bits from the file -- return the inflateRestore() result */
+local int gzresume(int fd, z_stream *strm, scan *s)
+{
+    int ret;
+    unsigned char byte;
+
+    ret = inflateRestore(strm, s->ckpt, s->len);
+    if (ret != Z_OK) return ret;
+    s->lastoff = s->start + (off_t)strm->total_in;
+    inflatePrime(strm, -1, 0);
+    if (s->lastbit) {
+        if (lseek(fd, s->lastoff - 1, SEEK_SET) == -1 ||
+            read(fd, &byte, 1) != 1)
+            return Z_DATA_ERROR;
+        inflatePrime(strm, s->lastbit, byte >> (8 - s->lastbit));
+    }
+    lseek(fd, s->lastoff, SEEK_SET);
+    s->crc = s->ckcrc;
+    return Z_OK;
+}
+
+/* look for the sidecar written by gzmark() for the gzip file, and if it is
+   there, intact, and for a gzip file of this length and trailer, restore strm
+   from it and position gz to resume decompression at the start of the last
+   block -- return the length of the gzip file, or -1 if there is no usable
+   checkpoint */
+local off_t gzfind(file *gz, z_stream *strm, scan *s)
+{
+    int fd;
+    ssize_t len;
+    off_t size;
+    char *ck;
+    unsigned char tail[8], *mem;
+
+    /* read the sidecar */
+    ck = ckname(gz->name);
+    fd = open(ck, O_RDONLY, 0);
+    free(ck);
+    if (fd == -1)
+        return -1;
+    mem = malloc(SFIX + CKMAX + 1);
+    if (mem == NULL) bye("out of memory", "");
+    len = read(fd, mem, SFIX + CKMAX + 1);
+    close(fd);
+
+    /* check that it is one of ours, for this gzip file */
+    size = lseek(gz->fd, 0L, SEEK_END);
+    if (len <= SFIX || len > SFIX + CKMAX || memcmp(mem, "GZAC", 4) != 0 ||
+        get4(mem + len - 4) != crc32(0L, mem, (uInt)len - 4) ||
+        get4(mem + 4) != (unsigned long)size ||
+        get4(mem + 8) != (unsigned long)((size >> 16) >> 16) ||
+        size < s->start + 8 || lseek(gz->fd, size - 8, SEEK_SET) == -1 ||
+        read(gz->fd, tail, 8) != 8 || memcmp(mem + 12, tail, 8) != 0 ||
+        get4(mem + 20) != (unsigned long)s->start || mem[28] > 7) {
+        free(mem);
+        return -1;
+    }
+
+    /* restore the inflate state at the start of the last block */
+    s->ckcrc = get4(mem + 24);
+    s->lastbit = mem[28];
+    s->len = (uLong)len - SFIX;
+    memcpy(s->ckpt, mem + 29, s->len);
+    free(mem);
+    if (gzresume(gz->fd, strm, s) != Z_OK) {
+        s->len = 0;
+        return -1;
+    }
+    s->left = 0;
+    gz->left = 0;
+    return size;
+}
+
 /* decompress gzip file "name", return strm with a deflate stream ready to
    continue compression of the data in the gzip file, and return a file
    descriptor pointing to where to write the compressed data -- the deflate
-   stream is initialized to compress using level "level" */
-local int gzscan(char *name, z_stream *strm, int level)
+   stream is initialized to compress using level "level", and s is left with
+   the checkpoint for gzmark() */
+local int gzscan(char *name, z_stream *strm, int level, scan *s)
 {
-    int ret, lastbit, left, full;
-    unsigned have;
-    unsigned long crc, tot;
+    int ret;
+    uInt have;
+    unsigned long tot;
     unsigned char *window;
-    off_t lastoff, end;
+    off_t mark, end;
     file gz;
 
     /* open gzip file */
@@ -276,104 +405,77 @@ local int gzscan(char *name, z_stream *strm, int level)
 
     /* skip gzip header */
     gzheader(&gz);
+    s->start = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
 
     /* prepare to decompress */
     window = malloc(DSIZE);
-    if (window == NULL) bye("out of memory", "");
+    s->ckpt = malloc(CKMAX);
+    if (window == NULL || s->ckpt == NULL) bye("out of memory", "");
     strm->zalloc = Z_NULL;
     strm->zfree = Z_NULL;
     strm->opaque = Z_NULL;
     ret = inflateInit2(strm, -15);
     if (ret != Z_OK) bye("out of memory", " or library mismatch");
 
-    /* decompress the deflate stream, saving append information */
-    lastbit = 0;
-    lastoff = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
-    left = 0;
-    strm->avail_in = gz.left;
-    strm->next_in = gz.next;
-    crc = crc32(0L, Z_NULL, 0);
-    have = full = 0;
-    do {
-        /* if needed, get more input */
-        if (strm->avail_in == 0) {
-            readmore(&gz);
-            strm->avail_in = gz.left;
-            strm->next_in = gz.next;
-        }
-
-        /* set up output to next available section of sliding window */
-        strm->avail_out = DSIZE - have;
-        strm->next_out = window + have;
-
-        /* inflate and check for errors */
-        ret = inflate(strm, Z_BLOCK);
-        if (ret == Z_STREAM_ERROR) bye("internal stream error!", "");
-        if (ret == Z_MEM_ERROR) bye("out of memory", "");
-        if (ret == Z_DATA_ERROR)
+    /* decompress just the last block if there is a checkpoint for it, and
+       the deflate stream from there ends just before the trailer */
+    mark = gzfind(&gz, strm, s);
+    if (mark != -1 && (gzblocks(&gz, strm, window, s) != Z_OK ||
+                       lseek(gz.fd, 0L, SEEK_CUR) - gz.left + 8 != mark))
+        mark = -1;
+
+    /* otherwise decompress the whole deflate stream */
+    if (mark == -1) {
+        ret = inflateReset2(strm, -15);
+        if (ret != Z_OK) bye("internal stream error!", "");
+        lseek(gz.fd, s->start, SEEK_SET);
+        gz.left = 0;
+        s->lastbit = 0;
+        s->lastoff = s->start;
+        s->left = 0;
+        s->len = 0;
+        s->crc = crc32(0L, Z_NULL, 0);
+        if (gzblocks(&gz, strm, window, s) != Z_OK)
             bye("invalid compressed data--format violated in", name);
+    }
 
-        /* update crc and sliding window pointer */
-        crc = crc32(crc, window + have, DSIZE - have - strm->avail_out);
-        if (strm->avail_out)
-            have = DSIZE - strm->avail_out;
-        else {
-            have = 0;
-            full = 1;
-        }
-
-        /* process end of block */
-        if (strm->data_type & 128) {
-            if (strm->data_type & 64)
-                left = strm->data_type & 0x1f;
-            else {
-                lastbit = strm->data_type & 0x1f;
-                lastoff = lseek(gz.fd, 0L, SEEK_CUR) - strm->avail_in;
-            }
-        }
-    } while (ret != Z_STREAM_END);
+    /* get the last 32K of uncompressed data for the dictionary */
+    have = DSIZE;
+    inflateGetDictionary(strm, window, &have);
     inflateEnd(strm);
-    gz.left = strm->avail_in;
-    gz.next = strm->next_in;
 
     /* save the location of the end of the compressed data */
     end = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
 
     /* check gzip trailer and save total for deflate */
-    if (crc != read4(&gz))
+    if (s->crc != read4(&gz))
         bye("invalid compressed data--crc mismatch in ", name);
     tot = strm->total_out;
     if ((tot & 0xffffffffUL) != read4(&gz))
         bye("invalid compressed data--length mismatch in", name);
 
     /* if not at end of file, warn */
-    if (gz.left || readin(&gz))
+    if (mark == -1 && (gz.left || readin(&gz)))
         fprintf(stderr,
             "gzappend warning: junk at end of gzip file overwritten\n");
 
     /* clear last block bit */
-    lseek(gz.fd, lastoff - (lastbit != 0), SEEK_SET);
+    lseek(gz.fd, s->lastoff - (s->lastbit != 0), SEEK_SET);
     if (read(gz.fd, gz.buf, 1) != 1) bye("reading after seek on ", name);
-    *gz.buf = (unsigned char)(*gz.buf ^ (1 << ((8 - lastbit) & 7)));
+    *gz.buf = (unsigned char)(*gz.buf ^ (1 << ((8 - s->lastbit) & 7)));
     lseek(gz.fd, -1L, SEEK_CUR);
     if (write(gz.fd, gz.buf, 1) != 1) bye("writing after seek to ", name);
 
-    /* if window wrapped, build dictionary from window by rotating */
-    if (full) {
-        rotate(window, DSIZE, have);
-        have = DSIZE;
-    }
-
     /* set up deflate stream with window, crc, total_in, and leftover bits */
     ret = deflateInit2(strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK) bye("out of memory", "");
     deflateSetDictionary(strm, window, have);
-    strm->adler = crc;
+    strm->adler = s->crc;
     strm->total_in = tot;
-    if (left) {
+    if (s->left) {
         lseek(gz.fd, --end, SEEK_SET);
         if (read(gz.fd, gz.buf, 1) != 1) bye("reading after seek on ", name);
-        deflatePrime(strm, 8 - left, *gz.buf);
+        deflatePrime(strm, 8 - s->left, *gz.buf);
     }
     lseek(gz.fd, end, SEEK_SET);
 
@@ -444,13 +546,7 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
         out[5] = (unsigned char)(strm->total_in >> 8);
         out[6] = (unsigned char)(strm->total_in >> 16);
         out[7] = (unsigned char)(strm->total_in >> 24);
-        len = 8;
-        do {
-            ret = write(gd, out + 8 - len, len);
-            if (ret == -1) bye("writing gzip file", "");
-            len -= ret;
-        } while (len);
-        close(gd);
+        writen(gd, out, 8, "gzip file");
     }
 
     /* clean up and return */
@@ -459,6 +555,88 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
     if (fd > 0) close(fd);
 }
 
+/* find the last block of gzip file "name" open on gd after appending to it,
+   decompressing only from the checkpoint in s, which also verifies the
+   appended data against the new trailer -- then cut off anything after the
+   trailer, close the file, and save a checkpoint for the new last block in
+   the sidecar */
+local void gzmark(char *name, int gd, scan *s)
+{
+    int ret, fd;
+    unsigned long len;
+    unsigned char *out, *mem;
+    char *ck;
+    off_t end;
+    z_stream strm;
+    file gz;
+
+    /* prepare to decompress from the checkpoint, or from the start if none */
+    gz.name = name;
+    gz.fd = gd;
+    gz.buf = malloc(CHUNK);
+    out = malloc(DSIZE);
+    if (gz.buf == NULL || out == NULL) bye("out of memory", "");
+    gz.size = LGCHUNK;
+    gz.left = 0;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = inflateInit2(&strm, -15);
+    if (ret != Z_OK) bye("out of memory", " or library mismatch");
+    if (s->len) {
+        ret = gzresume(gd, &strm, s);
+        if (ret != Z_OK) bye("internal stream error!", "");
+    }
+    else {
+        s->crc = crc32(0L, Z_NULL, 0);
+        lseek(gd, s->start, SEEK_SET);
+    }
+
+    /* decompress to the new last block and check the new trailer */
+    if (gzblocks(&gz, &strm, out, s) != Z_OK ||
+        s->crc != read4(&gz) ||
+        (strm.total_out & 0xffffffffUL) != read4(&gz))
+        bye("appended data does not verify in ", name);
+    inflateEnd(&strm);
+    end = lseek(gd, 0L, SEEK_CUR) - gz.left;
+
+    /* remove what was after the trailer, if anything */
+    if (ftruncate(gd, end) != 0) bye("truncating ", name);
+    close(gd);
+
+    /* save the checkpoint with the length and trailer of the gzip file, or
+       remove an old sidecar if there is no checkpoint */
+    ck = ckname(name);
+    if (s->len) {
+        len = SFIX + s->len;
+        mem = malloc(len);
+        if (mem == NULL) bye("out of memory", "");
+        memcpy(mem, "GZAC", 4);
+        put4(mem + 4, (unsigned long)end);
+        put4(mem + 8, (unsigned long)((end >> 16) >> 16));
+        put4(mem + 12, s->crc);
+        put4(mem + 16, strm.total_out);
+        put4(mem + 20, (unsigned long)s->start);
+        put4(mem + 24, s->ckcrc);
+        mem[28] = (unsigned char)s->lastbit;
+        memcpy(mem + 29, s->ckpt, s->len);
+        put4(mem + len - 4, crc32(0L, mem, (uInt)len - 4));
+        fd = open(ck, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1)
+            fprintf(stderr, "gzappend warning: cannot write %s\n", ck);
+        else {
+            writen(fd, mem, len, ck);
+            close(fd);
+        }
+        free(mem);
+    }
+    else
+        unlink(ck);
+    free(ck);
+    free(out);
+    free(gz.buf);
+}
+
 /* process the compression level option if present, scan the gzip file, and
    append the specified files, or append the data from stdin if no other file
    names are provided on the command line -- the gzip file must be writable
@@ -466,7 +644,9 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
 int main(int argc, char **argv)
 {
     int gd, level;
+    char *name;
     z_stream strm;
+    scan s;
 
     /* ignore command name */
     argc--; argv++;
@@ -474,7 +654,7 @@ int main(int argc, char **argv)
     /* provide usage if no arguments */
     if (*argv == NULL) {
         printf(
-            "gzappend 1.2 (11 Oct 2012) Copyright (C) 2003, 2012 Mark Adler\n"
+            "gzappend 1.3 (15 Oct 2026) Copyright (C) 2003, 2012 Mark Adler\n"
                );
         printf(
             "usage: gzappend [-level] file.gz [ addthis [ andthis ... ]]\n");
@@ -491,7 +671,8 @@ int main(int argc, char **argv)
     }
 
     /* prepare to append to gzip file */
-    gd = gzscan(*argv++, &strm, level);
+    name = *argv++;
+    gd = gzscan(name, &strm, level, &s);
 
     /* append files on command line, or from stdin if none */
     if (*argv == NULL)
@@ -500,5 +681,9 @@ int main(int argc, char **argv)
         do {
             gztack(*argv, gd, &strm, argv[1] == NULL);
         } while (*++argv != NULL);
+
+    /* leave a checkpoint for the next append */
+    gzmark(name, gd, &s);
+    free(s.ckpt);
     return 0;
 }
@@ -48,17 +48,35 @@
    compressed data in order to connect the streams.  The output gzip file
    has a minimal ten-byte gzip header with no file name or modification time.
 
+   With the -j option, the data is decompressed on several threads with
+   inflateParallel2() to check it and to get a checkpoint near its end, from
+   which inflateRestore() resumes decompression to find the last block.  Only
+   the compressed data after that checkpoint is decompressed serially.  The
+   files are then read into memory, so this applies to files of less than
+   4 GB, and larger ones are joined as without -j.
+
+   With the -m option, gzjoin does not decompress anything, and instead writes
+   each file as a separate member of the output, with the same minimal header
+   as above.  The result is a multiple-member gzip file, which gzip and zlib's
+   gzread() decompress to the concatenation of the data, but some other
+   decompressors only decompress the first member.  Each input file must then
+   contain a single gzip member, ending with its trailer.
+
    This program was written to illustrate the use of the Z_BLOCK option of
    inflate() and the crc32_combine() function.  gzjoin will not compile with
-   versions of zlib earlier than 1.2.3.
+   versions of zlib earlier than 1.2.3, and the -j option requires the
+   inflateParallel2() and inflateRestore() functions of this zlib.
  */
 
 #include <stdio.h>      /* fputs(), fprintf(), fwrite(), putc() */
-#include <stdlib.h>     /* exit(), malloc(), free() */
+#include <stdlib.h>     /* exit(), malloc(), free(), atoi() */
+#include <string.h>     /* memcpy(), strcmp() */
 #include <fcntl.h>      /* open() */
 #include <unistd.h>     /* close(), read(), lseek() */
+#include <sys/stat.h>   /* fstat() */
 #include "zlib.h"
-    /* crc32(), crc32_combine(), inflateInit2(), inflate(), inflateEnd() */
+    /* crc32(), crc32_combine(), inflateInit2(), inflate(), inflateEnd(),
+       inflateParallel2(), inflateRestore() */
 
 #define local static
 
@@ -269,6 +287,41 @@ local void gzinit(unsigned long *crc, unsigned long *tot, FILE *out)
     *tot = 0;
 }
 
+/* Write the last byte of deflate data last, which has pos unused bits.  If
+   clr is true, then follow that with empty blocks to get to a byte boundary,
+   so that more deflate data can follow it. */
+local void gzpad(int last, int pos, int clr, FILE *out)
+{
+    if (pos == 0 || !clr)
+        /* already at byte boundary, or last file: write last byte */
+        putc(last, out);
+    else {
+        /* append empty blocks to last byte */
+        last &= ((0x100 >> pos) - 1);       /* assure unused bits are zero */
+        if (pos & 1) {
+            /* odd -- append an empty stored block */
+            putc(last, out);
+            if (pos == 1)
+                putc(0, out);               /* two more bits in block header */
+            fwrite("\0\0\xff\xff", 1, 4, out);
+        }
+        else {
+            /* even -- append 1, 2, or 3 empty fixed blocks */
+            switch (pos) {
+            case 6:
+                putc(last | 8, out);
+                last = 0;
+            case 4:
+                putc(last | 0x20, out);
+                last = 0;
+            case 2:
+                putc(last | 0x80, out);
+                putc(0, out);
+            }
+        }
+    }
+}
+
 /* Copy the compressed data from name, zeroing the last block bit of the last
    block if clr is true, and adding empty blocks as needed to get to a byte
    boundary.  If clr is false, then the last block becomes the last block of
@@ -375,37 +428,8 @@ local void gzcopy(char *name, int clr, unsigned long *crc, unsigned long *tot,
     in->next = in->buf + (strm.next_in - in->buf);
 
     /* copy used input, write empty blocks to get to byte boundary */
-    pos = strm.data_type & 7;
     fwrite(start, 1, in->next - start - 1, out);
-    last = in->next[-1];
-    if (pos == 0 || !clr)
-        /* already at byte boundary, or last file: write last byte */
-        putc(last, out);
-    else {
-        /* append empty blocks to last byte */
-        last &= ((0x100 >> pos) - 1);       /* assure unused bits are zero */
-        if (pos & 1) {
-            /* odd -- append an empty stored block */
-            putc(last, out);
-            if (pos == 1)
-                putc(0, out);               /* two more bits in block header */
-            fwrite("\0\0\xff\xff", 1, 4, out);
-        }
-        else {
-            /* even -- append 1, 2, or 3 empty fixed blocks */
-            switch (pos) {
-            case 6:
-                putc(last | 8, out);
-                last = 0;
-            case 4:
-                putc(last | 0x20, out);
-                last = 0;
-            case 2:
-                putc(last | 0x80, out);
-                putc(0, out);
-            }
-        }
-    }
+    gzpad(in->next[-1], strm.data_type & 7, clr, out);
 
     /* update crc and tot */
     *crc = crc32_combine(*crc, bget4(in), len);
@@ -423,26 +447,271 @@ local void gzcopy(char *name, int clr, unsigned long *crc, unsigned long *tot,
     }
 }
 
+/* the last checkpoint from inflateParallel2() */
+typedef struct {
+    unsigned char *buf;     /* allocated checkpoint, or NULL if none yet */
+    unsigned len;           /* length of the checkpoint */
+} mark;
+
+/* inflateParallel2() index function -- keep the checkpoint if it is the last
+   one so far, which they all are, since they are made in order */
+local int keep(void *desc, unsigned char *buf, unsigned len)
+{
+    mark *last = desc;
+
+    if (last->buf == NULL) {
+        last->buf = malloc(24 + 32768U);        /* largest checkpoint */
+        if (last->buf == NULL)
+            return 1;
+    }
+    if (len > 24 + 32768U)
+        return 1;
+    memcpy(last->buf, buf, len);
+    last->len = len;
+    return 0;
+}
+
+/* inflateParallel2() output function -- discard the uncompressed data */
+local int discard(void *desc, unsigned char *buf, unsigned len)
+{
+    (void)desc;
+    (void)buf;
+    (void)len;
+    return 0;
+}
+
+/* Same as gzcopy(), but read all of name into memory and decompress it on up
+   to threads threads, keeping the last checkpoint, and then find the last
+   block by decompressing serially only from that checkpoint.  Return zero on
+   success, or -1 if the file is too large to be read into memory or to be
+   decompressed with one call, in which case nothing has been written. */
+local int gzfast(char *name, int clr, int threads, unsigned long *crc,
+                 unsigned long *tot, FILE *out)
+{
+    int ret;                /* return value from zlib functions */
+    int pos;                /* where the "last block" bit is in byte */
+    int last;               /* true if processing the last block */
+    bin *in;                /* buffered input file, to check the header */
+    unsigned char *buf;     /* the whole file */
+    unsigned char *junk;    /* buffer for uncompressed data -- discarded */
+    size_t head;            /* length of the gzip header */
+    size_t size;            /* length of the file */
+    size_t at;              /* offset of the next byte to decompress */
+    size_t got;             /* number of bytes read into buf */
+    long len;               /* return value of read() */
+    struct stat st;         /* to get the file size */
+    unsigned long crc2;     /* crc from the trailer */
+    z_off_t total;          /* length of uncompressed data */
+    z_stream strm;          /* zlib inflate stream */
+    mark cp;                /* last checkpoint */
+
+    /* open gzip file, skip header, and read it all in */
+    in = bopen(name);
+    if (in == NULL)
+        bail("could not open ", name);
+    gzhead(in);
+    head = (size_t)lseek(in->fd, 0, SEEK_CUR) - in->left;
+    if (fstat(in->fd, &st) || (off_t)(size_t)st.st_size != st.st_size ||
+        (off_t)(uInt)st.st_size != st.st_size ||
+        (buf = malloc(st.st_size ? (size_t)st.st_size : 1)) == NULL) {
+        bclose(in);
+        return -1;
+    }
+    size = (size_t)st.st_size;
+    lseek(in->fd, 0, SEEK_SET);
+    for (got = 0; got < size; got += (size_t)len) {
+        len = (long)read(in->fd, buf + got, size - got);
+        if (len <= 0)
+            bail("could not read ", name);
+    }
+    bclose(in);
+
+    /* decompress the deflate data on threads, keeping the last checkpoint */
+    cp.buf = NULL;
+    cp.len = 0;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = buf + head;
+    strm.avail_in = (uInt)(size - head);
+    ret = inflateParallel2(&strm, -15, threads, 0, discard, NULL, keep, &cp);
+    if (ret == Z_MEM_ERROR)
+        bail("out of memory", "");
+    if (ret == Z_BUF_ERROR && strm.avail_in == 0)
+        bail("unexpected end of file on ", name);
+    if (ret != Z_STREAM_END)
+        bail("invalid compressed data in ", name);
+    total = (z_off_t)strm.total_out;
+
+    /* resume at the last checkpoint, or start at the beginning if none */
+    junk = malloc(CHUNK);
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit2(&strm, -15);
+    if (junk == NULL || ret != Z_OK)
+        bail("out of memory", "");
+    at = head;
+    pos = 0;
+    if (cp.buf != NULL) {
+        if (inflateRestore(&strm, cp.buf, cp.len) != Z_OK)
+            bail("out of memory", "");
+        at += (size_t)strm.total_in;
+        pos = cp.buf[2];
+        free(cp.buf);
+    }
+    strm.next_in = buf + at;
+    strm.avail_in = (uInt)(size - at);
+
+    /* decompress from there a block at a time, clearing the last-block bit of
+       the last block if requested */
+    for (;;) {
+        /* find the last-block bit of the block that starts here */
+        if (pos != 0) {
+            /* last-block bit is in last used byte */
+            pos = 0x100 >> pos;
+            last = strm.next_in[-1] & pos;
+            if (last && clr)
+                strm.next_in[-1] &= ~pos;
+        }
+        else {
+            /* last-block bit is in next unused byte */
+            if (strm.avail_in == 0)
+                bail("unexpected end of file on ", name);
+            last = strm.next_in[0] & 1;
+            if (last && clr)
+                buf[strm.next_in - buf] &= ~1;
+        }
+
+        /* decompress to the end of the block */
+        do {
+            strm.avail_out = CHUNK;
+            strm.next_out = junk;
+            ret = inflate(&strm, Z_BLOCK);
+            if (ret == Z_MEM_ERROR)
+                bail("out of memory", "");
+            if (ret != Z_OK)
+                bail("invalid compressed data in ", name);
+        } while ((strm.data_type & 128) == 0);
+
+        /* if that was the last block, then done */
+        if (last)
+            break;
+        pos = strm.data_type & 7;
+    }
+
+    /* copy the compressed data, write empty blocks to get to byte boundary */
+    at = (size_t)(strm.next_in - buf);
+    if (size - at < 8)
+        bail("unexpected end of file on ", name);
+    fwrite(buf + head, 1, at - head - 1, out);
+    gzpad(buf[at - 1], strm.data_type & 7, clr, out);
+
+    /* update crc and tot from the trailer */
+    crc2 = buf[at] + ((unsigned long)buf[at + 1] << 8) +
+           ((unsigned long)buf[at + 2] << 16) +
+           ((unsigned long)buf[at + 3] << 24);
+    *crc = crc32_combine(*crc, crc2, total);
+    *tot += (unsigned long)total;
+
+    /* clean up */
+    inflateEnd(&strm);
+    free(junk);
+    free(buf);
+
+    /* write trailer if this is the last gzip file */
+    if (!clr) {
+        put4(*crc, out);
+        put4(*tot, out);
+    }
+    return 0;
+}
+
+/* Copy the gzip member in name to out as is, except with a minimal gzip
+   header.  name must contain one gzip member and nothing after it. */
+local void gzmember(char *name, FILE *out)
+{
+    bin *in;                /* buffered input file */
+    off_t left;             /* bytes left to copy */
+    unsigned put;           /* bytes to copy from the buffer */
+    struct stat st;         /* to get the file size */
+
+    /* open gzip file and skip header */
+    in = bopen(name);
+    if (in == NULL)
+        bail("could not open ", name);
+    gzhead(in);
+    if (fstat(in->fd, &st))
+        bail("could not read ", name);
+    left = st.st_size - (lseek(in->fd, 0, SEEK_CUR) - in->left);
+    if (left < 10)
+        bail("unexpected end of file on ", name);
+
+    /* write the header, and copy the compressed data and trailer */
+    fwrite("\x1f\x8b\x08\0\0\0\0\0\0\xff", 1, 10, out);
+    while (left) {
+        if (in->left == 0 && bload(in) < 0)
+            bail("could not read ", name);
+        if (in->left == 0)
+            bail("unexpected end of file on ", name);
+        put = left < in->left ? (unsigned)left : in->left;
+        fwrite(in->next, 1, put, out);
+        in->left -= put;
+        in->next += put;
+        left -= put;
+    }
+    bclose(in);
+}
+
 /* join the gzip files on the command line, write result to stdout */
 int main(int argc, char **argv)
 {
     unsigned long crc, tot;     /* running crc and total uncompressed length */
+    int members = 0;            /* true to write a multiple-member file */
+    int threads = 0;            /* threads for -j, or zero to not use it */
 
     /* skip command name */
     argc--;
     argv++;
 
+    /* get options */
+    while (argc && argv[0][0] == '-') {
+        if (strcmp(*argv, "-m") == 0)
+            members = 1;
+        else if (strcmp(*argv, "-j") == 0 && argc > 1 && atoi(argv[1]) > 0) {
+            threads = atoi(argv[1]);
+            argc--;
+            argv++;
+        }
+        else
+            bail("invalid option ", *argv);
+        argc--;
+        argv++;
+    }
+
     /* show usage if no arguments */
     if (argc == 0) {
-        fputs("gzjoin usage: gzjoin f1.gz [f2.gz [f3.gz ...]] > fjoin.gz\n",
-              stderr);
+        fputs("gzjoin usage: gzjoin [-m | -j threads] f1.gz [f2.gz [f3.gz ...]]"
+              " > fjoin.gz\n", stderr);
+        return 0;
+    }
+
+    /* copy each gzip file as a member of the output */
+    if (members) {
+        while (argc--)
+            gzmember(*argv++, stdout);
         return 0;
     }
 
     /* join gzip files on command line and write to stdout */
     gzinit(&crc, &tot, stdout);
-    while (argc--)
-        gzcopy(*argv++, argc, &crc, &tot, stdout);
+    while (argc--) {
+        if (threads == 0 || gzfast(*argv, argc, threads, &crc, &tot, stdout))
+            gzcopy(*argv, argc, &crc, &tot, stdout);
+        argv++;
+    }
 
     /* done */
     return 0;
@@ -22,6 +22,14 @@
    gzlog maintains another auxiliary file with the last 32K of data from the
    compressed portion, which is preloaded for the compression of the subsequent
    data.  This minimizes the impact to the compression ratio of appending.
+
+   Writes from several threads are committed in groups.  The records written
+   while an append is in progress are gathered in memory, and then written by
+   one of their writers as a single append, with one set of fsyncs.  When it is
+   time to compress, a compress thread does that, holding the files only while
+   it reads the stored data at the start, and again at the end, when it
+   compresses what was appended in between and rewrites the file.  The
+   procedures on the files below are the same either way.
  */
 
 /*
@@ -234,6 +242,8 @@
 #include <time.h>       /* time, ctime */
 #include <sys/stat.h>   /* stat */
 #include <sys/time.h>   /* utimes */
+#include <pthread.h>    /* pthread_mutex_lock, pthread_cond_wait, */
+                        /* pthread_create, pthread_join */
 #include "zlib.h"       /* crc32 */
 
 #include "gzlog.h"      /* header for external access */
@@ -284,6 +294,13 @@ typedef unsigned long ulong;
 #define PUT4(p,a) do {PUT2(p,a);PUT2(p+2,a>>16);} while(0)
 #define PUT8(p,a) do {PUT4(p,a);PUT4(p+4,a>>32);} while(0)
 
+/* a writer waiting for the batch with its record to be committed */
+struct log_wait {
+    struct log_wait *next;  /* next writer in the same batch */
+    int done;               /* true once the batch has been committed */
+    int ret;                /* result of committing the batch */
+};
+
 /* internal structure for log information */
 #define LOGID "\106\035\172"    /* should be three non-zero characters */
 struct log {
@@ -300,6 +317,21 @@ struct log {
     ulong tcrc;     /* crc of total data */
     ulong tlen;     /* length (modulo 2^32) of total data */
     time_t lock;    /* last modify time of our lock file */
+    pthread_mutex_t mutex;  /* protects the members below */
+    pthread_cond_t cond;    /* signaled when busy is cleared, or there is
+                               work for the compress thread */
+    int busy;               /* true while a thread is using the files */
+    unsigned char *pend;    /* records waiting to be committed */
+    size_t plen;            /* number of bytes in pend */
+    size_t psize;           /* allocated size of pend */
+    unsigned char *spare;   /* buffer to use for pend next */
+    size_t ssize;           /* allocated size of spare */
+    struct log_wait *wait;  /* writers of the records in pend */
+    int squeeze;            /* true while the compress thread has work */
+    int squeezing;          /* true while a compress is in progress */
+    int quit;               /* true to make the compress thread exit */
+    int started;            /* true if the compress thread was started */
+    pthread_t thread;       /* the compress thread */
 };
 
 /* gzip header for gzlog */
@@ -595,79 +627,154 @@ local int log_replace(struct log *log)
     return log_mark(log, NO_OP);
 }
 
+/* deflate state and its output for a compress operation */
+struct log_def {
+    z_stream strm;          /* raw deflate stream */
+    int init;               /* true if strm was initialized */
+    unsigned char *out;     /* compressed data so far */
+    size_t have;            /* number of bytes in out */
+    size_t size;            /* allocated size of out */
+};
+
+/* Set up def for compressing the stored data to be appended to the previous
+   compressed data in foo.gz, using the dictionary in foo.dict and priming
+   deflate with the last bits of the previous block.  Return -1 if reading
+   foo.dict or foo.gz failed, or -2 if there was a memory allocation failure.
+   def is left so that log_end() can be used in any case. */
+local int log_begin(struct log *log, struct log_def *def)
+{
+    int fd;
+    ssize_t dict;
+    unsigned char buf[DICT];
+
+    /* set up for deflate, allocating memory */
+    def->init = 0;
+    def->out = NULL;
+    def->have = 0;
+    def->size = 0;
+    def->strm.zalloc = Z_NULL;
+    def->strm.zfree = Z_NULL;
+    def->strm.opaque = Z_NULL;
+    if (deflateInit2(&def->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        return -2;
+    def->init = 1;
+
+    /* read in dictionary (last 32K of data that was compressed) */
+    strcpy(log->end, ".dict");
+    fd = open(log->path, O_RDONLY, 0);
+    if (fd >= 0) {
+        dict = read(fd, buf, DICT);
+        close(fd);
+        if (dict < 0)
+            return -1;
+        if (dict)
+            deflateSetDictionary(&def->strm, buf, (uint)dict);
+    }
+    log_touch(log);
+
+    /* prime deflate with last bits of previous block -- those bits are not
+       changed by appends, so this can be done before the data is complete */
+    if (lseek(log->fd, log->first - (log->back > 8 ? 2 : 1), SEEK_SET) < 0 ||
+        read(log->fd, buf, 1) != 1)
+        return -1;
+    deflatePrime(&def->strm, (8 - log->back) & 7, *buf);
+    return 0;
+}
+
+/* Compress the len bytes at data with def into memory, using flush for the
+   last of it.  This does not use the files, so it can be done while other
+   threads append to the log.  Return -2 if there was a memory allocation
+   failure. */
+local int log_deflate(struct log_def *def, unsigned char *data, size_t len,
+                      int flush)
+{
+    uint max;
+    size_t size;
+    unsigned char *out;
+
+    def->strm.next_in = data;
+    max = (((uint)0 - 1) >> 1) + 1; /* in case int smaller than size_t */
+    do {
+        def->strm.avail_in = len > max ? max : (uint)len;
+        len -= def->strm.avail_in;
+        do {
+            if (def->size - def->have < DICT) {
+                size = def->size ? def->size << 1 : (size_t)DICT << 3;
+                out = realloc(def->out, size);
+                if (out == NULL)
+                    return -2;
+                def->out = out;
+                def->size = size;
+            }
+            def->strm.avail_out = DICT;
+            def->strm.next_out = def->out + def->have;
+            deflate(&def->strm, len ? Z_NO_FLUSH : flush);
+            def->have += DICT - def->strm.avail_out;
+        } while (def->strm.avail_out == 0);
+    } while (len);
+    return 0;
+}
+
+/* Free the resources of def. */
+local void log_end(struct log_def *def)
+{
+    if (def->init)
+        deflateEnd(&def->strm);
+    def->init = 0;
+    free(def->out);
+    def->out = NULL;
+}
+
 /* Compress the len bytes at data and append the compressed data to the
    foo.gz deflate data immediately after the previous compressed data.  This
    overwrites the previous uncompressed data, which was stored in foo.add
-   and is the data provided in data[0..len-1].  If this operation is
-   interrupted, it picks up at the start of this routine, with the foo.add
-   file read in again.  If there is no data to compress (len == 0), then we
-   simply terminate the foo.gz file after the previously compressed data,
-   appending a final empty stored block and the gzip trailer.  Return -1 if
-   reading or writing the log.gz file failed, or -2 if there was a memory
+   and is the data provided in data[0..len-1].  If def is not NULL, then it has
+   already compressed all of data with a final Z_PARTIAL_FLUSH.  If this
+   operation is interrupted, it picks up at the start of this routine, with the
+   foo.add file read in again.  If there is no data to compress (len == 0),
+   then we simply terminate the foo.gz file after the previously compressed
+   data, appending a final empty stored block and the gzip trailer.  Return -1
+   if reading or writing the log.gz file failed, or -2 if there was a memory
    allocation failure. */
-local int log_compress(struct log *log, unsigned char *data, size_t len)
+local int log_compress(struct log *log, unsigned char *data, size_t len,
+                       struct log_def *def)
 {
-    int fd;
-    uint got, max;
-    ssize_t dict;
+    int ret;
+    size_t put, max;
     off_t end;
-    z_stream strm;
-    unsigned char buf[DICT];
+    struct log_def here;
+    unsigned char buf[8];
 
     /* compress and append compressed data */
     if (len) {
-        /* set up for deflate, allocating memory */
-        strm.zalloc = Z_NULL;
-        strm.zfree = Z_NULL;
-        strm.opaque = Z_NULL;
-        if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
-                         Z_DEFAULT_STRATEGY) != Z_OK)
-            return -2;
-
-        /* read in dictionary (last 32K of data that was compressed) */
-        strcpy(log->end, ".dict");
-        fd = open(log->path, O_RDONLY, 0);
-        if (fd >= 0) {
-            dict = read(fd, buf, DICT);
-            close(fd);
-            if (dict < 0) {
-                deflateEnd(&strm);
-                return -1;
+        /* compress to memory, finishing with a partial non-last empty static
+           block, unless that was already done */
+        if (def == NULL) {
+            def = &here;
+            ret = log_begin(log, def);
+            if (ret == 0)
+                ret = log_deflate(def, data, len, Z_PARTIAL_FLUSH);
+            if (ret) {
+                log_end(def);
+                return ret;
             }
-            if (dict)
-                deflateSetDictionary(&strm, buf, (uint)dict);
-        }
-        log_touch(log);
-
-        /* prime deflate with last bits of previous block, position write
-           pointer to write those bits and overwrite what follows */
-        if (lseek(log->fd, log->first - (log->back > 8 ? 2 : 1),
-                SEEK_SET) < 0 ||
-            read(log->fd, buf, 1) != 1 || lseek(log->fd, -1, SEEK_CUR) < 0) {
-            deflateEnd(&strm);
-            return -1;
         }
-        deflatePrime(&strm, (8 - log->back) & 7, *buf);
 
-        /* compress, finishing with a partial non-last empty static block */
-        strm.next_in = data;
-        max = (((uint)0 - 1) >> 1) + 1; /* in case int smaller than size_t */
-        do {
-            strm.avail_in = len > max ? max : (uint)len;
-            len -= strm.avail_in;
-            do {
-                strm.avail_out = DICT;
-                strm.next_out = buf;
-                deflate(&strm, len ? Z_NO_FLUSH : Z_PARTIAL_FLUSH);
-                got = DICT - strm.avail_out;
-                if (got && write(log->fd, buf, got) != got) {
-                    deflateEnd(&strm);
-                    return -1;
-                }
-                log_touch(log);
-            } while (strm.avail_out == 0);
-        } while (len);
-        deflateEnd(&strm);
+        /* write over the previous bits and what follows */
+        ret = lseek(log->fd, log->first - (log->back > 8 ? 2 : 1),
+                    SEEK_SET) < 0 ? -1 : 0;
+        max = (((uint)0 - 1) >> 1) + 1;
+        for (put = 0; ret == 0 && put < def->have; put += len) {
+            len = def->have - put > max ? max : def->have - put;
+            if ((size_t)write(log->fd, def->out + put, len) != len)
+                ret = -1;
+            log_touch(log);
+        }
+        if (def == &here)
+            log_end(def);
+        if (ret)
+            return ret;
         BAIL(5);
 
         /* find start of empty static block -- scanning backwards the first one
@@ -779,7 +886,7 @@ local int log_recover(struct log *log, int op)
         ret = log_append(log, data, len);
         break;
     case COMPRESS_OP:
-        ret = log_compress(log, data, len);
+        ret = log_compress(log, data, len, NULL);
         break;
     case REPLACE_OP:
         ret = log_replace(log);
@@ -863,6 +970,226 @@ local int log_open(struct log *log)
     return 0;
 }
 
+/* Read the uncompressed data in the stored blocks of foo.gz into an allocated
+   buffer, returned in *data with its length in *len.  Return -1 if reading
+   foo.gz failed, or -2 if there was a memory allocation failure. */
+local int log_stored(struct log *log, unsigned char **data, size_t *len)
+{
+    uint block;
+    size_t next;
+    unsigned char buf[5];
+
+    /* create space for uncompressed data */
+    *len = ((size_t)(log->last - log->first) & ~(((size_t)1 << 10) - 1)) +
+           log->stored;
+    if ((*data = malloc(*len + 1)) == NULL)
+        return -2;
+
+    /* read in the uncompressed data */
+    if (lseek(log->fd, log->first - 1, SEEK_SET) >= 0) {
+        next = 0;
+        while (next < *len) {
+            if (read(log->fd, buf, 5) != 5)
+                break;
+            block = PULL2(buf + 1);
+            if (next + block > *len ||
+                read(log->fd, *data + next, block) != block)
+                break;
+            next += block;
+        }
+        if (lseek(log->fd, 0, SEEK_CUR) == log->last + 4 + log->stored) {
+            log_touch(log);
+            return 0;
+        }
+    }
+    free(*data);
+    return -1;
+}
+
+/* Replace the len bytes of stored data at data with their compressed form,
+   which def has already compressed if it is not NULL.  Return -1 on an i/o
+   error, or -2 if there was a memory allocation failure. */
+local int log_store(struct log *log, unsigned char *data, size_t len,
+                    struct log_def *def)
+{
+    int fd, ret;
+    size_t next;
+
+    /* write the uncompressed data to the .add file */
+    strcpy(log->end, ".add");
+    fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    ret = (size_t)write(fd, data, len) != len;
+    if (ret | close(fd))
+        return -1;
+    log_touch(log);
+
+    /* write the dictionary for the next compress to the .temp file */
+    strcpy(log->end, ".temp");
+    fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    next = DICT > len ? len : DICT;
+    ret = (size_t)write(fd, data + len - next, next) != next;
+    if (ret | close(fd))
+        return -1;
+    log_touch(log);
+
+    /* roll back to compressed data, mark the compress in progress */
+    log->last = log->first;
+    log->stored = 0;
+    if (log_mark(log, COMPRESS_OP))
+        return -1;
+    BAIL(7);
+
+    /* compress and append the data (clears mark) */
+    return log_compress(log, data, len, def);
+}
+
+/* Wait until no other thread is using the files, and then claim them.  The
+   mutex must be held. */
+local void log_own(struct log *log)
+{
+    while (log->busy)
+        pthread_cond_wait(&log->cond, &log->mutex);
+    log->busy = 1;
+}
+
+/* Release the files for use by other threads. */
+local void log_release(struct log *log)
+{
+    pthread_mutex_lock(&log->mutex);
+    log->busy = 0;
+    pthread_cond_broadcast(&log->cond);
+    pthread_mutex_unlock(&log->mutex);
+}
+
+/* Compress the uncompressed data in the log, without keeping the files from
+   writers for the bulk of it.  The stored data is read, and then compressed
+   to memory while other threads go on appending.  The files are then claimed
+   again, the data that was appended meanwhile is compressed after it, and all
+   of it is replaced in foo.gz with the usual compress operation, whose
+   recovery is unchanged.  If the compressed data in foo.gz changed in between
+   (which requires losing the lock to another process), the data is compressed
+   again from the start.  Only one compress is done at a time.  Return values
+   as for gzlog_compress(). */
+local int log_squeeze(struct log *log)
+{
+    int ret;
+    off_t first = 0;
+    size_t len = 0, all;
+    unsigned char *data;
+    struct log_def def;
+
+    /* claim the files, and read the stored data and the dictionary */
+    pthread_mutex_lock(&log->mutex);
+    while (log->squeezing)
+        pthread_cond_wait(&log->cond, &log->mutex);
+    log->squeezing = 1;
+    log_own(log);
+    pthread_mutex_unlock(&log->mutex);
+    def.init = 0;
+    def.out = NULL;
+    ret = log_check(log) && log_open(log) ? -1 : log_stored(log, &data, &len);
+    if (ret == 0) {
+        ret = log_begin(log, &def);
+        first = log->first;
+        if (ret)
+            free(data);
+    }
+    log_release(log);
+
+    /* compress what was read while the writers continue */
+    if (ret == 0) {
+        ret = log_deflate(&def, data, len, Z_NO_FLUSH);
+        free(data);
+    }
+
+    /* claim the files again, and compress and replace all of the stored data,
+       starting over if the compressed data in foo.gz changed meanwhile */
+    pthread_mutex_lock(&log->mutex);
+    log_own(log);
+    pthread_mutex_unlock(&log->mutex);
+    if (ret == 0 && log_check(log) && log_open(log))
+        ret = -1;
+    if (ret == 0)
+        ret = log_stored(log, &data, &all);
+    if (ret == 0) {
+        if (log->first == first && all >= len) {
+            ret = log_deflate(&def, data + len, all - len, Z_PARTIAL_FLUSH);
+            if (ret == 0)
+                ret = log_store(log, data, all, &def);
+        }
+        else
+            ret = log_store(log, data, all, NULL);
+        free(data);
+    }
+    log_end(&def);
+    pthread_mutex_lock(&log->mutex);
+    log->busy = 0;
+    log->squeezing = 0;
+    pthread_cond_broadcast(&log->cond);
+    pthread_mutex_unlock(&log->mutex);
+    return ret;
+}
+
+/* Compress thread -- compress when asked to by a writer, until told to quit.
+   An error is left to be found by the next write or compress. */
+local void *log_compressor(void *arg)
+{
+    struct log *log = arg;
+
+    pthread_mutex_lock(&log->mutex);
+    for (;;) {
+        while (!log->squeeze && !log->quit)
+            pthread_cond_wait(&log->cond, &log->mutex);
+        if (log->quit)
+            break;
+        pthread_mutex_unlock(&log->mutex);
+        log_squeeze(log);
+        pthread_mutex_lock(&log->mutex);
+        log->squeeze = 0;
+    }
+    pthread_mutex_unlock(&log->mutex);
+    return NULL;
+}
+
+/* Append the len bytes at data to the log as one operation.  Return 1 if it is
+   time to compress, or else values as for gzlog_write(). */
+local int log_commit(struct log *log, unsigned char *data, size_t len)
+{
+    int fd, ret;
+
+    /* see if we lost the lock -- if so get it again and reload the extra
+       field information (it probably changed), recover last operation if
+       necessary */
+    if (log_check(log) && log_open(log))
+        return -1;
+
+    /* create and write .add file */
+    strcpy(log->end, ".add");
+    fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    ret = (size_t)write(fd, data, len) != len;
+    if (ret | close(fd))
+        return -1;
+    log_touch(log);
+
+    /* mark log file with append in progress */
+    if (log_mark(log, APPEND_OP))
+        return -1;
+    BAIL(8);
+
+    /* append data (clears mark) */
+    if (log_append(log, data, len))
+        return -1;
+
+    /* check to see if it's time to compress */
+    return ((log->last - log->first) >> 10) + (log->stored >> 10) >= TRIGGER;
+}
+
 /* See gzlog.h for the description of the external methods below */
 gzlog *gzlog_open(char *path)
 {
@@ -877,13 +1204,25 @@ gzlog *gzlog_open(char *path)
     log = malloc(sizeof(struct log));
     if (log == NULL)
         return NULL;
+    memset(log, 0, sizeof(struct log));
     strcpy(log->id, LOGID);
     log->fd = -1;
+    if (pthread_mutex_init(&log->mutex, NULL)) {
+        free(log);
+        return NULL;
+    }
+    if (pthread_cond_init(&log->cond, NULL)) {
+        pthread_mutex_destroy(&log->mutex);
+        free(log);
+        return NULL;
+    }
 
     /* save path and end of path for name construction */
     n = strlen(path);
     log->path = malloc(n + 9);              /* allow for ".repairs" */
     if (log->path == NULL) {
+        pthread_cond_destroy(&log->cond);
+        pthread_mutex_destroy(&log->mutex);
         free(log);
         return NULL;
     }
@@ -893,6 +1232,8 @@ gzlog *gzlog_open(char *path)
     /* gain exclusive access and verify log file -- may perform a
        recovery operation if needed */
     if (log_open(log)) {
+        pthread_cond_destroy(&log->cond);
+        pthread_mutex_destroy(&log->mutex);
         free(log->path);
         free(log);
         return NULL;
@@ -909,84 +1250,14 @@ gzlog *gzlog_open(char *path)
    -3: invalid log pointer argument */
 int gzlog_compress(gzlog *logd)
 {
-    int fd, ret;
-    uint block;
-    size_t len, next;
-    unsigned char *data, buf[5];
     struct log *log = logd;
 
     /* check arguments */
     if (log == NULL || strcmp(log->id, LOGID))
         return -3;
 
-    /* see if we lost the lock -- if so get it again and reload the extra
-       field information (it probably changed), recover last operation if
-       necessary */
-    if (log_check(log) && log_open(log))
-        return -1;
-
-    /* create space for uncompressed data */
-    len = ((size_t)(log->last - log->first) & ~(((size_t)1 << 10) - 1)) +
-          log->stored;
-    if ((data = malloc(len)) == NULL)
-        return -2;
-
-    /* do statement here is just a cheap trick for error handling */
-    do {
-        /* read in the uncompressed data */
-        if (lseek(log->fd, log->first - 1, SEEK_SET) < 0)
-            break;
-        next = 0;
-        while (next < len) {
-            if (read(log->fd, buf, 5) != 5)
-                break;
-            block = PULL2(buf + 1);
-            if (next + block > len ||
-                read(log->fd, (char *)data + next, block) != block)
-                break;
-            next += block;
-        }
-        if (lseek(log->fd, 0, SEEK_CUR) != log->last + 4 + log->stored)
-            break;
-        log_touch(log);
-
-        /* write the uncompressed data to the .add file */
-        strcpy(log->end, ".add");
-        fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd < 0)
-            break;
-        ret = (size_t)write(fd, data, len) != len;
-        if (ret | close(fd))
-            break;
-        log_touch(log);
-
-        /* write the dictionary for the next compress to the .temp file */
-        strcpy(log->end, ".temp");
-        fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd < 0)
-            break;
-        next = DICT > len ? len : DICT;
-        ret = (size_t)write(fd, (char *)data + len - next, next) != next;
-        if (ret | close(fd))
-            break;
-        log_touch(log);
-
-        /* roll back to compressed data, mark the compress in progress */
-        log->last = log->first;
-        log->stored = 0;
-        if (log_mark(log, COMPRESS_OP))
-            break;
-        BAIL(7);
-
-        /* compress and append the data (clears mark) */
-        ret = log_compress(log, data, len);
-        free(data);
-        return ret;
-    } while (0);
-
-    /* broke out of do above on i/o error */
-    free(data);
-    return -1;
+    /* compress, letting writers continue for most of it */
+    return log_squeeze(log);
 }
 
 /* gzlog_write() return values:
@@ -996,7 +1267,10 @@ int gzlog_compress(gzlog *logd)
    -3: invalid log pointer argument */
 int gzlog_write(gzlog *logd, void *data, size_t len)
 {
-    int fd, ret;
+    int ret, now = 0;
+    size_t size;
+    unsigned char *batch, *more;
+    struct log_wait me, *wait, *next;
     struct log *log = logd;
 
     /* check arguments */
@@ -1005,37 +1279,74 @@ int gzlog_write(gzlog *logd, void *data, size_t len)
     if (data == NULL || len <= 0)
         return 0;
 
-    /* see if we lost the lock -- if so get it again and reload the extra
-       field information (it probably changed), recover last operation if
-       necessary */
-    if (log_check(log) && log_open(log))
-        return -1;
-
-    /* create and write .add file */
-    strcpy(log->end, ".add");
-    fd = open(log->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd < 0)
-        return -1;
-    ret = (size_t)write(fd, data, len) != len;
-    if (ret | close(fd))
-        return -1;
-    log_touch(log);
-
-    /* mark log file with append in progress */
-    if (log_mark(log, APPEND_OP))
-        return -1;
-    BAIL(8);
-
-    /* append data (clears mark) */
-    if (log_append(log, data, len))
-        return -1;
-
-    /* check to see if it's time to compress -- if not, then done */
-    if (((log->last - log->first) >> 10) + (log->stored >> 10) < TRIGGER)
-        return 0;
+    /* add the record to the next batch */
+    pthread_mutex_lock(&log->mutex);
+    if (log->psize - log->plen < len) {
+        size = log->psize ? log->psize : 65536;
+        while (size - log->plen < len && size << 1 > size)
+            size <<= 1;
+        more = size - log->plen < len ? NULL : realloc(log->pend, size);
+        if (more == NULL) {
+            pthread_mutex_unlock(&log->mutex);
+            return -2;
+        }
+        log->pend = more;
+        log->psize = size;
+    }
+    memcpy(log->pend + log->plen, data, len);
+    log->plen += len;
+    me.done = 0;
+    me.next = log->wait;
+    log->wait = &me;
+
+    /* wait for the batch to be committed -- if no other thread is using the
+       files, then commit it and all of the records added to it so far, with
+       one append and one set of fsyncs */
+    while (!me.done) {
+        if (log->busy) {
+            pthread_cond_wait(&log->cond, &log->mutex);
+            continue;
+        }
+        log->busy = 1;
+        batch = log->pend;
+        len = log->plen;
+        size = log->psize;
+        wait = log->wait;
+        log->pend = log->spare;
+        log->psize = log->ssize;
+        log->plen = 0;
+        log->wait = NULL;
+        log->spare = NULL;
+        pthread_mutex_unlock(&log->mutex);
+        ret = log_commit(log, batch, len);
+        pthread_mutex_lock(&log->mutex);
+        log->spare = batch;
+        log->ssize = size;
+
+        /* hand compression to the compress thread, starting it if needed --
+           if it can't be started, then compress here as before */
+        if (ret > 0) {
+            ret = 0;
+            if (!log->started && !log->quit &&
+                pthread_create(&log->thread, NULL, log_compressor, log) == 0)
+                log->started = 1;
+            if (log->started)
+                log->squeeze = 1;
+            else
+                now = 1;
+        }
 
-    /* time to compress */
-    return gzlog_compress(log);
+        /* let the writers in the batch return */
+        for (; wait != NULL; wait = next) {
+            next = wait->next;
+            wait->ret = ret;
+            wait->done = 1;
+        }
+        log->busy = 0;
+        pthread_cond_broadcast(&log->cond);
+    }
+    pthread_mutex_unlock(&log->mutex);
+    return now && me.ret == 0 ? log_squeeze(log) : me.ret;
 }
 
 /* gzlog_close() return values:
@@ -1049,12 +1360,24 @@ int gzlog_close(gzlog *logd)
     if (log == NULL || strcmp(log->id, LOGID))
         return -3;
 
+    /* stop the compress thread, letting it finish a compress in progress */
+    pthread_mutex_lock(&log->mutex);
+    log->quit = 1;
+    pthread_cond_broadcast(&log->cond);
+    pthread_mutex_unlock(&log->mutex);
+    if (log->started)
+        pthread_join(log->thread, NULL);
+
     /* close the log file and release the lock */
     log_close(log);
 
     /* free structure and return */
     if (log->path != NULL)
         free(log->path);
+    free(log->pend);
+    free(log->spare);
+    pthread_cond_destroy(&log->cond);
+    pthread_mutex_destroy(&log->mutex);
     strcpy(log->id, "bad");
     free(log);
     return 0;
@@ -43,6 +43,12 @@
    The gzlog operations can be interrupted at any point due to an application or
    system crash, and the log file will be recovered the next time the log is
    opened with gzlog_open().
+
+   A gzlog object can be written to by many threads at once.  The records
+   written while one append is in progress are gathered, and are appended
+   together with the next one, so that the writers share its file writes and
+   fsyncs.  Compression is done by a thread of the object, while writers go on
+   appending.  gzlog.c must be linked with the POSIX threads library.
  */
 
 #ifndef GZLOG_H
@@ -72,20 +78,27 @@ gzlog *gzlog_open(char *path);
    a memory allocation failure, or -3 if the log argument is invalid (e.g. if
    it was not created by gzlog_open()).  This function will write data to the
    file uncompressed, until 1 MB has been accumulated, at which time that data
-   will be compressed.  The log file will be a valid gzip file upon successful
-   return. */
+   will be compressed in the background.  The log file will be a valid gzip
+   file upon successful return, and data will be in it to be recovered after a
+   crash.  gzlog_write() can be called from several threads at once.  Each
+   waits until its data has been appended, possibly together with the data of
+   other threads in a single append, which is then the data of each thread
+   in turn, whole.  The result of that append is returned to all of them. */
 int gzlog_write(gzlog *log, void *data, size_t len);
 
 /* Force compression of any uncompressed data in the log.  This should be used
    sparingly, if at all.  The main application would be when a log file will
    not be appended to again.  If this is used to compress frequently while
    appending, it will both significantly increase the execution time and
-   reduce the compression ratio.  The return codes are the same as for
-   gzlog_write(). */
+   reduce the compression ratio.  Writers are only held up while the data that
+   was appended during the compression is compressed and written.  The return
+   codes are the same as for gzlog_write(). */
 int gzlog_compress(gzlog *log);
 
 /* Close a gzlog object.  Return zero on success, -3 if the log argument is
-   invalid.  The log object is freed, and so cannot be referenced again. */
+   invalid.  A compression in progress in the background is completed first.
+   No other thread may be using the object.  The log object is freed, and so
+   cannot be referenced again. */
 int gzlog_close(gzlog *log);
 
 #endif
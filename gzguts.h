@@ -55,6 +55,25 @@
 #  define WIDECHAR
 #endif
 
+/* memory map files opened for reading with "m" on systems with mmap() */
+#if !defined(NO_MMAP) && !defined(_WIN32) && \
+    (defined(__unix__) || defined(__unix) || defined(__APPLE__))
+#  define GZ_MMAP
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  ifdef MADV_HUGEPAGE
+#    define GZ_HUGE 2097152     /* huge page size, for gzbufferalign() */
+#  endif
+#endif
+
+/* write the pieces from gzwritev() together when transparent, with writev() */
+#if !defined(NO_WRITEV) && !defined(_WIN32) && \
+    (defined(__unix__) || defined(__unix) || defined(__APPLE__))
+#  define GZ_WRITEV
+#  include <sys/uio.h>
+#endif
+
 #ifdef NO_DEFLATE       /* for compatibility with old definition */
 #  define NO_GZCOMPRESS
 #endif
@@ -144,6 +163,17 @@
     ZEXTERN z_off64_t ZEXPORT gzoffset64(gzFile);
 #endif
 
+/* seek on a file descriptor with a 64-bit offset, if available */
+#if defined(__DJGPP__)
+#  define LSEEK llseek
+#elif defined(_WIN32) && !defined(__BORLANDC__) && !defined(UNDER_CE)
+#  define LSEEK _lseeki64
+#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
+#  define LSEEK lseek64
+#else
+#  define LSEEK lseek
+#endif
+
 /* default memLevel */
 #if MAX_MEM_LEVEL >= 8
 #  define DEF_MEM_LEVEL 8
@@ -155,6 +185,10 @@
    twice this must be able to fit in an unsigned type) */
 #define GZBUFSIZE 8192
 
+/* largest buffer size chosen when reading a large file, if the size was not
+   requested with gzbuffer() */
+#define GZBUFMAX 131072
+
 /* gzip modes, also provide a little integrity check on the passed structure */
 #define GZ_NONE 0
 #define GZ_READ 7247
@@ -166,6 +200,15 @@
 #define COPY 1      /* copy input directly */
 #define GZIP 2      /* decompress a gzip stream */
 
+/* I/O functions and their context from gzopen_funcs() */
+struct gz_io_s {
+    voidp ctx;              /* opaque context for the functions */
+    gz_read_func zread;     /* read, or NULL if only writing */
+    gz_write_func zwrite;   /* write, or NULL if only reading */
+    gz_seek_func zseek;     /* seek, or NULL if not seekable */
+    gz_close_func zclose;   /* close, or NULL if nothing to do */
+};
+
 /* internal gzip file state data structure */
 typedef struct {
         /* exposed contents for gzgetc() macro */
@@ -177,8 +220,12 @@ typedef struct {
     int mode;               /* see gzip modes above */
     int fd;                 /* file descriptor */
     char *path;             /* path or fd for error messages */
+    struct gz_io_s *io;     /* I/O functions to use instead of fd, or NULL */
     unsigned size;          /* buffer size, zero if not allocated yet */
-    unsigned want;          /* requested buffer size, default is GZBUFSIZE */
+    unsigned want;          /* requested buffer size, or 0 for the default */
+    unsigned align;         /* buffer alignment, or 0 to just use malloc() */
+    int huge;               /* true to put the buffers on huge pages */
+    voidp mem;              /* aligned inflate or deflate memory, or NULL */
     unsigned char *in;      /* input buffer (double-sized when writing) */
     unsigned char *out;     /* output buffer (double-sized when reading) */
     int direct;             /* 0 if processing gzip, 1 if transparent */
@@ -187,10 +234,21 @@ typedef struct {
     z_off64_t start;        /* where the gzip data started, for rewinding */
     int eof;                /* true if end of input file reached */
     int past;               /* true if read requested past end */
+    unsigned char *map;     /* memory-mapped file, or NULL if using read() */
+    z_off64_t mapped;       /* length of the mapped file */
+    z_off64_t mnext;        /* offset in the map of the next byte to load */
+    unsigned ahead;         /* number of read-ahead or write-behind buffers */
+    struct gz_ahead_s *ring;    /* read-ahead thread and buffers, or NULL */
+    z_off64_t at;           /* file offset after the data taken from ring */
+    struct gz_index_s *index;   /* access points for seeking, or NULL */
+    int restored;           /* true if inflating raw from an access point */
+    unsigned trail;         /* gzip trailer bytes left to skip after that */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
+    int threads;            /* compression threads, parallel deflate if > 1 */
     int reset;              /* true if a reset is pending after a Z_FINISH */
+    struct gz_behind_s *behind; /* compression thread and buffers, or NULL */
         /* seek request */
     z_off64_t skip;         /* amount to skip (already rewound if backwards) */
     int seek;               /* true if seek request pending */
@@ -204,6 +262,14 @@ typedef gz_state FAR *gz_statep;
 
 /* shared functions */
 void ZLIB_INTERNAL gz_error(gz_statep, int, const char *);
+int ZLIB_INTERNAL gz_ahead_stop(gz_statep);
+int ZLIB_INTERNAL gz_index_seek(gz_statep, z_off64_t *);
+voidp ZLIB_INTERNAL gz_malloc(gz_statep, size_t);
+int ZLIB_INTERNAL gz_read_io(gz_statep, voidp, unsigned);
+int ZLIB_INTERNAL gz_write_io(gz_statep, voidpc, unsigned);
+z_off64_t ZLIB_INTERNAL gz_seek_io(gz_statep, z_off64_t, int);
+int ZLIB_INTERNAL gz_close_io(gz_statep);
+void ZLIB_INTERNAL gz_free(gz_statep, voidp);
 #if defined UNDER_CE
 char ZLIB_INTERNAL *gz_strwinerror(DWORD error);
 #endif
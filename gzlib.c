@@ -5,16 +5,6 @@
 
 #include "gzguts.h"
 
-#if defined(__DJGPP__)
-#  define LSEEK llseek
-#elif defined(_WIN32) && !defined(__BORLANDC__) && !defined(UNDER_CE)
-#  define LSEEK _lseeki64
-#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
-#  define LSEEK lseek64
-#else
-#  define LSEEK lseek
-#endif
-
 #if defined UNDER_CE
 
 /* Map the Windows error number in ERROR to a locale-dependent error message
@@ -72,6 +62,7 @@ local void gz_reset(gz_statep state) {
         state->eof = 0;             /* not at end of file */
         state->past = 0;            /* have not read past end yet */
         state->how = LOOK;          /* look for gzip header */
+        state->trail = 0;           /* no gzip trailer to skip */
     }
     else                            /* for writing ... */
         state->reset = 0;           /* no deflateReset pending */
@@ -81,8 +72,35 @@ local void gz_reset(gz_statep state) {
     state->strm.avail_in = 0;       /* no input data yet */
 }
 
-/* Open a gzip file either by name or file descriptor. */
-local gzFile gz_open(const void *path, int fd, const char *mode) {
+#ifdef GZ_MMAP
+/* Memory map the file being read, if it is a regular file with data after the
+   starting position. If it can't be mapped, read() is used instead. The size
+   of the file at the time it is opened is what will be read. */
+local void gz_map(gz_statep state) {
+    struct stat st;
+    void *map;
+
+    if (fstat(state->fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+            st.st_size <= state->start ||
+            (off_t)(size_t)st.st_size != st.st_size)
+        return;
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, state->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+#ifdef POSIX_MADV_SEQUENTIAL
+    (void)posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    (void)posix_madvise(map, (size_t)st.st_size, POSIX_MADV_WILLNEED);
+#endif
+    state->map = (unsigned char *)map;
+    state->mapped = st.st_size;
+    state->mnext = state->start;
+}
+#endif
+
+/* Open a gzip file either by name, by file descriptor, or with the I/O
+   functions in io, in which case path is only for error messages. */
+local gzFile gz_open(const void *path, int fd, const char *mode,
+                     struct gz_io_s *io) {
     gz_statep state;
     z_size_t len;
     int oflag;
@@ -92,6 +110,9 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
 #ifdef O_EXCL
     int exclusive = 0;
 #endif
+#ifdef GZ_MMAP
+    int map = 0;
+#endif
 
     /* check input */
     if (path == NULL)
@@ -101,14 +122,25 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
     state = (gz_statep)malloc(sizeof(gz_state));
     if (state == NULL)
         return NULL;
+    state->io = io;             /* NULL to use a file descriptor */
     state->size = 0;            /* no buffers allocated yet */
-    state->want = GZBUFSIZE;    /* requested buffer size */
+    state->want = 0;            /* default buffer size */
+    state->align = 0;           /* buffers from malloc() */
+    state->huge = 0;
+    state->mem = NULL;
     state->msg = NULL;          /* no error message yet */
+    state->map = NULL;          /* not memory mapped */
+    state->ahead = 0;           /* no read-ahead or write-behind thread */
+    state->ring = NULL;
+    state->behind = NULL;
+    state->index = NULL;        /* no access points */
+    state->restored = 0;
 
     /* interpret mode */
     state->mode = GZ_NONE;
     state->level = Z_DEFAULT_COMPRESSION;
     state->strategy = Z_DEFAULT_STRATEGY;
+    state->threads = 1;
     state->direct = 0;
     while (*mode) {
         if (*mode >= '0' && *mode <= '9')
@@ -153,17 +185,27 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
             case 'F':
                 state->strategy = Z_FIXED;
                 break;
+            case 'Q':
+                state->strategy = Z_QUICK;
+                break;
             case 'T':
                 state->direct = 1;
                 break;
+#ifdef GZ_MMAP
+            case 'm':
+                map = 1;
+                break;
+#endif
             default:        /* could consider as an error, but just ignore */
                 ;
             }
         mode++;
     }
 
-    /* must provide an "r", "w", or "a" */
-    if (state->mode == GZ_NONE) {
+    /* must provide an "r", "w", or "a", and the function to do it with */
+    if (state->mode == GZ_NONE || (io != NULL && (state->mode == GZ_READ ?
+                                                  io->zread == NULL :
+                                                  io->zwrite == NULL))) {
         free(state);
         return NULL;
     }
@@ -227,8 +269,10 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
            O_TRUNC :
            O_APPEND)));
 
-    /* open the file with the appropriate flags (or just use fd) */
-    if (fd == -1)
+    /* open the file with the appropriate flags (or just use fd or io) */
+    if (io != NULL)
+        state->fd = -1;
+    else if (fd == -1)
         state->fd = open((const char *)path, oflag, 0666);
 #ifdef WIDECHAR
     else if (fd == -2)
@@ -236,20 +280,24 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
 #endif
     else
         state->fd = fd;
-    if (state->fd == -1) {
+    if (state->fd == -1 && io == NULL) {
         free(state->path);
         free(state);
         return NULL;
     }
     if (state->mode == GZ_APPEND) {
-        LSEEK(state->fd, 0, SEEK_END);  /* so gzoffset() is correct */
+        gz_seek_io(state, 0, SEEK_END);  /* so gzoffset() is correct */
         state->mode = GZ_WRITE;         /* simplify later checks */
     }
 
     /* save the current position for rewinding (only if reading) */
     if (state->mode == GZ_READ) {
-        state->start = LSEEK(state->fd, 0, SEEK_CUR);
+        state->start = gz_seek_io(state, 0, SEEK_CUR);
         if (state->start == -1) state->start = 0;
+#ifdef GZ_MMAP
+        if (map && io == NULL)
+            gz_map(state);
+#endif
     }
 
     /* initialize stream */
@@ -261,12 +309,12 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
 
 /* -- see zlib.h -- */
 gzFile ZEXPORT gzopen(const char *path, const char *mode) {
-    return gz_open(path, -1, mode);
+    return gz_open(path, -1, mode, NULL);
 }
 
 /* -- see zlib.h -- */
 gzFile ZEXPORT gzopen64(const char *path, const char *mode) {
-    return gz_open(path, -1, mode);
+    return gz_open(path, -1, mode, NULL);
 }
 
 /* -- see zlib.h -- */
@@ -281,15 +329,36 @@ gzFile ZEXPORT gzdopen(int fd, const char *mode) {
 #else
     sprintf(path, "<fd:%d>", fd);   /* for debugging */
 #endif
-    gz = gz_open(path, fd, mode);
+    gz = gz_open(path, fd, mode, NULL);
     free(path);
     return gz;
 }
 
+/* -- see zlib.h -- */
+gzFile ZEXPORT gzopen_funcs(voidp ctx, gz_read_func zread,
+                            gz_write_func zwrite, gz_seek_func zseek,
+                            gz_close_func zclose, const char *mode) {
+    struct gz_io_s *io;
+    gzFile gz;
+
+    io = (struct gz_io_s *)malloc(sizeof(struct gz_io_s));
+    if (io == NULL)
+        return NULL;
+    io->ctx = ctx;
+    io->zread = zread;
+    io->zwrite = zwrite;
+    io->zseek = zseek;
+    io->zclose = zclose;
+    gz = gz_open("<funcs>", -1, mode, io);
+    if (gz == NULL)
+        free(io);
+    return gz;
+}
+
 /* -- see zlib.h -- */
 #ifdef WIDECHAR
 gzFile ZEXPORT gzopen_w(const wchar_t *path, const char *mode) {
-    return gz_open(path, -2, mode);
+    return gz_open(path, -2, mode, NULL);
 }
 #endif
 
@@ -317,6 +386,121 @@ int ZEXPORT gzbuffer(gzFile file, unsigned size) {
     return 0;
 }
 
+/* -- see zlib.h -- */
+int ZEXPORT gzbufferalign(gzFile file, unsigned align, int huge) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ && state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0)
+        return -1;
+
+    /* check and set requested alignment, which must be a power of two */
+    if (align & (align - 1))
+        return -1;
+    state->align = align;
+    state->huge = huge != 0;
+    return 0;
+}
+
+/* Allocate size bytes for a buffer or the inflate or deflate memory of
+   state, at the alignment requested with gzbufferalign(), and on huge pages
+   if requested and available. The pointer before the returned memory saves
+   what malloc() returned, for gz_free(). Return NULL if out of memory. */
+voidp ZLIB_INTERNAL gz_malloc(gz_statep state, size_t size) {
+    size_t align = state->align;
+    unsigned char *mem, *buf;
+
+    if (align <= 1 && !state->huge)
+        return malloc(size);
+    if (align < sizeof(voidp))
+        align = sizeof(voidp);
+#ifdef GZ_HUGE
+    if (state->huge) {
+        /* round up to whole huge pages, so that they can be used */
+        if (align < GZ_HUGE)
+            align = GZ_HUGE;
+        if (size > (size_t)-1 - (GZ_HUGE - 1))
+            return NULL;
+        size = (size + GZ_HUGE - 1) & ~(size_t)(GZ_HUGE - 1);
+    }
+#endif
+    if (size > (size_t)-1 - sizeof(voidp) - (align - 1))
+        return NULL;
+    mem = (unsigned char *)malloc(size + sizeof(voidp) + (align - 1));
+    if (mem == NULL)
+        return NULL;
+    buf = mem + sizeof(voidp);
+    buf += (0 - (z_size_t)buf) & (align - 1);
+    ((voidp *)buf)[-1] = mem;
+#ifdef GZ_HUGE
+    if (state->huge)
+        (void)madvise(buf, size, MADV_HUGEPAGE);
+#endif
+    return buf;
+}
+
+/* Read up to len bytes for state into buf, with the read function from
+   gzopen_funcs() if there is one, otherwise with read(). Return the number of
+   bytes read, zero at end of file, or -1 on error with errno set. */
+int ZLIB_INTERNAL gz_read_io(gz_statep state, voidp buf, unsigned len) {
+    if (state->io != NULL)
+        return state->io->zread(state->io->ctx, buf, len);
+    return (int)read(state->fd, buf, len);
+}
+
+/* Write up to len bytes for state from buf, as for gz_read_io(). Return the
+   number of bytes written, or -1 on error with errno set. */
+int ZLIB_INTERNAL gz_write_io(gz_statep state, voidpc buf, unsigned len) {
+    if (state->io != NULL)
+        return state->io->zwrite(state->io->ctx, buf, len);
+    return (int)write(state->fd, buf, len);
+}
+
+/* Seek for state, as for gz_read_io(). Return the resulting offset, or -1 on
+   error, including if there is no seek function. */
+z_off64_t ZLIB_INTERNAL gz_seek_io(gz_statep state, z_off64_t offset,
+                                   int whence) {
+    if (state->io == NULL)
+        return LSEEK(state->fd, offset, whence);
+    if (state->io->zseek == NULL) {
+#ifdef ESPIPE
+        errno = ESPIPE;
+#endif
+        return -1;
+    }
+    return state->io->zseek(state->io->ctx, offset, whence);
+}
+
+/* Close the file for state, as for gz_read_io(), and free the I/O functions.
+   Return 0 on success, or -1 on error. */
+int ZLIB_INTERNAL gz_close_io(gz_statep state) {
+    int ret;
+
+    if (state->io == NULL)
+        return close(state->fd);
+    ret = state->io->zclose == NULL ? 0 : state->io->zclose(state->io->ctx);
+    free(state->io);
+    state->io = NULL;
+    return ret;
+}
+
+/* Free memory from gz_malloc(). */
+void ZLIB_INTERNAL gz_free(gz_statep state, voidp ptr) {
+    if (ptr == NULL)
+        return;
+    if (state->align <= 1 && !state->huge)
+        free(ptr);
+    else
+        free(((voidp *)ptr)[-1]);
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzrewind(gzFile file) {
     gz_statep state;
@@ -332,7 +516,11 @@ int ZEXPORT gzrewind(gzFile file) {
         return -1;
 
     /* back up and start over */
-    if (LSEEK(state->fd, state->start, SEEK_SET) == -1)
+    if (gz_ahead_stop(state) == -1)
+        return -1;
+    if (state->map != NULL)
+        state->mnext = state->start;
+    else if (gz_seek_io(state, state->start, SEEK_SET) == -1)
         return -1;
     gz_reset(state);
     return 0;
@@ -369,9 +557,18 @@ z_off64_t ZEXPORT gzseek64(gzFile file, z_off64_t offset, int whence) {
     /* if within raw area while reading, just go there */
     if (state->mode == GZ_READ && state->how == COPY &&
             state->x.pos + offset >= 0) {
-        ret = LSEEK(state->fd, offset - (z_off64_t)state->x.have, SEEK_CUR);
-        if (ret == -1)
-            return -1;
+        if (state->map != NULL) {
+            ret = state->mnext + offset - (z_off64_t)state->x.have;
+            state->mnext = ret < state->mapped ? ret : state->mapped;
+        }
+        else {
+            if (gz_ahead_stop(state) == -1)
+                return -1;
+            ret = gz_seek_io(state, offset - (z_off64_t)state->x.have,
+                             SEEK_CUR);
+            if (ret == -1)
+                return -1;
+        }
         state->x.have = 0;
         state->eof = 0;
         state->past = 0;
@@ -382,6 +579,12 @@ z_off64_t ZEXPORT gzseek64(gzFile file, z_off64_t offset, int whence) {
         return state->x.pos;
     }
 
+    /* if reading with access points, go to the closest one if that's better
+       than decompressing from here or from the start */
+    if (state->mode == GZ_READ && state->index != NULL &&
+            gz_index_seek(state, &offset) == -1)
+        return -1;
+
     /* calculate skip amount, rewinding if needed for back seek when reading */
     if (offset < 0) {
         if (state->mode != GZ_READ)         /* writing -- can't go backwards */
@@ -455,7 +658,9 @@ z_off64_t ZEXPORT gzoffset64(gzFile file) {
         return -1;
 
     /* compute and return effective offset in file */
-    offset = LSEEK(state->fd, 0, SEEK_CUR);
+    offset = state->map != NULL ? state->mnext :
+             state->ring != NULL ? state->at :
+             gz_seek_io(state, 0, SEEK_CUR);
     if (offset == -1)
         return -1;
     if (state->mode == GZ_READ)             /* reading */
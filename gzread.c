@@ -4,6 +4,198 @@
  */
 
 #include "gzguts.h"
+#include "zthread.h"
+
+#ifdef HAVE_THREADS
+
+/* Ring of input buffers filled by a read-ahead thread, so that reading the
+   file overlaps decompression. The thread fills buffer head % count when
+   head - tail < count, and the reader takes the data from buffer tail % count,
+   releasing it by incrementing tail. */
+struct gz_ahead_s {
+        /* shared, protected by lock */
+    zmutex lock;            /* mutex for the following */
+    zcond cond;             /* signaled when a buffer is filled or released */
+    unsigned head;          /* number of buffers filled */
+    unsigned tail;          /* number of buffers released */
+    int end;                /* true if the thread reached the end of file */
+    int err;                /* errno from read(), or zero */
+    int stop;               /* true to tell the thread to return */
+        /* used only by the reader */
+    unsigned used;          /* bytes taken from the tail buffer */
+    int done;               /* true if the tail buffer is to be released */
+        /* set before the thread is started */
+    int fd;                 /* file descriptor to read */
+    struct gz_io_s *io;     /* or the functions to read with, if not NULL */
+    unsigned count;         /* number of buffers */
+    unsigned size;          /* size of each buffer */
+    unsigned *len;          /* bytes in each filled buffer */
+    unsigned char *buf;     /* count buffers of size bytes */
+    zthread thread;         /* the read-ahead thread */
+};
+
+/* Read-ahead thread. */
+local void gz_ahead_run(void *arg) {
+    struct gz_ahead_s *ring = (struct gz_ahead_s *)arg;
+    unsigned char *buf;
+    int ret;
+
+    zmutex_lock(&ring->lock);
+    for (;;) {
+        while (!ring->stop && !ring->end && !ring->err &&
+               ring->head - ring->tail == ring->count)
+            zcond_wait(&ring->cond, &ring->lock);
+        if (ring->stop || ring->end || ring->err)
+            break;
+        buf = ring->buf + (size_t)(ring->head % ring->count) * ring->size;
+        zmutex_unlock(&ring->lock);
+        ret = ring->io != NULL ?
+              ring->io->zread(ring->io->ctx, buf, ring->size) :
+              (int)read(ring->fd, buf, ring->size);
+        zmutex_lock(&ring->lock);
+        if (ret < 0)
+            ring->err = errno;
+        else if (ret == 0)
+            ring->end = 1;
+        else
+            ring->len[ring->head++ % ring->count] = (unsigned)ret;
+        zcond_broadcast(&ring->cond);
+    }
+    zmutex_unlock(&ring->lock);
+}
+
+/* Start the read-ahead thread for state->fd at its current position, if
+   requested and not already running. If it can't be started, give up on
+   reading ahead and use read() directly. */
+local void gz_ahead_start(gz_statep state) {
+    struct gz_ahead_s *ring;
+
+    if (state->ahead == 0 || state->ring != NULL || state->map != NULL)
+        return;
+    ring = (struct gz_ahead_s *)malloc(sizeof(struct gz_ahead_s));
+    if (ring == NULL) {
+        state->ahead = 0;
+        return;
+    }
+    ring->count = state->ahead;
+    ring->size = state->size;
+    if (ring->size > ((unsigned)-1 >> 2) + 1)
+        ring->size = ((unsigned)-1 >> 2) + 1;
+    ring->len = (unsigned *)malloc(ring->count * sizeof(unsigned));
+    ring->buf = (unsigned char *)gz_malloc(state,
+                                           (size_t)ring->count * ring->size);
+    if (ring->len == NULL || ring->buf == NULL ||
+        ring->count != state->ahead ||
+        (size_t)ring->count * ring->size / ring->size != ring->count) {
+        gz_free(state, ring->buf);
+        free(ring->len);
+        free(ring);
+        state->ahead = 0;
+        return;
+    }
+    ring->head = ring->tail = 0;
+    ring->end = ring->err = ring->stop = 0;
+    ring->used = 0;
+    ring->done = 0;
+    ring->fd = state->fd;
+    ring->io = state->io;
+    state->at = gz_seek_io(state, 0, SEEK_CUR);
+    if (zmutex_init(&ring->lock) == 0) {
+        if (zcond_init(&ring->cond) == 0) {
+            if (zthread_start(&ring->thread, gz_ahead_run, ring) == 0) {
+                state->ring = ring;
+                return;
+            }
+            zcond_free(&ring->cond);
+        }
+        zmutex_free(&ring->lock);
+    }
+    gz_free(state, ring->buf);
+    free(ring->len);
+    free(ring);
+    state->ahead = 0;
+}
+
+/* Release the tail buffer if it has all been taken, and wait for data in the
+   next one. Set *next and *have to the data not yet taken, with *have zero at
+   the end of the file. Return -1 on a read error, otherwise 0. */
+local int gz_ahead_next(gz_statep state, unsigned char **next,
+                        unsigned *have) {
+    struct gz_ahead_s *ring = state->ring;
+    int err;
+
+    zmutex_lock(&ring->lock);
+    if (ring->done) {
+        ring->tail++;
+        ring->used = 0;
+        ring->done = 0;
+        zcond_broadcast(&ring->cond);
+    }
+    while (ring->head == ring->tail && !ring->end && !ring->err)
+        zcond_wait(&ring->cond, &ring->lock);
+    if (ring->head == ring->tail) {
+        err = ring->err;
+        zmutex_unlock(&ring->lock);
+        *have = 0;
+        if (err) {
+            errno = err;
+            gz_error(state, Z_ERRNO, zstrerror());
+            return -1;
+        }
+        return 0;
+    }
+    zmutex_unlock(&ring->lock);
+    *next = ring->buf + (size_t)(ring->tail % ring->count) * ring->size +
+            ring->used;
+    *have = ring->len[ring->tail % ring->count] - ring->used;
+    return 0;
+}
+
+/* Mark n bytes of the tail buffer as taken. The buffer is released on the next
+   gz_ahead_next() once it has all been taken, since the data may still be in
+   use until then. */
+local void gz_ahead_take(gz_statep state, unsigned n) {
+    struct gz_ahead_s *ring = state->ring;
+
+    ring->used += n;
+    state->at += n;
+    if (ring->used == ring->len[ring->tail % ring->count])
+        ring->done = 1;
+}
+
+#endif
+
+/* Stop the read-ahead thread if it is running, and free its buffers. The file
+   position is set back to just after the data that has been consumed, and any
+   input that inflate has not used yet is dropped to be read again, so this
+   may only be used when that input is not needed or will be rewound. Return
+   -1 on error, otherwise 0. */
+int ZLIB_INTERNAL gz_ahead_stop(gz_statep state) {
+#ifdef HAVE_THREADS
+    struct gz_ahead_s *ring = state->ring;
+
+    if (ring == NULL)
+        return 0;
+    zmutex_lock(&ring->lock);
+    ring->stop = 1;
+    zcond_broadcast(&ring->cond);
+    zmutex_unlock(&ring->lock);
+    zthread_join(ring->thread);
+    zcond_free(&ring->cond);
+    zmutex_free(&ring->lock);
+    gz_free(state, ring->buf);
+    free(ring->len);
+    free(ring);
+    state->ring = NULL;
+    state->at -= state->strm.avail_in;
+    state->strm.avail_in = 0;
+    if (gz_seek_io(state, state->at, SEEK_SET) == -1)
+        return -1;
+#else
+    (void)state;
+#endif
+    return 0;
+}
 
 /* Use read() to load a buffer -- return -1 on error, otherwise 0.  Read from
    state->fd, and update state->eof, state->err, and state->msg as appropriate.
@@ -15,11 +207,42 @@ local int gz_load(gz_statep state, unsigned char *buf, unsigned len,
     unsigned get, max = ((unsigned)-1 >> 2) + 1;
 
     *have = 0;
+#ifdef HAVE_THREADS
+    gz_ahead_start(state);
+    if (state->ring != NULL) {      /* copy from the read-ahead buffers */
+        unsigned char *next;
+
+        while (*have < len) {
+            if (gz_ahead_next(state, &next, &get) == -1)
+                return -1;
+            if (get == 0) {
+                state->eof = 1;
+                break;
+            }
+            if (get > len - *have)
+                get = len - *have;
+            memcpy(buf + *have, next, get);
+            gz_ahead_take(state, get);
+            *have += get;
+        }
+        return 0;
+    }
+#endif
+    if (state->map != NULL) {       /* copy from the memory-mapped file */
+        if ((z_off64_t)len > state->mapped - state->mnext)
+            len = (unsigned)(state->mapped - state->mnext);
+        memcpy(buf, state->map + state->mnext, len);
+        state->mnext += len;
+        *have = len;
+        if (state->mnext == state->mapped)
+            state->eof = 1;
+        return 0;
+    }
     do {
         get = len - *have;
         if (get > max)
             get = max;
-        ret = read(state->fd, buf + *have, get);
+        ret = gz_read_io(state, buf + *have, get);
         if (ret <= 0)
             break;
         *have += (unsigned)ret;
@@ -39,14 +262,47 @@ local int gz_load(gz_statep state, unsigned char *buf, unsigned len,
    that data has been used, no more attempts will be made to read the file.
    If strm->avail_in != 0, then the current data is moved to the beginning of
    the input buffer, and then the remainder of the buffer is loaded with the
-   available data from the input file. */
+   available data from the input file.  If the file is memory mapped, then
+   next_in points into the map instead, and up to a buffer's worth of data is
+   made available, with no copy. */
 local int gz_avail(gz_statep state) {
     unsigned got;
     z_streamp strm = &(state->strm);
 
     if (state->err != Z_OK && state->err != Z_BUF_ERROR)
         return -1;
-    if (state->eof == 0) {
+#ifdef HAVE_THREADS
+    if (state->eof == 0)
+        gz_ahead_start(state);
+#endif
+    if (state->eof == 0 && state->map != NULL) {
+        if (strm->avail_in == 0)
+            strm->next_in = state->map + state->mnext;
+        got = state->size - strm->avail_in;
+        if ((z_off64_t)got > state->mapped - state->mnext)
+            got = (unsigned)(state->mapped - state->mnext);
+        strm->avail_in += got;
+        state->mnext += got;
+        if (state->mnext == state->mapped)
+            state->eof = 1;
+    }
+#ifdef HAVE_THREADS
+    else if (state->eof == 0 && state->ring != NULL && strm->avail_in == 0) {
+        unsigned char *next;
+
+        /* point at the next read-ahead buffer, with no copy */
+        if (gz_ahead_next(state, &next, &got) == -1)
+            return -1;
+        if (got == 0)
+            state->eof = 1;
+        else {
+            gz_ahead_take(state, got);
+            strm->next_in = next;
+            strm->avail_in = got;
+        }
+    }
+#endif
+    else if (state->eof == 0) {
         if (strm->avail_in) {       /* copy what's there to the start */
             unsigned char *p = state->in;
             unsigned const char *q = strm->next_in;
@@ -64,6 +320,24 @@ local int gz_avail(gz_statep state) {
     return 0;
 }
 
+/* Return the buffer size to use for reading if none was requested: GZBUFSIZE,
+   doubled for every 64 times that in the rest of the file, up to GZBUFMAX.
+   If the length of the file can't be found, as for a pipe, use GZBUFSIZE. */
+local unsigned gz_want(gz_statep state) {
+    unsigned want = GZBUFSIZE;
+    z_off64_t here, end;
+
+    here = gz_seek_io(state, 0, SEEK_CUR);
+    if (here == -1)
+        return want;
+    end = gz_seek_io(state, 0, SEEK_END);
+    if (gz_seek_io(state, here, SEEK_SET) == -1 || end == -1)
+        return want;
+    while (want < GZBUFMAX && end - here >= (z_off64_t)want << 6)
+        want <<= 1;
+    return want;
+}
+
 /* Look for gzip header, set up for inflate or copy.  state->x.have must be 0.
    If this is the first time in, allocate required memory.  state->how will be
    left unchanged if there is no more input data available, will be set to COPY
@@ -78,36 +352,72 @@ local int gz_look(gz_statep state) {
 
     /* allocate read buffers and inflate memory */
     if (state->size == 0) {
+        int ret;
+
         /* allocate buffers */
-        state->in = (unsigned char *)malloc(state->want);
-        state->out = (unsigned char *)malloc(state->want << 1);
+        if (state->want == 0)
+            state->want = gz_want(state);
+        state->in = (unsigned char *)gz_malloc(state, state->want);
+        state->out = (unsigned char *)gz_malloc(state,
+                                                (size_t)state->want << 1);
         if (state->in == NULL || state->out == NULL) {
-            free(state->out);
-            free(state->in);
+            gz_free(state, state->out);
+            gz_free(state, state->in);
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
         state->size = state->want;
 
-        /* allocate inflate memory */
+        /* allocate inflate memory, in one aligned block if requested */
         state->strm.zalloc = Z_NULL;
         state->strm.zfree = Z_NULL;
         state->strm.opaque = Z_NULL;
         state->strm.avail_in = 0;
         state->strm.next_in = Z_NULL;
-        if (inflateInit2(&(state->strm), 15 + 16) != Z_OK) {    /* gunzip */
-            free(state->out);
-            free(state->in);
+        if (state->align > 1 || state->huge) {
+            uLong len = inflateStateSize(15 + 16);
+
+            state->mem = gz_malloc(state, len);
+            ret = state->mem == NULL ? Z_MEM_ERROR :
+                  inflateInitMem(&(state->strm), 15 + 16, state->mem, len);
+        }
+        else
+            ret = inflateInit2(&(state->strm), 15 + 16);        /* gunzip */
+        if (ret != Z_OK) {
+            gz_free(state, state->mem);
+            state->mem = NULL;
+            gz_free(state, state->out);
+            gz_free(state, state->in);
             state->size = 0;
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
     }
 
-    /* get at least the magic bytes in the input buffer */
+    /* skip the trailer of a gzip stream decompressed from an access point */
+    while (state->trail) {
+        unsigned n;
+
+        if (strm->avail_in == 0) {
+            if (gz_avail(state) == -1)
+                return -1;
+            if (strm->avail_in == 0)
+                return 0;
+        }
+        n = strm->avail_in < state->trail ? strm->avail_in : state->trail;
+        strm->next_in += n;
+        strm->avail_in -= n;
+        state->trail -= n;
+    }
+
+    /* get at least the magic bytes in the input buffer -- a read-ahead
+       buffer can hold just one byte, in which case it is copied to the input
+       buffer and filled from there */
     if (strm->avail_in < 2) {
         if (gz_avail(state) == -1)
             return -1;
+        if (strm->avail_in == 1 && state->eof == 0 && gz_avail(state) == -1)
+            return -1;
         if (strm->avail_in == 0)
             return 0;
     }
@@ -121,7 +431,13 @@ local int gz_look(gz_statep state) {
        single byte is sufficient indication that it is not a gzip file) */
     if (strm->avail_in > 1 &&
             strm->next_in[0] == 31 && strm->next_in[1] == 139) {
-        inflateReset(strm);
+        if (state->restored) {
+            /* inflateRestore() left inflate decoding raw deflate data */
+            inflateReset2(strm, 15 + 16);
+            state->restored = 0;
+        }
+        else
+            inflateReset(strm);
         state->how = GZIP;
         state->direct = 0;
         return 0;
@@ -148,6 +464,143 @@ local int gz_look(gz_statep state) {
     return 0;
 }
 
+/* Access points for seeking, saved while decompressing. list[0..have-1] are in
+   order of increasing offsets, each about span bytes of uncompressed data
+   after the one before. The first saved of them were loaded from path. */
+#define GZ_CKPT 32792       /* largest inflateCheckpoint() */
+
+struct gz_point_s {
+    z_off64_t out;          /* uncompressed offset, as for gztell() */
+    z_off64_t in;           /* compressed offset, as for gzoffset() */
+    unsigned len;           /* length of the checkpoint */
+    unsigned clen;          /* length of the compressed checkpoint */
+    unsigned char *ckpt;    /* checkpoint compressed with compress2() */
+};
+
+struct gz_index_s {
+    z_off64_t span;         /* uncompressed data between access points */
+    z_off64_t length;       /* length of the file, to check a sidecar */
+    unsigned have;          /* number of access points */
+    unsigned size;          /* number of access points allocated in list */
+    unsigned saved;         /* number of access points loaded from path */
+    struct gz_point_s *list;    /* the access points */
+    unsigned char *buf;     /* GZ_CKPT bytes for a checkpoint */
+    char *path;             /* sidecar file, or NULL */
+};
+
+/* Save an access point if inflate() is at the start of a block that is at
+   least span bytes after the last access point, where produced is how much has
+   been decompressed since x.pos. Return -1 on a memory allocation failure,
+   otherwise 0. */
+local int gz_index_add(gz_statep state, unsigned produced) {
+    struct gz_index_s *index = state->index;
+    z_streamp strm = &(state->strm);
+    struct gz_point_s *point;
+    z_off64_t out = state->x.pos + produced, in;
+    uLong len, clen;
+
+    if ((strm->data_type & 0xc0) != 0x80 ||
+        out < (index->have ? index->list[index->have - 1].out : 0) +
+              index->span)
+        return 0;
+    in = gzoffset64((gzFile)state);
+    len = GZ_CKPT;
+    if (in == -1 || inflateCheckpoint(strm, index->buf, &len) != Z_OK)
+        return 0;
+    if (index->have == index->size) {
+        unsigned size = index->size ? index->size << 1 : 64;
+
+        point = size < index->size ? NULL : (struct gz_point_s *)
+                realloc(index->list, size * sizeof(struct gz_point_s));
+        if (point == NULL) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
+        index->list = point;
+        index->size = size;
+    }
+    point = index->list + index->have;
+    clen = compressBound(len);
+    point->ckpt = (unsigned char *)malloc(clen);
+    if (point->ckpt == NULL ||
+        compress2(point->ckpt, &clen, index->buf, len, 1) != Z_OK) {
+        free(point->ckpt);
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    point->out = out;
+    point->in = in;
+    point->len = (unsigned)len;
+    point->clen = (unsigned)clen;
+    index->have++;
+    return 0;
+}
+
+/* On a seek of *offset from x.pos when reading, resume decompression from the
+   last access point at or before the destination, if that's ahead of the data
+   decompressed so far, or if the destination is behind x.pos. In that case,
+   update *offset to be relative to the access point. Return -1 on error,
+   otherwise 0. */
+int ZLIB_INTERNAL gz_index_seek(gz_statep state, z_off64_t *offset) {
+    struct gz_index_s *index = state->index;
+    struct gz_point_s *point;
+    z_off64_t pos = state->x.pos + *offset;
+    unsigned lo = 0, hi = index->have, mid;
+    uLong len;
+    int ret;
+
+    /* find the access point */
+    while (lo < hi) {
+        mid = lo + ((hi - lo) >> 1);
+        if (index->list[mid].out <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return 0;
+    point = index->list + lo - 1;
+    if (*offset >= 0 && point->out <= state->x.pos + state->x.have)
+        return 0;
+
+    /* set up inflate if there hasn't been any reading yet */
+    if (state->size == 0 && gz_look(state) == -1)
+        return -1;
+    if (state->direct)
+        return 0;
+
+    /* go to the access point */
+    len = point->len;
+    if (uncompress(index->buf, &len, point->ckpt, point->clen) != Z_OK ||
+            len != point->len) {
+        gz_error(state, Z_DATA_ERROR, "invalid access point");
+        return -1;
+    }
+    if (gz_ahead_stop(state) == -1)
+        return -1;
+    if (state->map != NULL)
+        state->mnext = point->in;
+    else if (gz_seek_io(state, point->in, SEEK_SET) == -1)
+        return -1;
+    ret = inflateRestore(&(state->strm), index->buf, len);
+    if (ret != Z_OK) {
+        gz_error(state, ret, ret == Z_MEM_ERROR ? "out of memory" :
+                             "invalid access point");
+        return -1;
+    }
+    state->x.have = 0;
+    state->eof = 0;
+    state->past = 0;
+    state->how = GZIP;
+    state->restored = 1;
+    state->trail = 0;
+    gz_error(state, Z_OK, NULL);
+    state->strm.avail_in = 0;
+    state->x.pos = point->out;
+    *offset = pos - point->out;
+    return 0;
+}
+
 /* Decompress from input to the provided next_out and avail_out in the state.
    On return, state->x.have and state->x.next point to the just decompressed
    data.  If the gzip stream completes, state->how is reset to LOOK to look for
@@ -169,8 +622,8 @@ local int gz_decomp(gz_statep state) {
             break;
         }
 
-        /* decompress and handle errors */
-        ret = inflate(strm, Z_NO_FLUSH);
+        /* decompress and handle errors -- stop at blocks for access points */
+        ret = inflate(strm, state->index != NULL ? Z_BLOCK : Z_NO_FLUSH);
         if (ret == Z_STREAM_ERROR || ret == Z_NEED_DICT) {
             gz_error(state, Z_STREAM_ERROR,
                      "internal error: inflate stream corrupt");
@@ -185,15 +638,22 @@ local int gz_decomp(gz_statep state) {
                      strm->msg == NULL ? "compressed data error" : strm->msg);
             return -1;
         }
+        if (state->index != NULL &&
+            gz_index_add(state, had - strm->avail_out) == -1)
+            return -1;
     } while (strm->avail_out && ret != Z_STREAM_END);
 
     /* update available output */
     state->x.have = had - strm->avail_out;
     state->x.next = strm->next_out - state->x.have;
 
-    /* if the gzip stream completed successfully, look for another */
-    if (ret == Z_STREAM_END)
+    /* if the gzip stream completed successfully, look for another -- from an
+       access point, inflate() stopped before the trailer */
+    if (ret == Z_STREAM_END) {
         state->how = LOOK;
+        if (state->restored)
+            state->trail = 8;
+    }
 
     /* good decompression */
     return 0;
@@ -556,6 +1016,335 @@ char * ZEXPORT gzgets(gzFile file, char *buf, int len) {
     return str;
 }
 
+/* -- see zlib.h -- */
+int ZEXPORT gzreadview(gzFile file, z_const unsigned char **buf,
+                       unsigned *len) {
+    gz_statep state;
+
+    /* check parameters and get internal structure */
+    if (file == NULL || buf == NULL || len == NULL)
+        return -1;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+        (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return -1;
+
+    /* process a skip request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_skip(state, state->skip) == -1)
+            return -1;
+    }
+
+    /* assure that something is in the output buffer, unless at end of file */
+    if (state->x.have == 0 && gz_fetch(state) == -1)
+        return -1;                      /* error */
+    if (state->x.have == 0)
+        state->past = 1;                /* end of file */
+
+    /* show the caller the buffered bytes in place */
+    *buf = state->x.next;
+    *len = state->x.have;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzconsume(gzFile file, unsigned len) {
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+        (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return -1;
+
+    /* can only consume what gzreadview() last showed */
+    if (state->seek || len > state->x.have) {
+        gz_error(state, Z_STREAM_ERROR, "consumed more than was viewed");
+        return -1;
+    }
+
+    /* move past the consumed bytes */
+    state->x.have -= len;
+    state->x.next += len;
+    state->x.pos += len;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzgetlines(gzFile file,
+                       int (*line)(void *, z_const char *, unsigned),
+                       void *ctx) {
+    int ret;
+    unsigned n, len = 0, size = 0;
+    char *part = NULL, *grow;
+    unsigned char *next, *eol;
+    gz_statep state;
+
+    /* check parameters and get internal structure */
+    if (file == NULL || line == NULL)
+        return -1;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+        (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return -1;
+
+    /* process a skip request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_skip(state, state->skip) == -1)
+            return -1;
+    }
+
+    /* deliver lines in place from the output buffer, assembling in part[]
+       only those that straddle the end of the buffer */
+    for (;;) {
+        /* assure that something is in the output buffer */
+        if (state->x.have == 0 && gz_fetch(state) == -1) {
+            ret = -1;                   /* error */
+            break;
+        }
+        if (state->x.have == 0) {       /* end of file */
+            state->past = 1;
+            ret = len && line(ctx, part, len) ? 1 : 0;
+            break;
+        }
+
+        /* find the end of the line, or take the whole buffer if none */
+        next = state->x.next;
+        eol = (unsigned char *)memchr(next, '\n', state->x.have);
+        n = eol == NULL ? state->x.have : (unsigned)(eol - next) + 1;
+        state->x.have -= n;
+        state->x.next += n;
+        state->x.pos += n;
+
+        /* a whole line in the buffer can be delivered where it is */
+        if (eol != NULL && len == 0) {
+            if (line(ctx, (char *)next, n)) {
+                ret = 1;
+                break;
+            }
+            continue;
+        }
+
+        /* append to the partial line, making room as needed */
+        if (n > size - len) {
+            if (n > (unsigned)-1 - len) {
+                gz_error(state, Z_MEM_ERROR, "out of memory");
+                ret = -1;
+                break;
+            }
+            size = len + n > (unsigned)-1 >> 1 ? (unsigned)-1 : (len + n) << 1;
+            grow = (char *)realloc(part, size);
+            if (grow == NULL) {
+                gz_error(state, Z_MEM_ERROR, "out of memory");
+                ret = -1;
+                break;
+            }
+            part = grow;
+        }
+        memcpy(part + len, next, n);
+        len += n;
+        if (eol != NULL) {
+            n = len;
+            len = 0;
+            if (line(ctx, part, n)) {
+                ret = 1;
+                break;
+            }
+        }
+    }
+    free(part);
+    return ret;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzreadahead(gzFile file, unsigned buffers) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ)
+        return -1;
+
+    /* make sure we haven't already started reading */
+    if (state->size != 0)
+        return -1;
+
+    /* set the number of buffers to read ahead into */
+    state->ahead = buffers;
+    return 0;
+}
+
+/* Read an n-byte little-endian integer from in to *val. Return -1 if it can't
+   be read or doesn't fit, otherwise 0. */
+local int gz_index_get(FILE *in, z_off64_t *val, int n) {
+    unsigned char buf[8];
+
+    if (fread(buf, 1, n, in) != (size_t)n)
+        return -1;
+    *val = 0;
+    while (n--) {
+        if (*val >> (sizeof(z_off64_t) * 8 - 9))
+            return -1;
+        *val = (*val << 8) + buf[n];
+    }
+    return 0;
+}
+
+/* Write val to out as an n-byte little-endian integer. Return -1 on error,
+   otherwise 0. */
+local int gz_index_put(FILE *out, z_off64_t val, int n) {
+    while (n--) {
+        if (putc((int)(val & 0xff), out) == EOF)
+            return -1;
+        val >>= 8;
+    }
+    return 0;
+}
+
+/* Free the access points in index. */
+local void gz_index_drop(struct gz_index_s *index) {
+    while (index->have)
+        free(index->list[--index->have].ckpt);
+    index->saved = 0;
+}
+
+/* Load the access points in the sidecar file at index->path, if it is there
+   and is for a file of length index->length. The sidecar is "gzix", then the
+   length of the file and the number of access points, followed by each access
+   point's uncompressed offset, compressed offset, checkpoint length, and
+   compressed checkpoint length and data, with the integers in little-endian
+   order in 8, 8, 8, 4, 4, and 4 bytes respectively. */
+local void gz_index_load(struct gz_index_s *index) {
+    FILE *in;
+    char magic[4];
+    z_off64_t length, count, len, clen;
+    struct gz_point_s *point;
+
+    in = fopen(index->path, "rb");
+    if (in == NULL)
+        return;
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "gzix", 4) ||
+        gz_index_get(in, &length, 8) || length != index->length ||
+        gz_index_get(in, &count, 4) || count == 0 ||
+        (size_t)count > (size_t)-1 / sizeof(struct gz_point_s) ||
+        (index->list = (struct gz_point_s *)
+                       malloc((size_t)count * sizeof(struct gz_point_s)))
+            == NULL) {
+        fclose(in);
+        return;
+    }
+    index->size = (unsigned)count;
+    while (index->have < count) {
+        point = index->list + index->have;
+        if (gz_index_get(in, &point->out, 8) ||
+            gz_index_get(in, &point->in, 8) ||
+            gz_index_get(in, &len, 4) || gz_index_get(in, &clen, 4) ||
+            len < 24 || len > GZ_CKPT ||
+            clen > (z_off64_t)compressBound((uLong)len) ||
+            point->in >= length || (index->have &&
+             (point->out <= point[-1].out || point->in <= point[-1].in)) ||
+            (point->ckpt = (unsigned char *)malloc((size_t)clen)) == NULL)
+            break;
+        point->len = (unsigned)len;
+        point->clen = (unsigned)clen;
+        index->have++;
+        if (fread(point->ckpt, 1, point->clen, in) != point->clen)
+            break;
+    }
+    if (index->have < count || getc(in) != EOF)
+        gz_index_drop(index);
+    index->saved = index->have;
+    fclose(in);
+}
+
+/* Write the access points to the sidecar file at index->path. Return -1 on
+   error, otherwise 0. */
+local int gz_index_save(struct gz_index_s *index) {
+    FILE *out;
+    struct gz_point_s *point;
+    int ret;
+
+    out = fopen(index->path, "wb");
+    if (out == NULL)
+        return -1;
+    ret = fwrite("gzix", 1, 4, out) != 4 ||
+          gz_index_put(out, index->length, 8) ||
+          gz_index_put(out, index->have, 4);
+    for (point = index->list; !ret && point < index->list + index->have;
+         point++)
+        ret = gz_index_put(out, point->out, 8) ||
+              gz_index_put(out, point->in, 8) ||
+              gz_index_put(out, point->len, 4) ||
+              gz_index_put(out, point->clen, 4) ||
+              fwrite(point->ckpt, 1, point->clen, out) != point->clen;
+    if (fclose(out) == EOF)
+        ret = 1;
+    return ret ? -1 : 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzindex(gzFile file, unsigned long span, const char *path) {
+    gz_statep state;
+    struct gz_index_s *index;
+    z_off64_t at;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ)
+        return -1;
+
+    /* make sure we haven't already started reading */
+    if (state->size != 0 || state->index != NULL)
+        return -1;
+
+    /* get the length of the file, which must be seekable */
+    index = (struct gz_index_s *)malloc(sizeof(struct gz_index_s));
+    if (index == NULL)
+        return -1;
+    if (state->map != NULL)
+        index->length = state->mapped;
+    else if ((at = gz_seek_io(state, 0, SEEK_CUR)) == -1 ||
+             (index->length = gz_seek_io(state, 0, SEEK_END)) == -1 ||
+             gz_seek_io(state, at, SEEK_SET) == -1) {
+        free(index);
+        return -1;
+    }
+
+    /* set up the index, loading it from the sidecar if there is one */
+    index->span = span ? (z_off64_t)span : 1048576;
+    index->have = index->size = index->saved = 0;
+    index->list = NULL;
+    index->buf = (unsigned char *)malloc(GZ_CKPT);
+    index->path = NULL;
+    if (path != NULL &&
+        (index->path = (char *)malloc(strlen(path) + 1)) != NULL)
+        strcpy(index->path, path);
+    if (index->buf == NULL || (path != NULL && index->path == NULL)) {
+        free(index->path);
+        free(index->buf);
+        free(index);
+        return -1;
+    }
+    if (index->path != NULL)
+        gz_index_load(index);
+    state->index = index;
+    return 0;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzdirect(gzFile file) {
     gz_statep state;
@@ -589,15 +1378,35 @@ int ZEXPORT gzclose_r(gzFile file) {
         return Z_STREAM_ERROR;
 
     /* free memory and close file */
+    gz_ahead_stop(state);
     if (state->size) {
         inflateEnd(&(state->strm));
-        free(state->out);
-        free(state->in);
+        gz_free(state, state->mem);
+        gz_free(state, state->out);
+        gz_free(state, state->in);
     }
+#ifdef GZ_MMAP
+    if (state->map != NULL)
+        munmap(state->map, (size_t)state->mapped);
+#endif
     err = state->err == Z_BUF_ERROR ? Z_BUF_ERROR : Z_OK;
+
+    /* save any new access points, and free them */
+    if (state->index != NULL) {
+        struct gz_index_s *index = state->index;
+
+        if (index->path != NULL && index->have > index->saved &&
+                gz_index_save(index) == -1)
+            err = Z_ERRNO;
+        gz_index_drop(index);
+        free(index->list);
+        free(index->path);
+        free(index->buf);
+        free(index);
+    }
     gz_error(state, Z_OK, NULL);
     free(state->path);
-    ret = close(state->fd);
+    ret = gz_close_io(state);
     free(state);
     return ret ? Z_ERRNO : err;
 }
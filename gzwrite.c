@@ -4,6 +4,291 @@
  */
 
 #include "gzguts.h"
+#include "zthread.h"
+
+/* Initialize state->strm for gzip compression with the level, strategy, and
+   number of threads in state. The memory is one block from gz_malloc() if an
+   alignment or huge pages were requested, with room for all of the levels.
+   Return the deflateInit2(), deflateInitMem(), or deflateParallelInit2()
+   result. */
+local int gz_deflate_init(gz_statep state) {
+    z_streamp strm = &(state->strm);
+    uLong len;
+    int ret;
+
+    strm->zalloc = Z_NULL;
+    strm->zfree = Z_NULL;
+    strm->opaque = Z_NULL;
+    if (state->threads > 1)
+        return deflateParallelInit2(strm, state->level, MAX_WBITS + 16,
+                                    DEF_MEM_LEVEL, state->strategy,
+                                    state->threads, 0);
+    if (state->align <= 1 && !state->huge)
+        return deflateInit2(strm, state->level, Z_DEFLATED, MAX_WBITS + 16,
+                            DEF_MEM_LEVEL, state->strategy);
+    len = deflateStateSize(12, MAX_WBITS + 16, DEF_MEM_LEVEL, state->strategy);
+    if (len == 0)
+        return Z_STREAM_ERROR;
+    state->mem = gz_malloc(state, len);
+    if (state->mem == NULL)
+        return Z_MEM_ERROR;
+    ret = deflateInitMem(strm, state->level, MAX_WBITS + 16, DEF_MEM_LEVEL,
+                         state->strategy, state->mem, len);
+    if (ret != Z_OK) {
+        gz_free(state, state->mem);
+        state->mem = NULL;
+    }
+    return ret;
+}
+
+/* Free the deflate state initialized by gz_deflate_init(). */
+local void gz_deflate_end(gz_statep state) {
+    if (state->threads > 1)
+        (void)deflateParallelEnd(&(state->strm));
+    else
+        (void)deflateEnd(&(state->strm));
+    gz_free(state, state->mem);
+    state->mem = NULL;
+}
+
+#ifdef HAVE_THREADS
+
+local int gz_comp(gz_statep state, int flush);
+
+/* Ring of input buffers compressed and written by a separate thread, so that
+   the writing functions can return once the data is copied. The caller fills
+   buffer head % count when head - tail < count, along with the deflate() flush
+   to follow it, and the thread compresses the data in buffer tail % count
+   with its own state, work, releasing it by incrementing tail. */
+struct gz_behind_s {
+        /* shared, protected by lock */
+    zmutex lock;            /* mutex for the following */
+    zcond cond;             /* signaled when a buffer is filled or released */
+    unsigned head;          /* number of buffers filled */
+    unsigned tail;          /* number of buffers released */
+    int err;                /* deferred error from the thread, or Z_OK */
+    char *msg;              /* deferred error message, or NULL */
+    int stop;               /* true to tell the thread to return */
+        /* set before the thread is started */
+    unsigned count;         /* number of buffers */
+    unsigned size;          /* size of each buffer */
+    unsigned *len;          /* bytes in each filled buffer */
+    int *flush;             /* deflate() flush after each filled buffer */
+    unsigned char *buf;     /* count buffers of size bytes */
+    gz_state work;          /* output and deflate state for the thread */
+    zthread thread;         /* the compression thread */
+};
+
+/* Compression thread. Once there is an error, buffers are released without
+   being compressed until the caller has picked up the error, since the caller
+   would not have provided them had it known. */
+local void gz_behind_run(void *arg) {
+    struct gz_behind_s *ring = (struct gz_behind_s *)arg;
+    gz_statep work = &ring->work;
+    unsigned k;
+    int ok, ret;
+
+    zmutex_lock(&ring->lock);
+    for (;;) {
+        while (!ring->stop && ring->head == ring->tail)
+            zcond_wait(&ring->cond, &ring->lock);
+        if (ring->head == ring->tail)
+            break;
+        k = ring->tail % ring->count;
+        ok = ring->err == Z_OK;
+        zmutex_unlock(&ring->lock);
+        ret = 0;
+        if (ok) {
+            work->strm.next_in = ring->buf + (size_t)k * ring->size;
+            work->strm.avail_in = ring->len[k];
+            ret = gz_comp(work, ring->flush[k]);
+        }
+        zmutex_lock(&ring->lock);
+        if (ret == -1) {
+            /* hand the error to the caller */
+            ring->err = work->err;
+            ring->msg = work->msg;
+            work->err = Z_OK;
+            work->msg = NULL;
+        }
+        ring->tail++;
+        zcond_broadcast(&ring->cond);
+    }
+    zmutex_unlock(&ring->lock);
+}
+
+/* Free the buffers and deflate state of ring, and ring itself. */
+local void gz_behind_free(struct gz_behind_s *ring) {
+    if (ring->work.out != NULL) {
+        gz_deflate_end(&ring->work);
+        gz_free(&ring->work, ring->work.out);
+    }
+    if (ring->msg != NULL && ring->err != Z_MEM_ERROR)
+        free(ring->msg);
+    gz_free(&ring->work, ring->buf);
+    free(ring->flush);
+    free(ring->len);
+    free(ring);
+}
+
+/* Start the compression thread for state, if requested. If it can't be
+   started, give up on it and compress in the calling thread. */
+local void gz_behind_start(gz_statep state) {
+    struct gz_behind_s *ring;
+    gz_statep work;
+    int ok;
+
+    if (state->ahead == 0)
+        return;
+    ring = (struct gz_behind_s *)malloc(sizeof(struct gz_behind_s));
+    if (ring == NULL) {
+        state->ahead = 0;
+        return;
+    }
+    ring->count = state->ahead;
+    ring->size = state->want;
+    ring->len = (unsigned *)malloc(ring->count * sizeof(unsigned));
+    ring->flush = (int *)malloc(ring->count * sizeof(int));
+    ring->buf = (unsigned char *)gz_malloc(state,
+                                           (size_t)ring->count * ring->size);
+    ring->err = Z_OK;
+    ring->msg = NULL;
+    work = &ring->work;
+    work->align = state->align;
+    work->huge = state->huge;
+    work->mem = NULL;
+    work->fd = state->fd;
+    work->io = state->io;
+    work->path = state->path;
+    work->size = ring->size;
+    work->out = NULL;
+    work->direct = state->direct;
+    work->level = state->level;
+    work->strategy = state->strategy;
+    work->threads = state->threads;
+    work->reset = 0;
+    work->behind = NULL;
+    work->err = Z_OK;
+    work->msg = NULL;
+    ok = ring->len != NULL && ring->flush != NULL && ring->buf != NULL &&
+         (size_t)ring->count * ring->size / ring->size == ring->count;
+    if (ok && !work->direct) {
+        /* set up for gzip compression, as gz_init() does */
+        work->out = (unsigned char *)gz_malloc(work, ring->size);
+        if (work->out != NULL && gz_deflate_init(work) != Z_OK) {
+            gz_free(work, work->out);
+            work->out = NULL;
+        }
+        ok = work->out != NULL;
+        work->strm.avail_out = ring->size;
+        work->strm.next_out = work->out;
+        work->x.next = work->out;
+    }
+    if (ok) {
+        ring->head = ring->tail = 0;
+        ring->stop = 0;
+        if (zmutex_init(&ring->lock) == 0) {
+            if (zcond_init(&ring->cond) == 0) {
+                if (zthread_start(&ring->thread, gz_behind_run, ring) == 0) {
+                    state->behind = ring;
+                    return;
+                }
+                zcond_free(&ring->cond);
+            }
+            zmutex_free(&ring->lock);
+        }
+    }
+    gz_behind_free(ring);
+    state->ahead = 0;
+}
+
+/* Move a deferred error from the compression thread to state. The lock must
+   be held. Return -1 if there was an error, otherwise 0. */
+local int gz_behind_err(gz_statep state) {
+    struct gz_behind_s *ring = state->behind;
+
+    if (ring->err == Z_OK)
+        return 0;
+    gz_error(state, Z_OK, NULL);
+    state->err = ring->err;
+    state->msg = ring->msg;
+    ring->err = Z_OK;
+    ring->msg = NULL;
+    return -1;
+}
+
+/* Wait for the compression thread to finish with all of the buffers. Return
+   -1 if it had an error, otherwise 0. */
+local int gz_behind_wait(gz_statep state) {
+    struct gz_behind_s *ring = state->behind;
+    int ret;
+
+    zmutex_lock(&ring->lock);
+    while (ring->head != ring->tail)
+        zcond_wait(&ring->cond, &ring->lock);
+    ret = gz_behind_err(state);
+    zmutex_unlock(&ring->lock);
+    return ret;
+}
+
+/* Copy the input at next_in and avail_in to the ring for the compression
+   thread, consuming it, with flush after the last of it. If flush is not
+   Z_NO_FLUSH, then wait for the thread to complete it. Return -1 if the thread
+   had an error, otherwise 0. */
+local int gz_behind_put(gz_statep state, int flush) {
+    struct gz_behind_s *ring = state->behind;
+    z_streamp strm = &(state->strm);
+    unsigned k, n;
+    int ret;
+
+    zmutex_lock(&ring->lock);
+    if (strm->avail_in || flush != Z_NO_FLUSH)
+        do {
+            while (ring->head - ring->tail == ring->count)
+                zcond_wait(&ring->cond, &ring->lock);
+            zmutex_unlock(&ring->lock);
+            k = ring->head % ring->count;
+            n = strm->avail_in < ring->size ? strm->avail_in : ring->size;
+            if (n)
+                memcpy(ring->buf + (size_t)k * ring->size, strm->next_in, n);
+            strm->next_in += n;
+            strm->avail_in -= n;
+            ring->len[k] = n;
+            ring->flush[k] = strm->avail_in ? Z_NO_FLUSH : flush;
+            zmutex_lock(&ring->lock);
+            ring->head++;
+            zcond_broadcast(&ring->cond);
+        } while (strm->avail_in);
+    ret = gz_behind_err(state);
+    zmutex_unlock(&ring->lock);
+    if (ret == 0 && flush != Z_NO_FLUSH)
+        ret = gz_behind_wait(state);
+    return ret;
+}
+
+#endif
+
+/* Stop the compression thread if it is running, after it has compressed any
+   input given to it, and free its buffers and deflate state. */
+local void gz_behind_stop(gz_statep state) {
+#ifdef HAVE_THREADS
+    struct gz_behind_s *ring = state->behind;
+
+    if (ring == NULL)
+        return;
+    zmutex_lock(&ring->lock);
+    ring->stop = 1;
+    zcond_broadcast(&ring->cond);
+    zmutex_unlock(&ring->lock);
+    zthread_join(ring->thread);
+    zcond_free(&ring->cond);
+    zmutex_free(&ring->lock);
+    gz_behind_free(ring);
+    state->behind = NULL;
+#else
+    (void)state;
+#endif
+}
 
 /* Initialize state for writing a gzip file.  Mark initialization by setting
    state->size to non-zero.  Return -1 on a memory allocation failure, or 0 on
@@ -13,31 +298,38 @@ local int gz_init(gz_statep state) {
     z_streamp strm = &(state->strm);
 
     /* allocate input buffer (double size for gzprintf) */
-    state->in = (unsigned char *)malloc(state->want << 1);
+    if (state->want == 0)
+        state->want = GZBUFSIZE;
+    state->in = (unsigned char *)gz_malloc(state, (size_t)state->want << 1);
     if (state->in == NULL) {
         gz_error(state, Z_MEM_ERROR, "out of memory");
         return -1;
     }
 
+#ifdef HAVE_THREADS
+    /* leave the compressing to a separate thread if requested */
+    gz_behind_start(state);
+    if (state->behind != NULL) {
+        state->size = state->want;
+        return 0;
+    }
+#endif
+
     /* only need output buffer and deflate state if compressing */
     if (!state->direct) {
         /* allocate output buffer */
-        state->out = (unsigned char *)malloc(state->want);
+        state->out = (unsigned char *)gz_malloc(state, state->want);
         if (state->out == NULL) {
-            free(state->in);
+            gz_free(state, state->in);
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
 
         /* allocate deflate memory, set up for gzip compression */
-        strm->zalloc = Z_NULL;
-        strm->zfree = Z_NULL;
-        strm->opaque = Z_NULL;
-        ret = deflateInit2(strm, state->level, Z_DEFLATED,
-                           MAX_WBITS + 16, DEF_MEM_LEVEL, state->strategy);
+        ret = gz_deflate_init(state);
         if (ret != Z_OK) {
-            free(state->out);
-            free(state->in);
+            gz_free(state, state->out);
+            gz_free(state, state->in);
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
@@ -71,11 +363,17 @@ local int gz_comp(gz_statep state, int flush) {
     if (state->size == 0 && gz_init(state) == -1)
         return -1;
 
+#ifdef HAVE_THREADS
+    /* pass the input to the compression thread if there is one */
+    if (state->behind != NULL)
+        return gz_behind_put(state, flush);
+#endif
+
     /* write directly if requested */
     if (state->direct) {
         while (strm->avail_in) {
             put = strm->avail_in > max ? max : strm->avail_in;
-            writ = write(state->fd, strm->next_in, put);
+            writ = gz_write_io(state, strm->next_in, put);
             if (writ < 0) {
                 gz_error(state, Z_ERRNO, zstrerror());
                 return -1;
@@ -91,7 +389,16 @@ local int gz_comp(gz_statep state, int flush) {
         /* don't start a new gzip member unless there is data to write */
         if (strm->avail_in == 0)
             return 0;
-        deflateReset(strm);
+        if (state->threads > 1) {
+            /* a parallel stream can't be reset, so start a new one */
+            gz_deflate_end(state);
+            if (gz_deflate_init(state) != Z_OK) {
+                gz_error(state, Z_MEM_ERROR, "out of memory");
+                return -1;
+            }
+        }
+        else
+            deflateReset(strm);
         state->reset = 0;
     }
 
@@ -105,7 +412,7 @@ local int gz_comp(gz_statep state, int flush) {
             while (strm->next_out > state->x.next) {
                 put = strm->next_out - state->x.next > (int)max ? max :
                       (unsigned)(strm->next_out - state->x.next);
-                writ = write(state->fd, state->x.next, put);
+                writ = gz_write_io(state, state->x.next, put);
                 if (writ < 0) {
                     gz_error(state, Z_ERRNO, zstrerror());
                     return -1;
@@ -121,12 +428,17 @@ local int gz_comp(gz_statep state, int flush) {
 
         /* compress */
         have = strm->avail_out;
-        ret = deflate(strm, flush);
+        ret = state->threads > 1 ? deflateParallel(strm, flush) :
+                                   deflate(strm, flush);
         if (ret == Z_STREAM_ERROR) {
             gz_error(state, Z_STREAM_ERROR,
                       "internal error: deflate stream corrupt");
             return -1;
         }
+        if (ret == Z_MEM_ERROR) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
         have -= strm->avail_out;
     } while (have);
 
@@ -233,6 +545,66 @@ local z_size_t gz_write(gz_statep state, voidpc buf, z_size_t len) {
     return put;
 }
 
+#ifdef GZ_WRITEV
+/* Write the n pieces in iov directly to the file with writev(), for
+   transparent writing. Return -1 on error, otherwise 0. */
+local int gz_writev(gz_statep state, const gz_iovec *iov, int n) {
+    struct iovec vec[16];
+    int k = 0, m, j;
+    z_size_t off = 0, o, len, sum;
+    ssize_t writ;
+    z_size_t max = ((unsigned)-1 >> 2) + 1;
+
+    /* write what's left in the input buffer first */
+    if (state->strm.avail_in && gz_comp(state, Z_NO_FLUSH) == -1)
+        return -1;
+
+    while (k < n) {
+        /* gather up to 16 pieces, or max bytes, starting at iov[k] + off */
+        m = 0;
+        sum = 0;
+        j = k;
+        o = off;
+        while (j < n && m < 16 && sum < max) {
+            len = iov[j].len - o;
+            if (len > max - sum)
+                len = max - sum;
+            if (len) {
+                vec[m].iov_base = (char *)iov[j].base + o;
+                vec[m].iov_len = (size_t)len;
+                m++;
+                sum += len;
+            }
+            if (o + len < iov[j].len)
+                break;
+            j++;
+            o = 0;
+        }
+        if (m == 0)
+            break;
+
+        /* write them, and move past what was written */
+        writ = writev(state->fd, vec, m);
+        if (writ < 0) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            return -1;
+        }
+        state->x.pos += writ;
+        while (writ) {
+            len = iov[k].len - off;
+            if ((z_size_t)writ < len) {
+                off += (z_size_t)writ;
+                break;
+            }
+            writ -= (ssize_t)len;
+            k++;
+            off = 0;
+        }
+    }
+    return 0;
+}
+#endif
+
 /* -- see zlib.h -- */
 int ZEXPORT gzwrite(gzFile file, voidpc buf, unsigned len) {
     gz_statep state;
@@ -283,6 +655,61 @@ z_size_t ZEXPORT gzfwrite(voidpc buf, z_size_t size, z_size_t nitems,
     return len ? gz_write(state, buf, len) / size : 0;
 }
 
+/* -- see zlib.h -- */
+z_size_t ZEXPORT gzwritev(gzFile file, const gz_iovec *iov, int n) {
+    int k;
+    z_size_t len = 0;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return 0;
+    state = (gz_statep)file;
+
+    /* check that we're writing and that there's no error */
+    if (state->mode != GZ_WRITE || state->err != Z_OK)
+        return 0;
+
+    /* compute bytes to write -- error on overflow */
+    if (n < 0 || (n && iov == NULL)) {
+        gz_error(state, Z_STREAM_ERROR, "invalid iovec");
+        return 0;
+    }
+    for (k = 0; k < n; k++) {
+        if (iov[k].len > (z_size_t)-1 - len) {
+            gz_error(state, Z_STREAM_ERROR,
+                     "request does not fit in a size_t");
+            return 0;
+        }
+        len += iov[k].len;
+    }
+    if (len == 0)
+        return 0;
+
+#ifdef GZ_WRITEV
+    /* allocate memory if this is the first time through */
+    if (state->size == 0 && gz_init(state) == -1)
+        return 0;
+
+    /* write large requests together when transparent and in this thread */
+    if (state->direct && state->behind == NULL && state->io == NULL &&
+        len >= state->size) {
+        if (state->seek) {
+            state->seek = 0;
+            if (gz_zero(state, state->skip) == -1)
+                return 0;
+        }
+        return gz_writev(state, iov, n) == -1 ? 0 : len;
+    }
+#endif
+
+    /* otherwise write the pieces one at a time */
+    for (k = 0; k < n; k++)
+        if (gz_write(state, iov[k].base, iov[k].len) != iov[k].len)
+            return 0;
+    return len;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzputc(gzFile file, int c) {
     unsigned have;
@@ -524,6 +951,46 @@ int ZEXPORTVA gzprintf(gzFile file, const char *format, int a1, int a2, int a3,
 
 #endif
 
+/* -- see zlib.h -- */
+int ZEXPORT gzwritebehind(gzFile file, unsigned buffers) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already started writing */
+    if (state->size != 0)
+        return -1;
+
+    /* set the number of buffers to queue for the compression thread */
+    state->ahead = buffers;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzsetthreads(gzFile file, int threads) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_WRITE || threads < 1)
+        return -1;
+
+    /* make sure we haven't already started writing */
+    if (state->size != 0)
+        return -1;
+
+    /* set the number of threads for deflateParallel() */
+    state->threads = threads;
+    return 0;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzflush(gzFile file, int flush) {
     gz_statep state;
@@ -581,10 +1048,25 @@ int ZEXPORT gzsetparams(gzFile file, int level, int strategy) {
 
     /* change compression parameters for subsequent input */
     if (state->size) {
-        /* flush previous input with previous parameters before changing */
-        if (strm->avail_in && gz_comp(state, Z_BLOCK) == -1)
+        /* flush previous input with previous parameters before changing --
+           a parallel stream must have written all of it */
+        if ((strm->avail_in || state->threads > 1) &&
+            gz_comp(state, Z_BLOCK) == -1)
             return state->err;
-        deflateParams(strm, level, strategy);
+#ifdef HAVE_THREADS
+        if (state->behind != NULL) {
+            /* the thread is idle once it is done with the input */
+            if (gz_behind_wait(state) == -1)
+                return state->err;
+            state->behind->work.level = level;
+            state->behind->work.strategy = strategy;
+            strm = &(state->behind->work.strm);
+        }
+#endif
+        if (state->threads > 1)
+            deflateParallelParams(strm, level, strategy);
+        else
+            deflateParams(strm, level, strategy);
     }
     state->level = level;
     state->strategy = strategy;
@@ -616,15 +1098,17 @@ int ZEXPORT gzclose_w(gzFile file) {
     if (gz_comp(state, Z_FINISH) == -1)
         ret = state->err;
     if (state->size) {
-        if (!state->direct) {
-            (void)deflateEnd(&(state->strm));
-            free(state->out);
+        if (state->behind != NULL)
+            gz_behind_stop(state);
+        else if (!state->direct) {
+            gz_deflate_end(state);
+            gz_free(state, state->out);
         }
-        free(state->in);
+        gz_free(state, state->in);
     }
     gz_error(state, Z_OK, NULL);
     free(state->path);
-    if (close(state->fd) == -1)
+    if (gz_close_io(state) == -1)
         ret = Z_ERRNO;
     free(state);
     return ret;
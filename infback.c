@@ -20,16 +20,30 @@
    Z_NULL to use the library memory allocation functions.
 
    windowBits is in the range 8..15, and window is a user-supplied
-   window and output buffer that is 2**windowBits bytes.
+   window and output buffer that is 2**windowBits bytes.  16 can be added to
+   windowBits to decode a gzip stream, or 32 to decode a zlib or gzip stream,
+   with the header and trailer processed and the check value verified.
  */
 int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
                              unsigned char FAR *window, const char *version,
                              int stream_size) {
     struct inflate_state FAR *state;
+    int wrap;
 
     if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
         stream_size != (int)(sizeof(z_stream)))
         return Z_VERSION_ERROR;
+    wrap = 0;
+#ifdef GUNZIP
+    if (windowBits > 31) {
+        wrap = 3 | 4;
+        windowBits -= 32;
+    }
+    else if (windowBits > 15) {
+        wrap = 2 | 4;
+        windowBits -= 16;
+    }
+#endif
     if (strm == Z_NULL || window == Z_NULL ||
         windowBits < 8 || windowBits > 15)
         return Z_STREAM_ERROR;
@@ -54,12 +68,17 @@ int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
     Tracev((stderr, "inflate: allocated\n"));
     strm->state = (struct internal_state FAR *)state;
     state->dmax = 32768U;
+    state->wrap = wrap;
+    state->head = Z_NULL;
     state->wbits = (uInt)windowBits;
     state->wsize = 1U << windowBits;
     state->window = window;
     state->wnext = 0;
     state->whave = 0;
+    state->dend = Z_NULL;
+    state->dsize = 0;
     state->sane = 1;
+    state->over = 0;        /* the output after a match is in the window */
     return Z_OK;
 }
 
@@ -114,8 +133,35 @@ local void fixedtables(struct inflate_state FAR *state) {
     state->distbits = 5;
 }
 
+/* check function to use adler32() for zlib or crc32() for gzip */
+#ifdef GUNZIP
+#  define UPDATE_CHECK(check, buf, len) \
+    (state->flags ? crc32(check, buf, len) : adler32(check, buf, len))
+#else
+#  define UPDATE_CHECK(check, buf, len) adler32(check, buf, len)
+#endif
+
 /* Macros for inflateBack(): */
 
+/* check macros for header crc */
+#ifdef GUNZIP
+#  define CRC2(check, word) \
+    do { \
+        hbuf[0] = (unsigned char)(word); \
+        hbuf[1] = (unsigned char)((word) >> 8); \
+        check = crc32(check, hbuf, 2); \
+    } while (0)
+
+#  define CRC4(check, word) \
+    do { \
+        hbuf[0] = (unsigned char)(word); \
+        hbuf[1] = (unsigned char)((word) >> 8); \
+        hbuf[2] = (unsigned char)((word) >> 16); \
+        hbuf[3] = (unsigned char)((word) >> 24); \
+        check = crc32(check, hbuf, 4); \
+    } while (0)
+#endif
+
 /* Load returned state from inflate_fast() */
 #define LOAD() \
     do { \
@@ -196,12 +242,24 @@ local void fixedtables(struct inflate_state FAR *state) {
         bits -= bits & 7; \
     } while (0)
 
+/* Update the check value and output count for the output in the window up
+   to put, when there is a zlib or gzip wrapper. */
+#define WRAPOUT() \
+    do { \
+        if (state->wrap) { \
+            state->check = UPDATE_CHECK(state->check, state->window, \
+                                        (unsigned)(put - state->window)); \
+            state->total += (unsigned long)(put - state->window); \
+        } \
+    } while (0)
+
 /* Assure that some output space is available, by writing out the window
    if it's full.  If the write fails, return from inflateBack() with a
    Z_BUF_ERROR. */
 #define ROOM() \
     do { \
         if (left == 0) { \
+            WRAPOUT(); \
             put = state->window; \
             left = state->wsize; \
             state->whave = left; \
@@ -253,6 +311,9 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
     code last;                  /* parent table entry */
     unsigned len;               /* length to copy for repeats, bits to drop */
     int ret;                    /* return code */
+#ifdef GUNZIP
+    unsigned char hbuf[4];      /* buffer for gzip header crc calculation */
+#endif
     static const unsigned short order[19] = /* permutation of code lengths */
         {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
@@ -263,7 +324,9 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
 
     /* Reset the state */
     strm->msg = Z_NULL;
-    state->mode = TYPE;
+    state->mode = state->wrap ? HEAD : TYPE;
+    state->flags = 0;
+    state->total = 0;
     state->last = 0;
     state->whave = 0;
     next = strm->next_in;
@@ -273,14 +336,151 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
     put = state->window;
     left = state->wsize;
 
-    /* Inflate until end of block marked as last */
+    /* Inflate until end of block marked as last, and the trailer if any */
     for (;;)
         switch (state->mode) {
+        case HEAD:
+            /* zlib or gzip header */
+            NEEDBITS(16);
+#ifdef GUNZIP
+            if ((state->wrap & 2) && hold == 0x8b1f) {  /* gzip header */
+                state->check = crc32(0L, Z_NULL, 0);
+                CRC2(state->check, hold);
+                INITBITS();
+                state->mode = FLAGS;
+                break;
+            }
+            if (!(state->wrap & 1) ||   /* check if zlib header allowed */
+#else
+            if (
+#endif
+                ((BITS(8) << 8) + (hold >> 8)) % 31) {
+                strm->msg = (z_const char *)"incorrect header check";
+                state->mode = BAD;
+                break;
+            }
+            if (BITS(4) != Z_DEFLATED) {
+                strm->msg = (z_const char *)"unknown compression method";
+                state->mode = BAD;
+                break;
+            }
+            DROPBITS(4);
+            len = BITS(4) + 8;
+            if (len > state->wbits) {
+                strm->msg = (z_const char *)"invalid window size";
+                state->mode = BAD;
+                break;
+            }
+            state->dmax = 1U << len;
+            if (hold & 0x200) {         /* no way to provide a dictionary */
+                strm->msg = (z_const char *)"need dictionary";
+                state->mode = BAD;
+                break;
+            }
+            Tracev((stderr, "inflate:   zlib header ok\n"));
+            strm->adler = state->check = adler32(0L, Z_NULL, 0);
+            INITBITS();
+            state->mode = TYPE;
+            break;
+#ifdef GUNZIP
+        case FLAGS:
+            NEEDBITS(16);
+            state->flags = (int)(hold);
+            if ((state->flags & 0xff) != Z_DEFLATED) {
+                strm->msg = (z_const char *)"unknown compression method";
+                state->mode = BAD;
+                break;
+            }
+            if (state->flags & 0xe000) {
+                strm->msg = (z_const char *)"unknown header flags set";
+                state->mode = BAD;
+                break;
+            }
+            if (state->flags & 0x0200)
+                CRC2(state->check, hold);
+            INITBITS();
+            state->mode = TIME;
+                /* fallthrough */
+        case TIME:
+            NEEDBITS(32);
+            if (state->flags & 0x0200)
+                CRC4(state->check, hold);
+            INITBITS();
+            state->mode = OS;
+                /* fallthrough */
+        case OS:
+            NEEDBITS(16);
+            if (state->flags & 0x0200)
+                CRC2(state->check, hold);
+            INITBITS();
+            state->mode = EXLEN;
+                /* fallthrough */
+        case EXLEN:
+            if (state->flags & 0x0400) {
+                NEEDBITS(16);
+                state->length = (unsigned)(hold);
+                if (state->flags & 0x0200)
+                    CRC2(state->check, hold);
+                INITBITS();
+            }
+            state->mode = EXTRA;
+                /* fallthrough */
+        case EXTRA:
+            if (state->flags & 0x0400)
+                while (state->length != 0) {
+                    PULL();
+                    copy = state->length;
+                    if (copy > have) copy = have;
+                    if (state->flags & 0x0200)
+                        state->check = crc32(state->check, next, copy);
+                    have -= copy;
+                    next += copy;
+                    state->length -= copy;
+                }
+            state->mode = NAME;
+                /* fallthrough */
+        case NAME:
+        case COMMENT:
+            /* skip the zero-terminated name, then the comment */
+            if (state->flags & (state->mode == NAME ? 0x0800 : 0x1000))
+                do {
+                    PULL();
+                    copy = 0;
+                    do {
+                        len = (unsigned)(next[copy++]);
+                    } while (len && copy < have);
+                    if (state->flags & 0x0200)
+                        state->check = crc32(state->check, next, copy);
+                    have -= copy;
+                    next += copy;
+                } while (len);
+            if (state->mode == NAME) {
+                state->mode = COMMENT;
+                break;
+            }
+            state->mode = HCRC;
+                /* fallthrough */
+        case HCRC:
+            if (state->flags & 0x0200) {
+                NEEDBITS(16);
+                if (hold != (state->check & 0xffff)) {
+                    strm->msg = (z_const char *)"header crc mismatch";
+                    state->mode = BAD;
+                    break;
+                }
+                INITBITS();
+            }
+            Tracev((stderr, "inflate:   gzip header ok\n"));
+            strm->adler = state->check = crc32(0L, Z_NULL, 0);
+            state->mode = TYPE;
+            break;
+#endif
+
         case TYPE:
             /* determine and dispatch block type */
             if (state->last) {
                 BYTEBITS();
-                state->mode = DONE;
+                state->mode = state->wrap ? CHECK : DONE;
                 break;
             }
             NEEDBITS(3);
@@ -441,11 +641,12 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
             }
 
             /* build code tables -- note: do not change the lenbits or distbits
-               values here (9 and 6) without reading the comments in inftrees.h
-               concerning the ENOUGH constants, which depend on those values */
+               values here (INFLATE_LEN_ROOT and 6) without reading the comments
+               in inftrees.h concerning the ENOUGH constants, which depend on
+               those values */
             state->next = state->codes;
             state->lencode = (code const FAR *)(state->next);
-            state->lenbits = 9;
+            state->lenbits = INFLATE_LEN_ROOT;
             ret = inflate_table(LENS, state->lens, state->nlen, &(state->next),
                                 &(state->lenbits), state->work);
             if (ret) {
@@ -468,7 +669,8 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
 
         case LEN:
             /* use inflate_fast() if we have enough input and output */
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_HAVE &&
+                left >= INFLATE_FAST_MIN_LEFT) {
                 RESTORE();
                 if (state->whave < state->wsize)
                     state->whave = state->wsize - left;
@@ -480,6 +682,11 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
             /* get a literal, length, or end-of-block code */
             for (;;) {
                 here = state->lencode[BITS(state->lenbits)];
+                if (here.op & 128) {    /* first literal of a pair */
+                    here.bits = (unsigned char)(here.op & 15);
+                    here.op = 0;
+                    here.val &= 0xff;
+                }
                 if ((unsigned)(here.bits) <= bits) break;
                 PULLBYTE();
             }
@@ -591,6 +798,49 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
             } while (state->length != 0);
             break;
 
+        case CHECK:
+            /* write out the rest of the output to complete the check value */
+            WRAPOUT();
+            copy = state->wsize - left;
+            put = state->window;
+            left = state->wsize;
+            if (copy && out(out_desc, put, copy)) {
+                ret = Z_BUF_ERROR;
+                goto inf_leave;
+            }
+            strm->adler = state->check;
+
+            /* compare with the check value in the trailer */
+            NEEDBITS(32);
+            if ((
+#ifdef GUNZIP
+                 state->flags ? hold :
+#endif
+                 ZSWAP32(hold)) != state->check) {
+                strm->msg = (z_const char *)"incorrect data check";
+                state->mode = BAD;
+                break;
+            }
+            INITBITS();
+            Tracev((stderr, "inflate:   check matches trailer\n"));
+#ifdef GUNZIP
+            state->mode = LENGTH;
+                /* fallthrough */
+        case LENGTH:
+            if (state->flags) {
+                NEEDBITS(32);
+                if (hold != (state->total & 0xffffffff)) {
+                    strm->msg = (z_const char *)"incorrect length check";
+                    state->mode = BAD;
+                    break;
+                }
+                INITBITS();
+                Tracev((stderr, "inflate:   length matches trailer\n"));
+            }
+#endif
+            state->mode = DONE;
+                /* fallthrough */
+
         case DONE:
             /* inflate stream terminated properly */
             ret = Z_STREAM_END;
@@ -7,11 +7,137 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "zcpu.h"
 
 #ifdef ASMINF
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+#ifdef INFLATE_FAST_WIDE
+/*
+   Fill hold to at least 56 bits with the eight bytes at in, without a branch.
+   The bytes are loaded in little-endian order whatever the byte order of the
+   machine.  Only the whole bytes that fit above the bits in hold are counted,
+   advancing in, and the rest of the last byte is loaded again by the next
+   REFILL(), ORed over the same bits.  This requires that the bits in hold
+   above the bits counted are either zero or the input bits that belong there,
+   which REFILL() and the shifts that drop bits maintain.
+ */
+#  define REFILL() \
+    do { \
+        hold |= ((Z_U8)in[0] | (Z_U8)in[1] << 8 | (Z_U8)in[2] << 16 | \
+                 (Z_U8)in[3] << 24 | (Z_U8)in[4] << 32 | (Z_U8)in[5] << 40 | \
+                 (Z_U8)in[6] << 48 | (Z_U8)in[7] << 56) << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#endif
+
+/*
+   Write the literal or the literal pair in the table entry here.  The high
+   byte of val is zero for a single literal, and is written but then not kept,
+   which avoids a branch.  There is always room for that, since inflate_fast()
+   has at least 258 bytes of output space on each loop.
+ */
+#define PUTLIT(here) \
+    do { \
+        out[0] = (unsigned char)(here->val); \
+        out[1] = (unsigned char)(here->val >> 8); \
+        out += 1 + (here->op >> 7); \
+    } while (0)
+
+#ifdef ZLIB_DEBUG
+local void trace_lit(unsigned val) {
+    Tracevv((stderr, val >= 0x20 && val < 0x7f ?
+            "inflate:         literal '%c'\n" :
+            "inflate:         literal 0x%02x\n", val));
+}
+#  define TRACELIT(here) \
+    do { \
+        trace_lit(here->val & 0xff); \
+        if (here->op & 128) \
+            trace_lit(here->val >> 8); \
+    } while (0)
+#else
+#  define TRACELIT(here)
+#endif
+
+#ifdef INFLATE_FAST_CHUNK
+#  if defined(X86_SIMD)
+#    include <emmintrin.h>
+typedef __m128i chunk_t;
+#    define LOADCHUNK(p) _mm_loadu_si128((const __m128i *)(p))
+#    define STORECHUNK(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#    define SETCHUNK(c) _mm_set1_epi8((char)(c))
+#  else
+#    include <arm_neon.h>
+typedef uint8x16_t chunk_t;
+#    define LOADCHUNK(p) vld1q_u8(p)
+#    define STORECHUNK(p, v) vst1q_u8(p, v)
+#    define SETCHUNK(c) vdupq_n_u8(c)
+#  endif
+
+/*
+   Copy len bytes from out - dist to out, where the bytes before out have been
+   written, in 16-byte chunks.  Up to 15 bytes past out + len may be written.
+   Return out + len.  If dist is less than 16, so that each chunk overlaps the
+   bytes being written, then the repeating pattern of dist bytes is put into a
+   chunk, which is written at multiples of dist.
+ */
+local unsigned char FAR *chunk_copy(unsigned char FAR *out, unsigned dist,
+                                    unsigned len) {
+    unsigned char FAR *stop = out + len;
+    const unsigned char FAR *from = out - dist;
+    unsigned char pat[INFLATE_FAST_CHUNK];
+    unsigned n;
+    chunk_t c;
+
+    if (dist >= INFLATE_FAST_CHUNK) {
+        do {
+            STORECHUNK(out, LOADCHUNK(from));
+            out += INFLATE_FAST_CHUNK;
+            from += INFLATE_FAST_CHUNK;
+        } while (out < stop);
+        return stop;
+    }
+    if (dist == 1)
+        c = SETCHUNK(*from);
+    else {
+        for (n = 0; n < dist; n++)
+            pat[n] = from[n];
+        for (; n < INFLATE_FAST_CHUNK; n++)
+            pat[n] = pat[n - dist];
+        c = LOADCHUNK(pat);
+    }
+    n = INFLATE_FAST_CHUNK - INFLATE_FAST_CHUNK % dist;
+    do {
+        STORECHUNK(out, c);
+        out += n;
+    } while (out < stop);
+    return stop;
+}
+
+/*
+   Copy len bytes from the window at from to out, 16 bytes at a time, without
+   reading or writing past the len bytes.  Return out + len.
+ */
+local unsigned char FAR *window_copy(unsigned char FAR *out,
+                                     const unsigned char FAR *from,
+                                     unsigned len) {
+    while (len >= INFLATE_FAST_CHUNK) {
+        STORECHUNK(out, LOADCHUNK(from));
+        out += INFLATE_FAST_CHUNK;
+        from += INFLATE_FAST_CHUNK;
+        len -= INFLATE_FAST_CHUNK;
+    }
+    while (len) {
+        *out++ = *from++;
+        len--;
+    }
+    return out;
+}
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -23,8 +149,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE (6, or 8 if INFLATE_FAST_WIDE)
+        strm->avail_out >= INFLATE_FAST_MIN_LEFT (258, or 273 with chunks)
         start >= strm->avail_out
         state->bits < 8
 
@@ -42,265 +168,46 @@
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
       checking for available input while decoding.
 
+    - With INFLATE_FAST_WIDE, hold is refilled to at least 56 bits once for
+      each pass through the loop, which is enough for any length/distance
+      pair, or for three literals.  Each refill reads eight bytes, so eight
+      bytes of input are required instead of six.
+
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
       output space.
+
+    - With INFLATE_FAST_CHUNK, matches are copied in 16-byte chunks that can
+      write up to 15 bytes past the end of the match, so 15 more bytes of
+      output space are required.  That is not done for inflateBack(), where
+      the bytes after the output are the sliding window (state->over is
+      false).
+
+    - Blocks with the fixed codes are decoded by a copy of the loop made for
+      those codes, inflate_fast_fixed(), which is chosen when the tables are
+      not in state->codes.  Small messages and levels 1 and 2 of many
+      compressors are often coded that way.
  */
+#define INFLATE_FAST_LOOP inflate_fast_dynamic
+#include "inffastl.h"
+#undef INFLATE_FAST_LOOP
+
+#define INFLATE_FAST_LOOP inflate_fast_fixed
+#define INFLATE_FAST_FIXED
+#include "inffastl.h"
+#undef INFLATE_FAST_FIXED
+#undef INFLATE_FAST_LOOP
+
 void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
     struct inflate_state FAR *state;
-    z_const unsigned char FAR *in;      /* local strm->next_in */
-    z_const unsigned char FAR *last;    /* have enough input while in < last */
-    unsigned char FAR *out;     /* local strm->next_out */
-    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
-    unsigned char FAR *end;     /* while out < end, enough space available */
-#ifdef INFLATE_STRICT
-    unsigned dmax;              /* maximum distance from zlib header */
-#endif
-    unsigned wsize;             /* window size or zero if not using window */
-    unsigned whave;             /* valid bytes in the window */
-    unsigned wnext;             /* window write index */
-    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
-    unsigned long hold;         /* local strm->hold */
-    unsigned bits;              /* local strm->bits */
-    code const FAR *lcode;      /* local strm->lencode */
-    code const FAR *dcode;      /* local strm->distcode */
-    unsigned lmask;             /* mask for first level of length codes */
-    unsigned dmask;             /* mask for first level of distance codes */
-    code const *here;           /* retrieved table entry */
-    unsigned op;                /* code bits, operation, extra bits, or */
-                                /*  window position, window bytes to copy */
-    unsigned len;               /* match length, unused bytes */
-    unsigned dist;              /* match distance */
-    unsigned char FAR *from;    /* where to copy match from */
 
-    /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
-    in = strm->next_in;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out;
-    beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
-#ifdef INFLATE_STRICT
-    dmax = state->dmax;
-#endif
-    wsize = state->wsize;
-    whave = state->whave;
-    wnext = state->wnext;
-    window = state->window;
-    hold = state->hold;
-    bits = state->bits;
-    lcode = state->lencode;
-    dcode = state->distcode;
-    lmask = (1U << state->lenbits) - 1;
-    dmask = (1U << state->distbits) - 1;
-
-    /* decode literals and length/distances until end-of-block or not enough
-       input data or output space */
-    do {
-        if (bits < 15) {
-            hold += (unsigned long)(*in++) << bits;
-            bits += 8;
-            hold += (unsigned long)(*in++) << bits;
-            bits += 8;
-        }
-        here = lcode + (hold & lmask);
-      dolen:
-        op = (unsigned)(here->bits);
-        hold >>= op;
-        bits -= op;
-        op = (unsigned)(here->op);
-        if (op == 0) {                          /* literal */
-            Tracevv((stderr, here->val >= 0x20 && here->val < 0x7f ?
-                    "inflate:         literal '%c'\n" :
-                    "inflate:         literal 0x%02x\n", here->val));
-            *out++ = (unsigned char)(here->val);
-        }
-        else if (op & 16) {                     /* length base */
-            len = (unsigned)(here->val);
-            op &= 15;                           /* number of extra bits */
-            if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(*in++) << bits;
-                    bits += 8;
-                }
-                len += (unsigned)hold & ((1U << op) - 1);
-                hold >>= op;
-                bits -= op;
-            }
-            Tracevv((stderr, "inflate:         length %u\n", len));
-            if (bits < 15) {
-                hold += (unsigned long)(*in++) << bits;
-                bits += 8;
-                hold += (unsigned long)(*in++) << bits;
-                bits += 8;
-            }
-            here = dcode + (hold & dmask);
-          dodist:
-            op = (unsigned)(here->bits);
-            hold >>= op;
-            bits -= op;
-            op = (unsigned)(here->op);
-            if (op & 16) {                      /* distance base */
-                dist = (unsigned)(here->val);
-                op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(*in++) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(*in++) << bits;
-                        bits += 8;
-                    }
-                }
-                dist += (unsigned)hold & ((1U << op) - 1);
-#ifdef INFLATE_STRICT
-                if (dist > dmax) {
-                    strm->msg = (z_const char *)"invalid distance too far back";
-                    state->mode = BAD;
-                    break;
-                }
-#endif
-                hold >>= op;
-                bits -= op;
-                Tracevv((stderr, "inflate:         distance %u\n", dist));
-                op = (unsigned)(out - beg);     /* max distance in output */
-                if (dist > op) {                /* see if copy from window */
-                    op = dist - op;             /* distance back in window */
-                    if (op > whave) {
-                        if (state->sane) {
-                            strm->msg =
-                                (z_const char *)"invalid distance too far back";
-                            state->mode = BAD;
-                            break;
-                        }
-#ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
-                        if (len <= op - whave) {
-                            do {
-                                *out++ = 0;
-                            } while (--len);
-                            continue;
-                        }
-                        len -= op - whave;
-                        do {
-                            *out++ = 0;
-                        } while (--op > whave);
-                        if (op == 0) {
-                            from = out - dist;
-                            do {
-                                *out++ = *from++;
-                            } while (--len);
-                            continue;
-                        }
-#endif
-                    }
-                    from = window;
-                    if (wnext == 0) {           /* very common case */
-                        from += wsize - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
-                    }
-                    else if (wnext < op) {      /* wrap around window */
-                        from += wsize + wnext - op;
-                        op -= wnext;
-                        if (op < len) {         /* some from end of window */
-                            len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
-                            from = window;
-                            if (wnext < len) {  /* some from start of window */
-                                op = wnext;
-                                len -= op;
-                                do {
-                                    *out++ = *from++;
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
-                            }
-                        }
-                    }
-                    else {                      /* contiguous in window */
-                        from += wnext - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
-                    }
-                    while (len > 2) {
-                        *out++ = *from++;
-                        *out++ = *from++;
-                        *out++ = *from++;
-                        len -= 3;
-                    }
-                    if (len) {
-                        *out++ = *from++;
-                        if (len > 1)
-                            *out++ = *from++;
-                    }
-                }
-                else {
-                    from = out - dist;          /* copy direct from output */
-                    do {                        /* minimum length is three */
-                        *out++ = *from++;
-                        *out++ = *from++;
-                        *out++ = *from++;
-                        len -= 3;
-                    } while (len > 2);
-                    if (len) {
-                        *out++ = *from++;
-                        if (len > 1)
-                            *out++ = *from++;
-                    }
-                }
-            }
-            else if ((op & 64) == 0) {          /* 2nd level distance code */
-                here = dcode + here->val + (hold & ((1U << op) - 1));
-                goto dodist;
-            }
-            else {
-                strm->msg = (z_const char *)"invalid distance code";
-                state->mode = BAD;
-                break;
-            }
-        }
-        else if ((op & 64) == 0) {              /* 2nd level length code */
-            here = lcode + here->val + (hold & ((1U << op) - 1));
-            goto dolen;
-        }
-        else if (op & 32) {                     /* end-of-block */
-            Tracevv((stderr, "inflate:         end of block\n"));
-            state->mode = TYPE;
-            break;
-        }
-        else {
-            strm->msg = (z_const char *)"invalid literal/length code";
-            state->mode = BAD;
-            break;
-        }
-    } while (in < last && out < end);
-
-    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
-    len = bits >> 3;
-    in -= len;
-    bits -= len << 3;
-    hold &= (1U << bits) - 1;
-
-    /* update state and return */
-    strm->next_in = in;
-    strm->next_out = out;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
-    strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
-    state->hold = hold;
-    state->bits = bits;
-    return;
+    if (state->lencode >= state->codes &&
+        state->lencode <= state->codes + ENOUGH - 1)
+        inflate_fast_dynamic(strm, start);
+    else
+        inflate_fast_fixed(strm, start);
 }
 
 /*
@@ -318,3 +225,17 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
  */
 
 #endif /* !ASMINF */
+
+/* The chunked match copy in inflate_fast() is chosen at compile time, since
+   SSE2 and NEON are always present where they are used. */
+const char ZLIB_INTERNAL *inflate_copy_kernel(void) {
+#if defined(ASMINF)
+    return "asm";
+#elif !defined(INFLATE_FAST_CHUNK)
+    return "c";
+#elif defined(X86_SIMD)
+    return "sse2";
+#else
+    return "neon";
+#endif
+}
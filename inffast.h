@@ -8,4 +8,24 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* On 64-bit targets, inflate_fast() refills its bit buffer eight bytes at a
+   time, and so must be entered with at least eight bytes of input. */
+#if defined(Z_U8) && !defined(ASMINF) && \
+    (ULONG_MAX == 0xffffffffffffffff || defined(_WIN64))
+#  define INFLATE_FAST_WIDE
+#  define INFLATE_FAST_MIN_HAVE 8
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#endif
+
+/* With SSE2 or NEON, inflate_fast() copies matches in 16-byte chunks, and can
+   write up to 15 bytes past the end of a match, and so must be entered with
+   that much more output space. */
+#if (defined(X86_SIMD) || defined(ARM_SIMD)) && !defined(ASMINF)
+#  define INFLATE_FAST_CHUNK 16
+#  define INFLATE_FAST_MIN_LEFT (258 + INFLATE_FAST_CHUNK - 1)
+#else
+#  define INFLATE_FAST_MIN_LEFT 258
+#endif
+
 void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start);
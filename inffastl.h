@@ -0,0 +1,410 @@
+/* inffastl.h -- decoding loop of inflate_fast()
+ * Copyright (C) 1995-2017 Mark Adler
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/*
+   This is included by inffast.c to define the function INFLATE_FAST_LOOP,
+   once for any codes, and once with INFLATE_FAST_FIXED defined for the fixed
+   codes.  The fixed tables have a 9-bit root for the literal/length codes and
+   a 5-bit root for the distance codes, with no second-level tables, and no
+   literal pairs since no two literals fit in nine bits.  So the fixed version
+   uses constant masks, writes one literal at a time, and leaves out the
+   second-level lookups.  With INFLATE_FAST_WIDE it decodes up to six literals
+   for each refill instead of three, since each takes at most nine bits.
+ */
+
+#ifdef INFLATE_FAST_FIXED
+#  define LMASK 511U
+#  define DMASK 31U
+#  define ISLIT(op) ((op) == 0)
+#  define PUTCODE(here) (*out++ = (unsigned char)(here->val))
+#else
+#  define LMASK lmask
+#  define DMASK dmask
+#  define ISLIT(op) ((op) == 0 || (op) & 128)
+#  define PUTCODE(here) PUTLIT(here)
+#endif
+
+local void INFLATE_FAST_LOOP(z_streamp strm, unsigned start) {
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    unsigned char FAR *dend;    /* end of the dictionary before the window */
+    unsigned dsize;             /* bytes of that dictionary */
+#ifdef INFLATE_FAST_WIDE
+    Z_U8 hold;                  /* local strm->hold */
+#else
+    unsigned long hold;         /* local strm->hold */
+#endif
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+#ifndef INFLATE_FAST_FIXED
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+#endif
+    code const *here;           /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+#ifdef INFLATE_FAST_CHUNK
+    int over;                   /* true to copy in chunks */
+#endif
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_LEFT - 1));
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    dend = state->dend;
+    dsize = state->dsize;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+#ifndef INFLATE_FAST_FIXED
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+#endif
+#ifdef INFLATE_FAST_CHUNK
+    over = state->over;
+#endif
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+#ifdef INFLATE_FAST_WIDE
+        REFILL();
+#else
+        if (bits < 15) {
+            hold += (unsigned long)(*in++) << bits;
+            bits += 8;
+            hold += (unsigned long)(*in++) << bits;
+            bits += 8;
+        }
+#endif
+        here = lcode + (hold & LMASK);
+#ifndef INFLATE_FAST_FIXED
+      dolen:
+#endif
+        op = (unsigned)(here->bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here->op);
+        if (ISLIT(op)) {                        /* literal or literal pair */
+            TRACELIT(here);
+            PUTCODE(here);
+#if defined(INFLATE_FAST_WIDE) && defined(INFLATE_FAST_FIXED)
+            /* at least 47 bits are left, enough for five more literals of at
+               most nine bits */
+            len = 5;
+            do {
+                here = lcode + (hold & LMASK);
+                if (here->op)
+                    break;
+                hold >>= here->bits;
+                bits -= here->bits;
+                TRACELIT(here);
+                PUTCODE(here);
+            } while (--len);
+#elif defined(INFLATE_FAST_WIDE)
+            /* at least 41 bits are left, enough for two more literals or
+               literal pairs */
+            here = lcode + (hold & LMASK);
+            if (ISLIT(here->op)) {
+                hold >>= here->bits;
+                bits -= here->bits;
+                TRACELIT(here);
+                PUTCODE(here);
+                here = lcode + (hold & LMASK);
+                if (ISLIT(here->op)) {
+                    hold >>= here->bits;
+                    bits -= here->bits;
+                    TRACELIT(here);
+                    PUTCODE(here);
+                }
+            }
+#endif
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here->val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+#ifndef INFLATE_FAST_WIDE
+                if (bits < op) {
+                    hold += (unsigned long)(*in++) << bits;
+                    bits += 8;
+                }
+#endif
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+#ifndef INFLATE_FAST_WIDE
+            if (bits < 15) {
+                hold += (unsigned long)(*in++) << bits;
+                bits += 8;
+                hold += (unsigned long)(*in++) << bits;
+                bits += 8;
+            }
+#endif
+            here = dcode + (hold & DMASK);
+#ifndef INFLATE_FAST_FIXED
+          dodist:
+#endif
+            op = (unsigned)(here->bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here->op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here->val);
+                op &= 15;                       /* number of extra bits */
+#ifndef INFLATE_FAST_WIDE
+                if (bits < op) {
+                    hold += (unsigned long)(*in++) << bits;
+                    bits += 8;
+                    if (bits < op) {
+                        hold += (unsigned long)(*in++) << bits;
+                        bits += 8;
+                    }
+                }
+#endif
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (z_const char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave + dsize) {
+                        if (state->sane) {
+                            strm->msg =
+                                (z_const char *)"invalid distance too far back";
+                            state->mode = BAD;
+                            break;
+                        }
+#ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
+                        if (len <= op - whave) {
+                            do {
+                                *out++ = 0;
+                            } while (--len);
+                            continue;
+                        }
+                        len -= op - whave;
+                        do {
+                            *out++ = 0;
+                        } while (--op > whave);
+                        if (op == 0) {
+                            from = out - dist;
+                            do {
+                                *out++ = *from++;
+                            } while (--len);
+                            continue;
+                        }
+#endif
+                    }
+                    else if (op > whave) {      /* copy from dictionary */
+                        op -= whave;
+                        if (op >= len) {
+                            zmemcpy(out, dend - op, len);
+                            out += len;
+                            continue;
+                        }
+                        zmemcpy(out, dend - op, op);
+                        out += op;
+                        len -= op;
+                        op = whave;     /* the rest from window or output */
+                        if (op == 0) {
+                            from = out - dist;
+                            do {
+                                *out++ = *from++;
+                            } while (--len);
+                            continue;
+                        }
+                    }
+#ifdef INFLATE_FAST_CHUNK
+                    if (over) {
+                        if (wnext < op) {       /* wrap around window */
+                            op -= wnext;        /* bytes to end of window */
+                            from = window + wsize - op;
+                            if (op >= len) {
+                                out = window_copy(out, from, len);
+                                continue;
+                            }
+                            out = window_copy(out, from, op);
+                            len -= op;
+                            op = wnext;         /* from start of window */
+                            from = window;
+                        }
+                        else                    /* contiguous in window */
+                            from = window + wnext - op;
+                        if (op >= len) {
+                            out = window_copy(out, from, len);
+                            continue;
+                        }
+                        out = window_copy(out, from, op);
+                        out = chunk_copy(out, dist, len - op);
+                        continue;               /* rest from output */
+                    }
+#endif
+                    from = window;
+                    if (wnext == 0) {           /* very common case */
+                        from += wsize - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = window;
+                            if (wnext < len) {  /* some from start of window */
+                                op = wnext;
+                                len -= op;
+                                do {
+                                    *out++ = *from++;
+                                } while (--op);
+                                from = out - dist;      /* rest from output */
+                            }
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += wnext - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    while (len > 2) {
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        len -= 3;
+                    }
+                    if (len) {
+                        *out++ = *from++;
+                        if (len > 1)
+                            *out++ = *from++;
+                    }
+                }
+#ifdef INFLATE_FAST_CHUNK
+                else if (over)
+                    out = chunk_copy(out, dist, len);
+#endif
+                else {
+                    from = out - dist;          /* copy direct from output */
+                    do {                        /* minimum length is three */
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        len -= 3;
+                    } while (len > 2);
+                    if (len) {
+                        *out++ = *from++;
+                        if (len > 1)
+                            *out++ = *from++;
+                    }
+                }
+            }
+#ifndef INFLATE_FAST_FIXED
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode + here->val + (hold & ((1U << op) - 1));
+                goto dodist;
+            }
+#endif
+            else {
+                strm->msg = (z_const char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+#ifndef INFLATE_FAST_FIXED
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode + here->val + (hold & ((1U << op) - 1));
+            goto dolen;
+        }
+#endif
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (z_const char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
+    strm->avail_out = (unsigned)(out < end ?
+                                 (INFLATE_FAST_MIN_LEFT - 1) + (end - out) :
+                                 (INFLATE_FAST_MIN_LEFT - 1) - (out - end));
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#undef LMASK
+#undef DMASK
+#undef ISLIT
+#undef PUTCODE
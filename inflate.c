@@ -123,6 +123,9 @@ int ZEXPORT inflateResetKeep(z_streamp strm) {
     state->lencode = state->distcode = state->next = state->codes;
     state->sane = 1;
     state->back = -1;
+#ifdef INFLATE_STATS
+    zmemzero((voidpf)&state->stats, sizeof(state->stats));
+#endif
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
 }
@@ -135,9 +138,38 @@ int ZEXPORT inflateReset(z_streamp strm) {
     state->wsize = 0;
     state->whave = 0;
     state->wnext = 0;
+    state->dend = Z_NULL;
+    state->dsize = 0;
     return inflateResetKeep(strm);
 }
 
+/*
+   Extract the wrap request from the windowBits parameter of inflateInit2() or
+   inflateReset2(), and leave the number of window bits in *windowBits, or zero
+   to use the window size in the zlib header. Return the wrap request, or -1 if
+   windowBits is invalid.
+ */
+local int inflate_wbits(int *windowBits) {
+    int wrap;
+
+    if (*windowBits < 0) {
+        if (*windowBits < -15)
+            return -1;
+        wrap = 0;
+        *windowBits = -*windowBits;
+    }
+    else {
+        wrap = (*windowBits >> 4) + 5;
+#ifdef GUNZIP
+        if (*windowBits < 48)
+            *windowBits &= 15;
+#endif
+    }
+    if (*windowBits && (*windowBits < 8 || *windowBits > 15))
+        return -1;
+    return wrap;
+}
+
 int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
     int wrap;
     struct inflate_state FAR *state;
@@ -147,23 +179,11 @@ int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
     state = (struct inflate_state FAR *)strm->state;
 
     /* extract wrap request from windowBits parameter */
-    if (windowBits < 0) {
-        if (windowBits < -15)
-            return Z_STREAM_ERROR;
-        wrap = 0;
-        windowBits = -windowBits;
-    }
-    else {
-        wrap = (windowBits >> 4) + 5;
-#ifdef GUNZIP
-        if (windowBits < 48)
-            windowBits &= 15;
-#endif
-    }
+    wrap = inflate_wbits(&windowBits);
+    if (wrap < 0)
+        return Z_STREAM_ERROR;
 
     /* set number of window bits, free window if different */
-    if (windowBits && (windowBits < 8 || windowBits > 15))
-        return Z_STREAM_ERROR;
     if (state->window != Z_NULL && state->wbits != (unsigned)windowBits) {
         ZFREE(strm, state->window);
         state->window = Z_NULL;
@@ -175,6 +195,29 @@ int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
     return inflateReset(strm);
 }
 
+int ZEXPORT inflateBatch(z_streamp strm, z_batchp batch, unsigned n) {
+    int ret;
+
+    if (inflateStateCheck(strm) || (batch == Z_NULL && n))
+        return Z_STREAM_ERROR;
+    for (; n; n--, batch++) {
+        inflateReset(strm);
+        strm->next_in = batch->next_in;
+        strm->avail_in = batch->avail_in;
+        strm->next_out = batch->next_out;
+        strm->avail_out = batch->avail_out;
+        ret = inflate(strm, Z_FINISH);
+        batch->next_in = strm->next_in;
+        batch->avail_in = strm->avail_in;
+        batch->next_out = strm->next_out;
+        batch->avail_out = strm->avail_out;
+        batch->status = ret == Z_STREAM_END ? Z_OK :
+                        ret == Z_BUF_ERROR && strm->avail_out ? Z_DATA_ERROR :
+                        ret;
+    }
+    return Z_OK;
+}
+
 int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
                           const char *version, int stream_size) {
     int ret;
@@ -206,6 +249,7 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     strm->state = (struct internal_state FAR *)state;
     state->strm = strm;
     state->window = Z_NULL;
+    state->over = 1;
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     ret = inflateReset2(strm, windowBits);
     if (ret != Z_OK) {
@@ -215,6 +259,47 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     return ret;
 }
 
+uLong ZEXPORT inflateStateSize(int windowBits) {
+    if (inflate_wbits(&windowBits) < 0)
+        return 0;
+    if (windowBits == 0)
+        windowBits = 15;        /* the largest the zlib header can ask for */
+
+    /* the state from inflateInit2_() and the window from updatewindow() */
+    return ZARENA_SIZE(ZARENA_ROUND(sizeof(struct inflate_state)) +
+                       ZARENA_ROUND((ulg)1 << windowBits));
+}
+
+uLong ZEXPORT inflateMemUsage(z_streamp strm) {
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm))
+        return 0;
+    state = (struct inflate_state FAR *)strm->state;
+
+    /* the state from inflateInit2_(), and the window once updatewindow() has
+       allocated it */
+    return sizeof(struct inflate_state) +
+           (state->window == Z_NULL ? 0 : (ulg)1 << state->wbits);
+}
+
+int ZEXPORT inflateInitMem_(z_streamp strm, int windowBits, voidpf mem,
+                            uLong size, const char *version,
+                            int stream_size) {
+    uLong need;
+
+    if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
+        stream_size != (int)(sizeof(z_stream)))
+        return Z_VERSION_ERROR;
+    need = inflateStateSize(windowBits);
+    if (strm == Z_NULL || mem == Z_NULL || need == 0) return Z_STREAM_ERROR;
+    if (size < need) return Z_MEM_ERROR;
+    strm->zalloc = zarena_alloc;
+    strm->zfree = zarena_free;
+    strm->opaque = zarena_init(mem, size);
+    return inflateInit2_(strm, windowBits, version, stream_size);
+}
+
 int ZEXPORT inflateInit_(z_streamp strm, const char *version,
                          int stream_size) {
     return inflateInit2_(strm, DEF_WBITS, version, stream_size);
@@ -351,6 +436,19 @@ void makefixed(void)
 }
 #endif /* MAKEFIXED */
 
+/* check function to use adler32() for zlib or crc32() for gzip */
+#ifdef GUNZIP
+#  define UPDATE_CHECK(check, buf, len) \
+    (state->flags ? crc32(check, buf, len) : adler32(check, buf, len))
+#  define UPDATE_COPY(check, dest, buf, len) \
+    (state->flags ? crc32_copy(check, dest, buf, len) : \
+                    adler32_copy(check, dest, buf, len))
+#else
+#  define UPDATE_CHECK(check, buf, len) adler32(check, buf, len)
+#  define UPDATE_COPY(check, dest, buf, len) \
+    adler32_copy(check, dest, buf, len)
+#endif
+
 /*
    Update the window with the last wsize (normally 32K) bytes written before
    returning.  If window does not exist yet, create it.  This is only called
@@ -364,8 +462,13 @@ void makefixed(void)
    upon return from inflate(), and since all distances after the first 32K of
    output will fall in the output data, making match copies simpler and faster.
    The advantage may be dependent on the size of the processor's data caches.
+
+   If check is true, then the check value is also updated with the copy bytes
+   before end, with the bytes copied to the window checked as they are copied,
+   to avoid a second pass over them.
  */
-local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
+local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy,
+                       int check) {
     struct inflate_state FAR *state;
     unsigned dist;
 
@@ -387,18 +490,35 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
     }
 
     /* copy state->wsize or less output bytes into the circular window */
+    STAT(state, window_copies, 1);
+    STAT(state, window_bytes, copy < state->wsize ? copy : state->wsize);
     if (copy >= state->wsize) {
-        zmemcpy(state->window, end - state->wsize, state->wsize);
+        if (check) {
+            state->check = UPDATE_CHECK(state->check, end - copy,
+                                        copy - state->wsize);
+            state->check = UPDATE_COPY(state->check, state->window,
+                                       end - state->wsize, state->wsize);
+        }
+        else
+            zmemcpy(state->window, end - state->wsize, state->wsize);
         state->wnext = 0;
         state->whave = state->wsize;
     }
     else {
         dist = state->wsize - state->wnext;
         if (dist > copy) dist = copy;
-        zmemcpy(state->window + state->wnext, end - copy, dist);
+        if (check)
+            state->check = UPDATE_COPY(state->check, state->window +
+                                       state->wnext, end - copy, dist);
+        else
+            zmemcpy(state->window + state->wnext, end - copy, dist);
         copy -= dist;
         if (copy) {
-            zmemcpy(state->window, end - copy, copy);
+            if (check)
+                state->check = UPDATE_COPY(state->check, state->window,
+                                           end - copy, copy);
+            else
+                zmemcpy(state->window, end - copy, copy);
             state->wnext = copy;
             state->whave = state->wsize;
         }
@@ -408,19 +528,15 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
             if (state->whave < state->wsize) state->whave += dist;
         }
     }
+
+    /* what the window now holds from a used dictionary */
+    if (state->dsize > state->wsize - state->whave)
+        state->dsize = state->wsize - state->whave;
     return 0;
 }
 
 /* Macros for inflate(): */
 
-/* check function to use adler32() for zlib or crc32() for gzip */
-#ifdef GUNZIP
-#  define UPDATE_CHECK(check, buf, len) \
-    (state->flags ? crc32(check, buf, len) : adler32(check, buf, len))
-#else
-#  define UPDATE_CHECK(check, buf, len) adler32(check, buf, len)
-#endif
-
 /* check macros for header crc */
 #ifdef GUNZIP
 #  define CRC2(check, word) \
@@ -596,6 +712,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
     unsigned bits;              /* bits in bit buffer */
     unsigned in, out;           /* save starting available input and output */
     unsigned copy;              /* number of stored or match bytes to copy */
+    int check;                  /* true to update the check value on exit */
     unsigned char FAR *from;    /* where to copy match bytes from */
     code here;                  /* current decoding table entry */
     code last;                  /* parent table entry */
@@ -837,12 +954,14 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             case 0:                             /* stored block */
                 Tracev((stderr, "inflate:     stored block%s\n",
                         state->last ? " (last)" : ""));
+                STAT(state, stored_blocks, 1);
                 state->mode = STORED;
                 break;
             case 1:                             /* fixed block */
                 fixedtables(state);
                 Tracev((stderr, "inflate:     fixed codes block%s\n",
                         state->last ? " (last)" : ""));
+                STAT(state, fixed_blocks, 1);
                 state->mode = LEN_;             /* decode codes */
                 if (flush == Z_TREES) {
                     DROPBITS(2);
@@ -852,6 +971,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             case 2:                             /* dynamic block */
                 Tracev((stderr, "inflate:     dynamic codes block%s\n",
                         state->last ? " (last)" : ""));
+                STAT(state, dynamic_blocks, 1);
                 state->mode = TABLE;
                 break;
             case 3:
@@ -885,6 +1005,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 if (copy > left) copy = left;
                 if (copy == 0) goto inf_leave;
                 zmemcpy(put, next, copy);
+                STAT(state, stored_bytes, copy);
                 have -= copy;
                 next += copy;
                 left -= copy;
@@ -927,6 +1048,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->lenbits = 7;
             ret = inflate_table(CODES, state->lens, 19, &(state->next),
                                 &(state->lenbits), state->work);
+            STAT(state, tables, 1);
             if (ret) {
                 strm->msg = (z_const char *)"invalid code lengths set";
                 state->mode = BAD;
@@ -995,13 +1117,15 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             }
 
             /* build code tables -- note: do not change the lenbits or distbits
-               values here (9 and 6) without reading the comments in inftrees.h
-               concerning the ENOUGH constants, which depend on those values */
+               values here (INFLATE_LEN_ROOT and 6) without reading the comments
+               in inftrees.h concerning the ENOUGH constants, which depend on
+               those values */
             state->next = state->codes;
             state->lencode = (const code FAR *)(state->next);
-            state->lenbits = 9;
+            state->lenbits = INFLATE_LEN_ROOT;
             ret = inflate_table(LENS, state->lens, state->nlen, &(state->next),
                                 &(state->lenbits), state->work);
+            STAT(state, tables, 1);
             if (ret) {
                 strm->msg = (z_const char *)"invalid literal/lengths set";
                 state->mode = BAD;
@@ -1011,6 +1135,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->distbits = 6;
             ret = inflate_table(DISTS, state->lens + state->nlen, state->ndist,
                             &(state->next), &(state->distbits), state->work);
+            STAT(state, tables, 1);
             if (ret) {
                 strm->msg = (z_const char *)"invalid distances set";
                 state->mode = BAD;
@@ -1024,9 +1149,12 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->mode = LEN;
                 /* fallthrough */
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_HAVE &&
+                left >= INFLATE_FAST_MIN_LEFT) {
                 RESTORE();
                 inflate_fast(strm, out);
+                STAT(state, fast_calls, 1);
+                STAT(state, fast_bytes, left - strm->avail_out);
                 LOAD();
                 if (state->mode == TYPE)
                     state->back = -1;
@@ -1035,6 +1163,11 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->back = 0;
             for (;;) {
                 here = state->lencode[BITS(state->lenbits)];
+                if (here.op & 128) {    /* first literal of a pair */
+                    here.bits = (unsigned char)(here.op & 15);
+                    here.op = 0;
+                    here.val &= 0xff;
+                }
                 if ((unsigned)(here.bits) <= bits) break;
                 PULLBYTE();
             }
@@ -1134,7 +1267,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             copy = out - left;
             if (state->offset > copy) {         /* copy from window */
                 copy = state->offset - copy;
-                if (copy > state->whave) {
+                if (copy > state->whave + state->dsize) {
                     if (state->sane) {
                         strm->msg = (z_const char *)"invalid distance too far back";
                         state->mode = BAD;
@@ -1154,7 +1287,11 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                     break;
 #endif
                 }
-                if (copy > state->wnext) {
+                if (copy > state->whave) {      /* copy from dictionary */
+                    copy -= state->whave;
+                    from = state->dend - copy;
+                }
+                else if (copy > state->wnext) {
                     copy -= state->wnext;
                     from = state->window + (state->wsize - copy);
                 }
@@ -1169,6 +1306,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             if (copy > left) copy = left;
             left -= copy;
             state->length -= copy;
+            STAT(state, slow_bytes, copy);
             do {
                 *put++ = *from++;
             } while (--copy);
@@ -1177,6 +1315,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
         case LIT:
             if (left == 0) goto inf_leave;
             *put++ = (unsigned char)(state->length);
+            STAT(state, slow_bytes, 1);
             left--;
             state->mode = LEN;
             break;
@@ -1241,20 +1380,25 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
      */
   inf_leave:
     RESTORE();
+    check = (state->wrap & 4) && out != strm->avail_out;
     if (state->wsize || (out != strm->avail_out && state->mode < BAD &&
-            (state->mode < CHECK || flush != Z_FINISH)))
-        if (updatewindow(strm, strm->next_out, out - strm->avail_out)) {
+            (state->mode < CHECK || flush != Z_FINISH))) {
+        if (updatewindow(strm, strm->next_out, out - strm->avail_out,
+                         check)) {
             state->mode = MEM;
             return Z_MEM_ERROR;
         }
+        check = 0;                      /* updated by updatewindow() */
+    }
     in -= strm->avail_in;
     out -= strm->avail_out;
     strm->total_in += in;
     strm->total_out += out;
     state->total += out;
+    if (check)
+        state->check = UPDATE_CHECK(state->check, strm->next_out - out, out);
     if ((state->wrap & 4) && out)
-        strm->adler = state->check =
-            UPDATE_CHECK(state->check, strm->next_out - out, out);
+        strm->adler = state->check;
     strm->data_type = (int)state->bits + (state->last ? 64 : 0) +
                       (state->mode == TYPE ? 128 : 0) +
                       (state->mode == LEN_ || state->mode == COPY_ ? 256 : 0);
@@ -1283,7 +1427,11 @@ int ZEXPORT inflateGetDictionary(z_streamp strm, Bytef *dictionary,
     if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)strm->state;
 
-    /* copy dictionary */
+    /* copy dictionary, starting with any used dictionary before the window */
+    if (state->dsize && dictionary != Z_NULL) {
+        zmemcpy(dictionary, state->dend - state->dsize, state->dsize);
+        dictionary += state->dsize;
+    }
     if (state->whave && dictionary != Z_NULL) {
         zmemcpy(dictionary, state->window + state->wnext,
                 state->whave - state->wnext);
@@ -1291,7 +1439,7 @@ int ZEXPORT inflateGetDictionary(z_streamp strm, Bytef *dictionary,
                 state->window, state->wnext);
     }
     if (dictLength != Z_NULL)
-        *dictLength = state->whave;
+        *dictLength = state->dsize + state->whave;
     return Z_OK;
 }
 
@@ -1317,7 +1465,7 @@ int ZEXPORT inflateSetDictionary(z_streamp strm, const Bytef *dictionary,
 
     /* copy dictionary to window using updatewindow(), which will amend the
        existing dictionary if appropriate */
-    ret = updatewindow(strm, dictionary + dictLength, dictLength);
+    ret = updatewindow(strm, dictionary + dictLength, dictLength, 0);
     if (ret) {
         state->mode = MEM;
         return Z_MEM_ERROR;
@@ -1327,6 +1475,58 @@ int ZEXPORT inflateSetDictionary(z_streamp strm, const Bytef *dictionary,
     return Z_OK;
 }
 
+z_inflate_dictp ZEXPORT inflatePrepareDictionary(z_streamp strm,
+                                                 const Bytef *dictionary,
+                                                 uInt dictLength) {
+    z_inflate_dictp dict;
+    unsigned size;
+
+    if (inflateStateCheck(strm) || dictionary == Z_NULL)
+        return Z_NULL;
+    size = dictLength < 32768U ? dictLength : 32768U;
+    dict = (z_inflate_dictp)
+           ZALLOC(strm, 1, sizeof(struct z_inflate_dict_s) + size);
+    if (dict == Z_NULL)
+        return Z_NULL;
+    dict->zfree = strm->zfree;
+    dict->opaque = strm->opaque;
+    dict->adler = adler32(adler32(0L, Z_NULL, 0), dictionary, dictLength);
+    dict->size = size;
+    dict->data = (unsigned char FAR *)(dict + 1);
+    zmemcpy(dict->data, dictionary + dictLength - size, size);
+    return dict;
+}
+
+int ZEXPORT inflateUseDictionary(z_streamp strm, z_inflate_dictp dict) {
+    struct inflate_state FAR *state;
+    unsigned wsize;
+
+    /* check state */
+    if (inflateStateCheck(strm) || dict == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if ((state->wrap != 0 && state->mode != DICT) || state->whave ||
+        state->dsize || strm->total_out)
+        return Z_STREAM_ERROR;
+
+    /* check for correct dictionary identifier */
+    if (state->mode == DICT && dict->adler != state->check)
+        return Z_DATA_ERROR;
+
+    /* reference the dictionary as what precedes the window, up to the window
+       size, instead of copying it */
+    wsize = 1U << state->wbits;
+    state->dsize = dict->size < wsize ? dict->size : wsize;
+    state->dend = dict->data + dict->size;
+    state->havedict = 1;
+    Tracev((stderr, "inflate:   dictionary used\n"));
+    return Z_OK;
+}
+
+void ZEXPORT inflateFreeDictionary(z_inflate_dictp dict) {
+    if (dict != Z_NULL)
+        dict->zfree(dict->opaque, (voidpf)dict);
+}
+
 int ZEXPORT inflateGetHeader(z_streamp strm, gz_headerp head) {
     struct inflate_state FAR *state;
 
@@ -1445,6 +1645,8 @@ int ZEXPORT inflateCopy(z_streamp dest, z_streamp source) {
     /* check input */
     if (inflateStateCheck(source) || dest == Z_NULL)
         return Z_STREAM_ERROR;
+    if (source->zfree == zarena_free)
+        return Z_MEM_ERROR;     /* no room in an inflateInitMem() block */
     state = (struct inflate_state FAR *)source->state;
 
     /* allocate space */
@@ -1518,6 +1720,89 @@ long ZEXPORT inflateMark(z_streamp strm) {
             (state->mode == MATCH ? state->was - state->length : 0));
 }
 
+int ZEXPORT inflateGetStats(z_streamp strm, z_inflate_stats *stats) {
+    if (inflateStateCheck(strm) || stats == Z_NULL) return Z_STREAM_ERROR;
+#ifdef INFLATE_STATS
+    *stats = ((struct inflate_state FAR *)strm->state)->stats;
+    return Z_OK;
+#else
+    zmemzero((voidpf)stats, sizeof(z_inflate_stats));
+    return Z_VERSION_ERROR;
+#endif
+}
+
+local void put_bytes(Bytef *buf, uLong val, unsigned n) {
+    while (n--) {
+        *buf++ = (Bytef)val;
+        val >>= 8;
+    }
+}
+
+local uLong get_bytes(const Bytef *buf, unsigned n) {
+    uLong val = 0;
+
+    buf += n;
+    while (n--)
+        val = (val << 8) + *--buf;
+    return val;
+}
+
+int ZEXPORT inflateCheckpoint(z_streamp strm, Bytef *buf, uLong *len) {
+    struct inflate_state FAR *state;
+    uLong need;
+
+    if (inflateStateCheck(strm) || len == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->mode != TYPE || state->last) return Z_STREAM_ERROR;
+    need = CKPT_HEAD + state->dsize + state->whave;
+    if (buf == Z_NULL) {
+        *len = need;
+        return Z_OK;
+    }
+    if (*len < need) {
+        *len = need;
+        return Z_BUF_ERROR;
+    }
+    *len = need;
+    buf[0] = CKPT_VERSION;
+    buf[1] = (Bytef)state->wbits;
+    buf[2] = (Bytef)state->bits;
+    buf[3] = (Bytef)(state->hold & ((1U << state->bits) - 1));
+    put_bytes(buf + 4, strm->total_in, 8);
+    put_bytes(buf + 12, strm->total_out, 8);
+    put_bytes(buf + 20, state->dsize + state->whave, 4);
+    return inflateGetDictionary(strm, buf + CKPT_HEAD, Z_NULL);
+}
+
+int ZEXPORT inflateRestore(z_streamp strm, const Bytef *buf, uLong len) {
+    struct inflate_state FAR *state;
+    unsigned wbits, bits, have;
+    int ret;
+
+    if (inflateStateCheck(strm) || buf == Z_NULL) return Z_STREAM_ERROR;
+    if (len < CKPT_HEAD || buf[0] != CKPT_VERSION)
+        return Z_DATA_ERROR;
+    wbits = buf[1];
+    bits = buf[2];
+    have = (unsigned)get_bytes(buf + 20, 4);
+    if (wbits < 8 || wbits > 15 || bits > 7 || (buf[3] >> bits) != 0 ||
+        have > (1U << wbits) || len != CKPT_HEAD + (uLong)have)
+        return Z_DATA_ERROR;
+    ret = inflateReset2(strm, -(int)wbits);
+    if (ret != Z_OK) return ret;
+    state = (struct inflate_state FAR *)strm->state;
+    state->hold = buf[3];
+    state->bits = bits;
+    if (have && updatewindow(strm, buf + CKPT_HEAD + have, have, 0)) {
+        state->mode = MEM;
+        return Z_MEM_ERROR;
+    }
+    strm->total_in = get_bytes(buf + 4, 8);
+    strm->total_out = get_bytes(buf + 12, 8);
+    Tracev((stderr, "inflate: restored at %lu\n", strm->total_in));
+    return Z_OK;
+}
+
 unsigned long ZEXPORT inflateCodesUsed(z_streamp strm) {
     struct inflate_state FAR *state;
     if (inflateStateCheck(strm)) return (unsigned long)-1;
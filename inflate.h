@@ -16,6 +16,14 @@
 #  define GUNZIP
 #endif
 
+/* Checkpoint format for inflateCheckpoint() and inflateRestore(): version,
+   window bits, number of unused bits, unused bits, total_in and total_out in
+   eight bytes each, the number of window bytes in four bytes, and then the
+   window bytes from the oldest to the newest.  The integers are little-endian.
+ */
+#define CKPT_VERSION 1
+#define CKPT_HEAD 24
+
 /* Possible inflate modes between inflate() calls */
 typedef enum {
     HEAD = 16180,   /* i: waiting for magic header */
@@ -98,6 +106,9 @@ struct inflate_state {
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if needed */
+    unsigned char FAR *dend;    /* end of inflateUseDictionary() data */
+    unsigned dsize;             /* bytes of that dictionary before the window,
+                                   reached by distances past whave */
         /* bit accumulator */
     unsigned long hold;         /* input bit accumulator */
     unsigned bits;              /* number of bits in hold */
@@ -123,4 +134,26 @@ struct inflate_state {
     int sane;                   /* if false, allow invalid distance too far */
     int back;                   /* bits back of last unprocessed length/lit */
     unsigned was;               /* initial length of match */
+    int over;                   /* true if inflate_fast() can write past the
+                                   end of a match, up to strm->avail_out */
+#ifdef INFLATE_STATS
+    z_inflate_stats stats;      /* counts returned by inflateGetStats() */
+#endif
 };
+
+/* A dictionary prepared by inflatePrepareDictionary(), which streams reference
+   in place of copying it into their windows. */
+struct z_inflate_dict_s {
+    free_func zfree;            /* to free this, from the preparing stream */
+    voidpf opaque;
+    uLong adler;                /* Adler-32 of the whole dictionary */
+    unsigned size;              /* bytes at data, the last 32K or less */
+    unsigned char FAR *data;    /* the end of the dictionary, after this */
+};
+
+/* Add n to the count in state->stats, if INFLATE_STATS is defined. */
+#ifdef INFLATE_STATS
+#  define STAT(state, count, n) ((state)->stats.count += (n))
+#else
+#  define STAT(state, count, n) ((void)0)
+#endif
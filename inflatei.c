@@ -0,0 +1,803 @@
+/* inflatei.c -- index a deflate stream for random access
+ * Copyright (C) 2005, 2012, 2018, 2023, 2024 Mark Adler
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      Decompression can resume at the start of any deflate block, given the
+ *      bit position of that block in the compressed data and the 32K bytes of
+ *      uncompressed data that precede it. inflateIndexBuild() decompresses the
+ *      whole stream once, a block at a time with Z_BLOCK, and when at least
+ *      span bytes of uncompressed data have gone by since the last access
+ *      point it saves a new one with inflateCheckpoint(). The window in a
+ *      checkpoint is recent output, which compresses well, so each is stored
+ *      as raw deflate data at level 1. The first access point is always the
+ *      start of the stream, which needs no checkpoint.
+ *
+ *      inflateIndexExtract() finds the last access point at or before the
+ *      requested offset with a binary search, decompresses its checkpoint,
+ *      resumes there with inflateRestore(), and decompresses and discards on
+ *      average span / 2 bytes before getting to the requested data. At the
+ *      end of a gzip member reached from a checkpoint, the trailer is skipped
+ *      and inflate() then decodes the header of the next member, if there is
+ *      one. This is the approach of examples/zran.c, which this replaces.
+ *
+ *      The index can be written with inflateIndexSave() and read back with
+ *      inflateIndexLoad(), in this format, with all integers little-endian:
+ *
+ *          4 bytes     "zidx"
+ *          1 byte      format version, 1
+ *          1 byte      0 for raw deflate, 1 for zlib, 2 for gzip
+ *          1 byte      window bits of the stream, 8..15
+ *          1 byte      zero
+ *          8 bytes     length of the compressed data
+ *          8 bytes     length of the uncompressed data
+ *          8 bytes     span requested when the index was built
+ *          4 bytes     number of access points n
+ *
+ *      followed by n access points, each being:
+ *
+ *          8 bytes     uncompressed offset
+ *          8 bytes     compressed offset
+ *          4 bytes     length of the checkpoint, or zero for the start
+ *          4 bytes     length of the compressed checkpoint, clen
+ *          clen bytes  the checkpoint, compressed as raw deflate data
+ *
+ *      and then a 4-byte CRC-32 of everything before it. The offsets increase,
+ *      and the first access point is at the start, with zero offsets and
+ *      lengths. A checkpoint is as written by inflateCheckpoint().
+ */
+
+/* @(#) $Id$ */
+
+#include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+
+#define IX_WINDOW 32768U                /* size of a deflate window */
+#define IX_CKPT (CKPT_HEAD + IX_WINDOW) /* largest checkpoint */
+#define IX_HEAD 36                      /* length of the index header */
+#define IX_POINT 24                     /* length of an access point header */
+#define IX_MAGIC "zidx"
+#define IX_VERSION 1
+
+/* An access point, where decompression can resume. */
+typedef struct {
+    z_off64_t out;      /* uncompressed offset */
+    z_off64_t in;       /* compressed offset */
+    uLong len;          /* length of the checkpoint, zero for the start */
+    uLong clen;         /* length of the compressed checkpoint */
+    Bytef *ckpt;        /* compressed checkpoint, or Z_NULL for the start */
+} ix_point;
+
+/* The index. strm carries the allocation functions, and is the inflate engine
+   for inflateIndexExtract() once it has been initialized. */
+struct z_index_s {
+    int wrap;           /* 0 for raw deflate, 1 for zlib, 2 for gzip */
+    int wbits;          /* window bits of the stream */
+    z_off64_t in;       /* length of the compressed data */
+    z_off64_t out;      /* length of the uncompressed data */
+    z_off64_t span;     /* requested uncompressed data between points */
+    unsigned long have; /* number of access points */
+    unsigned long size; /* number of access points allocated in list */
+    ix_point *list;     /* the access points */
+    Bytef *buf;         /* IX_CKPT bytes of space, or Z_NULL */
+    z_stream strm;      /* allocation, and raw inflate once state is set */
+};
+
+/* Allocate an empty index, with strm's allocation functions. Return Z_NULL if
+   out of memory. */
+local z_indexp ix_alloc(z_streamp strm) {
+    z_indexp index;
+
+    index = (z_indexp)ZALLOC(strm, 1, sizeof(struct z_index_s));
+    if (index == Z_NULL)
+        return Z_NULL;
+    zmemzero(index, sizeof(struct z_index_s));
+    index->strm.zalloc = strm->zalloc;
+    index->strm.zfree = strm->zfree;
+    index->strm.opaque = strm->opaque;
+    return index;
+}
+
+/* Make room for one more access point. Return a pointer to it, or Z_NULL if
+   out of memory. */
+local ix_point *ix_room(z_indexp index) {
+    ix_point *list;
+    unsigned long size, i;
+
+    if (index->have < index->size)
+        return index->list + index->have;
+    size = index->size ? index->size << 1 : 64;
+    if (size < index->size || (uInt)size != size ||
+        (size_t)size > (size_t)-1 / sizeof(ix_point))
+        return Z_NULL;
+    list = (ix_point *)ZALLOC(&index->strm, (uInt)size, sizeof(ix_point));
+    if (list == Z_NULL)
+        return Z_NULL;
+    for (i = 0; i < index->have; i++)
+        list[i] = index->list[i];
+    if (index->list != Z_NULL)
+        ZFREE(&index->strm, index->list);
+    index->list = list;
+    index->size = size;
+    return list + index->have;
+}
+
+/* Write n bytes of the little-endian integer val to buf. */
+local void ix_put(Bytef *buf, z_off64_t val, int n) {
+    while (n--) {
+        *buf++ = (Bytef)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+/* Return the n-byte little-endian integer at buf. */
+local z_off64_t ix_get(const Bytef *buf, int n) {
+    z_off64_t val = 0;
+
+    while (n--)
+        val = (val << 8) + buf[n];
+    return val;
+}
+
+/* Add an access point with the checkpoint ckpt[0..len-1], at compressed offset
+   in and uncompressed offset out, compressing it with the raw deflate stream
+   def into scratch[0..bound-1]. Return Z_OK, or Z_MEM_ERROR if out of memory.
+ */
+local int ix_keep(z_indexp index, const Bytef *ckpt, uLong len, z_off64_t in,
+                  z_off64_t out, z_streamp def, Bytef *scratch, uLong bound) {
+    ix_point *point;
+    int ret;
+
+    point = ix_room(index);
+    if (point == Z_NULL)
+        return Z_MEM_ERROR;
+    def->next_in = (z_const Bytef *)ckpt;
+    def->avail_in = (uInt)len;
+    def->next_out = scratch;
+    def->avail_out = (uInt)bound;
+    ret = deflate(def, Z_FINISH);
+    point->clen = bound - def->avail_out;
+    deflateReset(def);
+    if (ret != Z_STREAM_END)
+        return Z_MEM_ERROR;
+    point->ckpt = (Bytef *)ZALLOC(&index->strm, (uInt)point->clen, 1);
+    if (point->ckpt == Z_NULL)
+        return Z_MEM_ERROR;
+    zmemcpy(point->ckpt, scratch, (uInt)point->clen);
+    point->out = out;
+    point->in = in;
+    point->len = len;
+    index->have++;
+    return Z_OK;
+}
+
+/* Add an access point with the checkpoint at the current position of strm,
+   as for ix_keep(). index->buf is used for the checkpoint. */
+local int ix_add(z_indexp index, z_streamp strm, z_off64_t in, z_off64_t out,
+                 z_streamp def, Bytef *scratch, uLong bound) {
+    uLong len = IX_CKPT;
+
+    if (inflateCheckpoint(strm, index->buf, &len) != Z_OK)
+        return Z_OK;
+    return ix_keep(index, index->buf, len, in, out, def, scratch, bound);
+}
+
+/* Set up def to compress checkpoints, with strm's allocation functions, and
+   allocate *scratch for its output of at most *bound bytes. Return Z_OK or
+   Z_MEM_ERROR. def->state is Z_NULL if def was not initialized. */
+local int ix_deflate(z_streamp strm, z_streamp def, Bytef **scratch,
+                     uLong *bound) {
+    int ret;
+
+    def->zalloc = strm->zalloc;
+    def->zfree = strm->zfree;
+    def->opaque = strm->opaque;
+    def->state = Z_NULL;
+    *scratch = Z_NULL;
+    ret = deflateInit2(def, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK)
+        return ret;
+    *bound = deflateBound(def, IX_CKPT);
+    *scratch = (Bytef *)ZALLOC(strm, (uInt)*bound, 1);
+    return *scratch == Z_NULL ? Z_MEM_ERROR : Z_OK;
+}
+
+/* Add the access point at the start of the stream. Return Z_OK, or Z_MEM_ERROR
+   if out of memory. */
+local int ix_start(z_indexp index) {
+    ix_point *point;
+
+    point = ix_room(index);
+    if (point == Z_NULL)
+        return Z_MEM_ERROR;
+    point->out = point->in = 0;
+    point->len = point->clen = 0;
+    point->ckpt = Z_NULL;
+    index->have++;
+    return Z_OK;
+}
+
+/* The windowBits for inflateInit2() or inflateReset2() to decode the stream
+   in index from the start of it or of a gzip member. */
+local int ix_bits(z_indexp index) {
+    return index->wrap == 0 ? -index->wbits :
+           index->wrap == 1 ? index->wbits : index->wbits + 16;
+}
+
+/* Get more input for strm from in() if there is none, unless *eof is set, in
+   which case in() has already returned zero. Set *eof if in() returns zero.
+   Return the number of bytes available at next_in. */
+local unsigned ix_more(z_streamp strm, in_func in, void FAR *desc, int *eof) {
+    if (strm->avail_in == 0 && !*eof) {
+        strm->avail_in = in(desc, &strm->next_in);
+        if (strm->avail_in == 0) {
+            strm->next_in = Z_NULL;
+            *eof = 1;
+        }
+    }
+    return strm->avail_in;
+}
+
+/* -- see zlib.h -- */
+void ZEXPORT inflateIndexFree(z_indexp index) {
+    if (index == Z_NULL)
+        return;
+    while (index->have)
+        if (index->list[--index->have].ckpt != Z_NULL)
+            ZFREE(&index->strm, index->list[index->have].ckpt);
+    if (index->list != Z_NULL)
+        ZFREE(&index->strm, index->list);
+    if (index->buf != Z_NULL)
+        ZFREE(&index->strm, index->buf);
+    if (index->strm.state != Z_NULL)
+        inflateEnd(&index->strm);
+    ZFREE(&index->strm, index);
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexBuild(z_streamp strm, int windowBits, uLong span,
+                              in_func in, void FAR *in_desc,
+                              z_indexp FAR *built) {
+    z_indexp index;
+    z_stream def;
+    Bytef *scratch = Z_NULL;
+    uLong bound = 0;
+    z_off64_t pos = 0, out = 0, last = 0;
+    unsigned long more;
+    unsigned had;
+    int ret, eof = 0;
+
+    /* check the parameters and set up */
+    if (built == Z_NULL)
+        return Z_STREAM_ERROR;
+    *built = Z_NULL;
+    if (strm == Z_NULL || in == Z_NULL)
+        return Z_STREAM_ERROR;
+    if (strm->next_in == Z_NULL)
+        strm->avail_in = 0;
+    ret = inflateInit2(strm, windowBits);
+    if (ret != Z_OK)
+        return ret;
+    index = ix_alloc(strm);
+    if (index == Z_NULL) {
+        inflateEnd(strm);
+        return Z_MEM_ERROR;
+    }
+    index->wrap = -1;
+    index->span = span ? (z_off64_t)span : 1048576;
+    index->buf = (Bytef *)ZALLOC(strm, IX_CKPT, 1);
+    def.state = Z_NULL;
+    ret = index->buf == Z_NULL ? Z_MEM_ERROR :
+          ix_deflate(strm, &def, &scratch, &bound);
+    if (ret == Z_OK)
+        ret = ix_start(index);
+
+    /* decompress the stream a block at a time, adding access points */
+    while (ret == Z_OK) {
+        ix_more(strm, in, in_desc, &eof);
+        strm->next_out = index->buf;
+        strm->avail_out = IX_WINDOW;
+        had = strm->avail_in;
+        ret = inflate(strm, Z_BLOCK);
+        pos += had - strm->avail_in;
+        out += IX_WINDOW - strm->avail_out;
+        if (ret == Z_BUF_ERROR && !eof)
+            ret = Z_OK;
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            break;
+
+        /* note the type of stream once the header has been decoded */
+        if (index->wrap == -1 &&
+            (ret == Z_STREAM_END || (strm->data_type & 0x80))) {
+            struct inflate_state FAR *state =
+                (struct inflate_state FAR *)strm->state;
+
+            index->wrap = state->flags == -1 ? 0 : state->flags == 0 ? 1 : 2;
+            index->wbits = (int)state->wbits;
+        }
+
+        /* add an access point at the start of a block after span bytes */
+        if ((strm->data_type & 0xc0) == 0x80 && out - last >= index->span) {
+            more = index->have;
+            ret = ix_add(index, strm, pos, out, &def, scratch, bound);
+            if (index->have > more)
+                last = out;
+            if (ret != Z_OK)
+                break;
+        }
+
+        /* continue with the next gzip member, if there is more input */
+        if (ret == Z_STREAM_END && index->wrap == 2 &&
+            ix_more(strm, in, in_desc, &eof))
+            ret = inflateReset(strm);
+    }
+
+    /* clean up, and return the index on success */
+    if (scratch != Z_NULL)
+        ZFREE(strm, scratch);
+    if (def.state != Z_NULL)
+        deflateEnd(&def);
+    inflateEnd(strm);
+    if (ret != Z_STREAM_END) {
+        inflateIndexFree(index);
+        return ret;
+    }
+    index->in = pos;
+    index->out = out;
+    *built = index;
+    return Z_OK;
+}
+
+/* State for the index() and out() functions of inflateParallel2(), used by
+   inflateIndexParallel(). */
+typedef struct {
+    z_indexp index;     /* the index being built */
+    z_stream def;       /* raw deflate to compress the checkpoints */
+    Bytef *scratch;     /* space for a compressed checkpoint */
+    uLong bound;        /* size of scratch */
+    z_off64_t last;     /* uncompressed offset of the last access point */
+    int ret;            /* Z_OK, or Z_MEM_ERROR if out of memory */
+} ix_par;
+
+/* Discard the decompressed data. */
+local int ix_discard(void FAR *desc, unsigned char FAR *buf, unsigned len) {
+    (void)desc;
+    (void)buf;
+    (void)len;
+    return 0;
+}
+
+/* Keep the checkpoint in buf[0..len-1] as an access point, if it is at least
+   span bytes of uncompressed data after the last one. */
+local int ix_point_at(void FAR *desc, unsigned char FAR *buf, unsigned len) {
+    ix_par *par = (ix_par *)desc;
+    z_off64_t in, out;
+
+    if (len < CKPT_HEAD || len > IX_CKPT)
+        return 0;
+    in = ix_get(buf + 4, 8);
+    out = ix_get(buf + 12, 8);
+    if (out - par->last < par->index->span)
+        return 0;
+    par->ret = ix_keep(par->index, buf, len, in, out, &par->def, par->scratch,
+                       par->bound);
+    par->last = out;
+    return par->ret != Z_OK;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexParallel(z_streamp strm, int windowBits, uLong span,
+                                 int threads, z_indexp FAR *built) {
+    ix_par par;
+    z_indexp index;
+    z_const Bytef *in;
+    uLong chunk;
+    int ret;
+
+    /* check the parameters and set up */
+    if (built == Z_NULL)
+        return Z_STREAM_ERROR;
+    *built = Z_NULL;
+    if (strm == Z_NULL || (strm->avail_in && strm->next_in == Z_NULL) ||
+        windowBits == 0 || threads < 1)
+        return Z_STREAM_ERROR;
+#ifndef Z_SOLO
+    if (strm->zalloc == (alloc_func)0) {
+        strm->zalloc = zcalloc;
+        strm->opaque = (voidpf)0;
+    }
+    if (strm->zfree == (free_func)0)
+        strm->zfree = zcfree;
+#else
+    if (strm->zalloc == (alloc_func)0 || strm->zfree == (free_func)0)
+        return Z_STREAM_ERROR;
+#endif
+    index = ix_alloc(strm);
+    if (index == Z_NULL)
+        return Z_MEM_ERROR;
+    index->span = span ? (z_off64_t)span : 1048576;
+    in = strm->next_in;             /* start of the stream, for its header */
+    par.index = index;
+    par.last = 0;
+    par.ret = ix_deflate(strm, &par.def, &par.scratch, &par.bound);
+    if (par.ret == Z_OK)
+        par.ret = ix_start(index);
+
+    /* decompress the stream on threads, keeping the checkpoints made where
+       the regions meet -- the regions are a quarter of the span, which is
+       about the compressed size of span bytes of typical data */
+    ret = par.ret;
+    if (ret == Z_OK) {
+        chunk = (uLong)(index->span >> 2);
+        if (chunk == 0)
+            chunk = 1;
+        if (chunk > 0x1000000UL)
+            chunk = 0x1000000UL;
+        ret = inflateParallel2(strm, windowBits, threads, chunk, ix_discard,
+                               Z_NULL, ix_point_at, &par);
+        if (ret == Z_BUF_ERROR && par.ret != Z_OK)
+            ret = par.ret;
+    }
+
+    /* note the type of stream, as inflateParallel2() found it */
+    if (ret == Z_STREAM_END) {
+        if (windowBits < 0) {
+            index->wrap = 0;
+            index->wbits = -windowBits;
+        }
+        else if (windowBits > 15 &&
+                 (windowBits < 32 || (in[0] == 31 && in[1] == 139))) {
+            index->wrap = 2;
+            index->wbits = windowBits & 15;
+        }
+        else {
+            index->wrap = 1;
+            index->wbits = (in[0] >> 4) + 8;
+        }
+    }
+
+    /* clean up, and return the index on success */
+    if (par.scratch != Z_NULL)
+        ZFREE(strm, par.scratch);
+    if (par.def.state != Z_NULL)
+        deflateEnd(&par.def);
+    if (ret != Z_STREAM_END) {
+        inflateIndexFree(index);
+        return ret;
+    }
+    index->in = (z_off64_t)strm->total_in;
+    index->out = (z_off64_t)strm->total_out;
+    *built = index;
+    return Z_OK;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexExtract(z_indexp index, z_off64_t offset, Bytef *buf,
+                                uLong FAR *len, in_func in, seek_func seek,
+                                void FAR *desc) {
+    z_streamp strm;
+    ix_point *point;
+    unsigned long lo, hi, mid;
+    z_off64_t skip;
+    uLong want, got = 0;
+    unsigned had;
+    int ret, eof = 0;
+
+    /* check the parameters */
+    if (index == Z_NULL || len == Z_NULL || (buf == Z_NULL && *len) ||
+        in == Z_NULL || seek == Z_NULL || offset < 0)
+        return Z_STREAM_ERROR;
+    want = *len;
+    *len = 0;
+    if (want == 0 || offset >= index->out)
+        return Z_OK;
+
+    /* find the last access point at or before offset */
+    lo = 1;
+    hi = index->have;
+    while (lo < hi) {
+        mid = lo + ((hi - lo) >> 1);
+        if (index->list[mid].out <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    point = index->list + lo - 1;
+
+    /* set up the inflate engine the first time */
+    strm = &index->strm;
+    if (strm->state == Z_NULL) {
+        ret = inflateInit2(strm, -15);
+        if (ret != Z_OK)
+            return ret;
+    }
+    if (index->buf == Z_NULL) {
+        index->buf = (Bytef *)ZALLOC(strm, IX_CKPT, 1);
+        if (index->buf == Z_NULL)
+            return Z_MEM_ERROR;
+    }
+
+    /* go to the access point */
+    if (point->ckpt == Z_NULL)
+        ret = inflateReset2(strm, ix_bits(index));
+    else {
+        ret = inflateReset2(strm, -15);
+        if (ret != Z_OK)
+            return ret;
+        strm->next_in = point->ckpt;
+        strm->avail_in = (uInt)point->clen;
+        strm->next_out = index->buf;
+        strm->avail_out = IX_CKPT;
+        ret = inflate(strm, Z_FINISH);
+        if (ret != Z_STREAM_END || strm->total_out != point->len) {
+            strm->msg = (z_const char *)"invalid access point";
+            return Z_DATA_ERROR;
+        }
+        ret = inflateRestore(strm, index->buf, point->len);
+    }
+    if (ret != Z_OK)
+        return ret;
+    strm->next_in = Z_NULL;
+    strm->avail_in = 0;
+    if (seek(desc, point->in))
+        return Z_BUF_ERROR;
+
+    /* decompress, discarding the data before offset */
+    skip = offset - point->out;
+    do {
+        if (skip) {
+            strm->next_out = index->buf;
+            strm->avail_out = skip < (z_off64_t)IX_WINDOW ? (uInt)skip :
+                              IX_WINDOW;
+        }
+        else {
+            strm->next_out = buf + got;
+            strm->avail_out = want - got > (uInt)-1 ? (uInt)-1 :
+                              (uInt)(want - got);
+        }
+        ix_more(strm, in, desc, &eof);
+        had = strm->avail_out;
+        ret = inflate(strm, Z_NO_FLUSH);
+        had -= strm->avail_out;
+        if (skip)
+            skip -= had;
+        else
+            got += had;
+        if (ret == Z_BUF_ERROR && !eof)
+            ret = Z_OK;
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            break;
+
+        /* continue with the next gzip member, if there is one */
+        if (ret == Z_STREAM_END && index->wrap == 2) {
+            struct inflate_state FAR *state =
+                (struct inflate_state FAR *)strm->state;
+
+            if (state->flags == -1) {
+                /* resumed raw from a checkpoint -- skip the gzip trailer */
+                unsigned drop = 8;
+
+                while (drop && ix_more(strm, in, desc, &eof)) {
+                    had = drop < strm->avail_in ? drop : strm->avail_in;
+                    strm->next_in += had;
+                    strm->avail_in -= had;
+                    drop -= had;
+                }
+                if (drop) {
+                    ret = Z_BUF_ERROR;
+                    break;
+                }
+            }
+            if (ix_more(strm, in, desc, &eof)) {
+                ret = inflateReset2(strm, ix_bits(index));
+                if (ret != Z_OK)
+                    break;
+            }
+        }
+    } while (ret == Z_OK && got < want);
+
+    /* return the amount extracted */
+    *len = got;
+    return ret == Z_STREAM_END || got == want ? Z_OK : ret;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexInfo(z_indexp index, z_off64_t FAR *length,
+                             z_off64_t FAR *compressed,
+                             unsigned long FAR *points) {
+    if (index == Z_NULL)
+        return Z_STREAM_ERROR;
+    if (length != Z_NULL)
+        *length = index->out;
+    if (compressed != Z_NULL)
+        *compressed = index->in;
+    if (points != Z_NULL)
+        *points = index->have;
+    return Z_OK;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexSave(z_indexp index, out_func out, void FAR *out_desc) {
+    Bytef head[IX_HEAD];
+    ix_point *point;
+    uLong crc;
+
+    if (index == Z_NULL || out == Z_NULL)
+        return Z_STREAM_ERROR;
+    zmemcpy(head, IX_MAGIC, 4);
+    head[4] = IX_VERSION;
+    head[5] = (Bytef)index->wrap;
+    head[6] = (Bytef)index->wbits;
+    head[7] = 0;
+    ix_put(head + 8, index->in, 8);
+    ix_put(head + 16, index->out, 8);
+    ix_put(head + 24, index->span, 8);
+    ix_put(head + 32, (z_off64_t)index->have, 4);
+    crc = crc32(0, head, IX_HEAD);
+    if (out(out_desc, head, IX_HEAD))
+        return Z_BUF_ERROR;
+    for (point = index->list; point < index->list + index->have; point++) {
+        ix_put(head, point->out, 8);
+        ix_put(head + 8, point->in, 8);
+        ix_put(head + 16, (z_off64_t)point->len, 4);
+        ix_put(head + 20, (z_off64_t)point->clen, 4);
+        crc = crc32(crc, head, IX_POINT);
+        if (out(out_desc, head, IX_POINT))
+            return Z_BUF_ERROR;
+        if (point->clen) {
+            crc = crc32(crc, point->ckpt, (uInt)point->clen);
+            if (out(out_desc, point->ckpt, (unsigned)point->clen))
+                return Z_BUF_ERROR;
+        }
+    }
+    ix_put(head, (z_off64_t)crc, 4);
+    return out(out_desc, head, 4) ? Z_BUF_ERROR : Z_OK;
+}
+
+/* Input for inflateIndexLoad(). */
+typedef struct {
+    in_func in;                 /* input function */
+    void FAR *desc;             /* its opaque argument */
+    z_const Bytef *next;        /* next input byte */
+    unsigned have;              /* number of bytes available at next */
+    uLong crc;                  /* CRC-32 of the bytes read so far */
+} ix_input;
+
+/* Read len bytes to buf. Return 0 on success, or -1 if the input ended. */
+local int ix_read(ix_input *s, Bytef *buf, uLong len) {
+    unsigned n;
+
+    while (len) {
+        if (s->have == 0) {
+            s->have = s->in(s->desc, &s->next);
+            if (s->have == 0)
+                return -1;
+        }
+        n = s->have < len ? s->have : (unsigned)len;
+        s->crc = crc32(s->crc, s->next, n);
+        zmemcpy(buf, s->next, n);
+        s->next += n;
+        s->have -= n;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT inflateIndexLoad(z_streamp strm, in_func in, void FAR *in_desc,
+                             z_indexp FAR *loaded) {
+    ix_input s;
+    Bytef head[IX_HEAD];
+    z_indexp index;
+    ix_point *point, *prev;
+    z_off64_t count;
+    uLong crc;
+
+    /* check the parameters */
+    if (loaded == Z_NULL)
+        return Z_STREAM_ERROR;
+    *loaded = Z_NULL;
+    if (strm == Z_NULL || in == Z_NULL)
+        return Z_STREAM_ERROR;
+#ifndef Z_SOLO
+    if (strm->zalloc == (alloc_func)0) {
+        strm->zalloc = zcalloc;
+        strm->opaque = (voidpf)0;
+    }
+    if (strm->zfree == (free_func)0)
+        strm->zfree = zcfree;
+#else
+    if (strm->zalloc == (alloc_func)0 || strm->zfree == (free_func)0)
+        return Z_STREAM_ERROR;
+#endif
+    s.in = in;
+    s.desc = in_desc;
+    s.next = Z_NULL;
+    s.have = 0;
+    s.crc = crc32(0, Z_NULL, 0);
+
+    /* read and check the header */
+    if (ix_read(&s, head, IX_HEAD))
+        return Z_BUF_ERROR;
+    if (zmemcmp(head, IX_MAGIC, 4) || head[4] != IX_VERSION || head[5] > 2 ||
+        head[6] < 8 || head[6] > 15 || head[7] != 0)
+        return Z_DATA_ERROR;
+    count = ix_get(head + 32, 4);
+    if (count == 0)
+        return Z_DATA_ERROR;
+    index = ix_alloc(strm);
+    if (index == Z_NULL)
+        return Z_MEM_ERROR;
+    index->wrap = head[5];
+    index->wbits = head[6];
+    index->in = ix_get(head + 8, 8);
+    index->out = ix_get(head + 16, 8);
+    index->span = ix_get(head + 24, 8);
+    if (index->in < 0 || index->out < 0 || index->span < 0) {
+        inflateIndexFree(index);
+        return Z_DATA_ERROR;
+    }
+
+    /* read and check the access points */
+    while (index->have < (unsigned long)count) {
+        point = ix_room(index);
+        if (point == Z_NULL) {
+            inflateIndexFree(index);
+            return Z_MEM_ERROR;
+        }
+        if (ix_read(&s, head, IX_POINT)) {
+            inflateIndexFree(index);
+            return Z_BUF_ERROR;
+        }
+        point->out = ix_get(head, 8);
+        point->in = ix_get(head + 8, 8);
+        point->len = (uLong)ix_get(head + 16, 4);
+        point->clen = (uLong)ix_get(head + 20, 4);
+        point->ckpt = Z_NULL;
+        prev = index->have ? point - 1 : Z_NULL;
+        if (prev == Z_NULL ? point->out || point->in || point->len ||
+                             point->clen :
+            point->out <= prev->out || point->in <= prev->in ||
+            point->out > index->out || point->in > index->in ||
+            point->len <= CKPT_HEAD || point->len > IX_CKPT ||
+            point->clen == 0 || point->clen > IX_CKPT + (IX_CKPT >> 3)) {
+            inflateIndexFree(index);
+            return Z_DATA_ERROR;
+        }
+        if (point->clen) {
+            point->ckpt = (Bytef *)ZALLOC(strm, (uInt)point->clen, 1);
+            if (point->ckpt == Z_NULL) {
+                inflateIndexFree(index);
+                return Z_MEM_ERROR;
+            }
+        }
+        index->have++;
+        if (point->clen && ix_read(&s, point->ckpt, point->clen)) {
+            inflateIndexFree(index);
+            return Z_BUF_ERROR;
+        }
+    }
+
+    /* check the CRC-32 */
+    crc = s.crc;
+    if (ix_read(&s, head, 4)) {
+        inflateIndexFree(index);
+        return Z_BUF_ERROR;
+    }
+    if ((uLong)ix_get(head, 4) != crc) {
+        inflateIndexFree(index);
+        return Z_DATA_ERROR;
+    }
+    *loaded = index;
+    return Z_OK;
+}
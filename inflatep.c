@@ -0,0 +1,1456 @@
+/* inflatep.c -- decompress data using multiple threads
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      A deflate stream can only be decoded from a point where the bit
+ *      position and the preceding window's worth of data are known. Two kinds
+ *      of points are always byte-aligned: the start of a gzip member, and the
+ *      block after an empty stored block, which is what a sync or full flush
+ *      writes, ending in the bytes 00 00 ff ff. After a full flush, or at the
+ *      start of a member, no data before that point is referenced. Writers
+ *      such as deflateParallel() with Z_FULL_FLUSH, pigz -i, and bgzip make
+ *      such points at regular intervals.
+ *
+ *      The input is divided into regions of chunk bytes. For each region a
+ *      worker thread finds the first candidate point in it, either a gzip
+ *      header or a position after 00 00 ff ff, and decodes from there with an
+ *      empty window until it reaches a point of the same kind at or after the
+ *      start of the next region. Decoding from a true point finds all of the
+ *      true points that follow, so if the next region's candidate is a true
+ *      point, the two decodings meet exactly there. A candidate can be false,
+ *      since those bytes can appear anywhere in compressed data, and decoding
+ *      without the window fails with "invalid distance too far back" after a
+ *      sync flush that is not a full flush. The application's thread joins the
+ *      regions in order, and uses a region's output only if its decoding
+ *      started exactly where the previous region's ended, and completed
+ *      without error. Otherwise the region is decoded again by the
+ *      application's thread, from where the previous one ended and with the
+ *      window of the data before it. The output is then always what a serial
+ *      inflate would produce.
+ *
+ *      Those points are not enough for a stream with a single member that was
+ *      compressed without flushes. For that, a worker also tries every bit
+ *      position in its region where the header of a dynamic block that is not
+ *      the last block could start. It decodes from there without the window,
+ *      writing 16-bit symbols in which 256 + i stands for byte i of the
+ *      unknown 32K window before the point (the approach of rapidgzip). A
+ *      false candidate is very likely to fail to decode within its first
+ *      block, and the next candidate is tried. Once the last 32K symbols no
+ *      longer refer to the unknown window, the window is known, and the worker
+ *      continues with inflate(). When the application's thread joins such a
+ *      region, the window before it is known, and the references are resolved
+ *      before the output is used. The regions end at the first candidate point
+ *      of any kind at or after the start of the next region, found in deflate
+ *      data only at block boundaries. The starts of blocks that are fixed,
+ *      stored, or last are not candidates, so streams without dynamic blocks
+ *      are decoded serially except at members and flushes.
+ *
+ *      Each worker computes the check value of its output, and verifies the
+ *      trailers of the gzip members that start and end in its region. The
+ *      application's thread combines the check values of the regions in order
+ *      with crc32_combine() or adler32_combine() to verify the trailers of the
+ *      members that span regions. If there are no threads, or only one, then
+ *      the application's thread decodes the whole stream serially.
+ */
+
+/* @(#) $Id$ */
+
+#include "zthread.h"
+#include "inftrees.h"
+#include "inflate.h"
+
+/* fixed codes for the speculative decoding of fixed blocks */
+#include "inffixed.h"
+
+#define PAR_CHUNK 524288UL              /* default region size */
+#define PAR_MAX_CHUNK 0x1000000UL       /* largest permitted region size */
+#define PAR_GROW 32     /* most output per region, as a multiple of chunk */
+#define PAR_WINDOW 32768U               /* size of a deflate window */
+
+/* A position in the input is the offset pos of the next byte, and the number
+   of bits of the byte before it that are not yet used. True if the position is
+   at or after the start of byte end. */
+#define PAR_AT(pos, bits, end) \
+    ((pos) > (end) || ((pos) == (end) && (bits) == 0))
+
+/* Where a job is in the stream it is decoding. */
+typedef enum {
+    PAR_HEAD,           /* at a gzip header */
+    PAR_WIDE,           /* in deflate blocks, without the preceding window */
+    PAR_DATA,           /* in deflate blocks */
+    PAR_TRAIL           /* at a zlib or gzip trailer */
+} par_mode;
+
+/* Why a job stopped. */
+typedef enum {
+    PAR_NONE,           /* the region has no candidate point */
+    PAR_PAUSE,          /* the output buffer is full, more to come */
+    PAR_STOP,           /* reached a point at or after the end of the region */
+    PAR_END             /* reached the end of the stream */
+} par_why;
+
+/* A region of input and its decompressed data. */
+typedef struct par_job_s par_job;
+struct par_job_s {
+    par_job *next;      /* next job in stream order, or next free job */
+    uLong from;         /* start of the region in the input */
+    uLong to;           /* end of the region in the input */
+    uLong begin;        /* where decoding started */
+    int begin_bits;     /* unused bits of the byte before begin */
+    uLong pos;          /* input position reached */
+    int bits;           /* unused bits of the byte before pos */
+    par_mode mode;      /* what is at pos */
+    par_why why;        /* why decoding stopped */
+    int done;           /* true when the job has been decoded */
+    int ret;            /* Z_OK, or an error from decoding */
+    const char *msg;    /* error message, or Z_NULL */
+    z_stream strm;      /* raw inflate stream */
+    Bytef *buf;         /* allocated buffer for decompressed data */
+    uInt alloc;         /* allocated size of buf */
+    Bytef *out;         /* decompressed data, in buf or at next_out */
+    uInt size;          /* space at out */
+    uInt have;          /* number of bytes in out */
+    int member;         /* true if the current member started in this job */
+    int ends;           /* true if a member that started before ended here */
+    uLong check;        /* check value of the output since the job started
+                           or since the current member started */
+    uLong len;          /* length of that output */
+    uLong lead;         /* check value of the output up to the first trailer,
+                           if ends is true */
+    uLong lead_len;     /* length of that output */
+    uLong want;         /* check value in that trailer */
+    uLong want_len;     /* length in that trailer, modulo 2^32 */
+    uLong last;         /* check value of the last member completed */
+    unsigned short *wide;   /* output decoded without the window, where
+                               256 + i is byte i of the unknown window */
+    uLong wlen;         /* number of symbols in wide */
+    uLong walloc;       /* allocated size of wide */
+    uLong wmark;        /* number of symbols through the last unknown one */
+    unsigned wfar;      /* farthest back an unknown symbol is, from begin */
+    int blocks;         /* number of blocks decoded to wide */
+    Bytef *win;         /* allocated window for leaving PAR_WIDE mode */
+};
+
+/* The parallel inflate state, for the duration of inflateParallel(). */
+typedef struct {
+    z_streamp strm;     /* the application's stream */
+    const Bytef *in;    /* the input */
+    uLong length;       /* length of the input */
+    uLong start;        /* where the deflate data or first member starts */
+    int wrap;           /* 0 for raw, 1 for zlib, 2 for gzip */
+    int wbits;          /* window bits for decoding */
+    uLong chunk;        /* size of the regions */
+    uInt grow;          /* most output buffered for a region */
+    out_func out;       /* output function, or Z_NULL to use next_out */
+    void FAR *out_desc; /* opaque argument for out */
+    out_func index;     /* index function, or Z_NULL */
+    void FAR *index_desc;   /* opaque argument for index */
+    Bytef *mark;        /* allocated space for an index checkpoint */
+    uLong wmax;         /* most symbols in wide before writing them */
+    Bytef *res;         /* allocated table to map symbols to bytes */
+    uLong pos;          /* input position verified so far */
+    int bits;           /* unused bits of the byte before pos */
+    par_mode mode;      /* what is at pos */
+    uLong check;        /* check value of the current member so far */
+    uLong len;          /* length of the current member so far */
+    uLong next;         /* start of the next region to submit */
+    Bytef *dict;        /* the last 32K of output (or less) */
+    uInt dlen;          /* number of bytes in dict */
+    par_job *first;     /* oldest job submitted and not yet written */
+    par_job *last;      /* newest job submitted */
+    par_job *todo;      /* oldest job not yet taken by a worker */
+    par_job *spare;     /* list of jobs available for reuse */
+    int jobs;           /* number of jobs from first to last */
+    int max;            /* maximum number of jobs in progress */
+#ifdef HAVE_THREADS
+    zthread *pool;      /* the worker threads */
+    int running;        /* number of worker threads started */
+    int quit;           /* true to make the workers exit */
+    zmutex lock;        /* protects todo, done, and quit */
+    zcond work;         /* signaled when todo is set or quit is set */
+    zcond ready;        /* signaled when a job is done */
+#endif
+} par_state;
+
+/* Return true if a gzip header might start at in[0..len-1]. */
+local int par_gzip(const Bytef *in, uLong len) {
+    return len >= 4 && in[0] == 31 && in[1] == 139 && in[2] == 8 &&
+           (in[3] & 0xe0) == 0;
+}
+
+/* Return true if pos follows the bytes written by a sync or full flush. */
+local int par_sync(const Bytef *in, uLong pos) {
+    return pos >= 4 && in[pos - 4] == 0 && in[pos - 3] == 0 &&
+           in[pos - 2] == 0xff && in[pos - 1] == 0xff;
+}
+
+/* Return true if (pos, bits) might be where a dynamic block that is not the
+   last block starts, or if it follows a sync or full flush. For a dynamic
+   block, the header must have valid numbers of codes, and a complete code for
+   the code lengths. */
+local int par_point(par_state *s, uLong pos, int bits) {
+    const Bytef *in = s->in;
+    unsigned long val;
+    unsigned skip, ncode, sum, len, at;
+
+    if (bits == 0 && par_sync(in, pos))
+        return 1;
+    if (bits)
+        pos--;
+    if (s->length - pos < 12)
+        return 0;
+    skip = bits ? 8 - (unsigned)bits : 0;
+    val = ((unsigned long)in[pos] | ((unsigned long)in[pos + 1] << 8) |
+           ((unsigned long)in[pos + 2] << 16)) >> skip;
+    if ((val & 7) != 4 || ((val >> 3) & 0x1f) > 29 || ((val >> 8) & 0x1f) > 29)
+        return 0;
+    ncode = ((val >> 13) & 0xf) + 4;
+    sum = 0;
+    for (at = skip + 17; ncode--; at += 3) {
+        len = ((in[pos + (at >> 3)] | ((unsigned)in[pos + (at >> 3) + 1] << 8))
+               >> (at & 7)) & 7;
+        if (len)
+            sum += 128U >> len;
+    }
+    return sum == 128;
+}
+
+/* Return the little-endian four-byte integer at in. */
+local uLong par_get4(const Bytef *in) {
+    return (uLong)in[0] | ((uLong)in[1] << 8) | ((uLong)in[2] << 16) |
+           ((uLong)in[3] << 24);
+}
+
+/* ===========================================================================
+ * Skip the gzip header at job->pos. Set job->ret to Z_BUF_ERROR if the input
+ * ends in the header, or to Z_DATA_ERROR if it is invalid.
+ */
+local void par_header(par_state *s, par_job *job) {
+    const Bytef *in = s->in + job->pos;
+    uLong left = s->length - job->pos, n = 10, k;
+    unsigned flags;
+
+    if (left < n) {
+        job->ret = Z_BUF_ERROR;
+        return;
+    }
+    flags = in[3];
+    if (!par_gzip(in, left)) {
+        job->msg = "incorrect header check";
+        job->ret = Z_DATA_ERROR;
+        return;
+    }
+    if (flags & 4) {
+        if (left < n + 2) {
+            job->ret = Z_BUF_ERROR;
+            return;
+        }
+        n += 2 + (in[n] | ((unsigned)in[n + 1] << 8));
+    }
+    for (k = 8; k <= 16; k <<= 1)
+        if (flags & k) {
+            while (n < left && in[n])
+                n++;
+            n++;
+        }
+    if (flags & 2)
+        n += 2;
+    if (n > left) {
+        job->ret = Z_BUF_ERROR;
+        return;
+    }
+    if ((flags & 2) && (crc32(0L, in, (uInt)n - 2) & 0xffff) !=
+                       (in[n - 2] | ((uLong)in[n - 1] << 8))) {
+        job->msg = "header crc mismatch";
+        job->ret = Z_DATA_ERROR;
+        return;
+    }
+    job->pos += n;
+}
+
+/* ===========================================================================
+ * Make room for more output in the job. Return true if the output is already
+ * as large as permitted, in which case it must be written before decoding
+ * continues.
+ */
+local int par_grow(par_state *s, par_job *job) {
+    z_streamp strm = s->strm;
+    Bytef *out;
+    uInt size;
+
+    if (job->have < job->size)
+        return 0;
+    if (job->out != job->buf || job->size >= s->grow)
+        return 1;
+    size = job->size ? job->size << 1 : (uInt)s->chunk << 1;
+    if (size < 4096)
+        size = 4096;
+    if (size > s->grow)
+        size = s->grow;
+    out = (Bytef *)ZALLOC(strm, size, 1);
+    if (out == Z_NULL)
+        return 1;
+    if (job->buf != Z_NULL) {
+        zmemcpy(out, job->buf, job->have);
+        ZFREE(strm, job->buf);
+    }
+    job->buf = job->out = out;
+    job->alloc = job->size = size;
+    return 0;
+}
+
+/* ===========================================================================
+ * Continue the job's inflate stream in deflate blocks at (pos, bits), with
+ * the window dict[0..len-1].
+ */
+local void par_restart(par_state *s, par_job *job, uLong pos, int bits,
+                       const Bytef *dict, uInt len) {
+    z_streamp strm = &job->strm;
+
+    job->pos = pos;
+    job->bits = bits;
+    job->mode = PAR_DATA;
+    job->ret = inflateReset2(strm, -s->wbits);
+    if (job->ret == Z_OK && len)
+        job->ret = inflateSetDictionary(strm, dict, len);
+    if (job->ret == Z_OK && bits)
+        job->ret = inflatePrime(strm, bits, s->in[pos - 1] >> (8 - bits));
+}
+
+/* ===========================================================================
+ * Make room for n more symbols in job->wide. Return true if out of memory, or
+ * if that would be more than twice as many as permitted.
+ */
+local int par_room(par_state *s, par_job *job, uLong n) {
+    z_streamp strm = s->strm;
+    unsigned short *wide;
+    uLong size;
+
+    size = job->walloc ? job->walloc : 65536UL;
+    while (size - job->wlen < n)
+        size <<= 1;
+    if (size > s->wmax << 1)
+        return 1;
+    wide = (unsigned short *)ZALLOC(strm, (uInt)size, sizeof(unsigned short));
+    if (wide == Z_NULL)
+        return 1;
+    if (job->wide != Z_NULL) {
+        zmemcpy((Bytef *)wide, (Bytef *)job->wide,
+                (uInt)(job->wlen * sizeof(unsigned short)));
+        ZFREE(strm, job->wide);
+    }
+    job->wide = wide;
+    job->walloc = size;
+    return 0;
+}
+
+/* Bit accumulator macros for par_wide(), as in inflate.c */
+#define PULLBYTE() \
+    do { \
+        if (next == s->length) goto bad; \
+        hold += (unsigned long)in[next++] << bits; \
+        bits += 8; \
+    } while (0)
+#define NEEDBITS(n) \
+    do { \
+        while (bits < (unsigned)(n)) \
+            PULLBYTE(); \
+    } while (0)
+#define BITS(n) ((unsigned)hold & ((1U << (n)) - 1))
+#define DROPBITS(n) \
+    do { \
+        hold >>= (n); \
+        bits -= (unsigned)(n); \
+    } while (0)
+#define ROOM(n) \
+    do { \
+        if (job->walloc - w < (uLong)(n)) { \
+            job->wlen = w; \
+            if (par_room(s, job, n)) goto mem; \
+            out = job->wide; \
+        } \
+    } while (0)
+
+/* ===========================================================================
+ * Decode deflate blocks from job->pos without the window before it, writing
+ * 16-bit symbols to job->wide. A symbol is a literal byte, or 256 + i for the
+ * unknown byte i of the 32K window, where i == 32767 is the last byte before
+ * job->begin. Stop at a point at or after the end of the region, at the end
+ * of the last block, or when there are many symbols. If the last 32K symbols
+ * are all known, then continue in PAR_DATA mode with those as the window. Set
+ * job->ret to Z_DATA_ERROR if the data is invalid, or Z_MEM_ERROR if out of
+ * memory or if a block has too many symbols.
+ */
+local void par_wide(par_state *s, par_job *job) {
+    static const unsigned short order[19] = /* permutation of code lengths */
+        {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    const Bytef *in = s->in;
+    uLong next = job->pos;      /* next input byte */
+    unsigned long hold;         /* bit buffer */
+    unsigned bits;              /* bits in bit buffer */
+    unsigned short *out = job->wide;
+    uLong w = job->wlen;        /* symbols in out */
+    uLong mark = job->wmark;    /* symbols through the last unknown one that
+                                   was written directly */
+    unsigned back = job->wfar;  /* farthest back into the unknown window */
+    uLong pos, from;
+    unsigned last, type, nlen, ndist, ncode, have, len, dist, copy, k;
+    code here, prev;
+    code const FAR *lencode = lenfix, *distcode = distfix;
+    unsigned lenbits = 9, distbits = 5;
+    code FAR *put;
+    unsigned short lens[320], work[288];
+    code codes[ENOUGH];
+
+    bits = (unsigned)job->bits;
+    hold = bits ? (unsigned long)in[next - 1] >> (8 - bits) : 0;
+    for (;;) {
+        if (job->blocks) {
+            /* at the boundary between two blocks -- find the last unknown
+               symbol, which may have been copied by a match */
+            for (from = w; from > mark && w - from < PAR_WINDOW; from--)
+                if (out[from - 1] > 255) {
+                    mark = from;
+                    break;
+                }
+            pos = next - (bits >> 3);
+            k = bits & 7;
+            if (PAR_AT(pos, k, job->to) && par_point(s, pos, (int)k)) {
+                job->pos = pos;
+                job->bits = (int)k;
+                job->mode = PAR_DATA;
+                job->why = PAR_STOP;
+                break;
+            }
+            if (w - mark >= PAR_WINDOW) {
+                /* the window is known -- continue with inflate() */
+                if (job->win == Z_NULL) {
+                    job->win = (Bytef *)ZALLOC(s->strm, PAR_WINDOW, 1);
+                    if (job->win == Z_NULL)
+                        goto mem;
+                }
+                for (len = 0; len < PAR_WINDOW; len++)
+                    job->win[len] = (Bytef)out[w - PAR_WINDOW + len];
+                par_restart(s, job, pos, (int)k, job->win, PAR_WINDOW);
+                break;
+            }
+            if (w >= s->wmax) {
+                job->pos = pos;
+                job->bits = (int)k;
+                job->why = PAR_PAUSE;
+                break;
+            }
+        }
+
+        /* block header */
+        NEEDBITS(3);
+        last = BITS(1);
+        type = BITS(3) >> 1;
+        DROPBITS(3);
+        if (type == 0) {
+            /* stored block */
+            DROPBITS(bits & 7);
+            NEEDBITS(32);
+            len = BITS(16);
+            DROPBITS(16);
+            if (BITS(16) != (len ^ 0xffff))
+                goto bad;
+            DROPBITS(16);
+            if (s->length - next < len)
+                goto bad;
+            ROOM(len);
+            while (len--)
+                out[w++] = in[next++];
+        }
+        else if (type == 1) {
+            lencode = lenfix;
+            lenbits = 9;
+            distcode = distfix;
+            distbits = 5;
+        }
+        else if (type == 2) {
+            /* dynamic block -- build the code tables as inflate() does */
+            NEEDBITS(14);
+            nlen = BITS(5) + 257;
+            DROPBITS(5);
+            ndist = BITS(5) + 1;
+            DROPBITS(5);
+            ncode = BITS(4) + 4;
+            DROPBITS(4);
+            if (nlen > 286 || ndist > 30)
+                goto bad;
+            for (have = 0; have < ncode; have++) {
+                NEEDBITS(3);
+                lens[order[have]] = (unsigned short)BITS(3);
+                DROPBITS(3);
+            }
+            while (have < 19)
+                lens[order[have++]] = 0;
+            put = codes;
+            lencode = (const code FAR *)put;
+            lenbits = 7;
+            if (inflate_table(CODES, lens, 19, &put, &lenbits, work))
+                goto bad;
+            have = 0;
+            while (have < nlen + ndist) {
+                for (;;) {
+                    here = lencode[BITS(lenbits)];
+                    if ((unsigned)(here.bits) <= bits) break;
+                    PULLBYTE();
+                }
+                if (here.val < 16) {
+                    DROPBITS(here.bits);
+                    lens[have++] = here.val;
+                    continue;
+                }
+                if (here.val == 16) {
+                    if (have == 0)
+                        goto bad;
+                    NEEDBITS(here.bits + 2);
+                    DROPBITS(here.bits);
+                    len = lens[have - 1];
+                    copy = 3 + BITS(2);
+                    DROPBITS(2);
+                }
+                else if (here.val == 17) {
+                    NEEDBITS(here.bits + 3);
+                    DROPBITS(here.bits);
+                    len = 0;
+                    copy = 3 + BITS(3);
+                    DROPBITS(3);
+                }
+                else {
+                    NEEDBITS(here.bits + 7);
+                    DROPBITS(here.bits);
+                    len = 0;
+                    copy = 11 + BITS(7);
+                    DROPBITS(7);
+                }
+                if (have + copy > nlen + ndist)
+                    goto bad;
+                while (copy--)
+                    lens[have++] = (unsigned short)len;
+            }
+            if (lens[256] == 0)
+                goto bad;
+            put = codes;
+            lencode = (const code FAR *)put;
+            lenbits = INFLATE_LEN_ROOT;
+            if (inflate_table(LENS, lens, nlen, &put, &lenbits, work))
+                goto bad;
+            distcode = (const code FAR *)put;
+            distbits = 6;
+            if (inflate_table(DISTS, lens + nlen, ndist, &put, &distbits,
+                              work))
+                goto bad;
+        }
+        else
+            goto bad;
+
+        /* decode the literals, lengths, and distances of a coded block,
+           quickly while there is enough input for any one of them */
+        if (type != 0)
+            for (;;) {
+                ROOM(258);
+                if (s->length - next >= 8) {
+                    if (bits < 15) {
+                        hold += (unsigned long)in[next++] << bits;
+                        bits += 8;
+                        hold += (unsigned long)in[next++] << bits;
+                        bits += 8;
+                    }
+                    here = lencode[BITS(lenbits)];
+                    if (here.op & 128) {        /* pair of literals */
+                        DROPBITS(here.bits);
+                        out[w++] = here.val & 0xff;
+                        out[w++] = here.val >> 8;
+                        continue;
+                    }
+                    if (here.op && (here.op & 0xf0) == 0) {
+                        DROPBITS(here.bits);
+                        here = lencode[here.val + BITS(here.op)];
+                    }
+                    DROPBITS(here.bits);
+                    if (here.op == 0) {
+                        out[w++] = here.val;
+                        continue;
+                    }
+                    if (here.op & 32)
+                        break;
+                    if (here.op & 64)
+                        goto bad;
+                    len = here.val;
+                    copy = here.op & 15;
+                    if (copy) {
+                        if (bits < copy) {
+                            hold += (unsigned long)in[next++] << bits;
+                            bits += 8;
+                        }
+                        len += BITS(copy);
+                        DROPBITS(copy);
+                    }
+                    if (bits < 15) {
+                        hold += (unsigned long)in[next++] << bits;
+                        bits += 8;
+                        hold += (unsigned long)in[next++] << bits;
+                        bits += 8;
+                    }
+                    here = distcode[BITS(distbits)];
+                    if ((here.op & 0xf0) == 0) {
+                        DROPBITS(here.bits);
+                        here = distcode[here.val + BITS(here.op)];
+                    }
+                    DROPBITS(here.bits);
+                    if (here.op & 64)
+                        goto bad;
+                    dist = here.val;
+                    copy = here.op & 15;
+                    if (copy) {
+                        if (bits < copy) {
+                            hold += (unsigned long)in[next++] << bits;
+                            bits += 8;
+                            if (bits < copy) {
+                                hold += (unsigned long)in[next++] << bits;
+                                bits += 8;
+                            }
+                        }
+                        dist += BITS(copy);
+                        DROPBITS(copy);
+                    }
+                }
+                else {
+                    for (;;) {
+                        here = lencode[BITS(lenbits)];
+                        if (here.op & 128) {    /* first literal of a pair */
+                            here.bits = (unsigned char)(here.op & 15);
+                            here.op = 0;
+                            here.val &= 0xff;
+                        }
+                        if ((unsigned)(here.bits) <= bits) break;
+                        PULLBYTE();
+                    }
+                    if (here.op && (here.op & 0xf0) == 0) {
+                        prev = here;
+                        for (;;) {
+                            here = lencode[prev.val +
+                                    (BITS(prev.bits + prev.op) >> prev.bits)];
+                            if ((unsigned)(prev.bits + here.bits) <= bits)
+                                break;
+                            PULLBYTE();
+                        }
+                        DROPBITS(prev.bits);
+                    }
+                    DROPBITS(here.bits);
+                    if (here.op == 0) {
+                        out[w++] = here.val;
+                        continue;
+                    }
+                    if (here.op & 32)
+                        break;
+                    if (here.op & 64)
+                        goto bad;
+                    len = here.val;
+                    copy = here.op & 15;
+                    if (copy) {
+                        NEEDBITS(copy);
+                        len += BITS(copy);
+                        DROPBITS(copy);
+                    }
+                    for (;;) {
+                        here = distcode[BITS(distbits)];
+                        if ((unsigned)(here.bits) <= bits) break;
+                        PULLBYTE();
+                    }
+                    if ((here.op & 0xf0) == 0) {
+                        prev = here;
+                        for (;;) {
+                            here = distcode[prev.val +
+                                    (BITS(prev.bits + prev.op) >> prev.bits)];
+                            if ((unsigned)(prev.bits + here.bits) <= bits)
+                                break;
+                            PULLBYTE();
+                        }
+                        DROPBITS(prev.bits);
+                    }
+                    DROPBITS(here.bits);
+                    if (here.op & 64)
+                        goto bad;
+                    dist = here.val;
+                    copy = here.op & 15;
+                    if (copy) {
+                        NEEDBITS(copy);
+                        dist += BITS(copy);
+                        DROPBITS(copy);
+                    }
+                }
+
+                /* copy the match */
+                if (dist > w) {
+                    copy = dist - (unsigned)w;
+                    if (copy > back)
+                        back = copy;
+                    k = 256 + PAR_WINDOW - copy;
+                    if (copy > len)
+                        copy = len;
+                    len -= copy;
+                    while (copy--)
+                        out[w++] = (unsigned short)k++;
+                    mark = w;
+                }
+                from = w - dist;
+                while (len--)
+                    out[w++] = out[from++];
+            }
+        job->blocks++;
+        if (last) {
+            job->pos = next - (bits >> 3);
+            job->bits = 0;
+            job->mode = PAR_TRAIL;
+            break;
+        }
+    }
+    job->wlen = w;
+    job->wmark = mark;
+    job->wfar = back;
+    return;
+
+  bad:
+    job->ret = Z_DATA_ERROR;
+    job->pos = next;
+    job->wlen = w;
+    return;
+
+  mem:
+    job->ret = Z_MEM_ERROR;
+    job->pos = next;
+}
+
+/* ===========================================================================
+ * Decode the job's input from job->pos, until reaching a point at or after
+ * the end of its region, the end of the stream, an error, or a full output
+ * buffer.
+ */
+local void par_decode(par_state *s, par_job *job) {
+    z_streamp strm = &job->strm;
+    const Bytef *in = s->in;
+    uLong pos, end, want, want_len;
+    uInt n;
+    int ret;
+
+    job->why = PAR_NONE;
+    for (;;)
+        switch (job->mode) {
+        case PAR_HEAD:
+            par_header(s, job);
+            if (job->ret != Z_OK)
+                return;
+            job->ret = inflateReset2(strm, -s->wbits);
+            if (job->ret != Z_OK)
+                return;
+            job->member = 1;
+            job->check = crc32(0L, Z_NULL, 0);
+            job->len = 0;
+            job->mode = PAR_DATA;
+            break;
+        case PAR_WIDE:
+            par_wide(s, job);
+            if (job->ret != Z_OK || job->why != PAR_NONE)
+                return;
+            break;
+        case PAR_DATA:
+            if (par_grow(s, job)) {
+                if (job->size == 0) {
+                    job->ret = Z_MEM_ERROR;
+                    return;
+                }
+                job->why = PAR_PAUSE;
+                return;
+            }
+            /* decode to the end of the region without stopping, and then a
+               block at a time to find the next point */
+            end = job->pos < job->to ? job->to : s->length;
+            strm->next_in = (z_const Bytef *)in + job->pos;
+            strm->avail_in = (uInt)(end - job->pos);
+            strm->next_out = job->out + job->have;
+            strm->avail_out = job->size - job->have;
+            ret = inflate(strm, job->pos < job->to ? Z_NO_FLUSH : Z_BLOCK);
+            n = job->size - job->have - strm->avail_out;
+            if (s->wrap == 1)
+                job->check = adler32(job->check, job->out + job->have, n);
+            else if (s->wrap == 2)
+                job->check = crc32(job->check, job->out + job->have, n);
+            job->len += n;
+            job->have += n;
+            job->pos = (uLong)(strm->next_in - in);
+            job->bits = strm->data_type & 7;
+            if (ret == Z_STREAM_END) {
+                job->bits = 0;
+                job->mode = PAR_TRAIL;
+                break;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                job->msg = strm->msg;
+                job->ret = ret;
+                return;
+            }
+            if (strm->avail_out == 0)
+                break;
+            if (ret == Z_BUF_ERROR && end == s->length) {
+                job->ret = Z_BUF_ERROR;
+                return;
+            }
+            if ((strm->data_type & 192) == 128 &&
+                PAR_AT(job->pos, job->bits, job->to) &&
+                par_point(s, job->pos, job->bits)) {
+                job->why = PAR_STOP;
+                return;
+            }
+            break;
+        case PAR_TRAIL:
+            pos = job->pos;
+            n = s->wrap == 2 ? 8 : s->wrap == 1 ? 4 : 0;
+            if (s->length - pos < n) {
+                job->ret = Z_BUF_ERROR;
+                return;
+            }
+            want = want_len = job->len & 0xffffffff;
+            if (s->wrap == 2) {
+                want = par_get4(in + pos);
+                want_len = par_get4(in + pos + 4);
+            }
+            else if (s->wrap == 1)
+                want = ((uLong)in[pos] << 24) | ((uLong)in[pos + 1] << 16) |
+                       ((uLong)in[pos + 2] << 8) | in[pos + 3];
+            if (!job->member) {
+                job->ends = 1;
+                job->lead = job->check;
+                job->lead_len = job->len;
+                job->want = want;
+                job->want_len = want_len;
+            }
+            else if (n && want != job->check) {
+                job->msg = "incorrect data check";
+                job->ret = Z_DATA_ERROR;
+                return;
+            }
+            else if (want_len != (job->len & 0xffffffff)) {
+                job->msg = "incorrect length check";
+                job->ret = Z_DATA_ERROR;
+                return;
+            }
+            job->last = want;
+            job->pos = pos += n;
+            if (s->wrap == 2 && par_gzip(in + pos, s->length - pos)) {
+                job->mode = PAR_HEAD;
+                if (pos >= job->to) {
+                    job->why = PAR_STOP;
+                    return;
+                }
+                break;
+            }
+            job->why = PAR_END;
+            return;
+        }
+}
+
+/* ===========================================================================
+ * Prepare the job to decode from (pos, bits), with the stream in the given
+ * mode. If dict is true and the mode is PAR_DATA, then the window is loaded
+ * with the output so far.
+ */
+local void par_begin(par_state *s, par_job *job, uLong pos, int bits,
+                     par_mode mode, int dict) {
+    job->begin = job->pos = pos;
+    job->begin_bits = job->bits = bits;
+    job->mode = mode;
+    job->why = PAR_NONE;
+    job->ret = Z_OK;
+    job->msg = Z_NULL;
+    job->out = job->buf;
+    job->size = job->alloc;
+    job->have = 0;
+    job->member = pos == s->start;
+    job->ends = 0;
+    job->check = s->wrap == 1 ? adler32(0L, Z_NULL, 0) :
+                 crc32(0L, Z_NULL, 0);
+    job->len = 0;
+    job->last = 0;
+    job->wlen = 0;
+    job->wmark = 0;
+    job->wfar = 0;
+    job->blocks = 0;
+    if (mode == PAR_DATA)
+        par_restart(s, job, pos, bits, s->dict, dict ? s->dlen : 0);
+}
+
+#ifdef HAVE_THREADS
+/* ===========================================================================
+ * Decode from the first candidate point in the job's region that decodes
+ * without error, trying the bit positions in order. The first region starts
+ * at the start of the stream. A candidate that fails after the end of the
+ * region is not followed by another, since the true points in this region
+ * would fail there too.
+ */
+local void par_run(par_state *s, par_job *job) {
+    const Bytef *in = s->in;
+    uLong pos;
+    int k;
+
+    if (job->from == s->start) {
+        par_begin(s, job, s->start, 0, s->wrap == 2 ? PAR_HEAD : PAR_DATA, 0);
+        par_decode(s, job);
+        return;
+    }
+    for (pos = job->from; pos < job->to; pos++)
+        for (k = 0; k < 8; k++) {
+            if (k == 0 && s->wrap == 2 && par_gzip(in + pos, s->length - pos))
+                par_begin(s, job, pos, 0, PAR_HEAD, 0);
+            else if (par_point(s, pos + (k != 0), k ? 8 - k : 0))
+                par_begin(s, job, pos + (k != 0), k ? 8 - k : 0, PAR_WIDE, 0);
+            else
+                continue;
+            par_decode(s, job);
+            if (job->ret != Z_DATA_ERROR || job->pos >= job->to)
+                return;
+        }
+    job->why = PAR_NONE;
+    job->ret = Z_OK;
+}
+
+/* ===========================================================================
+ * Worker thread: decode jobs in order as they are submitted, until told to
+ * quit.
+ */
+local void par_worker(void *arg) {
+    par_state *s = (par_state *)arg;
+    par_job *job;
+
+    zmutex_lock(&s->lock);
+    for (;;) {
+        while (s->todo == Z_NULL && !s->quit)
+            zcond_wait(&s->work, &s->lock);
+        if (s->quit)
+            break;
+        job = s->todo;
+        s->todo = job->next;
+        zmutex_unlock(&s->lock);
+        par_run(s, job);
+        zmutex_lock(&s->lock);
+        job->done = 1;
+        zcond_broadcast(&s->ready);
+    }
+    zmutex_unlock(&s->lock);
+}
+#endif
+
+/* ===========================================================================
+ * Submit a job for the next region. Return Z_OK, or Z_MEM_ERROR if a new job
+ * could not be allocated.
+ */
+local int par_submit(par_state *s) {
+    z_streamp strm = s->strm;
+    par_job *job;
+
+    job = s->spare;
+    if (job != Z_NULL)
+        s->spare = job->next;
+    else {
+        job = (par_job *)ZALLOC(strm, 1, sizeof(par_job));
+        if (job == Z_NULL)
+            return Z_MEM_ERROR;
+        zmemzero((Bytef *)job, sizeof(par_job));
+        job->strm.zalloc = strm->zalloc;
+        job->strm.zfree = strm->zfree;
+        job->strm.opaque = strm->opaque;
+        if (inflateInit2(&job->strm, -15) != Z_OK) {
+            ZFREE(strm, job);
+            return Z_MEM_ERROR;
+        }
+    }
+    job->from = s->next;
+    job->to = (s->max > 1 || s->index != Z_NULL) &&
+              s->length - s->next > s->chunk ?
+              s->next + s->chunk : s->length;
+    s->next = job->to;
+    job->why = PAR_NONE;
+    job->done = 0;
+    job->next = Z_NULL;
+    s->jobs++;
+#ifdef HAVE_THREADS
+    if (s->running) {
+        /* the workers follow the next links, so append under the lock */
+        zmutex_lock(&s->lock);
+        if (s->first == Z_NULL)
+            s->first = job;
+        else
+            s->last->next = job;
+        s->last = job;
+        if (s->todo == Z_NULL)
+            s->todo = job;
+        zcond_broadcast(&s->work);
+        zmutex_unlock(&s->lock);
+        return Z_OK;
+    }
+#endif
+    if (s->first == Z_NULL)
+        s->first = job;
+    else
+        s->last->next = job;
+    s->last = job;
+    job->done = 1;
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Wait for the oldest submitted job to be done. Without workers, jobs are
+ * decoded by the application's thread when they are written.
+ */
+local void par_wait(par_state *s) {
+#ifdef HAVE_THREADS
+    if (s->running) {
+        zmutex_lock(&s->lock);
+        while (!s->first->done)
+            zcond_wait(&s->ready, &s->lock);
+        zmutex_unlock(&s->lock);
+    }
+#else
+    (void)s;
+#endif
+}
+
+/* ===========================================================================
+ * Write the n bytes of output at buf, which are already at next_out if direct
+ * is true, and keep the last 32K of the output for decoding a region again.
+ * Return Z_OK, or Z_BUF_ERROR if out() failed or next_out is full.
+ */
+local int par_put(par_state *s, Bytef *buf, uInt n, int direct) {
+    z_streamp strm = s->strm;
+    uInt keep, k;
+    int ret = Z_OK;
+
+    if (n == 0)
+        return Z_OK;
+    if (direct) {
+        strm->next_out += n;
+        strm->avail_out -= n;
+    }
+    else if (s->out != Z_NULL) {
+        if (s->out(s->out_desc, buf, n))
+            return Z_BUF_ERROR;
+    }
+    else {
+        if (n > strm->avail_out) {
+            n = strm->avail_out;
+            ret = Z_BUF_ERROR;
+        }
+        zmemcpy(strm->next_out, buf, n);
+        strm->next_out += n;
+        strm->avail_out -= n;
+    }
+    strm->total_out += n;
+    if (n >= 32768U) {
+        zmemcpy(s->dict, buf + n - 32768U, 32768U);
+        s->dlen = 32768U;
+    }
+    else {
+        keep = 32768U - n;
+        if (keep > s->dlen)
+            keep = s->dlen;
+        for (k = 0; k < keep; k++)      /* overlapped copy down */
+            s->dict[k] = s->dict[s->dlen - keep + k];
+        zmemcpy(s->dict + keep, buf, n);
+        s->dlen = keep + n;
+    }
+    return ret;
+}
+
+/* ===========================================================================
+ * Write the job's output.
+ */
+local int par_write(par_state *s, par_job *job) {
+    uInt n = job->have;
+
+    job->have = 0;
+    return par_put(s, job->out, n, job->out != job->buf);
+}
+
+/* ===========================================================================
+ * Replace the references to the unknown window in job->wide with the bytes
+ * from the output so far, and convert the symbols to bytes in place. Return
+ * true if a reference is farther back than the output or the window size, in
+ * which case the job did not start where the output so far ends, or if out of
+ * memory. Either way the job is then decoded again.
+ */
+local int par_resolve(par_state *s, par_job *job) {
+    unsigned short *wide = job->wide;
+    Bytef *out = (Bytef *)wide, *res = s->res;
+    uInt have = 1U << s->wbits;
+    uLong i;
+
+    if (job->wlen == 0)
+        return 0;
+    if (have > s->dlen)
+        have = s->dlen;
+    if (job->wfar > have)
+        return 1;
+    if (res == Z_NULL) {
+        res = (Bytef *)ZALLOC(s->strm, 256 + PAR_WINDOW, 1);
+        if (res == Z_NULL)
+            return 1;
+        for (i = 0; i < 256; i++)
+            res[i] = (Bytef)i;
+        s->res = res;
+    }
+    zmemcpy(res + 256 + PAR_WINDOW - job->wfar, s->dict + s->dlen - job->wfar,
+            job->wfar);
+    for (i = 0; i < job->wlen; i++)
+        out[i] = res[wide[i]];
+    return 0;
+}
+
+/* ===========================================================================
+ * Give an access point at the verified position to the index function, as a
+ * checkpoint for inflateRestore(). Return Z_OK, or Z_BUF_ERROR if index()
+ * returned an error.
+ */
+local int par_index(par_state *s) {
+    Bytef *buf = s->mark;
+    uInt have = 1U << s->wbits;
+    uLong val;
+    int k;
+
+    if (have > s->dlen)
+        have = s->dlen;
+    buf[0] = CKPT_VERSION;
+    buf[1] = (Bytef)s->wbits;
+    buf[2] = (Bytef)s->bits;
+    buf[3] = s->bits ? (Bytef)(s->in[s->pos - 1] >> (8 - s->bits)) : 0;
+    for (k = 0, val = s->pos; k < 8; k++, val >>= 8)
+        buf[4 + k] = (Bytef)val;
+    for (k = 0, val = s->strm->total_out; k < 8; k++, val >>= 8)
+        buf[12 + k] = (Bytef)val;
+    for (k = 0, val = have; k < 4; k++, val >>= 8)
+        buf[20 + k] = (Bytef)val;
+    zmemcpy(buf + CKPT_HEAD, s->dict + s->dlen - have, have);
+    return s->index(s->index_desc, buf, CKPT_HEAD + have) ? Z_BUF_ERROR :
+                                                            Z_OK;
+}
+
+/* ===========================================================================
+ * Stop the workers, and free everything allocated for the parallel state.
+ */
+local void par_free(par_state *s) {
+    z_streamp strm = s->strm;
+    par_job *job, *list[2];
+    int i;
+
+#ifdef HAVE_THREADS
+    if (s->running) {
+        zmutex_lock(&s->lock);
+        s->quit = 1;
+        zcond_broadcast(&s->work);
+        zmutex_unlock(&s->lock);
+        for (i = 0; i < s->running; i++)
+            zthread_join(s->pool[i]);
+        zcond_free(&s->ready);
+        zcond_free(&s->work);
+        zmutex_free(&s->lock);
+    }
+    TRY_FREE(strm, s->pool);
+#endif
+    list[0] = s->first;
+    list[1] = s->spare;
+    for (i = 0; i < 2; i++)
+        while ((job = list[i]) != Z_NULL) {
+            list[i] = job->next;
+            inflateEnd(&job->strm);
+            TRY_FREE(strm, job->buf);
+            TRY_FREE(strm, job->wide);
+            TRY_FREE(strm, job->win);
+            ZFREE(strm, job);
+        }
+    TRY_FREE(strm, s->dict);
+    TRY_FREE(strm, s->mark);
+    TRY_FREE(strm, s->res);
+    ZFREE(strm, s);
+}
+
+/* ===========================================================================
+ * When the application's thread decodes, write directly to next_out if that
+ * is where the output goes and there is room, or else to the job's buffer.
+ */
+local void par_direct(par_state *s, par_job *job) {
+    z_streamp strm = s->strm;
+
+    if (s->out == Z_NULL && strm->avail_out) {
+        job->out = strm->next_out;
+        job->size = strm->avail_out;
+    }
+    else {
+        job->out = job->buf;
+        job->size = job->alloc;
+    }
+}
+
+/* ===========================================================================
+ * Use the job's output, decoding it again first if it did not start where
+ * the output so far ends. Return Z_OK, Z_STREAM_END after the end of the
+ * stream, or an error.
+ */
+local int par_join(par_state *s, par_job *job) {
+    uLong check;
+    int ret;
+
+    if (s->index != Z_NULL && s->mode == PAR_DATA && s->pos != s->start) {
+        ret = par_index(s);
+        if (ret != Z_OK)
+            return ret;
+    }
+    if (job->why == PAR_NONE || job->ret != Z_OK || job->begin != s->pos ||
+        job->begin_bits != s->bits || par_resolve(s, job)) {
+        par_begin(s, job, s->pos, s->bits, s->mode, 1);
+        par_direct(s, job);
+        if (job->ret == Z_OK)
+            par_decode(s, job);
+    }
+    for (;;) {
+        ret = Z_OK;
+        if (job->wlen) {
+            /* write the resolved output decoded without the window */
+            ret = par_put(s, (Bytef *)job->wide, (uInt)job->wlen, 0);
+            if (s->wrap == 1)
+                s->check = adler32(s->check, (Bytef *)job->wide,
+                                   (uInt)job->wlen);
+            else if (s->wrap == 2)
+                s->check = crc32(s->check, (Bytef *)job->wide,
+                                 (uInt)job->wlen);
+            s->len += job->wlen;
+            job->wlen = 0;
+        }
+        if (ret == Z_OK)
+            ret = par_write(s, job);
+        if (ret == Z_OK)
+            ret = job->ret;
+        if (ret != Z_OK) {
+            if (job->msg != Z_NULL)
+                s->strm->msg = (char *)job->msg;
+            return ret;
+        }
+        if (job->why != PAR_PAUSE)
+            break;
+        if (job->mode == PAR_WIDE)
+            par_begin(s, job, job->pos, job->bits, PAR_DATA, 1);
+        par_direct(s, job);
+        if (job->ret == Z_OK)
+            par_decode(s, job);
+    }
+
+    /* verify the trailer of a member that started before this job */
+    if (job->ends && s->wrap) {
+        check = s->wrap == 1 ?
+                adler32_combine(s->check, job->lead, job->lead_len) :
+                crc32_combine(s->check, job->lead, job->lead_len);
+        if (check != job->want) {
+            s->strm->msg = (char *)"incorrect data check";
+            return Z_DATA_ERROR;
+        }
+        if (s->wrap == 2 &&
+            ((s->len + job->lead_len) & 0xffffffff) != job->want_len) {
+            s->strm->msg = (char *)"incorrect length check";
+            return Z_DATA_ERROR;
+        }
+    }
+    if (job->ends || job->member) {
+        s->check = job->check;
+        s->len = job->len;
+    }
+    else {
+        s->check = s->wrap == 1 ?
+                   adler32_combine(s->check, job->check, job->len) :
+                   crc32_combine(s->check, job->check, job->len);
+        s->len += job->len;
+    }
+    s->pos = job->pos;
+    s->bits = job->bits;
+    s->mode = job->mode;
+    if (job->why != PAR_END)
+        return Z_OK;
+    if (s->wrap)
+        s->strm->adler = job->last;
+    return Z_STREAM_END;
+}
+
+/* ========================================================================= */
+int ZEXPORT inflateParallel(z_streamp strm, int windowBits, int threads,
+                            uLong chunk, out_func out, void FAR *out_desc) {
+    return inflateParallel2(strm, windowBits, threads, chunk, out, out_desc,
+                            Z_NULL, Z_NULL);
+}
+
+/* ========================================================================= */
+int ZEXPORT inflateParallel2(z_streamp strm, int windowBits, int threads,
+                             uLong chunk, out_func out, void FAR *out_desc,
+                             out_func index, void FAR *index_desc) {
+    par_state *s;
+    par_job *job;
+    int wrap = 1, ret = Z_OK;
+    const Bytef *in;
+#ifdef HAVE_THREADS
+    int i;
+#endif
+
+    if (strm == Z_NULL || (strm->avail_in && strm->next_in == Z_NULL) ||
+        (out == Z_NULL && strm->next_out == Z_NULL))
+        return Z_STREAM_ERROR;
+    strm->msg = Z_NULL;
+    if (strm->zalloc == (alloc_func)0) {
+#ifdef Z_SOLO
+        return Z_STREAM_ERROR;
+#else
+        strm->zalloc = zcalloc;
+        strm->opaque = (voidpf)0;
+#endif
+    }
+    if (strm->zfree == (free_func)0)
+#ifdef Z_SOLO
+        return Z_STREAM_ERROR;
+#else
+        strm->zfree = zcfree;
+#endif
+
+    in = strm->next_in;
+    if (windowBits < 0) {
+        wrap = 0;
+        if (windowBits < -15)
+            return Z_STREAM_ERROR;
+        windowBits = -windowBits;
+    }
+#ifndef NO_GZIP
+    else if (windowBits >= 32) {
+        windowBits -= 32;
+        if (strm->avail_in >= 2 && in[0] == 31 && in[1] == 139)
+            wrap = 2;
+    }
+    else if (windowBits > 15) {
+        wrap = 2;
+        windowBits -= 16;
+    }
+#endif
+    if (chunk == 0)
+        chunk = PAR_CHUNK;
+    if (windowBits < 8 || windowBits > 15 || threads < 1 ||
+        chunk > PAR_MAX_CHUNK)
+        return Z_STREAM_ERROR;
+#ifndef HAVE_THREADS
+    threads = 1;
+#endif
+
+    /* check the zlib header, and use its window size */
+    if (wrap == 1) {
+        if (strm->avail_in < 2)
+            return Z_BUF_ERROR;
+        if ((in[0] & 0xf) != Z_DEFLATED || ((in[0] << 8) + in[1]) % 31) {
+            strm->msg = (char *)"incorrect header check";
+            return Z_DATA_ERROR;
+        }
+        if ((in[0] >> 4) + 8 > windowBits) {
+            strm->msg = (char *)"invalid window size";
+            return Z_DATA_ERROR;
+        }
+        if (in[1] & 0x20)
+            return Z_NEED_DICT;
+        windowBits = (in[0] >> 4) + 8;
+    }
+
+    s = (par_state *)ZALLOC(strm, 1, sizeof(par_state));
+    if (s == Z_NULL) return Z_MEM_ERROR;
+    zmemzero((Bytef *)s, sizeof(par_state));
+    s->strm = strm;
+    s->in = in;
+    s->length = strm->avail_in;
+    s->start = s->pos = s->next = wrap == 1 ? 2 : 0;
+    s->wrap = wrap;
+    s->wbits = windowBits;
+    s->chunk = chunk;
+    s->grow = chunk < 2048 ? 65536U : (uInt)chunk * PAR_GROW;
+    s->out = out;
+    s->out_desc = out_desc;
+    s->index = index;
+    s->index_desc = index_desc;
+    s->wmax = (uLong)s->grow >> 2;
+    if (s->wmax < 262144UL)
+        s->wmax = 262144UL;
+    s->mode = wrap == 2 ? PAR_HEAD : PAR_DATA;
+    s->check = wrap == 1 ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+    s->dict = (Bytef *)ZALLOC(strm, 32768U, 1);
+    if (index != Z_NULL)
+        s->mark = (Bytef *)ZALLOC(strm, CKPT_HEAD + PAR_WINDOW, 1);
+    if (s->dict == Z_NULL || (index != Z_NULL && s->mark == Z_NULL)) {
+        par_free(s);
+        return Z_MEM_ERROR;
+    }
+    strm->total_out = 0;
+
+    /* start the workers -- if not all of them can be started, use the ones
+       that were, or if none, decode in the application's thread */
+    s->max = 1;
+#ifdef HAVE_THREADS
+    s->pool = threads > 1 ? (zthread *)ZALLOC(strm, threads, sizeof(zthread)) :
+                            Z_NULL;
+    if (s->pool != Z_NULL && zmutex_init(&s->lock) == 0) {
+        if (zcond_init(&s->work) == 0) {
+            if (zcond_init(&s->ready) == 0) {
+                for (i = 0; i < threads; i++) {
+                    if (zthread_start(&s->pool[i], par_worker, s))
+                        break;
+                    s->running++;
+                }
+                if (s->running)
+                    s->max = s->running << 1;
+                else
+                    zcond_free(&s->ready);
+            }
+            if (s->running == 0)
+                zcond_free(&s->work);
+        }
+        if (s->running == 0)
+            zmutex_free(&s->lock);
+    }
+#endif
+
+    /* join the regions in order, keeping up to max of them in progress */
+    for (;;) {
+        while (s->jobs < s->max && s->next < s->length &&
+               (ret = par_submit(s)) == Z_OK)
+            ;
+        if (ret != Z_OK)
+            break;
+        job = s->first;
+        if (job == Z_NULL) {
+            ret = Z_BUF_ERROR;
+            break;
+        }
+        par_wait(s);
+        if (s->pos < job->to) {
+            ret = par_join(s, job);
+            if (ret != Z_OK) {
+                if (ret != Z_STREAM_END && job->ret != Z_OK)
+                    s->pos = job->ret == Z_BUF_ERROR ? s->length : job->pos;
+                break;
+            }
+        }
+        s->first = job->next;
+        s->jobs--;
+        job->next = s->spare;
+        s->spare = job;
+    }
+    strm->next_in += s->pos;
+    strm->avail_in -= (uInt)s->pos;
+    strm->total_in = s->pos;
+    par_free(s);
+    return ret;
+}
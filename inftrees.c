@@ -292,6 +292,28 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
         next[huff] = here;
     }
 
+    /* pair up literals in the root table whose codes fit together in the
+       root bits -- go down, so that the entry at index >> len, which is at or
+       below index, has not been paired yet */
+    if (type == LENS) {
+        next = *table;
+        huff = 1U << root;
+        while (huff--) {
+            here = next[huff];
+            if (here.op == 0) {
+                len = here.bits;
+                incr = huff >> len;
+                if ((next[incr].op | (len + next[incr].bits > root)) == 0) {
+                    here.op = (unsigned char)(128 + len);
+                    here.bits = (unsigned char)(len + next[incr].bits);
+                    here.val = (unsigned short)(here.val +
+                                                (next[incr].val << 8));
+                    next[huff] = here;
+                }
+            }
+        }
+    }
+
     /* set return parameters */
     *table += used;
     *bits = root;
@@ -33,8 +33,25 @@ typedef struct {
     0001eeee - length or distance, eeee is the number of extra bits
     01100000 - end of block
     01000000 - invalid code
+    1000llll - literal pair, llll is the number of bits in the first code
+
+   A literal pair is a root table entry for two literals whose codes together
+   fit in the root table index bits.  bits is the number of bits in both codes,
+   and val has the first literal in the low byte and the second literal in the
+   high byte.  Pairs are only made for literal/length tables.  Decoders that
+   take one symbol at a time use just the first literal from a pair entry, with
+   the number of bits from op.
  */
 
+/* The number of index bits of the root table for literal/length codes.  The
+   default is 9.  It can be set to 10 or 11 at compile time, so that more codes
+   are decoded with one table lookup and more literals are paired, at the cost
+   of building a larger root table for each dynamic block, and of 480 or 1488
+   more code structures in the inflate state. */
+#ifndef INFLATE_LEN_ROOT
+#  define INFLATE_LEN_ROOT 9
+#endif
+
 /* Maximum size of the dynamic table.  The maximum number of code structures is
    1444, which is the sum of 852 for literal/length codes and 592 for distance
    codes.  These values were found by exhaustive searches using the program
@@ -42,11 +59,20 @@ typedef struct {
    program are the number of symbols, the initial root table size, and the
    maximum bit length of a code.  "enough 286 9 15" for literal/length codes
    returns 852, and "enough 30 6 15" for distance codes returns 592. The
-   initial root table size (9 or 6) is found in the fifth argument of the
-   inflate_table() calls in inflate.c and infback.c.  If the root table size is
-   changed, then these maximum sizes would be need to be recalculated and
-   updated. */
-#define ENOUGH_LENS 852
+   initial root table size (INFLATE_LEN_ROOT or 6) is found in the fifth
+   argument of the inflate_table() calls in inflate.c and infback.c.  "enough
+   286 10 15" returns 1332, and "enough 286 11 15" returns 2340.  If the root
+   table size is changed, then these maximum sizes would be need to be
+   recalculated and updated. */
+#if INFLATE_LEN_ROOT == 9
+#  define ENOUGH_LENS 852
+#elif INFLATE_LEN_ROOT == 10
+#  define ENOUGH_LENS 1332
+#elif INFLATE_LEN_ROOT == 11
+#  define ENOUGH_LENS 2340
+#else
+#  error INFLATE_LEN_ROOT must be 9, 10, or 11
+#endif
 #define ENOUGH_DISTS 592
 #define ENOUGH (ENOUGH_LENS+ENOUGH_DISTS)
 
@@ -0,0 +1,53 @@
+/* crc32_tune.c -- time the braided crc32() for one choice of N and W
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+   This is compiled by CMake with the ZLIB_CRC32_TUNE option for each N in
+   1..6 and W of 4 and 8, given as Z_TESTN and Z_TESTW, and run on the build
+   host. It writes the speed of crc32_z() in MB/s, or 0 if the result is
+   wrong, and the fastest N and W are then used to build zlib. The processor
+   CRC instructions are disabled here, since the braided code is what is being
+   timed -- it is what crc32_z() falls back on when they are not available.
+ */
+
+#ifndef NO_SIMD
+#  define NO_SIMD
+#endif
+#include "../crc32.c"
+#include <stdio.h>
+#include <time.h>
+
+#define SIZE 32768      /* bytes per crc32_z() call */
+#define TRIALS 3        /* take the fastest of this many */
+
+int main(void) {
+    static unsigned char buf[SIZE];
+    unsigned long k, rounds, best = 0, speed;
+    clock_t start, ticks;
+    uLong crc = 0;
+    int trial;
+
+    if (crc32(0, (const Bytef *)"123456789", 9) != 0xcbf43926UL) {
+        puts("0");
+        return 0;
+    }
+    for (k = 0; k < SIZE; k++)
+        buf[k] = (unsigned char)((k * 2654435761UL) >> 24);
+    for (trial = 0; trial < TRIALS; trial++) {
+        rounds = 0;
+        start = clock();
+        do {
+            crc = crc32_z(crc, buf, SIZE);
+            buf[rounds++ & (SIZE - 1)] ^= (unsigned char)crc;
+            ticks = clock() - start;
+        } while (ticks < CLOCKS_PER_SEC / 20);
+        speed = (unsigned long)((double)rounds * SIZE * CLOCKS_PER_SEC /
+                                ticks / 1e6);
+        if (speed > best)
+            best = speed;
+    }
+    printf("%lu\n", best);
+    return 0;
+}
@@ -40,6 +40,15 @@ static z_const char hello[] = "hello, hello!";
 static const char dictionary[] = "hello";
 static uLong dictId;    /* Adler32 value of the dictionary */
 
+/* ===========================================================================
+ * Return the next of a sequence of pseudo-random 32-bit values, updating the
+ * state at seed, for test data that is the same on every run
+ */
+static uLong next_random(uLong *seed) {
+    *seed = (*seed * 69069 + 1) & 0xffffffff;
+    return *seed;
+}
+
 #ifdef Z_SOLO
 
 static void *myalloc(void *q, unsigned n, unsigned m) {
@@ -84,6 +93,68 @@ static void test_compress(Byte *compr, uLong comprLen, Byte *uncompr,
     }
 }
 
+/* ===========================================================================
+ * Count the lines from gzgetlines(), checking that each is six bytes, and
+ * stop after 100 of them.
+ */
+static int count_line(void *ctx, z_const char *str, unsigned len) {
+    long *lines = (long *)ctx;
+
+    if (len != 6 || str[5] != '\n')
+        return 2;
+    return ++*lines == 100;
+}
+
+/* ===========================================================================
+ * A file in memory for gzopen_funcs().
+ */
+typedef struct {
+    unsigned char data[512];
+    long len;           /* bytes in data */
+    long pos;           /* offset of the next byte to read or write */
+} memfile;
+
+static int mem_read(voidp ctx, voidp buf, unsigned len) {
+    memfile *mem = (memfile *)ctx;
+
+    if (len > (unsigned)(mem->len - mem->pos))
+        len = (unsigned)(mem->len - mem->pos);
+    memcpy(buf, mem->data + mem->pos, len);
+    mem->pos += (long)len;
+    return (int)len;
+}
+
+/* Like mem_read(), but return one byte for a read from the start, as a pipe
+   or a network file may. */
+static int mem_read_short(voidp ctx, voidp buf, unsigned len) {
+    memfile *mem = (memfile *)ctx;
+
+    return mem_read(ctx, buf, mem->pos == 0 && len > 1 ? 1 : len);
+}
+
+static int mem_write(voidp ctx, voidpc buf, unsigned len) {
+    memfile *mem = (memfile *)ctx;
+
+    if (len > sizeof(mem->data) - (unsigned long)mem->pos)
+        return -1;
+    memcpy(mem->data + mem->pos, buf, len);
+    mem->pos += (long)len;
+    if (mem->len < mem->pos)
+        mem->len = mem->pos;
+    return (int)len;
+}
+
+static z_off64_t mem_seek(voidp ctx, z_off64_t offset, int whence) {
+    memfile *mem = (memfile *)ctx;
+
+    offset += whence == SEEK_SET ? 0 : whence == SEEK_CUR ? mem->pos :
+              mem->len;
+    if (offset < 0 || offset > mem->len)
+        return -1;
+    mem->pos = (long)offset;
+    return offset;
+}
+
 /* ===========================================================================
  * Test read/write of .gz files
  */
@@ -95,6 +166,12 @@ static void test_gzio(const char *fname, Byte *uncompr, uLong uncomprLen) {
     int len = (int)strlen(hello)+1;
     gzFile file;
     z_off_t pos;
+    int i;
+    gz_iovec iov[3];
+    static memfile mem;
+    z_const unsigned char *view;
+    unsigned have;
+    long lines;
 
     file = gzopen(fname, "wb");
     if (file == NULL) {
@@ -161,6 +238,266 @@ static void test_gzio(const char *fname, Byte *uncompr, uLong uncomprLen) {
     }
 
     gzclose(file);
+
+    file = gzopen(fname, "rbm");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzseek(file, 7L, SEEK_SET) != 7 || gzrewind(file) != 0 ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char*)uncompr, hello) || gzseek(file, 1L, SEEK_SET) != 1 ||
+        gzgetc(file) != 'e') {
+        fprintf(stderr, "bad gzread memory mapped: %s\n",
+                gzerror(file, &err));
+        exit(1);
+    } else {
+        printf("gzread() memory mapped: %s\n", hello);
+    }
+    gzclose(file);
+
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzreadahead(file, 2) != 0 ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char*)uncompr, hello) || gzrewind(file) != 0 ||
+        gzgetc(file) != 'h' || gzreadahead(file, 2) != -1) {
+        fprintf(stderr, "bad gzread with read-ahead: %s\n",
+                gzerror(file, &err));
+        exit(1);
+    } else {
+        printf("gzread() with read-ahead: %s\n", hello);
+    }
+    gzclose(file);
+
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzwritebehind(file, 2) != 0 || gzputs(file, "hello,") != 6 ||
+        gzflush(file, Z_SYNC_FLUSH) != Z_OK ||
+        gzsetparams(file, 1, Z_DEFAULT_STRATEGY) != Z_OK ||
+        gzprintf(file, " %s!", "hello") != 7 || gzputc(file, 0) != 0 ||
+        gzwritebehind(file, 2) != -1 || gzclose(file) != Z_OK) {
+        fprintf(stderr, "bad gzwrite with write-behind\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad gzread after write-behind: %s\n",
+                gzerror(file, &err));
+        exit(1);
+    } else {
+        printf("gzwrite() with write-behind: %s\n", hello);
+    }
+    gzclose(file);
+
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzsetthreads(file, 2) != 0 || gzputs(file, "hello,") != 6 ||
+        gzsetparams(file, 9, Z_DEFAULT_STRATEGY) != Z_OK ||
+        gzflush(file, Z_FINISH) != Z_OK ||
+        gzprintf(file, " %s!", "hello") != 7 || gzputc(file, 0) != 0 ||
+        gzsetthreads(file, 2) != -1 || gzclose(file) != Z_OK) {
+        fprintf(stderr, "bad gzwrite with threads\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad gzread after threads: %s\n",
+                gzerror(file, &err));
+        exit(1);
+    } else {
+        printf("gzwrite() with threads: %s\n", hello);
+    }
+    gzclose(file);
+
+    iov[0].base = hello;
+    iov[0].len = 6;
+    iov[1].base = hello + 6;
+    iov[1].len = 0;
+    iov[2].base = hello + 6;
+    iov[2].len = (z_size_t)len - 6;
+    for (i = 0; i < 2; i++) {
+        file = gzopen(fname, i ? "wT" : "wb");
+        if (file == NULL) {
+            fprintf(stderr, "gzopen error\n");
+            exit(1);
+        }
+        if (gzbuffer(file, 8) != 0 ||
+            gzwritev(file, iov, 3) != (z_size_t)len ||
+            gzwritev(file, iov, -1) != 0) {
+            fprintf(stderr, "bad gzwritev\n");
+            exit(1);
+        }
+        gzclose(file);
+        file = gzopen(fname, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "gzopen error\n");
+            exit(1);
+        }
+        if (gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+            strcmp((char*)uncompr, hello) || gzdirect(file) != i) {
+            fprintf(stderr, "bad gzread after gzwritev\n");
+            exit(1);
+        }
+        gzclose(file);
+    }
+    printf("gzwritev(): %s\n", hello);
+
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzbufferalign(file, 3, 0) != -1 || gzbufferalign(file, 4096, 1) ||
+        gzputs(file, hello) != len - 1 || gzputc(file, 0) != 0 ||
+        gzbufferalign(file, 64, 0) != -1 || gzclose(file) != Z_OK) {
+        fprintf(stderr, "bad gzwrite with gzbufferalign\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzbufferalign(file, 4096, 1) ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad gzread with gzbufferalign\n");
+        exit(1);
+    } else {
+        printf("gzbufferalign(): %s\n", hello);
+    }
+    gzclose(file);
+
+    mem.len = mem.pos = 0;
+    file = gzopen_funcs(&mem, NULL, mem_write, mem_seek, NULL, "wb");
+    if (file == NULL ||
+        gzopen_funcs(&mem, NULL, mem_write, mem_seek, NULL, "rb") != NULL) {
+        fprintf(stderr, "gzopen_funcs error\n");
+        exit(1);
+    }
+    if (gzprintf(file, "%s", hello) != len - 1 || gzputc(file, 0) != 0 ||
+        gzclose(file) != Z_OK || mem.len < 20) {
+        fprintf(stderr, "bad gzwrite with gzopen_funcs\n");
+        exit(1);
+    }
+    mem.pos = 0;
+    file = gzopen_funcs(&mem, mem_read, NULL, mem_seek, NULL, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen_funcs error\n");
+        exit(1);
+    }
+    if (gzseek(file, 7L, SEEK_SET) != 7L ||
+        gzgets(file, (char *)uncompr, (int)uncomprLen) == NULL ||
+        strcmp((char *)uncompr, hello + 7) || gzrewind(file) != 0 ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char *)uncompr, hello) || gzoffset(file) != mem.len) {
+        fprintf(stderr, "bad gzread with gzopen_funcs\n");
+        exit(1);
+    } else {
+        printf("gzopen_funcs(): %s\n", hello);
+    }
+    gzclose(file);
+
+    mem.pos = 0;
+    file = gzopen_funcs(&mem, mem_read_short, NULL, mem_seek, NULL, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen_funcs error\n");
+        exit(1);
+    }
+    if (gzreadahead(file, 3) != 0 ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len ||
+        strcmp((char *)uncompr, hello) || gzdirect(file) ||
+        gzseek(file, 1L, SEEK_SET) != 1L ||
+        gzread(file, uncompr, (unsigned)uncomprLen) != len - 1 ||
+        strcmp((char *)uncompr, hello + 1)) {
+        fprintf(stderr, "bad gzread with read-ahead and short reads\n");
+        exit(1);
+    } else {
+        printf("gzread() with read-ahead and short reads: %s\n", hello);
+    }
+    gzclose(file);
+
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    for (i = 0; i < 20000; i++)
+        gzprintf(file, "%05d\n", i);
+    gzclose(file);
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzindex(file, 8192, NULL) != 0 ||
+        gzseek(file, 6L * 19999, SEEK_SET) != 6L * 19999 ||
+        gzseek(file, 6L * 12345, SEEK_SET) != 6L * 12345 ||
+        gzread(file, uncompr, 6) != 6 || memcmp(uncompr, "12345\n", 6) ||
+        gzseek(file, 6L * 19999, SEEK_SET) != 6L * 19999 ||
+        gzread(file, uncompr, 7) != 6 || memcmp(uncompr, "19999\n", 6) ||
+        !gzeof(file) || gzclose(file) != Z_OK) {
+        fprintf(stderr, "bad gzseek with access points\n");
+        exit(1);
+    } else {
+        printf("gzseek() with access points: %.5s\n", (char *)uncompr);
+    }
+
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    lines = 0;
+    while (gzreadview(file, &view, &have) == 0 && have &&
+           gzconsume(file, have) == 0)
+        while (have)
+            lines += view[--have] == '\n';
+    if (lines != 20000 || gztell(file) != 6L * 20000 || !gzeof(file) ||
+        gzconsume(file, 1) != -1) {
+        fprintf(stderr, "bad gzreadview\n");
+        exit(1);
+    } else {
+        printf("gzreadview(): %ld lines\n", lines);
+    }
+    gzclose(file);
+
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    lines = 0;
+    if (gzgetlines(file, count_line, &lines) != 1 ||
+        !gzgets(file, (char *)uncompr, (int)uncomprLen) ||
+        strcmp((char *)uncompr, "00100\n") ||
+        gzgetlines(file, count_line, &lines) != 0 || lines != 20000 - 1) {
+        fprintf(stderr, "bad gzgetlines\n");
+        exit(1);
+    } else {
+        printf("gzgetlines(): %ld lines\n", lines + 1);
+    }
+    gzclose(file);
 #endif
 }
 
@@ -332,6 +669,270 @@ static void test_large_inflate(Byte *compr, uLong comprLen, Byte *uncompr,
     }
 }
 
+/* ===========================================================================
+ * Test deflate() of all of a large input at once, which uses the input
+ * directly as the window, against deflate() of the same input in pieces
+ */
+static void test_direct(void) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 200000, bound, k, pos, seed = 1;
+    Byte *buf, *once, *pieces;
+    int err, piece;
+
+    buf = (Byte*)malloc(len);
+    bound = len + (len >> 3) + 64;
+    once = (Byte*)malloc(bound);
+    pieces = (Byte*)malloc(bound);
+    if (buf == Z_NULL || once == Z_NULL || pieces == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = (Byte)(hello[k % (sizeof(hello) - 1)] +
+                        (next_random(&seed) >> 30));
+
+    for (piece = 0; piece < 2; piece++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+        err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+        CHECK_ERR(err, "deflateInit");
+        c_stream.next_out = piece ? pieces : once;
+        c_stream.avail_out = (uInt)bound;
+        pos = 0;
+        do {
+            c_stream.next_in = buf + pos;
+            c_stream.avail_in = piece && len - pos > 1000 ? 1000 :
+                                (uInt)(len - pos);
+            pos += c_stream.avail_in;
+            err = deflate(&c_stream, pos == len ? Z_FINISH : Z_NO_FLUSH);
+        } while (pos < len);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+        if (piece == 0)
+            k = c_stream.total_out;
+    }
+    if (k != c_stream.total_out || memcmp(once, pieces, (size_t)k)) {
+        fprintf(stderr, "bad deflate of all of the input\n");
+        exit(1);
+    }
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in  = once;
+    d_stream.avail_in = (uInt)k;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    d_stream.next_out = pieces;
+    d_stream.avail_out = (uInt)bound;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END || d_stream.total_out != len ||
+        memcmp(pieces, buf, (size_t)len)) {
+        fprintf(stderr, "bad inflate of all of the input\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    printf("deflate() of all of the input: %lu bytes, same as in pieces\n",
+           k);
+    free(pieces);
+    free(once);
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test deflateLitMem() against the default symbol buffers
+ */
+static void test_lit_mem(void) {
+    z_stream c_stream; /* compression stream */
+    uLong len = 100000, bound, k, seed = 1, size[2];
+    Byte *buf, *out[2];
+    int err, lit_mem;
+
+    buf = (Byte*)malloc(len);
+    bound = len + (len >> 3) + 64;
+    out[0] = (Byte*)malloc(bound);
+    out[1] = (Byte*)malloc(bound);
+    if (buf == Z_NULL || out[0] == Z_NULL || out[1] == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = (Byte)(hello[k % (sizeof(hello) - 1)] +
+                        (next_random(&seed) >> 30));
+
+    for (lit_mem = 0; lit_mem < 2; lit_mem++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+        err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+        CHECK_ERR(err, "deflateInit");
+        err = deflateLitMem(&c_stream, lit_mem);
+        CHECK_ERR(err, "deflateLitMem");
+        c_stream.next_in = buf;
+        c_stream.avail_in = 1000;
+        c_stream.next_out = out[lit_mem];
+        c_stream.avail_out = (uInt)bound;
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+        if (deflateLitMem(&c_stream, !lit_mem) != Z_STREAM_ERROR) {
+            fprintf(stderr, "deflateLitMem should fail with pending "
+                    "symbols\n");
+            exit(1);
+        }
+        c_stream.avail_in = (uInt)len - 1000;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        size[lit_mem] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    if (size[0] != size[1] || memcmp(out[0], out[1], (size_t)size[0])) {
+        fprintf(stderr, "bad deflate with deflateLitMem\n");
+        exit(1);
+    }
+    printf("deflateLitMem(): %lu bytes, same as without\n", size[1]);
+    free(out[1]);
+    free(out[0]);
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test deflateUseDictionary() against deflateSetDictionary(), and
+ * inflateUseDictionary() on the result
+ */
+static void test_dict_prepared(void) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    z_deflate_dictp dict;
+    z_inflate_dictp idict;
+    uLong len = 40000, bound, k, seed = 1, size[3], id[3];
+    Byte *buf, *out[3];
+    int err, n;
+
+    buf = (Byte*)malloc(len);
+    bound = len + (len >> 3) + 64;
+    out[0] = (Byte*)malloc(bound);
+    out[1] = (Byte*)malloc(bound);
+    out[2] = (Byte*)malloc(bound);
+    if (buf == Z_NULL || out[0] == Z_NULL || out[1] == Z_NULL ||
+        out[2] == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = (Byte)(hello[k % (sizeof(hello) - 1)] +
+                        (next_random(&seed) >> 30));
+
+    /* out[0] with deflateSetDictionary(), out[1] and out[2] using dict, the
+       first on the stream that prepared it, compressing the dictionary's
+       last 5000 bytes */
+    dict = Z_NULL;
+    for (n = 0; n < 3; n++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+        err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+        CHECK_ERR(err, "deflateInit");
+        if (n == 0)
+            err = deflateSetDictionary(&c_stream, buf, (uInt)len);
+        else {
+            if (n == 1) {
+                dict = deflatePrepareDictionary(&c_stream, buf, (uInt)len);
+                if (dict == Z_NULL) {
+                    fprintf(stderr, "deflatePrepareDictionary error\n");
+                    exit(1);
+                }
+            }
+            err = deflateUseDictionary(&c_stream, dict);
+        }
+        CHECK_ERR(err, "set dictionary");
+        id[n] = c_stream.adler;
+        c_stream.next_in = buf + len - 5000;
+        c_stream.avail_in = 5000;
+        c_stream.next_out = out[n];
+        c_stream.avail_out = (uInt)bound;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        if (deflateUseDictionary(&c_stream, dict) != Z_STREAM_ERROR) {
+            fprintf(stderr, "deflateUseDictionary should fail after "
+                    "deflate\n");
+            exit(1);
+        }
+        size[n] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    deflateFreeDictionary(dict);
+    for (n = 1; n < 3; n++)
+        if (size[n] != size[0] || id[n] != id[0] ||
+            memcmp(out[n], out[0], (size_t)size[0])) {
+            fprintf(stderr, "bad deflate with deflateUseDictionary\n");
+            exit(1);
+        }
+    printf("deflateUseDictionary(): %lu bytes, same as "
+           "deflateSetDictionary()\n", size[0]);
+
+    /* decompress out[0] with a prepared dictionary, in one call with
+       Z_FINISH and then with little output at a time */
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    idict = inflatePrepareDictionary(&d_stream, buf, (uInt)len);
+    if (idict == Z_NULL) {
+        fprintf(stderr, "inflatePrepareDictionary error\n");
+        exit(1);
+    }
+    for (n = 0; n < 2; n++) {
+        err = inflateReset(&d_stream);
+        CHECK_ERR(err, "inflateReset");
+        d_stream.next_in = out[0];
+        d_stream.avail_in = (uInt)size[0];
+        d_stream.next_out = out[1];
+        d_stream.avail_out = n ? 0 : 5000;
+        err = inflate(&d_stream, n ? Z_NO_FLUSH : Z_FINISH);
+        if (err != Z_NEED_DICT || d_stream.adler != id[0]) {
+            fprintf(stderr, "inflate should report Z_NEED_DICT\n");
+            exit(1);
+        }
+        err = inflateUseDictionary(&d_stream, idict);
+        CHECK_ERR(err, "inflateUseDictionary");
+        do {
+            if (n)
+                d_stream.avail_out = 7;
+            err = inflate(&d_stream, n ? Z_NO_FLUSH : Z_FINISH);
+        } while (err == Z_OK);
+        if (err != Z_STREAM_END || d_stream.total_out != 5000 ||
+            memcmp(out[1], buf + len - 5000, 5000)) {
+            fprintf(stderr, "bad inflate with inflateUseDictionary\n");
+            exit(1);
+        }
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    inflateFreeDictionary(idict);
+    printf("inflateUseDictionary(): %lu bytes, in one call and in pieces\n",
+           d_stream.total_out);
+    free(out[2]);
+    free(out[1]);
+    free(out[0]);
+    free(buf);
+}
+
 /* ===========================================================================
  * Test deflate() with full flush
  */
@@ -490,6 +1091,1972 @@ static void test_dict_inflate(Byte *compr, uLong comprLen, Byte *uncompr,
     }
 }
 
+/* ===========================================================================
+ * Test deflate() with the CRC-32C hash, and inflate() of the result
+ */
+static void test_hash(Byte *compr, uLong comprLen, Byte *uncompr,
+                      uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 0;
+    int err;
+
+    while (len + sizeof(hello) <= uncomprLen) {
+        memcpy(uncompr + len, hello, sizeof(hello) - 1);
+        len += sizeof(hello) - 1;
+        uncompr[len] = (Byte)('a' + len % 26);
+        len++;
+    }
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_BEST_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    err = deflateHash(&c_stream, Z_HASH_CRC32C);
+    CHECK_ERR(err, "deflateHash");
+
+    c_stream.next_in  = uncompr;
+    c_stream.avail_in = (uInt)len / 2;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    if (deflateHash(&c_stream, Z_HASH_ROLLING) != Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateHash should fail after input\n");
+        exit(1);
+    }
+    c_stream.avail_in = (uInt)(len - len / 2);
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_out = compr + c_stream.total_out;
+    d_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len ||
+        memcmp(compr + c_stream.total_out, uncompr, len)) {
+        fprintf(stderr, "bad inflate of crc32c hash deflate\n");
+        exit(1);
+    } else {
+        printf("deflate with crc32c hash: %ld -> %ld\n", len,
+               c_stream.total_out);
+    }
+
+    /* Optimal parsing of exactly a full window of input, ending at the end
+       of uncompr, must not hash past the end of the input when finishing */
+    len = 2 << 12;
+    err = deflateInit2(&c_stream, 12, Z_DEFLATED, 12, 8, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateInit2");
+    err = deflateHash(&c_stream, Z_HASH_CRC32C);
+    CHECK_ERR(err, "deflateHash");
+    c_stream.next_in  = uncompr + uncomprLen - len;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    d_stream.next_out = compr + c_stream.total_out;
+    d_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (d_stream.total_out != len ||
+        memcmp(compr + c_stream.total_out, uncompr + uncomprLen - len, len)) {
+        fprintf(stderr, "bad inflate of optimal crc32c hash deflate\n");
+        exit(1);
+    }
+}
+
+/* ===========================================================================
+ * Test deflatePrime() and deflatePending() by priming a raw deflate stream
+ * with an empty fixed block, and inflate() of the result
+ */
+static void test_prime(Byte *compr, uLong comprLen, Byte *uncompr,
+                       uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    unsigned pending;
+    int bits, err;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                       -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateInit2");
+
+    /* ten bits: not last, fixed codes, and the seven-bit end-of-block code */
+    err = deflatePrime(&c_stream, 10, 2);
+    CHECK_ERR(err, "deflatePrime");
+    err = deflatePending(&c_stream, &pending, &bits);
+    CHECK_ERR(err, "deflatePending");
+    if (pending != 1 || bits != 2) {
+        fprintf(stderr, "deflatePending should report 1 byte, 2 bits\n");
+        exit(1);
+    }
+
+    c_stream.next_in  = (z_const unsigned char *)hello;
+    c_stream.avail_in = (uInt)strlen(hello)+1;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit2(&d_stream, -MAX_WBITS);
+    CHECK_ERR(err, "inflateInit2");
+
+    d_stream.next_out = uncompr;
+    d_stream.avail_out = (uInt)uncomprLen;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad inflate of primed deflate\n");
+        exit(1);
+    } else {
+        printf("deflatePrime(): %s\n", (char *)uncompr);
+    }
+}
+
+/* ===========================================================================
+ * Test deflate() with the Z_QUICK strategy with small output buffers, a flush,
+ * and a switch to the default strategy, and inflate() of the result
+ */
+static void test_quick(Byte *compr, uLong comprLen, Byte *uncompr,
+                       uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 0;
+    int err;
+
+    while (len + sizeof(hello) <= uncomprLen / 2) {
+        memcpy(uncompr + len, hello, sizeof(hello) - 1);
+        len += sizeof(hello) - 1;
+        uncompr[len] = (Byte)('a' + len % 26);
+        len++;
+    }
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit2(&c_stream, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS, 8,
+                       Z_QUICK);
+    CHECK_ERR(err, "deflateInit2");
+
+    c_stream.next_in  = uncompr;
+    c_stream.next_out = compr;
+    while (c_stream.total_in != len / 2) {
+        c_stream.avail_in = c_stream.avail_out = 1; /* force small buffers */
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+    }
+    c_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = deflate(&c_stream, Z_SYNC_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflateParams(&c_stream, Z_BEST_SPEED, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateParams");
+    c_stream.avail_in = (uInt)(len - len / 2);
+    err = deflate(&c_stream, Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflateParams(&c_stream, Z_BEST_SPEED, Z_QUICK);
+    CHECK_ERR(err, "deflateParams");
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_out = uncompr + len;
+    d_stream.avail_out = (uInt)(uncomprLen - len);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len || memcmp(uncompr + len, uncompr, len)) {
+        fprintf(stderr, "bad inflate of quick deflate\n");
+        exit(1);
+    } else {
+        printf("deflate with quick strategy: %ld -> %ld\n", len,
+               c_stream.total_out);
+    }
+}
+
+/* ===========================================================================
+ * Test deflateParallel() with small chunks and a flush, and inflate() of the
+ * result
+ */
+static void test_parallel(Byte *compr, uLong comprLen, Byte *uncompr,
+                          uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    Byte *back = compr + comprLen / 2;
+    uLong len = uncomprLen, sent = 0;
+    int err;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateParallelInit2(&c_stream, Z_DEFAULT_COMPRESSION, 31, 8,
+                               Z_DEFAULT_STRATEGY, 3, 1024);
+    CHECK_ERR(err, "deflateParallelInit2");
+
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen / 2;
+    while (sent < len) {
+        c_stream.next_in = uncompr + sent;
+        c_stream.avail_in = (uInt)(len - sent < 777 ? len - sent : 777);
+        sent += c_stream.avail_in;
+        err = deflateParallel(&c_stream,
+                              sent == len / 2 ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        CHECK_ERR(err, "deflateParallel");
+    }
+    err = deflateParallel(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflateParallel should report Z_STREAM_END\n");
+        exit(1);
+    }
+    if (c_stream.adler != crc32(0L, uncompr, (uInt)len)) {
+        fprintf(stderr, "bad deflateParallel check value\n");
+        exit(1);
+    }
+    err = deflateParallelEnd(&c_stream);
+    CHECK_ERR(err, "deflateParallelEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit2(&d_stream, 31);
+    CHECK_ERR(err, "inflateInit2");
+
+    d_stream.next_out = back;
+    d_stream.avail_out = (uInt)(comprLen - comprLen / 2);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len || memcmp(back, uncompr, len)) {
+        fprintf(stderr, "bad inflate of parallel deflate\n");
+        exit(1);
+    } else {
+        printf("parallel deflate: %ld -> %ld\n", len, c_stream.total_out);
+    }
+}
+
+/* ===========================================================================
+ * Test deflateInitMem() and inflateInitMem() with a block starting at an odd
+ * address, first with one byte too few, and then inflate() of the result in
+ * the same block
+ */
+static void test_mem(Byte *compr, uLong comprLen, Byte *uncompr,
+                     uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong size, dsize;
+    Byte *mem;
+    int err;
+
+    size = deflateStateSize(Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                            Z_DEFAULT_STRATEGY);
+    dsize = inflateStateSize(MAX_WBITS);
+    if (size == 0 || dsize == 0) {
+        fprintf(stderr, "deflateStateSize or inflateStateSize failed\n");
+        exit(1);
+    }
+    mem = (Byte *)malloc((size < dsize ? dsize : size) + 1);
+    if (mem == Z_NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    err = deflateInitMem(&c_stream, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY, mem + 1, size - 1);
+    if (err != Z_MEM_ERROR) {
+        fprintf(stderr, "deflateInitMem should report Z_MEM_ERROR\n");
+        exit(1);
+    }
+    err = deflateInitMem(&c_stream, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY, mem + 1, size);
+    CHECK_ERR(err, "deflateInitMem");
+
+    c_stream.next_in  = (z_const unsigned char *)hello;
+    c_stream.avail_in = (uInt)strlen(hello)+1;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInitMem(&d_stream, MAX_WBITS, mem + 1, dsize);
+    CHECK_ERR(err, "inflateInitMem");
+
+    d_stream.next_out = uncompr;
+    d_stream.avail_out = (uInt)uncomprLen;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    free(mem);
+
+    if (strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad inflate in caller-provided memory\n");
+        exit(1);
+    } else {
+        printf("deflateInitMem(): %s\n", (char *)uncompr);
+    }
+}
+
+/* ===========================================================================
+ * Test deflate() with optimal parsing at levels 10 to 12, with small buffers,
+ * a flush, and a change of level
+ */
+static void test_optimal(Byte *compr, uLong comprLen, Byte *uncompr,
+                         uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 0;
+    int err;
+
+    while (len + sizeof(hello) <= uncomprLen / 2) {
+        memcpy(uncompr + len, hello, sizeof(hello) - 1);
+        len += sizeof(hello) - 1;
+        uncompr[len] = (Byte)('a' + len % 7);
+        len++;
+    }
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, 12);
+    CHECK_ERR(err, "deflateInit");
+    err = deflateOptimize(&c_stream, 3, 0);
+    CHECK_ERR(err, "deflateOptimize");
+
+    c_stream.next_in  = uncompr;
+    c_stream.next_out = compr;
+    while (c_stream.total_in != len / 2) {
+        c_stream.avail_in = c_stream.avail_out = 1; /* force small buffers */
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+    }
+    c_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = deflate(&c_stream, Z_SYNC_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflateParams(&c_stream, 10, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateParams");
+    c_stream.avail_in = (uInt)(len - len / 2);
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_out = uncompr + len;
+    d_stream.avail_out = (uInt)(uncomprLen - len);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len || memcmp(uncompr + len, uncompr, len)) {
+        fprintf(stderr, "bad inflate of optimal deflate\n");
+        exit(1);
+    } else {
+        printf("deflate with optimal parsing: %ld -> %ld\n", len,
+               c_stream.total_out);
+    }
+}
+
+/* ===========================================================================
+ * Test inflateCheckpoint() and inflateRestore(), resuming decompression from a
+ * block boundary in the middle of a stream with sync flushes
+ */
+static void test_checkpoint(Byte *compr, uLong comprLen, Byte *uncompr,
+                            uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = uncomprLen / 8 * 4, size, at;
+    Byte *ckpt;
+    int err, k;
+
+    for (k = 0; k < (int)len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + k / 1000);
+    memset(uncompr + len, 0, len);
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+
+    c_stream.next_in  = uncompr;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    for (k = 1; k <= 4; k++) {
+        c_stream.avail_in = (uInt)(len / 4);
+        err = deflate(&c_stream, k < 4 ? Z_SYNC_FLUSH : Z_FINISH);
+        if (err != (k < 4 ? Z_OK : Z_STREAM_END)) {
+            fprintf(stderr, "deflate error %d\n", err);
+            exit(1);
+        }
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_out = uncompr + len;
+    d_stream.avail_out = (uInt)len;
+    do {
+        err = inflate(&d_stream, Z_BLOCK);
+        CHECK_ERR(err, "inflate");
+    } while (d_stream.total_out < len / 2 || (d_stream.data_type & 128) == 0);
+    err = inflateCheckpoint(&d_stream, Z_NULL, &size);
+    CHECK_ERR(err, "inflateCheckpoint");
+    ckpt = (Byte *)calloc((uInt)size, 1);
+    if (ckpt == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    err = inflateCheckpoint(&d_stream, ckpt, &size);
+    CHECK_ERR(err, "inflateCheckpoint");
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    err = inflateRestore(&d_stream, ckpt, size);
+    CHECK_ERR(err, "inflateRestore");
+    free(ckpt);
+
+    at = d_stream.total_in;
+    d_stream.next_in = compr + at;
+    d_stream.avail_in = (uInt)(c_stream.total_out - at);
+    d_stream.next_out = uncompr + len + d_stream.total_out;
+    d_stream.avail_out = (uInt)(len - d_stream.total_out);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len || memcmp(uncompr + len, uncompr, len)) {
+        fprintf(stderr, "bad inflate after inflateRestore\n");
+        exit(1);
+    } else {
+        printf("inflateRestore(): resumed at %ld of %ld\n", at,
+               c_stream.total_out);
+    }
+}
+
+/* ===========================================================================
+ * Test inflateParallel() on two gzip members written with full flushes, with
+ * small regions so that the threads have several to decode
+ */
+static void test_inflate_parallel(Byte *compr, uLong comprLen, Byte *uncompr,
+                                  uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    Byte *back = compr + comprLen / 2;
+    uLong len = uncomprLen / 1000 * 500, sent, used = 0;
+    int err, k;
+
+    for (k = 0; k < (int)len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + k / 1000);
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    for (k = 0; k < 2; k++) {
+        err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+                           Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflateInit2");
+        c_stream.next_out = compr + used;
+        c_stream.avail_out = (uInt)(comprLen / 2 - used);
+        for (sent = 0; sent < len; sent += 500) {
+            c_stream.next_in = uncompr + sent;
+            c_stream.avail_in = 500;
+            err = deflate(&c_stream,
+                          sent + 500 < len ? Z_FULL_FLUSH : Z_FINISH);
+            if (err < 0) {
+                fprintf(stderr, "deflate error %d\n", err);
+                exit(1);
+            }
+        }
+        used += c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)used;
+    d_stream.next_out = back;
+    d_stream.avail_out = (uInt)(comprLen - comprLen / 2);
+    err = inflateParallel(&d_stream, 31, 3, 256, Z_NULL, Z_NULL);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflateParallel should report Z_STREAM_END\n");
+        exit(1);
+    }
+    if (d_stream.total_out != 2 * len || d_stream.avail_in != 0 ||
+        memcmp(back, uncompr, len) || memcmp(back + len, uncompr, len) ||
+        d_stream.adler != crc32(0L, uncompr, (uInt)len)) {
+        fprintf(stderr, "bad inflateParallel\n");
+        exit(1);
+    } else {
+        printf("inflateParallel(): %ld -> %ld\n", used, d_stream.total_out);
+    }
+}
+
+/* A place to keep the first checkpoint from inflateParallel2() */
+typedef struct {
+    Byte *buf;          /* space for the checkpoint */
+    uLong size;         /* size of buf */
+    uLong len;          /* length of the checkpoint, zero if none yet */
+} keep_ckpt;
+
+static int keep_first(void *desc, unsigned char *buf, unsigned len) {
+    keep_ckpt *keep = (keep_ckpt *)desc;
+
+    if (keep->len == 0 && len <= keep->size) {
+        memcpy(keep->buf, buf, len);
+        keep->len = len;
+    }
+    return 0;
+}
+
+/* ===========================================================================
+ * Test inflateParallel2() on a zlib stream with sync flushes, where the
+ * regions after the first refer to data before them, and then resume from
+ * its first index checkpoint with inflateRestore()
+ */
+static void test_inflate_index(Byte *compr, uLong comprLen, Byte *uncompr,
+                               uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    Byte *back = compr + comprLen / 2;
+    uLong len = uncomprLen / 1000 * 500, sent, at, done;
+    keep_ckpt keep;
+    int err, k;
+
+    for (k = 0; k < (int)len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + k / 1000);
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)(comprLen / 2);
+    for (sent = 0; sent < len; sent += 500) {
+        c_stream.next_in = uncompr + sent;
+        c_stream.avail_in = 500;
+        err = deflate(&c_stream, sent + 500 < len ? Z_SYNC_FLUSH : Z_FINISH);
+        if (err < 0) {
+            fprintf(stderr, "deflate error %d\n", err);
+            exit(1);
+        }
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    keep.size = 32768 + 64;
+    keep.len = 0;
+    keep.buf = (Byte *)calloc((uInt)keep.size, 1);
+    if (keep.buf == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    d_stream.next_out = back;
+    d_stream.avail_out = (uInt)len;
+    err = inflateParallel2(&d_stream, 15, 3, 256, Z_NULL, Z_NULL,
+                           keep_first, &keep);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflateParallel2 should report Z_STREAM_END\n");
+        exit(1);
+    }
+    if (d_stream.total_out != len || memcmp(back, uncompr, len) ||
+        keep.len == 0) {
+        fprintf(stderr, "bad inflateParallel2\n");
+        exit(1);
+    }
+
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    err = inflateRestore(&d_stream, keep.buf, keep.len);
+    CHECK_ERR(err, "inflateRestore");
+    free(keep.buf);
+
+    at = d_stream.total_in;
+    done = d_stream.total_out;
+    d_stream.next_in = compr + at;
+    d_stream.avail_in = (uInt)(c_stream.total_out - at);
+    d_stream.next_out = back + len;
+    d_stream.avail_out = (uInt)(len - done);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (d_stream.total_out != len ||
+        memcmp(back + len, uncompr + done, len - done)) {
+        fprintf(stderr, "bad inflate after inflateParallel2 checkpoint\n");
+        exit(1);
+    } else {
+        printf("inflateParallel2(): resumed at %ld of %ld\n", at,
+               c_stream.total_out);
+    }
+}
+
+/* Memory input and output for the inflateIndex functions, a chunk at a time */
+typedef struct {
+    Byte *buf;          /* data */
+    uLong len;          /* length of the data, or of the space for output */
+    uLong pos;          /* next position to read or write */
+} index_io;
+
+static unsigned index_in(void *desc, z_const unsigned char **buf) {
+    index_io *io = (index_io *)desc;
+    uLong n = io->len - io->pos;
+
+    if (n > 1000)
+        n = 1000;
+    *buf = io->buf + io->pos;
+    io->pos += n;
+    return (unsigned)n;
+}
+
+static int index_seek(void *desc, z_off64_t pos) {
+    index_io *io = (index_io *)desc;
+
+    if (pos < 0 || (uLong)pos > io->len)
+        return -1;
+    io->pos = (uLong)pos;
+    return 0;
+}
+
+static int index_out(void *desc, unsigned char *buf, unsigned len) {
+    index_io *io = (index_io *)desc;
+
+    if (len > io->len - io->pos)
+        return 1;
+    memcpy(io->buf + io->pos, buf, len);
+    io->pos += len;
+    return 0;
+}
+
+/* ===========================================================================
+ * Test inflateIndexBuild() on a two-member gzip stream, save the index and
+ * load it back, and extract from it across the member boundary
+ */
+static void test_index_extract(Byte *compr, uLong comprLen, Byte *uncompr,
+                               uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    z_indexp index, loaded;
+    index_io src, dst;
+    Byte *back;
+    uLong len = uncomprLen / 2, half = len / 2, at, got;
+    z_off64_t length, compressed;
+    unsigned long points;
+    int err, k, m;
+
+    for (k = 0; k < (int)len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + k / 1000);
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    src.len = 0;
+    for (m = 0; m < 2; m++) {
+        err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31,
+                           8, Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflateInit2");
+        for (at = m * half; at < (m ? len : half); at += got) {
+            got = (m ? len : half) - at;
+            if (got > 1000)
+                got = 1000;
+            c_stream.next_in = uncompr + at;
+            c_stream.avail_in = (uInt)got;
+            err = deflate(&c_stream, at + got == (m ? len : half) ?
+                                     Z_FINISH : Z_SYNC_FLUSH);
+            if (err < 0) {
+                fprintf(stderr, "deflate error %d\n", err);
+                exit(1);
+            }
+        }
+        src.len += c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    src.buf = compr;
+    src.pos = 0;
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in = Z_NULL;
+    d_stream.avail_in = 0;
+    err = inflateIndexBuild(&d_stream, 15 + 32, 1500, index_in, &src, &index);
+    CHECK_ERR(err, "inflateIndexBuild");
+    inflateIndexInfo(index, &length, &compressed, &points);
+    if (length != (z_off64_t)len || compressed != (z_off64_t)src.len ||
+        points < 4) {
+        fprintf(stderr, "bad inflateIndexInfo\n");
+        exit(1);
+    }
+
+    dst.len = src.len + 65536L;
+    dst.pos = 0;
+    dst.buf = (Byte *)malloc(dst.len);
+    back = (Byte *)malloc(len);
+    if (dst.buf == Z_NULL || back == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    err = inflateIndexSave(index, index_out, &dst);
+    CHECK_ERR(err, "inflateIndexSave");
+    inflateIndexFree(index);
+    dst.len = dst.pos;
+    dst.pos = 0;
+    err = inflateIndexLoad(&d_stream, index_in, &dst, &loaded);
+    CHECK_ERR(err, "inflateIndexLoad");
+
+    /* extract a piece spanning the members, the tail, and past the end */
+    at = half - 3000;
+    got = 6000;
+    err = inflateIndexExtract(loaded, at, back, &got, index_in, index_seek,
+                              &src);
+    CHECK_ERR(err, "inflateIndexExtract");
+    if (got != 6000 || memcmp(back, uncompr + at, got)) {
+        fprintf(stderr, "bad inflateIndexExtract across members\n");
+        exit(1);
+    }
+    at = len - 5000;
+    got = 10000;
+    err = inflateIndexExtract(loaded, at, back, &got, index_in, index_seek,
+                              &src);
+    CHECK_ERR(err, "inflateIndexExtract");
+    if (got != 5000 || memcmp(back, uncompr + at, got)) {
+        fprintf(stderr, "bad inflateIndexExtract at end\n");
+        exit(1);
+    }
+    got = 100;
+    err = inflateIndexExtract(loaded, len, back, &got, index_in, index_seek,
+                              &src);
+    CHECK_ERR(err, "inflateIndexExtract");
+    if (got != 0) {
+        fprintf(stderr, "bad inflateIndexExtract past end\n");
+        exit(1);
+    }
+    inflateIndexFree(loaded);
+
+    /* a corrupted index must be rejected */
+    dst.buf[dst.len / 2] ^= 1;
+    dst.pos = 0;
+    err = inflateIndexLoad(&d_stream, index_in, &dst, &loaded);
+    if (err != Z_DATA_ERROR || loaded != Z_NULL) {
+        fprintf(stderr, "inflateIndexLoad should report Z_DATA_ERROR\n");
+        exit(1);
+    }
+
+    /* build the index on threads, and extract using its saved copy */
+    d_stream.next_in = compr;
+    d_stream.avail_in = (uInt)src.len;
+    err = inflateIndexParallel(&d_stream, 15 + 32, 400, 3, &index);
+    CHECK_ERR(err, "inflateIndexParallel");
+    inflateIndexInfo(index, &length, &compressed, &points);
+    if (length != (z_off64_t)len || compressed != (z_off64_t)src.len ||
+        points < 2) {
+        fprintf(stderr, "bad inflateIndexParallel\n");
+        exit(1);
+    }
+    dst.len = src.len + 65536L;
+    dst.pos = 0;
+    err = inflateIndexSave(index, index_out, &dst);
+    CHECK_ERR(err, "inflateIndexSave");
+    inflateIndexFree(index);
+    dst.len = dst.pos;
+    dst.pos = 0;
+    err = inflateIndexLoad(&d_stream, index_in, &dst, &loaded);
+    CHECK_ERR(err, "inflateIndexLoad");
+    for (at = 0; at < len; at += 1700) {
+        got = 2500;
+        err = inflateIndexExtract(loaded, at, back, &got, index_in, index_seek,
+                                  &src);
+        CHECK_ERR(err, "inflateIndexExtract");
+        if (got != (len - at < 2500 ? len - at : 2500) ||
+            memcmp(back, uncompr + at, got)) {
+            fprintf(stderr, "bad inflateIndexExtract after "
+                            "inflateIndexParallel\n");
+            exit(1);
+        }
+    }
+    inflateIndexFree(loaded);
+    free(back);
+    free(dst.buf);
+    printf("inflateIndexParallel(): %lu points, %lu byte index for %lu bytes\n",
+           points, dst.len, src.len);
+}
+
+/* ===========================================================================
+ * Test deflateBatch() and inflateBatch() with a few small streams, one with
+ * too little output space and one truncated
+ */
+static void test_batch(Byte *compr, uLong comprLen, Byte *uncompr,
+                       uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    z_batch batch[4];
+    Byte *back = uncompr + uncomprLen / 2;
+    uInt len[3] = {200, 900, 2000}, at = 0;
+    int err, k;
+
+    for (k = 0; k < 3100; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + k / 700);
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    for (k = 0; k < 4; k++) {
+        batch[k].next_in = uncompr + (k < 3 ? at : 0);
+        batch[k].avail_in = len[k < 3 ? k : 2];
+        batch[k].next_out = compr + (uInt)(comprLen / 4) * (uInt)k;
+        batch[k].avail_out = k < 3 ? (uInt)(comprLen / 4) : 10;
+        at += k < 3 ? len[k] : 0;
+    }
+    err = deflateBatch(&c_stream, batch, 4);
+    CHECK_ERR(err, "deflateBatch");
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    for (k = 0; k < 4; k++)
+        if (batch[k].status != (k < 3 ? Z_OK : Z_BUF_ERROR)) {
+            fprintf(stderr, "bad deflateBatch status\n");
+            exit(1);
+        }
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in  = Z_NULL;
+    d_stream.avail_in = 0;
+
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    for (k = 0; k < 3; k++) {
+        batch[k].next_in = compr + (uInt)(comprLen / 4) * (uInt)k;
+        batch[k].avail_in = (uInt)(comprLen / 4) - batch[k].avail_out;
+        batch[k].next_out = back + 2000 * k;
+        batch[k].avail_out = k == 1 ? 500 : 2000;
+    }
+    batch[3] = batch[2];
+    batch[3].avail_in /= 2;
+    batch[3].next_out = back + 6000;
+    err = inflateBatch(&d_stream, batch, 4);
+    CHECK_ERR(err, "inflateBatch");
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (batch[0].status != Z_OK || batch[1].status != Z_BUF_ERROR ||
+        batch[2].status != Z_OK || batch[3].status != Z_DATA_ERROR ||
+        batch[0].avail_out != 2000 - len[0] ||
+        batch[2].avail_out != 2000 - len[2] ||
+        memcmp(back, uncompr, len[0]) ||
+        memcmp(back + 4000, uncompr + len[0] + len[1], len[2])) {
+        fprintf(stderr, "bad inflateBatch\n");
+        exit(1);
+    } else {
+        printf("deflateBatch() and inflateBatch(): 4 streams\n");
+    }
+}
+
+/* ===========================================================================
+ * Test crc32_z_parallel() against crc32_z()
+ */
+static void test_crc32_parallel(void) {
+    z_size_t len = 12582912 + 12345, k;
+    Byte *buf = (Byte*)malloc(len);
+    uLong crc;
+
+    if (buf == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = (Byte)(k ^ (k >> 9) ^ (k >> 17));
+    crc = crc32_z(1, buf, len);
+    if (crc32_z_parallel(1, buf, len, 4) != crc ||
+        crc32_z_parallel(1, buf, len, 1) != crc ||
+        crc32_z_parallel(1, buf, 5000000, 4) != crc32_z(1, buf, 5000000)) {
+        fprintf(stderr, "bad crc32_z_parallel\n");
+        exit(1);
+    } else {
+        printf("crc32_z_parallel(): 0x%08lx\n", crc);
+    }
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test crc32_combine_many() and adler32_combine_many() on segments of buf
+ */
+static void test_combine_many(Byte *buf, uLong len) {
+    static const z_size_t lens[8] = {1000, 3000, 3000, 0, 3000, 37, 3000, 500};
+    uLong crcs[8], adlers[8], crc, adler, at = 0;
+    int k;
+
+    for (k = 0; k < (int)len; k++)
+        buf[k] = (Byte)(k * 7 + (k >> 5));
+    for (k = 0; k < 8; k++) {
+        crcs[k] = crc32_z(0, buf + at, lens[k]);
+        adlers[k] = adler32_z(1, buf + at, lens[k]);
+        at += (uLong)lens[k];
+    }
+    crc = crc32_z(0, buf, at);
+    adler = adler32_z(1, buf, at);
+    if (crc32_combine_many(crcs, lens, 8) != crc ||
+        adler32_combine_many(adlers, lens, 8) != adler ||
+        crc32_combine_many(crcs, lens, 1) != crcs[0] ||
+        crc32_combine_many(crcs, lens, 0) != 0 ||
+        adler32_combine_many(adlers, lens, 0) != 1) {
+        fprintf(stderr, "bad crc32_combine_many or adler32_combine_many\n");
+        exit(1);
+    } else {
+        printf("crc32_combine_many() and adler32_combine_many(): 8 "
+               "segments\n");
+    }
+}
+
+/* ===========================================================================
+ * Test deflateGetStats() on a compression of buf, and after deflateReset(),
+ * and inflateGetStats() on a decompression of the result
+ */
+static void test_stats(Byte *compr, uLong comprLen, Byte *buf, uLong len) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    z_deflate_stats stats;
+    z_inflate_stats istats;
+    uLong k;
+    int err;
+
+    for (k = 0; k < len; k++)
+        buf[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + (k >> 8));
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+
+    c_stream.next_in  = buf;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    comprLen = c_stream.total_out;
+    err = deflateGetStats(&c_stream, &stats);
+    if (err == Z_VERSION_ERROR) {
+        if (stats.searches != 0 || stats.literals != 0) {
+            fprintf(stderr, "deflateGetStats should clear stats\n");
+            exit(1);
+        }
+        printf("deflateGetStats(): not compiled\n");
+    }
+    else {
+        CHECK_ERR(err, "deflateGetStats");
+        if (stats.literals + stats.matches == 0 || stats.searches == 0 ||
+            stats.block_bytes != len ||
+            stats.stored_blocks + stats.static_blocks +
+            stats.dynamic_blocks == 0) {
+            fprintf(stderr, "bad deflateGetStats\n");
+            exit(1);
+        }
+        printf("deflateGetStats(): %lu literals, %lu matches\n",
+               stats.literals, stats.matches);
+        err = deflateReset(&c_stream);
+        CHECK_ERR(err, "deflateReset");
+        err = deflateGetStats(&c_stream, &stats);
+        CHECK_ERR(err, "deflateGetStats");
+        if (stats.searches != 0 || stats.block_bytes != 0) {
+            fprintf(stderr, "deflateReset should clear stats\n");
+            exit(1);
+        }
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)comprLen;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_out = buf;
+    for (;;) {
+        d_stream.avail_out = 1000;  /* force window updates */
+        err = inflate(&d_stream, Z_NO_FLUSH);
+        if (err == Z_STREAM_END) break;
+        CHECK_ERR(err, "inflate");
+    }
+    err = inflateGetStats(&d_stream, &istats);
+    if (err == Z_VERSION_ERROR) {
+        if (istats.fast_bytes != 0 || istats.slow_bytes != 0) {
+            fprintf(stderr, "inflateGetStats should clear stats\n");
+            exit(1);
+        }
+        printf("inflateGetStats(): not compiled\n");
+    }
+    else {
+        CHECK_ERR(err, "inflateGetStats");
+        if (istats.fast_bytes + istats.slow_bytes + istats.stored_bytes !=
+                d_stream.total_out || istats.window_copies == 0 ||
+            istats.stored_blocks + istats.fixed_blocks +
+            istats.dynamic_blocks == 0 ||
+            istats.tables != 3 * istats.dynamic_blocks) {
+            fprintf(stderr, "bad inflateGetStats\n");
+            exit(1);
+        }
+        printf("inflateGetStats(): %lu fast bytes, %lu slow bytes\n",
+               istats.fast_bytes, istats.slow_bytes);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (d_stream.total_out != len) {
+        fprintf(stderr, "bad inflate with stats\n");
+        exit(1);
+    }
+}
+
+/* ===========================================================================
+ * Test zlibAllocCache() with streams that reuse the cached memory
+ */
+static void test_alloc_cache(Byte *compr, uLong comprLen, Byte *uncompr,
+                             uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = (uLong)strlen(hello)+1;
+    int err, k;
+
+    err = zlibAllocCache(1L << 20);
+    if (err == Z_STREAM_ERROR) {
+        printf("zlibAllocCache(): not compiled\n");
+        return;
+    }
+    CHECK_ERR(err, "zlibAllocCache");
+    for (k = 0; k < 3; k++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+        err = deflateInit(&c_stream, k);
+        CHECK_ERR(err, "deflateInit");
+        c_stream.next_in  = (z_const unsigned char *)hello;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)comprLen;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        d_stream.zalloc = zalloc;
+        d_stream.zfree = zfree;
+        d_stream.opaque = (voidpf)0;
+        d_stream.next_in  = compr;
+        d_stream.avail_in = (uInt)c_stream.total_out;
+        err = inflateInit(&d_stream);
+        CHECK_ERR(err, "inflateInit");
+        d_stream.next_out = uncompr;
+        d_stream.avail_out = (uInt)uncomprLen;
+        err = inflate(&d_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "inflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = inflateEnd(&d_stream);
+        CHECK_ERR(err, "inflateEnd");
+        if (strcmp((char*)uncompr, hello)) {
+            fprintf(stderr, "bad inflate with zlibAllocCache\n");
+            exit(1);
+        }
+    }
+    err = zlibAllocCache(0);
+    CHECK_ERR(err, "zlibAllocCache");
+    printf("zlibAllocCache(): %s\n", (char *)uncompr);
+}
+
+/* ===========================================================================
+ * Test that deflateReset() after a short stream gives the same compressed
+ * data as a new stream, with nothing matched from the stream before
+ */
+static void test_reset(Byte *compr, uLong comprLen) {
+    z_stream c_stream; /* compression stream */
+    uLong len = (uLong)strlen(hello)+1;
+    uLong half = comprLen >> 1, first = 0;
+    int err, k;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    for (k = 0; k < 3; k++) {
+        c_stream.next_in  = (z_const unsigned char *)hello;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = k ? compr + half : compr;
+        c_stream.avail_out = (uInt)half;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        if (k == 0)
+            first = c_stream.total_out;
+        else if (c_stream.total_out != first ||
+                 memcmp(compr, compr + half, (size_t)first)) {
+            fprintf(stderr, "bad deflate after deflateReset\n");
+            exit(1);
+        }
+        err = deflateReset(&c_stream);
+        CHECK_ERR(err, "deflateReset");
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    printf("deflateReset(): %lu bytes, same as a new stream\n", first);
+}
+
+/* ===========================================================================
+ * Test deflateSizeParams() with a stream for short messages
+ */
+static void test_size_params(Byte *compr, uLong comprLen, Byte *uncompr,
+                             uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 4000, k;
+    int windowBits = MAX_WBITS, memLevel = 8, err;
+
+    for (k = 0; k < len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + (k >> 8));
+    err = deflateSizeParams(len, &windowBits, &memLevel);
+    CHECK_ERR(err, "deflateSizeParams");
+    if (windowBits != 13 || memLevel != 6) {
+        fprintf(stderr, "bad deflateSizeParams\n");
+        exit(1);
+    }
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                       windowBits, memLevel, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateInit2");
+    c_stream.next_in  = uncompr;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    d_stream.next_out = uncompr + len;
+    d_stream.avail_out = (uInt)(uncomprLen - len);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (d_stream.total_out != len || memcmp(uncompr, uncompr + len, len)) {
+        fprintf(stderr, "bad inflate with deflateSizeParams\n");
+        exit(1);
+    }
+    printf("deflateSizeParams(): windowBits %d, memLevel %d, %lu bytes\n",
+           windowBits, memLevel, c_stream.total_out);
+}
+
+/* ===========================================================================
+ * Test deflateMemUsage() against deflateStateSize(), and inflateMemUsage()
+ * before and after inflate() allocates the window
+ */
+static void test_mem_usage(Byte *compr, uLong comprLen, Byte *uncompr,
+                           uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = (uLong)strlen(hello)+1;
+    uLong used, size, before;
+    int err;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    used = deflateMemUsage(&c_stream);
+    size = deflateStateSize(Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                            Z_DEFAULT_STRATEGY);
+    if (used == 0 || used > size || size - used > 1024) {
+        fprintf(stderr, "bad deflateMemUsage\n");
+        exit(1);
+    }
+    c_stream.next_in  = (z_const unsigned char *)hello;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    before = inflateMemUsage(&d_stream);
+    d_stream.next_out = uncompr;
+    while (d_stream.total_out < uncomprLen) {
+        d_stream.avail_out = 1;     /* force the window to be allocated */
+        err = inflate(&d_stream, Z_NO_FLUSH);
+        if (err == Z_STREAM_END) break;
+        CHECK_ERR(err, "inflate");
+    }
+    size = inflateMemUsage(&d_stream);
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (before == 0 || size != before + (1UL << MAX_WBITS) ||
+        strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad inflateMemUsage\n");
+        exit(1);
+    }
+    printf("deflateMemUsage(): %lu bytes, inflateMemUsage(): %lu bytes\n",
+           used, size);
+}
+
+/* ===========================================================================
+ * Test deflateParams() level switches at block boundaries with no output space,
+ * and deflateOptimize() while a switch to optimal parsing is pending
+ */
+static void test_params_switch(Byte *compr, uLong comprLen, Byte *uncompr,
+                               uLong uncomprLen) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong len = 8000, k;
+    int level[] = {9, 4, 12, 1}, n = 0, err;
+
+    for (k = 0; k < len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + (k >> 6));
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, Z_BEST_SPEED);
+    CHECK_ERR(err, "deflateInit");
+    c_stream.next_in  = uncompr;
+    c_stream.next_out = compr;
+    while (c_stream.total_in != len) {
+        c_stream.avail_in = c_stream.avail_out = 1; /* force small buffers */
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+        if (c_stream.total_in == 1500 * (uLong)(n + 1)) {
+            /* no output space is needed to change the compression level */
+            c_stream.avail_out = 0;
+            err = deflateParams(&c_stream, level[n & 3],
+                                n & 1 ? Z_FILTERED : Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+            n++;
+        }
+    }
+    c_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in  = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    d_stream.next_out = uncompr + len;
+    d_stream.avail_out = (uInt)(uncomprLen - len);
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (d_stream.total_out != len || memcmp(uncompr, uncompr + len, len)) {
+        fprintf(stderr, "bad inflate after deflateParams\n");
+        exit(1);
+    }
+    printf("deflateParams(): %d switches, %lu bytes\n", n, c_stream.total_out);
+
+    /* deflateOptimize() while a switch to optimal parsing is pending */
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    c_stream.next_in  = uncompr;
+    c_stream.avail_in = (uInt)len / 2;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflateParams(&c_stream, 11, Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateParams");
+    err = deflateOptimize(&c_stream, 2, 8192);
+    CHECK_ERR(err, "deflateOptimize");
+    c_stream.avail_in = (uInt)(len - len / 2);
+    err = deflate(&c_stream, Z_BLOCK);          /* make the switch */
+    CHECK_ERR(err, "deflate");
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    k = uncomprLen - len;
+    err = uncompress(uncompr + len, &k, compr, c_stream.total_out);
+    CHECK_ERR(err, "uncompress");
+    if (k != len || memcmp(uncompr, uncompr + len, len)) {
+        fprintf(stderr, "bad inflate after deflateOptimize\n");
+        exit(1);
+    }
+}
+
+/* ===========================================================================
+ * Compress len bytes of buf at level after calling set(strm, value), giving
+ * deflate() at most piece bytes of input and output at a time and ending each
+ * piece of input with flush, and setting the option back to zero once more
+ * than off bytes have been consumed if off is not zero. Check that the result
+ * decompresses to buf, and return the compressed length.
+ */
+typedef int (*option_func)(z_streamp strm, int value);
+
+static uLong option_deflate(const char *name, option_func set, int value,
+                            uLong off, Byte *buf, uLong len, int level,
+                            uInt piece, int flush) {
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    uLong comprLen;
+    Byte *compr, *out;
+    int err, flushed = 1;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, level);
+    CHECK_ERR(err, "deflateInit");
+    err = set(&c_stream, value);
+    CHECK_ERR(err, name);
+    comprLen = deflateBound(&c_stream, len) + (len / piece + 1) * 16;
+    compr = (Byte*)malloc(comprLen);
+    out = (Byte*)malloc(len);
+    if (compr == Z_NULL || out == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    c_stream.next_in = buf;
+    c_stream.avail_in = 0;
+    c_stream.next_out = compr;
+    do {
+        if (c_stream.avail_in == 0 && flushed)
+            c_stream.avail_in = (uInt)(len - c_stream.total_in < piece ?
+                                       len - c_stream.total_in : piece);
+        c_stream.avail_out = (uInt)(comprLen - c_stream.total_out < piece ?
+                                    comprLen - c_stream.total_out : piece);
+        if (off && c_stream.total_in > off) {
+            /* go back to the default part way through */
+            err = set(&c_stream, 0);
+            CHECK_ERR(err, name);
+        }
+        err = deflate(&c_stream, c_stream.total_in + c_stream.avail_in == len ?
+                                 Z_FINISH : flush);
+        if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+            fprintf(stderr, "deflate error %d with %s\n", err, name);
+            exit(1);
+        }
+        flushed = c_stream.avail_out != 0;
+    } while (err != Z_STREAM_END);
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    d_stream.next_in = compr;
+    d_stream.avail_in = (uInt)c_stream.total_out;
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+    d_stream.next_out = out;
+    d_stream.avail_out = (uInt)len;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "inflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (d_stream.total_out != len || memcmp(out, buf, len)) {
+        fprintf(stderr, "bad inflate after %s\n", name);
+        exit(1);
+    }
+    free(out);
+    free(compr);
+    return c_stream.total_out;
+}
+
+static int set_adaptive(z_streamp strm, int value) {
+    return deflateAdaptive(strm, value);
+}
+
+/* ===========================================================================
+ * Test deflateAdaptive() with text around a region of random bytes
+ */
+static void test_adaptive(void) {
+    uLong len = 393216, clen, plain, k, seed = 1;
+    Byte *buf;
+    int level[] = {1, 4, 6, 9, 11}, n;
+
+    buf = (Byte*)malloc(len);
+    if (buf == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = k >= 65536 && k < 327680 ? (Byte)(next_random(&seed) >> 24) :
+                 (Byte)(hello[k % (sizeof(hello) - 1)] + (k % 1000 >> 4));
+
+    for (n = 0; n < 5; n++) {
+        plain = option_deflate("deflateAdaptive", set_adaptive, 0, 0, buf, len,
+                               level[n], (uInt)len, Z_NO_FLUSH);
+        clen = option_deflate("deflateAdaptive", set_adaptive, 1,
+                              (len >> 1) + (len >> 2), buf, len, level[n],
+                              n & 1 ? 1000 : (uInt)len, Z_NO_FLUSH);
+        if (clen > plain + (plain >> 6)) {
+            fprintf(stderr, "deflateAdaptive at level %d: %lu bytes, %lu "
+                    "without\n", level[n], clen, plain);
+            exit(1);
+        }
+    }
+    printf("deflateAdaptive(): %lu bytes, %lu without\n", clen, plain);
+    free(buf);
+}
+
+static int set_split(z_streamp strm, int value) {
+    return deflateSplit(strm, value);
+}
+
+static int set_split_lit_mem(z_streamp strm, int value) {
+    int ret;
+
+    ret = deflateLitMem(strm, 1);
+    return ret == Z_OK ? deflateSplit(strm, value) : ret;
+}
+
+/* ===========================================================================
+ * Test deflateSplit() with text that changes to digits and back every 24K
+ */
+static void test_split(void) {
+    uLong len = 262144, clen, plain, k, seed = 1;
+    Byte *buf;
+    int level[] = {1, 6, 9, 11}, n;
+
+    buf = (Byte*)malloc(len);
+    if (buf == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        buf[k] = k / 24576 & 1 ?
+                 (Byte)("0123456789,\n"[(next_random(&seed) >> 24) % 12]) :
+                 (Byte)(hello[k % (sizeof(hello) - 1)] + (k % 1000 >> 4));
+
+    for (n = 0; n < 4; n++) {
+        plain = option_deflate("deflateSplit", set_split, 0, 0, buf, len,
+                               level[n], (uInt)len, Z_NO_FLUSH);
+        clen = option_deflate("deflateSplit",
+                              n == 2 ? set_split_lit_mem : set_split, 1, 0,
+                              buf, len, level[n], n & 1 ? 1000 : (uInt)len,
+                              Z_NO_FLUSH);
+        if (clen >= plain) {
+            fprintf(stderr, "deflateSplit at level %d: %lu bytes, %lu "
+                    "without\n", level[n], clen, plain);
+            exit(1);
+        }
+    }
+    printf("deflateSplit(): %lu bytes, %lu without\n", clen, plain);
+    free(buf);
+}
+
+static int set_reuse(z_streamp strm, int value) {
+    return deflateReuse(strm, value);
+}
+
+/* ===========================================================================
+ * Test deflateReuse() with small and medium messages of similar records,
+ * each ended with a sync flush
+ */
+static void test_reuse(void) {
+    uLong len = 0, clen = 0, plain = 0, seed = 1;
+    uInt size[] = {200, 3000};
+    Byte *buf;
+    int level[] = {1, 6}, n;
+
+    buf = (Byte*)malloc(300000);
+    if (buf == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    while (len < 262144) {
+        next_random(&seed);
+        len += (uLong)sprintf((char *)buf + len,
+                              "{\"id\":%lu,\"user\":\"u%lu\",\"ok\":%s}\n",
+                              seed >> 16, (seed >> 8) % 977,
+                              seed & 0x100 ? "true" : "false");
+    }
+
+    for (n = 0; n < 4; n++) {
+        plain = option_deflate("deflateReuse", set_reuse, 0, 0, buf, len,
+                               level[n & 1], size[n >> 1], Z_SYNC_FLUSH);
+        clen = option_deflate("deflateReuse", set_reuse, 1, 0, buf, len,
+                              level[n & 1], size[n >> 1], Z_SYNC_FLUSH);
+        if (clen > plain + (plain >> 4)) {
+            fprintf(stderr, "deflateReuse at level %d: %lu bytes, %lu "
+                    "without\n", level[n & 1], clen, plain);
+            exit(1);
+        }
+    }
+    printf("deflateReuse(): %lu bytes, %lu without\n", clen, plain);
+    free(buf);
+}
+
+/* ===========================================================================
+ * Inflate the output pushed to latency_out() as it arrives
+ */
+typedef struct {
+    z_stream strm;          /* decompression stream */
+    Byte *out;              /* decompressed data */
+    uLong size;             /* space at out */
+} latency_sink;
+
+static int latency_out(void FAR *desc, unsigned char FAR *buf, unsigned len) {
+    latency_sink *sink = (latency_sink *)desc;
+    int err;
+
+    sink->strm.next_in = buf;
+    sink->strm.avail_in = len;
+    sink->strm.next_out = sink->out + sink->strm.total_out;
+    sink->strm.avail_out = (uInt)(sink->size - sink->strm.total_out);
+    err = inflate(&sink->strm, Z_SYNC_FLUSH);
+    return (err != Z_OK && err != Z_STREAM_END) || sink->strm.avail_in != 0;
+}
+
+/* ===========================================================================
+ * Test deflateLatency() and deflateOutput() by inflating the output as it is
+ * pushed, checking that each emit can be decompressed when it is made
+ */
+static void test_latency(void) {
+    z_stream c_stream; /* compression stream */
+    latency_sink sink;
+    uLong len = 0, bufLen = 65536, seed = 1, spin;
+    uInt piece;
+    Byte *buf, *out, room[64];
+    int err;
+
+    buf = (Byte*)malloc(bufLen);
+    out = (Byte*)malloc(bufLen);
+    if (buf == Z_NULL || out == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    while (len < 60000) {
+        next_random(&seed);
+        len += (uLong)sprintf((char *)buf + len, "event %lu at %lu\n",
+                              (seed >> 8) % 97, seed >> 12);
+    }
+    sink.strm.zalloc = zalloc;
+    sink.strm.zfree = zfree;
+    sink.strm.opaque = (voidpf)0;
+    sink.strm.next_in = Z_NULL;
+    sink.strm.avail_in = 0;
+    err = inflateInit(&sink.strm);
+    CHECK_ERR(err, "inflateInit");
+    sink.out = out;
+    sink.size = bufLen;
+
+    /* emit after every 1000 bytes, with input in pieces of 777 bytes and a
+       small output space that is pushed whenever it fills */
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    err = deflateLatency(&c_stream, 1000, 0, Z_SYNC_FLUSH);
+    CHECK_ERR(err, "deflateLatency");
+    err = deflateOutput(&c_stream, latency_out, &sink);
+    CHECK_ERR(err, "deflateOutput");
+    c_stream.next_in = buf;
+    do {
+        piece = (uInt)(len - c_stream.total_in < 777 ?
+                       len - c_stream.total_in : 777);
+        c_stream.avail_in = piece;
+        c_stream.next_out = room;
+        c_stream.avail_out = sizeof(room);
+        err = deflate(&c_stream, c_stream.total_in + piece == len ?
+                                 Z_FINISH : Z_NO_FLUSH);
+        if ((err != Z_OK && err != Z_STREAM_END) || c_stream.avail_in ||
+            c_stream.next_out != room || c_stream.avail_out != sizeof(room)) {
+            fprintf(stderr, "deflate error %d with deflateOutput\n", err);
+            exit(1);
+        }
+        if (sink.strm.total_out < c_stream.total_in -
+                                  c_stream.total_in % 1000) {
+            fprintf(stderr, "deflateLatency held %lu of %lu bytes\n",
+                    c_stream.total_in - sink.strm.total_out,
+                    c_stream.total_in);
+            exit(1);
+        }
+    } while (err != Z_STREAM_END);
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    if (sink.strm.total_out != len || memcmp(out, buf, len)) {
+        fprintf(stderr, "bad inflate after deflateLatency\n");
+        exit(1);
+    }
+    printf("deflateLatency(): %lu bytes in %lu bytes of emits\n",
+           len, sink.strm.total_in);
+
+    /* emit after a millisecond, calling deflate with no input until then */
+    err = inflateReset(&sink.strm);
+    CHECK_ERR(err, "inflateReset");
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+    err = deflateLatency(&c_stream, 0, 1000, Z_SYNC_FLUSH);
+    if (err == Z_OK) {
+        err = deflateOutput(&c_stream, latency_out, &sink);
+        CHECK_ERR(err, "deflateOutput");
+        c_stream.next_in = buf;
+        c_stream.avail_in = 100;
+        for (spin = 0; sink.strm.total_out < 100; spin++) {
+            c_stream.next_out = room;
+            c_stream.avail_out = sizeof(room);
+            err = deflate(&c_stream, Z_NO_FLUSH);
+            if ((err != Z_OK && err != Z_BUF_ERROR) || spin == 100000000L) {
+                fprintf(stderr, "deflateLatency timed emit failed\n");
+                exit(1);
+            }
+        }
+        if (memcmp(out, buf, 100)) {
+            fprintf(stderr, "bad inflate after timed deflateLatency\n");
+            exit(1);
+        }
+        c_stream.next_out = room;
+        c_stream.avail_out = sizeof(room);
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+    }
+    else if (err != Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateLatency error %d\n", err);
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    err = inflateEnd(&sink.strm);
+    CHECK_ERR(err, "inflateEnd");
+    free(out);
+    free(buf);
+}
+
+/* ===========================================================================
+ * Compress len bytes of buf with windowBits wbits, appending to compr at *at
+ */
+static void back_deflate(Byte *buf, uLong len, int wbits, Byte *compr,
+                         uLong comprLen, uLong *at) {
+    z_stream c_stream; /* compression stream */
+    int err;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, wbits, 8,
+                       Z_DEFAULT_STRATEGY);
+    CHECK_ERR(err, "deflateInit2");
+    c_stream.next_in = buf;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr + *at;
+    c_stream.avail_out = (uInt)(comprLen - *at);
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    *at += c_stream.total_out;
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+}
+
+/* ===========================================================================
+ * Test inflateBack() with gzip and zlib wrappers, on a two-member gzip stream
+ * and a zlib stream, and with a bad check value
+ */
+static void test_inflate_back(Byte *compr, uLong comprLen, Byte *uncompr,
+                              uLong uncomprLen) {
+    z_stream d_stream; /* decompression stream */
+    index_io in, out;
+    Byte *window, *back;
+    uLong len = 20000, part = 5000, first, gz, k;
+    int err;
+
+    if (uncomprLen < len) {
+        fprintf(stderr, "inflateBack test needs more space\n");
+        exit(1);
+    }
+    for (k = 0; k < len; k++)
+        uncompr[k] = (Byte)(hello[k % (sizeof(hello) - 1)] + (k >> 7));
+    gz = 0;
+    back_deflate(uncompr, len, 15 + 16, compr, comprLen, &gz);
+    first = gz;
+    back_deflate(uncompr, part, 15 + 16, compr, comprLen, &gz);
+    k = gz;
+    back_deflate(uncompr, len, 15, compr, comprLen, &k);
+
+    window = (Byte *)malloc(32768);
+    back = (Byte *)malloc(len + part);
+    if (window == Z_NULL || back == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    err = inflateBackInit(&d_stream, 15 + 16, window);
+    CHECK_ERR(err, "inflateBackInit");
+
+    /* decode both gzip members, the second from what the first left over */
+    in.buf = compr;
+    in.len = gz;
+    in.pos = 0;
+    out.buf = back;
+    out.len = len + part;
+    out.pos = 0;
+    d_stream.next_in = Z_NULL;
+    err = inflateBack(&d_stream, index_in, &in, index_out, &out);
+    if (err != Z_STREAM_END || out.pos != len ||
+        d_stream.adler != crc32(0L, uncompr, (uInt)len)) {
+        fprintf(stderr, "inflateBack gzip error: %d\n", err);
+        exit(1);
+    }
+    err = inflateBack(&d_stream, index_in, &in, index_out, &out);
+    if (err != Z_STREAM_END || out.pos != len + part ||
+        memcmp(back, uncompr, (size_t)len) ||
+        memcmp(back + len, uncompr, (size_t)part) ||
+        d_stream.avail_in != 0 || in.pos != gz) {
+        fprintf(stderr, "inflateBack second gzip member error: %d\n", err);
+        exit(1);
+    }
+
+    /* a bad CRC-32 in the first trailer is caught */
+    compr[first - 8] ^= 1;
+    in.pos = 0;
+    out.pos = 0;
+    d_stream.next_in = Z_NULL;
+    err = inflateBack(&d_stream, index_in, &in, index_out, &out);
+    compr[first - 8] ^= 1;
+    if (err != Z_DATA_ERROR || strcmp(d_stream.msg, "incorrect data check")) {
+        fprintf(stderr, "inflateBack should report a bad check\n");
+        exit(1);
+    }
+    err = inflateBackEnd(&d_stream);
+    CHECK_ERR(err, "inflateBackEnd");
+
+    /* detect and decode the zlib stream */
+    err = inflateBackInit(&d_stream, 15 + 32, window);
+    CHECK_ERR(err, "inflateBackInit");
+    in.buf = compr + gz;
+    in.len = k - gz;
+    in.pos = 0;
+    out.pos = 0;
+    d_stream.next_in = Z_NULL;
+    err = inflateBack(&d_stream, index_in, &in, index_out, &out);
+    if (err != Z_STREAM_END || out.pos != len || memcmp(back, uncompr, len) ||
+        d_stream.adler != adler32(1L, uncompr, (uInt)len)) {
+        fprintf(stderr, "inflateBack zlib error: %d\n", err);
+        exit(1);
+    }
+    err = inflateBackEnd(&d_stream);
+    CHECK_ERR(err, "inflateBackEnd");
+    free(back);
+    free(window);
+    printf("inflateBack(): gzip and zlib wrappers, %lu and %lu bytes\n", gz,
+           k - gz);
+}
+
 /* ===========================================================================
  * Usage:  example [output.gz  [input.gz]]
  */
@@ -511,6 +3078,7 @@ int main(int argc, char *argv[]) {
 
     printf("zlib version %s = 0x%04x, compile flags = 0x%lx\n",
             ZLIB_VERSION, ZLIB_VERNUM, zlibCompileFlags());
+    printf("kernels: %s\n", zlibKernels());
 
     compr    = (Byte*)calloc((uInt)comprLen, 1);
     uncompr  = (Byte*)calloc((uInt)uncomprLen, 1);
@@ -537,6 +3105,8 @@ int main(int argc, char *argv[]) {
 
     test_large_deflate(compr, comprLen, uncompr, uncomprLen);
     test_large_inflate(compr, comprLen, uncompr, uncomprLen);
+    test_direct();
+    test_lit_mem();
 
     test_flush(compr, &comprLen);
     test_sync(compr, comprLen, uncompr, uncomprLen);
@@ -544,6 +3114,32 @@ int main(int argc, char *argv[]) {
 
     test_dict_deflate(compr, comprLen);
     test_dict_inflate(compr, comprLen, uncompr, uncomprLen);
+    test_dict_prepared();
+
+    test_prime(compr, comprLen, uncompr, uncomprLen);
+    test_hash(compr, comprLen, uncompr, uncomprLen);
+    test_quick(compr, comprLen, uncompr, uncomprLen);
+    test_parallel(compr, comprLen, uncompr, uncomprLen);
+    test_mem(compr, comprLen, uncompr, uncomprLen);
+    test_optimal(compr, comprLen, uncompr, uncomprLen);
+    test_checkpoint(compr, comprLen, uncompr, uncomprLen);
+    test_inflate_parallel(compr, comprLen, uncompr, uncomprLen);
+    test_inflate_index(compr, comprLen, uncompr, uncomprLen);
+    test_index_extract(compr, comprLen, uncompr, uncomprLen);
+    test_batch(compr, comprLen, uncompr, uncomprLen);
+    test_crc32_parallel();
+    test_combine_many(uncompr, uncomprLen);
+    test_stats(compr, comprLen, uncompr, uncomprLen);
+    test_alloc_cache(compr, comprLen, uncompr, uncomprLen);
+    test_reset(compr, comprLen);
+    test_size_params(compr, comprLen, uncompr, uncomprLen);
+    test_mem_usage(compr, comprLen, uncompr, uncomprLen);
+    test_params_switch(compr, comprLen, uncompr, uncomprLen);
+    test_adaptive();
+    test_split();
+    test_reuse();
+    test_latency();
+    test_inflate_back(compr, comprLen, uncompr, uncomprLen);
 
     free(compr);
     free(uncompr);
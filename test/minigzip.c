@@ -28,10 +28,12 @@
 
 #include "zlib.h"
 #include <stdio.h>
+#include <time.h>
 
 #ifdef STDC
 #  include <string.h>
 #  include <stdlib.h>
+#  include <limits.h>
 #endif
 
 #ifdef USE_MMAP
@@ -316,9 +318,17 @@ static const char *gzerror(gzFile gz, int *err) {
     return gz->msg;
 }
 
+static int gzsetthreads(gzFile gz, int threads) {
+    (void)gz;
+    (void)threads;
+    return 0;
+}
+
 #endif
 
 static char *prog;
+static int threads = 1;         /* number of threads for compressing */
+static const char *inmode = "rb";     /* gzopen() mode for decompressing */
 
 /* ===========================================================================
  * Display error message and exit
@@ -371,6 +381,8 @@ static void gz_compress(FILE *in, gzFile out) {
     int len;
     int err;
 
+    if (threads > 1 && gzsetthreads(out, threads))
+        error("can't compress with threads");
 #ifdef USE_MMAP
     /* Try first compressing with mmap. If mmap fails (minigzip used in a
      * pipe), use the normal fread loop.
@@ -473,7 +485,7 @@ static void file_uncompress(char *file) {
         infile = buf;
         string_copy(buf + len, GZ_SUFFIX, sizeof(buf) - len);
     }
-    in = gzopen(infile, "rb");
+    in = gzopen(infile, inmode);
     if (in == NULL) {
         fprintf(stderr, "%s: can't gzopen %s\n", prog, infile);
         exit(1);
@@ -491,18 +503,228 @@ static void file_uncompress(char *file) {
 
 
 /* ===========================================================================
- * Usage:  minigzip [-c] [-d] [-f] [-h] [-r] [-1 to -9] [files...]
+ * Benchmark mode. Each measurement is repeated until it has taken at least
+ * BENCH_TIME seconds, and the speed is reported in MB/s of uncompressed data.
+ */
+#define BENCH_TIME 0.5
+
+/* Return the elapsed time in seconds from some fixed point. */
+static double now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Read all of in into an allocated buffer, returning its length in *len. */
+static unsigned char *bench_load(FILE *in, z_size_t *len) {
+    unsigned char *buf = NULL, *more;
+    z_size_t size = 0, got;
+
+    *len = 0;
+    do {
+        if (*len == size) {
+            size = size ? size << 1 : 1048576;
+            more = realloc(buf, size);
+            if (more == NULL) error("out of memory");
+            buf = more;
+        }
+        got = fread(buf + *len, 1, size - *len, in);
+        *len += got;
+    } while (got);
+    if (ferror(in)) {
+        perror("fread");
+        exit(1);
+    }
+    return buf;
+}
+
+/* Compress in[0..len-1] to gzip at level with strategy into *out, which is
+   allocated or grown as needed to *size bytes. Use deflateParallel() if
+   threads is more than one. Return the compressed length. */
+static z_size_t bench_deflate(const unsigned char *in, z_size_t len,
+                              int level, int strategy,
+                              unsigned char **out, z_size_t *size) {
+    z_stream strm;
+    unsigned char *more;
+    z_size_t left = len;
+    int ret;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = threads > 1 ?
+        deflateParallelInit2(&strm, level, 15 + 16, 8, strategy, threads, 0) :
+        deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, strategy);
+    if (ret != Z_OK) error("deflate init failed");
+    if (*out == NULL) {
+        *size = deflateBound(Z_NULL, (uLong)len) + 65536;
+        *out = malloc(*size);
+        if (*out == NULL) error("out of memory");
+    }
+    strm.next_in = (z_const Bytef *)in;
+    strm.avail_in = 0;
+    strm.next_out = *out;
+    strm.avail_out = 0;
+    do {
+        if (strm.avail_out == 0) {
+            z_size_t have = (z_size_t)(strm.next_out - *out);
+            if (have == *size) {
+                more = realloc(*out, *size << 1);
+                if (more == NULL) error("out of memory");
+                *out = more;
+                *size <<= 1;
+            }
+            strm.next_out = *out + have;
+            strm.avail_out = *size - have > UINT_MAX ? UINT_MAX :
+                             (uInt)(*size - have);
+        }
+        if (strm.avail_in == 0) {
+            strm.avail_in = left > UINT_MAX ? UINT_MAX : (uInt)left;
+            left -= strm.avail_in;
+        }
+        ret = threads > 1 ?
+            deflateParallel(&strm, left ? Z_NO_FLUSH : Z_FINISH) :
+            deflate(&strm, left ? Z_NO_FLUSH : Z_FINISH);
+    } while (ret == Z_OK || ret == Z_BUF_ERROR);
+    if (ret != Z_STREAM_END) error("deflate failed");
+    threads > 1 ? deflateParallelEnd(&strm) : deflateEnd(&strm);
+    return (z_size_t)(strm.next_out - *out);
+}
+
+/* Decompress the gzip stream in[0..len-1] to out[0..size-1], and check that
+   it is all of out. */
+static void bench_inflate(const unsigned char *in, z_size_t len,
+                          unsigned char *out, z_size_t size) {
+    z_stream strm;
+    int ret;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) error("inflate init failed");
+    strm.next_in = (z_const Bytef *)in;
+    strm.next_out = out;
+    strm.avail_out = 0;
+    do {
+        if (strm.avail_in == 0) {
+            strm.avail_in = len > UINT_MAX ? UINT_MAX : (uInt)len;
+            len -= strm.avail_in;
+        }
+        if (strm.avail_out == 0) {
+            strm.avail_out = size > UINT_MAX ? UINT_MAX : (uInt)size;
+            size -= strm.avail_out;
+        }
+        ret = inflate(&strm, Z_NO_FLUSH);
+    } while (ret == Z_OK);
+    if (ret != Z_STREAM_END || size || strm.avail_out)
+        error("inflate failed");
+    inflateEnd(&strm);
+}
+
+/* Report the compressed size and the compression and decompression speeds
+   for the data in name at each level from first to last. */
+static void bench_compress(const char *name, FILE *in, int first, int last,
+                           int strategy) {
+    unsigned char *data, *comp = NULL, *copy;
+    z_size_t len, clen = 0, size = 0;
+    double start, comp_time, decomp_time;
+    long reps;
+    int level;
+
+    data = bench_load(in, &len);
+    if (in != stdin)
+        fclose(in);
+    copy = malloc(len ? len : 1);
+    if (copy == NULL) error("out of memory");
+    printf("%s: %lu bytes", name, (unsigned long)len);
+    if (threads > 1)
+        printf(", compressing with %d threads", threads);
+    printf("\nlevel   ratio  compress MB/s  decompress MB/s\n");
+    for (level = first; level <= last; level++) {
+        reps = 0;
+        start = now();
+        do {
+            clen = bench_deflate(data, len, level, strategy, &comp, &size);
+            reps++;
+        } while ((comp_time = now() - start) < BENCH_TIME);
+        comp_time /= reps;
+        reps = 0;
+        start = now();
+        do {
+            bench_inflate(comp, clen, copy, len);
+            reps++;
+        } while ((decomp_time = now() - start) < BENCH_TIME);
+        decomp_time /= reps;
+        if (memcmp(copy, data, len)) error("decompressed data differs");
+        printf("%5d  %5.1f%%  %13.1f  %15.1f\n", level,
+               len ? 100. * clen / len : 0., len / comp_time * 1e-6,
+               len / decomp_time * 1e-6);
+    }
+    free(copy);
+    free(comp);
+    free(data);
+}
+
+/* Report the speed of decompressing the gzip file name with gzread(), which
+   is read with inmode, so memory mapped with -m. */
+static void bench_uncompress(char *name) {
+    local char buf[BUFLEN];
+    gzFile in;
+    z_size_t total;
+    double start, elapsed;
+    long reps = 0;
+    int len, err;
+
+    start = now();
+    do {
+        in = gzopen(name, inmode);
+        if (in == NULL) {
+            fprintf(stderr, "%s: can't gzopen %s\n", prog, name);
+            exit(1);
+        }
+        total = 0;
+        while ((len = gzread(in, buf, sizeof(buf))) > 0)
+            total += (z_size_t)len;
+        if (len < 0) error(gzerror(in, &err));
+        if (gzclose(in) != Z_OK) error("failed gzclose");
+        reps++;
+    } while ((elapsed = now() - start) < BENCH_TIME);
+    elapsed /= reps;
+    printf("%s: %lu bytes, gzread%s %.1f MB/s\n", name, (unsigned long)total,
+           strchr(inmode, 'm') != NULL ? " with mmap" : "",
+           total / elapsed * 1e-6);
+}
+
+
+/* ===========================================================================
+ * Usage:  minigzip [-b] [-c] [-d] [-f] [-h] [-m] [-p n] [-r] [-1 to -9]
+ *                 [files...]
+ *   -b : benchmark, reporting the compressed size and the compression and
+ *        decompression speeds for each level, or with -d the speed of
+ *        decompressing the gzip files with gzread()
  *   -c : write to standard output
  *   -d : decompress
  *   -f : compress with Z_FILTERED
  *   -h : compress with Z_HUFFMAN_ONLY
+ *   -m : memory map the files to decompress, to read them with no copy
+ *   -p n : compress using n threads, with gzsetthreads() or deflateParallel()
  *   -r : compress with Z_RLE
- *   -1 to -9 : compression level
+ *   -1 to -9 : compression level (for -b, only that level)
  */
 
 int main(int argc, char *argv[]) {
     int copyout = 0;
     int uncompr = 0;
+    int bench = 0;
+    int levelset = 0;
+    int strategy, first, last;
     gzFile file;
     char *bname, outmode[5];
 
@@ -521,7 +743,9 @@ int main(int argc, char *argv[]) {
       copyout = uncompr = 1;
 
     while (argc > 0) {
-      if (strcmp(*argv, "-c") == 0)
+      if (strcmp(*argv, "-b") == 0)
+        bench = 1;
+      else if (strcmp(*argv, "-c") == 0)
         copyout = 1;
       else if (strcmp(*argv, "-d") == 0)
         uncompr = 1;
@@ -529,22 +753,59 @@ int main(int argc, char *argv[]) {
         outmode[3] = 'f';
       else if (strcmp(*argv, "-h") == 0)
         outmode[3] = 'h';
+      else if (strcmp(*argv, "-m") == 0)
+        inmode = "rbm";
+      else if (strcmp(*argv, "-p") == 0 && argc > 1) {
+        argc--, argv++;
+        threads = atoi(*argv);
+        if (threads < 1)
+          error("-p needs a number of threads of at least one");
+      }
       else if (strcmp(*argv, "-r") == 0)
         outmode[3] = 'R';
       else if ((*argv)[0] == '-' && (*argv)[1] >= '1' && (*argv)[1] <= '9' &&
-               (*argv)[2] == 0)
+               (*argv)[2] == 0) {
         outmode[2] = (*argv)[1];
+        levelset = 1;
+      }
       else
         break;
       argc--, argv++;
     }
+    if (bench) {
+        strategy = outmode[3] == 'f' ? Z_FILTERED :
+                   outmode[3] == 'h' ? Z_HUFFMAN_ONLY :
+                   outmode[3] == 'R' ? Z_RLE : Z_DEFAULT_STRATEGY;
+        first = levelset ? outmode[2] - '0' : 1;
+        last = levelset ? outmode[2] - '0' : 9;
+        if (argc == 0) {
+            if (uncompr) error("-b -d needs file names");
+            SET_BINARY_MODE(stdin);
+            bench_compress("stdin", stdin, first, last, strategy);
+        }
+        for (; argc > 0; argc--, argv++) {
+            FILE *in;
+
+            if (uncompr) {
+                bench_uncompress(*argv);
+                continue;
+            }
+            in = fopen(*argv, "rb");
+            if (in == NULL) {
+                perror(*argv);
+                exit(1);
+            }
+            bench_compress(*argv, in, first, last, strategy);
+        }
+        return 0;
+    }
     if (outmode[3] == ' ')
         outmode[3] = 0;
     if (argc == 0) {
         SET_BINARY_MODE(stdin);
         SET_BINARY_MODE(stdout);
         if (uncompr) {
-            file = gzdopen(fileno(stdin), "rb");
+            file = gzdopen(fileno(stdin), inmode);
             if (file == NULL) error("can't gzdopen stdin");
             gz_uncompress(file, stdout);
         } else {
@@ -559,7 +820,7 @@ int main(int argc, char *argv[]) {
         do {
             if (uncompr) {
                 if (copyout) {
-                    file = gzopen(*argv, "rb");
+                    file = gzopen(*argv, inmode);
                     if (file == NULL)
                         fprintf(stderr, "%s: can't gzopen %s\n", prog, *argv);
                     else
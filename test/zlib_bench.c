@@ -0,0 +1,1002 @@
+/* zlib_bench.c -- measure the speed of zlib compression options
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ * zlib_bench compares the hash functions that deflate can use to find
+ * candidate matching strings. For each corpus it reports the average number of
+ * hash chain steps per position that a chain walk limited to 128 steps (as for
+ * level 6) would make, how many of those steps reach strings whose first three
+ * bytes do not match the current string, and the compression speed and ratio
+ * with each hash, including for level 1 with the Z_QUICK strategy.
+ *
+ * For each corpus it also reports the compression and decompression speeds and
+ * the compressed size for every level and strategy, and the latency of
+ * compressing and decompressing small messages, as the 50th, 90th, 99th, and
+ * 99.9th percentiles over many messages.
+ *
+ * It also measures the cost of sliding the hash tables, which deflate does
+ * every time it moves the window down. Zeros are compressed at level 1, where
+ * long matches skip the string insertions, so the time per window's worth of
+ * input is largely the slide and the copying of the window.
+ *
+ * Last it measures the speed of the Adler-32 and CRC-32 check values, which
+ * use vector instructions chosen at run time, over buffers of several sizes.
+ *
+ * Usage: zlib_bench [-j] [file ...]
+ *        zlib_bench -b baseline [-t percent | -s]
+ *        zlib_bench -u baseline
+ *
+ * If no files are given, built-in synthetic JSON, CSV, and text corpora are
+ * used. -j writes the results as JSON to stdout instead of as text, with one
+ * object per measurement, for tracking performance across versions.
+ *
+ * -b runs the regression check: text, JSON, binary, and incompressible
+ * corpora, and the JSON corpus as small messages, are compressed at every
+ * level and decompressed. The speeds, the compressed sizes, and the peak
+ * memory allocated by deflate and inflate, counted by their zalloc, are
+ * compared with the baseline file. The exit status is 1 if a speed is more
+ * than percent (default 30) below its baseline, if a compressed size is more
+ * than 0.1% above its baseline, or if a peak memory is more than 1% above its
+ * baseline. -s leaves out the speeds, for builds that are not optimized. -u
+ * writes a new baseline. Speeds are kept relative to a simple string matcher
+ * in this file that is timed on the same machine, so that a baseline carries
+ * over to other machines, though not exactly.
+ */
+
+#if defined(_WIN32) && !defined(_CRT_SECURE_NO_WARNINGS)
+#  define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "zlib.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CORPUS_SIZE 1048576     /* size of each synthetic corpus */
+#define HASH_BITS 15            /* hash table size for the default memLevel */
+#define WSIZE 32768             /* window size for the default windowBits */
+#define MAX_CHAIN 128           /* maximum chain walk for level 6 */
+#define MESSAGES 2000           /* number of small messages timed */
+#define CHECK_SIZE 131072       /* size of each regression check corpus */
+#define CHECK_MESSAGE 256       /* size of each message in the check */
+#define CHECK_LEVELS 13         /* levels 0..12 in the check */
+
+static void bail(const char *msg, const char *what) {
+    fprintf(stderr, "zlib_bench: %s%s\n", msg, what);
+    exit(1);
+}
+
+/* Results are written as text, or as JSON if json is true. In JSON, each
+   measurement is one object in the results array, started by record(), given
+   its members by the add_*() functions, and closed by the next record() or
+   by the end of the output. */
+static int json = 0;                /* true to write JSON */
+static int records = 0;             /* number of JSON objects written */
+static const char *corpus = "";     /* name of the corpus being measured */
+
+/* Write str as a JSON string. */
+static void put_string(const char *str) {
+    putchar('"');
+    for (; *str; str++)
+        if (*str == '"' || *str == '\\')
+            printf("\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            printf("\\u%04x", (unsigned char)*str);
+        else
+            putchar(*str);
+    putchar('"');
+}
+
+static void add_string(const char *key, const char *val) {
+    if (json) {
+        printf(", \"%s\": ", key);
+        put_string(val);
+    }
+}
+
+static void add_number(const char *key, double val) {
+    if (json)
+        printf(", \"%s\": %.6g", key, val);
+}
+
+/* Start a JSON object for a measurement of the given kind. */
+static void record(const char *test) {
+    if (json) {
+        printf("%s\n    {\"test\": \"%s\"", records ? "}," : "", test);
+        records++;
+        if (*corpus)
+            add_string("corpus", corpus);
+    }
+}
+
+/* Return the elapsed time in seconds from some fixed point, with as fine a
+   resolution as is available. */
+static double now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+#elif defined(TIME_UTC)
+    struct timespec t;
+
+    timespec_get(&t, TIME_UTC);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Deterministic pseudo-random numbers, so that corpora are reproducible. */
+static unsigned long rand_state = 1;
+static unsigned next_rand(void) {
+    rand_state = rand_state * 1103515245UL + 12345;
+    return (unsigned)((rand_state >> 16) & 0x7fff);
+}
+
+/* Append the string str to buf at *have, without exceeding size. */
+static void append(unsigned char *buf, size_t size, size_t *have,
+                   const char *str) {
+    size_t len = strlen(str);
+    if (len > size - *have)
+        len = size - *have;
+    memcpy(buf + *have, str, len);
+    *have += len;
+}
+
+static const char *words[] = {
+    "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was",
+    "with", "be", "by", "on", "not", "he", "this", "are", "or", "his",
+    "from", "at", "which", "but", "have", "an", "had", "they", "you",
+    "compression", "window", "stream", "deflate", "matching", "string"
+};
+#define NWORDS (sizeof(words) / sizeof(words[0]))
+
+/* Generate a corpus of the given kind in buf[0..size-1]. */
+static void make_corpus(const char *kind, unsigned char *buf, size_t size) {
+    char line[256];
+    size_t have = 0;
+    unsigned long n = 0;
+
+    rand_state = 1;
+    while (have < size) {
+        if (strcmp(kind, "json") == 0)
+            sprintf(line, "{\"id\":%lu,\"user\":\"user%u\",\"score\":%u.%02u,"
+                    "\"tags\":[\"%s\",\"%s\"],\"ok\":%s}\n", n,
+                    next_rand() % 500, next_rand() % 100, next_rand() % 100,
+                    words[next_rand() % NWORDS], words[next_rand() % NWORDS],
+                    next_rand() & 1 ? "true" : "false");
+        else if (strcmp(kind, "csv") == 0)
+            sprintf(line, "%lu,%u,%s,%u.%03u,2024-%02u-%02u\n", n,
+                    next_rand() % 10000, words[next_rand() % NWORDS],
+                    next_rand() % 1000, next_rand() % 1000,
+                    next_rand() % 12 + 1, next_rand() % 28 + 1);
+        else {
+            sprintf(line, "%s ", words[next_rand() % NWORDS]);
+            if (next_rand() % 12 == 0)
+                strcat(line, "\n");
+        }
+        append(buf, size, &have, line);
+        n++;
+    }
+}
+
+/* Generate binary records, or random bytes if random is true, in
+   buf[0..size-1]. Each record is sixteen bytes of little-endian counters and
+   readings, as from a log of measurements. */
+static void make_binary(unsigned char *buf, size_t size, int random) {
+    unsigned long n, val[4];
+    size_t i;
+    int k;
+
+    rand_state = 1;
+    if (random) {
+        for (i = 0; i < size; i++)
+            buf[i] = (unsigned char)(next_rand() >> 7);
+        return;
+    }
+    memset(buf, 0, size);
+    for (n = 0, i = 0; i + 16 <= size; n++, i += 16) {
+        val[0] = n;
+        val[1] = n * 3 + next_rand() % 4;
+        val[2] = next_rand() % 1000;
+        val[3] = next_rand() & 0xff0f;
+        for (k = 0; k < 16; k++)
+            buf[i + k] = (unsigned char)(val[k >> 2] >> ((k & 3) << 3));
+    }
+}
+
+/* Read the contents of the file at path, and return its size in *size. */
+static unsigned char *load(const char *path, size_t *size) {
+    FILE *in;
+    unsigned char *buf;
+    long len;
+
+    in = fopen(path, "rb");
+    if (in == NULL || fseek(in, 0, SEEK_END) || (len = ftell(in)) < 0)
+        bail("cannot read ", path);
+    rewind(in);
+    buf = malloc(len ? (size_t)len : 1);
+    if (buf == NULL)
+        bail("out of memory", "");
+    if (fread(buf, 1, (size_t)len, in) != (size_t)len)
+        bail("cannot read ", path);
+    fclose(in);
+    *size = (size_t)len;
+    return buf;
+}
+
+/* CRC-32C of the four bytes at p with no conditioning, as deflate uses. */
+static unsigned long crc32c_table[256];
+static unsigned long crc32c4(const unsigned char *p) {
+    unsigned long crc = 0;
+    int k;
+
+    if (crc32c_table[1] == 0) {
+        unsigned long c;
+        int n, j;
+        for (n = 0; n < 256; n++) {
+            c = (unsigned long)n;
+            for (j = 0; j < 8; j++)
+                c = c & 1 ? (c >> 1) ^ 0x82f63b78UL : c >> 1;
+            crc32c_table[n] = c;
+        }
+    }
+    for (k = 0; k < 4; k++)
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ p[k]) & 0xff];
+    return crc;
+}
+
+/* Model the hash chains deflate builds with the given hash, and report the
+   average chain walk per position, and the fraction of those steps that land
+   on strings that cannot match. */
+static void chain_walk(const unsigned char *buf, size_t len, int hash) {
+    unsigned mask = (1U << HASH_BITS) - 1, shift = (HASH_BITS + 2) / 3;
+    unsigned h = 0;
+    long *head, *prev;
+    size_t i;
+    double steps = 0, misses = 0;
+
+    head = malloc(sizeof(long) << HASH_BITS);
+    prev = malloc(sizeof(long) * WSIZE);
+    if (head == NULL || prev == NULL)
+        bail("out of memory", "");
+    for (i = 0; i <= mask; i++)
+        head[i] = -1;
+    if (len >= 2)
+        h = ((buf[0] << shift) ^ buf[1]) & mask;
+    for (i = 0; i + 4 <= len; i++) {
+        long cand;
+        int chain = MAX_CHAIN;
+
+        if (hash == Z_HASH_ROLLING)
+            h = ((h << shift) ^ buf[i + 2]) & mask;
+        else
+            h = (unsigned)crc32c4(buf + i) & mask;
+        for (cand = head[h]; cand >= 0 && i - (size_t)cand < WSIZE && chain;
+             cand = prev[cand & (WSIZE - 1)], chain--) {
+            steps++;
+            if (memcmp(buf + cand, buf + i, 3))
+                misses++;
+        }
+        prev[i & (WSIZE - 1)] = head[h];
+        head[h] = (long)i;
+    }
+    free(prev);
+    free(head);
+    record("chain");
+    add_string("hash", hash == Z_HASH_ROLLING ? "rolling" : "crc32c");
+    add_number("steps_per_pos", len ? steps / len : 0.0);
+    add_number("false_pct", steps ? 100 * misses / steps : 0.0);
+    if (!json)
+        printf("  %s: %.2f steps/pos, %.1f%% false candidates\n",
+               hash == Z_HASH_ROLLING ? "rolling" : "crc32c",
+               len ? steps / len : 0.0, steps ? 100 * misses / steps : 0.0);
+}
+
+/* Names of the strategies, indexed by strategy. */
+static const char *strategies[] = {
+    "default", "filtered", "huffman", "rle", "fixed", "quick"
+};
+
+/* Return the speed in MB/s of processing len bytes reps times in total
+   clock ticks. */
+static double mbps(size_t len, int reps, clock_t total) {
+    return total ? (double)len * reps / 1e6 / ((double)total / CLOCKS_PER_SEC)
+                 : 0.0;
+}
+
+/* Compress buf[0..len-1] at level with the given strategy and hash, and then
+   decompress the result, and print the speeds and the compressed size. */
+static void time_compress(const unsigned char *buf, size_t len, int level,
+                          int strategy, int hash) {
+    z_stream strm;
+    unsigned char *out, *back;
+    uLong bound, size = 0;
+    clock_t start, total = 0, total_inf = 0;
+    int rep, reps = 0, reps_inf = 0;
+
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, level, Z_DEFLATED, 15, 8, strategy) != Z_OK)
+        bail("deflateInit2 failed", "");
+    bound = deflateBound(&strm, (uLong)len);
+    out = malloc(bound);
+    back = malloc(len ? len : 1);
+    if (out == NULL || back == NULL)
+        bail("out of memory", "");
+    for (rep = 0; rep < 3 || total < CLOCKS_PER_SEC / 4; rep++) {
+        deflateReset(&strm);
+        if (deflateHash(&strm, hash) != Z_OK)
+            bail("deflateHash failed", "");
+        strm.next_in = (z_const Bytef *)buf;
+        strm.avail_in = (uInt)len;
+        strm.next_out = out;
+        strm.avail_out = (uInt)bound;
+        start = clock();
+        if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+            bail("deflate failed", "");
+        total += clock() - start;
+        size = strm.total_out;
+        reps++;
+    }
+    deflateEnd(&strm);
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 15) != Z_OK)
+        bail("inflateInit2 failed", "");
+    for (rep = 0; rep < 3 || total_inf < CLOCKS_PER_SEC / 4; rep++) {
+        inflateReset(&strm);
+        strm.next_in = out;
+        strm.avail_in = (uInt)size;
+        strm.next_out = back;
+        strm.avail_out = (uInt)len;
+        start = clock();
+        if (inflate(&strm, Z_FINISH) != Z_STREAM_END)
+            bail("inflate failed", "");
+        total_inf += clock() - start;
+        reps_inf++;
+    }
+    inflateEnd(&strm);
+    if (memcmp(back, buf, len))
+        bail("round trip failed", "");
+    free(back);
+    free(out);
+
+    record("compress");
+    add_string("strategy", strategies[strategy]);
+    add_number("level", level);
+    add_string("hash", hash == Z_HASH_ROLLING ? "rolling" : "crc32c");
+    add_number("bytes", (double)len);
+    add_number("compressed", (double)size);
+    add_number("ratio", size ? (double)len / size : 0.0);
+    add_number("deflate_MBps", mbps(len, reps, total));
+    add_number("inflate_MBps", mbps(len, reps_inf, total_inf));
+    if (!json)
+        printf("    %-8s %d: %7.1f MB/s, %7.1f MB/s inflate, %6.2f%%\n",
+               strategies[strategy], level, mbps(len, reps, total),
+               mbps(len, reps_inf, total_inf),
+               len ? 100.0 * size / len : 0.0);
+}
+
+/* Compress len zeros at level 1 with the given memLevel and windowBits, and
+   print the time per window slide. */
+static void time_slide(size_t len, int memLevel, int windowBits) {
+    z_stream strm;
+    unsigned char *in, *out;
+    uLong bound;
+    clock_t start, total = 0;
+    int rep, reps = 0;
+    double slides;
+
+    in = calloc(len, 1);
+    memset(&strm, 0, sizeof(strm));
+    if (in == NULL || deflateInit2(&strm, 1, Z_DEFLATED, windowBits, memLevel,
+                                   Z_DEFAULT_STRATEGY) != Z_OK)
+        bail("deflateInit2 failed", "");
+    bound = deflateBound(&strm, (uLong)len);
+    out = malloc(bound);
+    if (out == NULL)
+        bail("out of memory", "");
+    for (rep = 0; rep < 3 || total < CLOCKS_PER_SEC / 4; rep++) {
+        deflateReset(&strm);
+        strm.next_in = in;
+        strm.avail_in = (uInt)len;
+        strm.next_out = out;
+        strm.avail_out = (uInt)bound;
+        start = clock();
+        if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+            bail("deflate failed", "");
+        total += clock() - start;
+        reps++;
+    }
+    deflateEnd(&strm);
+    free(out);
+    free(in);
+    slides = (double)reps * (len >> windowBits);
+    record("slide");
+    add_number("memLevel", memLevel);
+    add_number("windowBits", windowBits);
+    add_number("us_per_slide",
+               1e6 * ((double)total / CLOCKS_PER_SEC) / slides);
+    if (!json)
+        printf("  memLevel %d, windowBits %d: %.2f us per slide\n", memLevel,
+               windowBits, 1e6 * ((double)total / CLOCKS_PER_SEC) / slides);
+}
+
+/* Compute the Adler-32 or CRC-32 of buf[0..len-1] repeatedly, and print the
+   speed. */
+static void time_check(const unsigned char *buf, size_t len, int crc) {
+    clock_t start, total = 0;
+    unsigned long check = 0;
+    long reps = 0;
+    int i;
+
+    do {
+        start = clock();
+        for (i = 0; i < 1000; i++)
+            check = crc ? crc32_z(check, buf, len) : adler32_z(check, buf, len);
+        total += clock() - start;
+        reps += 1000;
+    } while (total < CLOCKS_PER_SEC / 4);
+    record("check");
+    add_string("function", crc ? "crc32" : "adler32");
+    add_number("bytes", (double)len);
+    add_number("GBps", (double)len * reps / 1e9 /
+                       ((double)total / CLOCKS_PER_SEC));
+    if (!json)
+        printf("  %s %6lu bytes: %6.2f GB/s\n", crc ? "crc32  " : "adler32",
+               (unsigned long)len,
+               (double)len * reps / 1e9 / ((double)total / CLOCKS_PER_SEC));
+}
+
+/* Compare two doubles for qsort(). */
+static int by_value(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Compress and then decompress MESSAGES messages of size bytes each, taken
+   from buf[0..len-1], at level, resetting the same two streams for each
+   message as a server would, and print the 50th, 90th, 99th, and 99.9th
+   percentiles of the times in microseconds. */
+static void time_latency(const unsigned char *buf, size_t len, size_t size,
+                         int level) {
+    static const double pct[] = {50, 90, 99, 99.9};
+    static const char *name[] = {"p50", "p90", "p99", "p999"};
+    z_stream def, inf;
+    unsigned char *out, *back;
+    double *tdef, *tinf, start;
+    uLong bound;
+    size_t at;
+    char key[32];
+    int i, k;
+
+    if (len < size)
+        return;
+    memset(&def, 0, sizeof(def));
+    memset(&inf, 0, sizeof(inf));
+    if (deflateInit2(&def, level, Z_DEFLATED, 15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK ||
+        inflateInit2(&inf, 15) != Z_OK)
+        bail("initialization failed", "");
+    bound = deflateBound(&def, (uLong)size);
+    out = malloc(bound);
+    back = malloc(size);
+    tdef = malloc(MESSAGES * sizeof(double));
+    tinf = malloc(MESSAGES * sizeof(double));
+    if (out == NULL || back == NULL || tdef == NULL || tinf == NULL)
+        bail("out of memory", "");
+
+    /* the first tenth of the messages warm up the caches and are not kept */
+    for (i = -MESSAGES / 10; i < MESSAGES; i++) {
+        at = len > size ? (size_t)(i + MESSAGES) * 4099 % (len - size) : 0;
+        deflateReset(&def);
+        def.next_in = (z_const Bytef *)buf + at;
+        def.avail_in = (uInt)size;
+        def.next_out = out;
+        def.avail_out = (uInt)bound;
+        start = now();
+        if (deflate(&def, Z_FINISH) != Z_STREAM_END)
+            bail("deflate failed", "");
+        if (i >= 0)
+            tdef[i] = 1e6 * (now() - start);
+        inflateReset(&inf);
+        inf.next_in = out;
+        inf.avail_in = (uInt)def.total_out;
+        inf.next_out = back;
+        inf.avail_out = (uInt)size;
+        start = now();
+        if (inflate(&inf, Z_FINISH) != Z_STREAM_END)
+            bail("inflate failed", "");
+        if (i >= 0)
+            tinf[i] = 1e6 * (now() - start);
+    }
+    deflateEnd(&def);
+    inflateEnd(&inf);
+    qsort(tdef, MESSAGES, sizeof(double), by_value);
+    qsort(tinf, MESSAGES, sizeof(double), by_value);
+
+    record("latency");
+    add_number("bytes", (double)size);
+    add_number("level", level);
+    for (k = 0; k < 4; k++) {
+        sprintf(key, "deflate_%s_us", name[k]);
+        add_number(key, tdef[(int)(pct[k] / 100 * (MESSAGES - 1))]);
+    }
+    for (k = 0; k < 4; k++) {
+        sprintf(key, "inflate_%s_us", name[k]);
+        add_number(key, tinf[(int)(pct[k] / 100 * (MESSAGES - 1))]);
+    }
+    if (!json) {
+        printf("    %5lu bytes, level %d: deflate", (unsigned long)size,
+               level);
+        for (k = 0; k < 4; k++)
+            printf("%c%.1f", k ? '/' : ' ',
+                   tdef[(int)(pct[k] / 100 * (MESSAGES - 1))]);
+        printf(" us, inflate");
+        for (k = 0; k < 4; k++)
+            printf("%c%.1f", k ? '/' : ' ',
+                   tinf[(int)(pct[k] / 100 * (MESSAGES - 1))]);
+        printf(" us\n");
+    }
+    free(tinf);
+    free(tdef);
+    free(back);
+    free(out);
+}
+
+/* Run the hash comparison, the levels and strategies, and the small message
+   latencies on one corpus. */
+static void bench_corpus(const char *name, const unsigned char *buf,
+                         size_t len) {
+    static const int levels[] = {1, 4, 6, 9};
+    static const int others[] = {Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED};
+    int hash, k;
+    size_t size;
+
+    corpus = name;
+    if (!json)
+        printf("%s (%lu bytes)\n", name, (unsigned long)len);
+    for (hash = Z_HASH_ROLLING; hash <= Z_HASH_CRC32C; hash++) {
+        chain_walk(buf, len, hash);
+        for (k = 0; k < (int)(sizeof(levels) / sizeof(levels[0])); k++)
+            time_compress(buf, len, levels[k], Z_DEFAULT_STRATEGY, hash);
+        time_compress(buf, len, 1, Z_QUICK, hash);
+    }
+    if (!json)
+        printf("  levels and strategies\n");
+    for (k = 1; k <= 9; k++)
+        time_compress(buf, len, k, Z_DEFAULT_STRATEGY, Z_HASH_ROLLING);
+    for (k = 0; k < (int)(sizeof(others) / sizeof(others[0])); k++)
+        time_compress(buf, len, 6, others[k], Z_HASH_ROLLING);
+    time_compress(buf, len, 1, Z_QUICK, Z_HASH_ROLLING);
+    if (!json)
+        printf("  latency (p50/p90/p99/p99.9)\n");
+    for (size = 256; size <= 16384; size <<= 2) {
+        time_latency(buf, len, size, 1);
+        time_latency(buf, len, size, 6);
+    }
+    corpus = "";
+}
+
+/* Memory allocated through count_alloc() now, and the most at once since
+   mem_peak was last reset. Each block starts with its size. */
+static size_t mem_now = 0, mem_peak = 0;
+typedef union {
+    size_t size;
+    double align;
+    void *ptr;
+} count_head;
+
+static voidpf count_alloc(voidpf opaque, uInt items, uInt size) {
+    count_head *head;
+    size_t len = (size_t)items * size;
+
+    (void)opaque;
+    head = malloc(sizeof(count_head) + len);
+    if (head == NULL)
+        return Z_NULL;
+    head->size = len;
+    mem_now += len;
+    if (mem_peak < mem_now)
+        mem_peak = mem_now;
+    return head + 1;
+}
+
+static void count_free(voidpf opaque, voidpf address) {
+    count_head *head = (count_head *)address - 1;
+
+    (void)opaque;
+    mem_now -= head->size;
+    free(head);
+}
+
+/* Result of the regression check for one corpus and level. The speeds are
+   relative to reference_speed(). */
+typedef struct {
+    char corpus[16];
+    int level;
+    double deflate, inflate;            /* relative speeds */
+    unsigned long compressed;           /* total compressed bytes */
+    unsigned long deflate_mem;          /* peak bytes allocated by deflate */
+    unsigned long inflate_mem;          /* peak bytes allocated by inflate */
+} check_result;
+
+/* Keep the reference matcher from being optimized away. */
+static volatile unsigned long check_sink;
+
+/* Return the speed in MB/s of a simple greedy string matcher over
+   buf[0..len-1]. The check reports speeds relative to this, which scales with
+   the machine about as compression does. */
+static double reference_speed(const unsigned char *buf, size_t len) {
+    static size_t head[4096];
+    size_t i, cand, n;
+    unsigned long sum, h;
+    clock_t start, total;
+    double best = 0, speed;
+    int round, reps;
+
+    for (round = 0; round < 5; round++) {
+        reps = 0;
+        start = clock();
+        do {
+            memset(head, 0, sizeof(head));
+            sum = 0;
+            for (i = 0; i + 4 <= len;) {
+                h = ((buf[i] | (unsigned long)buf[i + 1] << 8 |
+                      (unsigned long)buf[i + 2] << 16 |
+                      (unsigned long)buf[i + 3] << 24) * 2654435761UL) &
+                    0xffffffffUL;
+                h >>= 20;
+                cand = head[h];
+                head[h] = i + 1;
+                n = 0;
+                if (cand--)
+                    while (i + n < len && n < 258 && buf[cand + n] == buf[i + n])
+                        n++;
+                sum += n;
+                i += n >= 4 ? n : 1;
+            }
+            check_sink += sum;
+            reps++;
+            total = clock() - start;
+        } while (reps < 3 || total < CLOCKS_PER_SEC / 50);
+        speed = mbps(len, reps, total);
+        if (best < speed)
+            best = speed;
+    }
+    return best;
+}
+
+/* Compress buf[0..len-1] as messages of msg bytes, resetting strm for each,
+   into out, saving the end of each compressed message in ends[]. */
+static void check_deflate(z_stream *strm, const unsigned char *buf,
+                          size_t len, size_t msg, unsigned char *out,
+                          uLong *ends, uLong room) {
+    size_t at;
+    uLong put = 0;
+    int k = 0;
+
+    for (at = 0; at < len; at += msg) {
+        deflateReset(strm);
+        strm->next_in = (z_const Bytef *)buf + at;
+        strm->avail_in = (uInt)(len - at < msg ? len - at : msg);
+        strm->next_out = out + put;
+        strm->avail_out = (uInt)(room - put);
+        if (deflate(strm, Z_FINISH) != Z_STREAM_END)
+            bail("deflate failed", "");
+        put += strm->total_out;
+        ends[k++] = put;
+    }
+}
+
+/* Decompress the messages made by check_deflate() into back. */
+static void check_inflate(z_stream *strm, const unsigned char *out,
+                          const uLong *ends, size_t len, size_t msg,
+                          unsigned char *back) {
+    size_t at;
+    uLong got = 0;
+    int k = 0;
+
+    for (at = 0; at < len; at += msg) {
+        inflateReset(strm);
+        strm->next_in = (z_const Bytef *)out + got;
+        strm->avail_in = (uInt)(ends[k] - got);
+        strm->next_out = back + at;
+        strm->avail_out = (uInt)(len - at < msg ? len - at : msg);
+        if (inflate(strm, Z_FINISH) != Z_STREAM_END)
+            bail("inflate failed", "");
+        got = ends[k++];
+    }
+}
+
+/* Run the regression check for one corpus and level, compressing messages
+   of msg bytes, or the whole corpus if msg is zero. The speeds are the best
+   of three rounds, or are left at zero if timed is false. */
+static void check_level(check_result *res, const char *name,
+                        const unsigned char *buf, size_t len, size_t msg,
+                        int level, int timed, double ref) {
+    z_stream strm;
+    unsigned char *out, *back;
+    uLong *ends, room;
+    size_t count;
+    clock_t start, total;
+    double speed;
+    int round, reps;
+
+    if (msg == 0)
+        msg = len;
+    count = (len + msg - 1) / msg;
+    memset(res, 0, sizeof(check_result));
+    strncpy(res->corpus, name, sizeof(res->corpus) - 1);
+    res->level = level;
+
+    memset(&strm, 0, sizeof(strm));
+    strm.zalloc = count_alloc;
+    strm.zfree = count_free;
+    mem_peak = mem_now;
+    if (deflateInit2(&strm, level, Z_DEFLATED, 15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        bail("deflateInit2 failed", "");
+    room = deflateBound(&strm, (uLong)msg) * count;
+    out = malloc(room);
+    back = malloc(len);
+    ends = malloc(count * sizeof(uLong));
+    if (out == NULL || back == NULL || ends == NULL)
+        bail("out of memory", "");
+    check_deflate(&strm, buf, len, msg, out, ends, room);
+    for (round = 0; timed && round < 3; round++) {
+        reps = 0;
+        start = clock();
+        do {
+            check_deflate(&strm, buf, len, msg, out, ends, room);
+            reps++;
+            total = clock() - start;
+        } while (total < CLOCKS_PER_SEC / 40);
+        speed = mbps(len, reps, total) / ref;
+        if (res->deflate < speed)
+            res->deflate = speed;
+    }
+    deflateEnd(&strm);
+    res->compressed = ends[count - 1];
+    res->deflate_mem = (unsigned long)mem_peak;
+
+    memset(&strm, 0, sizeof(strm));
+    strm.zalloc = count_alloc;
+    strm.zfree = count_free;
+    mem_peak = mem_now;
+    if (inflateInit2(&strm, 15) != Z_OK)
+        bail("inflateInit2 failed", "");
+    check_inflate(&strm, out, ends, len, msg, back);
+    if (memcmp(back, buf, len))
+        bail("round trip failed", "");
+    for (round = 0; timed && round < 3; round++) {
+        reps = 0;
+        start = clock();
+        do {
+            check_inflate(&strm, out, ends, len, msg, back);
+            reps++;
+            total = clock() - start;
+        } while (total < CLOCKS_PER_SEC / 40);
+        speed = mbps(len, reps, total) / ref;
+        if (res->inflate < speed)
+            res->inflate = speed;
+    }
+    inflateEnd(&strm);
+    res->inflate_mem = (unsigned long)mem_peak;
+    free(ends);
+    free(back);
+    free(out);
+}
+
+/* Find the result for corpus and level in the baseline file at path, and
+   return true if it is there. */
+static int find_base(check_result *base, const char *path, const char *corpus,
+                     int level) {
+    char line[256];
+    FILE *file;
+    int found = 0;
+
+    file = fopen(path, "r");
+    if (file == NULL)
+        bail("cannot read ", path);
+    while (!found && fgets(line, sizeof(line), file) != NULL)
+        found = line[0] != '#' &&
+                sscanf(line, "%15s %d %lf %lf %lu %lu %lu", base->corpus,
+                       &base->level, &base->deflate, &base->inflate,
+                       &base->compressed, &base->deflate_mem,
+                       &base->inflate_mem) == 7 &&
+                strcmp(base->corpus, corpus) == 0 && base->level == level;
+    fclose(file);
+    return found;
+}
+
+/* Compare res with base, print both, and return the number of regressions:
+   speeds more than tolerance percent lower, if timed, a compressed size more
+   than 0.1% larger, or a peak memory more than 1% larger. */
+static int compare(const check_result *res, const check_result *base,
+                   int timed, double tolerance) {
+    int bad = 0;
+
+    printf("%-8s %2d:", res->corpus, res->level);
+    if (timed) {
+        printf(" deflate %.3g (%.3g), inflate %.3g (%.3g),", res->deflate,
+               base->deflate, res->inflate, base->inflate);
+        if (res->deflate < base->deflate * (1 - tolerance / 100) ||
+            res->inflate < base->inflate * (1 - tolerance / 100)) {
+            printf(" SLOWER");
+            bad++;
+        }
+    }
+    printf(" %lu (%lu) bytes,", res->compressed, base->compressed);
+    if (res->compressed > base->compressed + base->compressed / 1000) {
+        printf(" LARGER");
+        bad++;
+    }
+    printf(" %lu/%lu (%lu/%lu) peak", res->deflate_mem, res->inflate_mem,
+           base->deflate_mem, base->inflate_mem);
+    if (res->deflate_mem > base->deflate_mem + base->deflate_mem / 100 ||
+        res->inflate_mem > base->inflate_mem + base->inflate_mem / 100) {
+        printf(" MORE MEMORY");
+        bad++;
+    }
+    putchar('\n');
+    return bad;
+}
+
+/* Return the middle of a, b, and c. */
+static double middle(double a, double b, double c) {
+    return a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+}
+
+/* Run the regression check. If update is true, write the results to the
+   baseline file at path, with the middle speeds of three measurements so that
+   a lucky one is not kept. Otherwise compare them with that file, allowing
+   speeds to be tolerance percent lower, or not comparing speeds if timed is
+   false, and return the number of regressions. A level that is slower is
+   measured up to twice more, keeping the best speeds, before it counts, since
+   other work on the machine can slow any one measurement. */
+static int check(const char *path, int update, int timed, double tolerance) {
+    static const char *kinds[] = {"text", "json", "binary", "random",
+                                  "messages"};
+    check_result res, again, base, more;
+    unsigned char *buf;
+    FILE *file = NULL;
+    double ref;
+    int k, level, retry, bad = 0, n = 0;
+
+    buf = malloc(CHECK_SIZE);
+    if (buf == NULL)
+        bail("out of memory", "");
+    timed = timed || update;
+    make_corpus("text", buf, CHECK_SIZE);
+    ref = timed ? reference_speed(buf, CHECK_SIZE) : 1;
+    if (update) {
+        file = fopen(path, "w");
+        if (file == NULL)
+            bail("cannot write ", path);
+        fprintf(file, "# zlib_bench regression baseline, written by "
+                "zlib_bench -u\n"
+                "# zlib %s, %s, reference matcher %.1f MB/s\n"
+                "# speeds are relative to the reference matcher\n"
+                "# corpus level deflate inflate compressed deflate_mem "
+                "inflate_mem\n", zlibVersion(), zlibKernels(), ref);
+    }
+    for (k = 0; k < 5; k++) {
+        if (k == 2 || k == 3)
+            make_binary(buf, CHECK_SIZE, k == 3);
+        else
+            make_corpus(k == 0 ? "text" : "json", buf, CHECK_SIZE);
+        for (level = 0; level < CHECK_LEVELS; level++, n++) {
+            check_level(&res, kinds[k], buf, CHECK_SIZE,
+                        k == 4 ? CHECK_MESSAGE : 0, level, timed, ref);
+            if (update) {
+                check_level(&again, kinds[k], buf, CHECK_SIZE,
+                            k == 4 ? CHECK_MESSAGE : 0, level, timed, ref);
+                check_level(&more, kinds[k], buf, CHECK_SIZE,
+                            k == 4 ? CHECK_MESSAGE : 0, level, timed, ref);
+                res.deflate = middle(res.deflate, again.deflate, more.deflate);
+                res.inflate = middle(res.inflate, again.inflate, more.inflate);
+                fprintf(file, "%s %d %.4g %.4g %lu %lu %lu\n", res.corpus,
+                        res.level, res.deflate, res.inflate, res.compressed,
+                        res.deflate_mem, res.inflate_mem);
+                continue;
+            }
+            if (!find_base(&base, path, res.corpus, res.level)) {
+                printf("%-8s %2d: not in the baseline -- REGRESSION\n",
+                       res.corpus, res.level);
+                bad++;
+                continue;
+            }
+            for (retry = 0; timed && retry < 2 &&
+                 (res.deflate < base.deflate * (1 - tolerance / 100) ||
+                  res.inflate < base.inflate * (1 - tolerance / 100));
+                 retry++) {
+                check_level(&again, kinds[k], buf, CHECK_SIZE,
+                            k == 4 ? CHECK_MESSAGE : 0, level, timed, ref);
+                if (res.deflate < again.deflate)
+                    res.deflate = again.deflate;
+                if (res.inflate < again.inflate)
+                    res.inflate = again.inflate;
+            }
+            bad += compare(&res, &base, timed, tolerance);
+        }
+    }
+    free(buf);
+    if (update) {
+        if (fclose(file))
+            bail("cannot write ", path);
+        printf("wrote %d results to %s\n", n, path);
+        return 0;
+    }
+    printf("%d regressions in %d results from %s", bad, n, path);
+    if (timed)
+        printf(", reference matcher %.1f MB/s", ref);
+    putchar('\n');
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned char *buf;
+    size_t len;
+    int i, first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-u") == 0)
+        return check(argv[2], 1, 1, 0);
+    if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+        if (argc > 4 && strcmp(argv[3], "-t") == 0)
+            return check(argv[2], 0, 1, atof(argv[4])) != 0;
+        return check(argv[2], 0, argc < 4 || strcmp(argv[3], "-s"), 30) != 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "-j") == 0) {
+        json = 1;
+        first = 2;
+    }
+    if (json) {
+        printf("{\n  \"version\": ");
+        put_string(zlibVersion());
+        printf(",\n  \"kernels\": ");
+        put_string(zlibKernels());
+        printf(",\n  \"results\": [");
+    }
+    else
+        printf("zlib %s, %s\n", zlibVersion(), zlibKernels());
+
+    buf = malloc(CORPUS_SIZE);
+    if (buf == NULL)
+        bail("out of memory", "");
+    if (first == argc) {
+        static const char *kinds[] = {"json", "csv", "text"};
+        for (i = 0; i < 3; i++) {
+            make_corpus(kinds[i], buf, CORPUS_SIZE);
+            bench_corpus(kinds[i], buf, CORPUS_SIZE);
+        }
+    }
+    for (i = first; i < argc; i++) {
+        unsigned char *file;
+
+        file = load(argv[i], &len);
+        bench_corpus(argv[i], file, len);
+        free(file);
+    }
+
+    if (!json)
+        printf("slide\n");
+    time_slide(16 * CORPUS_SIZE, 8, 15);
+    time_slide(16 * CORPUS_SIZE, 9, 15);
+    if (!json)
+        printf("check\n");
+    make_corpus("text", buf, CORPUS_SIZE);
+    for (len = 64; len <= 65536; len <<= 4) {
+        time_check(buf, len, 0);
+        time_check(buf, len, 1);
+    }
+    free(buf);
+    if (json)
+        printf("%s\n  ]\n}\n", records ? "}" : "");
+    return 0;
+}
@@ -146,6 +146,32 @@ local TCONST static_tree_desc static_bl_desc =
     put_byte(s, (uch)((ush)(w) >> 8)); \
 }
 
+/* ===========================================================================
+ * Output all Buf_size bits of the bit buffer LSB first on the stream. The
+ * bytes are stored through a local pointer, so that the compiler can combine
+ * them into a single wide store.
+ * IN assertion: there is enough room in pendingBuf.
+ */
+#if Buf_size == 64
+#  define put_bi_buf(s) { \
+    bi_t buf = s->bi_buf; \
+    uchf *out = s->pending_buf + s->pending; \
+    out[0] = (uch)buf;          out[1] = (uch)(buf >> 8); \
+    out[2] = (uch)(buf >> 16);  out[3] = (uch)(buf >> 24); \
+    out[4] = (uch)(buf >> 32);  out[5] = (uch)(buf >> 40); \
+    out[6] = (uch)(buf >> 48);  out[7] = (uch)(buf >> 56); \
+    s->pending += 8; \
+}
+#else
+#  define put_bi_buf(s) { \
+    bi_t buf = s->bi_buf; \
+    uchf *out = s->pending_buf + s->pending; \
+    out[0] = (uch)buf;          out[1] = (uch)(buf >> 8); \
+    out[2] = (uch)(buf >> 16);  out[3] = (uch)(buf >> 24); \
+    s->pending += 4; \
+}
+#endif
+
 /* ===========================================================================
  * Reverse the first len bits of a code, using straightforward code (a faster
  * method would use a table)
@@ -164,11 +190,7 @@ local unsigned bi_reverse(unsigned code, int len) {
  * Flush the bit buffer, keeping at most 7 bits in it.
  */
 local void bi_flush(deflate_state *s) {
-    if (s->bi_valid == 16) {
-        put_short(s, s->bi_buf);
-        s->bi_buf = 0;
-        s->bi_valid = 0;
-    } else if (s->bi_valid >= 8) {
+    while (s->bi_valid >= 8) {
         put_byte(s, (Byte)s->bi_buf);
         s->bi_buf >>= 8;
         s->bi_valid -= 8;
@@ -179,12 +201,12 @@ local void bi_flush(deflate_state *s) {
  * Flush the bit buffer and align the output on a byte boundary
  */
 local void bi_windup(deflate_state *s) {
-    if (s->bi_valid > 8) {
-        put_short(s, s->bi_buf);
-    } else if (s->bi_valid > 0) {
+    s->bi_used = ((s->bi_valid - 1) & 7) + 1;
+    while (s->bi_valid > 0) {
         put_byte(s, (Byte)s->bi_buf);
+        s->bi_buf >>= 8;
+        s->bi_valid -= 8;
     }
-    s->bi_used = ((s->bi_valid - 1) & 7) + 1;
     s->bi_buf = 0;
     s->bi_valid = 0;
 #ifdef ZLIB_DEBUG
@@ -256,16 +278,17 @@ local void send_bits(deflate_state *s, int value, int length) {
     s->bits_sent += (ulg)length;
 
     /* If not enough room in bi_buf, use (valid) bits from bi_buf and
-     * (16 - bi_valid) bits from value, leaving (width - (16 - bi_valid))
-     * unused bits in value.
+     * (Buf_size - bi_valid) bits from value, leaving (width - (Buf_size -
+     * bi_valid)) unused bits in value. bi_buf is written when it fills, so
+     * that bi_valid is always less than Buf_size for the shifts.
      */
-    if (s->bi_valid > (int)Buf_size - length) {
-        s->bi_buf |= (ush)value << s->bi_valid;
-        put_short(s, s->bi_buf);
-        s->bi_buf = (ush)value >> (Buf_size - s->bi_valid);
+    if (s->bi_valid >= (int)Buf_size - length) {
+        s->bi_buf |= (bi_t)value << s->bi_valid;
+        put_bi_buf(s);
+        s->bi_buf = (bi_t)value >> (Buf_size - s->bi_valid);
         s->bi_valid += length - Buf_size;
     } else {
-        s->bi_buf |= (ush)value << s->bi_valid;
+        s->bi_buf |= (bi_t)value << s->bi_valid;
         s->bi_valid += length;
     }
 }
@@ -273,14 +296,14 @@ local void send_bits(deflate_state *s, int value, int length) {
 
 #define send_bits(s, value, length) \
 { int len = length;\
-  if (s->bi_valid > (int)Buf_size - len) {\
+  if (s->bi_valid >= (int)Buf_size - len) {\
     int val = (int)value;\
-    s->bi_buf |= (ush)val << s->bi_valid;\
-    put_short(s, s->bi_buf);\
-    s->bi_buf = (ush)val >> (Buf_size - s->bi_valid);\
+    s->bi_buf |= (bi_t)val << s->bi_valid;\
+    put_bi_buf(s);\
+    s->bi_buf = (bi_t)val >> (Buf_size - s->bi_valid);\
     s->bi_valid += len - Buf_size;\
   } else {\
-    s->bi_buf |= (ush)(value) << s->bi_valid;\
+    s->bi_buf |= (bi_t)(value) << s->bi_valid;\
     s->bi_valid += len;\
   }\
 }
@@ -794,15 +817,17 @@ local void send_tree(deflate_state *s, ct_data *tree, int max_code) {
 }
 
 /* ===========================================================================
- * Construct the Huffman tree for the bit lengths and return the index in
- * bl_order of the last bit length code to send.
+ * Construct the Huffman tree for the bit lengths of the literal and distance
+ * trees in l_desc and d_desc, and return the index in bl_order of the last bit
+ * length code to send.
  */
-local int build_bl_tree(deflate_state *s) {
+local int build_bl_tree(deflate_state *s, tree_desc *l_desc,
+                        tree_desc *d_desc) {
     int max_blindex;  /* index of last bit length code of non zero freq */
 
     /* Determine the bit length frequencies for literal and distance trees */
-    scan_tree(s, (ct_data *)s->dyn_ltree, s->l_desc.max_code);
-    scan_tree(s, (ct_data *)s->dyn_dtree, s->d_desc.max_code);
+    scan_tree(s, l_desc->dyn_tree, l_desc->max_code);
+    scan_tree(s, d_desc->dyn_tree, d_desc->max_code);
 
     /* Build the bit length tree: */
     build_tree(s, (tree_desc *)(&(s->bl_desc)));
@@ -859,6 +884,8 @@ local void send_all_trees(deflate_state *s, int lcodes, int dcodes,
  */
 void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
                                     ulg stored_len, int last) {
+    STAT(s, stored_blocks, 1);
+    STAT(s, block_bytes, stored_len);
     send_bits(s, (STORED_BLOCK<<1) + last, 3);  /* send block type */
     bi_windup(s);        /* align on byte boundary */
     put_short(s, (ush)stored_len);
@@ -895,25 +922,154 @@ void ZLIB_INTERNAL _tr_align(deflate_state *s) {
 }
 
 /* ===========================================================================
- * Send the block data compressed using the given Huffman trees
+ * Start a block coded with the static trees, for deflate_quick(). Literals and
+ * matches are then sent directly with _tr_quick_lit() and _tr_quick_dist(),
+ * with no symbol buffer and no tree construction, and the block is ended with
+ * _tr_quick_end().
+ */
+void ZLIB_INTERNAL _tr_quick_start(deflate_state *s, int last) {
+    STAT(s, static_blocks, 1);
+    send_bits(s, (STATIC_TREES<<1) + last, 3);
+#ifdef ZLIB_DEBUG
+    s->compressed_len += 3;
+#endif
+}
+
+/* ===========================================================================
+ * Send the literal byte c with the static literal/length tree.
+ */
+void ZLIB_INTERNAL _tr_quick_lit(deflate_state *s, unsigned c) {
+    STAT(s, literals, 1);
+    STAT(s, block_bytes, 1);
+    send_code(s, c, static_ltree);
+    Tracecv(isgraph(c), (stderr," '%c' ", c));
+#ifdef ZLIB_DEBUG
+    s->compressed_len += static_ltree[c].Len;
+#endif
+}
+
+/* ===========================================================================
+ * Send a match of length lc + MIN_MATCH at distance dist with the static
+ * trees.
+ */
+void ZLIB_INTERNAL _tr_quick_dist(deflate_state *s, unsigned dist,
+                                  unsigned lc) {
+    unsigned code;      /* the code to send */
+    int extra;          /* number of extra bits to send */
+
+    Assert(dist != 0 && lc <= MAX_MATCH-MIN_MATCH, "bad match");
+    STAT(s, matches, 1);
+    STAT(s, block_bytes, lc + MIN_MATCH);
+    code = _length_code[lc];
+    send_code(s, code + LITERALS + 1, static_ltree);
+    extra = extra_lbits[code];
+#ifdef ZLIB_DEBUG
+    s->compressed_len += static_ltree[code + LITERALS + 1].Len + extra;
+#endif
+    if (extra != 0) {
+        lc -= (unsigned)base_length[code];
+        send_bits(s, lc, extra);
+    }
+    dist--;             /* dist is now the match distance - 1 */
+    code = d_code(dist);
+    send_code(s, code, static_dtree);
+    extra = extra_dbits[code];
+#ifdef ZLIB_DEBUG
+    s->compressed_len += 5 + extra;
+#endif
+    if (extra != 0) {
+        dist -= (unsigned)base_dist[code];
+        send_bits(s, dist, extra);
+    }
+}
+
+/* ===========================================================================
+ * End a block started by _tr_quick_start(), aligning on a byte boundary if it
+ * is the last block.
+ */
+void ZLIB_INTERNAL _tr_quick_end(deflate_state *s, int last) {
+    send_code(s, END_BLOCK, static_ltree);
+#ifdef ZLIB_DEBUG
+    s->compressed_len += 7;
+#endif
+    Assert (s->compressed_len == s->bits_sent, "bad compressed size");
+    if (last) {
+        bi_windup(s);
+#ifdef ZLIB_DEBUG
+        s->compressed_len += 7;  /* align on byte boundary */
+#endif
+    }
+}
+
+/* ===========================================================================
+ * Set the bit costs of the literals, lengths, and distance codes in opt for
+ * deflate_optimal(). If fixed is true, the costs are those of the static
+ * trees. Otherwise Huffman codes are built as _tr_flush_block() would, from
+ * the frequencies in opt->ltree and opt->dtree plus those of the symbols
+ * tallied so far in the current block, and the costs are the lengths of those
+ * codes. A symbol with no code is given a cost of MAX_BITS. The current block
+ * is not disturbed.
+ */
+#define OPT_LEN(len) ((len) ? (ush)(len) : MAX_BITS)
+
+void ZLIB_INTERNAL _tr_opt_costs(deflate_state *s, opt_state *opt, int fixed) {
+    tree_desc l_desc, d_desc;
+    ulg opt_len = s->opt_len, static_len = s->static_len;
+    int n, code;
+
+    if (fixed) {
+        for (n = 0; n < L_CODES; n++)
+            opt->ltree[n].Len = static_ltree[n].Len;
+        for (n = 0; n < D_CODES; n++)
+            opt->dtree[n].Len = static_dtree[n].Len;
+    }
+    else {
+        for (n = 0; n < L_CODES; n++)
+            opt->ltree[n].Freq += s->dyn_ltree[n].Freq;
+        for (n = 0; n < D_CODES; n++)
+            opt->dtree[n].Freq += s->dyn_dtree[n].Freq;
+        l_desc.dyn_tree = opt->ltree;
+        l_desc.stat_desc = &static_l_desc;
+        d_desc.dyn_tree = opt->dtree;
+        d_desc.stat_desc = &static_d_desc;
+        build_tree(s, &l_desc);
+        build_tree(s, &d_desc);
+        s->opt_len = opt_len;
+        s->static_len = static_len;
+    }
+    for (n = 0; n < LITERALS; n++)
+        opt->lit_cost[n] = OPT_LEN(opt->ltree[n].Len);
+    for (n = MIN_MATCH; n <= MAX_MATCH; n++) {
+        code = _length_code[n - MIN_MATCH];
+        opt->len_cost[n] = OPT_LEN(opt->ltree[code + LITERALS + 1].Len) +
+                           extra_lbits[code];
+    }
+    for (code = 0; code < D_CODES; code++)
+        opt->dist_cost[code] = OPT_LEN(opt->dtree[code].Len) +
+                               extra_dbits[code];
+}
+
+/* ===========================================================================
+ * Send the block data compressed using the given Huffman trees, for the
+ * symbols from index sx up to end in the symbol buffers.
  */
 local void compress_block(deflate_state *s, const ct_data *ltree,
-                          const ct_data *dtree) {
+                          const ct_data *dtree, unsigned sx, unsigned end) {
     unsigned dist;      /* distance of matched string */
     int lc;             /* match length or unmatched char (if dist == 0) */
-    unsigned sx = 0;    /* running index in symbol buffers */
     unsigned code;      /* the code to send */
     int extra;          /* number of extra bits to send */
 
-    if (s->sym_next != 0) do {
-#ifdef LIT_MEM
-        dist = s->d_buf[sx];
-        lc = s->l_buf[sx++];
-#else
-        dist = s->sym_buf[sx++] & 0xff;
-        dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
-        lc = s->sym_buf[sx++];
-#endif
+    if (sx < end) do {
+        if (s->lit_mem) {
+            dist = s->d_buf[sx];
+            lc = s->l_buf[sx++];
+        }
+        else {
+            dist = s->sym_buf[sx++] & 0xff;
+            dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
+            lc = s->sym_buf[sx++];
+        }
         if (dist == 0) {
             send_code(s, lc, ltree); /* send a literal byte */
             Tracecv(isgraph(lc), (stderr," '%c' ", lc));
@@ -939,13 +1095,11 @@ local void compress_block(deflate_state *s, const ct_data *ltree,
         } /* literal or match pair ? */
 
         /* Check for no overlay of pending_buf on needed symbols */
-#ifdef LIT_MEM
-        Assert(s->pending < 2 * (s->lit_bufsize + sx), "pendingBuf overflow");
-#else
-        Assert(s->pending < s->lit_bufsize + sx, "pendingBuf overflow");
-#endif
+        Assert(s->pending < (s->lit_mem ? 2 * (s->lit_bufsize + sx) :
+                                          s->lit_bufsize + sx),
+               "pendingBuf overflow");
 
-    } while (sx < s->sym_next);
+    } while (sx < end);
 
     send_code(s, END_BLOCK, ltree);
 }
@@ -990,21 +1144,212 @@ local int detect_data_type(deflate_state *s) {
     return Z_BINARY;
 }
 
+#define REUSE_NEAR 3
+/* saved codes fit a block if its data bits per symbol with them are within
+ * 1/8 (>> 3) of the bits per symbol of the counts they were built from
+ */
+
+#define REUSE_SPAN 16384
+/* the recent counts are halved when they add up to more than this */
+
+#define REUSE_LOSS 5
+/* saved codes are trusted if they give at most 1/32 (>> 5) more bits for a
+ * block than codes built for it
+ */
+
+#define REUSE_TRUST 4
+/* blocks coded in a row with trusted codes double up to 1 << REUSE_TRUST */
+
 /* ===========================================================================
- * Determine the best encoding for the current block: dynamic trees, static
- * trees or store, and write out the encoded block.
+ * Add the symbol counts of the current block to the recent counts in
+ * s->reuse, halving the recent counts first if there are too many, so that
+ * symbols that are no longer used fade away.
  */
-void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
-                                   ulg stored_len, int last) {
+local void reuse_count(deflate_state *s) {
+    reuse_state *ru = s->reuse;
+    int n;
+
+    if (ru->total > REUSE_SPAN) {
+        ru->total = 0;
+        for (n = 0; n < L_CODES; n++)
+            ru->total += ru->freq[n] >>= 1;
+        for (n = 0; n < D_CODES; n++)
+            ru->freq[L_CODES + n] >>= 1;
+    }
+    for (n = 0; n < L_CODES; n++) {
+        ru->freq[n] += s->dyn_ltree[n].Freq;
+        ru->total += s->dyn_ltree[n].Freq;
+    }
+    for (n = 0; n < D_CODES; n++)
+        ru->freq[L_CODES + n] += s->dyn_dtree[n].Freq;
+}
+
+/* ===========================================================================
+ * Build the saved codes in s->reuse from the recent counts, as flush_block()
+ * would build them for a block with those counts. The current block is not
+ * disturbed.
+ */
+local void reuse_build(deflate_state *s) {
+    reuse_state *ru = s->reuse;
+    tree_desc l_desc, d_desc;
+    ulg data, syms = 0;
+    int n;
+
+    for (n = 0; n < L_CODES; n++)
+        syms += ru->ltree[n].Freq = ru->freq[n];
+    for (n = 0; n < D_CODES; n++)
+        ru->dtree[n].Freq = ru->freq[L_CODES + n];
+    l_desc.dyn_tree = ru->ltree;
+    l_desc.stat_desc = &static_l_desc;
+    d_desc.dyn_tree = ru->dtree;
+    d_desc.stat_desc = &static_d_desc;
+    build_tree(s, &l_desc);
+    build_tree(s, &d_desc);
+    data = s->opt_len;
+    ru->blcodes = build_bl_tree(s, &l_desc, &d_desc) + 1;
+    ru->lcodes = l_desc.max_code + 1;
+    ru->dcodes = d_desc.max_code + 1;
+    ru->header = s->opt_len - data;
+    ru->rate = (data << 8) / syms;
+    ru->skip = 0;
+    zmemcpy(ru->bl_tree, s->bl_tree, sizeof(ru->bl_tree));
+
+    /* leave the bit length counts and lengths as init_block() did */
+    for (n = 0; n < BL_CODES; n++)
+        s->bl_tree[n].Freq = 0;
+    s->opt_len = s->static_len = 0L;
+}
+
+/* ===========================================================================
+ * Return true if the saved codes in s->reuse fit the current block: every
+ * symbol in the block has a code, and the data bits per symbol are near the
+ * bits per symbol of the counts the codes were built from. If so, set opt_len
+ * and static_len to the data bits of the block with the saved codes and with
+ * the fixed codes.
+ */
+local int reuse_fit(deflate_state *s) {
+    reuse_state *ru = s->reuse;
+    ulg data = 0;       /* data bits with the saved codes */
+    ulg fixed = 0;      /* data bits with the fixed codes */
+    ulg syms = 0;       /* literal, length, and end-of-block symbols */
+    ulg rate;           /* data bits per symbol, times 256 */
+    unsigned f;         /* frequency of a symbol */
+    int n, x;
+
+    if (ru->lcodes == 0)
+        return 0;
+    for (n = 0; n < L_CODES; n++) {
+        f = s->dyn_ltree[n].Freq;
+        if (f == 0)
+            continue;
+        if (n >= ru->lcodes || ru->ltree[n].Len == 0)
+            return 0;
+        x = n > LITERALS ? extra_lbits[n - LITERALS - 1] : 0;
+        data += (ulg)f * (ru->ltree[n].Len + x);
+        fixed += (ulg)f * (static_ltree[n].Len + x);
+        syms += f;
+    }
+    for (n = 0; n < D_CODES; n++) {
+        f = s->dyn_dtree[n].Freq;
+        if (f == 0)
+            continue;
+        if (n >= ru->dcodes || ru->dtree[n].Len == 0)
+            return 0;
+        data += (ulg)f * (ru->dtree[n].Len + extra_dbits[n]);
+        fixed += (ulg)f * (static_dtree[n].Len + extra_dbits[n]);
+    }
+    rate = (data << 8) / syms;
+    if (rate + (ru->rate >> REUSE_NEAR) < ru->rate ||
+        rate > ru->rate + (ru->rate >> REUSE_NEAR))
+        return 0;
+    s->opt_len = data;
+    s->static_len = fixed;
+    return 1;
+}
+
+/* ===========================================================================
+ * Choose the codes for the current block from the saved codes in s->reuse,
+ * rebuilt from the recent counts if they don't fit the block, and the fixed
+ * codes, without building codes for the block itself. Return -1 if the saved
+ * codes don't fit the block or are due to be checked against codes built for
+ * it, leaving the block as it was. Return 0 if the fixed codes are better,
+ * with opt_len and static_len both set to the bits of the block with the
+ * fixed codes. Return 1 if the saved codes are better, having put them in
+ * dyn_ltree, dyn_dtree, and bl_tree, and having set opt_len, static_len, and
+ * *max_blindex as build_bl_tree() would.
+ */
+local int reuse_trees(deflate_state *s, int *max_blindex) {
+    reuse_state *ru = s->reuse;
+
+    reuse_count(s);
+    ru->guess = 0;
+    if (!reuse_fit(s)) {
+        reuse_build(s);
+        if (!reuse_fit(s))
+            return -1;
+    }
+    if (ru->skip == 0) {
+        /* have reuse_judge() compare with the codes built for the block */
+        ru->guess = s->opt_len + ru->header < s->static_len ?
+                    s->opt_len + ru->header : s->static_len;
+        s->opt_len = s->static_len = 0L;
+        return -1;
+    }
+    ru->skip--;
+    if (s->opt_len + ru->header >= s->static_len) {
+        s->opt_len = s->static_len;
+        return 0;
+    }
+    zmemcpy(s->dyn_ltree, ru->ltree, (L_CODES + 1) * sizeof(ct_data));
+    zmemcpy(s->dyn_dtree, ru->dtree, (D_CODES + 1) * sizeof(ct_data));
+    zmemcpy(s->bl_tree, ru->bl_tree, sizeof(ru->bl_tree));
+    s->l_desc.max_code = ru->lcodes - 1;
+    s->d_desc.max_code = ru->dcodes - 1;
+    s->opt_len += ru->header;
+    *max_blindex = ru->blcodes - 1;
+    return 1;
+}
+
+/* ===========================================================================
+ * Compare the bits for the current block with the saved codes or the fixed
+ * codes, as found by reuse_trees(), with fresh, the bits with the codes just
+ * built for the block or the fixed codes. If the saved codes did about as
+ * well, then trust them for twice as many blocks as the last time before
+ * checking them again.
+ */
+local void reuse_judge(deflate_state *s, ulg fresh) {
+    reuse_state *ru = s->reuse;
+
+    if (ru->guess != 0 && ru->guess <= fresh + (fresh >> REUSE_LOSS)) {
+        ru->skip = 1 << ru->trust;
+        if (ru->trust < REUSE_TRUST)
+            ru->trust++;
+    }
+    else
+        ru->trust = 0;
+}
+
+/* ===========================================================================
+ * Determine the best encoding for the symbols from index sx up to end in the
+ * symbol buffers, whose frequencies are in dyn_ltree and dyn_dtree: dynamic
+ * trees, static trees or store, and write out the encoded block.
+ */
+local void flush_block(deflate_state *s, charf *buf, ulg stored_len,
+                       int last, unsigned sx, unsigned end) {
     ulg opt_lenb, static_lenb; /* opt_len and static_len in bytes */
     int max_blindex = 0;  /* index of last bit length code of non zero freq */
 
-    /* Build the Huffman trees unless a stored block is forced */
-    if (s->level > 0) {
+    /* Build the Huffman trees unless a stored block is forced, or choose
+     * between the saved codes and the fixed codes if deflateReuse() is on and
+     * the saved codes fit the block */
+    if (s->level > 0 && s->reuse != Z_NULL && s->strategy != Z_FIXED &&
+        reuse_trees(s, &max_blindex) >= 0) {
+        Tracev((stderr, "\nreused trees: dyn %ld, stat %ld", s->opt_len,
+                s->static_len));
+        opt_lenb = (s->opt_len + 3 + 7) >> 3;
+        static_lenb = (s->static_len + 3 + 7) >> 3;
 
-        /* Check if the file is binary or text */
-        if (s->strm->data_type == Z_UNKNOWN)
-            s->strm->data_type = detect_data_type(s);
+    } else if (s->level > 0) {
 
         /* Construct the literal and distance trees */
         build_tree(s, (tree_desc *)(&(s->l_desc)));
@@ -1021,7 +1366,10 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
         /* Build the bit length tree for the above two trees, and get the index
          * in bl_order of the last bit length code to send.
          */
-        max_blindex = build_bl_tree(s);
+        max_blindex = build_bl_tree(s, &s->l_desc, &s->d_desc);
+        if (s->reuse != Z_NULL && s->strategy != Z_FIXED)
+            reuse_judge(s, s->opt_len < s->static_len ? s->opt_len :
+                                                        s->static_len);
 
         /* Determine the best encoding. Compute the block lengths in bytes. */
         opt_lenb = (s->opt_len + 3 + 7) >> 3;
@@ -1029,17 +1377,16 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
 
         Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
                 opt_lenb, s->opt_len, static_lenb, s->static_len, stored_len,
-                s->sym_next / 3));
-
-#ifndef FORCE_STATIC
-        if (static_lenb <= opt_lenb || s->strategy == Z_FIXED)
-#endif
-            opt_lenb = static_lenb;
+                (end - sx) / SYM_SIZE(s)));
 
     } else {
         Assert(buf != (char*)0, "lost buf");
         opt_lenb = static_lenb = stored_len + 5; /* force a stored block */
     }
+#ifndef FORCE_STATIC
+    if (static_lenb <= opt_lenb || s->strategy == Z_FIXED)
+#endif
+        opt_lenb = static_lenb;
 
 #ifdef FORCE_STORED
     if (buf != (char*)0) { /* force stored block */
@@ -1056,18 +1403,22 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
         _tr_stored_block(s, buf, stored_len, last);
 
     } else if (static_lenb == opt_lenb) {
+        STAT(s, static_blocks, 1);
+        STAT(s, block_bytes, stored_len);
         send_bits(s, (STATIC_TREES<<1) + last, 3);
         compress_block(s, (const ct_data *)static_ltree,
-                       (const ct_data *)static_dtree);
+                       (const ct_data *)static_dtree, sx, end);
 #ifdef ZLIB_DEBUG
         s->compressed_len += 3 + s->static_len;
 #endif
     } else {
+        STAT(s, dynamic_blocks, 1);
+        STAT(s, block_bytes, stored_len);
         send_bits(s, (DYN_TREES<<1) + last, 3);
         send_all_trees(s, s->l_desc.max_code + 1, s->d_desc.max_code + 1,
                        max_blindex + 1);
         compress_block(s, (const ct_data *)s->dyn_ltree,
-                       (const ct_data *)s->dyn_dtree);
+                       (const ct_data *)s->dyn_dtree, sx, end);
 #ifdef ZLIB_DEBUG
         s->compressed_len += 3 + s->opt_len;
 #endif
@@ -1076,6 +1427,163 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
     /* The above check is made mod 2^32, for files larger than 512 MB
      * and uLong implemented on 32 bits.
      */
+}
+
+#define SPLIT_MIN (SPLIT_SEGS * 256)
+/* fewest symbols in a block that is considered for splitting */
+
+/* ===========================================================================
+ * Count the symbols of the current block in each of SPLIT_SEGS segments with
+ * equal numbers of symbols, saving in s->split the counts, input bytes, and
+ * symbol buffer index before each segment boundary.
+ */
+local void split_count(deflate_state *s) {
+    split_state *sp = s->split;
+    unsigned dist;      /* distance of matched string */
+    int lc;             /* match length or unmatched char (if dist == 0) */
+    unsigned sx = 0;    /* running index in symbol buffers */
+    unsigned next;      /* index of the next segment boundary */
+    ulg len = 0;        /* input bytes so far */
+    ush *freq;          /* counts up to the next boundary */
+    int k;
+
+    zmemzero(sp->freq[0], sizeof(sp->freq[0]));
+    sp->len[0] = 0;
+    sp->sym[0] = 0;
+    for (k = 1; k <= SPLIT_SEGS; k++) {
+        freq = sp->freq[k];
+        zmemcpy(freq, sp->freq[k - 1], sizeof(sp->freq[0]));
+        next = s->sym_next / SYM_SIZE(s) * k / SPLIT_SEGS * SYM_SIZE(s);
+        while (sx < next) {
+            if (s->lit_mem) {
+                dist = s->d_buf[sx];
+                lc = s->l_buf[sx++];
+            }
+            else {
+                dist = s->sym_buf[sx++] & 0xff;
+                dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
+                lc = s->sym_buf[sx++];
+            }
+            if (dist == 0) {
+                freq[lc]++;
+                len++;
+            }
+            else {
+                freq[_length_code[lc] + LITERALS + 1]++;
+                freq[L_CODES + d_code(dist - 1)]++;
+                len += lc + MIN_MATCH;
+            }
+        }
+        sp->len[k] = len;
+        sp->sym[k] = sx;
+    }
+}
+
+/* ===========================================================================
+ * Return the number of bits to code segments i up to j of the current block
+ * as one block, which may be stored if stored is true. The trees are built
+ * as flush_block() would, but from the counts in s->split, so that the
+ * current block is not disturbed.
+ */
+local ulg split_bits(deflate_state *s, int i, int j, int stored) {
+    split_state *sp = s->split;
+    tree_desc l_desc, d_desc;
+    ulg bits, len;
+    int n;
+
+    for (n = 0; n < L_CODES; n++)
+        sp->ltree[n].Freq = sp->freq[j][n] - sp->freq[i][n];
+    sp->ltree[END_BLOCK].Freq = 1;
+    for (n = 0; n < D_CODES; n++)
+        sp->dtree[n].Freq = sp->freq[j][L_CODES + n] -
+                            sp->freq[i][L_CODES + n];
+    l_desc.dyn_tree = sp->ltree;
+    l_desc.stat_desc = &static_l_desc;
+    d_desc.dyn_tree = sp->dtree;
+    d_desc.stat_desc = &static_d_desc;
+    build_tree(s, &l_desc);
+    build_tree(s, &d_desc);
+    build_bl_tree(s, &l_desc, &d_desc);
+    bits = 3 + (s->static_len <= s->opt_len ? s->static_len : s->opt_len);
+    len = sp->len[j] - sp->len[i];
+    if (stored && (len + 5) << 3 < bits)
+        bits = (len + 5) << 3;
+
+    /* leave the bit length counts and lengths as init_block() did */
+    for (n = 0; n < BL_CODES; n++)
+        s->bl_tree[n].Freq = 0;
+    s->opt_len = s->static_len = 0L;
+    return bits;
+}
+
+/* ===========================================================================
+ * Write the current block as the run of blocks, each made of whole segments,
+ * that takes the fewest bits. The best cost up to each segment boundary is
+ * the least over the boundaries before it of the best cost up to there plus
+ * the cost of one block from there. The block is written whole if that is
+ * best.
+ */
+local void split_flush(deflate_state *s, charf *buf, ulg stored_len,
+                       int last) {
+    split_state *sp = s->split;
+    int end[SPLIT_SEGS];    /* ends of the blocks to write, last first */
+    int i, j, k, n;
+    ulg bits;
+
+    split_count(s);
+    Assert(sp->len[SPLIT_SEGS] == stored_len, "bad split length");
+    sp->cost[0] = 0;
+    for (j = 1; j <= SPLIT_SEGS; j++) {
+        sp->cost[j] = (ulg)-1;
+        for (i = 0; i < j; i++) {
+            bits = sp->cost[i] + split_bits(s, i, j, buf != (char*)0);
+            if (bits < sp->cost[j]) {
+                sp->cost[j] = bits;
+                sp->from[j] = i;
+            }
+        }
+    }
+    n = 0;
+    for (j = SPLIT_SEGS; j; j = sp->from[j])
+        end[n++] = j;
+    if (n == 1) {
+        flush_block(s, buf, stored_len, last, 0, s->sym_next);
+        return;
+    }
+
+    /* write each block with the counts of its own symbols */
+    for (i = 0; n--; i = j) {
+        j = end[n];
+        for (k = 0; k < L_CODES; k++)
+            s->dyn_ltree[k].Freq = sp->freq[j][k] - sp->freq[i][k];
+        s->dyn_ltree[END_BLOCK].Freq = 1;
+        for (k = 0; k < D_CODES; k++)
+            s->dyn_dtree[k].Freq = sp->freq[j][L_CODES + k] -
+                                   sp->freq[i][L_CODES + k];
+        for (k = 0; k < BL_CODES; k++)
+            s->bl_tree[k].Freq = 0;
+        s->opt_len = s->static_len = 0L;
+        flush_block(s, buf == (char*)0 ? (char*)0 : buf + sp->len[i],
+                    sp->len[j] - sp->len[i], last && j == SPLIT_SEGS,
+                    sp->sym[i], sp->sym[j]);
+    }
+}
+
+/* ===========================================================================
+ * Write out the current block, as several blocks if deflateSplit() is on and
+ * that is smaller.
+ */
+void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
+                                   ulg stored_len, int last) {
+    /* Check if the file is binary or text */
+    if (s->level > 0 && s->strm->data_type == Z_UNKNOWN)
+        s->strm->data_type = detect_data_type(s);
+
+    if (s->split != Z_NULL && s->level > 0 && s->strategy != Z_FIXED &&
+        s->sym_next >= SPLIT_MIN * SYM_SIZE(s))
+        split_flush(s, buf, stored_len, last);
+    else
+        flush_block(s, buf, stored_len, last, 0, s->sym_next);
     init_block(s);
 
     if (last) {
@@ -1093,19 +1601,22 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
  * the current block must be flushed.
  */
 int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc) {
-#ifdef LIT_MEM
-    s->d_buf[s->sym_next] = (ush)dist;
-    s->l_buf[s->sym_next++] = (uch)lc;
-#else
-    s->sym_buf[s->sym_next++] = (uch)dist;
-    s->sym_buf[s->sym_next++] = (uch)(dist >> 8);
-    s->sym_buf[s->sym_next++] = (uch)lc;
-#endif
+    if (s->lit_mem) {
+        s->d_buf[s->sym_next] = (ush)dist;
+        s->l_buf[s->sym_next++] = (uch)lc;
+    }
+    else {
+        s->sym_buf[s->sym_next++] = (uch)dist;
+        s->sym_buf[s->sym_next++] = (uch)(dist >> 8);
+        s->sym_buf[s->sym_next++] = (uch)lc;
+    }
     if (dist == 0) {
         /* lc is the unmatched char */
         s->dyn_ltree[lc].Freq++;
+        STAT(s, literals, 1);
     } else {
         s->matches++;
+        STAT(s, matches, 1);
         /* Here, lc is the match length - MIN_MATCH */
         dist--;             /* dist = match distance - 1 */
         Assert((ush)dist < (ush)MAX_DIST(s) &&
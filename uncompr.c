@@ -54,6 +54,9 @@ int ZEXPORT uncompress2(Bytef *dest, uLongf *destLen, const Bytef *source,
     stream.next_out = dest;
     stream.avail_out = 0;
 
+    /* once all of the input and output have been provided, use Z_FINISH, so
+       that inflate() resolves all distances in dest without allocating and
+       filling a sliding window */
     do {
         if (stream.avail_out == 0) {
             stream.avail_out = left > (uLong)max ? max : (uInt)left;
@@ -63,7 +66,7 @@ int ZEXPORT uncompress2(Bytef *dest, uLongf *destLen, const Bytef *source,
             stream.avail_in = len > (uLong)max ? max : (uInt)len;
             len -= stream.avail_in;
         }
-        err = inflate(&stream, Z_NO_FLUSH);
+        err = inflate(&stream, left || len ? Z_NO_FLUSH : Z_FINISH);
     } while (err == Z_OK);
 
     *sourceLen -= len + stream.avail_in;
@@ -29,6 +29,7 @@
 #  define adler32               z_adler32
 #  define adler32_combine       z_adler32_combine
 #  define adler32_combine64     z_adler32_combine64
+#  define adler32_combine_many  z_adler32_combine_many
 #  define adler32_z             z_adler32_z
 #  ifndef Z_SOLO
 #    define compress              z_compress
@@ -40,25 +41,51 @@
 #  define crc32_combine64       z_crc32_combine64
 #  define crc32_combine_gen     z_crc32_combine_gen
 #  define crc32_combine_gen64   z_crc32_combine_gen64
+#  define crc32_combine_many    z_crc32_combine_many
 #  define crc32_combine_op      z_crc32_combine_op
 #  define crc32_z               z_crc32_z
+#  define crc32_z_parallel      z_crc32_z_parallel
 #  define deflate               z_deflate
+#  define deflateAdaptive       z_deflateAdaptive
+#  define deflateBatch          z_deflateBatch
 #  define deflateBound          z_deflateBound
 #  define deflateCopy           z_deflateCopy
 #  define deflateEnd            z_deflateEnd
+#  define deflateFreeDictionary z_deflateFreeDictionary
 #  define deflateGetDictionary  z_deflateGetDictionary
+#  define deflateGetStats       z_deflateGetStats
+#  define deflateHash           z_deflateHash
 #  define deflateInit           z_deflateInit
 #  define deflateInit2          z_deflateInit2
 #  define deflateInit2_         z_deflateInit2_
+#  define deflateInitMem        z_deflateInitMem
+#  define deflateInitMem_       z_deflateInitMem_
 #  define deflateInit_          z_deflateInit_
+#  define deflateLatency        z_deflateLatency
+#  define deflateLitMem         z_deflateLitMem
+#  define deflateMemUsage       z_deflateMemUsage
+#  define deflateOptimize       z_deflateOptimize
+#  define deflateOutput         z_deflateOutput
+#  define deflateParallel       z_deflateParallel
+#  define deflateParallelEnd    z_deflateParallelEnd
+#  define deflateParallelInit   z_deflateParallelInit
+#  define deflateParallelInit2  z_deflateParallelInit2
+#  define deflateParallelInit2_ z_deflateParallelInit2_
+#  define deflateParallelParams z_deflateParallelParams
 #  define deflateParams         z_deflateParams
 #  define deflatePending        z_deflatePending
+#  define deflatePrepareDictionary z_deflatePrepareDictionary
 #  define deflatePrime          z_deflatePrime
 #  define deflateReset          z_deflateReset
 #  define deflateResetKeep      z_deflateResetKeep
+#  define deflateReuse          z_deflateReuse
 #  define deflateSetDictionary  z_deflateSetDictionary
 #  define deflateSetHeader      z_deflateSetHeader
+#  define deflateSizeParams     z_deflateSizeParams
+#  define deflateSplit          z_deflateSplit
+#  define deflateStateSize      z_deflateStateSize
 #  define deflateTune           z_deflateTune
+#  define deflateUseDictionary  z_deflateUseDictionary
 #  define deflateUsed           z_deflateUsed
 #  define deflate_copyright     z_deflate_copyright
 #  define get_crc_table         z_get_crc_table
@@ -67,10 +94,12 @@
 #    define gz_intmax             z_gz_intmax
 #    define gz_strwinerror        z_gz_strwinerror
 #    define gzbuffer              z_gzbuffer
+#    define gzbufferalign         z_gzbufferalign
 #    define gzclearerr            z_gzclearerr
 #    define gzclose               z_gzclose
 #    define gzclose_r             z_gzclose_r
 #    define gzclose_w             z_gzclose_w
+#    define gzconsume             z_gzconsume
 #    define gzdirect              z_gzdirect
 #    define gzdopen               z_gzdopen
 #    define gzeof                 z_gzeof
@@ -80,11 +109,14 @@
 #    define gzfwrite              z_gzfwrite
 #    define gzgetc                z_gzgetc
 #    define gzgetc_               z_gzgetc_
+#    define gzgetlines            z_gzgetlines
 #    define gzgets                z_gzgets
+#    define gzindex               z_gzindex
 #    define gzoffset              z_gzoffset
 #    define gzoffset64            z_gzoffset64
 #    define gzopen                z_gzopen
 #    define gzopen64              z_gzopen64
+#    define gzopen_funcs          z_gzopen_funcs
 #    ifdef _WIN32
 #      define gzopen_w              z_gzopen_w
 #    endif
@@ -92,39 +124,64 @@
 #    define gzputc                z_gzputc
 #    define gzputs                z_gzputs
 #    define gzread                z_gzread
+#    define gzreadahead           z_gzreadahead
+#    define gzreadview            z_gzreadview
 #    define gzrewind              z_gzrewind
 #    define gzseek                z_gzseek
 #    define gzseek64              z_gzseek64
 #    define gzsetparams           z_gzsetparams
+#    define gzsetthreads          z_gzsetthreads
 #    define gztell                z_gztell
 #    define gztell64              z_gztell64
 #    define gzungetc              z_gzungetc
 #    define gzvprintf             z_gzvprintf
 #    define gzwrite               z_gzwrite
+#    define gzwritebehind         z_gzwritebehind
+#    define gzwritev              z_gzwritev
 #  endif
 #  define inflate               z_inflate
 #  define inflateBack           z_inflateBack
 #  define inflateBackEnd        z_inflateBackEnd
 #  define inflateBackInit       z_inflateBackInit
 #  define inflateBackInit_      z_inflateBackInit_
+#  define inflateBatch          z_inflateBatch
+#  define inflateCheckpoint     z_inflateCheckpoint
 #  define inflateCodesUsed      z_inflateCodesUsed
 #  define inflateCopy           z_inflateCopy
 #  define inflateEnd            z_inflateEnd
+#  define inflateFreeDictionary z_inflateFreeDictionary
 #  define inflateGetDictionary  z_inflateGetDictionary
 #  define inflateGetHeader      z_inflateGetHeader
+#  define inflateGetStats       z_inflateGetStats
+#  define inflateIndexBuild     z_inflateIndexBuild
+#  define inflateIndexExtract   z_inflateIndexExtract
+#  define inflateIndexFree      z_inflateIndexFree
+#  define inflateIndexInfo      z_inflateIndexInfo
+#  define inflateIndexLoad      z_inflateIndexLoad
+#  define inflateIndexParallel  z_inflateIndexParallel
+#  define inflateIndexSave      z_inflateIndexSave
 #  define inflateInit           z_inflateInit
 #  define inflateInit2          z_inflateInit2
 #  define inflateInit2_         z_inflateInit2_
+#  define inflateInitMem        z_inflateInitMem
+#  define inflateInitMem_       z_inflateInitMem_
 #  define inflateInit_          z_inflateInit_
 #  define inflateMark           z_inflateMark
+#  define inflateMemUsage       z_inflateMemUsage
+#  define inflateParallel       z_inflateParallel
+#  define inflateParallel2      z_inflateParallel2
 #  define inflatePrime          z_inflatePrime
+#  define inflatePrepareDictionary z_inflatePrepareDictionary
 #  define inflateReset          z_inflateReset
 #  define inflateReset2         z_inflateReset2
 #  define inflateResetKeep      z_inflateResetKeep
+#  define inflateRestore        z_inflateRestore
 #  define inflateSetDictionary  z_inflateSetDictionary
+#  define inflateStateSize      z_inflateStateSize
 #  define inflateSync           z_inflateSync
 #  define inflateSyncPoint      z_inflateSyncPoint
 #  define inflateUndermine      z_inflateUndermine
+#  define inflateUseDictionary  z_inflateUseDictionary
 #  define inflateValidate       z_inflateValidate
 #  define inflate_copyright     z_inflate_copyright
 #  define inflate_fast          z_inflate_fast
@@ -138,7 +195,9 @@
 #    define zcalloc               z_zcalloc
 #    define zcfree                z_zcfree
 #  endif
+#  define zlibAllocCache        z_zlibAllocCache
 #  define zlibCompileFlags      z_zlibCompileFlags
+#  define zlibKernels           z_zlibKernels
 #  define zlibVersion           z_zlibVersion
 
 /* all zlib typedefs in zlib.h and zconf.h */
@@ -150,11 +209,17 @@
 #  ifndef Z_SOLO
 #    define gzFile                z_gzFile
 #  endif
+#  define gz_close_func         z_gz_close_func
 #  define gz_header             z_gz_header
 #  define gz_headerp            z_gz_headerp
+#  define gz_iovec              z_gz_iovec
+#  define gz_read_func          z_gz_read_func
+#  define gz_seek_func          z_gz_seek_func
+#  define gz_write_func         z_gz_write_func
 #  define in_func               z_in_func
 #  define intf                  z_intf
 #  define out_func              z_out_func
+#  define seek_func             z_seek_func
 #  define uInt                  z_uInt
 #  define uIntf                 z_uIntf
 #  define uLong                 z_uLong
@@ -165,6 +230,7 @@
 
 /* all zlib structs in zlib.h and zconf.h */
 #  define gz_header_s           z_gz_header_s
+#  define gz_iovec_s            z_gz_iovec_s
 #  define internal_state        z_internal_state
 
 #endif
@@ -289,6 +355,10 @@
    The memory requirements for inflate are (in bytes) 1 << windowBits
  that is, 32K for windowBits=15 (default value) plus about 7 kilobytes
  for small objects.
+
+   The exact amounts for a stream are returned by deflateMemUsage() and
+ inflateMemUsage(), and for given parameters by deflateStateSize() and
+ inflateStateSize().
 */
 
                         /* Type declarations */
@@ -0,0 +1,144 @@
+/* zcpu.c -- processor features for the compression library
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* @(#) $Id$ */
+
+#include "zcpu.h"
+
+#ifdef X86_SIMD
+#  include <cpuid.h>
+#endif
+#if defined(__aarch64__) && !defined(Z_SOLO)
+#  if defined(__linux__)
+#    include <sys/auxv.h>
+#    ifndef HWCAP_PMULL
+#      define HWCAP_PMULL (1 << 4)
+#    endif
+#    ifndef HWCAP_CRC32
+#      define HWCAP_CRC32 (1 << 7)
+#    endif
+#  elif defined(__APPLE__)
+#    include <sys/sysctl.h>
+#  endif
+#endif
+
+/* ========================================================================= */
+#if defined(__STDC__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+
+void ZLIB_INTERNAL z_once(z_once_t *state, void (*init)(void)) {
+    if (!atomic_load(&state->done)) {
+        if (atomic_flag_test_and_set(&state->begun))
+            while (!atomic_load(&state->done))
+                ;
+        else {
+            init();
+            atomic_store(&state->done, 1);
+        }
+    }
+}
+
+#else   /* no atomics */
+
+/* Test and set. Alas, not atomic, but tries to minimize the period of
+   vulnerability. */
+local int test_and_set(int volatile *flag) {
+    int was;
+
+    was = *flag;
+    *flag = 1;
+    return was;
+}
+
+void ZLIB_INTERNAL z_once(z_once_t *state, void (*init)(void)) {
+    if (!state->done) {
+        if (test_and_set(&state->begun))
+            while (!state->done)
+                ;
+        else {
+            init();
+            state->done = 1;
+        }
+    }
+}
+
+#endif
+
+/* ========================================================================= */
+local z_once_t detected = Z_ONCE_INIT;
+local unsigned features;
+
+#if defined(__APPLE__) && defined(__aarch64__) && !defined(Z_SOLO)
+/* Return true if the named sysctl flag is present and set. */
+local int apple_has(const char *name) {
+    int has = 0;
+    size_t size = sizeof(has);
+
+    return sysctlbyname(name, &has, &size, NULL, 0) == 0 && has;
+}
+#endif
+
+/* Fill in features for this processor. An instruction set that the compiler
+   was told to assume is reported even if it can't be checked at run time. */
+local void detect(void) {
+    unsigned f = 0;
+#ifdef X86_SIMD
+    unsigned eax, ebx, ecx, edx, xcr0 = 0, ebx7 = 0, ecx7 = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        if (ecx & 0x200)
+            f |= ZCPU_SSSE3;
+        if (ecx & 0x100000)
+            f |= ZCPU_SSE42;
+        if (ecx & 2)
+            f |= ZCPU_PCLMUL;
+        if (ecx & 0x8000000) {      /* OSXSAVE, so xgetbv is available */
+            unsigned hi;
+
+            __asm__("xgetbv" : "=a"(xcr0), "=d"(hi) : "c"(0));
+        }
+        if (__get_cpuid_max(0, Z_NULL) >= 7)
+            __cpuid_count(7, 0, eax, ebx7, ecx7, edx);
+        if ((ecx & 0x10000000) && (xcr0 & 6) == 6 && (ebx7 & 0x20))
+            f |= ZCPU_AVX2;
+        if ((xcr0 & 0xe6) == 0xe6 && (ebx7 & 0x40010000) == 0x40010000) {
+            f |= ZCPU_AVX512;
+            if ((ecx7 & 0x400) && (f & ZCPU_PCLMUL))
+                f |= ZCPU_VPCLMUL;
+        }
+    }
+#endif
+#ifdef __aarch64__
+#  ifdef __ARM_FEATURE_CRC32
+    f |= ZCPU_ARMCRC32;
+#  endif
+#  if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+    f |= ZCPU_PMULL;
+#  endif
+#  ifndef Z_SOLO
+#    if defined(__linux__)
+    {
+        unsigned long hwcap = getauxval(AT_HWCAP);
+
+        if (hwcap & HWCAP_CRC32)
+            f |= ZCPU_ARMCRC32;
+        if (hwcap & HWCAP_PMULL)
+            f |= ZCPU_PMULL;
+    }
+#    elif defined(__APPLE__)
+    if (apple_has("hw.optional.armv8_crc32"))
+        f |= ZCPU_ARMCRC32;
+    if (apple_has("hw.optional.arm.FEAT_PMULL"))
+        f |= ZCPU_PMULL;
+#    endif
+#  endif
+#endif
+    features = f;
+}
+
+unsigned ZLIB_INTERNAL zcpu_features(void) {
+    z_once(&detected, detect);
+    return features;
+}
@@ -0,0 +1,71 @@
+/* zcpu.h -- internal interface to processor features for the compression
+ * library
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef ZCPU_H
+#define ZCPU_H
+
+#include "zutil.h"
+
+/*
+  Definition of once functionality, depending on the availability of atomics.
+  If atomics are not available, and the library will be used in multiple
+  threads, then zlibKernels() must be called and must return before any threads
+  are allowed to use the library, so that the processor features and kernel
+  selections are made. The same applies to get_crc_table() if the library is
+  compiled with DYNAMIC_CRC_TABLE defined.
+ */
+#if defined(__STDC__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+#  include <stdatomic.h>
+   /* Structure for z_once(), which must be initialized with Z_ONCE_INIT. */
+   typedef struct {
+       atomic_flag begun;
+       atomic_int done;
+   } z_once_t;
+#  define Z_ONCE_INIT {ATOMIC_FLAG_INIT, 0}
+#else
+   /* Structure for z_once(), which must be initialized with Z_ONCE_INIT. */
+   typedef struct {
+       volatile int begun;
+       volatile int done;
+   } z_once_t;
+#  define Z_ONCE_INIT {0, 0}
+#endif
+
+/* Run the provided init() function exactly once, even if multiple threads
+   invoke z_once() at the same time. Without atomics, this is not thread-safe.
+ */
+void ZLIB_INTERNAL z_once(z_once_t *state, void (*init)(void));
+
+/* Processor features detected at run time. The x86 vector features are only
+   reported if the operating system saves the associated registers. AVX512
+   means both AVX512F and AVX512BW, and VPCLMUL means AVX512 with VPCLMULQDQ
+   and PCLMULQDQ. */
+#define ZCPU_SSSE3      0x001
+#define ZCPU_SSE42      0x002
+#define ZCPU_PCLMUL     0x004
+#define ZCPU_AVX2       0x008
+#define ZCPU_AVX512     0x010
+#define ZCPU_VPCLMUL    0x020
+#define ZCPU_ARMCRC32   0x100
+#define ZCPU_PMULL      0x200
+
+/* Return the ZCPU_* features of this processor, determined on first use. */
+unsigned ZLIB_INTERNAL zcpu_features(void);
+
+/* Return the name of the kernel used by each module for long buffers. */
+const char ZLIB_INTERNAL *crc32_kernel(void);
+const char ZLIB_INTERNAL *adler32_kernel(void);
+const char ZLIB_INTERNAL *longest_match_kernel(void);
+const char ZLIB_INTERNAL *slide_hash_kernel(void);
+const char ZLIB_INTERNAL *inflate_copy_kernel(void);
+
+#endif /* ZCPU_H */
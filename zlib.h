@@ -80,6 +80,9 @@ extern "C" {
 
 typedef voidpf (*alloc_func)(voidpf opaque, uInt items, uInt size);
 typedef void   (*free_func)(voidpf opaque, voidpf address);
+typedef unsigned (*in_func)(void FAR *,
+                            z_const unsigned char FAR * FAR *);
+typedef int (*out_func)(void FAR *, unsigned char FAR *, unsigned);
 
 struct internal_state;
 
@@ -130,6 +133,71 @@ typedef struct gz_header_s {
 
 typedef gz_header FAR *gz_headerp;
 
+/*
+     One of many independent streams compressed or decompressed in a single
+  call to deflateBatch() or inflateBatch().  The input and output fields are
+  updated as deflate() and inflate() update them in z_stream.
+*/
+typedef struct z_batch_s {
+    z_const Bytef *next_in; /* complete input for this stream */
+    uInt     avail_in;  /* number of bytes available at next_in */
+    Bytef    *next_out; /* output for this stream will go here */
+    uInt     avail_out; /* remaining free space at next_out */
+    int      status;    /* result for this stream, set on return */
+} z_batch;
+
+typedef z_batch FAR *z_batchp;
+
+/*
+     Counts of what deflate has done, returned by deflateGetStats() when zlib
+  is compiled with DEFLATE_STATS defined.
+*/
+typedef struct z_deflate_stats_s {
+    uLong   searches;       /* searches of the hash chains for matches */
+    uLong   chain_steps;    /* strings compared on the hash chains */
+    uLong   literals;       /* literals emitted */
+    uLong   matches;        /* matches emitted */
+    uLong   lazy_wins;      /* matches dropped for a longer next one */
+    uLong   stored_blocks;  /* stored blocks emitted */
+    uLong   static_blocks;  /* blocks emitted with the fixed codes */
+    uLong   dynamic_blocks; /* blocks emitted with dynamic codes */
+    uLong   block_bytes;    /* uncompressed bytes in all blocks */
+    uLong   slides;         /* slides of the hash tables */
+    uLong   fills;          /* reads of input into the window */
+} z_deflate_stats;
+
+/*
+     A preset dictionary prepared once by deflatePrepareDictionary(), which can
+  then be used by any number of deflate streams at the same time.  Its contents
+  are private to zlib.
+*/
+typedef struct z_deflate_dict_s FAR *z_deflate_dictp;
+
+/*
+     A preset dictionary prepared once by inflatePrepareDictionary(), which
+  inflate streams reference, without copying it, for as long as it can be
+  reached.  It can be used by any number of streams at the same time.  Its
+  contents are private to zlib.
+*/
+typedef struct z_inflate_dict_s FAR *z_inflate_dictp;
+
+/*
+     Counts of what inflate has done, returned by inflateGetStats() when zlib
+  is compiled with INFLATE_STATS defined.
+*/
+typedef struct z_inflate_stats_s {
+    uLong   fast_bytes;     /* bytes decoded by the fast loop */
+    uLong   slow_bytes;     /* bytes decoded a code at a time by inflate() */
+    uLong   stored_bytes;   /* bytes copied from stored blocks */
+    uLong   fast_calls;     /* entries into the fast loop */
+    uLong   tables;         /* code tables built for dynamic blocks */
+    uLong   window_copies;  /* updates of the sliding window */
+    uLong   window_bytes;   /* bytes copied to the sliding window */
+    uLong   stored_blocks;  /* stored blocks decoded */
+    uLong   fixed_blocks;   /* blocks decoded with the fixed codes */
+    uLong   dynamic_blocks; /* blocks decoded with dynamic codes */
+} z_inflate_stats;
+
 /*
      The application must update next_in and avail_in when avail_in has dropped
    to zero.  It must update next_out and avail_out when avail_out has dropped
@@ -197,9 +265,14 @@ typedef gz_header FAR *gz_headerp;
 #define Z_HUFFMAN_ONLY        2
 #define Z_RLE                 3
 #define Z_FIXED               4
+#define Z_QUICK               5
 #define Z_DEFAULT_STRATEGY    0
 /* compression strategy; see deflateInit2() below for details */
 
+#define Z_HASH_ROLLING        0
+#define Z_HASH_CRC32C         1
+/* string hash functions; see deflateHash() below for details */
+
 #define Z_BINARY   0
 #define Z_TEXT     1
 #define Z_ASCII    Z_TEXT   /* for compatibility with 1.2.2 and earlier */
@@ -232,11 +305,16 @@ ZEXTERN int ZEXPORT deflateInit(z_streamp strm, int level);
    zalloc and zfree are set to Z_NULL, deflateInit updates them to use default
    allocation functions.  total_in, total_out, adler, and msg are initialized.
 
-     The compression level must be Z_DEFAULT_COMPRESSION, or between 0 and 9:
-   1 gives best speed, 9 gives best compression, 0 gives no compression at all
-   (the input data is simply copied a block at a time).  Z_DEFAULT_COMPRESSION
-   requests a default compromise between speed and compression (currently
-   equivalent to level 6).
+     The compression level must be Z_DEFAULT_COMPRESSION, or between 0 and
+   12: 1 gives best speed, 9 gives best compression at a moderate speed, 0
+   gives no compression at all (the input data is simply copied a block at a
+   time).  Z_DEFAULT_COMPRESSION requests a default compromise between speed
+   and compression (currently equivalent to level 6).  Levels 10 through 12
+   choose the matches and literals with an iterative optimal parse, for a few
+   percent better compression than level 9 at ten to fifty times the
+   compression time (see deflateOptimize()), for data that is compressed once
+   and decompressed many times.  The compressed data is decompressed by
+   inflate() as for any level.
 
      deflateInit returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if level is not a valid compression level, or
@@ -601,7 +679,14 @@ ZEXTERN int ZEXPORT deflateInit2(z_streamp strm,
    never the correctness of the compressed output, even if it is not set
    optimally for the given data.  Z_FIXED uses the default string matching, but
    prevents the use of dynamic Huffman codes, allowing for a simpler decoder
-   for special applications.
+   for special applications.  Z_QUICK trades compression for speed, for when
+   latency matters more than size: only the most recent string with the same
+   hash is checked for a match, and the matches and literals are sent directly
+   as fixed-code blocks, without collecting them to construct Huffman codes.
+   Z_QUICK is typically one and a half to two times as fast as level 1 with
+   Z_DEFAULT_STRATEGY, but since fixed codes are used, the compressed data can
+   be a third again as large.  The level has no effect on Z_QUICK compression,
+   except that level 0 still only stores.
 
      deflateInit2 returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if any parameter is invalid (such as an invalid
@@ -677,6 +762,52 @@ ZEXTERN int ZEXPORT deflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+ZEXTERN z_deflate_dictp ZEXPORT deflatePrepareDictionary(z_streamp strm,
+                                               const Bytef *dictionary,
+                                               uInt  dictLength);
+/*
+     Prepare the dictionary once for use by many deflate streams with
+   deflateUseDictionary(), instead of having deflateSetDictionary() insert all
+   of it into the hash tables again for every stream.  strm must be a deflate
+   stream initialized, or reset, with the windowBits, memLevel, and hash
+   function (see deflateHash()) of the streams that will use the dictionary,
+   and on which deflate() has not yet been called.  strm is left as it was,
+   so it can then be used as one of those streams.  The memory for the
+   prepared dictionary is allocated with strm's zalloc, so it cannot be a
+   stream initialized with deflateInitMem().
+
+     The prepared dictionary is not changed by its use, so it can be shared by
+   streams in different threads.  It is about the same size as the window and
+   hash tables of strm, and it must be freed with deflateFreeDictionary()
+   once no streams are using it.
+
+     deflatePrepareDictionary returns the prepared dictionary, or Z_NULL if
+   there was not enough memory, if strm was not a fresh deflate stream, or if
+   it was a gzip stream, which cannot use a dictionary.
+*/
+
+ZEXTERN int ZEXPORT deflateUseDictionary(z_streamp strm,
+                                         z_deflate_dictp dict);
+/*
+     Set the dictionary of strm to one prepared by deflatePrepareDictionary(),
+   with the same result as calling deflateSetDictionary() with that
+   dictionary, but by only copying the prepared window and hash tables.  The
+   same restrictions apply.  In addition, it must be called before the first
+   deflate() call of the stream, after deflateInit(), deflateInit2(), or
+   deflateReset(), and strm must have the windowBits, memLevel, and hash
+   function of the stream the dictionary was prepared with.
+
+     deflateUseDictionary returns Z_OK on success, or Z_STREAM_ERROR if a
+   parameter is invalid, if the stream does not match the dictionary, or if
+   deflate() has already been called for the stream.
+*/
+
+ZEXTERN void ZEXPORT deflateFreeDictionary(z_deflate_dictp dict);
+/*
+     Free a dictionary returned by deflatePrepareDictionary().  dict may be
+   Z_NULL, in which case nothing is done.
+*/
+
 ZEXTERN int ZEXPORT deflateCopy(z_streamp dest,
                                 z_streamp source);
 /*
@@ -706,6 +837,28 @@ ZEXTERN int ZEXPORT deflateReset(z_streamp strm);
    stream state was inconsistent (such as zalloc or state being Z_NULL).
 */
 
+ZEXTERN int ZEXPORT deflateBatch(z_streamp strm, z_batchp batch, unsigned n);
+/*
+     deflateBatch() compresses n independent streams, one for each entry of
+   batch[], reusing the compression state in strm.  Each stream is compressed
+   as if by deflateReset() followed by a single deflate() call with Z_FINISH,
+   so the entry must provide all of its input, and should provide at least
+   deflateBound() bytes of output space.  The level, strategy, and wrapper
+   set for strm apply to every stream.  This saves allocating and
+   initializing a new state for each of many small streams.  For streams of a
+   few kilobytes, a smaller windowBits and memLevel in deflateInit2() reduce
+   the memory cleared for each stream, at some cost in compression.
+
+     On return, the input and output fields of each entry are updated as
+   deflate() would update them, and status is set to Z_OK if the stream was
+   completed, or to Z_BUF_ERROR if there was not enough output space.
+
+     deflateBatch returns Z_OK once all of the entries have been processed,
+   whatever their status, or Z_STREAM_ERROR if the stream state was
+   inconsistent or if batch is Z_NULL and n is not zero.  strm is left as
+   after the last stream, ready for deflateReset().
+*/
+
 ZEXTERN int ZEXPORT deflateParams(z_streamp strm,
                                   int level,
                                   int strategy);
@@ -716,16 +869,22 @@ ZEXTERN int ZEXPORT deflateParams(z_streamp strm,
    to switch to a different kind of input data requiring a different strategy.
    If the compression approach (which is a function of the level) or the
    strategy is changed, and if there have been any deflate() calls since the
-   state was initialized or reset, then the input available so far is
-   compressed with the old level and strategy using deflate(strm, Z_BLOCK).
-   There are three approaches for the compression levels 0, 1..3, and 4..9
-   respectively.  The new level and strategy will take effect at the next call
-   of deflate().
-
-     If a deflate(strm, Z_BLOCK) is performed by deflateParams(), and it does
-   not have enough output space to complete, then the parameter change will not
-   take effect.  In this case, deflateParams() can be called again with the
-   same parameters and more output space to try again.
+   state was initialized or reset, then the change is made at a deflate block
+   boundary.  There are five approaches for the compression levels 0, 1..3,
+   4..5, 6..9, and 10..12 respectively.  When switching among the levels 1..12
+   and the strategies other than Z_QUICK, deflate() continues with the old
+   level and strategy until the current deflate block is complete, and then
+   uses the new level and strategy for the following blocks.  No block is cut
+   short for the change.  A pending change is replaced by a later
+   deflateParams() call, and is applied by deflateReset().
+
+     When switching to or from level 0 or Z_QUICK, the input available so far
+   is instead compressed with the old level and strategy using
+   deflate(strm, Z_BLOCK), and the new level and strategy will take effect at
+   the next call of deflate().  If that deflate(strm, Z_BLOCK) does not have
+   enough output space to complete, then the parameter change will not take
+   effect.  In this case, deflateParams() can be called again with the same
+   parameters and more output space to try again.
 
      In order to assure a change in the parameters on the first try, the
    deflate stream should be flushed using deflate() with Z_BLOCK or other flush
@@ -738,8 +897,8 @@ ZEXTERN int ZEXPORT deflateParams(z_streamp strm,
      deflateParams returns Z_OK on success, Z_STREAM_ERROR if the source stream
    state was inconsistent or if a parameter was invalid, or Z_BUF_ERROR if
    there was not enough output space to complete the compression of the
-   available input data before a change in the strategy or approach.  Note that
-   in the case of a Z_BUF_ERROR, the parameters are not changed.  A return
+   available input data before a change to or from level 0 or Z_QUICK.  Note
+   that in the case of a Z_BUF_ERROR, the parameters are not changed.  A return
    value of Z_BUF_ERROR is not fatal, in which case deflateParams() can be
    retried with more output space.
 */
@@ -761,6 +920,239 @@ ZEXTERN int ZEXPORT deflateTune(z_streamp strm,
    returns Z_OK on success, or Z_STREAM_ERROR for an invalid deflate stream.
  */
 
+ZEXTERN int ZEXPORT deflateOptimize(z_streamp strm,
+                                    int iterations,
+                                    uLong memory);
+/*
+     Set the effort of the optimal parsing done by compression levels 10
+   through 12.  The input is parsed in segments.  For each segment, the matches
+   at every position are found once, and then each of iterations passes
+   chooses the path of literals and matches with the least total cost in bits,
+   using the Huffman codes that resulted from the previous pass.  The passes
+   stop early if one chooses the same path as the one before it.  The defaults
+   are 2, 5, and 15 passes for levels 10, 11, and 12.  The time to find the
+   matches is set by the max_chain and nice_length parameters of deflateTune(),
+   which default to 1024, 4096, and 8192, and 258.
+
+     memory is the most memory in bytes to use for the parsing, which sets the
+   length of the segments.  If memory is zero, the segments are as long as the
+   symbol buffer set by memLevel allows, which uses about 34 bytes per input
+   byte in a segment, e.g. 557K for the default memLevel of 8.  That memory
+   is allocated by deflateInit2() or deflateParams() when a level above 9 is
+   first requested.  Less memory makes shorter segments, down to a minimum of
+   1024 bytes, and compresses slightly less.  A call of deflateParams() resets
+   iterations to the default for the new level, but retains memory.
+
+     deflateOptimize() can be called after deflateInit2() or between deflate()
+   calls, and can be called for a level under 10 to take effect when the level
+   is changed by deflateParams().  deflateOptimize returns Z_OK on success,
+   Z_MEM_ERROR if there was not enough memory, or Z_STREAM_ERROR if the stream
+   state was inconsistent or iterations is less than one.
+*/
+
+ZEXTERN int ZEXPORT deflateGetStats(z_streamp strm,
+                                    z_deflate_stats *stats);
+/*
+     deflateGetStats() copies to *stats the counts of the work done by deflate
+   since deflateInit2() or the last deflateReset(), to help with choosing the
+   deflateTune() parameters for the data being compressed.  The average number
+   of chain_steps per search shows how long the hash chains walked are, and
+   lazy_wins / matches shows how often the lazy evaluation of levels 4
+   through 9 pays off.  The stored block count includes the empty stored
+   blocks that mark Z_SYNC_FLUSH and Z_FULL_FLUSH, and block_bytes divided by
+   the total number of blocks is the average uncompressed block size.  The
+   counts wrap around if they exceed the range of uLong.
+
+     The counting is only compiled when zlib is built with DEFLATE_STATS
+   defined, so that there is no cost otherwise.  Whether it was can be
+   determined using zlibCompileFlags().
+
+     deflateGetStats returns Z_OK on success, Z_STREAM_ERROR if the stream
+   state was inconsistent or stats is Z_NULL, or Z_VERSION_ERROR if zlib was
+   compiled without DEFLATE_STATS, in which case the counts are set to zero.
+*/
+
+ZEXTERN int ZEXPORT deflateHash(z_streamp strm,
+                                int hash);
+/*
+     Select the hash function used by deflate to find candidate matching
+   strings.  The default, Z_HASH_ROLLING, is the running hash of three bytes
+   that zlib has always used.  Z_HASH_CRC32C hashes four bytes using CRC-32C,
+   which gives shorter hash chains on structured data such as JSON or CSV, and
+   lets successive hashes be computed independently.  The CRC-32C instruction
+   is used if the processor has it (SSE4.2 on x86, or the CRC extension on ARM
+   when zlib is compiled for it), else it is computed with a table.  The
+   compressed data is the same either way, but is not the same as with
+   Z_HASH_ROLLING.  Z_HASH_CRC32C will not find matches of length three, so
+   the compression ratio can be slightly lower for some data.
+
+     deflateHash() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before deflateSetDictionary() or the first call of
+   deflate() with input.  The selection is retained by deflateReset().
+
+     deflateHash returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state was inconsistent, if hash is not a valid value, or if input has
+   already been provided.
+*/
+
+ZEXTERN int ZEXPORT deflateLitMem(z_streamp strm,
+                                  int lit_mem);
+/*
+     Select how deflate buffers the literals and matches of a block before
+   coding them.  If lit_mem is true, separate distance and literal/length
+   buffers are used, which makes deflate slightly faster (order 1% to 2%), but
+   uses lit_bufsize (16K at the default memLevel) more bytes of memory.  If
+   lit_mem is false, they are packed into one buffer, three bytes per symbol.
+   The default is false, unless zlib was compiled with LIT_MEM defined.  The
+   compressed data is the same either way.
+
+     deflateLitMem() must be called when no symbols or output are pending, e.g.
+   after deflateInit(), deflateInit2(), or deflateReset(), or after a deflate()
+   call that flushed all of its output with Z_SYNC_FLUSH, Z_FULL_FLUSH, or
+   Z_FINISH.  The selection is retained by deflateReset().  If the stream was
+   initialized with deflateInitMem(), then selecting the separate buffers will
+   fail unless the default was already to use them, since the memory provided
+   is sized for the default.
+
+     deflateLitMem returns Z_OK on success, Z_MEM_ERROR if there was not enough
+   memory for the separate buffers, or Z_STREAM_ERROR if the stream state was
+   inconsistent or if symbols or output are pending.
+*/
+
+ZEXTERN int ZEXPORT deflateAdaptive(z_streamp strm,
+                                    int adaptive);
+/*
+     If adaptive is true, let deflate pass quickly over regions of the input
+   that look like they are already compressed or are encrypted, such as JPEG
+   images or encrypted segments in a stream that is otherwise text.  At the
+   end of each block, deflate looks at how much its matches saved and at how
+   evenly spread the values of its last bytes are.  If the matches saved
+   little and the bytes look random, then the input that follows is copied to
+   stored blocks without looking for matches, at close to the speed of a copy.
+   If the bytes are less evenly spread, then they are Huffman coded as with
+   Z_HUFFMAN_ONLY.  deflate returns to looking for matches when the spread of
+   the bytes drops, and also every so often in order to check that there are
+   still none to be had, at intervals that double while the region goes on.
+   This applies to levels 1 through 12 with Z_DEFAULT_STRATEGY or Z_FILTERED.
+
+     The compressed data is valid deflate data either way.  It can be a little
+   larger than without adaptive, if matches are missed in a region, or much
+   faster to make for input with large incompressible regions.  The default is
+   false.  deflateAdaptive() can be called at any time, with a switch back to
+   looking for matches made at the end of the current block.  The selection
+   is retained by deflateReset().
+
+     deflateAdaptive returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT deflateSplit(z_streamp strm,
+                                 int split);
+/*
+     If split is true, let deflate end blocks early where the statistics of
+   the data change.  Normally a block ends when deflate's buffer of literals
+   and matches fills, so that input whose makeup shifts in the middle of a
+   block, such as text followed by a table of numbers, is coded with one set of
+   Huffman codes that fits neither part well.  With split true, the literals
+   and matches of each full block are divided into eight equal segments, and
+   the block is written as the run of blocks made of whole segments that takes
+   the fewest bits, counting the cost of the code descriptions of the extra
+   blocks.  That is often just the one block.  This applies to levels 1
+   through 12 with any strategy other than Z_FIXED, and costs some time at the
+   end of each block to build the trial codes.
+
+     The compressed data is the same size or smaller, save perhaps for a few
+   bits from rounding the stored block estimates, and can be several percent
+   smaller for mixed data.  The default is false.
+   deflateSplit() can be called at any time, and takes effect at the end of
+   the current block.  The selection is retained by deflateReset().
+
+     deflateSplit returns Z_OK on success, Z_MEM_ERROR if there was not enough
+   memory for the working space, which is about 8K bytes, or Z_STREAM_ERROR if
+   the stream state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT deflateReuse(z_streamp strm,
+                                 int reuse);
+/*
+     If reuse is true, let deflate use Huffman codes saved from earlier blocks
+   for a block with similar statistics, instead of building new codes for it.
+   This is meant for streams that are flushed often, such as with a
+   Z_SYNC_FLUSH after each message of a chatty protocol, where building the
+   codes for each small block is a large part of the time spent.  The saved
+   codes are built from the counts of the symbols in recent blocks, and are
+   rebuilt when a block has a symbol they have no code for.  Every so often a
+   block is also given codes of its own, to check that the saved codes, or the
+   fixed codes when those are better, do about as well.  The more checks they
+   pass, the more blocks in a row are coded without building new codes.
+
+     The deflate format requires every dynamic block to describe its codes, so
+   a block coded with the saved codes still carries that description, but it
+   is not computed again.  The compressed data can be slightly larger than
+   without reuse, up to a few percent for blocks of a few K bytes, since the
+   saved codes are not the best for each block.  The default is false.
+   deflateReuse() can be called at any time.  The selection and the saved
+   codes are retained by deflateReset() and copied by deflateCopy().
+
+     deflateReuse returns Z_OK on success, Z_MEM_ERROR if there was not enough
+   memory for the saved codes, which take about 3.5K bytes, or Z_STREAM_ERROR
+   if the stream state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT deflateLatency(z_streamp strm,
+                                   uLong bytes,
+                                   uLong usec,
+                                   int flush);
+/*
+     Bound how long input can wait in deflate before the output it makes can
+   be decompressed.  If bytes is not zero, then deflate() ends a block with
+   the given flush, which is Z_BLOCK, Z_PARTIAL_FLUSH, Z_SYNC_FLUSH, or
+   Z_FULL_FLUSH, after every bytes bytes of input since the last such flush,
+   as if the input had been cut there and given to deflate() with that flush.
+   If usec is not zero, then deflate() also does that when the first input
+   taken since the last flush was taken usec microseconds ago or more.  A flush
+   requested by the application counts as an emit, and so does the end of the
+   stream.  bytes and usec both zero turn this off, which is the default.
+
+     The time is checked only when deflate() is called, since deflate has no
+   thread of its own, so an application that wants waiting input to go out on
+   time should call deflate() now and then even when it has no new input,
+   such as with avail_in zero and Z_NO_FLUSH.  The emitted output lands in
+   next_out as usual, or goes to the deflateOutput() function if there is
+   one.  If avail_out runs out in the middle of an emit, the next call of
+   deflate() completes it before taking more input.
+
+     deflateLatency() can be called at any time, and is retained by
+   deflateReset(), which restarts the count.  deflateLatency returns Z_OK on
+   success, or Z_STREAM_ERROR if the stream state was inconsistent, flush is
+   not one of the four allowed values, or usec is not zero and there is no
+   clock available on this system.
+*/
+
+ZEXTERN int ZEXPORT deflateOutput(z_streamp strm,
+                                  out_func out,
+                                  void FAR *out_desc);
+/*
+     Set a function for deflate() to push its output to, so that the
+   application does not need to empty next_out and check avail_out after each
+   call.  With out not Z_NULL, deflate() calls out(out_desc, buf, len) with the
+   compressed data it wrote to the next_out space, whenever that space fills
+   and before it returns, and then points next_out and avail_out back at the
+   whole space.  The space given to deflate() in next_out and avail_out can
+   then be the same for every call, and deflate() takes all of the input it is
+   given, returning with avail_in zero and avail_out unchanged.  When used
+   with deflateLatency(), each emitted block is pushed as soon as it is made.
+   out() returns zero on success, or not zero to stop deflate(), which then
+   returns Z_BUF_ERROR, with next_in and avail_in updated for the input taken.
+   The output given to the failed out() call is dropped, and the stream
+   cannot be continued.  out equal to Z_NULL turns this off, which is the
+   default.
+
+     deflateOutput() can be called at any time, and is retained by
+   deflateReset().  deflateOutput returns Z_OK on success, or Z_STREAM_ERROR
+   if the stream state was inconsistent.
+*/
+
 ZEXTERN uLong ZEXPORT deflateBound(z_streamp strm,
                                    uLong sourceLen);
 /*
@@ -776,6 +1168,84 @@ ZEXTERN uLong ZEXPORT deflateBound(z_streamp strm,
    than Z_FINISH or Z_NO_FLUSH are used.
 */
 
+ZEXTERN int ZEXPORT deflateSizeParams(uLong sourceLen, int *windowBits,
+                                      int *memLevel);
+/*
+     deflateSizeParams() reduces the deflateInit2() parameters *windowBits and
+   *memLevel to the smallest values that still let deflate find matches back to
+   the start of sourceLen bytes of input, and compress all of it in one block.
+   This is for streams of short messages, where the default window, hash
+   table, and symbol buffers are much larger than a message, and so take much
+   more time to allocate and clear than it takes to compress the message.  For
+   example, for messages of up to 4000 bytes, windowBits 15 and memLevel 8 are
+   reduced to 13 and 6, which uses about 70K of memory instead of 262K.
+   *windowBits can be negative or more than 15 as for deflateInit2(), and the
+   same kind of value is returned.  The values are never increased.  The
+   results can also be used for deflateStateSize() and deflateInitMem().  The
+   compressed data may differ slightly from that with the original values,
+   since the smaller hash table groups more strings on each hash chain.
+
+     A stream with the reduced parameters can still compress more than
+   sourceLen bytes, but then with a shorter reach back for matches, and in
+   more blocks, than with the original parameters.  For the zlib format, the
+   smaller window size is written in the header, which reduces the memory
+   needed by inflate.
+
+     deflateSizeParams returns Z_OK on success, or Z_STREAM_ERROR if
+   windowBits or memLevel is Z_NULL, or if *windowBits or *memLevel is not
+   valid for deflateInit2().
+*/
+
+ZEXTERN uLong ZEXPORT deflateStateSize(int level, int windowBits,
+                                       int memLevel, int strategy);
+/*
+     deflateStateSize() returns the number of bytes of memory that
+   deflateInitMem() needs for a stream with the given parameters, which are as
+   for deflateInit2().  That includes room to align the start of the memory on
+   a 64-byte boundary if it is not already.  deflateStateSize() returns zero if
+   the parameters are invalid.
+*/
+
+ZEXTERN uLong ZEXPORT deflateMemUsage(z_streamp strm);
+/*
+     deflateMemUsage() returns the number of bytes of memory allocated for the
+   state of strm, including the window, hash tables, and symbol buffers, as
+   well as the memory for levels 10 through 12 or for deflateLitMem() if it has
+   been allocated.  This is what deflateStateSize() returns for the same
+   parameters, less its room for alignment.  It does not include the memory
+   for a dictionary from deflatePrepareDictionary(), which is allocated
+   separately.  deflateMemUsage() returns zero if the stream state is
+   inconsistent, or if the stream was initialized for deflateParallel().
+*/
+
+/*
+ZEXTERN int ZEXPORT deflateInitMem(z_streamp strm, int level,
+                                   int windowBits, int memLevel,
+                                   int strategy, voidpf mem, uLong size);
+
+     This is another version of deflateInit2 with the method Z_DEFLATED, where
+   all of the memory for the compression state is taken from the size bytes at
+   mem, as one block, instead of being allocated by zalloc.  size must be at
+   least the value returned by deflateStateSize() for the same parameters.
+   Each of the parts of the state is placed on a 64-byte boundary, to align
+   them with cache lines.  zalloc, zfree, and opaque are set by
+   deflateInitMem() to use the block, and must not be changed by the
+   application.  The memory at mem must not be used for anything else until
+   deflateEnd() is called, after which it can be used again, for example for
+   another deflateInitMem().
+
+     deflateCopy() cannot copy a stream initialized with deflateInitMem(), and
+   will return Z_MEM_ERROR.  deflateInitMem() cannot be used with
+   deflateParallel().  The memory for the optimal parsing of levels 10 through
+   12 is included only if one of those levels is given here, so a later
+   deflateParams() to such a level may return Z_MEM_ERROR.
+
+     deflateInitMem returns Z_OK if success, Z_MEM_ERROR if size is less than
+   deflateStateSize(), Z_STREAM_ERROR if a parameter is invalid or if mem is
+   Z_NULL, or Z_VERSION_ERROR if the zlib library version is incompatible with
+   the version assumed by the caller.
+*/
+
 ZEXTERN int ZEXPORT deflatePending(z_streamp strm,
                                    unsigned *pending,
                                    int *bits);
@@ -845,6 +1315,112 @@ ZEXTERN int ZEXPORT deflateSetHeader(z_streamp strm,
    stream state was inconsistent.
 */
 
+/*
+ZEXTERN int ZEXPORT deflateParallelInit(z_streamp strm, int level,
+                                        int threads, uLong chunk);
+
+     Initialize a stream for compression using up to threads threads.  The
+   input is divided into chunks of chunk bytes, which are compressed at the
+   same time by different threads.  Each chunk is compressed using the end of
+   the previous chunk as a dictionary, so only a small amount of compression is
+   lost.  The compressed chunks are joined in order, and their check values
+   combined, to make a single zlib stream that can be decompressed by inflate()
+   or any other zlib decoder.  For a given input, level, and chunk size, the
+   compressed data is the same regardless of the number of threads.  If chunk
+   is zero, a chunk size of 128K is used.  Larger chunks lose less compression,
+   but require more input before all of the threads can be put to work.  It is
+   recommended that the chunk size be at least four times the window size.
+
+     The stream is then compressed with deflateParallel() and freed with
+   deflateParallelEnd().  No other deflate functions can be used with it.  The
+   memory used is about 2 * threads * (2 * chunk + 32K) bytes, plus a deflate
+   state for each thread, all allocated by deflateParallelInit() using zalloc.
+   The threads are started by deflateParallelInit(), and are stopped by
+   deflateParallelEnd().  If zlib was compiled without thread support (see
+   zlibCompileFlags()), or if threads is one, then all of the compression is
+   done in the calling thread.
+
+     deflateParallelInit returns Z_OK if success, Z_MEM_ERROR if there was not
+   enough memory, Z_STREAM_ERROR if level is not a valid compression level, if
+   threads is less than one, or if chunk is more than 1 GB, or Z_VERSION_ERROR
+   if the zlib library version is incompatible with the version assumed by the
+   caller.
+*/
+
+/*
+ZEXTERN int ZEXPORT deflateParallelInit2(z_streamp strm, int level,
+                                         int windowBits, int memLevel,
+                                         int strategy, int threads,
+                                         uLong chunk);
+
+     This is another version of deflateParallelInit with more compression
+   options.  windowBits, memLevel, and strategy are as for deflateInit2(), and
+   are used for the compression of each chunk.  As for deflateInit2(),
+   windowBits can select a zlib (8..15), gzip (16+9..16+15), or raw deflate
+   (-9..-15) stream.  A gzip stream gets the default header described for
+   deflateSetHeader().
+*/
+
+ZEXTERN int ZEXPORT deflateParallel(z_streamp strm, int flush);
+/*
+     deflateParallel() compresses as much data as possible, and stops when the
+   input buffer becomes empty or the output buffer becomes full, with the same
+   use of next_in, avail_in, next_out, avail_out, total_in, total_out, and
+   adler as for deflate().  Input is copied into the chunk being filled, and
+   each chunk is handed to a thread when it is full.  If all of the threads are
+   busy, then deflateParallel() waits for the oldest chunk to finish.
+   Compressed data is provided in order as it becomes available, so
+   deflateParallel() may return with output still to come even though the
+   output buffer has room.  Calling deflateParallel() again will provide it.
+
+     If flush is Z_NO_FLUSH, deflateParallel() returns once all of the input
+   has been taken, or the output buffer is full.  If flush is Z_SYNC_FLUSH (or
+   Z_PARTIAL_FLUSH or Z_BLOCK, which are treated the same), then the input so
+   far is compressed and all of it is written, ending on a byte boundary as for
+   deflate().  That waits for all of the pending chunks, so flushes should be
+   used sparingly.  Z_FULL_FLUSH does the same, and also makes the next chunk
+   not use any prior data, as for deflate().  If flush is Z_FINISH, then the
+   remaining input is compressed, and Z_STREAM_END is returned once all of the
+   compressed data and the trailer have been written.  If Z_OK is returned
+   instead, then deflateParallel() must be called again with Z_FINISH and more
+   output space.  As with deflate(), once Z_FINISH is used, it must be used in
+   all subsequent calls.
+
+     deflateParallel() returns Z_OK if some progress has been made,
+   Z_STREAM_END if all of the compressed data has been written, Z_STREAM_ERROR
+   if the stream state was inconsistent or the parameters were invalid,
+   Z_BUF_ERROR if avail_out was zero, or Z_MEM_ERROR if there was not enough
+   memory for a chunk.  A Z_MEM_ERROR, or an error compressing a chunk, is
+   returned again by subsequent calls.
+*/
+
+ZEXTERN int ZEXPORT deflateParallelParams(z_streamp strm, int level,
+                                          int strategy);
+/*
+     Change the compression level and strategy of a parallel stream, as
+   deflateParams() does for deflate(), for the chunks that follow.  This can
+   only be done once all of the input provided so far has been compressed and
+   written, with a deflateParallel() flush that has completed, or before any
+   input is provided.
+
+     deflateParallelParams returns Z_OK if success, Z_STREAM_ERROR if the
+   parameters are invalid, if the stream state was inconsistent, or if
+   Z_FINISH has been used, Z_BUF_ERROR if there is input or output still
+   pending, or Z_MEM_ERROR if there was not enough memory for a level of 10 or
+   more.  After an error other than Z_BUF_ERROR, some of the threads may have
+   the new parameters.
+*/
+
+ZEXTERN int ZEXPORT deflateParallelEnd(z_streamp strm);
+/*
+     All dynamically allocated data structures for this stream are freed, and
+   the threads are stopped.  Any pending compression is discarded.
+
+     deflateParallelEnd returns Z_OK if success, Z_STREAM_ERROR if the stream
+   state was inconsistent, or Z_DATA_ERROR if the stream was freed prematurely
+   (some input or output was discarded).
+*/
+
 /*
 ZEXTERN int ZEXPORT inflateInit2(z_streamp strm,
                                  int windowBits);
@@ -938,6 +1514,53 @@ ZEXTERN int ZEXPORT inflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+ZEXTERN z_inflate_dictp ZEXPORT inflatePrepareDictionary(z_streamp strm,
+                                               const Bytef *dictionary,
+                                               uInt  dictLength);
+/*
+     Prepare the dictionary once for use by many inflate streams with
+   inflateUseDictionary().  The last 32K bytes of the dictionary, or all of it
+   if shorter, are copied, and its Adler-32 value is computed.  strm must be
+   an initialized inflate stream, which is used only for its zalloc, zfree, and
+   opaque, so it cannot be a stream initialized with inflateInitMem().
+
+     The prepared dictionary is not changed by its use, so it can be shared by
+   streams in different threads.  It must be freed with
+   inflateFreeDictionary() once no streams are using it.
+
+     inflatePrepareDictionary returns the prepared dictionary, or Z_NULL if
+   there was not enough memory or if strm is not a valid inflate stream.
+*/
+
+ZEXTERN int ZEXPORT inflateUseDictionary(z_streamp strm,
+                                         z_inflate_dictp dict);
+/*
+     Provide the dictionary as inflateSetDictionary() does, with inflate()
+   taking the bytes that distances reach before the output from the prepared
+   dictionary itself.  Nothing is copied into the sliding window, so when the
+   stream is decompressed in one inflate() call with Z_FINISH, as uncompress()
+   does, no window is allocated or filled at all.  The dictionary is referenced
+   until a window's worth of output has been produced.  It must not be freed
+   before then, or until the stream is ended or reset, and it is shared by
+   copies made with inflateCopy().
+
+     inflateUseDictionary must be called when inflateSetDictionary() could be,
+   but for raw inflate only before any data is decompressed.  The dictionary
+   is not amended by or to any other: it must be the only one given, and there
+   must be no retained history from a previous stream.
+
+     inflateUseDictionary returns Z_OK if success, Z_STREAM_ERROR if a
+   parameter is invalid or the stream state is inconsistent or not as needed,
+   or Z_DATA_ERROR if the given dictionary doesn't match the expected one
+   (incorrect Adler-32 value).
+*/
+
+ZEXTERN void ZEXPORT inflateFreeDictionary(z_inflate_dictp dict);
+/*
+     Free a dictionary returned by inflatePrepareDictionary().  dict may be
+   Z_NULL, in which case nothing is done.
+*/
+
 ZEXTERN int ZEXPORT inflateSync(z_streamp strm);
 /*
      Skips invalid compressed data until a possible full flush point (see above
@@ -998,6 +1621,76 @@ ZEXTERN int ZEXPORT inflateReset2(z_streamp strm,
    the windowBits parameter is invalid.
 */
 
+ZEXTERN int ZEXPORT inflateBatch(z_streamp strm, z_batchp batch, unsigned n);
+/*
+     inflateBatch() decompresses n independent streams, one for each entry of
+   batch[], reusing the decompression state in strm.  Each stream is
+   decompressed as if by inflateReset() followed by a single inflate() call
+   with Z_FINISH, so the entry must provide all of its input and enough output
+   space for all of its output.  Then inflate() resolves distances in the
+   output, and does not allocate or fill a sliding window.  The wrap and window
+   size requests set by inflateInit2() apply to every stream.  This saves
+   allocating and initializing a new state for each of many small streams.
+
+     On return, the input and output fields of each entry are updated as
+   inflate() would update them, and status is set to Z_OK if the stream was
+   complete and its output fit, Z_BUF_ERROR if the output space was not
+   enough, Z_DATA_ERROR if the stream was corrupted or incomplete, Z_NEED_DICT
+   if it needs a preset dictionary, or Z_MEM_ERROR if there was not enough
+   memory.  strm->msg is reset for each stream, so it is left as set for the
+   last entry.
+
+     inflateBatch returns Z_OK once all of the entries have been processed,
+   whatever their status, or Z_STREAM_ERROR if the stream state was
+   inconsistent or if batch is Z_NULL and n is not zero.  strm is left as
+   after the last stream, ready for inflateReset().
+*/
+
+ZEXTERN uLong ZEXPORT inflateStateSize(int windowBits);
+/*
+     inflateStateSize() returns the number of bytes of memory that
+   inflateInitMem() needs for a stream with the given windowBits, interpreted
+   as for inflateInit2().  If windowBits is zero, then the size is for the
+   largest window.  That includes room to align the start of the memory on a
+   64-byte boundary if it is not already.  inflateStateSize() returns zero if
+   windowBits is invalid.
+*/
+
+ZEXTERN uLong ZEXPORT inflateMemUsage(z_streamp strm);
+/*
+     inflateMemUsage() returns the number of bytes of memory allocated for the
+   state of strm, including the window if it has been allocated.  inflate()
+   allocates the window only when it first needs it, which is not at all if
+   the output is provided in one buffer large enough for all of it, and then
+   for the window size given by windowBits, or else by the zlib header when
+   windowBits is zero.  inflateMemUsage() returns zero if the stream state is
+   inconsistent.
+*/
+
+/*
+ZEXTERN int ZEXPORT inflateInitMem(z_streamp strm, int windowBits,
+                                   voidpf mem, uLong size);
+
+     This is another version of inflateInit2, where the memory for the
+   decompression state and the window is taken from the size bytes at mem, as
+   one block, instead of being allocated by zalloc.  size must be at least the
+   value returned by inflateStateSize() for the same windowBits.  The state and
+   the window are each placed on a 64-byte boundary.  zalloc, zfree, and opaque
+   are set by inflateInitMem() to use the block, and must not be changed by the
+   application.  The memory at mem must not be used for anything else until
+   inflateEnd() is called.
+
+     inflateCopy() cannot copy a stream initialized with inflateInitMem(), and
+   will return Z_MEM_ERROR.  If inflateReset2() is used to request a larger
+   window than size provides for, then inflate() will return Z_MEM_ERROR when
+   it needs the window.
+
+     inflateInitMem returns Z_OK if success, Z_MEM_ERROR if size is less than
+   inflateStateSize(), Z_STREAM_ERROR if windowBits is invalid or if mem is
+   Z_NULL, or Z_VERSION_ERROR if the zlib library version is incompatible with
+   the version assumed by the caller.
+*/
+
 ZEXTERN int ZEXPORT inflatePrime(z_streamp strm,
                                  int bits,
                                  int value);
@@ -1047,6 +1740,74 @@ ZEXTERN long ZEXPORT inflateMark(z_streamp strm);
    source stream state was inconsistent.
 */
 
+ZEXTERN int ZEXPORT inflateGetStats(z_streamp strm,
+                                    z_inflate_stats *stats);
+/*
+     inflateGetStats() copies to *stats the counts of the work done by inflate
+   since inflateInit2() or the last inflateReset().  The output bytes are
+   split into those decoded by the fast loop, fast_bytes, those decoded one
+   code at a time by inflate() itself, slow_bytes, and those copied from
+   stored blocks, stored_bytes.  The fast loop is only used when there are at
+   least several bytes of input and a few hundred bytes of output space
+   available, so if slow_bytes is a large part of the total, then the
+   application is likely providing input or output buffers that are too small,
+   or is using Z_BLOCK or Z_TREES very often.  tables counts the calls to build
+   the three code tables of each dynamic block, and window_copies and
+   window_bytes count the saving of output in the sliding window when inflate()
+   returns, which larger output buffers also reduce.  The counts wrap around if
+   they exceed the range of uLong.
+
+     The counting is only compiled when zlib is built with INFLATE_STATS
+   defined, so that there is no cost otherwise.  Whether it was can be
+   determined using zlibCompileFlags().
+
+     inflateGetStats returns Z_OK on success, Z_STREAM_ERROR if the stream
+   state was inconsistent or stats is Z_NULL, or Z_VERSION_ERROR if zlib was
+   compiled without INFLATE_STATS, in which case the counts are set to zero.
+*/
+
+ZEXTERN int ZEXPORT inflateCheckpoint(z_streamp strm, Bytef *buf,
+                                      uLong *len);
+/*
+     Save in buf the state needed to resume decompression at the current
+   position with inflateRestore(), where inflate() has just returned at the
+   start of a deflate block, as it does with flush equal to Z_BLOCK when bit 7
+   of data_type is set.  That is the sliding window of up to 32K bytes, the
+   unused bits of the last input byte, and total_in and total_out.  On entry,
+   *len is the space available at buf.  On return, *len is the size of the
+   checkpoint, which is 24 bytes more than the window, and so is always at most
+   32792 bytes.  If buf is Z_NULL, then only *len is set.
+
+     This can be used to build an index for random access into a large zlib,
+   gzip, or raw deflate stream, decompressing it once and saving a checkpoint
+   every so often, as examples/zran.c does with its own code.  The window is
+   the last output, so a checkpoint will usually compress well with compress()
+   if it is to be stored.
+
+     inflateCheckpoint returns Z_OK if success, Z_BUF_ERROR if *len is too
+   small, or Z_STREAM_ERROR if the stream state was inconsistent, if inflate()
+   is not at the start of a deflate block, or if the last block has been
+   decoded.
+*/
+
+ZEXTERN int ZEXPORT inflateRestore(z_streamp strm, const Bytef *buf,
+                                   uLong len);
+/*
+     Resume decompression from the checkpoint buf[0..len-1] saved by
+   inflateCheckpoint().  strm must have been initialized by inflateInit2() or
+   a similar function.  The stream is reset to decode raw deflate data, with
+   the window size of the stream that was saved, and with the window, the
+   unused input bits, and total_in and total_out restored.  The application
+   then provides input starting at offset total_in of the original stream.
+   Since the data before the checkpoint is not decoded, there is no check
+   value, and for a zlib or gzip stream, inflate() returns Z_STREAM_END at the
+   end of the last deflate block, without reading the trailer.
+
+     inflateRestore returns Z_OK if success, Z_DATA_ERROR if buf is not a valid
+   checkpoint, Z_MEM_ERROR if there was not enough memory for the window, or
+   Z_STREAM_ERROR if the stream state was inconsistent.
+*/
+
 ZEXTERN int ZEXPORT inflateGetHeader(z_streamp strm,
                                      gz_headerp head);
 /*
@@ -1101,6 +1862,13 @@ ZEXTERN int ZEXPORT inflateBackInit(z_streamp strm, int windowBits,
    and a 32K byte window must be supplied to be able to decompress general
    deflate streams.
 
+     windowBits can also be greater than 15 to have inflateBack() decode the
+   zlib or gzip header and trailer.  windowBits can be 16 more than the window
+   size to decode a gzip stream, or 32 more to decode either a zlib or a gzip
+   stream with automatic detection of the header.  The window size must be at
+   least the window size in a zlib header.  If zlib was compiled without gzip
+   support (NO_GUNZIP), then these return Z_STREAM_ERROR.
+
      See inflateBack() for the usage of these routines.
 
      inflateBackInit will return Z_OK on success, Z_STREAM_ERROR if any of
@@ -1109,10 +1877,6 @@ ZEXTERN int ZEXPORT inflateBackInit(z_streamp strm, int windowBits,
    the version of the header file.
 */
 
-typedef unsigned (*in_func)(void FAR *,
-                            z_const unsigned char FAR * FAR *);
-typedef int (*out_func)(void FAR *, unsigned char FAR *, unsigned);
-
 ZEXTERN int ZEXPORT inflateBack(z_streamp strm,
                                 in_func in, void FAR *in_desc,
                                 out_func out, void FAR *out_desc);
@@ -1139,6 +1903,17 @@ ZEXTERN int ZEXPORT inflateBack(z_streamp strm,
    behavior of inflate(), which expects a zlib header and trailer around the
    deflate stream.
 
+     If inflateBackInit() was given a windowBits greater than 15, then
+   inflateBack() instead decompresses a complete gzip, or zlib or gzip, stream
+   with each call.  It decodes and skips the header, and computes the CRC-32 or
+   Adler-32 of the uncompressed data as it is written, with the length for
+   gzip, and compares them with the trailer.  A mismatch returns Z_DATA_ERROR.
+   strm->adler is set to the check value of the uncompressed data.  A zlib
+   stream that needs a preset dictionary is rejected with Z_DATA_ERROR, since
+   there is no way to provide one.  The unused input returned in
+   strm->next_in and strm->avail_in starts right after the trailer, so another
+   call of inflateBack() can decompress the next member of a gzip file.
+
      inflateBack() uses two subroutines supplied by the caller that are then
    called by inflateBack() for input and output.  inflateBack() calls those
    routines until it reads a complete deflate stream and writes out all of the
@@ -1191,6 +1966,200 @@ ZEXTERN int ZEXPORT inflateBackEnd(z_streamp strm);
    state was inconsistent.
 */
 
+ZEXTERN int ZEXPORT inflateParallel(z_streamp strm, int windowBits,
+                                    int threads, uLong chunk,
+                                    out_func out, void FAR *out_desc);
+/*
+     inflateParallel() decompresses a complete zlib, gzip, or raw deflate
+   stream in memory with a single call, using up to threads threads.  The
+   stream can be decoded in parallel where gzip members start, after flushes
+   (see deflate() and deflateParallel()), and at the starts of dynamic blocks,
+   which most compressors write every 16K to 64K of compressed data.  Where
+   the data before such a point is not yet known, its references to that data
+   are kept and filled in once it is.  The points are found by trying every
+   bit position, and a region in which none is found, or in which a guess was
+   wrong, is decoded serially.  In all cases the output is the same as from
+   inflate(), and any zlib, gzip, or raw deflate stream can be used.
+
+     The fields zalloc, zfree, and opaque must be initialized before the call,
+   and zalloc and zfree must be safe to use from multiple threads at once, as
+   the defaults are.  The input is next_in[0..avail_in-1], all of which must
+   be provided.  windowBits is as for inflateInit2(), except that it cannot be
+   zero.  The input is divided into regions of chunk bytes, and each region is
+   decoded by a different thread from its first point.  If chunk is zero, a
+   region size of 512K is used.  Regions that are not much larger than the
+   spacing of the points gain little.  Each thread buffers no more than
+   32 * chunk bytes of output.  If zlib was compiled without thread support
+   (see zlibCompileFlags()), or if threads is one, then all of the
+   decompression is done in the calling thread.
+
+     If out is not Z_NULL, then out(out_desc, buf, len) is called to write the
+   decompressed data in order, as for inflateBack().  out() should return zero
+   on success, or non-zero to stop.  Otherwise the decompressed data is written
+   to next_out[0..avail_out-1].  Every check value is verified, the one for
+   each gzip member, or for the zlib stream.  On return, next_in, avail_in,
+   and total_in reflect the input used, total_out is the amount of
+   decompressed data, and for a zlib or gzip stream adler is the check value
+   of the stream or of the last gzip member.  Decoding stops after a gzip
+   member that is not followed by another gzip header, leaving any remaining
+   input at next_in.  No state remains, so there is no inflateEnd() to call.
+
+     inflateParallel returns Z_STREAM_END on success, Z_DATA_ERROR if the
+   input is not valid (strm->msg is set to indicate the nature of the error),
+   Z_NEED_DICT if the zlib stream requires a preset dictionary, which is not
+   supported, Z_BUF_ERROR if the input is incomplete (avail_in is then zero),
+   or if the output did not fit or out() returned an error (avail_in not
+   zero), Z_MEM_ERROR if there was not enough memory, or Z_STREAM_ERROR if the
+   parameters are invalid, if threads is less than one, or if chunk is more
+   than 16 MB.  inflateParallel() cannot return Z_OK.
+*/
+
+ZEXTERN int ZEXPORT inflateParallel2(z_streamp strm, int windowBits,
+                                     int threads, uLong chunk,
+                                     out_func out, void FAR *out_desc,
+                                     out_func index, void FAR *index_desc);
+/*
+     inflateParallel2() is the same as inflateParallel(), but if index is not
+   Z_NULL, it also provides an index for random access to the stream.  Where
+   two regions meet within deflate blocks, index(index_desc, buf, len) is
+   called with a checkpoint in buf[0..len-1], before any of the output after
+   that point is written.  The checkpoint has the same format as those made by
+   inflateCheckpoint(), and so can be saved and later given to
+   inflateRestore() to resume decompressing there, as raw deflate data
+   continuing at total_in bytes into the input, and total_out bytes into the
+   output.  The checkpoints are about chunk bytes of input apart, also when
+   only one thread is used.  None are made where a gzip member starts, since
+   decompression can simply start there.  index() should return zero on
+   success, or non-zero to stop, in which case inflateParallel2() returns
+   Z_BUF_ERROR with avail_in not zero.
+*/
+
+typedef struct z_index_s FAR *z_indexp;
+typedef int (*seek_func)(void FAR *, z_off64_t);
+
+ZEXTERN int ZEXPORT inflateIndexBuild(z_streamp strm, int windowBits,
+                                      uLong span, in_func in,
+                                      void FAR *in_desc, z_indexp FAR *index);
+/*
+     inflateIndexBuild() decompresses a complete zlib, gzip, or raw deflate
+   stream, and returns in *index an index of access points into it, from
+   which inflateIndexExtract() can decompress any part of the stream without
+   starting over from the beginning.  The fields zalloc, zfree, and opaque of
+   strm must be initialized before the call, and are used for all of the
+   index's memory.  windowBits is as for inflateInit2(), so for example
+   15 + 32 accepts either a zlib or a gzip stream, and -15 is a raw deflate
+   stream.  A gzip stream can have several members, which are all indexed.
+   The input is provided by in(in_desc, &buf) as for inflateBack(), and starts
+   with next_in[0..avail_in-1] if next_in is not Z_NULL.  The offsets given
+   later to the seek function of inflateIndexExtract() are from the start of
+   that input.
+
+     An access point is made at the start of the first deflate block that is
+   at least span bytes of uncompressed data after the last one, and there is
+   always one at the start of the stream.  If span is zero, then 1 MB is used.
+   Each access point keeps the 32K window that preceded it, compressed, so
+   the index is usually a few percent of the size of the stream at the
+   default span.  Extracting data decompresses on average span / 2 bytes
+   before getting to it.  The decompressed data is discarded, after the check
+   values of the zlib stream or of each gzip member are verified.  On return,
+   strm has been ended as by inflateEnd(), so there is no state left to free.
+
+     inflateIndexBuild returns Z_OK on success, Z_DATA_ERROR if the input is
+   not valid (strm->msg is then set) or requires a preset dictionary,
+   Z_BUF_ERROR if in() returned zero before the end of the stream, Z_MEM_ERROR
+   if there was not enough memory, or Z_STREAM_ERROR if the parameters are
+   invalid.  On error, *index is set to Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT inflateIndexParallel(z_streamp strm, int windowBits,
+                                         uLong span, int threads,
+                                         z_indexp FAR *index);
+/*
+     inflateIndexParallel() is the same as inflateIndexBuild(), but the whole
+   stream is provided in next_in[0..avail_in-1], and it is decompressed using
+   up to threads threads with inflateParallel2().  The access points are the
+   checkpoints inflateParallel2() makes where its regions meet, which are a
+   quarter of span bytes of compressed data long, and of those only the ones
+   that are at least span bytes of uncompressed data after the last one are
+   kept.  The access points are therefore at different places than those
+   made by inflateIndexBuild(), but the index is used in the same way, and is
+   saved in the same format.  With one thread, or if zlib was compiled
+   without thread support, the stream is decompressed serially.  On return,
+   next_in, avail_in, total_in, and total_out are as for inflateParallel(),
+   and there is no state to free.
+
+     inflateIndexParallel returns Z_OK on success, Z_NEED_DICT if the zlib
+   stream requires a preset dictionary, or else the same errors as
+   inflateParallel(), other than Z_STREAM_END.  On error, *index is set to
+   Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT inflateIndexExtract(z_indexp index, z_off64_t offset,
+                                        Bytef *buf, uLong FAR *len,
+                                        in_func in, seek_func seek,
+                                        void FAR *desc);
+/*
+     Decompress *len bytes starting at the uncompressed offset offset into
+   buf, using the index built by inflateIndexBuild() or read by
+   inflateIndexLoad().  seek(desc, pos) is called to position the input at
+   pos bytes from the start of the stream, and should return zero on success
+   or non-zero on failure.  The input from there is then provided by
+   in(desc, &buf), as for inflateIndexBuild().  On return, *len is the number
+   of bytes written to buf, which is less than requested only if the end of
+   the stream was reached, or on error.  Decompression may continue across
+   gzip members.  Check values are verified only for the gzip members that
+   are decompressed from their start.  An index contains an inflate stream
+   that is reused for each extraction, so it can only be used by one thread at
+   a time.
+
+     inflateIndexExtract returns Z_OK on success, including when the offset is
+   at or past the end of the stream, in which case *len is zero.  It returns
+   Z_DATA_ERROR if the input or the index is not valid, Z_BUF_ERROR if seek()
+   failed or in() returned zero before the end of the stream, Z_MEM_ERROR if
+   there was not enough memory, or Z_STREAM_ERROR if the parameters are
+   invalid.
+*/
+
+ZEXTERN int ZEXPORT inflateIndexInfo(z_indexp index, z_off64_t FAR *length,
+                                     z_off64_t FAR *compressed,
+                                     unsigned long FAR *points);
+/*
+     Set *length to the length of the uncompressed data of the indexed stream,
+   *compressed to the length of its compressed data, and *points to the
+   number of access points in the index.  Any of the three can be Z_NULL to
+   not get that value.  inflateIndexInfo returns Z_OK, or Z_STREAM_ERROR if
+   index is Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT inflateIndexSave(z_indexp index, out_func out,
+                                     void FAR *out_desc);
+ZEXTERN int ZEXPORT inflateIndexLoad(z_streamp strm, in_func in,
+                                     void FAR *in_desc, z_indexp FAR *index);
+/*
+     inflateIndexSave() writes the index with out(out_desc, buf, len), which
+   should return zero on success or non-zero to stop, as for inflateBack().
+   inflateIndexLoad() reads an index written by inflateIndexSave() from
+   in(in_desc, &buf), using the zalloc, zfree, and opaque fields of strm for
+   its memory, and returns it in *index.  The format does not depend on the
+   platform or on the zlib version, and is described in inflatei.c.  It ends
+   with a CRC-32 that inflateIndexLoad() checks.  The index does not identify
+   the stream it was built for, so the application must keep the two
+   together.
+
+     inflateIndexSave returns Z_OK on success, Z_BUF_ERROR if out() returned
+   non-zero, or Z_STREAM_ERROR if the parameters are invalid.
+   inflateIndexLoad returns Z_OK on success, Z_DATA_ERROR if the input is not
+   a valid index, Z_BUF_ERROR if in() returned zero before the end of the
+   index, Z_MEM_ERROR if there was not enough memory, or Z_STREAM_ERROR if
+   the parameters are invalid.  On error, *index is set to Z_NULL.
+*/
+
+ZEXTERN void ZEXPORT inflateIndexFree(z_indexp index);
+/*
+     Free all of the memory used by index.  index can be Z_NULL, in which case
+   nothing is done.
+*/
+
 ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
 /* Return flags indicating compile-time options.
 
@@ -1204,7 +2173,7 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
      8: ZLIB_DEBUG
      9: ASMV or ASMINF -- use ASM code
      10: ZLIB_WINAPI -- exported functions use the WINAPI calling convention
-     11: 0 (reserved)
+     11: DEFLATE_STATS -- deflateGetStats() counts the work done by deflate
 
     One-time table building (smaller code, but not thread-safe if true):
      12: BUILDFIXED -- build static block decoding tables when needed
@@ -1216,7 +2185,8 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
                           deflate code when not needed)
      17: NO_GZIP -- deflate can't write gzip streams, and inflate can't detect
                     and decode gzip streams (to avoid linking crc code)
-     18-19: 0 (reserved)
+     18: no threads -- deflateParallel() compresses in the calling thread
+     19: 0 (reserved)
 
     Operation variations (changes in library functionality):
      20: PKZIP_BUG_WORKAROUND -- slightly more permissive inflate
@@ -1229,9 +2199,57 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
      26: 0 = returns value, 1 = void -- 1 means inferred string length returned
 
     Remainder:
-     27-31: 0 (reserved)
+     27: INFLATE_STATS -- inflateGetStats() counts the work done by inflate
+     28-31: 0 (reserved)
  */
 
+ZEXTERN const char * ZEXPORT zlibKernels(void);
+/*
+     Return a string naming the implementation that this processor uses for
+   each of the routines that have vector or instruction set alternatives.  The
+   processor features are detected once, on first use of the library, and the
+   fastest supported implementations are chosen then.  The string is a list of
+   name=kernel pairs separated by spaces, for example: "crc32=vpclmul
+   adler32=avx2 longest_match=avx2 slide_hash=avx512 inflate_copy=sse2".  The
+   kernels are "c" for portable code, "braid" or "byte" for the table-driven
+   CRC-32, or the name of the instruction set used, e.g. "sse2", "ssse3",
+   "avx2", "avx512", "pclmul", "vpclmul", "neon", "armv8" (the ARMv8 CRC32
+   instructions), or "pmull".  The crc32 entry names the kernel used for long
+   buffers; shorter buffers may use a simpler one.  The names and the order of
+   the entries may change in future versions.  The string is static and must
+   not be modified or freed by the application.
+
+     If atomics are not available, and the library will be used in multiple
+   threads, then zlibKernels() should be called once before starting the
+   threads, so that the detection and the choices are made safely.
+*/
+
+ZEXTERN int ZEXPORT zlibAllocCache(z_size_t max);
+/*
+     Enable or disable the caching of memory freed by the default allocation
+   functions, those used when zalloc and zfree are Z_NULL.  When enabled, the
+   memory freed by deflateEnd(), inflateEnd(), and the like is kept in a cache
+   for each thread, of up to max bytes, and an allocation of the same size in
+   that thread reuses it, instead of going back to the system.  A thread that
+   repeatedly initializes and ends streams of the same parameters then gets the
+   same memory back, already mapped and likely still in the processor's cache.
+   The memory held in the cache of a thread is freed when the thread exits.
+   max equal to zero, the initial setting, disables the cache, freeing the
+   memory cached by the calling thread, and that of other threads the next time
+   they free memory.
+
+     zlibAllocCache() changes the setting for the entire library, and so must
+   not be called while other threads are using zlib.  The memory held by each
+   thread is in addition to the memory in use by its streams, so max should be
+   sized accordingly, e.g. to the memory used by one deflate stream (see
+   deflateStateSize()) plus one inflate stream.
+
+     zlibAllocCache() returns Z_OK on success, Z_MEM_ERROR if the cache could
+   not be set up, or Z_STREAM_ERROR if the library was compiled without
+   threads, to use other allocation functions, or with Z_SOLO, in which case
+   there is no cache.
+*/
+
 #ifndef Z_SOLO
 
                         /* utility functions */
@@ -1291,7 +2309,9 @@ ZEXTERN int ZEXPORT uncompress(Bytef *dest,   uLongf *destLen,
    uncompressed data.  (The size of the uncompressed data must have been saved
    previously by the compressor and transmitted to the decompressor by some
    mechanism outside the scope of this compression library.) Upon exit, destLen
-   is the actual size of the uncompressed data.
+   is the actual size of the uncompressed data.  Since all of dest is
+   available, distances are resolved directly in dest, and no sliding window is
+   allocated, unless sourceLen or destLen does not fit in a uInt.
 
      uncompress returns Z_OK if success, Z_MEM_ERROR if there was not
    enough memory, Z_BUF_ERROR if there was not enough room in the output
@@ -1326,9 +2346,10 @@ ZEXTERN gzFile ZEXPORT gzopen(const char *path, const char *mode);
    compressing and writing.  The mode parameter is as in fopen ("rb" or "wb")
    but can also include a compression level ("wb9") or a strategy: 'f' for
    filtered data as in "wb6f", 'h' for Huffman-only compression as in "wb1h",
-   'R' for run-length encoding as in "wb1R", or 'F' for fixed code compression
-   as in "wb9F".  (See the description of deflateInit2 for more information
-   about the strategy parameter.)  'T' will request transparent writing or
+   'R' for run-length encoding as in "wb1R", 'F' for fixed code compression
+   as in "wb9F", or 'Q' for quick compression as in "wb1Q".  (See the
+   description of deflateInit2 for more information about the strategy
+   parameter.)  'T' will request transparent writing or
    appending with no compression and not using the gzip format.
 
      "a" can be used instead of "w" to request that the gzip stream that will
@@ -1337,6 +2358,13 @@ ZEXTERN gzFile ZEXPORT gzopen(const char *path, const char *mode);
    "x" when writing will create the file exclusively, which fails if the file
    already exists.  On systems that support it, the addition of "e" when
    reading or writing will set the flag to close the file on an execve() call.
+   On systems with mmap(), the addition of "m" when reading will memory map
+   the file, if it is a regular file, so that gzread() decompresses directly
+   from the mapping with no copy and no read() calls, and gzseek() backwards
+   does not have to read the file again.  The size of the file when it is
+   opened is what is read.  The file must not be truncated while it is open,
+   or the process may be sent a SIGBUS.  gzopen() will read the file as usual
+   if it cannot be mapped.
 
      These functions, as well as gzip, will read and decode a sequence of gzip
    streams in a file.  The append function of gzopen() can be used to create
@@ -1380,15 +2408,51 @@ ZEXTERN gzFile ZEXPORT gzdopen(int fd, const char *mode);
    will not detect if fd is invalid (unless fd is -1).
 */
 
+typedef int (*gz_read_func)(voidp ctx, voidp buf, unsigned len);
+typedef int (*gz_write_func)(voidp ctx, voidpc buf, unsigned len);
+typedef z_off64_t (*gz_seek_func)(voidp ctx, z_off64_t offset, int whence);
+typedef int (*gz_close_func)(voidp ctx);
+
+ZEXTERN gzFile ZEXPORT gzopen_funcs(voidp ctx, gz_read_func zread,
+                                    gz_write_func zwrite, gz_seek_func zseek,
+                                    gz_close_func zclose, const char *mode);
+/*
+     Open a gzFile whose compressed data is read and written by the provided
+   functions instead of a file descriptor, for example for object storage or
+   memory.  Each function is called with ctx as its first argument.  mode is
+   as for gzopen(), except that "e", "x", and "m" are ignored.  zread() must
+   be provided for reading, and zwrite() for writing.  Everything else,
+   including gzgets(), gzprintf(), and gzseek(), then works as for any other
+   gzFile.
+
+     zread() reads up to len bytes into buf, and returns the number read, zero
+   at the end of the data, or -1 on error with errno set.  zwrite() writes up
+   to len bytes from buf, and returns the number written, which is more than
+   zero, or -1 on error with errno set.  zseek() is as for lseek(), and
+   returns the resulting offset or -1 on error.  zseek may be NULL if the
+   data is not seekable, in which case gzrewind(), gzoffset(), and backward
+   or indexed seeks when reading return -1.  zclose() is called once by
+   gzclose(), and returns 0 on success or -1 on error.  zclose may be NULL if
+   there is nothing to do.  With gzreadahead() or gzwritebehind(), zread() or
+   zwrite() is called from the separate thread, but never at the same time as
+   the other functions.
+
+     gzopen_funcs returns NULL if there was insufficient memory, if the mode is
+   invalid, or if a needed function is NULL.  zclose() is not called in that
+   case.
+*/
+
 ZEXTERN int ZEXPORT gzbuffer(gzFile file, unsigned size);
 /*
      Set the internal buffer size used by this library's functions for file to
-   size.  The default buffer size is 8192 bytes.  This function must be called
-   after gzopen() or gzdopen(), and before any other calls that read or write
-   the file.  The buffer memory allocation is always deferred to the first read
-   or write.  Three times that size in buffer space is allocated.  A larger
-   buffer size of, for example, 64K or 128K bytes will noticeably increase the
-   speed of decompression (reading).
+   size.  The default buffer size is 8192 bytes, except when reading a file
+   whose size is known, for which the default is doubled for every 64 times
+   that in the rest of the file, up to 128K bytes.  This function must be
+   called after gzopen() or gzdopen(), and before any other calls that read or
+   write the file.  The buffer memory allocation is always deferred to the
+   first read or write.  Three times that size in buffer space is allocated.
+   A larger buffer size of, for example, 64K or 128K bytes will noticeably
+   increase the speed of decompression (reading).
 
      The new buffer size also affects the maximum length for gzprintf().
 
@@ -1396,6 +2460,90 @@ ZEXTERN int ZEXPORT gzbuffer(gzFile file, unsigned size);
    too late.
 */
 
+ZEXTERN int ZEXPORT gzbufferalign(gzFile file, unsigned align, int huge);
+/*
+     Request that the internal buffers for file, and the deflate or inflate
+   state with its window, be allocated at a multiple of align bytes in memory,
+   where align is a power of two, or zero for the usual malloc() alignment.
+   For example, a descriptor opened with O_DIRECT for reading needs buffers
+   aligned to the storage block size, along with a buffer size from gzbuffer()
+   that is a multiple of it.  If huge is not zero, then also ask the operating
+   system to back the memory with huge pages, if it can, which can reduce the
+   cost of TLB misses for large buffers.  In that case each allocation is
+   rounded up to a whole number of huge pages, so this is most useful with a
+   large size given to gzbuffer().  The state is sized to permit all of the
+   compression levels, including those for gzsetparams().  The deflate state
+   of gzsetthreads() with more than one thread is allocated as usual.  This
+   function must be called after gzopen() or gzdopen(), and before any other
+   calls that read or write the file.
+
+     gzbufferalign() returns 0 on success, or -1 on failure, such as being
+   called too late or align not being a power of two.
+*/
+
+ZEXTERN int ZEXPORT gzreadahead(gzFile file, unsigned buffers);
+/*
+     Request that file, open for reading, be read by a separate thread into a
+   ring of buffers input buffers, each of the size set by gzbuffer(), so that
+   the reading of the file overlaps decompression in gzread() and the other
+   reading functions.  The decompression uses the data in the buffers
+   directly, with no copy.  This can make a big difference when each read()
+   has a long latency, as on a network file system, in which case a larger
+   buffer size with gzbuffer() will also help.  A buffers value of zero, the
+   default, reads the file in the calling thread.  The thread is stopped and
+   started again as needed by gzrewind() and gzseek(), and gzoffset() reports
+   the offset of the data consumed, not the data read ahead.  If the library
+   was compiled without threads (see zlibCompileFlags()), if the thread could
+   not be started, or if the file was memory mapped with "m", then the reading
+   is done in the calling thread as usual.  This function must be called after
+   gzopen() or gzdopen(), and before any reading of file.
+
+     gzreadahead() returns 0 on success, or -1 on failure, such as being called
+   too late, or if file is not open for reading.
+*/
+
+ZEXTERN int ZEXPORT gzwritebehind(gzFile file, unsigned buffers);
+/*
+     Request that the compression and writing for file, open for writing, be
+   done by a separate thread.  gzwrite() and the other writing functions then
+   copy the data into a ring of buffers input buffers, each of the size set by
+   gzbuffer(), and return without waiting, unless the ring is full.  gzflush()
+   with a flush value other than Z_NO_FLUSH, gzsetparams(), and gzclose() wait
+   for the thread to complete all of the data provided so far.  A buffers value
+   of zero, the default, compresses in the calling thread.  If the library was
+   compiled without threads (see zlibCompileFlags()), or if the thread could
+   not be started, then the compressing is done in the calling thread as usual.
+   This function must be called after gzopen() or gzdopen(), and before any
+   writing to file.
+
+     Since the writing is deferred, an error writing to the output file is
+   reported by whichever writing function is called next, or by gzflush() or
+   gzclose(), and some of the data accepted by earlier calls may have been
+   discarded.  gzoffset() reports only what the thread has written so far.
+
+     gzwritebehind() returns 0 on success, or -1 on failure, such as being
+   called too late, or if file is not open for writing.
+*/
+
+ZEXTERN int ZEXPORT gzsetthreads(gzFile file, int threads);
+/*
+     Request that file, open for writing, be compressed using threads threads
+   with deflateParallel(), which divides the input into 128K chunks that are
+   compressed at the same time.  The output is still a single gzip member, but
+   it is slightly larger than it would be otherwise, and gzflush() waits for
+   all of the pending chunks, so it should be used sparingly.  A threads value
+   of one, the default, uses deflate() in the calling thread.  This can be
+   combined with gzwritebehind(), in which case the caller does not wait for
+   the chunks to be compressed either.  If the library was compiled without
+   threads (see zlibCompileFlags()), then the chunks are compressed in the
+   calling thread.  This function must be called after gzopen() or gzdopen(),
+   and before any writing to file.
+
+     gzsetthreads() returns 0 on success, or -1 on failure, such as being
+   called too late, if file is not open for writing, or if threads is less
+   than one.
+*/
+
 ZEXTERN int ZEXPORT gzsetparams(gzFile file, int level, int strategy);
 /*
      Dynamically update the compression level and strategy for file.  See the
@@ -1483,6 +2631,26 @@ ZEXTERN z_size_t ZEXPORT gzfwrite(voidpc buf, z_size_t size,
    is returned, and the error state is set to Z_STREAM_ERROR.
 */
 
+typedef struct gz_iovec_s {
+    voidpc base;        /* start of the data */
+    z_size_t len;       /* number of bytes at base */
+} gz_iovec;
+
+ZEXTERN z_size_t ZEXPORT gzwritev(gzFile file, const gz_iovec *iov, int n);
+/*
+     Compress and write the data in the n pieces listed in iov to file, in
+   order, as if they were concatenated and given to gzwrite().  This avoids
+   copying scattered data, such as a header and a payload, to one place
+   first.  If file was opened for transparent writing with "T", on systems
+   that have writev(), then large requests are written with as few system
+   calls as possible, instead of one for each piece.
+
+     gzwritev() returns the total number of bytes written, or zero if there
+   was an error or no data.  If n is negative, or if the total length does
+   not fit in a z_size_t, then nothing is written, zero is returned, and the
+   error state is set to Z_STREAM_ERROR.
+*/
+
 ZEXTERN int ZEXPORTVA gzprintf(gzFile file, const char *format, ...);
 /*
      Convert, format, compress, and write the arguments (...) to file under
@@ -1520,6 +2688,50 @@ ZEXTERN char * ZEXPORT gzgets(gzFile file, char *buf, int len);
    buf are indeterminate.
 */
 
+ZEXTERN int ZEXPORT gzreadview(gzFile file, z_const unsigned char **buf,
+                               unsigned *len);
+/*
+     Show the decompressed bytes from file that are available next, without
+   copying them.  gzreadview() decompresses more data if none is buffered, and
+   then sets *buf to the buffered bytes in place and *len to how many there
+   are.  *len is set to zero at the end of the file.  The bytes are only valid
+   until the next call on file, other than gzconsume(), and may not be
+   modified.  Viewing the same bytes again shows the same bytes -- they are
+   not read until they are consumed with gzconsume().  This saves a copy for
+   applications that can parse the data where it is, e.g. to tokenize lines.
+
+     gzreadview returns 0 on success, or -1 in case of error.
+*/
+
+ZEXTERN int ZEXPORT gzconsume(gzFile file, unsigned len);
+/*
+     Consume len bytes of those last shown by gzreadview(), so that the
+   next read or view starts after them.  len may be less than the *len from
+   gzreadview(), in which case the remaining bytes are shown again first.
+   gzconsume returns 0 on success, or -1 if len is more than the bytes shown,
+   in which case the error is Z_STREAM_ERROR, or in case of a read error.
+*/
+
+ZEXTERN int ZEXPORT gzgetlines(gzFile file,
+                               int (*line)(void *, z_const char *, unsigned),
+                               void *ctx);
+/*
+     Read and decompress the lines of file, calling line(ctx, str, len) for
+   each one, until line() returns non-zero, the end of the file is reached, or
+   there is an error.  Each line is len bytes at str, including the
+   terminating newline character, except possibly for the last line of the
+   file.  str is not null-terminated.  Lines are shown in place in the output
+   buffer when they fit there, and otherwise are assembled in memory allocated
+   for them.  The line is only valid until line() returns, and line() must
+   not use file.  When line() returns non-zero, gzgetlines() returns right
+   away, and the next read from file starts with the next line.
+
+     This does the same work as a gzgets() loop, but without a copy of each
+   line or the per-call overhead, and with no limit on line length.
+   gzgetlines returns 1 if line() stopped it, 0 at the end of the file, or -1
+   in case of error.
+*/
+
 ZEXTERN int ZEXPORT gzputc(gzFile file, int c);
 /*
      Compress and write c, converted to an unsigned char, into file.  gzputc
@@ -1572,9 +2784,9 @@ ZEXTERN z_off_t ZEXPORT gzseek(gzFile file,
    the value SEEK_END is not supported.
 
      If the file is opened for reading, this function is emulated but can be
-   extremely slow.  If the file is opened for writing, only forward seeks are
-   supported; gzseek then compresses a sequence of zeroes up to the new
-   starting position.
+   extremely slow, unless access points are being kept with gzindex().  If the
+   file is opened for writing, only forward seeks are supported; gzseek then
+   compresses a sequence of zeroes up to the new starting position.
 
      gzseek returns the resulting offset location as measured in bytes from
    the beginning of the uncompressed stream, or -1 in case of error, in
@@ -1582,6 +2794,37 @@ ZEXTERN z_off_t ZEXPORT gzseek(gzFile file,
    would be before the current position.
 */
 
+ZEXTERN int ZEXPORT gzindex(gzFile file, unsigned long span,
+                            const char *path);
+/*
+     Request that access points be kept while file, open for reading, is
+   decompressed, about every span bytes of uncompressed data, or every 1 MB if
+   span is zero.  Each access point is the compressed and uncompressed offsets
+   of the start of a deflate block, along with the 32K of uncompressed data
+   before it, saved with inflateCheckpoint() and compressed.  gzseek() then
+   resumes decompression from the closest access point at or before the
+   requested position, instead of decompressing from the current position or
+   from the start, so random access into a large gzip file without the need to
+   decompress all of it first takes only as long as decompressing span bytes.
+   Access points are only made for the data that has been decompressed, so to
+   seek quickly to anywhere, the file could be read once to the end first.
+   Decompression that starts at an access point cannot check the CRC-32 of
+   that gzip member, since the data before the access point is not decoded.
+
+     If path is not NULL, it is the name of a sidecar file for the access
+   points.  If it exists and was made for a file of the same length, then its
+   access points are loaded by gzindex().  The access points, including any
+   new ones, are then written to it by gzclose() if there are any that were
+   not loaded.  The sidecar is not otherwise checked to be for this file.  This
+   function must be called after gzopen() or gzdopen(), and before any reading
+   of file, which must be seekable.
+
+     gzindex() returns 0 on success, or -1 on failure, such as being called too
+   late, if file is not open for reading or is not seekable, or if there was
+   not enough memory.  A sidecar that can't be read or is not for this file is
+   not a failure -- it is ignored, and is replaced when the file is closed.
+*/
+
 ZEXTERN int ZEXPORT    gzrewind(gzFile file);
 /*
      Rewind file. This function is supported only for reading.
@@ -1790,6 +3033,37 @@ ZEXTERN uLong ZEXPORT crc32_combine_op(uLong crc1, uLong crc2, uLong op);
    crc32_combine() if the generated op is used more than once.
 */
 
+ZEXTERN uLong ZEXPORT crc32_z_parallel(uLong crc, const Bytef *buf,
+                                       z_size_t len, int threads);
+/*
+     Same as crc32_z(), but using up to threads threads for a large buffer.
+   The buffer is divided into pieces of at least 4 MB, whose CRC-32 check
+   values are computed at the same time by the calling thread and up to
+   threads - 1 new threads, and then combined with crc32_combine_op().  Fewer
+   threads are used if the buffer is not long enough to give each one a piece.
+   The threads are started and stopped by each call.  The result is always
+   the same as crc32_z(crc, buf, len).  If zlib was compiled without thread
+   support (see zlibCompileFlags()), or if threads is less than two, or if
+   the threads cannot be started, then the CRC is computed in the calling
+   thread.
+*/
+
+ZEXTERN uLong ZEXPORT adler32_combine_many(const uLong *adlers,
+                                           const z_size_t *lens, unsigned n);
+ZEXTERN uLong ZEXPORT crc32_combine_many(const uLong *crcs,
+                                         const z_size_t *lens, unsigned n);
+/*
+     Combine n check values into one.  adlers[i] or crcs[i] is the Adler-32 or
+   CRC-32 of the i'th of n consecutive sequences of bytes, where the length of
+   that sequence is lens[i].  Return the check value of all of the sequences
+   concatenated.  That is the same as combining them in order with
+   adler32_combine64() or crc32_combine64().  lens[0] is not used.  If n is
+   zero, the initial check value is returned.  crc32_combine_many() keeps the
+   crc32_combine_gen64() operators of the lengths it has seen, so that
+   repeated lengths cost only one multiplication each.  It uses a carry-less
+   multiply instruction if available.
+*/
+
 
                         /* various hacks, don't look :) */
 
@@ -1810,6 +3084,18 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
                                      unsigned char FAR *window,
                                      const char *version,
                                      int stream_size);
+ZEXTERN int ZEXPORT deflateParallelInit2_(z_streamp strm, int level,
+                                          int windowBits, int memLevel,
+                                          int strategy, int threads,
+                                          uLong chunk, const char *version,
+                                          int stream_size);
+ZEXTERN int ZEXPORT deflateInitMem_(z_streamp strm, int level,
+                                    int windowBits, int memLevel,
+                                    int strategy, voidpf mem, uLong size,
+                                    const char *version, int stream_size);
+ZEXTERN int ZEXPORT inflateInitMem_(z_streamp strm, int windowBits,
+                                    voidpf mem, uLong size,
+                                    const char *version, int stream_size);
 #ifdef Z_PREFIX_SET
 #  define z_deflateInit(strm, level) \
           deflateInit_((strm), (level), ZLIB_VERSION, (int)sizeof(z_stream))
@@ -1824,6 +3110,23 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
 #  define z_inflateBackInit(strm, windowBits, window) \
           inflateBackInit_((strm), (windowBits), (window), \
                            ZLIB_VERSION, (int)sizeof(z_stream))
+#  define z_deflateParallelInit(strm, level, threads, chunk) \
+          deflateParallelInit2_((strm), (level), MAX_WBITS, 8, \
+                                Z_DEFAULT_STRATEGY, (threads), (chunk), \
+                                ZLIB_VERSION, (int)sizeof(z_stream))
+#  define z_deflateParallelInit2(strm, level, windowBits, memLevel, strategy, \
+                                 threads, chunk) \
+          deflateParallelInit2_((strm), (level), (windowBits), (memLevel), \
+                                (strategy), (threads), (chunk), \
+                                ZLIB_VERSION, (int)sizeof(z_stream))
+#  define z_deflateInitMem(strm, level, windowBits, memLevel, strategy, \
+                           mem, size) \
+          deflateInitMem_((strm), (level), (windowBits), (memLevel), \
+                          (strategy), (mem), (size), ZLIB_VERSION, \
+                          (int)sizeof(z_stream))
+#  define z_inflateInitMem(strm, windowBits, mem, size) \
+          inflateInitMem_((strm), (windowBits), (mem), (size), ZLIB_VERSION, \
+                          (int)sizeof(z_stream))
 #else
 #  define deflateInit(strm, level) \
           deflateInit_((strm), (level), ZLIB_VERSION, (int)sizeof(z_stream))
@@ -1838,6 +3141,23 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
 #  define inflateBackInit(strm, windowBits, window) \
           inflateBackInit_((strm), (windowBits), (window), \
                            ZLIB_VERSION, (int)sizeof(z_stream))
+#  define deflateParallelInit(strm, level, threads, chunk) \
+          deflateParallelInit2_((strm), (level), MAX_WBITS, 8, \
+                                Z_DEFAULT_STRATEGY, (threads), (chunk), \
+                                ZLIB_VERSION, (int)sizeof(z_stream))
+#  define deflateParallelInit2(strm, level, windowBits, memLevel, strategy, \
+                               threads, chunk) \
+          deflateParallelInit2_((strm), (level), (windowBits), (memLevel), \
+                                (strategy), (threads), (chunk), \
+                                ZLIB_VERSION, (int)sizeof(z_stream))
+#  define deflateInitMem(strm, level, windowBits, memLevel, strategy, \
+                         mem, size) \
+          deflateInitMem_((strm), (level), (windowBits), (memLevel), \
+                          (strategy), (mem), (size), ZLIB_VERSION, \
+                          (int)sizeof(z_stream))
+#  define inflateInitMem(strm, windowBits, mem, size) \
+          inflateInitMem_((strm), (windowBits), (mem), (size), ZLIB_VERSION, \
+                          (int)sizeof(z_stream))
 #endif
 
 #ifndef Z_SOLO
@@ -0,0 +1,228 @@
+/* zthread.c -- threads and a clock for the compression library
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* @(#) $Id$ */
+
+#include "zthread.h"
+
+#ifdef HAVE_THREADS
+
+/* Function and argument for a new thread, freed by the thread. */
+typedef struct {
+    void (*run)(void *);
+    void *arg;
+} zstart;
+
+#ifdef _WIN32
+
+#include <process.h>
+
+int ZLIB_INTERNAL zmutex_init(zmutex *mutex) {
+    InitializeCriticalSection(mutex);
+    return 0;
+}
+
+void ZLIB_INTERNAL zmutex_free(zmutex *mutex) {
+    DeleteCriticalSection(mutex);
+}
+
+void ZLIB_INTERNAL zmutex_lock(zmutex *mutex) {
+    EnterCriticalSection(mutex);
+}
+
+void ZLIB_INTERNAL zmutex_unlock(zmutex *mutex) {
+    LeaveCriticalSection(mutex);
+}
+
+int ZLIB_INTERNAL zcond_init(zcond *cond) {
+    InitializeConditionVariable(cond);
+    return 0;
+}
+
+void ZLIB_INTERNAL zcond_free(zcond *cond) {
+    (void)cond;
+}
+
+void ZLIB_INTERNAL zcond_wait(zcond *cond, zmutex *mutex) {
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void ZLIB_INTERNAL zcond_broadcast(zcond *cond) {
+    WakeAllConditionVariable(cond);
+}
+
+local unsigned __stdcall zthread_run(void *arg) {
+    zstart start = *(zstart *)arg;
+
+    free(arg);
+    start.run(start.arg);
+    return 0;
+}
+
+int ZLIB_INTERNAL zthread_start(zthread *thread, void (*run)(void *),
+                                void *arg) {
+    zstart *start;
+
+    start = malloc(sizeof(zstart));
+    if (start == NULL)
+        return -1;
+    start->run = run;
+    start->arg = arg;
+    *thread = (HANDLE)_beginthreadex(NULL, 0, zthread_run, start, 0, NULL);
+    if (*thread == 0) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void ZLIB_INTERNAL zthread_join(zthread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+/* Function to call with a thread's key value when the thread exits. */
+local void (*zkey_done)(void *);
+
+local VOID NTAPI zkey_run(PVOID ptr) {
+    if (ptr != NULL)
+        zkey_done(ptr);
+}
+
+int ZLIB_INTERNAL zkey_init(zkey *key, void (*done)(void *)) {
+    zkey_done = done;
+    *key = FlsAlloc(zkey_run);
+    return *key == FLS_OUT_OF_INDEXES ? -1 : 0;
+}
+
+void ZLIB_INTERNAL *zkey_get(zkey key) {
+    return FlsGetValue(key);
+}
+
+void ZLIB_INTERNAL zkey_set(zkey key, void *ptr) {
+    FlsSetValue(key, ptr);
+}
+
+#else /* !_WIN32 */
+
+int ZLIB_INTERNAL zmutex_init(zmutex *mutex) {
+    return pthread_mutex_init(mutex, NULL);
+}
+
+void ZLIB_INTERNAL zmutex_free(zmutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void ZLIB_INTERNAL zmutex_lock(zmutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void ZLIB_INTERNAL zmutex_unlock(zmutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+int ZLIB_INTERNAL zcond_init(zcond *cond) {
+    return pthread_cond_init(cond, NULL);
+}
+
+void ZLIB_INTERNAL zcond_free(zcond *cond) {
+    pthread_cond_destroy(cond);
+}
+
+void ZLIB_INTERNAL zcond_wait(zcond *cond, zmutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void ZLIB_INTERNAL zcond_broadcast(zcond *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+local void *zthread_run(void *arg) {
+    zstart start = *(zstart *)arg;
+
+    free(arg);
+    start.run(start.arg);
+    return NULL;
+}
+
+int ZLIB_INTERNAL zthread_start(zthread *thread, void (*run)(void *),
+                                void *arg) {
+    zstart *start;
+
+    start = malloc(sizeof(zstart));
+    if (start == NULL)
+        return -1;
+    start->run = run;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, zthread_run, start)) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void ZLIB_INTERNAL zthread_join(zthread thread) {
+    pthread_join(thread, NULL);
+}
+
+int ZLIB_INTERNAL zkey_init(zkey *key, void (*done)(void *)) {
+    return pthread_key_create(key, done);
+}
+
+void ZLIB_INTERNAL *zkey_get(zkey key) {
+    return pthread_getspecific(key);
+}
+
+void ZLIB_INTERNAL zkey_set(zkey key, void *ptr) {
+    pthread_setspecific(key, ptr);
+}
+
+#endif /* _WIN32 */
+
+#endif /* HAVE_THREADS */
+
+#ifdef HAVE_CLOCK
+
+#ifdef _WIN32
+
+#ifndef HAVE_THREADS
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+
+ulg ZLIB_INTERNAL zclock(void) {
+    static LONGLONG freq = 0;
+    LARGE_INTEGER now;
+
+    if (freq == 0) {
+        QueryPerformanceFrequency(&now);
+        freq = now.QuadPart;
+    }
+    QueryPerformanceCounter(&now);
+    return (ulg)(now.QuadPart / freq * 1000000 +
+                 now.QuadPart % freq * 1000000 / freq);
+}
+
+#else /* !_WIN32 */
+
+ulg ZLIB_INTERNAL zclock(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ulg)now.tv_sec * 1000000 + (ulg)now.tv_nsec / 1000;
+}
+
+#endif /* _WIN32 */
+
+#endif /* HAVE_CLOCK */
+
+#if !defined(HAVE_THREADS) && !defined(HAVE_CLOCK)
+
+/* ISO C forbids an empty translation unit. */
+typedef int zthread_dummy;
+
+#endif
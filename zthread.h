@@ -0,0 +1,81 @@
+/* zthread.h -- internal interface to threads and a clock
+ * Copyright (C) 2026 agent
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef ZTHREAD_H
+#define ZTHREAD_H
+
+#include "zutil.h"
+
+/* Threads are provided by Windows, or by POSIX threads if HAVE_PTHREAD is
+   defined (configure and cmake do that when they are available). Define
+   NO_THREADS to do without. When there are no threads, HAVE_THREADS is not
+   defined, and the parallel functions do all of their work in the calling
+   thread. */
+#if !defined(NO_THREADS) && !defined(Z_SOLO)
+#  if defined(_WIN32)
+#    ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#    define HAVE_THREADS
+     typedef CRITICAL_SECTION zmutex;
+     typedef CONDITION_VARIABLE zcond;
+     typedef HANDLE zthread;
+     typedef DWORD zkey;
+#  elif defined(HAVE_PTHREAD)
+#    include <pthread.h>
+#    define HAVE_THREADS
+     typedef pthread_mutex_t zmutex;
+     typedef pthread_cond_t zcond;
+     typedef pthread_t zthread;
+     typedef pthread_key_t zkey;
+#  endif
+#endif
+
+#ifdef HAVE_THREADS
+   /* The _init() and _start() functions return zero on success. */
+   int ZLIB_INTERNAL zmutex_init(zmutex *mutex);
+   void ZLIB_INTERNAL zmutex_free(zmutex *mutex);
+   void ZLIB_INTERNAL zmutex_lock(zmutex *mutex);
+   void ZLIB_INTERNAL zmutex_unlock(zmutex *mutex);
+   int ZLIB_INTERNAL zcond_init(zcond *cond);
+   void ZLIB_INTERNAL zcond_free(zcond *cond);
+   void ZLIB_INTERNAL zcond_wait(zcond *cond, zmutex *mutex);
+   void ZLIB_INTERNAL zcond_broadcast(zcond *cond);
+   int ZLIB_INTERNAL zthread_start(zthread *thread, void (*run)(void *),
+                                   void *arg);
+   void ZLIB_INTERNAL zthread_join(zthread thread);
+   /* A zkey holds a pointer for each thread, initially NULL. done() is called
+      with the pointer when a thread exits, if it is not NULL. On Windows,
+      there can be only one done() function. */
+   int ZLIB_INTERNAL zkey_init(zkey *key, void (*done)(void *));
+   void ZLIB_INTERNAL *zkey_get(zkey key);
+   void ZLIB_INTERNAL zkey_set(zkey key, void *ptr);
+#endif
+
+/* A monotonic clock is provided by Windows, or by POSIX clock_gettime() if
+   CLOCK_MONOTONIC is defined. HAVE_CLOCK is defined when there is one. */
+#ifndef Z_SOLO
+#  if defined(_WIN32)
+#    define HAVE_CLOCK
+#  else
+#    include <time.h>
+#    ifdef CLOCK_MONOTONIC
+#      define HAVE_CLOCK
+#    endif
+#  endif
+#endif
+
+#ifdef HAVE_CLOCK
+   /* Return the time in microseconds from some fixed point in the past. */
+   ulg ZLIB_INTERNAL zclock(void);
+#endif
+
+#endif /* ZTHREAD_H */
@@ -6,6 +6,8 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "zthread.h"        /* for HAVE_THREADS */
+#include "zcpu.h"           /* for the kernel names */
 #ifndef Z_SOLO
 #  include "gzguts.h"
 #endif
@@ -67,6 +69,9 @@ uLong ZEXPORT zlibCompileFlags(void) {
 #ifdef ZLIB_WINAPI
     flags += 1 << 10;
 #endif
+#ifdef DEFLATE_STATS
+    flags += 1 << 11;
+#endif
 #ifdef BUILDFIXED
     flags += 1 << 12;
 #endif
@@ -79,6 +84,9 @@ uLong ZEXPORT zlibCompileFlags(void) {
 #ifdef NO_GZIP
     flags += 1L << 17;
 #endif
+#ifndef HAVE_THREADS
+    flags += 1L << 18;
+#endif
 #ifdef PKZIP_BUG_WORKAROUND
     flags += 1L << 20;
 #endif
@@ -108,10 +116,45 @@ uLong ZEXPORT zlibCompileFlags(void) {
     flags += 1L << 26;
 #    endif
 #  endif
+#endif
+#ifdef INFLATE_STATS
+    flags += 1L << 27;
 #endif
     return flags;
 }
 
+/* The kernels selected by each module, listed once by zlibKernels(). */
+local z_once_t listed = Z_ONCE_INIT;
+local char kernels[160];
+
+/* Append "name=kernel" to kernels[] at *next, with a space before it if it is
+   not the first. kernels[] is large enough for all of the names. */
+local void add_kernel(unsigned *next, const char *name, const char *kernel) {
+    if (*next)
+        kernels[(*next)++] = ' ';
+    while (*name)
+        kernels[(*next)++] = *name++;
+    kernels[(*next)++] = '=';
+    while (*kernel)
+        kernels[(*next)++] = *kernel++;
+    kernels[*next] = 0;
+}
+
+local void list_kernels(void) {
+    unsigned next = 0;
+
+    add_kernel(&next, "crc32", crc32_kernel());
+    add_kernel(&next, "adler32", adler32_kernel());
+    add_kernel(&next, "longest_match", longest_match_kernel());
+    add_kernel(&next, "slide_hash", slide_hash_kernel());
+    add_kernel(&next, "inflate_copy", inflate_copy_kernel());
+}
+
+const char * ZEXPORT zlibKernels(void) {
+    z_once(&listed, list_kernels);
+    return kernels;
+}
+
 #ifdef ZLIB_DEBUG
 #include <stdlib.h>
 #  ifndef verbose
@@ -283,6 +326,121 @@ extern voidp calloc(uInt items, uInt size);
 extern void free(voidpf ptr);
 #endif
 
+#ifdef HAVE_THREADS
+
+/* With threads, each allocation is preceded by a header with its size, so
+   that zcfree() can keep freed blocks in a per-thread cache when enabled by
+   zlibAllocCache(). The header is 16 bytes to keep the alignment of malloc().
+   Each thread's cache is a list of blocks, most recently freed first, of at
+   most cache_max bytes and CACHE_COUNT blocks in total. */
+typedef union zblock_u {
+    struct {
+        z_size_t size;          /* size of the allocation after the header */
+        union zblock_u *next;   /* next block in the cache */
+    } h;
+    char pad[16];
+} zblock;
+
+typedef struct {
+    z_size_t have;              /* bytes in the cached blocks */
+    unsigned count;             /* number of cached blocks */
+    zblock *list;               /* cached blocks, most recently freed first */
+} zcache;
+
+#define CACHE_COUNT 32
+
+local z_size_t cache_max = 0;   /* maximum bytes cached per thread */
+local int cache_made = 0;       /* true if cache_key was initialized */
+local zkey cache_key;           /* each thread's zcache, or NULL */
+
+/* Free the blocks at the end of the list in cache until it is within the
+   limits. */
+local void cache_trim(zcache *cache) {
+    zblock **last, *blk;
+
+    while (cache->list != NULL &&
+           (cache->have > cache_max || cache->count > CACHE_COUNT)) {
+        last = &cache->list;
+        while ((*last)->h.next != NULL)
+            last = &(*last)->h.next;
+        blk = *last;
+        *last = NULL;
+        cache->have -= blk->h.size;
+        cache->count--;
+        free(blk);
+    }
+}
+
+/* Free a thread's cache when the thread exits. */
+local void cache_done(void *ptr) {
+    zcache *cache = ptr;
+    zblock *blk;
+
+    while ((blk = cache->list) != NULL) {
+        cache->list = blk->h.next;
+        free(blk);
+    }
+    free(cache);
+}
+
+voidpf ZLIB_INTERNAL zcalloc(voidpf opaque, unsigned items, unsigned size) {
+    z_size_t len = (z_size_t)items * size;
+    zcache *cache;
+    zblock *blk, **prev;
+
+    (void)opaque;
+    if (cache_max && (cache = zkey_get(cache_key)) != NULL)
+        for (prev = &cache->list; (blk = *prev) != NULL; prev = &blk->h.next)
+            if (blk->h.size == len) {
+                *prev = blk->h.next;
+                cache->have -= len;
+                cache->count--;
+                return (voidpf)(blk + 1);
+            }
+    blk = malloc(sizeof(zblock) + len);
+    if (blk == NULL)
+        return Z_NULL;
+    blk->h.size = len;
+    return (voidpf)(blk + 1);
+}
+
+void ZLIB_INTERNAL zcfree(voidpf opaque, voidpf ptr) {
+    zcache *cache;
+    zblock *blk;
+
+    (void)opaque;
+    if (ptr == Z_NULL)
+        return;
+    blk = (zblock *)ptr - 1;
+    if (cache_made) {
+        cache = zkey_get(cache_key);
+        if (cache == NULL && blk->h.size <= cache_max) {
+            cache = malloc(sizeof(zcache));
+            if (cache != NULL) {
+                cache->have = 0;
+                cache->count = 0;
+                cache->list = NULL;
+                zkey_set(cache_key, cache);
+            }
+        }
+        if (cache != NULL) {
+            if (blk->h.size <= cache_max) {
+                blk->h.next = cache->list;
+                cache->list = blk;
+                cache->have += blk->h.size;
+                cache->count++;
+                blk = NULL;
+            }
+            cache_trim(cache);
+        }
+    }
+    free(blk);
+}
+
+#  define CACHE_ALLOC
+
+#else /* !HAVE_THREADS */
+
 voidpf ZLIB_INTERNAL zcalloc(voidpf opaque, unsigned items, unsigned size) {
     (void)opaque;
     return sizeof(uInt) > 2 ? (voidpf)malloc(items * size) :
@@ -294,6 +452,75 @@ void ZLIB_INTERNAL zcfree(voidpf opaque, voidpf ptr) {
     free(ptr);
 }
 
+#endif /* HAVE_THREADS */
+
 #endif /* MY_ZCALLOC */
 
 #endif /* !Z_SOLO */
+
+int ZEXPORT zlibAllocCache(z_size_t max) {
+#ifdef CACHE_ALLOC
+    zcache *cache;
+
+    if (!cache_made) {
+        if (max == 0)
+            return Z_OK;
+        if (zkey_init(&cache_key, cache_done))
+            return Z_MEM_ERROR;
+        cache_made = 1;
+    }
+    cache_max = max;
+    cache = zkey_get(cache_key);
+    if (cache != NULL)
+        cache_trim(cache);
+    return Z_OK;
+#else
+    (void)max;
+    return Z_STREAM_ERROR;
+#endif
+}
+
+/* ===========================================================================
+ * Set up an arena at the first ZARENA_ALIGN boundary in the size bytes at mem,
+ * and return it, or return Z_NULL if it does not fit.
+ */
+voidpf ZLIB_INTERNAL zarena_init(voidpf mem, ulg size) {
+    zarena FAR *arena;
+    ulg pad;
+
+    pad = (ulg)(0 - (z_size_t)mem) & (ZARENA_ALIGN - 1);
+    if (size < pad + ZARENA_ROUND(sizeof(zarena)))
+        return Z_NULL;
+    arena = (zarena FAR *)((Bytef *)mem + pad);
+    arena->next = (Bytef *)arena + ZARENA_ROUND(sizeof(zarena));
+    arena->end = (Bytef *)mem + size;
+    return (voidpf)arena;
+}
+
+/* ===========================================================================
+ * Allocate the next items * size bytes of the arena, rounded up to keep the
+ * next allocation aligned.
+ */
+voidpf ZLIB_INTERNAL zarena_alloc(voidpf opaque, unsigned items,
+                                  unsigned size) {
+    zarena FAR *arena = (zarena FAR *)opaque;
+    ulg len = ZARENA_ROUND((ulg)items * size);
+    voidpf ptr;
+
+    if (len > (ulg)(arena->end - arena->next))
+        return Z_NULL;
+    ptr = (voidpf)arena->next;
+    arena->next += len;
+    return ptr;
+}
+
+/* ===========================================================================
+ * Free ptr and everything allocated after it. deflate and inflate free their
+ * allocations in the reverse order, so this returns all of the arena.
+ */
+void ZLIB_INTERNAL zarena_free(voidpf opaque, voidpf ptr) {
+    zarena FAR *arena = (zarena FAR *)opaque;
+
+    if ((Bytef *)ptr < arena->next)
+        arena->next = (Bytef *)ptr;
+}
@@ -78,6 +78,9 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 #endif
 /* default memLevel */
 
+#define MAX_LEVEL 12
+/* highest compression level, levels above 9 use optimal parsing */
+
 #define STORED_BLOCK 0
 #define STATIC_TREES 1
 #define DYN_TREES    2
@@ -184,6 +187,24 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 
 #ifndef F_OPEN
 #  define F_OPEN(name, mode) fopen((name), (mode))
+#endif
+
+        /* vector instruction sets */
+
+/* Define NO_SIMD to compile only the portable C versions of the routines that
+   have vector alternatives. Otherwise, X86_SIMD or ARM_SIMD is defined when
+   the compiler can generate the vector code. SSE2 and NEON are assumed to be
+   present when those are defined, since they are baseline for x86-64 and
+   AArch64. Wider instruction sets (e.g. AVX2) are compiled with function
+   target attributes and selected at run time only if the processor has them.
+ */
+#ifndef NO_SIMD
+#  if defined(__GNUC__) && (defined(__x86_64__) || \
+      (defined(__i386__) && defined(__SSE2__)))
+#    define X86_SIMD
+#  elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#    define ARM_SIMD
+#  endif
 #endif
 
          /* functions */
@@ -217,6 +238,14 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
    void ZLIB_INTERNAL zmemzero(Bytef* dest, uInt len);
 #endif
 
+/* Copy and check in one pass over memory, in blocks of CHECK_BLOCK bytes,
+   each of which is copied and then checked while it is still in the cache */
+#define CHECK_BLOCK 8192
+uLong ZLIB_INTERNAL adler32_copy(uLong adler, Bytef *dest,
+                                 const Bytef *source, z_size_t len);
+uLong ZLIB_INTERNAL crc32_copy(uLong crc, Bytef *dest, const Bytef *source,
+                               z_size_t len);
+
 /* Diagnostic functions */
 #ifdef ZLIB_DEBUG
 #  include <stdio.h>
@@ -243,6 +272,24 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
    void ZLIB_INTERNAL zcfree(voidpf opaque, voidpf ptr);
 #endif
 
+/* Allocation from a caller-provided block, for deflateInitMem() and
+   inflateInitMem(). Each allocation is rounded up to ZARENA_ALIGN bytes, and
+   ZARENA_SIZE(n) is the size of the block needed for allocations whose rounded
+   sizes total n, including the alignment of the start of the block and the
+   arena itself. */
+#define ZARENA_ALIGN 64
+#define ZARENA_ROUND(n) (((ulg)(n) + ZARENA_ALIGN - 1) & \
+                         ~(ulg)(ZARENA_ALIGN - 1))
+#define ZARENA_SIZE(n) (ZARENA_ALIGN - 1 + ZARENA_ROUND(sizeof(zarena)) + (n))
+typedef struct {
+    Bytef *next;        /* next available byte in the block */
+    Bytef *end;         /* end of the block */
+} zarena;
+voidpf ZLIB_INTERNAL zarena_init(voidpf mem, ulg size);
+voidpf ZLIB_INTERNAL zarena_alloc(voidpf opaque, unsigned items,
+                                  unsigned size);
+void ZLIB_INTERNAL zarena_free(voidpf opaque, voidpf ptr);
+
 #define ZALLOC(strm, items, size) \
            (*((strm)->zalloc))((strm)->opaque, (items), (size))
 #define ZFREE(strm, addr)  (*((strm)->zfree))((strm)->opaque, (voidpf)(addr))